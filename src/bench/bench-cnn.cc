@@ -0,0 +1,157 @@
+// bench/bench-cnn.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "bench/bench-utils.h"
+#include "cudamatrix/cu-device.h"
+#include "nnet/nnet-convolutional-component.h"
+#include "nnet/nnet-convolutional-2d-component.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+// Times the forward pass, and the forward pass, backward pass and update, of
+// "component" on "in"; adds the results in frames per second.
+static void BenchmarkComponent(const std::string &name,
+                               const BenchmarkOptions &bench_opts,
+                               int32 num_minibatches,
+                               const CuMatrixBase<BaseFloat> &in,
+                               UpdatableComponent *component,
+                               BenchmarkResults *results) {
+  CuMatrix<BaseFloat> out, out_diff(in.NumRows(), component->OutputDim()),
+      in_diff;
+  out_diff.SetRandn();
+  BenchmarkTimer forward_timer, training_timer;
+  for (int32 r = 0; r < bench_opts.num_repeats; r++) {
+    Timer timer;
+    for (int32 b = 0; b < num_minibatches; b++)
+      component->Propagate(in, &out);
+    forward_timer.AddTime(timer.Elapsed());
+
+    timer.Reset();
+    for (int32 b = 0; b < num_minibatches; b++) {
+      component->Propagate(in, &out);
+      component->Backpropagate(in, out, out_diff, &in_diff);
+      component->Update(in, out_diff);
+    }
+    training_timer.AddTime(timer.Elapsed());
+  }
+  double num_frames = static_cast<double>(num_minibatches) * in.NumRows();
+  results->AddResult(name + "-forward", "frames-per-second",
+                     num_frames / forward_timer.MinTime());
+  results->AddResult(name + "-training", "frames-per-second",
+                     num_frames / training_timer.MinTime());
+}
+
+}  // namespace nnet1
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet1;
+    const char *usage =
+        "Benchmark the nnet1 convolutional components (ConvolutionalComponent\n"
+        "and Convolutional2DComponent) as the front-end of a CNN acoustic\n"
+        "model, on spliced filterbank features: the forward pass, and the\n"
+        "forward pass, backward pass and update.  Results are written one per\n"
+        "line in JSON format.\n"
+        "Usage:  bench-cnn [options]\n"
+        "e.g.: bench-cnn --num-filters=256 --minibatch-size=512\n";
+
+    ParseOptions po(usage);
+    BenchmarkOptions bench_opts;
+    int32 num_bins = 40, num_splice = 11, patch_dim = 8, num_filters = 128,
+        filt_x_len = 9, minibatch_size = 256, num_minibatches = 10;
+    std::string use_gpu = "no";
+    bench_opts.Register(&po);
+    po.Register("num-bins", &num_bins, "Number of filterbank bins per frame.");
+    po.Register("num-splice", &num_splice, "Number of spliced frames.");
+    po.Register("patch-dim", &patch_dim, "Size of the filters along the "
+                "frequency axis.");
+    po.Register("filt-x-len", &filt_x_len, "Size of the 2D filters along the "
+                "time axis.");
+    po.Register("num-filters", &num_filters, "Number of filters.");
+    po.Register("minibatch-size", &minibatch_size, "Number of frames per "
+                "minibatch.");
+    po.Register("num-minibatches", &num_minibatches, "Number of minibatches "
+                "per timed run.");
+    po.Register("use-gpu", &use_gpu,
+                "yes|no|optional|wait, only has effect if compiled with CUDA");
+
+    po.Read(argc, argv);
+    if (po.NumArgs() != 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+    KALDI_ASSERT(patch_dim <= num_bins && filt_x_len <= num_splice);
+    srand(bench_opts.srand_seed);
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+
+    int32 input_dim = num_bins * num_splice,
+        num_freq_patches = num_bins - patch_dim + 1,
+        num_time_patches = num_splice - filt_x_len + 1;
+
+    ConvolutionalComponent conv(input_dim, num_freq_patches * num_filters);
+    {
+      std::ostringstream config;
+      config << "<PatchDim> " << patch_dim << " <PatchStep> 1 <PatchStride> "
+             << num_bins;
+      std::istringstream is(config.str());
+      conv.InitData(is);
+    }
+    Convolutional2DComponent conv2d(input_dim, num_time_patches *
+                                    num_freq_patches * num_filters);
+    {
+      std::ostringstream config;
+      config << "<FmapXLen> " << num_splice << " <FmapYLen> " << num_bins
+             << " <FiltXLen> " << filt_x_len << " <FiltYLen> " << patch_dim
+             << " <FiltXStep> 1 <FiltYStep> 1 <ConnectFmap> 0";
+      std::istringstream is(config.str());
+      conv2d.InitData(is);
+    }
+
+    CuMatrix<BaseFloat> in(minibatch_size, input_dim);
+    in.SetRandn();
+
+    BenchmarkResults results(bench_opts);
+    results.SetParam("num-bins", num_bins);
+    results.SetParam("num-splice", num_splice);
+    results.SetParam("patch-dim", patch_dim);
+    results.SetParam("filt-x-len", filt_x_len);
+    results.SetParam("num-filters", num_filters);
+    results.SetParam("minibatch-size", minibatch_size);
+
+    BenchmarkComponent("conv1d", bench_opts, num_minibatches, in, &conv,
+                       &results);
+    BenchmarkComponent("conv2d", bench_opts, num_minibatches, in, &conv2d,
+                       &results);
+    results.Write();
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().PrintProfile();
+#endif
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -0,0 +1,106 @@
+// bench/bench-decoder.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "bench/bench-utils.h"
+#include "decoder/decodable-matrix.h"
+#include "decoder/lattice-faster-decoder.h"
+#include "util/common-utils.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    const char *usage =
+        "Benchmark LatticeFasterDecoder on a synthetic decoding graph and\n"
+        "synthetic log-likelihoods.  Results are written one per line in JSON\n"
+        "format.\n"
+        "Usage:  bench-decoder [options]\n"
+        "e.g.: bench-decoder --num-states=1000000 --beam=15\n";
+
+    ParseOptions po(usage);
+    BenchmarkOptions bench_opts;
+    SyntheticGraphOptions graph_opts;
+    LatticeFasterDecoderConfig decoder_opts;
+    decoder_opts.beam = 13.0;
+    decoder_opts.max_active = 7000;
+    decoder_opts.lattice_beam = 6.0;
+    int32 num_frames = 3000;
+    BaseFloat acoustic_scale = 0.1;
+    bench_opts.Register(&po);
+    graph_opts.Register(&po);
+    decoder_opts.Register(&po);
+    po.Register("num-frames", &num_frames, "Number of frames to decode.");
+    po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for "
+                "acoustic likelihoods");
+
+    po.Read(argc, argv);
+    if (po.NumArgs() != 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+    srand(bench_opts.srand_seed);
+
+    fst::StdVectorFst graph;
+    GenerateSyntheticGraph(graph_opts, &graph);
+    Matrix<BaseFloat> loglikes;
+    GenerateSyntheticLoglikes(num_frames, graph_opts.num_pdfs, &loglikes);
+
+    BenchmarkResults results(bench_opts);
+    results.SetParam("num-states", graph_opts.num_states);
+    results.SetParam("arcs-per-state", graph_opts.arcs_per_state);
+    results.SetParam("num-pdfs", graph_opts.num_pdfs);
+    results.SetParam("num-frames", num_frames);
+    results.SetParam("beam", decoder_opts.beam);
+    results.SetParam("max-active", decoder_opts.max_active);
+    results.SetParam("lattice-beam", decoder_opts.lattice_beam);
+
+    BenchmarkTimer decode_timer, lattice_timer;
+    int32 num_lattice_arcs = 0;
+    for (int32 r = 0; r < bench_opts.num_repeats; r++) {
+      LatticeFasterDecoder decoder(graph, decoder_opts);
+      DecodableMatrixScaled decodable(loglikes, acoustic_scale);
+      Timer timer;
+      if (!decoder.Decode(&decodable))
+        KALDI_ERR << "Decoding failed (no tokens survived).";
+      decode_timer.AddTime(timer.Elapsed());
+      KALDI_ASSERT(decoder.NumFramesDecoded() == num_frames);
+
+      timer.Reset();
+      Lattice lat;
+      decoder.GetRawLattice(&lat);
+      lattice_timer.AddTime(timer.Elapsed());
+      num_lattice_arcs = 0;
+      for (int32 s = 0; s < lat.NumStates(); s++)
+        num_lattice_arcs += lat.NumArcs(s);
+    }
+    results.AddResult("lattice-faster-decoder", "frames-per-second",
+                      num_frames / decode_timer.MinTime());
+    results.AddResult("lattice-faster-decoder", "median-frames-per-second",
+                      num_frames / decode_timer.MedianTime());
+    results.AddResult("lattice-faster-decoder-get-raw-lattice", "seconds",
+                      lattice_timer.MinTime());
+    results.AddResult("lattice-faster-decoder-get-raw-lattice",
+                      "lattice-arcs-per-frame",
+                      num_lattice_arcs / static_cast<double>(num_frames));
+    results.Write();
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
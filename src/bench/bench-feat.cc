@@ -0,0 +1,92 @@
+// bench/bench-feat.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "bench/bench-utils.h"
+#include "feat/feature-fbank.h"
+#include "feat/feature-mfcc.h"
+#include "feat/feature-plp.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+
+// Times F::Compute() (F is Mfcc, Fbank or Plp) on the waveform, and records
+// the real-time factor and frames per second.
+template<class F>
+void BenchmarkFeature(const std::string &name, const BenchmarkOptions &opts,
+                      BaseFloat samp_freq, const Vector<BaseFloat> &wave,
+                      BenchmarkResults *results) {
+  typename F::Options feat_opts;
+  feat_opts.frame_opts.samp_freq = samp_freq;
+  F computer(feat_opts);
+  BenchmarkTimer timer;
+  Matrix<BaseFloat> feats;
+  for (int32 r = 0; r < opts.num_repeats; r++) {
+    Timer t;
+    computer.Compute(wave, 1.0, &feats);
+    timer.AddTime(t.Elapsed());
+  }
+  BaseFloat num_seconds = wave.Dim() / samp_freq;
+  results->AddResult(name, "real-time-factor", timer.MinTime() / num_seconds);
+  results->AddResult(name, "frames-per-second",
+                     feats.NumRows() / timer.MinTime());
+}
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    const char *usage =
+        "Benchmark feature extraction (MFCC, filterbank and PLP) on a synthetic\n"
+        "waveform.  Results are written one per line in JSON format.\n"
+        "Usage:  bench-feat [options]\n"
+        "e.g.: bench-feat --num-seconds=600 --results-wxfilename=feat.json\n";
+
+    ParseOptions po(usage);
+    BenchmarkOptions bench_opts;
+    BaseFloat num_seconds = 60.0, samp_freq = 16000.0;
+    bench_opts.Register(&po);
+    po.Register("num-seconds", &num_seconds, "Length of the synthetic "
+                "waveform in seconds.");
+    po.Register("sample-frequency", &samp_freq, "Sampling frequency of the "
+                "synthetic waveform.");
+
+    po.Read(argc, argv);
+    if (po.NumArgs() != 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+    srand(bench_opts.srand_seed);
+
+    Vector<BaseFloat> wave;
+    GenerateSyntheticWaveform(samp_freq, num_seconds, &wave);
+
+    BenchmarkResults results(bench_opts);
+    results.SetParam("num-seconds", num_seconds);
+    results.SetParam("sample-frequency", samp_freq);
+    BenchmarkFeature<Mfcc>("mfcc", bench_opts, samp_freq, wave, &results);
+    BenchmarkFeature<Fbank>("fbank", bench_opts, samp_freq, wave, &results);
+    BenchmarkFeature<Plp>("plp", bench_opts, samp_freq, wave, &results);
+    results.Write();
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
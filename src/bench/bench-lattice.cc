@@ -0,0 +1,118 @@
+// bench/bench-lattice.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "bench/bench-utils.h"
+#include "decoder/decodable-matrix.h"
+#include "decoder/lattice-faster-decoder.h"
+#include "lat/determinize-lattice-pruned.h"
+#include "lat/kaldi-lattice.h"
+#include "util/common-utils.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    const char *usage =
+        "Benchmark lattice determinization (DeterminizeLatticePruned) on raw\n"
+        "lattices produced by decoding synthetic log-likelihoods with a\n"
+        "synthetic graph.  Results are written one per line in JSON format.\n"
+        "Usage:  bench-lattice [options]\n"
+        "e.g.: bench-lattice --lattice-beam=8\n";
+
+    ParseOptions po(usage);
+    BenchmarkOptions bench_opts;
+    SyntheticGraphOptions graph_opts;
+    graph_opts.num_states = 20000;
+    LatticeFasterDecoderConfig decoder_opts;
+    decoder_opts.beam = 13.0;
+    decoder_opts.max_active = 7000;
+    decoder_opts.lattice_beam = 8.0;
+    int32 num_frames = 1000;
+    BaseFloat acoustic_scale = 0.1;
+    bench_opts.Register(&po);
+    graph_opts.Register(&po);
+    decoder_opts.Register(&po);
+    po.Register("num-frames", &num_frames, "Number of frames to decode.");
+    po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for "
+                "acoustic likelihoods");
+
+    po.Read(argc, argv);
+    if (po.NumArgs() != 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+    srand(bench_opts.srand_seed);
+
+    fst::StdVectorFst graph;
+    GenerateSyntheticGraph(graph_opts, &graph);
+    Matrix<BaseFloat> loglikes;
+    GenerateSyntheticLoglikes(num_frames, graph_opts.num_pdfs, &loglikes);
+
+    Lattice lat;
+    {
+      LatticeFasterDecoder decoder(graph, decoder_opts);
+      DecodableMatrixScaled decodable(loglikes, acoustic_scale);
+      if (!decoder.Decode(&decodable))
+        KALDI_ERR << "Decoding failed (no tokens survived).";
+      decoder.GetRawLattice(&lat);
+    }
+    // Prepare the lattice as lattice-determinize-pruned does.
+    fst::Connect(&lat);
+    fst::Invert(&lat);  // so word labels are on the input side.
+    if (!fst::TopSort(&lat))
+      KALDI_ERR << "Cycles detected in lattice.";
+    fst::ArcSort(&lat, fst::ILabelCompare<LatticeArc>());
+    int32 num_arcs = 0;
+    for (int32 s = 0; s < lat.NumStates(); s++)
+      num_arcs += lat.NumArcs(s);
+
+    BenchmarkResults results(bench_opts);
+    results.SetParam("num-states", graph_opts.num_states);
+    results.SetParam("num-frames", num_frames);
+    results.SetParam("lattice-beam", decoder_opts.lattice_beam);
+    results.SetParam("lattice-arcs", num_arcs);
+
+    fst::DeterminizeLatticePrunedOptions det_opts;
+    det_opts.delta = decoder_opts.det_opts.delta;
+    det_opts.max_mem = decoder_opts.det_opts.max_mem;
+
+    BenchmarkTimer timer;
+    int32 num_det_arcs = 0;
+    for (int32 r = 0; r < bench_opts.num_repeats; r++) {
+      CompactLattice clat;
+      Timer t;
+      if (!fst::DeterminizeLatticePruned(lat, decoder_opts.lattice_beam, &clat,
+                                         det_opts))
+        KALDI_WARN << "Determinization finished earlier than the beam.";
+      timer.AddTime(t.Elapsed());
+      num_det_arcs = 0;
+      for (int32 s = 0; s < clat.NumStates(); s++)
+        num_det_arcs += clat.NumArcs(s);
+    }
+    results.AddResult("determinize-lattice-pruned", "seconds", timer.MinTime());
+    results.AddResult("determinize-lattice-pruned", "input-arcs-per-second",
+                      num_arcs / timer.MinTime());
+    results.AddResult("determinize-lattice-pruned", "output-arcs",
+                      num_det_arcs);
+    results.Write();
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -0,0 +1,137 @@
+// bench/bench-lstm.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "bench/bench-utils.h"
+#include "cudamatrix/cu-device.h"
+#include "nnet/nnet-blstm-projected-streams.h"
+#include "nnet/nnet-lstm-projected-streams.h"
+#include "util/common-utils.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet1;
+    const char *usage =
+        "Benchmark the nnet1 LSTM components (LstmProjectedStreams and\n"
+        "BLstmProjectedStreams): streaming inference (the forward pass, one\n"
+        "chunk at a time with the state carried over) and training (forward\n"
+        "and backward pass).  Results are written one per line in JSON format.\n"
+        "Usage:  bench-lstm [options]\n"
+        "e.g.: bench-lstm --cell-dim=800 --num-streams=40\n";
+
+    ParseOptions po(usage);
+    BenchmarkOptions bench_opts;
+    int32 input_dim = 40, cell_dim = 512, recurrent_dim = 256,
+        num_streams = 20, chunk_size = 20, num_chunks = 10;
+    std::string use_gpu = "no";
+    bench_opts.Register(&po);
+    po.Register("input-dim", &input_dim, "Input dimension of the LSTM.");
+    po.Register("cell-dim", &cell_dim, "Number of LSTM cells.");
+    po.Register("recurrent-dim", &recurrent_dim, "Dimension of the recurrent "
+                "projection (the output dimension of the LSTM).");
+    po.Register("num-streams", &num_streams, "Number of streams processed in "
+                "parallel.");
+    po.Register("chunk-size", &chunk_size, "Number of frames of each stream "
+                "per minibatch.");
+    po.Register("num-chunks", &num_chunks, "Number of minibatches per timed "
+                "run.");
+    po.Register("use-gpu", &use_gpu,
+                "yes|no|optional|wait, only has effect if compiled with CUDA");
+
+    po.Read(argc, argv);
+    if (po.NumArgs() != 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+    srand(bench_opts.srand_seed);
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+
+    std::ostringstream config;
+    config << "<CellDim> " << cell_dim;
+    LstmProjectedStreams lstm(input_dim, recurrent_dim);
+    {
+      std::istringstream is(config.str());
+      lstm.InitData(is);
+    }
+    BLstmProjectedStreams blstm(input_dim, 2 * recurrent_dim);
+    {
+      std::istringstream is(config.str());
+      blstm.InitData(is);
+    }
+    std::vector<int32> reset_flags(num_streams, 1),
+        seq_lengths(num_streams, chunk_size);
+    lstm.ResetLstmStreams(reset_flags);
+    blstm.SetSeqLengths(seq_lengths);
+
+    CuMatrix<BaseFloat> in(chunk_size * num_streams, input_dim), out,
+        lstm_out_diff(chunk_size * num_streams, recurrent_dim),
+        blstm_out_diff(chunk_size * num_streams, 2 * recurrent_dim), in_diff;
+    in.SetRandn();
+    lstm_out_diff.SetRandn();
+    blstm_out_diff.SetRandn();
+
+    BenchmarkResults results(bench_opts);
+    results.SetParam("input-dim", input_dim);
+    results.SetParam("cell-dim", cell_dim);
+    results.SetParam("recurrent-dim", recurrent_dim);
+    results.SetParam("num-streams", num_streams);
+    results.SetParam("chunk-size", chunk_size);
+
+    BenchmarkTimer inference_timer, training_timer, blstm_training_timer;
+    for (int32 r = 0; r < bench_opts.num_repeats; r++) {
+      Timer timer;
+      for (int32 c = 0; c < num_chunks; c++)
+        lstm.Propagate(in, &out);
+      inference_timer.AddTime(timer.Elapsed());
+
+      timer.Reset();
+      for (int32 c = 0; c < num_chunks; c++) {
+        lstm.Propagate(in, &out);
+        lstm.Backpropagate(in, out, lstm_out_diff, &in_diff);
+      }
+      training_timer.AddTime(timer.Elapsed());
+
+      timer.Reset();
+      for (int32 c = 0; c < num_chunks; c++) {
+        blstm.Propagate(in, &out);
+        blstm.Backpropagate(in, out, blstm_out_diff, &in_diff);
+      }
+      blstm_training_timer.AddTime(timer.Elapsed());
+    }
+    double num_frames = static_cast<double>(num_chunks) * chunk_size *
+        num_streams;
+    results.AddResult("lstm-streaming-inference", "frames-per-second",
+                      num_frames / inference_timer.MinTime());
+    results.AddResult("lstm-training", "frames-per-second",
+                      num_frames / training_timer.MinTime());
+    results.AddResult("blstm-training", "frames-per-second",
+                      num_frames / blstm_training_timer.MinTime());
+    results.Write();
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().PrintProfile();
+#endif
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -0,0 +1,170 @@
+// bench/bench-nnet3.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "bench/bench-utils.h"
+#include "cudamatrix/cu-device.h"
+#include "nnet3/nnet-compile.h"
+#include "nnet3/nnet-compute.h"
+#include "nnet3/nnet-nnet.h"
+#include "nnet3/nnet-optimize.h"
+#include "nnet3/nnet-test-utils.h"
+#include "nnet3/nnet-utils.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// Creates a request for the output for frames 0 ... chunk_size - 1 of
+// "num_sequences" sequences, with the input that this needs.
+void CreateBenchmarkRequest(const Nnet &nnet, int32 chunk_size,
+                            int32 num_sequences,
+                            ComputationRequest *request,
+                            Matrix<BaseFloat> *input) {
+  int32 left_context, right_context;
+  ComputeSimpleNnetContext(nnet, &left_context, &right_context);
+  std::vector<Index> input_indexes, output_indexes;
+  for (int32 t = -left_context; t < chunk_size + right_context; t++)
+    for (int32 n = 0; n < num_sequences; n++)
+      input_indexes.push_back(Index(n, t));
+  for (int32 t = 0; t < chunk_size; t++)
+    for (int32 n = 0; n < num_sequences; n++)
+      output_indexes.push_back(Index(n, t));
+  request->inputs.clear();
+  request->inputs.push_back(IoSpecification("input", input_indexes));
+  request->outputs.clear();
+  request->outputs.push_back(IoSpecification("output", output_indexes));
+  input->Resize(input_indexes.size(), nnet.InputDim("input"));
+  input->SetRandn();
+}
+
+}  // namespace nnet3
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet3;
+    const char *usage =
+        "Benchmark the forward computation of nnet3 (NnetComputer), for a\n"
+        "synthetic TDNN-like network of configurable size, or (with\n"
+        "--random-config=true) for randomly generated networks as used in the\n"
+        "nnet3 tests.  Results are written one per line in JSON format.\n"
+        "Usage:  bench-nnet3 [options]\n"
+        "e.g.: bench-nnet3 --hidden-dim=2048 --num-hidden-layers=6\n";
+
+    ParseOptions po(usage);
+    BenchmarkOptions bench_opts;
+    SyntheticNnetOptions nnet_opts;
+    int32 chunk_size = 50, num_sequences = 64;
+    bool random_config = false;
+    std::string use_gpu = "no";
+    bench_opts.Register(&po);
+    nnet_opts.Register(&po);
+    po.Register("chunk-size", &chunk_size, "Number of output frames per "
+                "sequence in each minibatch.");
+    po.Register("num-sequences", &num_sequences, "Number of sequences in each "
+                "minibatch.");
+    po.Register("random-config", &random_config, "If true, benchmark a "
+                "randomly generated network (see nnet3/nnet-test-utils.h) "
+                "instead of the one specified by --hidden-dim etc.");
+    po.Register("use-gpu", &use_gpu,
+                "yes|no|optional|wait, only has effect if compiled with CUDA");
+
+    po.Read(argc, argv);
+    if (po.NumArgs() != 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+    srand(bench_opts.srand_seed);
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+
+    Nnet nnet;
+    std::vector<std::string> configs;
+    if (random_config) {
+      NnetGenerationOptions gen_opts;
+      gen_opts.allow_multiple_inputs = false;
+      GenerateConfigSequence(gen_opts, &configs);
+    } else {
+      configs.push_back(GenerateSyntheticNnetConfig(nnet_opts));
+    }
+    for (size_t i = 0; i < configs.size(); i++) {
+      std::istringstream is(configs[i]);
+      nnet.ReadConfig(is);
+    }
+
+    ComputationRequest request;
+    Matrix<BaseFloat> input;
+    CreateBenchmarkRequest(nnet, chunk_size, num_sequences, &request, &input);
+
+    BenchmarkResults results(bench_opts);
+    results.SetParam("random-config", (random_config ? "true" : "false"));
+    if (!random_config) {
+      results.SetParam("input-dim", nnet_opts.input_dim);
+      results.SetParam("hidden-dim", nnet_opts.hidden_dim);
+      results.SetParam("output-dim", nnet_opts.output_dim);
+      results.SetParam("num-hidden-layers", nnet_opts.num_hidden_layers);
+      results.SetParam("splice-width", nnet_opts.splice_width);
+    }
+    results.SetParam("num-parameters", NumParameters(nnet));
+    results.SetParam("chunk-size", chunk_size);
+    results.SetParam("num-sequences", num_sequences);
+
+    NnetComputation computation;
+    {
+      Timer timer;
+      Compiler compiler(request, nnet);
+      CompilerOptions compiler_opts;
+      compiler.CreateComputation(compiler_opts, &computation);
+      NnetOptimizeOptions optimize_opts;
+      Optimize(optimize_opts, nnet, request, &computation);
+      computation.ComputeCudaIndexes();
+      results.AddResult("nnet3-compile", "seconds", timer.Elapsed());
+    }
+
+    NnetComputeOptions compute_opts;
+    BenchmarkTimer timer;
+    for (int32 r = 0; r < bench_opts.num_repeats; r++) {
+      Timer t;
+      NnetComputer computer(compute_opts, computation, nnet, NULL);
+      CuMatrix<BaseFloat> cu_input(input);
+      computer.AcceptInput("input", &cu_input);
+      computer.Forward();
+      CuMatrix<BaseFloat> output;
+      computer.GetOutputDestructive("output", &output);
+      Matrix<BaseFloat> output_cpu(output);  // includes the copy from GPU.
+      timer.AddTime(t.Elapsed());
+    }
+    int32 num_frames = chunk_size * num_sequences;
+    results.AddResult("nnet3-forward", "frames-per-second",
+                      num_frames / timer.MinTime());
+    results.AddResult("nnet3-forward", "median-frames-per-second",
+                      num_frames / timer.MedianTime());
+    results.Write();
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().PrintProfile();
+#endif
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
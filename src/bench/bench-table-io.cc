@@ -0,0 +1,127 @@
+// bench/bench-table-io.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "bench/bench-utils.h"
+#include "util/common-utils.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    const char *usage =
+        "Benchmark table I/O: writing a feature archive (with a script file),\n"
+        "reading it sequentially, and reading it in random order through the\n"
+        "script file.  Results are written one per line in JSON format.\n"
+        "Usage:  bench-table-io [options]\n"
+        "e.g.: bench-table-io --num-utts=5000 --scratch-dir=/tmp\n";
+
+    ParseOptions po(usage);
+    BenchmarkOptions bench_opts;
+    int32 num_utts = 1000, num_frames = 500, dim = 40;
+    bool compress = false;
+    std::string scratch_dir = ".";
+    bench_opts.Register(&po);
+    po.Register("num-utts", &num_utts, "Number of matrices in the archive.");
+    po.Register("num-frames", &num_frames, "Number of rows of each matrix.");
+    po.Register("dim", &dim, "Number of columns of each matrix.");
+    po.Register("compress", &compress, "If true, write compressed matrices.");
+    po.Register("scratch-dir", &scratch_dir, "Directory in which to write the "
+                "temporary archive and script file.");
+
+    po.Read(argc, argv);
+    if (po.NumArgs() != 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+    srand(bench_opts.srand_seed);
+
+    std::string ark = scratch_dir + "/bench-table-io.ark",
+        scp = scratch_dir + "/bench-table-io.scp",
+        wspecifier = "ark,scp:" + ark + "," + scp;
+
+    std::vector<std::string> keys(num_utts);
+    for (int32 i = 0; i < num_utts; i++) {
+      std::ostringstream os;
+      os << "utt" << (100000 + i);  // so that they are sorted.
+      keys[i] = os.str();
+    }
+    Matrix<BaseFloat> mat(num_frames, dim);
+    mat.SetRandn();
+    double num_mb = 1.0e-06 * num_utts * num_frames * dim * sizeof(BaseFloat);
+
+    BenchmarkResults results(bench_opts);
+    results.SetParam("num-utts", num_utts);
+    results.SetParam("num-frames", num_frames);
+    results.SetParam("dim", dim);
+    results.SetParam("compress", (compress ? "true" : "false"));
+
+    BenchmarkTimer write_timer, read_timer, random_read_timer;
+    for (int32 r = 0; r < bench_opts.num_repeats; r++) {
+      Timer timer;
+      if (compress) {
+        CompressedMatrixWriter writer(wspecifier);
+        CompressedMatrix cmat(mat);
+        for (int32 i = 0; i < num_utts; i++)
+          writer.Write(keys[i], cmat);
+      } else {
+        BaseFloatMatrixWriter writer(wspecifier);
+        for (int32 i = 0; i < num_utts; i++)
+          writer.Write(keys[i], mat);
+      }
+      write_timer.AddTime(timer.Elapsed());
+
+      timer.Reset();
+      int64 num_rows = 0;
+      {
+        SequentialBaseFloatMatrixReader reader("scp:" + scp);
+        for (; !reader.Done(); reader.Next())
+          num_rows += reader.Value().NumRows();
+      }
+      read_timer.AddTime(timer.Elapsed());
+      KALDI_ASSERT(num_rows == static_cast<int64>(num_utts) * num_frames);
+
+      std::vector<std::string> shuffled_keys(keys);
+      std::random_shuffle(shuffled_keys.begin(), shuffled_keys.end());
+      timer.Reset();
+      {
+        RandomAccessBaseFloatMatrixReader reader("scp:" + scp);
+        for (int32 i = 0; i < num_utts; i++)
+          num_rows -= reader.Value(shuffled_keys[i]).NumRows();
+      }
+      random_read_timer.AddTime(timer.Elapsed());
+      KALDI_ASSERT(num_rows == 0);
+    }
+    std::remove(ark.c_str());
+    std::remove(scp.c_str());
+
+    results.AddResult("table-write", "megabytes-per-second",
+                      num_mb / write_timer.MinTime());
+    results.AddResult("table-sequential-read", "megabytes-per-second",
+                      num_mb / read_timer.MinTime());
+    results.AddResult("table-random-read", "megabytes-per-second",
+                      num_mb / random_read_timer.MinTime());
+    results.Write();
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
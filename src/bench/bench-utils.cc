@@ -0,0 +1,208 @@
+// bench/bench-utils.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdlib>
+#include <fst/fstlib.h>
+#include "bench/bench-utils.h"
+#include "util/kaldi-io.h"
+
+namespace kaldi {
+
+double BenchmarkTimer::MinTime() const {
+  KALDI_ASSERT(!times_.empty());
+  return *std::min_element(times_.begin(), times_.end());
+}
+
+double BenchmarkTimer::MedianTime() const {
+  KALDI_ASSERT(!times_.empty());
+  std::vector<double> sorted(times_);
+  std::sort(sorted.begin(), sorted.end());
+  return sorted[sorted.size() / 2];
+}
+
+
+bool BenchmarkResults::IsNumber(const std::string &str) {
+  if (str.empty()) return false;
+  const char *begin = str.c_str();
+  char *end;
+  double d = strtod(begin, &end);
+  return (*end == '\0' && d == d && d - d == 0.0);  // not NaN or inf.
+}
+
+void BenchmarkResults::SetParamInternal(const std::string &name,
+                                        const std::string &value,
+                                        bool is_number) {
+  std::string formatted = (is_number ? value : "\"" + value + "\"");
+  for (size_t i = 0; i < params_.size(); i++) {
+    if (params_[i].first == name) {
+      params_[i].second = formatted;
+      return;
+    }
+  }
+  params_.push_back(std::make_pair(name, formatted));
+}
+
+void BenchmarkResults::AddResult(const std::string &benchmark,
+                                 const std::string &metric,
+                                 double value) {
+  std::ostringstream os;
+  os << "{\"benchmark\": \"" << benchmark << "\", \"metric\": \""
+     << metric << "\", \"value\": " << value << ", \"params\": {";
+  for (size_t i = 0; i < params_.size(); i++)
+    os << (i == 0 ? "" : ", ") << '"' << params_[i].first << "\": "
+       << params_[i].second;
+  os << "}}";
+  KALDI_LOG << benchmark << ": " << metric << " = " << value;
+  lines_.push_back(os.str());
+}
+
+void BenchmarkResults::Write() const {
+  Output ko(opts_.results_wxfilename, false);  // text mode.
+  for (size_t i = 0; i < lines_.size(); i++)
+    ko.Stream() << lines_[i] << '\n';
+  ko.Close();
+}
+
+
+void GenerateSyntheticGraph(const SyntheticGraphOptions &opts,
+                            fst::StdVectorFst *fst) {
+  typedef fst::StdArc Arc;
+  KALDI_ASSERT(opts.num_states > 1 && opts.arcs_per_state > 0 &&
+               opts.num_pdfs > 0 && opts.num_words > 0);
+  fst->DeleteStates();
+  for (int32 s = 0; s < opts.num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < opts.num_states; s++) {
+    // The self-loop, as in an HMM state.
+    int32 pdf = RandInt(1, opts.num_pdfs);
+    fst->AddArc(s, Arc(pdf, 0, -Log(0.5), s));
+    BaseFloat arc_cost = -Log(0.5 / opts.arcs_per_state);
+    for (int32 a = 0; a < opts.arcs_per_state; a++) {
+      // The first arc goes to the next state, which makes sure that all states
+      // are accessible; the others go anywhere.
+      int32 next_state = (a == 0 ? (s + 1) % opts.num_states :
+                          RandInt(0, opts.num_states - 1));
+      int32 ilabel = (RandUniform() < opts.epsilon_proportion ? 0 :
+                      RandInt(1, opts.num_pdfs)),
+          olabel = (RandInt(0, 9) == 0 ? RandInt(1, opts.num_words) : 0);
+      // Epsilon arcs must not form cycles, or the decoder would loop; we
+      // only allow them to go forward.
+      if (ilabel == 0 && next_state <= s) {
+        if (s + 1 < opts.num_states) next_state = RandInt(s + 1,
+                                                          opts.num_states - 1);
+        else ilabel = RandInt(1, opts.num_pdfs);
+      }
+      BaseFloat cost = arc_cost + RandUniform();  // vary the LM-like costs.
+      fst->AddArc(s, Arc(ilabel, olabel, cost, next_state));
+    }
+    if (s == opts.num_states - 1 || RandUniform() < opts.final_proportion)
+      fst->SetFinal(s, -Log(RandUniform() + 0.01));
+  }
+  fst::ArcSort(fst, fst::ILabelCompare<Arc>());
+}
+
+void GenerateSyntheticLoglikes(int32 num_frames, int32 num_pdfs,
+                               Matrix<BaseFloat> *loglikes) {
+  KALDI_ASSERT(num_frames > 0 && num_pdfs > 0);
+  loglikes->Resize(num_frames, num_pdfs + 1);
+  int32 num_favoured = 10;
+  std::vector<int32> favoured(num_favoured);
+  for (int32 t = 0; t < num_frames; t++) {
+    if (t % 5 == 0)  // change the favoured pdfs every 5 frames.
+      for (int32 i = 0; i < num_favoured; i++)
+        favoured[i] = RandInt(1, num_pdfs);
+    SubVector<BaseFloat> row(*loglikes, t);
+    row.SetRandn();
+    row.Scale(2.0);
+    for (int32 i = 0; i < num_favoured; i++)
+      row(favoured[i]) += 5.0;
+    row(0) = -1.0e+10;  // column zero is never used; make it improbable.
+    row.Add(-row.LogSumExp());
+  }
+}
+
+void GenerateSyntheticWaveform(BaseFloat samp_freq, BaseFloat num_seconds,
+                               Vector<BaseFloat> *wave) {
+  KALDI_ASSERT(samp_freq > 0 && num_seconds > 0);
+  int32 num_samples = static_cast<int32>(samp_freq * num_seconds),
+      segment_length = static_cast<int32>(samp_freq * 0.1),
+      num_sinusoids = 3;
+  wave->Resize(num_samples);
+  std::vector<BaseFloat> freqs(num_sinusoids), amplitudes(num_sinusoids);
+  for (int32 i = 0; i < num_samples; i++) {
+    if (i % segment_length == 0) {
+      for (int32 j = 0; j < num_sinusoids; j++) {
+        freqs[j] = RandUniform() * samp_freq * 0.4;
+        amplitudes[j] = RandUniform() * 5000.0;
+      }
+    }
+    BaseFloat value = 30.0 * RandGauss();
+    for (int32 j = 0; j < num_sinusoids; j++)
+      value += amplitudes[j] * sin(M_2PI * freqs[j] * i / samp_freq);
+    (*wave)(i) = value;
+  }
+}
+
+std::string GenerateSyntheticNnetConfig(const SyntheticNnetOptions &opts) {
+  KALDI_ASSERT(opts.input_dim > 0 && opts.hidden_dim > 0 &&
+               opts.output_dim > 0 && opts.num_hidden_layers >= 0 &&
+               opts.splice_width > 0);
+  std::ostringstream os;
+  os << "input-node name=input dim=" << opts.input_dim << "\n";
+  std::string prev_node = "input";
+  int32 prev_dim = opts.input_dim,
+      left_splice = (opts.splice_width - 1) / 2,
+      right_splice = opts.splice_width - 1 - left_splice;
+  for (int32 l = 1; l <= opts.num_hidden_layers + 1; l++) {
+    bool is_last = (l == opts.num_hidden_layers + 1);
+    int32 output_dim = (is_last ? opts.output_dim : opts.hidden_dim),
+        spliced_dim = prev_dim * (is_last ? 1 : opts.splice_width);
+    os << "component name=affine" << l << " type=AffineComponent input-dim="
+       << spliced_dim << " output-dim=" << output_dim << "\n";
+    os << "component-node name=affine" << l << " component=affine" << l
+       << " input=";
+    if (is_last || opts.splice_width == 1) {
+      os << prev_node << "\n";
+    } else {
+      os << "Append(";
+      for (int32 o = -left_splice; o <= right_splice; o++)
+        os << (o == -left_splice ? "" : ", ") << "Offset(" << prev_node
+           << ", " << o << ")";
+      os << ")\n";
+    }
+    std::ostringstream name;
+    if (is_last) {
+      name << "logsoftmax";
+      os << "component name=logsoftmax type=LogSoftmaxComponent dim="
+         << output_dim << "\n";
+    } else {
+      name << "relu" << l;
+      os << "component name=" << name.str()
+         << " type=RectifiedLinearComponent dim=" << output_dim << "\n";
+    }
+    os << "component-node name=" << name.str() << " component=" << name.str()
+       << " input=affine" << l << "\n";
+    prev_node = name.str();
+    prev_dim = output_dim;
+  }
+  os << "output-node name=output input=" << prev_node << "\n";
+  return os.str();
+}
+
+}  // namespace kaldi
@@ -0,0 +1,198 @@
+// bench/bench-utils.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_BENCH_BENCH_UTILS_H_
+#define KALDI_BENCH_BENCH_UTILS_H_
+
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fst/fst-decl.h>
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "matrix/kaldi-matrix.h"
+
+/** @file
+   This file contains the common code for the benchmark programs in this
+   directory: the options that all of them take, a class for writing results in
+   a machine-readable format, and functions that generate reproducible synthetic
+   inputs (decoding graphs, log-likelihoods, waveforms and nnet3 configs), so
+   that the benchmarks do not need any data.
+
+   The results are written one per line, as JSON objects, e.g.
+   {"benchmark": "lattice-faster-decoder", "metric": "frames-per-second",
+    "value": 812.3, "params": {"num-states": 100000, ...}}
+   so that they can be compared between versions by simple scripts.
+*/
+
+namespace kaldi {
+
+struct BenchmarkOptions {
+  int32 num_repeats;
+  int32 srand_seed;
+  std::string results_wxfilename;
+
+  BenchmarkOptions(): num_repeats(3), srand_seed(0),
+                      results_wxfilename("-") { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("num-repeats", &num_repeats, "Number of times to repeat "
+                   "each timed computation; we report the fastest.");
+    opts->Register("srand", &srand_seed, "Seed for the random number generator "
+                   "that creates the synthetic inputs.");
+    opts->Register("results-wxfilename", &results_wxfilename, "Where to write "
+                   "the results (one JSON object per line).");
+  }
+};
+
+
+/// BenchmarkTimer collects the times taken by repeats of the same computation.
+class BenchmarkTimer {
+ public:
+  BenchmarkTimer() { }
+  void AddTime(double seconds) { times_.push_back(seconds); }
+  int32 NumRepeats() const { return times_.size(); }
+  /// The fastest time; this is the least noisy statistic.
+  double MinTime() const;
+  double MedianTime() const;
+ private:
+  std::vector<double> times_;
+};
+
+
+/// BenchmarkResults accumulates the results of a benchmark program, and
+/// writes them out when you call Write().
+class BenchmarkResults {
+ public:
+  explicit BenchmarkResults(const BenchmarkOptions &opts): opts_(opts) { }
+
+  /// Records a parameter of the benchmark (e.g. the graph size), to be
+  /// written out with the results that follow.
+  template<class T> void SetParam(const std::string &name, const T &value) {
+    std::ostringstream os;
+    os << value;
+    SetParamInternal(name, os.str(), IsNumber(os.str()));
+  }
+
+  /// Records a result.  "benchmark" is the name of what was measured
+  /// (e.g. "mfcc"), "metric" the quantity (e.g. "real-time-factor").
+  void AddResult(const std::string &benchmark, const std::string &metric,
+                 double value);
+
+  /// Writes all results to opts.results_wxfilename, and logs them.
+  void Write() const;
+
+ private:
+  void SetParamInternal(const std::string &name, const std::string &value,
+                        bool is_number);
+  static bool IsNumber(const std::string &str);
+
+  const BenchmarkOptions &opts_;
+  // Parameters, as (name, value) pairs, with the value already formatted as
+  // JSON.
+  std::vector<std::pair<std::string, std::string> > params_;
+  std::vector<std::string> lines_;
+};
+
+
+struct SyntheticGraphOptions {
+  int32 num_states;
+  int32 arcs_per_state;
+  int32 num_pdfs;
+  int32 num_words;
+  BaseFloat epsilon_proportion;
+  BaseFloat final_proportion;
+
+  SyntheticGraphOptions(): num_states(100000), arcs_per_state(3),
+                           num_pdfs(2000), num_words(10000),
+                           epsilon_proportion(0.1),
+                           final_proportion(0.01) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("num-states", &num_states, "Number of states in the "
+                   "synthetic decoding graph.");
+    opts->Register("arcs-per-state", &arcs_per_state, "Number of arcs per "
+                   "state in the synthetic graph, not counting the self-loop.");
+    opts->Register("num-pdfs", &num_pdfs, "Number of pdfs (columns of the "
+                   "log-likelihood matrix).");
+    opts->Register("num-words", &num_words, "Vocabulary size of the synthetic "
+                   "graph.");
+    opts->Register("epsilon-proportion", &epsilon_proportion, "Proportion of "
+                   "arcs in the synthetic graph with epsilon input labels.");
+    opts->Register("final-proportion", &final_proportion, "Proportion of "
+                   "states in the synthetic graph that are final.");
+  }
+};
+
+/// Generates a random graph with roughly the structure of an HCLG: each state
+/// has a self-loop and "arcs_per_state" arcs to random other states, and the
+/// input labels are 1 ... num_pdfs so that it can be decoded with
+/// DecodableMatrixScaled (see GenerateSyntheticLoglikes()).  A proportion of
+/// the arcs have epsilon input labels, and a few carry words.  The weights are
+/// negated log probabilities.  Every state is reachable and coaccessible, so
+/// the decoder never runs out of tokens.
+void GenerateSyntheticGraph(const SyntheticGraphOptions &opts,
+                            fst::StdVectorFst *fst);
+
+/// Generates a matrix of log-likelihoods with num_pdfs + 1 columns (column
+/// zero is not used, since the graph labels are one-based).  Each frame is a
+/// log-softmax of random scores, with a few pdfs favoured for several frames
+/// in a row so that the decoder sees something like speech.
+void GenerateSyntheticLoglikes(int32 num_frames, int32 num_pdfs,
+                               Matrix<BaseFloat> *loglikes);
+
+/// Generates "num_seconds" of a synthetic waveform, sampled at "samp_freq":
+/// a sum of sinusoids whose frequencies change every 0.1 seconds, with noise,
+/// at the scale of 16-bit audio.
+void GenerateSyntheticWaveform(BaseFloat samp_freq, BaseFloat num_seconds,
+                               Vector<BaseFloat> *wave);
+
+
+struct SyntheticNnetOptions {
+  int32 input_dim;
+  int32 hidden_dim;
+  int32 output_dim;
+  int32 num_hidden_layers;
+  int32 splice_width;
+
+  SyntheticNnetOptions(): input_dim(40), hidden_dim(1024), output_dim(4000),
+                          num_hidden_layers(5), splice_width(3) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("input-dim", &input_dim, "Feature dimension of the nnet.");
+    opts->Register("hidden-dim", &hidden_dim, "Dimension of the hidden "
+                   "layers.");
+    opts->Register("output-dim", &output_dim, "Output dimension (number of "
+                   "pdfs) of the nnet.");
+    opts->Register("num-hidden-layers", &num_hidden_layers, "Number of hidden "
+                   "layers.");
+    opts->Register("splice-width", &splice_width, "Each layer splices this many "
+                   "frames of its input (centered), TDNN style; 1 means no "
+                   "splicing.");
+  }
+};
+
+/// Generates an nnet3 config for a TDNN-like network of the given size
+/// (affine + ReLU layers, with splicing, and a log-softmax output), with one
+/// input called "input" and one output called "output".  The parameters are
+/// randomly initialized when the config is read.
+std::string GenerateSyntheticNnetConfig(const SyntheticNnetOptions &opts);
+
+}  // namespace kaldi
+
+#endif  // KALDI_BENCH_BENCH_UTILS_H_
@@ -24,6 +24,49 @@
 #include "hmm/transition-model.h"
 #include "hmm/posterior.h"
 #include "transform/lda-estimate.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+// This class is used to accumulate the LDA stats of an utterance, in parallel
+// with other utterances.
+class LdaAccTask {
+ public:
+  LdaAccTask(const TransitionModel &trans_model,
+             const Matrix<BaseFloat> &feats,
+             const Posterior &post,
+             BaseFloat rand_prune,
+             LdaEstimate *lda): trans_model_(trans_model), feats_(feats),
+                                post_(post), rand_prune_(rand_prune),
+                                lda_(lda) { }
+
+  void operator () () {
+    Posterior pdf_post;
+    ConvertPosteriorToPdfs(trans_model_, post_, &pdf_post);
+    for (size_t i = 0; i < pdf_post.size(); i++) {
+      size_t num_kept = 0;
+      for (size_t j = 0; j < pdf_post[i].size(); j++) {
+        BaseFloat weight = RandPrune(pdf_post[i][j].second, rand_prune_);
+        if (weight != 0.0)
+          pdf_post[i][num_kept++] = std::make_pair(pdf_post[i][j].first,
+                                                   weight);
+      }
+      pdf_post[i].resize(num_kept);
+    }
+    lda_->Accumulate(feats_, pdf_post);
+  }
+  ~LdaAccTask() { }  // the destructor doesn't have to do anything.
+ private:
+  const TransitionModel &trans_model_;
+  Matrix<BaseFloat> feats_;  // not a reference, since features come from a
+                             // Table and the reference we get from that is
+                             // not valid long-term.
+  Posterior post_;  // as above.
+  BaseFloat rand_prune_;
+  LdaEstimate *lda_;
+};
+
+}  // namespace kaldi
 
 /** @brief Accumulate LDA statistics based on pdf-ids. Inputs are the
 source models, that serve as the input (and may potentially contain
@@ -35,16 +78,19 @@ int main(int argc, char *argv[]) {
   try {
     const char *usage =
         "Accumulate LDA statistics based on pdf-ids.\n"
+        "Supports multiple threads (--num-threads).\n"
         "Usage:  acc-lda [options] <transition-gmm/model> <features-rspecifier> <posteriors-rspecifier> <lda-acc-out>\n"
         "Typical usage:\n"
         " ali-to-post ark:1.ali ark:- | lda-acc 1.mdl \"ark:splice-feats scp:train.scp|\"  ark:- ldaacc.1\n";
 
     bool binary = true;
     BaseFloat rand_prune = 0.0;
+    TaskSequencerConfig sequencer_opts;
     ParseOptions po(usage);
     po.Register("binary", &binary, "Write accumulators in binary mode.");
     po.Register("rand-prune", &rand_prune,
                 "Randomized pruning threshold for posteriors");
+    sequencer_opts.Register(&po);
     po.Read(argc, argv);
 
     if (po.NumArgs() != 4) {
@@ -71,47 +117,41 @@ int main(int argc, char *argv[]) {
     RandomAccessPosteriorReader posterior_reader(posteriors_rspecifier);
 
     int32 num_done = 0, num_fail = 0;
-    for (;!feature_reader.Done(); feature_reader.Next()) {
-      std::string utt = feature_reader.Key();
-      if (!posterior_reader.HasKey(utt)) {
-        KALDI_WARN << "No posteriors for utterance " << utt;
-        num_fail++;
-        continue;
-      }
-      const Posterior &post (posterior_reader.Value(utt));
-      const Matrix<BaseFloat> &feats(feature_reader.Value());
-
-      if (lda.Dim() == 0)
-        lda.Init(trans_model.NumPdfs(), feats.NumCols());
+    {
+      TaskSequencer<LdaAccTask> sequencer(sequencer_opts);
+      for (;!feature_reader.Done(); feature_reader.Next()) {
+        std::string utt = feature_reader.Key();
+        if (!posterior_reader.HasKey(utt)) {
+          KALDI_WARN << "No posteriors for utterance " << utt;
+          num_fail++;
+          continue;
+        }
+        const Posterior &post (posterior_reader.Value(utt));
+        const Matrix<BaseFloat> &feats(feature_reader.Value());
 
-      if (feats.NumRows() != static_cast<int32>(post.size())) {
-        KALDI_WARN << "Posterior vs. feats size mismatch "
-                   << feats.NumRows() << " vs. " <<post.size();
-        num_fail++;
-        continue;
-      }
-      if (lda.Dim() != 0 && lda.Dim() != feats.NumCols()) {
-        KALDI_WARN << "Feature dimension mismatch " << lda.Dim()
-                   << " vs. " << feats.NumCols();
-        num_fail++;
-        continue;
-      }
+        if (lda.Dim() == 0)
+          lda.Init(trans_model.NumPdfs(), feats.NumCols());
 
-      Posterior pdf_post;
-      ConvertPosteriorToPdfs(trans_model, post, &pdf_post);
-      for (int32 i = 0; i < feats.NumRows(); i++) {
-        SubVector<BaseFloat> feat(feats, i);
-        for (size_t j = 0; j < pdf_post[i].size(); j++) {
-          int32 pdf_id = pdf_post[i][j].first;
-          BaseFloat weight = RandPrune(pdf_post[i][j].second, rand_prune);
-          if (weight != 0.0) {
-            lda.Accumulate(feat, pdf_id, weight);
-          }
+        if (feats.NumRows() != static_cast<int32>(post.size())) {
+          KALDI_WARN << "Posterior vs. feats size mismatch "
+                     << feats.NumRows() << " vs. " <<post.size();
+          num_fail++;
+          continue;
         }
+        if (lda.Dim() != 0 && lda.Dim() != feats.NumCols()) {
+          KALDI_WARN << "Feature dimension mismatch " << lda.Dim()
+                     << " vs. " << feats.NumCols();
+          num_fail++;
+          continue;
+        }
+
+        sequencer.Run(new LdaAccTask(trans_model, feats, post, rand_prune,
+                                     &lda));
+        num_done++;
+        if (num_done % 100 == 0)
+          KALDI_LOG << "Done " << num_done << " utterances.";
       }
-      num_done++;
-      if (num_done % 100 == 0)
-        KALDI_LOG << "Done " << num_done << " utterances.";
+      // destructor of "sequencer" will wait for any remaining tasks.
     }
 
     KALDI_LOG << "Done " << num_done << " files, failed for "
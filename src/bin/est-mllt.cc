@@ -41,6 +41,9 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     po.Register("binary", &binary, "Write output in binary mode");
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads, "Number of threads to use in "
+                "inverting the statistics");
 
     po.Read(argc, argv);
 
@@ -62,7 +65,7 @@ int main(int argc, char *argv[]) {
     Matrix<BaseFloat> mat(mllt_accs.Dim(), mllt_accs.Dim());
     mat.SetUnit();
     BaseFloat objf_impr, count;
-    mllt_accs.Update(&mat, &objf_impr, &count);
+    mllt_accs.Update(&mat, &objf_impr, &count, num_threads);
 
     KALDI_LOG << "Overall objective function improvement for MLLT is "
               << (objf_impr/count) << " over " << count << " frames, logdet is "
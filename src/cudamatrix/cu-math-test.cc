@@ -18,6 +18,7 @@
 // limitations under the License.
 
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <cstdlib>
@@ -139,6 +140,120 @@ static void UnitTestCuMathSplice() {
   }
 }
 
+template<typename Real>
+static void UnitTestCuMathLstmStep() {
+  int32 S = 1 + Rand() % 10, C = 1 + Rand() % 50;
+  CuVector<Real> pi(C), pf(C), po(C);
+  pi.SetRandn();
+  pf.SetRandn();
+  po.SetRandn();
+  CuMatrix<Real> prev_y(S, 7 * C), y(S, 7 * C), next_y(S, 7 * C),
+      next_d(S, 7 * C), d(S, 7 * C);
+  prev_y.SetRandn();
+  y.SetRandn();
+  y.Scale(3.0);
+  next_y.SetRandn();
+  next_d.SetRandn();
+  d.SetRandn();
+
+  // the reference computation, one operation at a time.
+  CuMatrix<Real> y_ref(y);
+  CuSubMatrix<Real> y_g(y_ref.ColRange(0 * C, C)), y_i(y_ref.ColRange(1 * C, C)),
+      y_f(y_ref.ColRange(2 * C, C)), y_o(y_ref.ColRange(3 * C, C)),
+      y_c(y_ref.ColRange(4 * C, C)), y_h(y_ref.ColRange(5 * C, C)),
+      y_m(y_ref.ColRange(6 * C, C));
+  CuSubMatrix<Real> prev_c(prev_y.ColRange(4 * C, C));
+  y_i.AddMatDiagVec(1.0, prev_c, kNoTrans, pi, 1.0);
+  y_f.AddMatDiagVec(1.0, prev_c, kNoTrans, pf, 1.0);
+  y_i.Sigmoid(y_i);
+  y_f.Sigmoid(y_f);
+  y_g.Tanh(y_g);
+  y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
+  y_c.AddMatMatElements(1.0, prev_c, y_f, 1.0);
+  y_c.ApplyFloor(-50);
+  y_c.ApplyCeiling(50);
+  y_h.Tanh(y_c);
+  y_o.AddMatDiagVec(1.0, y_c, kNoTrans, po, 1.0);
+  y_o.Sigmoid(y_o);
+  y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+
+  cu::LstmStepForward(pi, pf, po, prev_y, &y);
+  AssertEqual(y, y_ref);
+
+  CuMatrix<Real> d_ref(d);
+  CuSubMatrix<Real> d_g(d_ref.ColRange(0 * C, C)), d_i(d_ref.ColRange(1 * C, C)),
+      d_f(d_ref.ColRange(2 * C, C)), d_o(d_ref.ColRange(3 * C, C)),
+      d_c(d_ref.ColRange(4 * C, C)), d_h(d_ref.ColRange(5 * C, C)),
+      d_m(d_ref.ColRange(6 * C, C));
+  d_h.AddMatMatElements(1.0, d_m, y_o, 0.0);
+  d_h.DiffTanh(y_h, d_h);
+  d_o.AddMatMatElements(1.0, d_m, y_h, 0.0);
+  d_o.DiffSigmoid(y_o, d_o);
+  d_c.CopyFromMat(d_h);
+  d_c.AddMatMatElements(1.0, next_d.ColRange(4 * C, C),
+                        next_y.ColRange(2 * C, C), 1.0);
+  d_c.AddMatDiagVec(1.0, next_d.ColRange(1 * C, C), kNoTrans, pi, 1.0);
+  d_c.AddMatDiagVec(1.0, next_d.ColRange(2 * C, C), kNoTrans, pf, 1.0);
+  d_c.AddMatDiagVec(1.0, d_o, kNoTrans, po, 1.0);
+  d_f.AddMatMatElements(1.0, d_c, prev_c, 0.0);
+  d_f.DiffSigmoid(y_f, d_f);
+  d_i.AddMatMatElements(1.0, d_c, y_g, 0.0);
+  d_i.DiffSigmoid(y_i, d_i);
+  d_g.AddMatMatElements(1.0, d_c, y_i, 0.0);
+  d_g.DiffTanh(y_g, d_g);
+
+  cu::LstmStepBackward(pi, pf, po, prev_y, y, next_y, next_d, &d);
+  AssertEqual(d, d_ref);
+}
+
+template<typename Real>
+static void UnitTestCuMathPatches() {
+  int32 T = 1 + Rand() % 20, D = 10 + Rand() % 30,
+      num_patches = 1 + Rand() % 5, patch_dim = 1 + Rand() % 10;
+  std::vector<std::vector<int32> > patch_columns(num_patches);
+  for (int32 p = 0; p < num_patches; p++) {
+    // a random subset of the columns, in random order.
+    std::vector<int32> cols(D);
+    for (int32 d = 0; d < D; d++) cols[d] = d;
+    std::random_shuffle(cols.begin(), cols.end());
+    patch_columns[p].assign(cols.begin(), cols.begin() + patch_dim);
+  }
+  std::vector<CuArray<int32> > forward_indexes, backward_indexes;
+  cu::ComputePatchIndexes(patch_columns, D, &forward_indexes,
+                          &backward_indexes);
+
+  CuMatrix<Real> in(T, D), patches(num_patches * T, patch_dim);
+  in.SetRandn();
+  cu::UnfoldPatches(in, forward_indexes, &patches);
+  for (int32 p = 0; p < num_patches; p++)
+    for (int32 t = 0; t < T; t++)
+      for (int32 k = 0; k < patch_dim; k++)
+        AssertEqual(patches(p * T + t, k), in(t, patch_columns[p][k]));
+
+  // FoldPatches() is the transpose of UnfoldPatches().
+  CuMatrix<Real> patches_deriv(num_patches * T, patch_dim),
+      in_deriv(T, D), in_deriv_ref(T, D);
+  patches_deriv.SetRandn();
+  cu::FoldPatches(patches_deriv, backward_indexes, &in_deriv);
+  for (int32 p = 0; p < num_patches; p++)
+    for (int32 k = 0; k < patch_dim; k++)
+      in_deriv_ref.ColRange(patch_columns[p][k], 1).AddMat(
+          1.0, patches_deriv.Range(p * T, T, k, 1));
+  AssertEqual(in_deriv, in_deriv_ref);
+
+  CuMatrix<Real> stacked(num_patches * T, D), unstacked(T, num_patches * D);
+  CuMatrix<Real> src(T, num_patches * D);
+  src.SetRandn();
+  cu::StackColumnBlocks(src, &stacked);
+  for (int32 p = 0; p < num_patches; p++) {
+    CuMatrix<Real> block(stacked.RowRange(p * T, T)),
+        block_ref(src.ColRange(p * D, D));
+    AssertEqual(block, block_ref);
+  }
+  cu::UnstackColumnBlocks(stacked, &unstacked);
+  AssertEqual(unstacked, src);
+}
+
 template<typename Real> void CudaMathUnitTest() {
   #if HAVE_CUDA == 1  
     if (CuDevice::Instantiate().DoublePrecisionSupported())
@@ -146,6 +261,8 @@ template<typename Real> void CudaMathUnitTest() {
   UnitTestCuMathRandomize<Real>();
   UnitTestCuMathSplice<Real>();
   UnitTestCuMathCopy<Real>();
+  UnitTestCuMathLstmStep<Real>();
+  UnitTestCuMathPatches<Real>();
 }
 
 
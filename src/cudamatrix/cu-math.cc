@@ -18,9 +18,11 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include "base/timer.h"
 #include "cudamatrix/cu-common.h"
 #include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-vector.h"
 #include "cudamatrix/cu-device.h"
 #include "cudamatrix/cu-kernels.h"
 
@@ -205,6 +207,240 @@ void Copy(const CuMatrixBase<Real> &src, const CuArray<int32> &copy_from_indices
   }
 }
 
+
+// The scalar nonlinearities used in the fused LSTM loops below; they are
+// written without branches so that the compiler can vectorize the loops.
+template<typename Real>
+static inline Real ScalarSigmoid(Real x) {
+  return 1.0 / (1.0 + Exp(-x));
+}
+
+template<typename Real>
+static inline Real ScalarTanh(Real x) {
+  return 2.0 / (1.0 + Exp(-(x + x))) - 1.0;
+}
+
+
+template<typename Real>
+void LstmStepForward(const CuVectorBase<Real> &peephole_i_c,
+                     const CuVectorBase<Real> &peephole_f_c,
+                     const CuVectorBase<Real> &peephole_o_c,
+                     const CuMatrixBase<Real> &prev_y,
+                     CuMatrixBase<Real> *y) {
+  int32 C = peephole_i_c.Dim();
+  KALDI_ASSERT(peephole_f_c.Dim() == C && peephole_o_c.Dim() == C);
+  KALDI_ASSERT(y->NumCols() == 7 * C && SameDim(prev_y, *y));
+
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    Timer tim;
+    CuSubMatrix<Real> y_g(y->ColRange(0 * C, C)), y_i(y->ColRange(1 * C, C)),
+        y_f(y->ColRange(2 * C, C)), y_o(y->ColRange(3 * C, C)),
+        y_c(y->ColRange(4 * C, C)), y_h(y->ColRange(5 * C, C)),
+        y_m(y->ColRange(6 * C, C));
+    const CuSubMatrix<Real> prev_c(prev_y.ColRange(4 * C, C));
+    y_i.AddMatDiagVec(1.0, prev_c, kNoTrans, peephole_i_c, 1.0);
+    y_f.AddMatDiagVec(1.0, prev_c, kNoTrans, peephole_f_c, 1.0);
+    y_i.Sigmoid(y_i);
+    y_f.Sigmoid(y_f);
+    y_g.Tanh(y_g);
+    y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
+    y_c.AddMatMatElements(1.0, prev_c, y_f, 1.0);
+    y_c.ApplyFloor(-50);
+    y_c.ApplyCeiling(50);
+    y_h.Tanh(y_c);
+    y_o.AddMatDiagVec(1.0, y_c, kNoTrans, peephole_o_c, 1.0);
+    y_o.Sigmoid(y_o);
+    y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+    CuDevice::Instantiate().AccuProfile(__func__, tim.Elapsed());
+  } else
+#endif
+  {
+    const Real *pi = peephole_i_c.Data(),
+        *pf = peephole_f_c.Data(),
+        *po = peephole_o_c.Data();
+    const MatrixBase<Real> &prev_mat = prev_y.Mat();
+    MatrixBase<Real> &mat = y->Mat();
+    for (MatrixIndexT r = 0; r < mat.NumRows(); r++) {
+      const Real *prev_c = prev_mat.RowData(r) + 4 * C;
+      Real *g = mat.RowData(r), *i = g + C, *f = g + 2 * C, *o = g + 3 * C,
+          *c = g + 4 * C, *h = g + 5 * C, *m = g + 6 * C;
+      for (int32 j = 0; j < C; j++) {
+        Real i_j = ScalarSigmoid(i[j] + pi[j] * prev_c[j]),
+            f_j = ScalarSigmoid(f[j] + pf[j] * prev_c[j]),
+            g_j = ScalarTanh(g[j]),
+            c_j = g_j * i_j + prev_c[j] * f_j;
+        // clipping of the cell activation, as in the Google paper
+        // (Interspeech 2014: LSTM for LVCSR).
+        c_j = std::min<Real>(std::max<Real>(c_j, -50.0), 50.0);
+        Real h_j = ScalarTanh(c_j),
+            o_j = ScalarSigmoid(o[j] + po[j] * c_j);
+        g[j] = g_j;
+        i[j] = i_j;
+        f[j] = f_j;
+        o[j] = o_j;
+        c[j] = c_j;
+        h[j] = h_j;
+        m[j] = h_j * o_j;
+      }
+    }
+  }
+}
+
+
+template<typename Real>
+void LstmStepBackward(const CuVectorBase<Real> &peephole_i_c,
+                      const CuVectorBase<Real> &peephole_f_c,
+                      const CuVectorBase<Real> &peephole_o_c,
+                      const CuMatrixBase<Real> &prev_y,
+                      const CuMatrixBase<Real> &y,
+                      const CuMatrixBase<Real> &next_y,
+                      const CuMatrixBase<Real> &next_d,
+                      CuMatrixBase<Real> *d) {
+  int32 C = peephole_i_c.Dim();
+  KALDI_ASSERT(peephole_f_c.Dim() == C && peephole_o_c.Dim() == C);
+  KALDI_ASSERT(y.NumCols() == 7 * C && SameDim(prev_y, y) &&
+               SameDim(next_y, y) && SameDim(next_d, y) && SameDim(*d, y));
+
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    Timer tim;
+    const CuSubMatrix<Real> y_g(y.ColRange(0 * C, C)), y_i(y.ColRange(1 * C, C)),
+        y_f(y.ColRange(2 * C, C)), y_o(y.ColRange(3 * C, C)),
+        y_h(y.ColRange(5 * C, C));
+    CuSubMatrix<Real> d_g(d->ColRange(0 * C, C)), d_i(d->ColRange(1 * C, C)),
+        d_f(d->ColRange(2 * C, C)), d_o(d->ColRange(3 * C, C)),
+        d_c(d->ColRange(4 * C, C)), d_h(d->ColRange(5 * C, C)),
+        d_m(d->ColRange(6 * C, C));
+    d_h.AddMatMatElements(1.0, d_m, y_o, 0.0);
+    d_h.DiffTanh(y_h, d_h);
+    d_o.AddMatMatElements(1.0, d_m, y_h, 0.0);
+    d_o.DiffSigmoid(y_o, d_o);
+    d_c.CopyFromMat(d_h);
+    d_c.AddMatMatElements(1.0, next_d.ColRange(4 * C, C),
+                          next_y.ColRange(2 * C, C), 1.0);
+    d_c.AddMatDiagVec(1.0, next_d.ColRange(1 * C, C), kNoTrans,
+                      peephole_i_c, 1.0);
+    d_c.AddMatDiagVec(1.0, next_d.ColRange(2 * C, C), kNoTrans,
+                      peephole_f_c, 1.0);
+    d_c.AddMatDiagVec(1.0, d_o, kNoTrans, peephole_o_c, 1.0);
+    d_f.AddMatMatElements(1.0, d_c, prev_y.ColRange(4 * C, C), 0.0);
+    d_f.DiffSigmoid(y_f, d_f);
+    d_i.AddMatMatElements(1.0, d_c, y_g, 0.0);
+    d_i.DiffSigmoid(y_i, d_i);
+    d_g.AddMatMatElements(1.0, d_c, y_i, 0.0);
+    d_g.DiffTanh(y_g, d_g);
+    CuDevice::Instantiate().AccuProfile(__func__, tim.Elapsed());
+  } else
+#endif
+  {
+    const Real *pi = peephole_i_c.Data(),
+        *pf = peephole_f_c.Data(),
+        *po = peephole_o_c.Data();
+    const MatrixBase<Real> &prev_mat = prev_y.Mat(), &y_mat = y.Mat(),
+        &next_y_mat = next_y.Mat(), &next_d_mat = next_d.Mat();
+    MatrixBase<Real> &d_mat = d->Mat();
+    for (MatrixIndexT r = 0; r < d_mat.NumRows(); r++) {
+      const Real *prev_c = prev_mat.RowData(r) + 4 * C,
+          *g = y_mat.RowData(r), *i = g + C, *f = g + 2 * C, *o = g + 3 * C,
+          *h = g + 5 * C,
+          *next_f = next_y_mat.RowData(r) + 2 * C,
+          *next_di = next_d_mat.RowData(r) + C,
+          *next_df = next_d_mat.RowData(r) + 2 * C,
+          *next_dc = next_d_mat.RowData(r) + 4 * C;
+      Real *d_g = d_mat.RowData(r), *d_i = d_g + C, *d_f = d_g + 2 * C,
+          *d_o = d_g + 3 * C, *d_c = d_g + 4 * C, *d_h = d_g + 5 * C,
+          *d_m = d_g + 6 * C;
+      for (int32 j = 0; j < C; j++) {
+        Real d_h_j = d_m[j] * o[j] * (1.0 - h[j] * h[j]),
+            d_o_j = d_m[j] * h[j] * o[j] * (1.0 - o[j]),
+            d_c_j = d_h_j + next_dc[j] * next_f[j] + next_di[j] * pi[j] +
+                    next_df[j] * pf[j] + d_o_j * po[j];
+        d_h[j] = d_h_j;
+        d_o[j] = d_o_j;
+        d_c[j] = d_c_j;
+        d_f[j] = d_c_j * prev_c[j] * f[j] * (1.0 - f[j]);
+        d_i[j] = d_c_j * g[j] * i[j] * (1.0 - i[j]);
+        d_g[j] = d_c_j * i[j] * (1.0 - g[j] * g[j]);
+      }
+    }
+  }
+}
+
+
+void ComputePatchIndexes(const std::vector<std::vector<int32> > &patch_columns,
+                         int32 input_dim,
+                         std::vector<CuArray<int32> > *forward_indexes,
+                         std::vector<CuArray<int32> > *backward_indexes) {
+  int32 num_patches = patch_columns.size();
+  forward_indexes->resize(num_patches);
+  backward_indexes->resize(num_patches);
+  std::vector<int32> reverse(input_dim);
+  for (int32 p = 0; p < num_patches; p++) {
+    const std::vector<int32> &columns = patch_columns[p];
+    std::fill(reverse.begin(), reverse.end(), -1);
+    for (size_t k = 0; k < columns.size(); k++) {
+      int32 c = columns[k];
+      KALDI_ASSERT(c >= 0 && c < input_dim);
+      if (reverse[c] != -1)
+        KALDI_ERR << "Column " << c << " appears twice in patch " << p;
+      reverse[c] = k;
+    }
+    (*forward_indexes)[p].CopyFromVec(columns);
+    (*backward_indexes)[p].CopyFromVec(reverse);
+  }
+}
+
+
+template<typename Real>
+void UnfoldPatches(const CuMatrixBase<Real> &in,
+                   const std::vector<CuArray<int32> > &forward_indexes,
+                   CuMatrixBase<Real> *patches) {
+  int32 num_rows = in.NumRows(), num_patches = forward_indexes.size();
+  KALDI_ASSERT(patches->NumRows() == num_patches * num_rows);
+  for (int32 p = 0; p < num_patches; p++) {
+    CuSubMatrix<Real> patch(patches->RowRange(p * num_rows, num_rows));
+    patch.CopyCols(in, forward_indexes[p]);
+  }
+}
+
+
+template<typename Real>
+void FoldPatches(const CuMatrixBase<Real> &patches_deriv,
+                 const std::vector<CuArray<int32> > &backward_indexes,
+                 CuMatrixBase<Real> *in_deriv) {
+  int32 num_rows = in_deriv->NumRows(), num_patches = backward_indexes.size();
+  KALDI_ASSERT(patches_deriv.NumRows() == num_patches * num_rows);
+  for (int32 p = 0; p < num_patches; p++)
+    in_deriv->AddCols(patches_deriv.RowRange(p * num_rows, num_rows),
+                      backward_indexes[p]);
+}
+
+
+template<typename Real>
+void StackColumnBlocks(const CuMatrixBase<Real> &src, CuMatrixBase<Real> *dst) {
+  int32 num_rows = src.NumRows(), block_dim = dst->NumCols(),
+      num_blocks = dst->NumRows() / num_rows;
+  KALDI_ASSERT(dst->NumRows() == num_blocks * num_rows &&
+               src.NumCols() == num_blocks * block_dim);
+  for (int32 b = 0; b < num_blocks; b++)
+    dst->RowRange(b * num_rows, num_rows).CopyFromMat(
+        src.ColRange(b * block_dim, block_dim));
+}
+
+
+template<typename Real>
+void UnstackColumnBlocks(const CuMatrixBase<Real> &src, CuMatrixBase<Real> *dst) {
+  int32 num_rows = dst->NumRows(), block_dim = src.NumCols(),
+      num_blocks = src.NumRows() / num_rows;
+  KALDI_ASSERT(src.NumRows() == num_blocks * num_rows &&
+               dst->NumCols() == num_blocks * block_dim);
+  for (int32 b = 0; b < num_blocks; b++)
+    dst->ColRange(b * block_dim, block_dim).CopyFromMat(
+        src.RowRange(b * num_rows, num_rows));
+}
+
+
 // instantiate the templates.
 template
 void RegularizeL1(CuMatrixBase<float> *weight, CuMatrixBase<float> *grad, float l1, float lr);
@@ -233,6 +469,63 @@ void Randomize(const CuMatrixBase<double> &src,
                const CuArray<int32> &copy_from_idx,
                CuMatrixBase<double> *tgt);
 
+template
+void LstmStepForward(const CuVectorBase<float> &peephole_i_c,
+                     const CuVectorBase<float> &peephole_f_c,
+                     const CuVectorBase<float> &peephole_o_c,
+                     const CuMatrixBase<float> &prev_y,
+                     CuMatrixBase<float> *y);
+template
+void LstmStepForward(const CuVectorBase<double> &peephole_i_c,
+                     const CuVectorBase<double> &peephole_f_c,
+                     const CuVectorBase<double> &peephole_o_c,
+                     const CuMatrixBase<double> &prev_y,
+                     CuMatrixBase<double> *y);
+template
+void LstmStepBackward(const CuVectorBase<float> &peephole_i_c,
+                      const CuVectorBase<float> &peephole_f_c,
+                      const CuVectorBase<float> &peephole_o_c,
+                      const CuMatrixBase<float> &prev_y,
+                      const CuMatrixBase<float> &y,
+                      const CuMatrixBase<float> &next_y,
+                      const CuMatrixBase<float> &next_d,
+                      CuMatrixBase<float> *d);
+template
+void LstmStepBackward(const CuVectorBase<double> &peephole_i_c,
+                      const CuVectorBase<double> &peephole_f_c,
+                      const CuVectorBase<double> &peephole_o_c,
+                      const CuMatrixBase<double> &prev_y,
+                      const CuMatrixBase<double> &y,
+                      const CuMatrixBase<double> &next_y,
+                      const CuMatrixBase<double> &next_d,
+                      CuMatrixBase<double> *d);
+
+template
+void UnfoldPatches(const CuMatrixBase<float> &in,
+                   const std::vector<CuArray<int32> > &forward_indexes,
+                   CuMatrixBase<float> *patches);
+template
+void FoldPatches(const CuMatrixBase<float> &patches_deriv,
+                 const std::vector<CuArray<int32> > &backward_indexes,
+                 CuMatrixBase<float> *in_deriv);
+template
+void StackColumnBlocks(const CuMatrixBase<float> &src, CuMatrixBase<float> *dst);
+template
+void UnstackColumnBlocks(const CuMatrixBase<float> &src, CuMatrixBase<float> *dst);
+
+template
+void UnfoldPatches(const CuMatrixBase<double> &in,
+                   const std::vector<CuArray<int32> > &forward_indexes,
+                   CuMatrixBase<double> *patches);
+template
+void FoldPatches(const CuMatrixBase<double> &patches_deriv,
+                 const std::vector<CuArray<int32> > &backward_indexes,
+                 CuMatrixBase<double> *in_deriv);
+template
+void StackColumnBlocks(const CuMatrixBase<double> &src, CuMatrixBase<double> *dst);
+template
+void UnstackColumnBlocks(const CuMatrixBase<double> &src, CuMatrixBase<double> *dst);
+
 
 
 } //namespace cu
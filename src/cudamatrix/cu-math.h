@@ -22,6 +22,7 @@
 
 #ifndef KALDI_CUDAMATRIX_CU_MATH_H_
 #define KALDI_CUDAMATRIX_CU_MATH_H_
+#include <vector>
 #include "cudamatrix/cu-common.h"
 #include "cudamatrix/cu-array.h"
 #include "cudamatrix/cu-device.h"
@@ -73,6 +74,77 @@ void Copy(const CuMatrixBase<Real> &src,
           const CuArray<int32> &copy_from_indices,
           CuMatrixBase<Real> *tgt);
 
+/// LstmStepForward does the non-recurrent part of one time-step of an LSTM
+/// with peephole connections (as in nnet1's LstmProjectedStreams), i.e.
+/// everything except the matrix multiplications.  "y" and "prev_y" have one
+/// row per stream and 7*C columns, where C is the number of cells, laid out as
+/// [ g i f o c h m ].  On input, the first 4*C columns of y contain the
+/// pre-activations of g, i, f, o (the input, recurrent and bias terms); on
+/// output, y contains all the activations.  Only the c part of prev_y (the
+/// cell at the previous time-step) is used.  On the CPU this is a single pass
+/// over the data, rather than one pass per operation.
+template<typename Real>
+void LstmStepForward(const CuVectorBase<Real> &peephole_i_c,
+                     const CuVectorBase<Real> &peephole_f_c,
+                     const CuVectorBase<Real> &peephole_o_c,
+                     const CuMatrixBase<Real> &prev_y,
+                     CuMatrixBase<Real> *y);
+
+/// LstmStepBackward is the backward pass corresponding to LstmStepForward.
+/// "d" has the same layout as y; on input its m part contains the derivative
+/// w.r.t. m, and on output it contains the derivatives w.r.t. all of
+/// g, i, f, o, c, h, m (the ones for g, i, f, o are w.r.t. the
+/// pre-activations).  "prev_y" and "y" are the activations at the previous
+/// and current time-steps; "next_y" and "next_d" are the activations and
+/// derivatives at the following time-step (zero at the end of the sequence),
+/// through which the cell derivative flows back.
+template<typename Real>
+void LstmStepBackward(const CuVectorBase<Real> &peephole_i_c,
+                      const CuVectorBase<Real> &peephole_f_c,
+                      const CuVectorBase<Real> &peephole_o_c,
+                      const CuMatrixBase<Real> &prev_y,
+                      const CuMatrixBase<Real> &y,
+                      const CuMatrixBase<Real> &next_y,
+                      const CuMatrixBase<Real> &next_d,
+                      CuMatrixBase<Real> *d);
+
+/// This is used by the convolutional components to unfold their input into
+/// patches ("im2col") and to fold the derivatives back.  "patch_columns[p]"
+/// lists the columns of the input that form patch p (no column may appear
+/// twice in the same patch).  Outputs "forward_indexes", for UnfoldPatches(),
+/// and "backward_indexes", for FoldPatches(); both have one element per
+/// patch.
+void ComputePatchIndexes(const std::vector<std::vector<int32> > &patch_columns,
+                         int32 input_dim,
+                         std::vector<CuArray<int32> > *forward_indexes,
+                         std::vector<CuArray<int32> > *backward_indexes);
+
+/// Copies the patches of "in" into "patches", one block of rows per patch:
+/// row p * in.NumRows() + t of "patches" is patch p of row t of "in".  This
+/// lets us apply the filters to all patches with one matrix multiplication.
+/// "patches" must have forward_indexes.size() * in.NumRows() rows.
+template<typename Real>
+void UnfoldPatches(const CuMatrixBase<Real> &in,
+                   const std::vector<CuArray<int32> > &forward_indexes,
+                   CuMatrixBase<Real> *patches);
+
+/// The transpose of UnfoldPatches(): adds the derivatives w.r.t. the patches
+/// to the derivative w.r.t. the input.
+template<typename Real>
+void FoldPatches(const CuMatrixBase<Real> &patches_deriv,
+                 const std::vector<CuArray<int32> > &backward_indexes,
+                 CuMatrixBase<Real> *in_deriv);
+
+/// Puts the blocks of "block_dim" = dst->NumCols() columns of "src" below
+/// each other in "dst": dst.RowRange(b * R, R) = src.ColRange(b * block_dim,
+/// block_dim), where R = src.NumRows().
+template<typename Real>
+void StackColumnBlocks(const CuMatrixBase<Real> &src, CuMatrixBase<Real> *dst);
+
+/// The inverse of StackColumnBlocks().
+template<typename Real>
+void UnstackColumnBlocks(const CuMatrixBase<Real> &src, CuMatrixBase<Real> *dst);
+
 
 } // namespace cu
 } // namespace kaldi
@@ -221,10 +221,10 @@ template<typename Real> void TestCuMatrixSigmoid(int32 dim) {
 }
 
 
-template<typename Real> void TestCuMatrixMulRowsGroupMat(int32 dim) {
+template<typename Real> void TestCuMatrixMulRowsGroupMat(int32 dim,
+                                                          int32 group_size) {
   BaseFloat time_in_secs = 0.025;
 
-  int32 group_size = 5;
   CuMatrix<Real> M(dim, dim * group_size), N(dim, dim);
   M.SetRandn();
   N.SetRandn();
@@ -237,7 +237,34 @@ template<typename Real> void TestCuMatrixMulRowsGroupMat(int32 dim) {
   BaseFloat fdim = dim;
   BaseFloat gflops = (fdim * fdim * group_size * iter) / (tim.Elapsed() * 1.0e+09);
   KALDI_LOG << "For CuMatrix::MulRowsGroupMat" << NameOf<Real>() << ", for dim = "
-            << dim << ", speed was " << gflops << " gigaflops.";
+            << dim << ", group size " << group_size
+            << ", speed was " << gflops << " gigaflops.";
+}
+
+template<typename Real> void TestCuMatrixSumColumnRanges(int32 dim,
+                                                         int32 group_size) {
+  BaseFloat time_in_secs = 0.025;
+  // consecutive groups, as in SumGroupComponent.
+  CuMatrix<Real> M(dim, dim * group_size), N(dim, dim);
+  M.SetRandn();
+  std::vector<Int32Pair> indexes(dim);
+  for (int32 i = 0; i < dim; i++) {
+    indexes[i].first = i * group_size;
+    indexes[i].second = (i + 1) * group_size;
+  }
+  CuArray<Int32Pair> indexes_cuda(indexes);
+
+  Timer tim;
+  int32 iter = 0;
+  for (; tim.Elapsed() < time_in_secs; iter++) {
+    N.SumColumnRanges(M, indexes_cuda);
+  }
+
+  BaseFloat fdim = dim;
+  BaseFloat gflops = (fdim * fdim * group_size * iter) / (tim.Elapsed() * 1.0e+09);
+  KALDI_LOG << "For CuMatrix::SumColumnRanges" << NameOf<Real>() << ", for dim = "
+            << dim << ", group size " << group_size
+            << ", speed was " << gflops << " gigaflops.";
 }
 
 
@@ -277,44 +304,51 @@ template<typename Real> void TestCuMatrixLogSoftmax(int32 dim) {
 }
 
 
-template<typename Real> void TestCuMatrixGroupPnorm(int32 dim) {
+template<typename Real> void TestCuMatrixGroupPnorm(int32 dim,
+                                                     int32 group_size,
+                                                     Real power) {
   BaseFloat time_in_secs = 0.025;
-  int32 group_size = 4;
-  CuMatrix<Real> M(dim, dim), N(dim, dim / group_size);
+  int32 num_groups = dim / group_size;
+  CuMatrix<Real> M(dim, num_groups * group_size), N(dim, num_groups);
   M.SetRandn();
   Timer tim;
   int32 iter = 0;
   for (;tim.Elapsed() < time_in_secs; iter++)
-    N.GroupPnorm(M, 2.0);
+    N.GroupPnorm(M, power);
 
   BaseFloat fdim = dim;
-  BaseFloat gflops = (fdim * fdim * iter) / (tim.Elapsed() * 1.0e+09);
+  BaseFloat gflops = (fdim * M.NumCols() * iter) / (tim.Elapsed() * 1.0e+09);
   KALDI_LOG << "For CuMatrix::GroupPnorm" << NameOf<Real>() << ", for dim = "
-            << dim << ", speed was " << gflops << " gigaflops.";
+            << dim << ", group-size = " << group_size << ", power = "
+            << power << ", speed was " << gflops << " gigaflops.";
 }
 
-template<typename Real> void TestCuMatrixGroupPnormDeriv(int32 dim) {
+template<typename Real> void TestCuMatrixGroupPnormDeriv(int32 dim,
+                                                         int32 group_size,
+                                                         Real power) {
   BaseFloat time_in_secs = 0.025;
-  int32 group_size = 4;
-  CuMatrix<Real> M(dim, dim), N(dim, dim / group_size), O(dim, dim);
+  int32 num_groups = dim / group_size;
+  CuMatrix<Real> M(dim, num_groups * group_size), N(dim, num_groups),
+      O(dim, num_groups * group_size);
   M.SetRandn();
-  N.GroupPnorm(M, 2.0);  
+  N.GroupPnorm(M, power);
   Timer tim;
   int32 iter = 0;
 
   for (;tim.Elapsed() < time_in_secs; iter++)
-    O.GroupPnormDeriv(M, N, 2.0);
+    O.GroupPnormDeriv(M, N, power);
 
   BaseFloat fdim = dim;
-  BaseFloat gflops = (fdim * fdim * iter) / (tim.Elapsed() * 1.0e+09);
+  BaseFloat gflops = (fdim * M.NumCols() * iter) / (tim.Elapsed() * 1.0e+09);
   KALDI_LOG << "For CuMatrix::GroupPnormDeriv" << NameOf<Real>() << ", for dim = "
-            << dim << ", speed was " << gflops << " gigaflops.";
+            << dim << ", group-size = " << group_size << ", power = "
+            << power << ", speed was " << gflops << " gigaflops.";
 }
 
-template<typename Real> void TestCuMatrixGroupMax(int32 dim) {
+template<typename Real> void TestCuMatrixGroupMax(int32 dim, int32 group_size) {
   BaseFloat time_in_secs = 0.025;
-  int32 group_size = 4;
-  CuMatrix<Real> M(dim, dim), N(dim, dim / group_size);
+  int32 num_groups = dim / group_size;
+  CuMatrix<Real> M(dim, num_groups * group_size), N(dim, num_groups);
   M.SetRandn();
   Timer tim;
   int32 iter = 0;
@@ -322,15 +356,18 @@ template<typename Real> void TestCuMatrixGroupMax(int32 dim) {
     N.GroupMax(M);
 
   BaseFloat fdim = dim;
-  BaseFloat gflops = (fdim * fdim * iter) / (tim.Elapsed() * 1.0e+09);
+  BaseFloat gflops = (fdim * M.NumCols() * iter) / (tim.Elapsed() * 1.0e+09);
   KALDI_LOG << "For CuMatrix::GroupMax" << NameOf<Real>() << ", for dim = "
-            << dim << ", speed was " << gflops << " gigaflops.";
+            << dim << ", group-size = " << group_size << ", speed was "
+            << gflops << " gigaflops.";
 }
 
-template<typename Real> void TestCuMatrixGroupMaxDeriv(int32 dim) {
+template<typename Real> void TestCuMatrixGroupMaxDeriv(int32 dim,
+                                                       int32 group_size) {
   BaseFloat time_in_secs = 0.025;
-  int32 group_size = 4;
-  CuMatrix<Real> M(dim, dim), N(dim, dim / group_size), O(dim, dim);
+  int32 num_groups = dim / group_size;
+  CuMatrix<Real> M(dim, num_groups * group_size), N(dim, num_groups),
+      O(dim, num_groups * group_size);
   M.SetRandn();
   N.GroupMax(M);
   Timer tim;
@@ -340,9 +377,10 @@ template<typename Real> void TestCuMatrixGroupMaxDeriv(int32 dim) {
     O.GroupMaxDeriv(M, N);
 
   BaseFloat fdim = dim;
-  BaseFloat gflops = (fdim * fdim * iter) / (tim.Elapsed() * 1.0e+09);
+  BaseFloat gflops = (fdim * M.NumCols() * iter) / (tim.Elapsed() * 1.0e+09);
   KALDI_LOG << "For CuMatrix::GroupMaxDeriv" << NameOf<Real>() << ", for dim = "
-            << dim << ", speed was " << gflops << " gigaflops.";
+            << dim << ", group-size = " << group_size << ", speed was "
+            << gflops << " gigaflops.";
 }
 
 template<typename Real> void TestCuMatrixTraceMatMat(int32 dim) {
@@ -709,20 +747,30 @@ template<typename Real> void CudaMatrixSpeedTest() {
     TestCuFindRowMaxId<Real>(sizes[s]);
   for (int32 s = 0; s < ns; s++)
     TestCuMatrixCompObjfAndDeriv<Real>(sizes[s]);
-  for (int32 s = 0; s < ns; s++)
-    TestCuMatrixMulRowsGroupMat<Real>(sizes[s]);
   for (int32 s = 0; s < ns; s++)
     TestCuMatrixSoftmax<Real>(sizes[s]);
   for (int32 s = 0; s < ns; s++)
     TestCuMatrixLogSoftmax<Real>(sizes[s]);
-  for (int32 s = 0; s < ns; s++)
-    TestCuMatrixGroupPnorm<Real>(sizes[s]);
-  for (int32 s = 0; s < ns; s++)
-    TestCuMatrixGroupPnormDeriv<Real>(sizes[s]);
-  for (int32 s = 0; s < ns; s++)
-    TestCuMatrixGroupMax<Real>(sizes[s]);
-  for (int32 s = 0; s < ns; s++)
-    TestCuMatrixGroupMaxDeriv<Real>(sizes[s]);
+  // the group sizes and powers typically used in the p-norm, maxout and
+  // sum-group networks.
+  int32 group_sizes[] = { 2, 4, 5, 10 };
+  Real powers[] = { 1.0, 2.0 };
+  for (int32 g = 0; g < 4; g++) {
+    for (int32 p = 0; p < 2; p++) {
+      for (int32 s = 0; s < ns; s++)
+        TestCuMatrixGroupPnorm<Real>(sizes[s], group_sizes[g], powers[p]);
+      for (int32 s = 0; s < ns; s++)
+        TestCuMatrixGroupPnormDeriv<Real>(sizes[s], group_sizes[g], powers[p]);
+    }
+    for (int32 s = 0; s < ns; s++)
+      TestCuMatrixGroupMax<Real>(sizes[s], group_sizes[g]);
+    for (int32 s = 0; s < ns; s++)
+      TestCuMatrixGroupMaxDeriv<Real>(sizes[s], group_sizes[g]);
+    for (int32 s = 0; s < ns; s++)
+      TestCuMatrixMulRowsGroupMat<Real>(sizes[s], group_sizes[g]);
+    for (int32 s = 0; s < ns; s++)
+      TestCuMatrixSumColumnRanges<Real>(sizes[s], group_sizes[g]);
+  }
   for (int32 s = 0; s < ns; s++)
     TestCuMatrixTraceMatMat<Real>(sizes[s]);
   for (int32 s = 0; s < ns; s++)
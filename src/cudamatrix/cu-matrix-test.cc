@@ -569,7 +569,18 @@ static void UnitTestCuMatrixSumColumnRanges() {
     Matrix<Real> src(num_rows, num_cols1);
     Matrix<Real> dst(num_rows, num_cols2);
     std::vector<Int32Pair> indices(num_cols2);
-    for (int32 i = 0; i < num_cols2; i++) {
+    if (p == 1) {
+      // consecutive groups of the same size, as in SumGroupComponent; this
+      // has its own code path.
+      int32 group_size = 1 + Rand() % 10;
+      num_cols1 = num_cols2 * group_size;
+      src.Resize(num_rows, num_cols1);
+      for (int32 i = 0; i < num_cols2; i++) {
+        indices[i].first = i * group_size;
+        indices[i].second = (i + 1) * group_size;
+      }
+    }
+    for (int32 i = 0; i < num_cols2 && p == 0; i++) {
       indices[i].first = Rand() % num_cols1;
       int32 headroom = num_cols1 - indices[i].first,
         size = (Rand() % headroom) + 1;
@@ -2124,6 +2124,21 @@ void CuMatrixBase<Real>::AddToRows(Real alpha,
 }
 
 
+// Sums consecutive groups of columns of one row, for SumColumnRanges().  G is
+// the group size if it is known at compile time, or 0 if it is only known at
+// run time; see also the helpers of GroupPnorm() in ../matrix/kaldi-matrix.cc.
+template<typename Real, int G>
+static void SumGroupsRow(const Real *src, int32 num_groups, int32 group_size,
+                         Real *dest) {
+  const int32 gs = (G > 0 ? G : group_size);
+  for (int32 j = 0; j < num_groups; j++, src += gs) {
+    Real sum = 0.0;
+    for (int32 k = 0; k < gs; k++)
+      sum += src[k];
+    dest[j] = sum;
+  }
+}
+
 template<typename Real>
 void CuMatrixBase<Real>::SumColumnRanges(const CuMatrixBase<Real> &src,
                                          const CuArray<Int32Pair> &indices) {
@@ -2148,14 +2163,37 @@ void CuMatrixBase<Real>::SumColumnRanges(const CuMatrixBase<Real> &src,
     Real *data = this->data_;
     const Real *src_data = src.data_;
     const Int32Pair *indices_data = indices.Data();
-    for (int32 row = 0; row < num_rows; row++) {
-      for (int32 col = 0; col < num_cols; col++) {
-        int32 start_col = indices_data[col].first,
-                end_col = indices_data[col].second;
-        Real sum = 0.0;
-        for (int32 src_col = start_col; src_col < end_col; src_col++)
-          sum += src_data[row * src_stride + src_col];
-        data[row * this_stride + col] = sum;
+    // SumGroupComponent usually sums consecutive groups of the same size, in
+    // which case we can use a loop with the group size known at compile time.
+    int32 group_size = (num_cols > 0 ?
+                        indices_data[0].second - indices_data[0].first : 0);
+    bool regular = true;
+    for (int32 col = 0; col < num_cols && regular; col++)
+      regular = (indices_data[col].first == col * group_size &&
+                 indices_data[col].second == (col + 1) * group_size);
+    for (int32 row = 0; row < num_rows;
+         row++, data += this_stride, src_data += src_stride) {
+      if (!regular) {
+        for (int32 col = 0; col < num_cols; col++) {
+          int32 start_col = indices_data[col].first,
+                  end_col = indices_data[col].second;
+          Real sum = 0.0;
+          for (int32 src_col = start_col; src_col < end_col; src_col++)
+            sum += src_data[src_col];
+          data[col] = sum;
+        }
+        continue;
+      }
+      switch (group_size) {
+        case 2: SumGroupsRow<Real, 2>(src_data, num_cols, group_size, data);
+          break;
+        case 4: SumGroupsRow<Real, 4>(src_data, num_cols, group_size, data);
+          break;
+        case 5: SumGroupsRow<Real, 5>(src_data, num_cols, group_size, data);
+          break;
+        case 10: SumGroupsRow<Real, 10>(src_data, num_cols, group_size, data);
+          break;
+        default: SumGroupsRow<Real, 0>(src_data, num_cols, group_size, data);
       }
     }
   }
@@ -704,6 +704,15 @@ class CuSubMatrix: public CuMatrixBase<Real> {
   inline CuSubMatrix<Real> (const CuSubMatrix &other):
   CuMatrixBase<Real> (other.data_, other.num_rows_, other.num_cols_,
                       other.stride_) {}
+
+  /// This constructor wraps memory that the matrix does not own, e.g. data
+  /// used in place in a MappedInput.  "data" must be on the GPU if we are
+  /// using one; it must not be changed through this object if it is const.
+  inline CuSubMatrix(const Real *data,
+                     const MatrixIndexT num_rows,
+                     const MatrixIndexT num_cols,
+                     const MatrixIndexT stride):
+  CuMatrixBase<Real> (const_cast<Real*>(data), num_rows, num_cols, stride) {}
  private:
   /// Disallow assignment.
   CuSubMatrix<Real> &operator = (const CuSubMatrix<Real> &other);
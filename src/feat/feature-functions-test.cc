@@ -29,6 +29,113 @@
 // TODO: some of the other functions should be tested.  
 namespace kaldi {
 
+// The previous implementation of SlidingWindowCmn(), which copied the
+// features to double precision and used the matrix and vector operations; the
+// current one should give the same output.
+void SlidingWindowCmnReference(const SlidingWindowCmnOptions &opts,
+                               const MatrixBase<BaseFloat> &input_float,
+                               MatrixBase<BaseFloat> *output_float) {
+  Matrix<double> input(input_float), output(input.NumRows(), input.NumCols());
+  int32 num_frames = input.NumRows(), dim = input.NumCols();
+
+  int32 last_window_start = -1, last_window_end = -1;
+  Vector<double> cur_sum(dim), cur_sumsq(dim);
+
+  for (int32 t = 0; t < num_frames; t++) {
+    int32 window_start, window_end;
+    if (opts.center) {
+      window_start = t - (opts.cmn_window / 2);
+      window_end = window_start + opts.cmn_window;
+    } else {
+      window_start = t - opts.cmn_window;
+      window_end = t + 1;
+    }
+    if (window_start < 0) {
+      window_end -= window_start;
+      window_start = 0;
+    }
+    if (!opts.center) {
+      if (window_end > t)
+        window_end = std::max(t + 1, opts.min_window);
+    }
+    if (window_end > num_frames) {
+      window_start -= (window_end - num_frames);
+      window_end = num_frames;
+      if (window_start < 0) window_start = 0;
+    }
+    if (last_window_start == -1) {
+      SubMatrix<double> input_part(input,
+                                   window_start, window_end - window_start,
+                                   0, dim);
+      cur_sum.AddRowSumMat(1.0, input_part , 0.0);
+      if (opts.normalize_variance)
+        cur_sumsq.AddDiagMat2(1.0, input_part, kTrans, 0.0);
+    } else {
+      if (window_start > last_window_start) {
+        SubVector<double> frame_to_remove(input, last_window_start);
+        cur_sum.AddVec(-1.0, frame_to_remove);
+        if (opts.normalize_variance)
+          cur_sumsq.AddVec2(-1.0, frame_to_remove);
+      }
+      if (window_end > last_window_end) {
+        SubVector<double> frame_to_add(input, last_window_end);
+        cur_sum.AddVec(1.0, frame_to_add);
+        if (opts.normalize_variance)
+          cur_sumsq.AddVec2(1.0, frame_to_add);
+      }
+    }
+    int32 window_frames = window_end - window_start;
+    last_window_start = window_start;
+    last_window_end = window_end;
+
+    SubVector<double> input_frame(input, t),
+        output_frame(output, t);
+    output_frame.CopyFromVec(input_frame);
+    output_frame.AddVec(-1.0 / window_frames, cur_sum);
+
+    if (opts.normalize_variance) {
+      if (window_frames == 1) {
+        output_frame.Set(0.0);
+      } else {
+        Vector<double> variance(cur_sumsq);
+        variance.Scale(1.0 / window_frames);
+        variance.AddVec2(-1.0 / (window_frames * window_frames), cur_sum);
+        variance.ApplyFloor(1.0e-10);
+        variance.ApplyPow(-0.5);
+        output_frame.MulElements(variance);
+      }
+    }
+  }
+  output_float->CopyFromMat(output);
+}
+
+void UnitTestSlidingWindowCmnReference() {
+  for (int32 i = 0; i < 200; i++) {
+    int32 num_frames = 1 + Rand() % 500, dim = 1 + Rand() % 40;
+    SlidingWindowCmnOptions opts;
+    opts.center = (Rand() % 2 == 0);
+    opts.normalize_variance = (Rand() % 2 == 0);
+    opts.cmn_window = 1 + Rand() % 300;
+    opts.min_window = 1 + Rand() % opts.cmn_window;
+    Matrix<BaseFloat> feats(num_frames, dim), output(num_frames, dim),
+        ref_output(num_frames, dim);
+    feats.SetRandn();
+    feats.Add(10.0);  // so the running sums are not all near zero.
+    SlidingWindowCmn(opts, feats, &output);
+    SlidingWindowCmnReference(opts, feats, &ref_output);
+    // The two differ only in rounding: the previous version computed the
+    // inverse standard deviation with pow() instead of sqrt().
+    for (int32 t = 0; t < num_frames; t++)
+      for (int32 d = 0; d < dim; d++)
+        KALDI_ASSERT(std::abs(output(t, d) - ref_output(t, d)) <=
+                     1.0e-06 * std::max<BaseFloat>(1.0, std::abs(output(t, d))));
+    // In-place use gives the same output.
+    Matrix<BaseFloat> in_place(feats);
+    SlidingWindowCmn(opts, in_place, &in_place);
+    KALDI_ASSERT(in_place.ApproxEqual(output, 0.0));
+  }
+}
+
 void UnitTestOnlineCmvn() {
   for (int32 i = 0; i < 1000; i++) {
     int32 num_frames = 1 + (Rand() % 10 * 10);
@@ -101,6 +208,7 @@ int main() {
   using namespace kaldi;
   try {
     UnitTestOnlineCmvn();
+    UnitTestSlidingWindowCmnReference();
     std::cout << "Tests succeeded.\n";
     return 0;
   } catch (const std::exception &e) {
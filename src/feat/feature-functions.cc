@@ -432,60 +432,92 @@ void SlidingWindowCmnOptions::Check() const {
   // else ignored so value doesn't matter.
 }
 
-// Internal version of SlidingWindowCmn with double-precision arguments.
-void SlidingWindowCmnInternal(const SlidingWindowCmnOptions &opts,
-                              const MatrixBase<double> &input,
-                              MatrixBase<double> *output) {
+// Works out the window [*window_start, *window_end) that we use to normalize
+// frame t; see the documentation of the options.
+static void GetCmnWindow(const SlidingWindowCmnOptions &opts,
+                         int32 t, int32 num_frames,
+                         int32 *window_start, int32 *window_end) {
+  if (opts.center) {
+    *window_start = t - (opts.cmn_window / 2);
+    *window_end = *window_start + opts.cmn_window;
+  } else {
+    *window_start = t - opts.cmn_window;
+    *window_end = t + 1;
+  }
+  if (*window_start < 0) { // shift window right if starts <0.
+    *window_end -= *window_start;
+    *window_start = 0;
+  }
+  if (!opts.center) {
+    if (*window_end > t)
+      *window_end = std::max(t + 1, opts.min_window);
+  }
+  if (*window_end > num_frames) {
+    *window_start -= (*window_end - num_frames);
+    *window_end = num_frames;
+    if (*window_start < 0) *window_start = 0;
+  }
+}
+
+void SlidingWindowCmn(const SlidingWindowCmnOptions &opts,
+                      const MatrixBase<BaseFloat> &input,
+                      MatrixBase<BaseFloat> *output) {
+  KALDI_ASSERT(SameDim(input, *output) && input.NumRows() > 0);
   opts.Check();
   int32 num_frames = input.NumRows(), dim = input.NumCols();
+  // We read input rows after writing earlier output rows, so if the input and
+  // output overlap (e.g. in-place use), we have to work from a copy.
+  const BaseFloat *input_begin = input.Data(),
+      *input_end = input.RowData(num_frames - 1) + dim,
+      *output_begin = output->Data(),
+      *output_end = output->RowData(num_frames - 1) + dim;
+  if (input_begin < output_end && output_begin < input_end) {
+    Matrix<BaseFloat> input_copy(input);
+    SlidingWindowCmn(opts, input_copy, output);
+    return;
+  }
 
+  // The window moves by at most one frame at each end from one frame to the
+  // next, so we keep running sums (in double precision) of the features and
+  // their squares over the window, which makes the cost per frame O(dim)
+  // however long the window is.  We work directly on the rows of the input
+  // and output, without any temporary matrices or per-frame allocation.
   int32 last_window_start = -1, last_window_end = -1;
   Vector<double> cur_sum(dim), cur_sumsq(dim);
+  double *sum = cur_sum.Data(), *sumsq = cur_sumsq.Data();
+  bool normalize_variance = opts.normalize_variance;
 
   for (int32 t = 0; t < num_frames; t++) {
     int32 window_start, window_end; // note: window_end will be one
     // past the end of the window we use for normalization.
-    if (opts.center) {
-      window_start = t - (opts.cmn_window / 2);
-      window_end = window_start + opts.cmn_window;
-    } else {
-      window_start = t - opts.cmn_window;
-      window_end = t + 1;
-    }
-    if (window_start < 0) { // shift window right if starts <0.
-      window_end -= window_start;
-      window_start = 0; // or: window_start -= window_start
-    }
-    if (!opts.center) {
-      if (window_end > t)
-        window_end = std::max(t + 1, opts.min_window);
-    }
-    if (window_end > num_frames) {
-      window_start -= (window_end - num_frames);
-      window_end = num_frames;
-      if (window_start < 0) window_start = 0;
-    }
+    GetCmnWindow(opts, t, num_frames, &window_start, &window_end);
     if (last_window_start == -1) {
-      SubMatrix<double> input_part(input,
-                                      window_start, window_end - window_start,
-                                      0, dim);
-      cur_sum.AddRowSumMat(1.0, input_part , 0.0);
-      if (opts.normalize_variance)
-        cur_sumsq.AddDiagMat2(1.0, input_part, kTrans, 0.0);
+      for (int32 t2 = window_start; t2 < window_end; t2++) {
+        const BaseFloat *frame = input.RowData(t2);
+        for (int32 d = 0; d < dim; d++) {
+          double f = frame[d];
+          sum[d] += f;
+          sumsq[d] += f * f;
+        }
+      }
     } else {
       if (window_start > last_window_start) {
         KALDI_ASSERT(window_start == last_window_start + 1);
-        SubVector<double> frame_to_remove(input, last_window_start);
-        cur_sum.AddVec(-1.0, frame_to_remove);
-        if (opts.normalize_variance)
-          cur_sumsq.AddVec2(-1.0, frame_to_remove);
+        const BaseFloat *frame = input.RowData(last_window_start);
+        for (int32 d = 0; d < dim; d++) {
+          double f = frame[d];
+          sum[d] -= f;
+          sumsq[d] -= f * f;
+        }
       }
       if (window_end > last_window_end) {
         KALDI_ASSERT(window_end == last_window_end + 1);
-        SubVector<double> frame_to_add(input, last_window_end);
-        cur_sum.AddVec(1.0, frame_to_add);
-        if (opts.normalize_variance)
-          cur_sumsq.AddVec2(1.0, frame_to_add);
+        const BaseFloat *frame = input.RowData(last_window_end);
+        for (int32 d = 0; d < dim; d++) {
+          double f = frame[d];
+          sum[d] += f;
+          sumsq[d] += f * f;
+        }
       }
     }
     int32 window_frames = window_end - window_start;
@@ -493,43 +525,66 @@ void SlidingWindowCmnInternal(const SlidingWindowCmnOptions &opts,
     last_window_end = window_end;
 
     KALDI_ASSERT(window_frames > 0);
-    SubVector<double> input_frame(input, t),
-        output_frame(*output, t);
-    output_frame.CopyFromVec(input_frame);
-    output_frame.AddVec(-1.0 / window_frames, cur_sum);
-
-    if (opts.normalize_variance) {
-      if (window_frames == 1) {
-        output_frame.Set(0.0);
-      } else {
-        Vector<double> variance(cur_sumsq);
-        variance.Scale(1.0 / window_frames);
-        variance.AddVec2(-1.0 / (window_frames * window_frames), cur_sum);
-        // now "variance" is the variance of the features in the window,
-        // around their own mean.
-        int32 num_floored = variance.ApplyFloor(1.0e-10);
-        if (num_floored > 0 && num_frames > 1) {
-          KALDI_WARN << "Flooring variance When normalizing variance, floored " << num_floored
-                     << " elements; num-frames was " << window_frames;
+    const BaseFloat *input_frame = input.RowData(t);
+    BaseFloat *output_frame = output->RowData(t);
+    double mean_scale = -1.0 / window_frames;
+    if (!normalize_variance) {
+      for (int32 d = 0; d < dim; d++)
+        output_frame[d] = input_frame[d] + mean_scale * sum[d];
+    } else if (window_frames == 1) {
+      for (int32 d = 0; d < dim; d++)
+        output_frame[d] = 0.0;
+    } else {
+      double var_scale = 1.0 / window_frames,
+          mean_sq_scale = -1.0 / (window_frames * window_frames);
+      int32 num_floored = 0;
+      for (int32 d = 0; d < dim; d++) {
+        // "variance" is the variance of the features in the window, around
+        // their own mean.
+        double variance = sumsq[d] * var_scale + mean_sq_scale * sum[d] * sum[d];
+        if (variance < 1.0e-10) {
+          variance = 1.0e-10;
+          num_floored++;
         }
-        variance.ApplyPow(-0.5); // get inverse standard deviation.
-        output_frame.MulElements(variance);
+        output_frame[d] = (input_frame[d] + mean_scale * sum[d]) /
+            std::sqrt(variance);
+      }
+      if (num_floored > 0 && num_frames > 1) {
+        KALDI_WARN << "Flooring variance When normalizing variance, floored " << num_floored
+                   << " elements; num-frames was " << window_frames;
       }
     }
   }
 }
 
-
-void SlidingWindowCmn(const SlidingWindowCmnOptions &opts,
-                      const MatrixBase<BaseFloat> &input,
-                      MatrixBase<BaseFloat> *output) {
-  KALDI_ASSERT(SameDim(input, *output) && input.NumRows() > 0);
-  Matrix<double> input_dbl(input), output_dbl(input.NumRows(), input.NumCols());
-  // calll double-precision version
-  SlidingWindowCmnInternal(opts, input_dbl, &output_dbl);
-  output->CopyFromMat(output_dbl);
+void WriteFeatures(const std::string &utt,
+                   uint16 htk_parm_kind,
+                   bool subtract_mean,
+                   const std::string &output_format,
+                   Matrix<BaseFloat> *features,
+                   BaseFloatMatrixWriter *kaldi_writer,
+                   TableWriter<HtkMatrixHolder> *htk_writer) {
+  if (subtract_mean) {
+    Vector<BaseFloat> mean(features->NumCols());
+    mean.AddRowSumMat(1.0, *features);
+    mean.Scale(1.0 / features->NumRows());
+    features->AddVecToRows(-1.0, mean);
+  }
+  if (output_format == "kaldi") {
+    kaldi_writer->Write(utt, *features);
+  } else {
+    std::pair<Matrix<BaseFloat>, HtkHeader> p;
+    p.first.Resize(features->NumRows(), features->NumCols());
+    p.first.CopyFromMat(*features);
+    HtkHeader header = {
+      features->NumRows(),
+      100000,  // 10ms shift
+      static_cast<int16>(sizeof(float) * features->NumCols()),
+      htk_parm_kind
+    };
+    p.second = header;
+    htk_writer->Write(utt, p);
+  }
 }
 
-
-
 }  // namespace kaldi
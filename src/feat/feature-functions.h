@@ -339,12 +339,25 @@ struct SlidingWindowCmnOptions {
 /// Applies sliding-window cepstral mean and/or variance normalization.  See the
 /// strings registering the options in the options class for information on how
 /// this works and what the options are.  input and output must have the same
-/// dimension.
+/// dimension; they may be the same matrix.
 void SlidingWindowCmn(const SlidingWindowCmnOptions &opts,
                       const MatrixBase<BaseFloat> &input,
                       MatrixBase<BaseFloat> *output);
 
 
+/// Used by compute-mfcc-feats and similar programs: subtracts the mean of the
+/// features if "subtract_mean" is true, and writes them to "kaldi_writer" if
+/// output_format == "kaldi", or else to "htk_writer" with an HTK header of
+/// parameter kind "htk_parm_kind" (e.g. 006 | 020000 for MFCC_0).
+void WriteFeatures(const std::string &utt,
+                   uint16 htk_parm_kind,
+                   bool subtract_mean,
+                   const std::string &output_format,
+                   Matrix<BaseFloat> *features,
+                   BaseFloatMatrixWriter *kaldi_writer,
+                   TableWriter<HtkMatrixHolder> *htk_writer);
+
+
 /// @} End of "addtogroup feat"
 }  // namespace kaldi
 
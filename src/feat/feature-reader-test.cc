@@ -0,0 +1,120 @@
+// feat/feature-reader-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <sstream>
+
+#include "feat/feature-reader.h"
+
+namespace kaldi {
+
+// Writes a few random recordings, and checks that the readers give the same
+// features as computing them directly, with and without the separate thread,
+// and from features as well as from the audio.
+void UnitTestFeatureReader() {
+  int32 num_utts = 1 + Rand() % 5;
+  std::vector<std::string> utts;
+  std::vector<Matrix<BaseFloat> > ref_feats;
+  MfccOptions mfcc_opts;
+  mfcc_opts.frame_opts.dither = 0.0;
+  Mfcc mfcc(mfcc_opts);
+  {
+    std::ofstream scp("tmp.scp");
+    for (int32 i = 0; i < num_utts; i++) {
+      std::ostringstream utt;
+      utt << "utt" << i;
+      // some of the recordings are too short to have any frames.
+      int32 num_samples = (Rand() % 5 == 0 ? 100 : 2000 + Rand() % 10000);
+      Matrix<BaseFloat> samples(1, num_samples);
+      for (int32 j = 0; j < num_samples; j++)
+        samples(0, j) = RandInt(-5000, 5000);
+      WaveData wave(mfcc_opts.frame_opts.samp_freq, samples);
+      std::string filename = "tmp." + utt.str() + ".wav";
+      std::ofstream os(filename.c_str(), std::ios::binary);
+      wave.Write(os);
+      scp << utt.str() << " " << filename << "\n";
+      Matrix<BaseFloat> feats;
+      mfcc.Compute(samples.Row(0), 1.0, &feats, NULL);
+      if (feats.NumRows() == 0)
+        continue;  // too short; the readers should skip it.
+      Matrix<BaseFloat> spliced;
+      SpliceFrames(feats, 1, 1, &spliced);
+      utts.push_back(utt.str());
+      ref_feats.push_back(spliced);
+    }
+  }
+  {
+    BaseFloatMatrixWriter writer("ark:tmp.ark");
+    for (size_t i = 0; i < utts.size(); i++)
+      writer.Write(utts[i], Matrix<BaseFloat>(ref_feats[i].ColRange(13, 13)));
+  }
+
+  {
+    std::ofstream os("tmp.conf");
+    os << "--dither=0\n";
+  }
+  FeatureReaderOptions opts;
+  opts.mfcc_config = "tmp.conf";
+  opts.feature_chain = "splice left-context=1 right-context=1";
+  for (int32 n = 0; n < 3; n++) {
+    std::string rspecifier = "ark:tmp.ark";
+    opts.feature_type = "";
+    opts.lookahead = Rand() % 3;
+    if (n > 0) {
+      rspecifier = "scp:tmp.scp";
+      opts.feature_type = "mfcc";
+    }
+    if (n < 2) {
+      SequentialFeatureReader reader(opts, rspecifier);
+      size_t i = 0;
+      for (; !reader.Done(); reader.Next(), i++) {
+        KALDI_ASSERT(i < utts.size() && reader.Key() == utts[i]);
+        AssertEqual(reader.Value(), ref_feats[i]);
+        if (Rand() % 10 == 0) break;  // check that we can stop early.
+      }
+      KALDI_ASSERT(i == utts.size() || !reader.Done());
+      // The recordings that were too short are counted as errors.
+      if (reader.Done())
+        KALDI_ASSERT(reader.NumErrors() ==
+                     (n == 0 ? 0 : num_utts - static_cast<int32>(utts.size())));
+    } else {
+      RandomAccessFeatureReader reader(opts, rspecifier);
+      for (int32 i = static_cast<int32>(utts.size()) - 1; i >= 0; i--) {
+        KALDI_ASSERT(reader.HasKey(utts[i]));
+        AssertEqual(reader.Value(utts[i]), ref_feats[i]);
+      }
+      KALDI_ASSERT(!reader.HasKey("foo"));
+    }
+  }
+  for (int32 i = 0; i < num_utts; i++) {
+    std::ostringstream filename;
+    filename << "tmp.utt" << i << ".wav";
+    unlink(filename.str().c_str());
+  }
+  unlink("tmp.scp");
+  unlink("tmp.ark");
+  unlink("tmp.conf");
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    UnitTestFeatureReader();
+  std::cout << "Tests succeeded.\n";
+}
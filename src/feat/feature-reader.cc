@@ -0,0 +1,360 @@
+// feat/feature-reader.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+
+#include "feat/feature-reader.h"
+
+namespace kaldi {
+
+FeatureProcessor::FeatureProcessor(const FeatureReaderOptions &opts):
+    opts_(opts), mfcc_(NULL), plp_(NULL), fbank_(NULL), samp_freq_(0.0),
+    have_chain_(!opts.feature_chain.empty()) {
+  if (opts_.feature_type == "mfcc") {
+    MfccOptions mfcc_opts;
+    if (opts_.mfcc_config != "")
+      ReadConfigFromFile(opts_.mfcc_config, &mfcc_opts);
+    mfcc_ = new Mfcc(mfcc_opts);
+    samp_freq_ = mfcc_opts.frame_opts.samp_freq;
+  } else if (opts_.feature_type == "plp") {
+    PlpOptions plp_opts;
+    if (opts_.plp_config != "")
+      ReadConfigFromFile(opts_.plp_config, &plp_opts);
+    plp_ = new Plp(plp_opts);
+    samp_freq_ = plp_opts.frame_opts.samp_freq;
+  } else if (opts_.feature_type == "fbank") {
+    FbankOptions fbank_opts;
+    if (opts_.fbank_config != "")
+      ReadConfigFromFile(opts_.fbank_config, &fbank_opts);
+    fbank_ = new Fbank(fbank_opts);
+    samp_freq_ = fbank_opts.frame_opts.samp_freq;
+  } else if (opts_.feature_type != "") {
+    KALDI_ERR << "Invalid feature type: " << opts_.feature_type << ". "
+              << "Supported feature types: mfcc, plp, fbank.";
+  }
+  if (opts_.add_pitch) {
+    if (!ComputesFromWave())
+      KALDI_ERR << "--add-pitch is only applicable with --feature-type";
+    if (opts_.pitch_config != "")
+      ReadConfigFromFile(opts_.pitch_config, &pitch_opts_);
+    if (opts_.pitch_process_config != "")
+      ReadConfigFromFile(opts_.pitch_process_config, &pitch_process_opts_);
+    if (pitch_opts_.samp_freq != samp_freq_)
+      KALDI_ERR << "Sample frequency mismatch between the pitch options ("
+                << pitch_opts_.samp_freq << ") and the feature options ("
+                << samp_freq_ << ")";
+  }
+  if (have_chain_) {
+    chain_.Init(opts_.feature_chain);
+    KALDI_LOG << "Feature transform chain is: " << chain_.Info();
+    if (chain_.NeedsCmvnStats() &&
+        (opts_.cmvn_rspecifier.empty() ||
+         !cmvn_reader_.Open(opts_.cmvn_rspecifier, opts_.utt2spk_rspecifier)))
+      KALDI_ERR << "The feature transform chain needs the CMVN stats; error "
+                << "opening '" << opts_.cmvn_rspecifier << "'";
+    if (chain_.NeedsFmllrTransform() &&
+        (opts_.fmllr_rspecifier.empty() ||
+         !fmllr_reader_.Open(opts_.fmllr_rspecifier,
+                             opts_.utt2spk_rspecifier)))
+      KALDI_ERR << "The feature transform chain needs the fMLLR transforms; "
+                << "error opening '" << opts_.fmllr_rspecifier << "'";
+  }
+}
+
+FeatureProcessor::~FeatureProcessor() {
+  delete mfcc_;
+  delete plp_;
+  delete fbank_;
+}
+
+bool FeatureProcessor::Compute(const std::string &utt, const WaveData &wave,
+                               Matrix<BaseFloat> *feats) {
+  KALDI_ASSERT(ComputesFromWave());
+  if (wave.SampFreq() != samp_freq_)
+    KALDI_ERR << "Sample frequency mismatch: you specified " << samp_freq_
+              << " but data has " << wave.SampFreq() << " (use "
+              << "--sample-frequency option in the feature config).  "
+              << "Utterance is " << utt;
+  int32 num_chan = wave.Data().NumRows();
+  if (num_chan != 1)
+    KALDI_WARN << "Utterance " << utt << " has " << num_chan
+               << " channels; using channel zero.";
+  SubVector<BaseFloat> waveform(wave.Data(), 0);
+  Matrix<BaseFloat> raw_feats;
+  try {
+    if (mfcc_ != NULL)
+      mfcc_->Compute(waveform, 1.0, &raw_feats, NULL);
+    else if (plp_ != NULL)
+      plp_->Compute(waveform, 1.0, &raw_feats, NULL);
+    else
+      fbank_->Compute(waveform, 1.0, &raw_feats, NULL);
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Failed to compute features for utterance " << utt << ": "
+               << e.what();
+    return false;
+  }
+  if (raw_feats.NumRows() == 0) {
+    KALDI_WARN << "Utterance " << utt << " is too short ("
+               << wave.Duration() << " sec) to have any frames.";
+    return false;
+  }
+  if (opts_.add_pitch) {
+    Matrix<BaseFloat> pitch;
+    try {
+      ComputeAndProcessKaldiPitch(pitch_opts_, pitch_process_opts_,
+                                  waveform, &pitch);
+    } catch (const std::exception &e) {
+      KALDI_WARN << "Failed to compute pitch for utterance " << utt << ": "
+                 << e.what();
+      return false;
+    }
+    // Append the pitch as paste-feats does.
+    int32 num_frames = std::min(raw_feats.NumRows(), pitch.NumRows()),
+        dim = raw_feats.NumCols();
+    if (std::max(raw_feats.NumRows(), pitch.NumRows()) - num_frames >
+        opts_.pitch_length_tolerance) {
+      KALDI_WARN << "Length mismatch " << raw_feats.NumRows() << " vs. "
+                 << pitch.NumRows() << " between the features and the pitch "
+                 << "for utterance " << utt;
+      return false;
+    }
+    Matrix<BaseFloat> with_pitch(num_frames, dim + pitch.NumCols(),
+                                 kUndefined);
+    with_pitch.ColRange(0, dim).CopyFromMat(raw_feats.RowRange(0, num_frames));
+    with_pitch.ColRange(dim, pitch.NumCols()).CopyFromMat(
+        pitch.RowRange(0, num_frames));
+    raw_feats.Swap(&with_pitch);
+  }
+  if (!have_chain_) {
+    feats->Swap(&raw_feats);
+    return true;
+  }
+  return Process(utt, raw_feats, feats);
+}
+
+bool FeatureProcessor::Process(const std::string &utt,
+                               const MatrixBase<BaseFloat> &input,
+                               Matrix<BaseFloat> *feats) {
+  if (!have_chain_) {
+    feats->Resize(input.NumRows(), input.NumCols(), kUndefined);
+    feats->CopyFromMat(input);
+    return true;
+  }
+  const Matrix<double> *cmvn_stats = NULL;
+  const Matrix<BaseFloat> *fmllr = NULL;
+  if (chain_.NeedsCmvnStats()) {
+    if (!cmvn_reader_.HasKey(utt)) {
+      KALDI_WARN << "No normalization statistics available for key "
+                 << utt << ", producing no features for this utterance";
+      return false;
+    }
+    cmvn_stats = &(cmvn_reader_.Value(utt));
+  }
+  if (chain_.NeedsFmllrTransform()) {
+    if (!fmllr_reader_.HasKey(utt)) {
+      KALDI_WARN << "No fMLLR transform available for utterance "
+                 << utt << ", producing no features for this utterance";
+      return false;
+    }
+    fmllr = &(fmllr_reader_.Value(utt));
+  }
+  chain_.Apply(input, cmvn_stats, fmllr, feats);
+  return true;
+}
+
+
+SequentialFeatureReader::SequentialFeatureReader(
+    const FeatureReaderOptions &opts, const std::string &rspecifier):
+    processor_(opts), queue_(NULL), stop_(false), producer_failed_(false),
+    current_(NULL), num_err_(0) {
+  if (processor_.ComputesFromWave()) {
+    if (!wave_reader_.Open(rspecifier))
+      KALDI_ERR << "Error opening wav rspecifier " << rspecifier;
+  } else {
+    if (!feature_reader_.Open(rspecifier))
+      KALDI_ERR << "Error opening features rspecifier " << rspecifier;
+  }
+  if (opts.lookahead > 0) {
+    queue_ = new BoundedQueue<Item*>(opts.lookahead);
+    int32 ret;
+    if ((ret = pthread_create(&thread_, NULL, RunProducer,
+                              static_cast<void*>(this)))) {
+      const char *c = strerror(ret);
+      KALDI_ERR << "Error creating thread, errno was: " << (c ? c : "[NULL]");
+    }
+  }
+  Next();
+}
+
+SequentialFeatureReader::~SequentialFeatureReader() {
+  delete current_;
+  if (queue_ != NULL) {
+    // Tell the thread to stop, and take what it has already computed so that
+    // it doesn't wait for space in the queue.
+    mutex_.Lock();
+    stop_ = true;
+    mutex_.Unlock();
+    Item *item = NULL;
+    while (queue_->Pop(&item))
+      delete item;
+    pthread_join(thread_, NULL);
+    delete queue_;
+  }
+}
+
+void SequentialFeatureReader::Next() {
+  delete current_;
+  current_ = NULL;
+  if (queue_ != NULL) {
+    if (!queue_->Pop(&current_)) {
+      current_ = NULL;
+      mutex_.Lock();
+      bool failed = producer_failed_;
+      std::string error = producer_error_;
+      mutex_.Unlock();
+      if (failed)
+        KALDI_ERR << "Error computing features: " << error;
+    }
+  } else {
+    current_ = ComputeNext();
+  }
+}
+
+const std::string &SequentialFeatureReader::Key() const {
+  KALDI_ASSERT(!Done());
+  return current_->key;
+}
+
+const Matrix<BaseFloat> &SequentialFeatureReader::Value() const {
+  KALDI_ASSERT(!Done());
+  return current_->feats;
+}
+
+void SequentialFeatureReader::FreeCurrent() {
+  KALDI_ASSERT(!Done());
+  current_->feats.Resize(0, 0);
+}
+
+SequentialFeatureReader::Item *SequentialFeatureReader::ComputeNext() {
+  Item *item = new Item;
+  if (processor_.ComputesFromWave()) {
+    for (; !wave_reader_.Done(); wave_reader_.Next()) {
+      item->key = wave_reader_.Key();
+      if (processor_.Compute(item->key, wave_reader_.Value(), &(item->feats))) {
+        wave_reader_.Next();
+        return item;
+      }
+      mutex_.Lock();
+      num_err_++;
+      mutex_.Unlock();
+    }
+  } else {
+    for (; !feature_reader_.Done(); feature_reader_.Next()) {
+      item->key = feature_reader_.Key();
+      if (processor_.Process(item->key, feature_reader_.Value(),
+                             &(item->feats))) {
+        feature_reader_.Next();
+        return item;
+      }
+      mutex_.Lock();
+      num_err_++;
+      mutex_.Unlock();
+    }
+  }
+  delete item;
+  return NULL;
+}
+
+int32 SequentialFeatureReader::NumErrors() const {
+  mutex_.Lock();
+  int32 ans = num_err_;
+  mutex_.Unlock();
+  return ans;
+}
+
+bool SequentialFeatureReader::Stopped() const {
+  mutex_.Lock();
+  bool ans = stop_;
+  mutex_.Unlock();
+  return ans;
+}
+
+void *SequentialFeatureReader::RunProducer(void *input) {
+  SequentialFeatureReader *me = static_cast<SequentialFeatureReader*>(input);
+  try {
+    while (!me->Stopped()) {
+      Item *item = me->ComputeNext();
+      if (item == NULL)
+        break;
+      if (!me->queue_->Push(item)) {
+        delete item;
+        break;
+      }
+    }
+  } catch (const std::exception &e) {
+    // Errors are reported by the thread that reads the features, when it gets
+    // to the end of the queue.
+    me->mutex_.Lock();
+    me->producer_error_ = e.what();
+    me->producer_failed_ = true;
+    me->mutex_.Unlock();
+  }
+  me->queue_->Close();
+  return NULL;
+}
+
+
+RandomAccessFeatureReader::RandomAccessFeatureReader(
+    const FeatureReaderOptions &opts, const std::string &rspecifier):
+    processor_(opts), ok_(false) {
+  if (processor_.ComputesFromWave()) {
+    if (!wave_reader_.Open(rspecifier))
+      KALDI_ERR << "Error opening wav rspecifier " << rspecifier;
+  } else {
+    if (!feature_reader_.Open(rspecifier))
+      KALDI_ERR << "Error opening features rspecifier " << rspecifier;
+  }
+}
+
+bool RandomAccessFeatureReader::HasKey(const std::string &key) {
+  return Compute(key);
+}
+
+const Matrix<BaseFloat> &RandomAccessFeatureReader::Value(
+    const std::string &key) {
+  if (!Compute(key))
+    KALDI_ERR << "Could not get features for utterance " << key;
+  return feats_;
+}
+
+bool RandomAccessFeatureReader::Compute(const std::string &key) {
+  if (key == key_)
+    return ok_;
+  key_ = key;
+  ok_ = false;
+  feats_.Resize(0, 0);
+  if (processor_.ComputesFromWave()) {
+    if (wave_reader_.HasKey(key))
+      ok_ = processor_.Compute(key, wave_reader_.Value(key), &feats_);
+  } else {
+    if (feature_reader_.HasKey(key))
+      ok_ = processor_.Process(key, feature_reader_.Value(key), &feats_);
+  }
+  return ok_;
+}
+
+}  // namespace kaldi
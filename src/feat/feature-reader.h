@@ -0,0 +1,253 @@
+// feat/feature-reader.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_FEAT_FEATURE_READER_H_
+#define KALDI_FEAT_FEATURE_READER_H_
+
+#include <pthread.h>
+#include <string>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "matrix/matrix-lib.h"
+#include "feat/feature-mfcc.h"
+#include "feat/feature-plp.h"
+#include "feat/feature-fbank.h"
+#include "feat/pitch-functions.h"
+#include "feat/feature-transform-chain.h"
+#include "feat/wave-reader.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-queue.h"
+
+namespace kaldi {
+/// @addtogroup  feat FeatureExtraction
+/// @{
+
+/// Options for SequentialFeatureReader and RandomAccessFeatureReader.  As for
+/// OnlineFeaturePipelineCommandLineConfig, the options of the feature
+/// computation are read from config files.
+struct FeatureReaderOptions {
+  // "mfcc", "plp" or "fbank" if we compute the features from the audio; empty
+  // if the input is features.
+  std::string feature_type;
+  std::string mfcc_config;
+  std::string plp_config;
+  std::string fbank_config;
+  bool add_pitch;
+  std::string pitch_config;
+  std::string pitch_process_config;
+  int32 pitch_length_tolerance;
+  // Config string for FeatureTransformChain, applied to the features.
+  std::string feature_chain;
+  std::string utt2spk_rspecifier;
+  std::string cmvn_rspecifier;
+  std::string fmllr_rspecifier;
+  // Number of utterances SequentialFeatureReader may compute ahead of the one
+  // being used, in a separate thread; 0 means no thread.
+  int32 lookahead;
+
+  FeatureReaderOptions(): add_pitch(false), pitch_length_tolerance(2),
+                          lookahead(0) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("feature-type", &feature_type, "If set, compute features "
+                   "of this type [mfcc, plp, fbank] from the audio, and the "
+                   "features rspecifier is instead a wav rspecifier.");
+    opts->Register("mfcc-config", &mfcc_config, "Configuration file for "
+                   "MFCC features (e.g. conf/mfcc.conf)");
+    opts->Register("plp-config", &plp_config, "Configuration file for "
+                   "PLP features (e.g. conf/plp.conf)");
+    opts->Register("fbank-config", &fbank_config, "Configuration file for "
+                   "filterbank features (e.g. conf/fbank.conf)");
+    opts->Register("add-pitch", &add_pitch, "Append pitch features to the "
+                   "features computed from the audio.");
+    opts->Register("pitch-config", &pitch_config, "Configuration file for "
+                   "pitch features (e.g. conf/pitch.conf)");
+    opts->Register("pitch-process-config", &pitch_process_config,
+                   "Configuration file for post-processing pitch features "
+                   "(e.g. conf/pitch_process.conf)");
+    opts->Register("pitch-length-tolerance", &pitch_length_tolerance,
+                   "Difference in number of frames between the pitch and the "
+                   "other features that we allow (as for paste-feats).");
+    opts->Register("feature-chain", &feature_chain, "Post-processing of the "
+                   "features, as for apply-feature-chain, e.g. 'cmvn; splice "
+                   "left-context=3 right-context=3; transform "
+                   "matrix=final.mat'");
+    opts->Register("utt2spk", &utt2spk_rspecifier, "rspecifier for utterance "
+                   "to speaker map, for the CMVN stats and fMLLR transforms "
+                   "of --feature-chain");
+    opts->Register("cmvn-stats", &cmvn_rspecifier, "rspecifier for the CMVN "
+                   "stats (needed if --feature-chain has a cmvn stage)");
+    opts->Register("fmllr", &fmllr_rspecifier, "rspecifier for the fMLLR "
+                   "transforms (needed if --feature-chain has a fmllr stage)");
+    opts->Register("feature-lookahead", &lookahead, "Number of utterances "
+                   "whose features we may compute ahead, in a separate thread "
+                   "(0 means no separate thread).");
+  }
+};
+
+
+/// FeatureProcessor gives the features of an utterance from its input: it
+/// computes them from the audio if FeatureReaderOptions::feature_type is set,
+/// and applies the FeatureTransformChain, if any.  It is used by the readers
+/// below.
+class FeatureProcessor {
+ public:
+  explicit FeatureProcessor(const FeatureReaderOptions &opts);
+
+  ~FeatureProcessor();
+
+  /// True if the input is audio rather than features.
+  bool ComputesFromWave() const { return !opts_.feature_type.empty(); }
+
+  /// Computes the features from the audio.  Returns false, with a warning, if
+  /// we could not compute features for this utterance.
+  bool Compute(const std::string &utt, const WaveData &wave,
+               Matrix<BaseFloat> *feats);
+
+  /// Applies the FeatureTransformChain (if any) to the features, and puts the
+  /// result in "feats".  Returns false, with a warning, if we could not.
+  bool Process(const std::string &utt, const MatrixBase<BaseFloat> &input,
+               Matrix<BaseFloat> *feats);
+
+ private:
+  FeatureReaderOptions opts_;
+  Mfcc *mfcc_;
+  Plp *plp_;
+  Fbank *fbank_;
+  BaseFloat samp_freq_;
+  PitchExtractionOptions pitch_opts_;
+  ProcessPitchOptions pitch_process_opts_;
+  bool have_chain_;
+  FeatureTransformChain chain_;
+  RandomAccessDoubleMatrixReaderMapped cmvn_reader_;
+  RandomAccessBaseFloatMatrixReaderMapped fmllr_reader_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FeatureProcessor);
+};
+
+
+/**
+   SequentialFeatureReader has the interface of SequentialBaseFloatMatrixReader,
+   and gives the features of the utterances of its input in order.  The input
+   is a features rspecifier, or, if the options set a feature type, a wav
+   rspecifier, and the features are computed from the audio, so that a program
+   such as a decoder can take the audio directly and no feature archives need
+   to be written.  The features may be post-processed by a
+   FeatureTransformChain, e.g. for CMVN, splicing and LDA.
+
+   If the "lookahead" option is positive, the input is read and the features
+   are computed in a separate thread, up to that many utterances ahead of the
+   one given by Value(), so this overlaps with whatever the program does with
+   the features.  Utterances we can't compute features for are skipped, with a
+   warning.
+*/
+class SequentialFeatureReader {
+ public:
+  SequentialFeatureReader(const FeatureReaderOptions &opts,
+                          const std::string &rspecifier);
+
+  ~SequentialFeatureReader();
+
+  bool Done() const { return (current_ == NULL); }
+
+  void Next();
+
+  const std::string &Key() const;
+
+  const Matrix<BaseFloat> &Value() const;
+
+  /// Frees the memory of the current features, as for the table readers.
+  void FreeCurrent();
+
+  /// The number of utterances of the input we could not give features for
+  /// so far.
+  int32 NumErrors() const;
+
+ private:
+  struct Item {
+    std::string key;
+    Matrix<BaseFloat> feats;
+  };
+
+  // Reads the input until we have the features of the next utterance; returns
+  // NULL if we reached the end of the input.
+  Item *ComputeNext();
+
+  // The function run by the thread that computes the features.
+  static void *RunProducer(void *input);
+
+  // True if the destructor has told the thread to stop.
+  bool Stopped() const;
+
+  FeatureProcessor processor_;
+  SequentialBaseFloatMatrixReader feature_reader_;
+  SequentialTableReader<WaveHolder> wave_reader_;
+
+  // If we have a separate thread, it gives us the utterances through this
+  // queue; NULL if not.
+  BoundedQueue<Item*> *queue_;
+  pthread_t thread_;
+  // Guards stop_, producer_failed_, producer_error_ and num_err_, which are
+  // shared with the thread.
+  mutable Mutex mutex_;
+  bool stop_;  // Tells the thread to stop early.
+  bool producer_failed_;  // Set if the thread caught an exception.
+  std::string producer_error_;
+
+  Item *current_;
+  int32 num_err_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SequentialFeatureReader);
+};
+
+
+/// RandomAccessFeatureReader has the interface of
+/// RandomAccessBaseFloatMatrixReader, for the same kind of input as
+/// SequentialFeatureReader.  The features of an utterance are computed when
+/// they are first asked for, and kept until we are asked for another one.
+class RandomAccessFeatureReader {
+ public:
+  RandomAccessFeatureReader(const FeatureReaderOptions &opts,
+                            const std::string &rspecifier);
+
+  /// True if the input has this utterance and we could compute its features.
+  bool HasKey(const std::string &key);
+
+  const Matrix<BaseFloat> &Value(const std::string &key);
+
+ private:
+  // Makes "feats_" the features of utterance "key"; returns false if we could
+  // not.
+  bool Compute(const std::string &key);
+
+  FeatureProcessor processor_;
+  RandomAccessBaseFloatMatrixReader feature_reader_;
+  RandomAccessTableReader<WaveHolder> wave_reader_;
+
+  std::string key_;  // The utterance we last computed features for.
+  bool ok_;  // True if we could compute features for key_.
+  Matrix<BaseFloat> feats_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(RandomAccessFeatureReader);
+};
+
+/// @} End of "addtogroup feat"
+}  // namespace kaldi
+
+#endif  // KALDI_FEAT_FEATURE_READER_H_
@@ -0,0 +1,138 @@
+// feat/feature-transform-chain-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+
+#include "feat/feature-transform-chain.h"
+#include "transform/cmvn.h"
+
+namespace kaldi {
+
+// Applies a linear or affine transform, as transform-feats does.
+static void ApplyTransformReference(const Matrix<BaseFloat> &transform,
+                                    Matrix<BaseFloat> *feats) {
+  int32 dim = feats->NumCols();
+  Matrix<BaseFloat> out(feats->NumRows(), transform.NumRows());
+  SubMatrix<BaseFloat> linear(transform, 0, transform.NumRows(), 0, dim);
+  out.AddMatMat(1.0, *feats, kNoTrans, linear, kTrans, 0.0);
+  if (transform.NumCols() == dim + 1) {
+    Vector<BaseFloat> offset(transform.NumRows());
+    offset.CopyColFromMat(transform, dim);
+    out.AddVecToRows(1.0, offset);
+  }
+  feats->Swap(&out);
+}
+
+static void RandomTransform(int32 rows, int32 cols, bool affine,
+                            Matrix<BaseFloat> *transform) {
+  transform->Resize(rows, cols + (affine ? 1 : 0));
+  transform->SetRandn();
+}
+
+// Compares the chain with doing the stages one by one, for random
+// combinations of the stages.
+void UnitTestFeatureTransformChain() {
+  int32 num_frames = 1 + Rand() % 50, dim = 1 + Rand() % 10;
+  bool use_cmvn = (Rand() % 2 == 0), norm_vars = (Rand() % 2 == 0),
+      use_deltas = (Rand() % 3 == 0), use_splice = (Rand() % 2 == 0),
+      use_lda = (Rand() % 2 == 0), use_mllt = (Rand() % 2 == 0),
+      use_fmllr = (Rand() % 2 == 0), use_subsample = (Rand() % 2 == 0);
+  int32 left_context = Rand() % 4, right_context = Rand() % 4,
+      n = 1 + Rand() % 3, offset = Rand() % 3;
+  DeltaFeaturesOptions delta_opts(1 + Rand() % 2, 1 + Rand() % 2);
+
+  Matrix<BaseFloat> feats(num_frames, dim);
+  feats.SetRandn();
+  Matrix<double> cmvn_stats;
+  InitCmvnStats(dim, &cmvn_stats);
+  {
+    Matrix<BaseFloat> other_feats(10 + Rand() % 10, dim);
+    other_feats.SetRandn();
+    AccCmvnStats(other_feats, NULL, &cmvn_stats);
+  }
+  Matrix<BaseFloat> ref(feats), fmllr;
+  std::ostringstream config;
+  if (use_cmvn) {
+    config << "cmvn norm-vars=" << (norm_vars ? "true" : "false") << "\n";
+    ApplyCmvn(cmvn_stats, norm_vars, &ref);
+  }
+  if (use_deltas) {
+    config << "deltas order=" << delta_opts.order << " window="
+           << delta_opts.window << "\n";
+    Matrix<BaseFloat> tmp;
+    ComputeDeltas(delta_opts, ref, &tmp);
+    ref.Swap(&tmp);
+  }
+  if (use_splice) {
+    config << "splice left-context=" << left_context << " right-context="
+           << right_context << "\n";
+    Matrix<BaseFloat> tmp;
+    SpliceFrames(ref, left_context, right_context, &tmp);
+    ref.Swap(&tmp);
+  }
+  if (use_lda) {
+    Matrix<BaseFloat> lda;
+    RandomTransform(1 + Rand() % 10, ref.NumCols(), (Rand() % 2 == 0), &lda);
+    WriteKaldiObject(lda, "tmp.lda.mat", (Rand() % 2 == 0));
+    config << "transform matrix=tmp.lda.mat\n";
+    ApplyTransformReference(lda, &ref);
+  }
+  if (use_mllt) {
+    Matrix<BaseFloat> mllt;
+    RandomTransform(ref.NumCols(), ref.NumCols(), (Rand() % 2 == 0), &mllt);
+    WriteKaldiObject(mllt, "tmp.mllt.mat", false);
+    config << "transform matrix=tmp.mllt.mat\n";
+    ApplyTransformReference(mllt, &ref);
+  }
+  if (use_fmllr) {
+    RandomTransform(ref.NumCols(), ref.NumCols(), (Rand() % 2 == 0), &fmllr);
+    config << "fmllr\n";
+    ApplyTransformReference(fmllr, &ref);
+  }
+  if (use_subsample) {
+    config << "subsample n=" << n << " offset=" << offset << "\n";
+    int32 num_frames_out = std::max(0, (num_frames - offset + n - 1) / n);
+    Matrix<BaseFloat> tmp;
+    if (num_frames_out > 0)
+      tmp.Resize(num_frames_out, ref.NumCols());
+    for (int32 i = 0; i < num_frames_out; i++)
+      tmp.Row(i).CopyFromVec(ref.Row(offset + i * n));
+    ref.Swap(&tmp);
+  }
+
+  FeatureTransformChain chain(config.str());
+  KALDI_LOG << "Chain is " << chain.Info();
+  KALDI_ASSERT(chain.NeedsCmvnStats() == use_cmvn &&
+               chain.NeedsFmllrTransform() == use_fmllr);
+  Matrix<BaseFloat> output;
+  chain.Apply(feats, (use_cmvn ? &cmvn_stats : NULL),
+              (use_fmllr ? &fmllr : NULL), &output);
+  KALDI_ASSERT(output.NumRows() == ref.NumRows() &&
+               output.NumCols() == ref.NumCols());
+  AssertEqual(output, ref, 0.001);
+  unlink("tmp.lda.mat");
+  unlink("tmp.mllt.mat");
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 50; i++)
+    UnitTestFeatureTransformChain();
+  std::cout << "Tests succeeded.\n";
+}
@@ -0,0 +1,419 @@
+// feat/feature-transform-chain.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+#include "feat/feature-transform-chain.h"
+#include "transform/cmvn.h"
+
+namespace kaldi {
+
+// Helpers for parsing the options of a stage, which are stored as name ->
+// value; each option is removed from the map when it is read, so that we can
+// detect unknown options.
+static void GetStageOption(const std::string &stage_name,
+                           const std::string &name,
+                           std::map<std::string, std::string> *opts,
+                           int32 *value) {
+  std::map<std::string, std::string>::iterator iter = opts->find(name);
+  if (iter == opts->end()) return;
+  if (!ConvertStringToInteger(iter->second, value))
+    KALDI_ERR << "Bad value '" << iter->second << "' for option " << name
+              << " of feature transform stage " << stage_name;
+  opts->erase(iter);
+}
+
+static void GetStageOption(const std::string &stage_name,
+                           const std::string &name,
+                           std::map<std::string, std::string> *opts,
+                           bool *value) {
+  std::map<std::string, std::string>::iterator iter = opts->find(name);
+  if (iter == opts->end()) return;
+  if (iter->second == "true") *value = true;
+  else if (iter->second == "false") *value = false;
+  else
+    KALDI_ERR << "Bad value '" << iter->second << "' for option " << name
+              << " of feature transform stage " << stage_name
+              << " (expected true or false)";
+  opts->erase(iter);
+}
+
+static void GetStageOption(const std::string &stage_name,
+                           const std::string &name,
+                           std::map<std::string, std::string> *opts,
+                           std::string *value) {
+  std::map<std::string, std::string>::iterator iter = opts->find(name);
+  if (iter == opts->end()) return;
+  *value = iter->second;
+  opts->erase(iter);
+}
+
+FeatureTransformChain::Stage FeatureTransformChain::ParseStage(
+    const std::string &line) {
+  std::vector<std::string> fields;
+  SplitStringToVector(line, " \t", true, &fields);
+  KALDI_ASSERT(!fields.empty());
+  const std::string &name = fields[0];
+  std::map<std::string, std::string> opts;
+  for (size_t i = 1; i < fields.size(); i++) {
+    size_t pos = fields[i].find('=');
+    if (pos == std::string::npos || pos == 0)
+      KALDI_ERR << "Bad option '" << fields[i] << "' in feature transform "
+                << "stage '" << line << "' (expected name=value)";
+    opts[fields[i].substr(0, pos)] = fields[i].substr(pos + 1);
+  }
+
+  Stage stage(kCmvn);
+  if (name == "cmvn") {
+    GetStageOption(name, "norm-vars", &opts, &stage.norm_vars);
+    GetStageOption(name, "reverse", &opts, &stage.reverse);
+  } else if (name == "splice") {
+    stage.type = kSplice;
+    stage.left_context = 4;
+    stage.right_context = 4;
+    GetStageOption(name, "left-context", &opts, &stage.left_context);
+    GetStageOption(name, "right-context", &opts, &stage.right_context);
+    if (stage.left_context < 0 || stage.right_context < 0)
+      KALDI_ERR << "Invalid context in feature transform stage '" << line
+                << "'";
+  } else if (name == "transform") {
+    stage.type = kTransform;
+    std::string rxfilename;
+    GetStageOption(name, "matrix", &opts, &rxfilename);
+    if (rxfilename.empty())
+      KALDI_ERR << "Feature transform stage '" << line << "' needs the "
+                << "matrix=<rxfilename> option";
+    ReadKaldiObject(rxfilename, &stage.linear);
+    // Whether the matrix is affine is only known once we know the input
+    // dimension; see ApplyTransform().
+    stage.offset.Resize(stage.linear.NumRows());
+  } else if (name == "fmllr") {
+    stage.type = kFmllr;
+  } else if (name == "deltas") {
+    stage.type = kDeltas;
+    GetStageOption(name, "order", &opts, &stage.delta_opts.order);
+    GetStageOption(name, "window", &opts, &stage.delta_opts.window);
+  } else if (name == "subsample") {
+    stage.type = kSubsample;
+    GetStageOption(name, "n", &opts, &stage.subsample_n);
+    GetStageOption(name, "offset", &opts, &stage.subsample_offset);
+    if (stage.subsample_n <= 0 || stage.subsample_offset < 0)
+      KALDI_ERR << "Invalid options in feature transform stage '" << line
+                << "' (n must be positive)";
+  } else {
+    KALDI_ERR << "Unknown feature transform stage '" << name << "'";
+  }
+  if (!opts.empty())
+    KALDI_ERR << "Unknown option '" << opts.begin()->first
+              << "' in feature transform stage '" << line << "'";
+  return stage;
+}
+
+void FeatureTransformChain::Init(const std::string &config) {
+  stages_.clear();
+  std::vector<std::string> lines;
+  SplitStringToVector(config, ";\n", true, &lines);
+  for (size_t i = 0; i < lines.size(); i++) {
+    std::string line = lines[i];
+    Trim(&line);
+    if (line.empty() || line[0] == '#') continue;
+    stages_.push_back(ParseStage(line));
+  }
+  FoldStages();
+  KALDI_VLOG(1) << "Feature transform chain is: " << Info();
+}
+
+bool FeatureTransformChain::IsFrameLevel(const Stage &stage) {
+  return stage.type == kCmvn || stage.type == kFmllr ||
+      (stage.type == kTransform && stage.left_context == 0 &&
+       stage.right_context == 0 && stage.subsample_n == 1 &&
+       stage.subsample_offset == 0);
+}
+
+void FeatureTransformChain::FoldStages() {
+  // Compose adjacent global transforms.  The offset of the first one may be
+  // hidden in an extra column of its matrix, which we don't know yet; but
+  // that is just multiplied by the following transforms like the rest of it.
+  for (size_t i = 0; i + 1 < stages_.size(); ) {
+    Stage &a = stages_[i];
+    const Stage &b = stages_[i + 1];
+    if (a.type != kTransform || b.type != kTransform) {
+      i++;
+      continue;
+    }
+    int32 dim = a.linear.NumRows();
+    if (b.linear.NumCols() != dim && b.linear.NumCols() != dim + 1)
+      KALDI_ERR << "Cannot compose transforms in feature transform chain: "
+                << "a transform with output dimension " << dim
+                << " is followed by one with " << b.linear.NumCols()
+                << " columns";
+    SubMatrix<BaseFloat> b_linear(b.linear, 0, b.linear.NumRows(), 0, dim);
+    Matrix<BaseFloat> linear(b.linear.NumRows(), a.linear.NumCols());
+    linear.AddMatMat(1.0, b_linear, kNoTrans, a.linear, kNoTrans, 0.0);
+    Vector<BaseFloat> offset(b.linear.NumRows());
+    offset.AddMatVec(1.0, b_linear, kNoTrans, a.offset, 0.0);
+    if (b.linear.NumCols() == dim + 1) {
+      Vector<BaseFloat> b_offset(b.linear.NumRows());
+      b_offset.CopyColFromMat(b.linear, dim);
+      offset.AddVec(1.0, b_offset);
+    }
+    a.linear.Swap(&linear);
+    a.offset.Swap(&offset);
+    stages_.erase(stages_.begin() + i + 1);
+  }
+
+  // Do the splicing as part of the transform that follows it.
+  for (size_t i = 0; i + 1 < stages_.size(); i++) {
+    if (stages_[i].type == kSplice && stages_[i + 1].type == kTransform) {
+      stages_[i + 1].left_context = stages_[i].left_context;
+      stages_[i + 1].right_context = stages_[i].right_context;
+      stages_.erase(stages_.begin() + i);
+    }
+  }
+
+  // Move the subsampling as early as possible, and do it as part of a
+  // preceding transform if there is one.
+  for (size_t i = 1; i < stages_.size(); i++) {
+    if (stages_[i].type != kSubsample) continue;
+    // Stages after i are not moved; if we erase one, the stage that was after
+    // it will be at position i.
+    size_t j = i;
+    while (j > 0 && IsFrameLevel(stages_[j - 1])) {
+      std::swap(stages_[j - 1], stages_[j]);
+      j--;
+    }
+    if (j > 0 && stages_[j - 1].type == kTransform &&
+        stages_[j - 1].subsample_n == 1 &&
+        stages_[j - 1].subsample_offset == 0) {
+      stages_[j - 1].subsample_n = stages_[j].subsample_n;
+      stages_[j - 1].subsample_offset = stages_[j].subsample_offset;
+      stages_.erase(stages_.begin() + j);
+      i--;
+    }
+  }
+}
+
+bool FeatureTransformChain::NeedsCmvnStats() const {
+  for (size_t i = 0; i < stages_.size(); i++)
+    if (stages_[i].type == kCmvn) return true;
+  return false;
+}
+
+bool FeatureTransformChain::NeedsFmllrTransform() const {
+  for (size_t i = 0; i < stages_.size(); i++)
+    if (stages_[i].type == kFmllr) return true;
+  return false;
+}
+
+void FeatureTransformChain::ApplyTransform(const Stage &stage,
+                                           const MatrixBase<BaseFloat> &linear,
+                                           const VectorBase<BaseFloat> &offset,
+                                           const MatrixBase<BaseFloat> &input,
+                                           Matrix<BaseFloat> *output) {
+  int32 num_frames = input.NumRows(), dim = input.NumCols(),
+      left_context = stage.left_context, right_context = stage.right_context,
+      context = left_context + 1 + right_context,
+      n = stage.subsample_n, frame_offset = stage.subsample_offset;
+  bool affine;
+  if (linear.NumCols() == context * dim) {
+    affine = false;
+  } else if (linear.NumCols() == context * dim + 1) {
+    affine = true;
+  } else {
+    KALDI_ERR << "Feature transform has " << linear.NumCols() << " columns, "
+              << "versus input dimension " << dim << " with " << context
+              << " frames of context";
+    affine = false;  // suppress compiler warning.
+  }
+  int32 num_frames_out = (num_frames > frame_offset ?
+                          (num_frames - frame_offset + n - 1) / n : 0);
+  if (num_frames_out == 0) {
+    output->Resize(0, 0);
+    return;
+  }
+  output->Resize(num_frames_out, linear.NumRows(), kUndefined);
+  output->CopyRowsFromVec(offset);
+  if (affine) {
+    Vector<BaseFloat> extra_offset(linear.NumRows());
+    extra_offset.CopyColFromMat(linear, context * dim);
+    output->AddVecToRows(1.0, extra_offset);
+  }
+
+  // Output frame i corresponds to input frame t = frame_offset + i * n, and
+  // the k'th context frame of that is t - left_context + k, i.e. row t + k of
+  // the input padded with left_context copies of the first frame and
+  // right_context copies of the last one.
+  const MatrixBase<BaseFloat> *src = &input;
+  Matrix<BaseFloat> padded;
+  if (context > 1) {
+    padded.Resize(num_frames + context - 1, dim, kUndefined);
+    for (int32 t = 0; t < padded.NumRows(); t++) {
+      int32 t2 = std::min(std::max(t - left_context, 0), num_frames - 1);
+      padded.Row(t).CopyFromVec(input.Row(t2));
+    }
+    src = &padded;
+  }
+  for (int32 k = 0; k < context; k++) {
+    SubMatrix<BaseFloat> frames(const_cast<BaseFloat*>(
+        src->RowData(frame_offset + k)), num_frames_out, dim,
+                                src->Stride() * n);
+    output->AddMatMat(1.0, frames, kNoTrans, linear.ColRange(k * dim, dim),
+                      kTrans, 1.0);
+  }
+}
+
+void FeatureTransformChain::Apply(
+    const MatrixBase<BaseFloat> &feats,
+    const MatrixBase<double> *cmvn_stats,
+    const MatrixBase<BaseFloat> *fmllr_transform,
+    Matrix<BaseFloat> *output) const {
+  // "input" is the input of the current stage: either "feats" or "cur".
+  const MatrixBase<BaseFloat> *input = &feats;
+  Matrix<BaseFloat> cur, next;
+  for (size_t i = 0; i < stages_.size(); i++) {
+    const Stage &stage = stages_[i];
+    switch (stage.type) {
+      case kCmvn: {
+        if (cmvn_stats == NULL)
+          KALDI_ERR << "Feature transform chain needs CMVN stats.";
+        if (input != &cur) {
+          cur = *input;
+          input = &cur;
+        }
+        if (stage.reverse)
+          ApplyCmvnReverse(*cmvn_stats, stage.norm_vars, &cur);
+        else
+          ApplyCmvn(*cmvn_stats, stage.norm_vars, &cur);
+        continue;  // the output is already in "cur".
+      }
+      case kSplice:
+        SpliceFrames(*input, stage.left_context, stage.right_context, &next);
+        break;
+      case kDeltas:
+        ComputeDeltas(stage.delta_opts, *input, &next);
+        break;
+      case kSubsample: {
+        int32 num_frames = input->NumRows(), n = stage.subsample_n,
+            offset = stage.subsample_offset,
+            num_frames_out = (num_frames > offset ?
+                              (num_frames - offset + n - 1) / n : 0);
+        if (num_frames_out == 0) {
+          output->Resize(0, 0);
+          return;
+        }
+        next.Resize(num_frames_out, input->NumCols(), kUndefined);
+        for (int32 j = 0; j < num_frames_out; j++)
+          next.Row(j).CopyFromVec(input->Row(offset + j * n));
+        break;
+      }
+      case kFmllr: {
+        if (fmllr_transform == NULL)
+          KALDI_ERR << "Feature transform chain needs a fMLLR transform.";
+        Stage plain(kTransform);
+        Vector<BaseFloat> zero(fmllr_transform->NumRows());
+        ApplyTransform(plain, *fmllr_transform, zero, *input, &next);
+        break;
+      }
+      case kTransform: {
+        if (i + 1 < stages_.size() && stages_[i + 1].type == kFmllr &&
+            fmllr_transform != NULL) {
+          // Compose the fMLLR transform with this one.
+          const MatrixBase<BaseFloat> &fmllr = *fmllr_transform;
+          int32 dim = stage.linear.NumRows();
+          if (fmllr.NumCols() != dim && fmllr.NumCols() != dim + 1)
+            KALDI_ERR << "fMLLR transform has " << fmllr.NumCols()
+                      << " columns, versus feature dimension " << dim;
+          SubMatrix<BaseFloat> fmllr_linear(fmllr, 0, fmllr.NumRows(), 0, dim);
+          Matrix<BaseFloat> linear(fmllr.NumRows(), stage.linear.NumCols());
+          linear.AddMatMat(1.0, fmllr_linear, kNoTrans, stage.linear, kNoTrans,
+                           0.0);
+          Vector<BaseFloat> offset(fmllr.NumRows());
+          offset.AddMatVec(1.0, fmllr_linear, kNoTrans, stage.offset, 0.0);
+          if (fmllr.NumCols() == dim + 1) {
+            Vector<BaseFloat> fmllr_offset(fmllr.NumRows());
+            fmllr_offset.CopyColFromMat(fmllr, dim);
+            offset.AddVec(1.0, fmllr_offset);
+          }
+          ApplyTransform(stage, linear, offset, *input, &next);
+          i++;  // skip the fMLLR stage.
+        } else {
+          ApplyTransform(stage, stage.linear, stage.offset, *input, &next);
+        }
+        break;
+      }
+      default:
+        KALDI_ERR << "Invalid stage type";
+    }
+    cur.Swap(&next);
+    input = &cur;
+    if (cur.NumRows() == 0) {  // subsampled to nothing.
+      output->Resize(0, 0);
+      return;
+    }
+  }
+  if (input == &cur) {
+    output->Swap(&cur);
+  } else {
+    output->Resize(feats.NumRows(), feats.NumCols(), kUndefined);
+    output->CopyFromMat(feats);
+  }
+}
+
+std::string FeatureTransformChain::Info() const {
+  std::ostringstream os;
+  for (size_t i = 0; i < stages_.size(); i++) {
+    const Stage &stage = stages_[i];
+    if (i > 0) os << " -> ";
+    switch (stage.type) {
+      case kCmvn:
+        os << "cmvn(norm-vars=" << (stage.norm_vars ? "true" : "false")
+           << ", reverse=" << (stage.reverse ? "true" : "false") << ")";
+        break;
+      case kSplice:
+        os << "splice(" << stage.left_context << ", " << stage.right_context
+           << ")";
+        break;
+      case kDeltas:
+        os << "deltas(" << stage.delta_opts.order << ", "
+           << stage.delta_opts.window << ")";
+        break;
+      case kSubsample:
+        os << "subsample(" << stage.subsample_n << ", "
+           << stage.subsample_offset << ")";
+        break;
+      case kFmllr:
+        os << "fmllr";
+        break;
+      case kTransform:
+        os << "transform(" << stage.linear.NumRows() << "x"
+           << stage.linear.NumCols();
+        if (stage.left_context != 0 || stage.right_context != 0)
+          os << ", splice " << stage.left_context << ", "
+             << stage.right_context;
+        if (stage.subsample_n != 1 || stage.subsample_offset != 0)
+          os << ", subsample " << stage.subsample_n << ", "
+             << stage.subsample_offset;
+        os << ")";
+        break;
+    }
+  }
+  return os.str();
+}
+
+}  // namespace kaldi
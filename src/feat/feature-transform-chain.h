@@ -0,0 +1,141 @@
+// feat/feature-transform-chain.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_FEAT_FEATURE_TRANSFORM_CHAIN_H_
+#define KALDI_FEAT_FEATURE_TRANSFORM_CHAIN_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "feat/feature-functions.h"
+
+namespace kaldi {
+/// @addtogroup  feat FeatureExtraction
+/// @{
+
+/**
+   FeatureTransformChain does, in a single process, the post-processing of the
+   features that is normally done by a pipe of programs such as
+
+     apply-cmvn ... | splice-feats ... | transform-feats ... | add-deltas ...
+
+   It is configured by a string with one stage per line (or separated by ';'),
+   each consisting of the stage name followed by options of the form
+   name=value:
+
+     cmvn [norm-vars=false] [reverse=false]   # as apply-cmvn; needs the stats.
+     splice [left-context=4] [right-context=4]   # as splice-feats.
+     transform matrix=<rxfilename>  # as transform-feats with a global
+                                    # (linear or affine) transform.
+     fmllr       # as transform-feats with a per-speaker or per-utterance
+                 # transform, which is supplied to Apply().
+     deltas [order=2] [window=2]    # as add-deltas.
+     subsample [n=1] [offset=0]     # as subsample-feats (n must be positive).
+
+   e.g. "cmvn; splice left-context=3 right-context=3; transform matrix=final.mat".
+
+   Consecutive linear operations are folded when the chain is initialized:
+   adjacent global transforms (e.g. LDA followed by MLLT) are composed into one
+   matrix, and a splicing stage followed by a transform is done as one matrix
+   multiplication per context frame, without creating the spliced features.
+   Subsampling is moved before the operations that work frame by frame, so
+   that the transforms are only computed for the frames we keep.  A fMLLR
+   transform directly after a global transform is composed with it for each
+   utterance.
+*/
+class FeatureTransformChain {
+ public:
+  FeatureTransformChain() { }
+
+  /// Initializes from the config string described above; reads the matrices
+  /// it refers to.
+  explicit FeatureTransformChain(const std::string &config) { Init(config); }
+
+  void Init(const std::string &config);
+
+  /// True if the chain has a "cmvn" stage, i.e. Apply() needs the CMVN stats.
+  bool NeedsCmvnStats() const;
+
+  /// True if the chain has a "fmllr" stage, i.e. Apply() needs the transform.
+  bool NeedsFmllrTransform() const;
+
+  /// Applies the chain to "feats".  "cmvn_stats" and "fmllr_transform" are only
+  /// needed (and otherwise may be NULL) if the chain has "cmvn" or "fmllr"
+  /// stages, respectively.  The fMLLR transform may be linear or affine.
+  void Apply(const MatrixBase<BaseFloat> &feats,
+             const MatrixBase<double> *cmvn_stats,
+             const MatrixBase<BaseFloat> *fmllr_transform,
+             Matrix<BaseFloat> *output) const;
+
+  /// Returns a description of the stages after folding, for diagnostics.
+  std::string Info() const;
+
+ private:
+  enum StageType { kCmvn, kSplice, kTransform, kFmllr, kDeltas, kSubsample };
+
+  struct Stage {
+    StageType type;
+    // for kCmvn.
+    bool norm_vars;
+    bool reverse;
+    // for kSplice, and for kTransform if it was folded with a splicing stage.
+    int32 left_context;
+    int32 right_context;
+    // for kSubsample, and for kTransform if it was folded with a subsampling
+    // stage.
+    int32 subsample_n;
+    int32 subsample_offset;
+    // for kDeltas.
+    DeltaFeaturesOptions delta_opts;
+    // for kTransform: the transform is x -> linear x + offset, where x is the
+    // spliced input if left_context or right_context is nonzero.
+    Matrix<BaseFloat> linear;
+    Vector<BaseFloat> offset;
+    explicit Stage(StageType type): type(type), norm_vars(false),
+                                    reverse(false), left_context(0),
+                                    right_context(0), subsample_n(1),
+                                    subsample_offset(0) { }
+  };
+
+  // Parses one stage of the config.
+  static Stage ParseStage(const std::string &line);
+
+  // Does the folding described in the class comment.
+  void FoldStages();
+
+  // True for the stages that work frame by frame, i.e. that commute with
+  // subsampling.
+  static bool IsFrameLevel(const Stage &stage);
+
+  // Applies a kTransform stage, with "linear" and "offset" possibly composed
+  // with a fMLLR transform.
+  static void ApplyTransform(const Stage &stage,
+                             const MatrixBase<BaseFloat> &linear,
+                             const VectorBase<BaseFloat> &offset,
+                             const MatrixBase<BaseFloat> &input,
+                             Matrix<BaseFloat> *output);
+
+  std::vector<Stage> stages_;
+};
+
+/// @} End of "addtogroup feat"
+}  // namespace kaldi
+
+#endif  // KALDI_FEAT_FEATURE_TRANSFORM_CHAIN_H_
@@ -88,36 +88,83 @@ BaseFloat NccfToPov(BaseFloat n) {
 }
 
 /**
-   This function computes some dot products that are required
-   while computing the NCCF.
-   For each integer lag from start to end-1, this function
-   outputs to (*inner_prod)(lag - start), the dot-product
-   of a window starting at 0 with a window starting at
-   lag.  All windows are of length nccf_window_size.  It
-   outputs to (*norm_prod)(lag - start), e1 * e2, where
-   e1 is the dot-product of the un-shifted window with itself,
-   and d2 is the dot-product of the window shifted by "lag"
-   with itself.
- */
-void ComputeCorrelation(const VectorBase<BaseFloat> &wave,
-                        int32 first_lag, int32 last_lag,
-                        int32 nccf_window_size,
-                        VectorBase<BaseFloat> *inner_prod,
-                        VectorBase<BaseFloat> *norm_prod) {
-  Vector<BaseFloat> zero_mean_wave(wave);
-  // TODO: possibly fix this, the mean normalization is done in a strange way.
-  SubVector<BaseFloat> wave_part(wave, 0, nccf_window_size);
-  // subtract mean-frame from wave
-  zero_mean_wave.Add(-wave_part.Sum() / nccf_window_size);
-  BaseFloat e1, e2, sum;
-  SubVector<BaseFloat> sub_vec1(zero_mean_wave, 0, nccf_window_size);
-  e1 = VecVec(sub_vec1, sub_vec1);
-  for (int32 lag = first_lag; lag <= last_lag; lag++) {
-    SubVector<BaseFloat> sub_vec2(zero_mean_wave, lag, nccf_window_size);
-    e2 = VecVec(sub_vec2, sub_vec2);
-    sum = VecVec(sub_vec1, sub_vec2);
-    (*inner_prod)(lag - first_lag) = sum;
-    (*norm_prod)(lag - first_lag) = e1 * e2;
+   This class computes, for a batch of frames, the quantities we need for the
+   NCCF.  Each frame's window is of length nccf_window_size + last_lag; we first
+   subtract from it the mean of its first nccf_window_size samples.  For each lag
+   from first_lag to last_lag, it outputs to (*inner_prod)(frame, lag - first_lag)
+   the dot-product of the part of the window starting at 0 with the part
+   starting at lag, both of length nccf_window_size, and to
+   (*norm_prod)(frame, lag - first_lag) e1 * e2, where e1 is the dot-product of
+   the un-shifted part with itself and e2 is the dot-product of the part
+   shifted by "lag" with itself.  We get the e2 values for all the lags from a
+   running sum of squares, rather than doing a dot-product for each lag, and we
+   keep the buffers between calls.
+*/
+class NccfCorrelationComputer {
+ public:
+  NccfCorrelationComputer(int32 first_lag, int32 last_lag,
+                          int32 nccf_window_size);
+
+  void Compute(const MatrixBase<BaseFloat> &windows,
+               MatrixBase<BaseFloat> *inner_prod,
+               MatrixBase<BaseFloat> *norm_prod);
+
+ private:
+  int32 first_lag_;
+  int32 last_lag_;
+  int32 nccf_window_size_;
+  // The mean-normalized window of the current frame.
+  Vector<BaseFloat> window_;
+  // sumsq_(i) is the sum of squares of samples zero through i - 1 of window_.
+  Vector<double> sumsq_;
+};
+
+NccfCorrelationComputer::NccfCorrelationComputer(int32 first_lag,
+                                                 int32 last_lag,
+                                                 int32 nccf_window_size):
+    first_lag_(first_lag), last_lag_(last_lag),
+    nccf_window_size_(nccf_window_size),
+    window_(nccf_window_size + last_lag, kUndefined),
+    sumsq_(nccf_window_size + last_lag + 1) {
+  KALDI_ASSERT(first_lag >= 0 && last_lag >= first_lag);
+}
+
+void NccfCorrelationComputer::Compute(const MatrixBase<BaseFloat> &windows,
+                                      MatrixBase<BaseFloat> *inner_prod,
+                                      MatrixBase<BaseFloat> *norm_prod) {
+  int32 num_frames = windows.NumRows(),
+      window_size = nccf_window_size_ + last_lag_,
+      num_lags = last_lag_ + 1 - first_lag_;
+  KALDI_ASSERT(windows.NumCols() == window_size &&
+               inner_prod->NumRows() == num_frames &&
+               inner_prod->NumCols() == num_lags &&
+               norm_prod->NumRows() == num_frames &&
+               norm_prod->NumCols() == num_lags);
+  BaseFloat *window_data = window_.Data();
+  double *sumsq_data = sumsq_.Data();
+  SubVector<BaseFloat> start(window_, 0, nccf_window_size_);
+  for (int32 frame = 0; frame < num_frames; frame++) {
+    window_.CopyFromVec(windows.Row(frame));
+    // TODO: possibly fix this, the mean normalization is done in a strange way.
+    window_.Add(-start.Sum() / nccf_window_size_);
+    for (int32 i = 0; i < window_size; i++)
+      sumsq_data[i + 1] = sumsq_data[i] + window_data[i] * window_data[i];
+
+    double e1 = sumsq_data[nccf_window_size_];
+    BaseFloat *inner_prod_data = inner_prod->RowData(frame),
+        *norm_prod_data = norm_prod->RowData(frame);
+    for (int32 lag = first_lag_; lag <= last_lag_; lag++) {
+      SubVector<BaseFloat> shifted(window_, lag, nccf_window_size_);
+      // e2 can't be negative, but rounding could make it so.
+      double e2 = std::max(0.0, sumsq_data[lag + nccf_window_size_] -
+                           sumsq_data[lag]),
+          norm = e1 * e2;
+      // ComputeNccf() requires the inner product to be zero if the norm is,
+      // which rounding in the running sum could otherwise break.
+      inner_prod_data[lag - first_lag_] = (norm == 0.0 ? 0.0 :
+                                           VecVec(start, shifted));
+      norm_prod_data[lag - first_lag_] = norm;
+    }
   }
 }
 
@@ -126,7 +173,7 @@ void ComputeCorrelation(const VectorBase<BaseFloat> &wave,
    two vectors) and a denominator term which equals sqrt(e1*e2 + nccf_ballast)
    where e1 and e2 are both dot-products of bits of the wave with themselves,
    and e1*e2 is supplied as "norm_prod".  These quantities are computed by
-   "ComputeCorrelation".
+   class NccfCorrelationComputer.
 */
 void ComputeNccf(const VectorBase<BaseFloat> &inner_prod,
                  const VectorBase<BaseFloat> &norm_prod,
@@ -136,7 +183,7 @@ void ComputeNccf(const VectorBase<BaseFloat> &inner_prod,
                inner_prod.Dim() == nccf_vec->Dim());
   for (int32 lag = 0; lag < inner_prod.Dim(); lag++) {
     BaseFloat numerator = inner_prod(lag),
-        denominator = pow(norm_prod(lag) + nccf_ballast, 0.5),
+        denominator = std::sqrt(norm_prod(lag) + nccf_ballast),
         nccf;
     if (denominator != 0.0) {
       nccf = numerator / denominator;
@@ -656,6 +703,9 @@ class OnlinePitchFeatureImpl {
   // have to use the initializer from the constructor.
   ArbitraryResample *nccf_resampler_;
 
+  // This object computes the correlations we need for the NCCF.
+  NccfCorrelationComputer *nccf_computer_;
+
   // The following objects may change during the lifetime of this object.
 
   // This object is used to resample the signal.
@@ -756,6 +806,9 @@ OnlinePitchFeatureImpl::OnlinePitchFeatureImpl(
                                           upsample_cutoff, lags_offset,
                                           opts.upsample_filter_width);
 
+  nccf_computer_ = new NccfCorrelationComputer(nccf_first_lag_, nccf_last_lag_,
+                                               opts.NccfWindowSize());
+
   // add a PitchInfo object for frame -1 (not a real frame).
   frame_info_.push_back(new PitchFrameInfo(lags_.Dim()));
   // zeroes forward_cost_; this is what we want for the fake frame -1.
@@ -1005,6 +1058,7 @@ void OnlinePitchFeatureImpl::RecomputeBacktraces() {
 
 OnlinePitchFeatureImpl::~OnlinePitchFeatureImpl() {
   delete nccf_resampler_;
+  delete nccf_computer_;
   delete signal_resampler_;
   for (size_t i = 0; i < frame_info_.size(); i++)
     delete frame_info_[i];
@@ -1055,9 +1109,10 @@ void OnlinePitchFeatureImpl::AcceptWaveform(
       basic_frame_length = opts_.NccfWindowSize(),
       full_frame_length = basic_frame_length + nccf_last_lag_;
 
-  Vector<BaseFloat> window(full_frame_length),
-      inner_prod(num_measured_lags),
-      norm_prod(num_measured_lags);
+  Matrix<BaseFloat> windows(num_new_frames, full_frame_length, kUndefined),
+      inner_prod(num_new_frames, num_measured_lags, kUndefined),
+      norm_prod(num_new_frames, num_measured_lags, kUndefined);
+  Vector<double> mean_square(num_new_frames, kUndefined);
   Matrix<BaseFloat> nccf_pitch(num_new_frames, num_measured_lags),
       nccf_pov(num_new_frames, num_measured_lags);
 
@@ -1067,10 +1122,13 @@ void OnlinePitchFeatureImpl::AcceptWaveform(
   // Because the resampling of the NCCF is more efficient when grouped together,
   // we first compute the NCCF for all frames, then resample as a matrix, then
   // do the Viterbi [that happens inside the constructor of PitchFrameInfo].
+  // We extract the windows of all the frames first, so that the correlations
+  // can be computed for all of them together.
 
   for (int32 frame = start_frame; frame < end_frame; frame++) {
     // start_sample is index into the whole wave, not just this part.
     int64 start_sample = static_cast<int64>(frame) * frame_shift;
+    SubVector<BaseFloat> window(windows, frame - start_frame);
     ExtractFrame(downsampled_wave, start_sample, &window);
     if (opts_.nccf_ballast_online) {
       // use only up to end of current frame to compute root-mean-square value.
@@ -1092,23 +1150,30 @@ void OnlinePitchFeatureImpl::AcceptWaveform(
       cur_sum += new_part.Sum();
       prev_frame_end_sample = end_sample;
     }
-    double mean_square = cur_sumsq / cur_num_samp -
+    mean_square(frame - start_frame) = cur_sumsq / cur_num_samp -
         pow(cur_sum / cur_num_samp, 2.0);
+  }
+
+  nccf_computer_->Compute(windows, &inner_prod, &norm_prod);
+  windows.Resize(0, 0);  // no longer needed.
 
-    ComputeCorrelation(window, nccf_first_lag_, nccf_last_lag_,
-                       basic_frame_length, &inner_prod, &norm_prod);
+  for (int32 frame = start_frame; frame < end_frame; frame++) {
+    int32 frame_idx = frame - start_frame;
+    SubVector<BaseFloat> inner_prod_row(inner_prod, frame_idx),
+        norm_prod_row(norm_prod, frame_idx);
     double nccf_ballast_pov = 0.0,
-        nccf_ballast_pitch = pow(mean_square * basic_frame_length, 2) *
-             opts_.nccf_ballast,
-        avg_norm_prod = norm_prod.Sum() / norm_prod.Dim();
-    SubVector<BaseFloat> nccf_pitch_row(nccf_pitch, frame - start_frame);
-    ComputeNccf(inner_prod, norm_prod, nccf_ballast_pitch,
+        nccf_ballast_pitch = pow(mean_square(frame_idx) * basic_frame_length,
+                                 2) * opts_.nccf_ballast,
+        avg_norm_prod = norm_prod_row.Sum() / norm_prod_row.Dim();
+    SubVector<BaseFloat> nccf_pitch_row(nccf_pitch, frame_idx);
+    ComputeNccf(inner_prod_row, norm_prod_row, nccf_ballast_pitch,
                 &nccf_pitch_row);
-    SubVector<BaseFloat> nccf_pov_row(nccf_pov, frame - start_frame);
-    ComputeNccf(inner_prod, norm_prod, nccf_ballast_pov,
+    SubVector<BaseFloat> nccf_pov_row(nccf_pov, frame_idx);
+    ComputeNccf(inner_prod_row, norm_prod_row, nccf_ballast_pov,
                 &nccf_pov_row);
     if (frame < opts_.recompute_frame)
-      nccf_info_.push_back(new NccfInfo(avg_norm_prod, mean_square));
+      nccf_info_.push_back(new NccfInfo(avg_norm_prod,
+                                        mean_square(frame_idx)));
   }
 
   Matrix<BaseFloat> nccf_pitch_resampled(num_new_frames, num_resampled_lags);
@@ -286,15 +286,22 @@ void ArbitraryResample::Resample(const MatrixBase<BaseFloat> &input,
                input.NumCols() == num_samples_in_ &&
                output->NumCols() == weights_.size());
 
-  Vector<BaseFloat> output_col(output->NumRows());
-  for (int32 i = 0; i < NumSamplesOut(); i++) {
-    SubMatrix<BaseFloat> input_part(input, 0, input.NumRows(),
-                                    first_index_[i],
-                                    weights_[i].Dim());
-    const Vector<BaseFloat> &weight_vec(weights_[i]);
-    output_col.AddMatVec(1.0, input_part,
-                         kNoTrans, weight_vec, 0.0);
-    output->CopyColFromVec(output_col, i);
+  // We go a row at a time, rather than a column at a time with matrix-vector
+  // products, because the filters are short and writing the output a column
+  // at a time is not cache-friendly.
+  int32 num_rows = input.NumRows(), num_samples_out = NumSamplesOut();
+  for (int32 r = 0; r < num_rows; r++) {
+    const BaseFloat *input_data = input.RowData(r);
+    BaseFloat *output_data = output->RowData(r);
+    for (int32 i = 0; i < num_samples_out; i++) {
+      const BaseFloat *this_input = input_data + first_index_[i],
+          *weight_data = weights_[i].Data();
+      int32 num_weights = weights_[i].Dim();
+      BaseFloat sum = 0.0;
+      for (int32 j = 0; j < num_weights; j++)
+        sum += this_input[j] * weight_data[j];
+      output_data[i] = sum;
+    }
   }
 }
 
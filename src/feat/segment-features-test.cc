@@ -0,0 +1,127 @@
+// feat/segment-features-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <sstream>
+
+#include "feat/segment-features.h"
+#include "feat/feature-mfcc.h"
+#include "feat/feature-fbank.h"
+
+namespace kaldi {
+
+// Writes a random recording and segments file, and checks that
+// SegmentFeatureReader gives the same features as extracting the segments'
+// audio and computing their features.
+template<class C>
+void UnitTestSegmentFeatureReader(typename C::Options opts) {
+  BaseFloat samp_freq = 8000.0;
+  opts.frame_opts.samp_freq = samp_freq;
+  opts.frame_opts.dither = 0.0;
+  opts.frame_opts.snip_edges = (Rand() % 2 == 0);
+  int32 num_channels = 1 + Rand() % 2,
+      num_samples = 8000 + Rand() % 100000;
+  Matrix<BaseFloat> samples(num_channels, num_samples);
+  for (int32 c = 0; c < num_channels; c++)
+    for (int32 i = 0; i < num_samples; i++)
+      samples(c, i) = RandInt(-5000, 5000);
+  {
+    WaveData wave(samp_freq, samples);
+    std::ofstream os("tmp.wav", std::ios::binary);
+    wave.Write(os);
+  }
+  {
+    std::ofstream os("tmp.scp");
+    os << "rec tmp.wav\n";
+  }
+
+  // Segments at multiples of 10ms, which often overlap, and a few that are not
+  // aligned with the frames of the others, or in a missing recording.
+  std::vector<std::string> segment_ids;
+  std::vector<int32> start_samples, end_samples, channels;
+  {
+    std::ofstream os("tmp.segments");
+    int32 num_segments = 1 + Rand() % 10;
+    for (int32 s = 0; s < num_segments; s++) {
+      std::ostringstream id;
+      id << "seg" << s;
+      int32 start = RandInt(0, num_samples / 80 - 20) * 80,
+          end = std::min(num_samples, start + RandInt(20, 300) * 80);
+      if (Rand() % 5 == 0)
+        start += RandInt(1, 79);
+      int32 channel = (num_channels == 1 ? 0 : Rand() % num_channels);
+      if (Rand() % 10 == 0) {
+        os << id.str() << " other_rec 0.0 1.0\n";
+        continue;
+      }
+      std::ostringstream start_str, end_str;
+      start_str << (start / samp_freq);
+      end_str << (end / samp_freq);
+      os << id.str() << " rec " << start_str.str() << " " << end_str.str();
+      if (num_channels != 1)
+        os << " " << channel;
+      os << "\n";
+      segment_ids.push_back(id.str());
+      // Convert the times back to samples as extract-segments does.
+      double start_time, end_time;
+      ConvertStringToReal(start_str.str(), &start_time);
+      ConvertStringToReal(end_str.str(), &end_time);
+      start_samples.push_back(static_cast<int32>(start_time * samp_freq));
+      end_samples.push_back(static_cast<int32>(end_time * samp_freq));
+      channels.push_back(channel);
+    }
+  }
+
+  SegmentFeatureOptions segment_opts;
+  SegmentFeatureReader<C> reader(opts, segment_opts, "scp:tmp.scp",
+                                 "tmp.segments", NULL);
+  C computer(opts);
+  size_t s = 0;
+  for (; !reader.Done(); reader.Next(), s++) {
+    KALDI_ASSERT(s < segment_ids.size() && reader.Key() == segment_ids[s]);
+    SubVector<BaseFloat> wave(samples.Row(channels[s]), start_samples[s],
+                              end_samples[s] - start_samples[s]);
+    Matrix<BaseFloat> ref_feats;
+    computer.Compute(wave, 1.0, &ref_feats, NULL);
+    const Matrix<BaseFloat> &feats = reader.Value();
+    KALDI_ASSERT(feats.NumRows() == ref_feats.NumRows());
+    if (opts.frame_opts.snip_edges) {
+      AssertEqual(feats, ref_feats, 0.001);
+    } else {
+      // The first and last frames may differ, as we use the audio outside the
+      // segment instead of reflecting it.
+      int32 n = feats.NumRows() - 4;
+      if (n > 0)
+        AssertEqual(feats.RowRange(2, n), ref_feats.RowRange(2, n), 0.001);
+    }
+  }
+  KALDI_ASSERT(s == segment_ids.size());
+  unlink("tmp.wav");
+  unlink("tmp.scp");
+  unlink("tmp.segments");
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 5; i++) {
+    UnitTestSegmentFeatureReader<Mfcc>(MfccOptions());
+    UnitTestSegmentFeatureReader<Fbank>(FbankOptions());
+  }
+  std::cout << "Tests succeeded.\n";
+}
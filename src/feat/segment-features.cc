@@ -0,0 +1,312 @@
+// feat/segment-features.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "feat/segment-features.h"
+#include "feat/feature-mfcc.h"
+#include "feat/feature-plp.h"
+#include "feat/feature-fbank.h"
+
+namespace kaldi {
+
+template<class C>
+SegmentFeatureReader<C>::SegmentFeatureReader(
+    const typename C::Options &feature_opts,
+    const SegmentFeatureOptions &opts,
+    const std::string &wav_rspecifier,
+    const std::string &segments_rxfilename,
+    RandomAccessBaseFloatReaderMapped *vtln_map_reader):
+    computer_(feature_opts), frame_opts_(feature_opts.frame_opts),
+    opts_(opts), wave_reader_(wav_rspecifier),
+    segments_input_(segments_rxfilename), vtln_map_reader_(vtln_map_reader),
+    have_next_line_(false), output_index_(0), num_lines_(0), num_err_(0),
+    num_frames_computed_(0), num_frames_output_(0) {
+  ReadNextRecording();
+}
+
+template<class C>
+void SegmentFeatureReader<C>::Next() {
+  KALDI_ASSERT(!Done());
+  output_index_++;
+  if (Done())
+    ReadNextRecording();
+}
+
+template<class C>
+const std::string &SegmentFeatureReader<C>::Key() const {
+  KALDI_ASSERT(!Done());
+  return keys_[output_index_];
+}
+
+template<class C>
+const Matrix<BaseFloat> &SegmentFeatureReader<C>::Value() const {
+  KALDI_ASSERT(!Done());
+  return feats_[output_index_];
+}
+
+template<class C>
+bool SegmentFeatureReader<C>::SegmentComparator::operator () (
+    const Segment &a, const Segment &b) const {
+  if (a.channel != b.channel) return a.channel < b.channel;
+  if (a.vtln_warp != b.vtln_warp) return a.vtln_warp < b.vtln_warp;
+  return a.start_sample < b.start_sample;
+}
+
+template<class C>
+bool SegmentFeatureReader<C>::ParseLine(const std::string &line,
+                                        std::string *recording,
+                                        Segment *segment) {
+  // The checks below are the same as in extract-segments.
+  std::vector<std::string> split_line;
+  SplitStringToVector(line, " \t\r", true, &split_line);
+  double start, end;
+  if ((split_line.size() != 4 && split_line.size() != 5) ||
+      !ConvertStringToReal(split_line[2], &start) ||
+      !ConvertStringToReal(split_line[3], &end) ||
+      start < 0 || (end != -1.0 && end <= 0) || (start >= end && end > 0)) {
+    KALDI_WARN << "Invalid line in segments file: " << line;
+    return false;
+  }
+  segment->id = split_line[0];
+  *recording = split_line[1];
+  segment->channel = opts_.channel;
+  if (split_line.size() == 5 &&
+      (!ConvertStringToInteger(split_line[4], &(segment->channel)) ||
+       segment->channel < 0)) {
+    KALDI_WARN << "Invalid line in segments file [bad channel]: " << line;
+    return false;
+  }
+  if (!wave_reader_.HasKey(*recording)) {
+    KALDI_WARN << "Could not find recording " << *recording
+               << ", skipping segment " << segment->id;
+    return false;
+  }
+  BaseFloat samp_freq = wave_reader_.SampFreq(*recording);
+  if (samp_freq != frame_opts_.samp_freq)
+    KALDI_ERR << "Sample frequency mismatch: you specified "
+              << frame_opts_.samp_freq << " but data has " << samp_freq
+              << " (use --sample-frequency option).  Recording is "
+              << *recording;
+  int32 num_samp = wave_reader_.NumSamples(*recording),
+      num_chan = wave_reader_.NumChannels(*recording);
+  segment->start_sample = start * samp_freq;
+  segment->end_sample = (end != -1 ? end * samp_freq : num_samp);
+  if (segment->start_sample >= num_samp) {
+    KALDI_WARN << "Start sample out of range " << segment->start_sample
+               << " [length:] " << num_samp << ", skipping segment "
+               << segment->id;
+    return false;
+  }
+  if (segment->end_sample > num_samp) {
+    if (segment->end_sample >=
+        num_samp + static_cast<int32>(opts_.max_overshoot * samp_freq)) {
+      KALDI_WARN << "End sample too far out of range " << segment->end_sample
+                 << " [length:] " << num_samp << ", skipping segment "
+                 << segment->id;
+      return false;
+    }
+    segment->end_sample = num_samp;
+  }
+  if (segment->end_sample <= segment->start_sample +
+      static_cast<int32>(opts_.min_segment_length * samp_freq)) {
+    KALDI_WARN << "Segment " << segment->id << " too short, skipping it.";
+    return false;
+  }
+  if (segment->channel == -1) {
+    segment->channel = 0;
+    if (num_chan != 1)
+      KALDI_WARN << "Channel not specified but you have data with "
+                 << num_chan  << " channels; defaulting to zero";
+  } else if (segment->channel >= num_chan) {
+    KALDI_WARN << "Recording " << *recording << " has " << num_chan
+               << " channels but you specified channel " << segment->channel
+               << ", skipping segment " << segment->id;
+    return false;
+  }
+  if (vtln_map_reader_ != NULL) {
+    if (!vtln_map_reader_->HasKey(segment->id)) {
+      KALDI_WARN << "No vtln-map entry for utterance-id (or speaker-id) "
+                 << segment->id;
+      return false;
+    }
+    segment->vtln_warp = vtln_map_reader_->Value(segment->id);
+  } else {
+    segment->vtln_warp = opts_.vtln_warp;
+  }
+  return true;
+}
+
+template<class C>
+void SegmentFeatureReader<C>::ReadNextRecording() {
+  keys_.clear();
+  feats_.clear();
+  output_index_ = 0;
+  while (keys_.empty()) {
+    std::string recording, line;
+    std::vector<Segment> segments;
+    while (true) {
+      if (have_next_line_) {
+        line = next_line_;
+        have_next_line_ = false;
+      } else if (std::getline(segments_input_.Stream(), line)) {
+        num_lines_++;
+      } else {
+        break;
+      }
+      std::string this_recording;
+      Segment segment;
+      if (!ParseLine(line, &this_recording, &segment)) {
+        num_err_++;
+        continue;
+      }
+      if (!segments.empty() && this_recording != recording) {
+        next_line_ = line;
+        have_next_line_ = true;
+        break;
+      }
+      recording = this_recording;
+      segment.index = segments.size();
+      segments.push_back(segment);
+    }
+    if (segments.empty())
+      return;  // End of the segments file.
+    ComputeRecording(recording, segments);
+  }
+}
+
+template<class C>
+void SegmentFeatureReader<C>::ComputeRecording(
+    const std::string &recording, const std::vector<Segment> &segments) {
+  int32 frame_shift = frame_opts_.WindowShift(),
+      frame_length = frame_opts_.WindowSize();
+  std::vector<Segment> sorted(segments);
+  std::sort(sorted.begin(), sorted.end(), SegmentComparator());
+  std::vector<Matrix<BaseFloat> > feats(segments.size());
+  std::vector<bool> ok(segments.size(), false);
+
+  for (size_t i = 0; i < sorted.size(); ) {
+    // Find the group of segments starting at sorted[i] that we compute
+    // together: they have the same channel and VTLN warp, start a whole
+    // number of frame shifts after the first one, and each starts within a
+    // frame length of the end of the ones before it.
+    int32 start_sample = sorted[i].start_sample,
+        end_sample = sorted[i].end_sample;
+    size_t j = i + 1;
+    for (; j < sorted.size(); j++) {
+      const Segment &seg = sorted[j];
+      if (seg.channel != sorted[i].channel ||
+          seg.vtln_warp != sorted[i].vtln_warp ||
+          seg.start_sample > end_sample + frame_length ||
+          (seg.start_sample - start_sample) % frame_shift != 0)
+        break;
+      end_sample = std::max(end_sample, seg.end_sample);
+    }
+    Matrix<BaseFloat> group_feats;
+    try {
+      ComputeFeatures(recording, sorted[i].channel, sorted[i].vtln_warp,
+                      start_sample, end_sample, &group_feats);
+    } catch (const std::exception &e) {
+      KALDI_WARN << "Failed to compute features for recording " << recording
+                 << " from sample " << start_sample << " to " << end_sample
+                 << ": " << e.what();
+      i = j;
+      continue;
+    }
+    for (; i < j; i++) {
+      const Segment &seg = sorted[i];
+      int32 first_frame = (seg.start_sample - start_sample) / frame_shift,
+          num_frames = NumFrames(seg.end_sample - seg.start_sample,
+                                 frame_opts_);
+      KALDI_ASSERT(first_frame + num_frames <= group_feats.NumRows());
+      if (num_frames == 0) {
+        KALDI_WARN << "Segment " << seg.id << " has no frames.";
+        continue;
+      }
+      feats[seg.index] = group_feats.RowRange(first_frame, num_frames);
+      ok[seg.index] = true;
+      num_frames_output_ += num_frames;
+    }
+  }
+  for (size_t i = 0; i < segments.size(); i++) {
+    if (ok[i]) {
+      keys_.push_back(segments[i].id);
+      feats_.push_back(Matrix<BaseFloat>());
+      feats_.back().Swap(&(feats[i]));
+    } else {
+      num_err_++;
+    }
+  }
+}
+
+template<class C>
+void SegmentFeatureReader<C>::ComputeFeatures(const std::string &recording,
+                                              int32 channel,
+                                              BaseFloat vtln_warp,
+                                              int32 start_sample,
+                                              int32 end_sample,
+                                              Matrix<BaseFloat> *feats) {
+  int32 num_frames = NumFrames(end_sample - start_sample, frame_opts_);
+  if (num_frames == 0) {
+    feats->Resize(0, 0);
+    return;
+  }
+  if (!frame_opts_.snip_edges) {
+    // The frames extend over the edges of the audio, so we can't compute them
+    // a block at a time; do it all at once.
+    Matrix<BaseFloat> data;
+    wave_reader_.ReadSamples(recording, start_sample,
+                             end_sample - start_sample, channel, &data);
+    computer_.Compute(data.Row(0), vtln_warp, feats, NULL);
+    KALDI_ASSERT(feats->NumRows() == num_frames);
+    num_frames_computed_ += num_frames;
+    return;
+  }
+  feats->Resize(num_frames, computer_.Dim(), kUndefined);
+  // We process the audio a block of about 10 seconds at a time, keeping the
+  // samples after the last whole frame for the next block, as
+  // OnlineGenericBaseFeature does.
+  int32 block_size = std::max(frame_opts_.WindowSize(),
+                              static_cast<int32>(frame_opts_.samp_freq * 10)),
+      frame = 0;
+  Vector<BaseFloat> remainder, wave;
+  Matrix<BaseFloat> data, block_feats;
+  for (int32 sample = start_sample; sample < end_sample;
+       sample += block_size) {
+    int32 this_block_size = std::min(block_size, end_sample - sample);
+    wave_reader_.ReadSamples(recording, sample, this_block_size, channel,
+                             &data);
+    wave.Resize(remainder.Dim() + this_block_size, kUndefined);
+    wave.Range(0, remainder.Dim()).CopyFromVec(remainder);
+    wave.Range(remainder.Dim(), this_block_size).CopyFromVec(data.Row(0));
+    computer_.Compute(wave, vtln_warp, &block_feats, &remainder);
+    if (block_feats.NumRows() == 0)
+      continue;
+    KALDI_ASSERT(frame + block_feats.NumRows() <= num_frames);
+    feats->RowRange(frame, block_feats.NumRows()).CopyFromMat(block_feats);
+    frame += block_feats.NumRows();
+  }
+  KALDI_ASSERT(frame == num_frames);
+  num_frames_computed_ += num_frames;
+}
+
+// instantiate the templates defined here for MFCC, PLP and filterbank classes.
+template class SegmentFeatureReader<Mfcc>;
+template class SegmentFeatureReader<Plp>;
+template class SegmentFeatureReader<Fbank>;
+
+}  // namespace kaldi
@@ -0,0 +1,176 @@
+// feat/segment-features.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_FEAT_SEGMENT_FEATURES_H_
+#define KALDI_FEAT_SEGMENT_FEATURES_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "matrix/matrix-lib.h"
+#include "feat/feature-functions.h"
+#include "feat/wave-reader.h"
+
+namespace kaldi {
+/// @addtogroup  feat FeatureExtraction
+/// @{
+
+struct SegmentFeatureOptions {
+  BaseFloat min_segment_length;  // Minimum segment length in seconds.
+  BaseFloat max_overshoot;  // Max time by which a segment can overshoot the
+                            // end of the recording.
+  // The channel to use for segments that do not specify one (-1 means we
+  // expect mono data); not registered, it is set by the program.
+  int32 channel;
+  // The VTLN warp factor to use if there is no VTLN map; not registered.
+  BaseFloat vtln_warp;
+
+  SegmentFeatureOptions(): min_segment_length(0.1), max_overshoot(0.5),
+                           channel(-1), vtln_warp(1.0) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("min-segment-length", &min_segment_length,
+                 "Minimum segment length in seconds (reject shorter segments); "
+                 "only relevant with --segments.");
+    po->Register("max-overshoot", &max_overshoot,
+                 "End segments overshooting audio by less than this (in "
+                 "seconds) are truncated, else rejected; only relevant with "
+                 "--segments.");
+  }
+};
+
+/**
+   SegmentFeatureReader computes features (MFCC, PLP or filterbank, depending
+   on the template argument) for the segments in a "segments" file, directly
+   from the recordings, and gives them in the order of the segments file in the
+   same way as a sequential table reader.  It gives the same features as
+   running
+
+     extract-segments <wav-rspecifier> <segments> ark:- | compute-mfcc-feats ...
+
+   with the same options (apart from the random dithering), but without
+   creating the segments' audio; the segments file has the same format as for
+   extract-segments.
+
+   The segments of a recording must be on consecutive lines for us to share the
+   computation between them.  The features of each recording are computed
+   once for each stretch of audio covered by overlapping or adjacent segments
+   (whose start times are a whole number of frame shifts apart), with the
+   audio read and processed a block at a time, as in OnlineGenericBaseFeature;
+   we then give each segment its range of those frames.
+*/
+template<class C>
+class SegmentFeatureReader {
+ public:
+  /// "vtln_map_reader" gives the VTLN warp factor for each segment-id; if it
+  /// is NULL, we use opts.vtln_warp for all segments.
+  SegmentFeatureReader(const typename C::Options &feature_opts,
+                       const SegmentFeatureOptions &opts,
+                       const std::string &wav_rspecifier,
+                       const std::string &segments_rxfilename,
+                       RandomAccessBaseFloatReaderMapped *vtln_map_reader);
+
+  bool Done() const { return (output_index_ == keys_.size()); }
+
+  void Next();
+
+  /// The segment-id of the current segment.
+  const std::string &Key() const;
+
+  /// The features of the current segment.
+  const Matrix<BaseFloat> &Value() const;
+
+  int32 Dim() const { return computer_.Dim(); }
+
+  /// The number of lines of the segments file we have read, and the number of
+  /// segments we could not compute features for.
+  int32 NumLines() const { return num_lines_; }
+  int32 NumErrors() const { return num_err_; }
+
+  /// The number of frames we computed, and the number of frames we output;
+  /// the latter may be larger if segments overlap.
+  int64 NumFramesComputed() const { return num_frames_computed_; }
+  int64 NumFramesOutput() const { return num_frames_output_; }
+
+ private:
+  struct Segment {
+    std::string id;
+    int32 channel;
+    int32 start_sample;
+    int32 end_sample;
+    BaseFloat vtln_warp;
+    int32 index;  // Position in the output for this recording.
+  };
+
+  // Orders segments by channel, VTLN warp and start sample, which is the order
+  // in which we group them.
+  struct SegmentComparator {
+    bool operator () (const Segment &a, const Segment &b) const;
+  };
+
+  // Reads the segments of the next recording that has any valid segments from
+  // the segments file, and computes their features.
+  void ReadNextRecording();
+
+  // Parses and checks one line of the segments file; returns false, with a
+  // warning, if we can't compute features for it.
+  bool ParseLine(const std::string &line, std::string *recording,
+                 Segment *segment);
+
+  // Computes the features of the segments of "recording", in the order of the
+  // segments file.
+  void ComputeRecording(const std::string &recording,
+                        const std::vector<Segment> &segments);
+
+  // Computes the features of samples [start_sample, end_sample) of one channel
+  // of the recording.
+  void ComputeFeatures(const std::string &recording, int32 channel,
+                       BaseFloat vtln_warp, int32 start_sample,
+                       int32 end_sample, Matrix<BaseFloat> *feats);
+
+  C computer_;
+  FrameExtractionOptions frame_opts_;
+  SegmentFeatureOptions opts_;
+  WaveSegmentReader wave_reader_;
+  Input segments_input_;
+  RandomAccessBaseFloatReaderMapped *vtln_map_reader_;
+
+  // The first line of the next recording, which we read while reading the
+  // segments of the previous one.
+  std::string next_line_;
+  bool have_next_line_;
+
+  // The segments of the current recording.
+  std::vector<std::string> keys_;
+  std::vector<Matrix<BaseFloat> > feats_;
+  size_t output_index_;
+
+  int32 num_lines_;
+  int32 num_err_;
+  int64 num_frames_computed_;
+  int64 num_frames_output_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SegmentFeatureReader);
+};
+
+/// @} End of "addtogroup feat"
+}  // namespace kaldi
+
+#endif  // KALDI_FEAT_SEGMENT_FEATURES_H_
@@ -286,12 +286,14 @@ BaseFloat SinusoidDetector::DetectSinusoid(
   if (signal(0) == 0.0 && signal.Norm(2.0) == 0.0)
     return 0.0;
   KALDI_ASSERT(signal.Dim() == num_samples_);
-  Vector<BaseFloat> fft(num_samples_padded_);
+  Vector<BaseFloat> &fft = fft_buffer_;
+  fft.Resize(num_samples_padded_, kUndefined);
   fft.Range(0, num_samples_).CopyFromVec(signal);
+  fft.Range(num_samples_, num_samples_padded_ - num_samples_).SetZero();
   bool forward = true;
   fft_.Compute(fft.Data(), forward);
 
-  std::vector<InfoForBin> info;
+  std::vector<InfoForBin> &info = info_;
   ComputeCoarseInfo(fft, &info);
   // we now have info for the "coarse" bins.
 
@@ -411,7 +413,9 @@ BaseFloat SinusoidDetector::DetectSinusoid(
 void SinusoidDetector::ComputeCoarseInfo(
     const Vector<BaseFloat> &fft,
     std::vector<InfoForBin> *info) const {
-  info->resize(num_samples_padded_ * 2 + 1);  // 4 times resolution of FFT itself.
+  // 4 times resolution of FFT itself.  We may be reusing "info" from a previous
+  // call, so reset all the elements.
+  info->assign(num_samples_padded_ * 2 + 1, InfoForBin());
 
   const BaseFloat *fft_data = fft.Data();
 
@@ -61,7 +61,8 @@ class SinusoidDetector {
   // energy-reduction of the signal from subtracting that sinuoid would be >=
   // "min_energy_change", and return that energy reduction; or zero if no
   // candidate was found.
-  // non-const because the FFT class has a temporary buffer.
+  // non-const because the FFT class, and this class, keep buffers that we
+  // reuse between calls.
   BaseFloat DetectSinusoid(BaseFloat min_energy_change,
                            const VectorBase<BaseFloat> &signal,
                            Sinusoid *sinusoid);
@@ -216,6 +217,10 @@ class SinusoidDetector {
                 BaseFloat final_freq,
                 BaseFloat final_energy);
 
+  // Buffers used in DetectSinusoid(), kept so we don't reallocate them for
+  // each frame: the zero-padded signal and its FFT, and the info for each bin.
+  Vector<BaseFloat> fft_buffer_;
+  std::vector<InfoForBin> info_;
 };
 
 
@@ -0,0 +1,110 @@
+// feat/wave-reader-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+
+#include "feat/wave-reader.h"
+
+namespace kaldi {
+
+// Writes a random recording, and checks that reading ranges of it with
+// WaveFileReader and WaveSegmentReader gives the same as reading all of it.
+void UnitTestWaveFileReader() {
+  int32 num_channels = 1 + Rand() % 2, num_samples = 1 + Rand() % 5000;
+  Matrix<BaseFloat> samples(num_channels, num_samples);
+  for (int32 c = 0; c < num_channels; c++)
+    for (int32 i = 0; i < num_samples; i++)
+      samples(c, i) = RandInt(-32768, 32767);
+  WaveData wave(8000.0, samples);
+  {
+    std::ofstream os("tmp.wav", std::ios::binary);
+    wave.Write(os);
+  }
+  {
+    std::ofstream os("tmp.scp");
+    os << "rec tmp.wav\n"
+       << "rec_pipe cat tmp.wav |\n"
+       << "bad tmp_bad.wav\n"
+       << "missing tmp_missing.wav\n";
+  }
+  {
+    std::ofstream os("tmp_bad.wav", std::ios::binary);
+    os << "not a wave file\n";
+  }
+  WaveData wave2;
+  {
+    std::ifstream is("tmp.wav", std::ios::binary);
+    wave2.Read(is);
+  }
+  AssertEqual(wave2.Data(), samples);
+
+  WaveFileReader reader;
+  KALDI_ASSERT(reader.Open("tmp.wav"));
+  KALDI_ASSERT(reader.NumSamples() == num_samples &&
+               reader.Info().NumChannels() == num_channels &&
+               reader.Info().SampFreq() == 8000.0);
+  // Recordings that are not plain files, and all the recordings of a script
+  // that is not a plain file, are read with the table reader.
+  WaveSegmentReader segment_reader("scp:tmp.scp"),
+      pipe_reader("scp:cat tmp.scp |");
+  KALDI_ASSERT(segment_reader.HasKey("rec") && !segment_reader.HasKey("foo"));
+  // Recordings in the scp that cannot be read do not exist.
+  KALDI_ASSERT(!segment_reader.HasKey("bad") &&
+               !segment_reader.HasKey("missing"));
+  KALDI_ASSERT(segment_reader.HasKey("rec_pipe") && pipe_reader.HasKey("rec"));
+  KALDI_ASSERT(segment_reader.NumSamples("rec") == num_samples &&
+               segment_reader.NumChannels("rec") == num_channels);
+  KALDI_ASSERT(segment_reader.NumSamples("rec_pipe") == num_samples &&
+               segment_reader.NumChannels("rec_pipe") == num_channels &&
+               segment_reader.SampFreq("rec_pipe") == 8000.0);
+  KALDI_ASSERT(pipe_reader.NumSamples("rec") == num_samples &&
+               pipe_reader.NumChannels("rec") == num_channels &&
+               pipe_reader.SampFreq("rec") == 8000.0);
+  for (int32 n = 0; n < 10; n++) {
+    int32 start = Rand() % num_samples,
+        length = 1 + Rand() % (num_samples - start),
+        channel = Rand() % (num_channels + 1) - 1;
+    Matrix<BaseFloat> data, data2, data3, data4;
+    reader.ReadSamples(start, length, channel, &data);
+    // alternate between the recordings, so that we switch between reading the
+    // file directly and with the table reader.
+    segment_reader.ReadSamples("rec", start, length, channel, &data2);
+    segment_reader.ReadSamples("rec_pipe", start, length, channel, &data3);
+    pipe_reader.ReadSamples("rec", start, length, channel, &data4);
+    if (channel == -1) {
+      AssertEqual(data, samples.ColRange(start, length));
+    } else {
+      KALDI_ASSERT(data.NumRows() == 1);
+      AssertEqual(data, samples.Range(channel, 1, start, length));
+    }
+    AssertEqual(data, data2);
+    AssertEqual(data, data3);
+    AssertEqual(data, data4);
+  }
+  unlink("tmp.wav");
+  unlink("tmp_bad.wav");
+  unlink("tmp.scp");
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    UnitTestWaveFileReader();
+  std::cout << "Tests succeeded.\n";
+}
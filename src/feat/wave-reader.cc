@@ -19,6 +19,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <cstdio>
 #include <limits>
 #include <sstream>
@@ -30,8 +31,8 @@
 
 namespace kaldi {
 
-// static
-void WaveData::Expect4ByteTag(std::istream &is, const char *expected) {
+// Helpers for reading the header.
+static void Expect4ByteTag(std::istream &is, const char *expected) {
   char tmp[5];
   tmp[4] = '\0';
   is.read(tmp, 4);
@@ -41,7 +42,7 @@ void WaveData::Expect4ByteTag(std::istream &is, const char *expected) {
     KALDI_ERR << "WaveData: expected " << expected << ", got " << tmp;
 }
 
-uint32 WaveData::ReadUint32(std::istream &is, bool swap) {
+static uint32 ReadUint32(std::istream &is, bool swap) {
   union {
     char result[4];
     uint32 ans;
@@ -55,7 +56,7 @@ uint32 WaveData::ReadUint32(std::istream &is, bool swap) {
 }
 
 
-uint16 WaveData::ReadUint16(std::istream &is, bool swap) {
+static uint16 ReadUint16(std::istream &is, bool swap) {
   union {
     char result[2];
     int16 ans;
@@ -68,8 +69,7 @@ uint16 WaveData::ReadUint16(std::istream &is, bool swap) {
   return u.ans;
 }
 
-// static
-void WaveData::Read4ByteTag(std::istream &is, char *dest) {
+static void Read4ByteTag(std::istream &is, char *dest) {
   is.read(dest, 4);
   if (is.fail())
     KALDI_ERR << "WaveData: expected 4-byte chunk-name, got read errror";
@@ -105,10 +105,7 @@ void WaveData::WriteUint16(std::ostream &os, int16 i) {
 }
 
 
-
-void WaveData::Read(std::istream &is) {
-  data_.Resize(0, 0);  // clear the data.
-
+void WaveInfo::Read(std::istream &is) {
   char tmp[5];
   tmp[4] = '\0';
   Read4ByteTag(is, &tmp[0]);
@@ -175,7 +172,6 @@ void WaveData::Read(std::istream &is) {
 
   if (num_channels <= 0)
     KALDI_ERR << "WaveData: no channels present";
-  samp_freq_ = static_cast<BaseFloat>(sample_rate);
   if (bits_per_sample != 8 && bits_per_sample != 16 && bits_per_sample != 32)
     KALDI_ERR << "WaveData: bits_per_sample is " << bits_per_sample;
   if (byte_rate != sample_rate * bits_per_sample/8 * num_channels)
@@ -233,33 +229,83 @@ void WaveData::Read(std::istream &is) {
               << "(we do not support reading multiple data chunks).";
   }
 
-  std::vector<char*> data_pointer_vec;
-  std::vector<int> data_size_vec;
+  if (data_chunk_size == 0)
+    KALDI_ERR << "WaveData: empty file (no data)";
+
+  samp_freq_ = static_cast<BaseFloat>(sample_rate);
+  num_channels_ = num_channels;
+  bits_per_sample_ = bits_per_sample;
+  data_bytes_ = data_chunk_size;
+  swap_ = swap;
+}
+
+void WaveInfo::ConvertSamples(const char *bytes, int32 num_samples,
+                              int32 channel,
+                              MatrixBase<BaseFloat> *data) const {
+  KALDI_ASSERT(channel >= -1 && channel < num_channels_);
+  KALDI_ASSERT(data->NumCols() == num_samples &&
+               data->NumRows() == (channel == -1 ? num_channels_ : 1));
+  int32 block_align = BlockAlign(), bytes_per_sample = bits_per_sample_ / 8;
+  for (int32 r = 0; r < data->NumRows(); r++) {
+    int32 c = (channel == -1 ? r : channel);
+    const char *ptr = bytes + c * bytes_per_sample;
+    BaseFloat *out = data->RowData(r);
+    // The common case of mono 16-bit data in the machine's byte order gets its
+    // own loop, which the compiler can vectorize.
+    if (bits_per_sample_ == 16 && num_channels_ == 1 && !swap_) {
+      const int16 *samples = reinterpret_cast<const int16*>(ptr);
+      for (int32 i = 0; i < num_samples; i++)
+        out[i] = samples[i];
+      continue;
+    }
+    for (int32 i = 0; i < num_samples; i++, ptr += block_align) {
+      switch (bits_per_sample_) {
+        case 8:
+          out[i] = *ptr;
+          break;
+        case 16: {
+          int16 k = *reinterpret_cast<const uint16*>(ptr);
+          if (swap_)
+            KALDI_SWAP2(k);
+          out[i] = k;
+          break;
+        }
+        case 32: {
+          int32 k = *reinterpret_cast<const uint32*>(ptr);
+          if (swap_)
+            KALDI_SWAP4(k);
+          out[i] = k;
+          break;
+        }
+        default:
+          KALDI_ERR << "bits per sample is " << bits_per_sample_;  // already checked this.
+      }
+    }
+  }
+}
+
+void WaveData::Read(std::istream &is) {
+  data_.Resize(0, 0);  // clear the data.
+
+  WaveInfo info;
+  info.Read(is);
+  samp_freq_ = info.SampFreq();
+
+  // We read the data in blocks straight into the buffer, rather than
+  // allocating it all at once, in case the header is wrong about the size.
+  uint32 data_chunk_size = info.DataBytes();
+  std::vector<char> chunk_data_vec;
   uint32 num_bytes_read = 0;
-  for (int32 remain_chunk_size = data_chunk_size; remain_chunk_size > 0;
-       remain_chunk_size -= kBlockSize) {
-    int32 this_block_size = remain_chunk_size;
-    if (kBlockSize < remain_chunk_size)
-      this_block_size = kBlockSize;
-    char *block_data_vec = new char[this_block_size];
-    is.read(block_data_vec, this_block_size);
+  while (num_bytes_read < data_chunk_size) {
+    uint32 this_block_size = std::min(kBlockSize,
+                                      data_chunk_size - num_bytes_read);
+    chunk_data_vec.resize(num_bytes_read + this_block_size);
+    is.read(&(chunk_data_vec[num_bytes_read]), this_block_size);
     num_bytes_read += is.gcount();
-    data_size_vec.push_back(is.gcount());
-    data_pointer_vec.push_back(block_data_vec);
-    if (num_bytes_read < this_block_size)
+    if (is.gcount() < this_block_size)
       break;
   }
 
-  std::vector<char> chunk_data_vec(num_bytes_read);
-  uint32 data_address = 0;
-  for (int i = 0; i < data_pointer_vec.size(); i++) {
-    memcpy(&(chunk_data_vec[data_address]), data_pointer_vec[i],
-           data_size_vec[i]);
-    delete[] data_pointer_vec[i];
-    data_address += data_size_vec[i];
-  }
-
-  char *data_ptr = &(chunk_data_vec[0]);
   if (num_bytes_read == 0 && num_bytes_read != data_chunk_size) {
     KALDI_ERR << "WaveData: failed to read data chunk (read no bytes)";
   } else if (num_bytes_read != data_chunk_size) {
@@ -268,41 +314,9 @@ void WaveData::Read(std::istream &is) {
                << num_bytes_read << " < " << data_chunk_size;
   }
 
-  if (data_chunk_size == 0)
-    KALDI_ERR << "WaveData: empty file (no data)";
-
-  uint32 num_samp = num_bytes_read / block_align;
-  data_.Resize(num_channels, num_samp);
-  for (uint32 i = 0; i < num_samp; i++) {
-    for (uint32 j = 0; j < num_channels; j++) {
-      switch (bits_per_sample) {
-        case 8:
-          data_(j, i) = *data_ptr;
-          data_ptr++;
-          break;
-        case 16:
-          {
-            int16 k = *reinterpret_cast<uint16*>(data_ptr);
-            if (swap)
-              KALDI_SWAP2(k);
-            data_(j, i) =  k;
-            data_ptr += 2;
-            break;
-          }
-        case 32:
-          {
-            int32 k = *reinterpret_cast<uint32*>(data_ptr);
-            if (swap)
-              KALDI_SWAP4(k);
-            data_(j, i) =  k;
-            data_ptr += 4;
-            break;
-          }
-        default:
-          KALDI_ERR << "bits per sample is " << bits_per_sample;  // already checked this.
-      }
-    }
-  }
+  uint32 num_samp = num_bytes_read / info.BlockAlign();
+  data_.Resize(info.NumChannels(), num_samp);
+  info.ConvertSamples(&(chunk_data_vec[0]), num_samp, -1, &data_);
 }
 
 
@@ -368,4 +382,147 @@ void WaveData::Write(std::ostream &os) const {
 }
 
 
+
+bool WaveFileReader::Open(const std::string &filename) {
+  Close();
+  is_.open(filename.c_str(), std::ios::binary);
+  if (!is_.is_open()) {
+    KALDI_WARN << "Failed to open Wave file " << filename;
+    return false;
+  }
+  try {
+    info_.Read(is_);
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Failed to read the header of Wave file " << filename;
+    Close();
+    return false;
+  }
+  data_offset_ = is_.tellg();
+  is_.seekg(0, std::ios::end);
+  int64 num_bytes = static_cast<int64>(is_.tellg() - data_offset_);
+  if (num_bytes < static_cast<int64>(info_.DataBytes()))
+    KALDI_WARN << "File " << filename << " has fewer bytes than specified in "
+               << "the header: " << num_bytes << " < " << info_.DataBytes();
+  num_samples_ = std::min(num_bytes, static_cast<int64>(info_.DataBytes())) /
+      info_.BlockAlign();
+  filename_ = filename;
+  return true;
+}
+
+void WaveFileReader::Close() {
+  if (is_.is_open())
+    is_.close();
+  is_.clear();
+  num_samples_ = 0;
+  filename_ = "";
+}
+
+void WaveFileReader::ReadSamples(int32 start_sample, int32 num_samples,
+                                 int32 channel, Matrix<BaseFloat> *data) {
+  KALDI_ASSERT(is_.is_open());
+  if (start_sample < 0 || num_samples <= 0 ||
+      start_sample + num_samples > num_samples_)
+    KALDI_ERR << "Invalid range of samples " << start_sample << " to "
+              << (start_sample + num_samples) << " in Wave file " << filename_
+              << " with " << num_samples_ << " samples";
+  if (channel < -1 || channel >= info_.NumChannels())
+    KALDI_ERR << "Invalid channel " << channel << " in Wave file " << filename_
+              << " with " << info_.NumChannels() << " channels";
+  int32 block_align = info_.BlockAlign();
+  size_t num_bytes = static_cast<size_t>(num_samples) * block_align;
+  buffer_.resize(num_bytes);
+  is_.clear();
+  is_.seekg(data_offset_ +
+            static_cast<std::streamoff>(static_cast<int64>(start_sample) *
+                                        block_align));
+  is_.read(&(buffer_[0]), num_bytes);
+  if (is_.fail() || static_cast<size_t>(is_.gcount()) != num_bytes)
+    KALDI_ERR << "Error reading samples from Wave file " << filename_;
+  data->Resize(channel == -1 ? info_.NumChannels() : 1, num_samples,
+               kUndefined);
+  info_.ConvertSamples(&(buffer_[0]), num_samples, channel, data);
+}
+
+
+WaveSegmentReader::WaveSegmentReader(const std::string &wav_rspecifier):
+    table_reader_(wav_rspecifier), current_is_file_(false) {
+  std::string script_rxfilename;
+  if (ClassifyRspecifier(wav_rspecifier, &script_rxfilename, NULL) ==
+      kScriptRspecifier &&
+      ClassifyRxfilename(script_rxfilename) == kFileInput) {
+    std::vector<std::pair<std::string, std::string> > script;
+    if (ReadScriptFile(script_rxfilename, false, &script)) {
+      for (size_t i = 0; i < script.size(); i++)
+        if (ClassifyRxfilename(script[i].second) == kFileInput)
+          files_[script[i].first] = script[i].second;
+    }
+  }
+}
+
+bool WaveSegmentReader::SetRecording(const std::string &recording) {
+  if (recording == current_recording_)
+    return current_is_file_;
+  current_recording_ = recording;
+  current_is_file_ = false;
+  file_reader_.Close();
+  std::map<std::string, std::string>::const_iterator iter =
+      files_.find(recording);
+  // If the file cannot be read directly, we let the table reader deal with it.
+  if (iter != files_.end() && file_reader_.Open(iter->second))
+    current_is_file_ = true;
+  return current_is_file_;
+}
+
+bool WaveSegmentReader::HasKey(const std::string &recording) {
+  // For files we read directly, the recording only exists if we can read its
+  // header; the table reader only checks that the scp has the key.
+  if (files_.count(recording) != 0)
+    return SetRecording(recording);
+  return table_reader_.HasKey(recording);
+}
+
+BaseFloat WaveSegmentReader::SampFreq(const std::string &recording) {
+  if (SetRecording(recording))
+    return file_reader_.Info().SampFreq();
+  return table_reader_.Value(recording).SampFreq();
+}
+
+int32 WaveSegmentReader::NumChannels(const std::string &recording) {
+  if (SetRecording(recording))
+    return file_reader_.Info().NumChannels();
+  return table_reader_.Value(recording).Data().NumRows();
+}
+
+int32 WaveSegmentReader::NumSamples(const std::string &recording) {
+  if (SetRecording(recording))
+    return file_reader_.NumSamples();
+  return table_reader_.Value(recording).Data().NumCols();
+}
+
+void WaveSegmentReader::ReadSamples(const std::string &recording,
+                                    int32 start_sample, int32 num_samples,
+                                    int32 channel, Matrix<BaseFloat> *data) {
+  if (SetRecording(recording)) {
+    file_reader_.ReadSamples(start_sample, num_samples, channel, data);
+    return;
+  }
+  const Matrix<BaseFloat> &wave_data = table_reader_.Value(recording).Data();
+  if (start_sample < 0 || num_samples <= 0 ||
+      start_sample + num_samples > wave_data.NumCols())
+    KALDI_ERR << "Invalid range of samples " << start_sample << " to "
+              << (start_sample + num_samples) << " in recording " << recording
+              << " with " << wave_data.NumCols() << " samples";
+  if (channel < -1 || channel >= wave_data.NumRows())
+    KALDI_ERR << "Invalid channel " << channel << " in recording " << recording
+              << " with " << wave_data.NumRows() << " channels";
+  if (channel == -1) {
+    data->Resize(wave_data.NumRows(), num_samples, kUndefined);
+    data->CopyFromMat(wave_data.ColRange(start_sample, num_samples));
+  } else {
+    data->Resize(1, num_samples, kUndefined);
+    data->Row(0).CopyFromVec(
+        wave_data.Row(channel).Range(start_sample, num_samples));
+  }
+}
+
 }  // end namespace kaldi
@@ -44,10 +44,15 @@
 #define KALDI_FEAT_WAVE_READER_H_
 
 #include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "base/kaldi-types.h"
 #include "matrix/kaldi-vector.h"
 #include "matrix/kaldi-matrix.h"
+#include "util/kaldi-table.h"
 
 
 namespace kaldi {
@@ -56,6 +61,42 @@ namespace kaldi {
 /// (2^15-1)*[-1, 1], not the usual default DSP range [-1, 1].
 const BaseFloat kWaveSampleMax = 32768.0;
 
+/// This class reads and stores the header of a Wave file, i.e. everything up
+/// to the start of the samples.
+class WaveInfo {
+ public:
+  WaveInfo(): samp_freq_(0.0), num_channels_(0), bits_per_sample_(0),
+              data_bytes_(0), swap_(false) { }
+
+  /// Reads the header; throws on error.  "is" should be opened in binary
+  /// mode; on exit it is positioned at the start of the samples.
+  void Read(std::istream &is);
+
+  BaseFloat SampFreq() const { return samp_freq_; }
+  int32 NumChannels() const { return num_channels_; }
+  int32 BitsPerSample() const { return bits_per_sample_; }
+  /// The number of bytes of each sample (for all channels).
+  int32 BlockAlign() const { return num_channels_ * bits_per_sample_ / 8; }
+  /// The size of the data chunk according to the header.
+  uint32 DataBytes() const { return data_bytes_; }
+  /// True if the samples are not in the machine's byte order.
+  bool Swap() const { return swap_; }
+
+  /// Converts "num_samples" samples of raw data as stored in the file, to
+  /// BaseFloat.  If channel == -1, "data" must have NumChannels() rows and
+  /// gets all the channels; otherwise it must have one row, which gets the
+  /// given channel.
+  void ConvertSamples(const char *bytes, int32 num_samples, int32 channel,
+                      MatrixBase<BaseFloat> *data) const;
+
+ private:
+  BaseFloat samp_freq_;
+  int32 num_channels_;
+  int32 bits_per_sample_;
+  uint32 data_bytes_;
+  bool swap_;
+};
+
 /// This class's purpose is to read in Wave files.
 class WaveData {
  public:
@@ -96,10 +137,6 @@ class WaveData {
   static const uint32 kBlockSize = 1024 * 1024;  // Use 1M bytes.
   Matrix<BaseFloat> data_;
   BaseFloat samp_freq_;
-  static void Expect4ByteTag(std::istream &is, const char *expected);
-  uint32 ReadUint32(std::istream &is, bool swap);
-  uint16 ReadUint16(std::istream &is, bool swap);
-  static void Read4ByteTag(std::istream &is, char *dest);
 
   static void WriteUint32(std::ostream &os, int32 i);
   static void WriteUint16(std::ostream &os, int16 i);
@@ -158,6 +195,84 @@ class WaveHolder {
 };
 
 
+/// This class reads ranges of samples from a Wave file on disk, without
+/// reading the whole file: only the header is read when the file is opened,
+/// and each call to ReadSamples() seeks to the samples it needs.  This is
+/// for extracting segments from long recordings.
+class WaveFileReader {
+ public:
+  WaveFileReader(): num_samples_(0), data_offset_(0) { }
+
+  /// Opens the file and reads its header.  Returns false (with a warning) if
+  /// the file could not be opened or is not a valid Wave file.
+  bool Open(const std::string &filename);
+
+  bool IsOpen() { return is_.is_open(); }
+
+  void Close();
+
+  const WaveInfo &Info() const { return info_; }
+
+  /// The number of samples per channel actually present in the file.
+  int32 NumSamples() const { return num_samples_; }
+
+  /// Reads the samples start_sample ... start_sample + num_samples - 1 of
+  /// channel "channel", or of all the channels if channel == -1, into "data",
+  /// which is resized to have one row or NumChannels() rows respectively.
+  /// Throws on error.
+  void ReadSamples(int32 start_sample, int32 num_samples, int32 channel,
+                   Matrix<BaseFloat> *data);
+
+ private:
+  std::string filename_;
+  std::ifstream is_;
+  WaveInfo info_;
+  int32 num_samples_;
+  std::streampos data_offset_;
+  std::vector<char> buffer_;  // The raw bytes of the last ReadSamples().
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(WaveFileReader);
+};
+
+
+/// This class provides random access to segments of the recordings in a
+/// table of Wave files (e.g. scp:wav.scp), for extract-segments and the
+/// feature-extraction programs.  If the rspecifier is a script file and the
+/// recording is a plain file on disk, the samples of each segment are read
+/// directly from the file by WaveFileReader; otherwise (e.g. for pipes or
+/// archives) the whole recording is read with the usual table reader.
+class WaveSegmentReader {
+ public:
+  explicit WaveSegmentReader(const std::string &wav_rspecifier);
+
+  /// Returns true if the recording exists and its header can be read.
+  bool HasKey(const std::string &recording);
+
+  /// The sampling frequency, number of channels and number of samples (per
+  /// channel) of the recording, which must exist.
+  BaseFloat SampFreq(const std::string &recording);
+  int32 NumChannels(const std::string &recording);
+  int32 NumSamples(const std::string &recording);
+
+  /// As WaveFileReader::ReadSamples(), for the given recording.
+  void ReadSamples(const std::string &recording, int32 start_sample,
+                   int32 num_samples, int32 channel, Matrix<BaseFloat> *data);
+
+ private:
+  // Makes sure "recording" is the current recording; returns true if it is
+  // read directly from disk.
+  bool SetRecording(const std::string &recording);
+
+  // The files on disk that we read directly, from the scp file.
+  std::map<std::string, std::string> files_;
+  RandomAccessTableReader<WaveHolder> table_reader_;
+  std::string current_recording_;
+  bool current_is_file_;  // True if we read the current recording directly.
+  WaveFileReader file_reader_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(WaveSegmentReader);
+};
+
 }  // namespace kaldi
 
 #endif  // KALDI_FEAT_WAVE_READER_H_
@@ -21,6 +21,38 @@
 #include "util/common-utils.h"
 #include "matrix/kaldi-matrix.h"
 #include "feat/feature-functions.h"
+#include "thread/kaldi-task-pipeline.h"
+
+namespace kaldi {
+
+// Applies sliding-window CMN to one utterance, so we can process utterances in
+// parallel.  The work happens in the operator (), the output happens in the
+// destructor.
+class SlidingWindowCmnTask {
+ public:
+  SlidingWindowCmnTask(const SlidingWindowCmnOptions &opts,
+                       const std::string &utt,
+                       const Matrix<BaseFloat> &feat,
+                       BaseFloatMatrixWriter *writer):
+      opts_(opts), utt_(utt), feat_(feat), writer_(writer) { }
+
+  void operator () () {
+    cmvn_feat_.Resize(feat_.NumRows(), feat_.NumCols(), kUndefined);
+    SlidingWindowCmn(opts_, feat_, &cmvn_feat_);
+  }
+
+  ~SlidingWindowCmnTask() {
+    writer_->Write(utt_, cmvn_feat_);
+  }
+ private:
+  const SlidingWindowCmnOptions &opts_;
+  std::string utt_;
+  Matrix<BaseFloat> feat_;
+  Matrix<BaseFloat> cmvn_feat_;
+  BaseFloatMatrixWriter *writer_;
+};
+
+}  // namespace kaldi
 
 
 int main(int argc, char *argv[]) {
@@ -38,7 +70,9 @@ int main(int argc, char *argv[]) {
     
     ParseOptions po(usage);
     SlidingWindowCmnOptions opts;
+    TaskSequencerConfig sequencer_config;  // only --num-threads matters here.
     opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -54,23 +88,32 @@ int main(int argc, char *argv[]) {
 
     SequentialBaseFloatMatrixReader feat_reader(feat_rspecifier);
     BaseFloatMatrixWriter feat_writer(feat_wspecifier);
-    
+
+    // With more than one thread, utterances are processed in parallel, and
+    // written in order; otherwise each task is run right away.
+    TaskPipeline<SlidingWindowCmnTask> *pipeline = NULL;
+    if (sequencer_config.num_threads > 1)
+      pipeline = new TaskPipeline<SlidingWindowCmnTask>(sequencer_config);
+
     for (;!feat_reader.Done(); feat_reader.Next()) {
       std::string utt = feat_reader.Key();
-      Matrix<BaseFloat> feat(feat_reader.Value());
+      const Matrix<BaseFloat> &feat = feat_reader.Value();
       if (feat.NumRows() == 0) {
         KALDI_WARN << "Empty feature matrix for utterance " << utt;
         num_err++;
         continue;
       }
-      Matrix<BaseFloat> cmvn_feat(feat.NumRows(),
-                                  feat.NumCols(), kUndefined);
-
-      SlidingWindowCmn(opts, feat, &cmvn_feat);
-      
-      feat_writer.Write(utt, cmvn_feat);
+      SlidingWindowCmnTask *task =
+          new SlidingWindowCmnTask(opts, utt, feat, &feat_writer);
+      if (pipeline != NULL) {
+        pipeline->Run(task);
+      } else {
+        (*task)();
+        delete task;  // writes the output.
+      }
       num_done++;
     }
+    delete pipeline;  // waits for the remaining tasks.
 
     KALDI_LOG << "Applied sliding-window cepstral mean "
               << (opts.normalize_variance ? "and variance " : "")
@@ -0,0 +1,116 @@
+// featbin/apply-feature-chain.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "feat/feature-transform-chain.h"
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+
+    const char *usage =
+        "Apply a chain of feature transformations (CMVN, splicing, global\n"
+        "transforms such as LDA and MLLT, fMLLR, deltas and subsampling) in a\n"
+        "single process, instead of a pipe of apply-cmvn, splice-feats,\n"
+        "transform-feats, add-deltas and subsample-feats.  The chain is given\n"
+        "as a string with the stages separated by ';'; see\n"
+        "feat/feature-transform-chain.h for the stages and their options.\n"
+        "Usage: apply-feature-chain [options] <chain-config> <feats-rspecifier> "
+        "<feats-wspecifier>\n"
+        "e.g.: apply-feature-chain --utt2spk=ark:data/test/utt2spk \\\n"
+        "  --cmvn-stats=scp:data/test/cmvn.scp --fmllr=ark:trans.1 \\\n"
+        "  'cmvn; splice left-context=3 right-context=3; "
+        "transform matrix=final.mat; fmllr' scp:data/test/feats.scp ark:-\n"
+        "See also: apply-cmvn, splice-feats, transform-feats, add-deltas\n";
+
+    ParseOptions po(usage);
+    std::string utt2spk_rspecifier, cmvn_rspecifier, fmllr_rspecifier;
+    po.Register("utt2spk", &utt2spk_rspecifier, "rspecifier for utterance to "
+                "speaker map, for the CMVN stats and the fMLLR transforms");
+    po.Register("cmvn-stats", &cmvn_rspecifier, "rspecifier for the CMVN "
+                "stats (needed if the chain has a cmvn stage)");
+    po.Register("fmllr", &fmllr_rspecifier, "rspecifier for the fMLLR "
+                "transforms (needed if the chain has a fmllr stage)");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string chain_config = po.GetArg(1),
+        feat_rspecifier = po.GetArg(2),
+        feat_wspecifier = po.GetArg(3);
+
+    FeatureTransformChain chain(chain_config);
+    KALDI_LOG << "Feature transform chain is: " << chain.Info();
+    if (chain.NeedsCmvnStats() && cmvn_rspecifier.empty())
+      KALDI_ERR << "The feature transform chain needs the --cmvn-stats option";
+    if (chain.NeedsFmllrTransform() && fmllr_rspecifier.empty())
+      KALDI_ERR << "The feature transform chain needs the --fmllr option";
+
+    SequentialBaseFloatMatrixReader feat_reader(feat_rspecifier);
+    BaseFloatMatrixWriter feat_writer(feat_wspecifier);
+    RandomAccessDoubleMatrixReaderMapped cmvn_reader;
+    if (chain.NeedsCmvnStats() &&
+        !cmvn_reader.Open(cmvn_rspecifier, utt2spk_rspecifier))
+      KALDI_ERR << "Error opening CMVN stats " << cmvn_rspecifier;
+    RandomAccessBaseFloatMatrixReaderMapped fmllr_reader;
+    if (chain.NeedsFmllrTransform() &&
+        !fmllr_reader.Open(fmllr_rspecifier, utt2spk_rspecifier))
+      KALDI_ERR << "Error opening fMLLR transforms " << fmllr_rspecifier;
+
+    int32 num_done = 0, num_err = 0;
+    for (; !feat_reader.Done(); feat_reader.Next()) {
+      std::string utt = feat_reader.Key();
+      const Matrix<BaseFloat> &feats = feat_reader.Value();
+      const Matrix<double> *cmvn_stats = NULL;
+      const Matrix<BaseFloat> *fmllr = NULL;
+      if (chain.NeedsCmvnStats()) {
+        if (!cmvn_reader.HasKey(utt)) {
+          KALDI_WARN << "No normalization statistics available for key "
+                     << utt << ", producing no output for this utterance";
+          num_err++;
+          continue;
+        }
+        cmvn_stats = &(cmvn_reader.Value(utt));
+      }
+      if (chain.NeedsFmllrTransform()) {
+        if (!fmllr_reader.HasKey(utt)) {
+          KALDI_WARN << "No fMLLR transform available for utterance "
+                     << utt << ", producing no output for this utterance";
+          num_err++;
+          continue;
+        }
+        fmllr = &(fmllr_reader.Value(utt));
+      }
+      Matrix<BaseFloat> output;
+      chain.Apply(feats, cmvn_stats, fmllr, &output);
+      feat_writer.Write(utt, output);
+      num_done++;
+    }
+    KALDI_LOG << "Applied feature transform chain to " << num_done
+              << " utterances; " << num_err << " had errors.";
+    return (num_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -22,14 +22,16 @@
 #include "util/common-utils.h"
 #include "feat/feature-fbank.h"
 #include "feat/wave-reader.h"
-
+#include "feat/segment-features.h"
 
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
     const char *usage =
         "Create Mel-filter bank (FBANK) feature files.\n"
-        "Usage:  compute-fbank-feats [options...] <wav-rspecifier> <feats-wspecifier>\n";
+        "Usage:  compute-fbank-feats [options...] <wav-rspecifier> <feats-wspecifier>\n"
+        "With --segments, <wav-rspecifier> gives the recordings, e.g.:\n"
+        " compute-fbank-feats --segments=segments scp:wav.scp ark:-\n";
 
     // construct all the global objects
     ParseOptions po(usage);
@@ -42,6 +44,8 @@ int main(int argc, char *argv[]) {
     BaseFloat min_duration = 0.0;
     // Define defaults for gobal options
     std::string output_format = "kaldi";
+    std::string segments_rxfilename;
+    SegmentFeatureOptions segment_opts;
 
     // Register the option struct
     fbank_opts.Register(&po);
@@ -53,6 +57,12 @@ int main(int argc, char *argv[]) {
     po.Register("utt2spk", &utt2spk_rspecifier, "Utterance to speaker-id map (if doing VTLN and you have warps per speaker)");
     po.Register("channel", &channel, "Channel to extract (-1 -> expect mono, 0 -> left, 1 -> right)");
     po.Register("min-duration", &min_duration, "Minimum duration of segments to process (in seconds).");
+    po.Register("segments", &segments_rxfilename, "Segments file (as for "
+                "extract-segments); if supplied, we compute the features "
+                "of the segments directly from the recordings in "
+                "<wav-rspecifier>, sharing the computation between "
+                "overlapping segments.");
+    segment_opts.Register(&po);
 
     // OPTION PARSING ..........................................................
     //
@@ -71,7 +81,6 @@ int main(int argc, char *argv[]) {
 
     Fbank fbank(fbank_opts);
 
-    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
     BaseFloatMatrixWriter kaldi_writer;  // typedef to TableWriter<something>.
     TableWriter<HtkMatrixHolder> htk_writer;
 
@@ -93,6 +102,35 @@ int main(int argc, char *argv[]) {
       KALDI_ERR << "Invalid output_format string " << output_format;
     }
 
+    uint16 htk_parm_kind = 007;  // FBANK
+    htk_parm_kind |= (fbank_opts.use_energy ? 0100 : 020000);  // energy or c0
+
+    if (segments_rxfilename != "") {
+      segment_opts.channel = channel;
+      segment_opts.vtln_warp = vtln_warp;
+      segment_opts.min_segment_length =
+          std::max(segment_opts.min_segment_length, min_duration);
+      SegmentFeatureReader<Fbank> segment_reader(
+          fbank_opts, segment_opts, wav_rspecifier, segments_rxfilename,
+          (vtln_map_rspecifier != "" ? &vtln_map_reader : NULL));
+      int32 num_success = 0;
+      for (; !segment_reader.Done(); segment_reader.Next()) {
+        std::string utt = segment_reader.Key();
+        Matrix<BaseFloat> features(segment_reader.Value());
+        WriteFeatures(utt, htk_parm_kind, subtract_mean, output_format,
+                      &features, &kaldi_writer, &htk_writer);
+        KALDI_VLOG(2) << "Processed features for key " << utt;
+        num_success++;
+      }
+      KALDI_LOG << "Computed " << segment_reader.NumFramesComputed()
+                << " frames of features for "
+                << segment_reader.NumFramesOutput() << " frames of segments.";
+      KALDI_LOG << " Done " << num_success << " out of "
+                << segment_reader.NumLines() << " segments.";
+      return (num_success != 0 ? 0 : 1);
+    }
+
+    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
     int32 num_utts = 0, num_success = 0;
     for (; !reader.Done(); reader.Next()) {
       num_utts++;
@@ -147,29 +185,8 @@ int main(int argc, char *argv[]) {
                    << utt;
         continue;
       }
-      if (subtract_mean) {
-        Vector<BaseFloat> mean(features.NumCols());
-        mean.AddRowSumMat(1.0, features);
-        mean.Scale(1.0 / features.NumRows());
-        for (int32 i = 0; i < features.NumRows(); i++)
-          features.Row(i).AddVec(-1.0, mean);
-      }
-      if (output_format == "kaldi") {
-        kaldi_writer.Write(utt, features);
-      } else {
-        std::pair<Matrix<BaseFloat>, HtkHeader> p;
-        p.first.Resize(features.NumRows(), features.NumCols());
-        p.first.CopyFromMat(features);
-        HtkHeader header = {
-          features.NumRows(),
-          100000,  // 10ms shift
-          static_cast<int16>(sizeof(float)*features.NumCols()),
-          static_cast<uint16>(007 | // FBANK
-          (fbank_opts.use_energy ? 0100 : 020000)) // energy; otherwise c0
-        };
-        p.second = header;
-        htk_writer.Write(utt, p);
-      }
+      WriteFeatures(utt, htk_parm_kind, subtract_mean, output_format,
+                    &features, &kaldi_writer, &htk_writer);
       if (num_utts % 10 == 0)
         KALDI_LOG << "Processed " << num_utts << " utterances";
       KALDI_VLOG(2) << "Processed features for key " << utt;
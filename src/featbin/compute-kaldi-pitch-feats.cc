@@ -22,6 +22,7 @@
 #include "util/common-utils.h"
 #include "feat/pitch-functions.h"
 #include "feat/wave-reader.h"
+#include "base/timer.h"
 
 
 int main(int argc, char *argv[]) {
@@ -62,6 +63,7 @@ int main(int argc, char *argv[]) {
     BaseFloatMatrixWriter feat_writer(feat_wspecifier);
 
     int32 num_done = 0, num_err = 0;
+    double tot_audio_secs = 0.0, tot_compute_secs = 0.0;
     for (; !wav_reader.Done(); wav_reader.Next()) {
       std::string utt = wav_reader.Key();  
       const WaveData &wave_data = wav_reader.Value(); 
@@ -95,7 +97,10 @@ int main(int argc, char *argv[]) {
       SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
       Matrix<BaseFloat> features;
       try {
+        Timer timer;
         ComputeKaldiPitch(pitch_opts, waveform, &features);
+        tot_compute_secs += timer.Elapsed();
+        tot_audio_secs += waveform.Dim() / wave_data.SampFreq();
       } catch (...) {
         KALDI_WARN << "Failed to compute pitch for utterance "
                    << utt;
@@ -110,6 +115,11 @@ int main(int argc, char *argv[]) {
     }
     KALDI_LOG << "Done " << num_done << " utterances, " << num_err
               << " with errors.";
+    if (tot_audio_secs > 0.0)
+      KALDI_LOG << "Pitch extraction took " << tot_compute_secs
+                << " seconds for " << tot_audio_secs << " seconds of audio; "
+                << "real-time factor is "
+                << (tot_compute_secs / tot_audio_secs);
     return (num_done != 0 ? 0 : 1);
   } catch(const std::exception &e) {
     std::cerr << e.what();
@@ -22,14 +22,16 @@
 #include "util/common-utils.h"
 #include "feat/feature-plp.h"
 #include "feat/wave-reader.h"
-
+#include "feat/segment-features.h"
 
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
     const char *usage =
         "Create PLP feature files.\n"
-        "Usage:  compute-plp-feats [options...] <wav-rspecifier> <feats-wspecifier>\n";
+        "Usage:  compute-plp-feats [options...] <wav-rspecifier> <feats-wspecifier>\n"
+        "With --segments, <wav-rspecifier> gives the recordings, e.g.:\n"
+        " compute-plp-feats --segments=segments scp:wav.scp ark:-\n";
 
     // construct all the global objects
     ParseOptions po(usage);
@@ -42,6 +44,8 @@ int main(int argc, char *argv[]) {
     BaseFloat min_duration = 0.0;
     // Define defaults for gobal options
     std::string output_format = "kaldi";
+    std::string segments_rxfilename;
+    SegmentFeatureOptions segment_opts;
 
     // Register the options
     po.Register("output-format", &output_format, "Format of the output "
@@ -58,6 +62,12 @@ int main(int argc, char *argv[]) {
                 "0 -> left, 1 -> right)");
     po.Register("min-duration", &min_duration, "Minimum duration of segments "
                 "to process (in seconds).");
+    po.Register("segments", &segments_rxfilename, "Segments file (as for "
+                "extract-segments); if supplied, we compute the features "
+                "of the segments directly from the recordings in "
+                "<wav-rspecifier>, sharing the computation between "
+                "overlapping segments.");
+    segment_opts.Register(&po);
 
     plp_opts.Register(&po);
 
@@ -74,7 +84,6 @@ int main(int argc, char *argv[]) {
 
     Plp plp(plp_opts);
 
-    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
     BaseFloatMatrixWriter kaldi_writer;  // typedef to TableWriter<something>.
     TableWriter<HtkMatrixHolder> htk_writer;
 
@@ -96,6 +105,35 @@ int main(int argc, char *argv[]) {
       KALDI_ERR << "Invalid output_format string " << output_format;
     }
 
+    // PLP, with c0 (there is no option to use energy in PLP).
+    uint16 htk_parm_kind = 013 | 020000;
+
+    if (segments_rxfilename != "") {
+      segment_opts.channel = channel;
+      segment_opts.vtln_warp = vtln_warp;
+      segment_opts.min_segment_length =
+          std::max(segment_opts.min_segment_length, min_duration);
+      SegmentFeatureReader<Plp> segment_reader(
+          plp_opts, segment_opts, wav_rspecifier, segments_rxfilename,
+          (vtln_map_rspecifier != "" ? &vtln_map_reader : NULL));
+      int32 num_success = 0;
+      for (; !segment_reader.Done(); segment_reader.Next()) {
+        std::string utt = segment_reader.Key();
+        Matrix<BaseFloat> features(segment_reader.Value());
+        WriteFeatures(utt, htk_parm_kind, subtract_mean, output_format,
+                      &features, &kaldi_writer, &htk_writer);
+        KALDI_VLOG(2) << "Processed features for key " << utt;
+        num_success++;
+      }
+      KALDI_LOG << "Computed " << segment_reader.NumFramesComputed()
+                << " frames of features for "
+                << segment_reader.NumFramesOutput() << " frames of segments.";
+      KALDI_LOG << " Done " << num_success << " out of "
+                << segment_reader.NumLines() << " segments.";
+      return (num_success != 0 ? 0 : 1);
+    }
+
+    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
     int32 num_utts = 0, num_success = 0;
     for (; !reader.Done(); reader.Next()) {
       num_utts++;
@@ -150,29 +188,8 @@ int main(int argc, char *argv[]) {
                    << utt;
         continue;
       }
-      if (subtract_mean) {
-        Vector<BaseFloat> mean(features.NumCols());
-        mean.AddRowSumMat(1.0, features);
-        mean.Scale(1.0 / features.NumRows());
-        for (size_t i = 0; i < features.NumRows(); i++)
-          features.Row(i).AddVec(-1.0, mean);
-      }
-      if (output_format == "kaldi") {
-        kaldi_writer.Write(utt, features);
-      } else {
-        std::pair<Matrix<BaseFloat>, HtkHeader> p;
-        p.first.Resize(features.NumRows(), features.NumCols());
-        p.first.CopyFromMat(features);
-        HtkHeader header = {
-          features.NumRows(),
-          100000,  // 10ms shift
-          static_cast<int16>(sizeof(float)*features.NumCols()),
-          013 | // PLP
-          020000 // C0 [no option currently to use energy in PLP.
-        };
-        p.second = header;
-        htk_writer.Write(utt, p);
-      }
+      WriteFeatures(utt, htk_parm_kind, subtract_mean, output_format,
+                    &features, &kaldi_writer, &htk_writer);
       if (num_utts % 10 == 0)
         KALDI_LOG << "Processed " << num_utts << " utterances";
       KALDI_VLOG(2) << "Processed features for key " << utt;
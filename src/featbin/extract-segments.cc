@@ -70,7 +70,9 @@ int main(int argc, char *argv[]) {
     std::string segments_rxfilename = po.GetArg(2);
     std::string wav_wspecifier = po.GetArg(3);
 
-    RandomAccessTableReader<WaveHolder> reader(wav_rspecifier);
+    // For recordings in a script file, this reads only the samples of each
+    // segment from the Wave file, rather than the whole recording.
+    WaveSegmentReader reader(wav_rspecifier);
     TableWriter<WaveHolder> writer(wav_wspecifier);
     Input ki(segments_rxfilename);  // no binary argment: never binary.
 
@@ -129,11 +131,9 @@ int main(int argc, char *argv[]) {
         continue;
       }
       
-      const WaveData &wave = reader.Value(recording);
-      const Matrix<BaseFloat> &wave_data = wave.Data();
-      BaseFloat samp_freq = wave.SampFreq();  // read sampling fequency
-      int32 num_samp = wave_data.NumCols(),  // number of samples in recording
-        num_chan = wave_data.NumRows();  // number of channels in recording
+      BaseFloat samp_freq = reader.SampFreq(recording);  // read sampling fequency
+      int32 num_samp = reader.NumSamples(recording),  // number of samples in recording
+        num_chan = reader.NumChannels(recording);  // number of channels in recording
 
       // Convert starting time of the segment to corresponding sample number.
       // If end time is -1 then use the whole file starting from start time.
@@ -185,9 +185,11 @@ int main(int argc, char *argv[]) {
         }
       }
       /*
-       * This function  return a portion of a wav data from the orignial wav data matrix 
+       * Read the samples of the segment from the recording.
        */
-      SubMatrix<BaseFloat> segment_matrix(wave_data, channel, 1, start_samp, end_samp-start_samp);
+      Matrix<BaseFloat> segment_matrix;
+      reader.ReadSamples(recording, start_samp, end_samp - start_samp, channel,
+                         &segment_matrix);
       WaveData segment_wave(samp_freq, segment_matrix);
       writer.Write(segment, segment_wave); // write segment in wave format.
       num_success++;
@@ -33,7 +33,10 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     bool binary = true;
+    int32 num_threads = 1;
     po.Register("binary", &binary, "If true, output stats in binary mode.");
+    po.Register("num-threads", &num_threads, "Number of threads to use in "
+                "accumulating the stats");
     po.Read(argc, argv);
 
     if (po.NumArgs() != 5) {
@@ -82,13 +85,15 @@ int main(int argc, char *argv[]) {
       const Matrix<BaseFloat> &feat_deriv = diff_reader.Value(key);
 
       if (feat_deriv.NumCols() == feat_in.NumCols()) { // Only direct derivative.
-        fmpe.AccStats(feat_in, gselect, feat_deriv, NULL, &fmpe_stats);
+        fmpe.AccStats(feat_in, gselect, feat_deriv, NULL, &fmpe_stats,
+                      num_threads);
       } else if (feat_deriv.NumCols() == feat_in.NumCols() * 2) { // +indirect.
         SubMatrix<BaseFloat> direct_deriv(feat_deriv, 0, feat_deriv.NumRows(),
                                           0, feat_in.NumCols()),
             indirect_deriv(feat_deriv, 0, feat_deriv.NumRows(),
                            feat_in.NumCols(), feat_in.NumCols());
-        fmpe.AccStats(feat_in, gselect, direct_deriv, &indirect_deriv, &fmpe_stats);
+        fmpe.AccStats(feat_in, gselect, direct_deriv, &indirect_deriv,
+                      &fmpe_stats, num_threads);
       } else {
         KALDI_ERR << "Mismatch in dimension of feature derivative.";
       }
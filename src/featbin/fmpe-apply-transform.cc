@@ -32,9 +32,11 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     bool add_to_features = true;
+    int32 num_threads = 1;
     po.Register("add-to-features", &add_to_features, "If true, add original "
                 "features to fMPE offsets (false useful for diagnostics)");
-    // no non-default options.
+    po.Register("num-threads", &num_threads, "Number of threads to use in "
+                "computing the fMPE offsets");
     po.Read(argc, argv);
 
     if (po.NumArgs() != 4) {
@@ -72,7 +74,7 @@ int main(int argc, char *argv[]) {
         continue;
       }
       Matrix<BaseFloat> feat_out(feat_in.NumRows(), feat_in.NumCols());
-      fmpe.ComputeFeatures(feat_in, gselect, &feat_out);
+      fmpe.ComputeFeatures(feat_in, gselect, &feat_out, num_threads);
       if (add_to_features) // feat_out += feat_in.
         feat_out.AddMat(1.0, feat_in, kNoTrans);
 
@@ -25,6 +25,92 @@
 #include "hmm/transition-model.h"
 #include "transform/hlda.h"
 #include "hmm/posterior.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+// This class is used to accumulate the HLDA stats of an utterance, in parallel
+// with other utterances.
+class HldaAccTask {
+ public:
+  HldaAccTask(const AmDiagGmm &am_gmm,
+              const TransitionModel &trans_model,
+              const Matrix<BaseFloat> &cur_transform,
+              const Matrix<BaseFloat> &feats,
+              const Posterior &posterior,
+              HldaAccsDiagGmm *hlda_accs,
+              double *tot_like,
+              double *tot_t,
+              int32 *num_accumulated):
+      am_gmm_(am_gmm), trans_model_(trans_model),
+      cur_transform_(cur_transform), feats_(feats), posterior_(posterior),
+      hlda_accs_(hlda_accs), tot_like_(tot_like), tot_t_(tot_t),
+      num_accumulated_(num_accumulated), tot_like_this_file_(0.0),
+      tot_weight_(0.0) { }
+
+  void operator () () {
+    // Compute transformed features (need them in order to compute
+    // Gaussian-level posteriors)
+    Matrix<BaseFloat> transformed_mat(feats_.NumRows(), am_gmm_.Dim());
+    transformed_mat.AddMatMat(1.0, feats_, kNoTrans, cur_transform_, kTrans,
+                              0.0);
+
+    Posterior pdf_posterior;
+    ConvertPosteriorToPdfs(trans_model_, posterior_, &pdf_posterior);
+    int32 num_rows = 0;
+    for (size_t i = 0; i < pdf_posterior.size(); i++)
+      num_rows += pdf_posterior[i].size();
+    // One row for each (frame, pdf) pair.
+    Matrix<BaseFloat> data(num_rows, feats_.NumCols(), kUndefined);
+    std::vector<int32> pdf_ids(num_rows);
+    std::vector<Vector<BaseFloat> > posteriors(num_rows);
+    int32 r = 0;
+    for (size_t i = 0; i < pdf_posterior.size(); i++) {
+      for (size_t j = 0; j < pdf_posterior[i].size(); j++, r++) {
+        int32 pdf_id = pdf_posterior[i][j].first;
+        BaseFloat weight = pdf_posterior[i][j].second;
+        const DiagGmm &gmm = am_gmm_.GetPdf(pdf_id);
+        tot_like_this_file_ +=
+            weight * gmm.ComponentPosteriors(transformed_mat.Row(i),
+                                             &(posteriors[r]));
+        tot_weight_ += weight;
+        posteriors[r].Scale(weight);
+        data.Row(r).CopyFromVec(feats_.Row(i));
+        pdf_ids[r] = pdf_id;
+      }
+    }
+    hlda_accs_->AccumulateFromPosteriors(am_gmm_, pdf_ids, data, posteriors);
+  }
+
+  ~HldaAccTask() {
+    // The destructors are called in order, one at a time.
+    KALDI_LOG << "Average like for this file is "
+              << (tot_like_this_file_/tot_weight_) << " over "
+              << tot_weight_ <<" frames.";
+    *tot_like_ += tot_like_this_file_;
+    *tot_t_ += tot_weight_;
+    (*num_accumulated_)++;
+    if (*num_accumulated_ % 10 == 0)
+      KALDI_LOG << "Avg like per frame so far is "
+                << (*tot_like_ / *tot_t_);
+  }
+ private:
+  const AmDiagGmm &am_gmm_;
+  const TransitionModel &trans_model_;
+  const Matrix<BaseFloat> &cur_transform_;
+  Matrix<BaseFloat> feats_;  // not a reference, since features come from a
+                             // Table and the reference we get from that is
+                             // not valid long-term.
+  Posterior posterior_;  // as above.
+  HldaAccsDiagGmm *hlda_accs_;
+  double *tot_like_;
+  double *tot_t_;
+  int32 *num_accumulated_;  // number of files done so far.
+  double tot_like_this_file_;
+  double tot_weight_;
+};
+
+}  // namespace kaldi
 
 
 
@@ -33,6 +119,7 @@ int main(int argc, char *argv[]) {
   try {
     const char *usage =
         "Accumulate HLDA statistics\n"
+        "Supports multiple threads (--num-threads).\n"
         "Usage:  gmm-acc-hlda [options] <model-in> <orig-transform-in> <orig-feature-rspecifier> <posteriors-rspecifier> <stats-out>\n"
         "Note: orig-transform-in must be the current truncated HLDA transform (e.g. from LDA)."
         "e.g.: \n"
@@ -41,8 +128,10 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     bool binary = true;
     BaseFloat speedup = 1.0;
+    TaskSequencerConfig sequencer_opts;
     po.Register("binary", &binary, "Write output in binary mode");
     po.Register("speedup", &speedup, "Proportion of data to accumulate full HLDA stats with");
+    sequencer_opts.Register(&po);
     po.Read(argc, argv);
 
     if (po.NumArgs() != 5) {
@@ -85,57 +174,31 @@ int main(int argc, char *argv[]) {
     RandomAccessPosteriorReader posteriors_reader(posteriors_rspecifier);
 
     int32 num_done = 0, num_no_posterior = 0, num_other_error = 0;
-    for (; !feature_reader.Done(); feature_reader.Next()) {
-      std::string key = feature_reader.Key();
-      if (!posteriors_reader.HasKey(key)) {
-        num_no_posterior++;
-      } else {
-        const Matrix<BaseFloat> &mat = feature_reader.Value();
-        const Posterior &posterior = posteriors_reader.Value(key);
-
-        // Compute transformed features (need them in order to compute
-        // Gaussian-level posteriors)
-        Matrix<BaseFloat> transformed_mat(mat.NumRows(), am_gmm.Dim());
-        transformed_mat.AddMatMat(1.0, mat, kNoTrans, cur_transform, kTrans, 0.0);
-
-        if (static_cast<int32>(posterior.size()) != mat.NumRows()) {
-          KALDI_WARN << "Posterior vector has wrong size "<< (posterior.size()) << " vs. "<< (mat.NumRows());
-          num_other_error++;
-          continue;
-        }
-
-        num_done++;
-        BaseFloat tot_like_this_file = 0.0, tot_weight = 0.0;
-
-        Posterior pdf_posterior;
-        ConvertPosteriorToPdfs(trans_model, posterior, &pdf_posterior);
-        for (size_t i = 0; i < posterior.size(); i++) {
-          for (size_t j = 0; j < pdf_posterior[i].size(); j++) {
-            int32 pdf_id = pdf_posterior[i][j].first;
-            BaseFloat weight = pdf_posterior[i][j].second;
-
-            Vector<BaseFloat> posteriors;
-            const DiagGmm &gmm = am_gmm.GetPdf(pdf_id);
-            tot_like_this_file +=
-                weight * gmm.ComponentPosteriors(transformed_mat.Row(i),
-                                                 &posteriors);
-            tot_weight += weight;
-            posteriors.Scale(weight);
-            hlda_accs.AccumulateFromPosteriors(pdf_id,
-                                               gmm,
-                                               mat.Row(i),
-                                               posteriors);
+    int32 num_accumulated = 0;  // files whose stats have been added.
+    {
+      TaskSequencer<HldaAccTask> sequencer(sequencer_opts);
+      for (; !feature_reader.Done(); feature_reader.Next()) {
+        std::string key = feature_reader.Key();
+        if (!posteriors_reader.HasKey(key)) {
+          num_no_posterior++;
+        } else {
+          const Matrix<BaseFloat> &mat = feature_reader.Value();
+          const Posterior &posterior = posteriors_reader.Value(key);
+
+          if (static_cast<int32>(posterior.size()) != mat.NumRows()) {
+            KALDI_WARN << "Posterior vector has wrong size "<< (posterior.size()) << " vs. "<< (mat.NumRows());
+            num_other_error++;
+            continue;
           }
+
+          num_done++;
+          sequencer.Run(new HldaAccTask(am_gmm, trans_model, cur_transform,
+                                        mat, posterior, &hlda_accs,
+                                        &tot_like, &tot_t,
+                                        &num_accumulated));
         }
-        KALDI_LOG << "Average like for this file is "
-                  << (tot_like_this_file/tot_weight) << " over "
-                  << tot_weight <<" frames.";
-        tot_like += tot_like_this_file;
-        tot_t += tot_weight;
-        if (num_done % 10 == 0)
-          KALDI_LOG << "Avg like per frame so far is "
-                    << (tot_like/tot_t);
       }
+      // destructor of "sequencer" will wait for any remaining tasks.
     }
 
     KALDI_LOG << "Done " << num_done << " files, " << num_no_posterior
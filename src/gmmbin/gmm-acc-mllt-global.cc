@@ -78,13 +78,14 @@ int main(int argc, char *argv[]) {
       const Matrix<BaseFloat> &mat = feature_reader.Value();      
       
       num_done++;
-      BaseFloat tot_like_this_file = 0.0, tot_weight = 0.0;
-      
+      BaseFloat tot_like_this_file = 0.0, tot_weight = mat.NumRows();
+      // We accumulate all the frames at once, which is faster.
+      std::vector<const DiagGmm*> gmms(mat.NumRows(), &gmm);
+      Vector<BaseFloat> weights(mat.NumRows());
+      weights.Set(1.0);
+
       if (gselect_rspecifier == "") {
-        for (int32 i = 0; i < mat.NumRows(); i++) {
-          tot_like_this_file += mllt_accs.AccumulateFromGmm(gmm, mat.Row(i), 1.0);
-          tot_weight += 1.0;
-        }
+        tot_like_this_file = mllt_accs.AccumulateFromGmms(gmms, mat, weights);
       } else {
         if (!gselect_reader.HasKey(utt)) {
           KALDI_WARN << "No gselect information for utterance " << utt;
@@ -99,12 +100,8 @@ int main(int argc, char *argv[]) {
           num_err++;
           continue;
         }
-        
-        for (int32 i = 0; i < mat.NumRows(); i++) {
-          tot_like_this_file += mllt_accs.AccumulateFromGmmPreselect(
-              gmm, gselect[i], mat.Row(i), 1.0);
-          tot_weight += 1.0;
-        }
+        tot_like_this_file = mllt_accs.AccumulateFromGmms(gmms, mat, weights,
+                                                          &gselect);
       }
       KALDI_LOG << "Average like for this file is "
                 << (tot_like_this_file/tot_weight) << " over "
@@ -25,6 +25,77 @@
 #include "hmm/transition-model.h"
 #include "transform/mllt.h"
 #include "hmm/posterior.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+// This class is used to accumulate the MLLT stats of an utterance, in
+// parallel with other utterances.
+class MlltAccTask {
+ public:
+  MlltAccTask(const AmDiagGmm &am_gmm,
+              const TransitionModel &trans_model,
+              const Matrix<BaseFloat> &feats,
+              const Posterior &posterior,
+              MlltAccs *mllt_accs,
+              double *tot_like,
+              double *tot_t,
+              int32 *num_accumulated):
+      am_gmm_(am_gmm), trans_model_(trans_model), feats_(feats),
+      posterior_(posterior), mllt_accs_(mllt_accs), tot_like_(tot_like),
+      tot_t_(tot_t), num_accumulated_(num_accumulated),
+      tot_like_this_file_(0.0), tot_weight_(0.0) { }
+
+  void operator () () {
+    Posterior pdf_posterior;
+    ConvertPosteriorToPdfs(trans_model_, posterior_, &pdf_posterior);
+    int32 num_rows = 0;
+    for (size_t i = 0; i < pdf_posterior.size(); i++)
+      num_rows += pdf_posterior[i].size();
+    // One row for each (frame, pdf) pair.
+    Matrix<BaseFloat> data(num_rows, feats_.NumCols(), kUndefined);
+    std::vector<const DiagGmm*> gmms(num_rows);
+    Vector<BaseFloat> weights(num_rows);
+    int32 r = 0;
+    for (size_t i = 0; i < pdf_posterior.size(); i++) {
+      for (size_t j = 0; j < pdf_posterior[i].size(); j++, r++) {
+        data.Row(r).CopyFromVec(feats_.Row(i));
+        gmms[r] = &(am_gmm_.GetPdf(pdf_posterior[i][j].first));
+        weights(r) = pdf_posterior[i][j].second;
+      }
+    }
+    tot_like_this_file_ = mllt_accs_->AccumulateFromGmms(gmms, data, weights);
+    tot_weight_ = weights.Sum();
+  }
+
+  ~MlltAccTask() {
+    // The destructors are called in order, one at a time.
+    KALDI_LOG << "Average like for this file is "
+              << (tot_like_this_file_/tot_weight_) << " over "
+              << tot_weight_ << " frames.";
+    *tot_like_ += tot_like_this_file_;
+    *tot_t_ += tot_weight_;
+    (*num_accumulated_)++;
+    if (*num_accumulated_ % 10 == 0)
+      KALDI_LOG << "Avg like per frame so far is "
+                << (*tot_like_ / *tot_t_);
+  }
+ private:
+  const AmDiagGmm &am_gmm_;
+  const TransitionModel &trans_model_;
+  Matrix<BaseFloat> feats_;  // not a reference, since features come from a
+                             // Table and the reference we get from that is
+                             // not valid long-term.
+  Posterior posterior_;  // as above.
+  MlltAccs *mllt_accs_;
+  double *tot_like_;
+  double *tot_t_;
+  int32 *num_accumulated_;  // number of files done so far.
+  double tot_like_this_file_;
+  double tot_weight_;
+};
+
+}  // namespace kaldi
 
 
 int main(int argc, char *argv[]) {
@@ -32,6 +103,7 @@ int main(int argc, char *argv[]) {
   try {
     const char *usage =
         "Accumulate MLLT (global STC) statistics\n"
+        "Supports multiple threads (--num-threads).\n"
         "Usage:  gmm-acc-mllt [options] <model-in> <feature-rspecifier> <posteriors-rspecifier> <stats-out>\n"
         "e.g.: \n"
         " gmm-acc-mllt 1.mdl scp:train.scp ark:1.post 1.macc\n";
@@ -39,9 +111,11 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     bool binary = true;
     BaseFloat rand_prune = 0.25;
+    TaskSequencerConfig sequencer_opts;
     po.Register("binary", &binary, "Write output in binary mode");
     po.Register("rand-prune", &rand_prune, "Randomized pruning parameter to speed up "
                 "accumulation (larger -> more pruning.  May exceed one).");
+    sequencer_opts.Register(&po);
     po.Read(argc, argv);
 
     if (po.NumArgs() != 4) {
@@ -75,45 +149,30 @@ int main(int argc, char *argv[]) {
     RandomAccessPosteriorReader posteriors_reader(posteriors_rspecifier);
 
     int32 num_done = 0, num_no_posterior = 0, num_other_error = 0;
-    for (; !feature_reader.Done(); feature_reader.Next()) {
-      std::string key = feature_reader.Key();
-      if (!posteriors_reader.HasKey(key)) {
-        num_no_posterior++;
-      } else {
-        const Matrix<BaseFloat> &mat = feature_reader.Value();
-        const Posterior &posterior = posteriors_reader.Value(key);
-
-        if (static_cast<int32>(posterior.size()) != mat.NumRows()) {
-          KALDI_WARN << "Posterior vector has wrong size "<< (posterior.size()) << " vs. "<< (mat.NumRows());
-          num_other_error++;
-          continue;
-        }
-
-        num_done++;
-        BaseFloat tot_like_this_file = 0.0, tot_weight = 0.0;
-
-        Posterior pdf_posterior;
-        ConvertPosteriorToPdfs(trans_model, posterior, &pdf_posterior);
-        for (size_t i = 0; i < posterior.size(); i++) {
-          for (size_t j = 0; j < pdf_posterior[i].size(); j++) {
-            int32 pdf_id = pdf_posterior[i][j].first;
-            BaseFloat weight = pdf_posterior[i][j].second;
-
-            tot_like_this_file += mllt_accs.AccumulateFromGmm(am_gmm.GetPdf(pdf_id),
-                                                              mat.Row(i),
-                                                              weight) * weight;
-            tot_weight += weight;
+    int32 num_accumulated = 0;  // files whose stats have been added.
+    {
+      TaskSequencer<MlltAccTask> sequencer(sequencer_opts);
+      for (; !feature_reader.Done(); feature_reader.Next()) {
+        std::string key = feature_reader.Key();
+        if (!posteriors_reader.HasKey(key)) {
+          num_no_posterior++;
+        } else {
+          const Matrix<BaseFloat> &mat = feature_reader.Value();
+          const Posterior &posterior = posteriors_reader.Value(key);
+
+          if (static_cast<int32>(posterior.size()) != mat.NumRows()) {
+            KALDI_WARN << "Posterior vector has wrong size "<< (posterior.size()) << " vs. "<< (mat.NumRows());
+            num_other_error++;
+            continue;
           }
+
+          num_done++;
+          sequencer.Run(new MlltAccTask(am_gmm, trans_model, mat, posterior,
+                                        &mllt_accs, &tot_like, &tot_t,
+                                        &num_accumulated));
         }
-        KALDI_LOG << "Average like for this file is "
-                  << (tot_like_this_file/tot_weight) << " over "
-                  << tot_weight << " frames.";
-        tot_like += tot_like_this_file;
-        tot_t += tot_weight;
-        if (num_done % 10 == 0)
-          KALDI_LOG << "Avg like per frame so far is "
-                    << (tot_like/tot_t);
       }
+      // destructor of "sequencer" will wait for any remaining tasks.
     }
 
     KALDI_LOG << "Done " << num_done << " files, " << num_no_posterior
@@ -38,6 +38,9 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     po.Register("binary", &binary, "Write output in binary mode");
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads, "Number of threads to use in "
+                "inverting and processing the statistics");
 
     po.Read(argc, argv);
 
@@ -79,7 +82,8 @@ int main(int argc, char *argv[]) {
                                     hlda_accs.FeatureDim());
 
     BaseFloat objf_impr, count;
-    hlda_accs.Update(&am_gmm, &hlda_mat_full, &hlda_mat_part, &objf_impr, &count);
+    hlda_accs.Update(&am_gmm, &hlda_mat_full, &hlda_mat_part, &objf_impr, &count,
+                     num_threads);
 
     KALDI_LOG << "Updated HLDA, total objf impr is " << (objf_impr/count)
               << " over " << count << " frames, logdet is "
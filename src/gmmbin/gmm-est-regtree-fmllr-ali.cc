@@ -44,6 +44,9 @@ int main(int argc, char *argv[]) {
     po.Register("spk2utt", &spk2utt_rspecifier, "rspecifier for speaker to "
                 "utterance-list map");
     po.Register("binary", &binary, "Write output in binary mode");
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads, "Number of threads to use in "
+                "estimating the transforms of the different classes");
     // register other modules
     RegtreeFmllrOptions opts;
     opts.Register(&po);
@@ -117,11 +120,13 @@ int main(int argc, char *argv[]) {
           }
 
           BaseFloat file_like = 0.0;
-          for (size_t i = 0; i < alignment.size(); i++) {
-            int32 pdf_id = trans_model.TransitionIdToPdf(alignment[i]);
-            file_like += fmllr_accs.AccumulateForGmm(regtree, am_gmm,
-                feats.Row(i), pdf_id, 1.0);
-          }
+          vector<vector<std::pair<int32, BaseFloat> > > pdf_post(
+              alignment.size());
+          for (size_t i = 0; i < alignment.size(); i++)
+            pdf_post[i].push_back(std::make_pair(
+                trans_model.TransitionIdToPdf(alignment[i]), 1.0));
+          file_like += fmllr_accs.AccumulateForUtterance(regtree, am_gmm, feats,
+                                                         pdf_post);
           KALDI_VLOG(2) << "Average like for this file is " << (file_like
               / alignment.size()) << " over " << alignment.size()
               << " frames.\n";
@@ -132,7 +137,8 @@ int main(int argc, char *argv[]) {
               << "Avg like per frame so far is " << (tot_like / tot_t) << '\n';
         }  // end looping over all utterances of the current speaker
         BaseFloat objf_impr, t;
-        fmllr_accs.Update(regtree, opts, &fmllr_xforms, &objf_impr, &t);
+        fmllr_accs.Update(regtree, opts, &fmllr_xforms, &objf_impr, &t,
+                          num_threads);
         KALDI_LOG << "fMLLR objf improvement for speaker " << spk << " is "
                   << (objf_impr/(t+1.0e-10)) << " per frame over " << t
                   << " frames.";
@@ -163,11 +169,13 @@ int main(int argc, char *argv[]) {
         num_done++;
         BaseFloat file_like = 0.0;
         fmllr_accs.SetZero();
-        for (size_t i = 0; i < alignment.size(); i++) {
-          int32 pdf_id = trans_model.TransitionIdToPdf(alignment[i]);
-          file_like += fmllr_accs.AccumulateForGmm(regtree, am_gmm,
-              feats.Row(i), pdf_id, 1.0);
-        }
+        vector<vector<std::pair<int32, BaseFloat> > > pdf_post(
+            alignment.size());
+        for (size_t i = 0; i < alignment.size(); i++)
+          pdf_post[i].push_back(std::make_pair(
+              trans_model.TransitionIdToPdf(alignment[i]), 1.0));
+        file_like += fmllr_accs.AccumulateForUtterance(regtree, am_gmm, feats,
+                                                       pdf_post);
         KALDI_VLOG(2) << "Average like for this file is " << (file_like
             / alignment.size()) << " over " << alignment.size() << " frames.";
         tot_like += file_like;
@@ -175,7 +183,8 @@ int main(int argc, char *argv[]) {
         if (num_done % 10 == 0) KALDI_VLOG(1)
             << "Avg like per frame so far is " << (tot_like / tot_t);
         BaseFloat objf_impr, t;
-        fmllr_accs.Update(regtree, opts, &fmllr_xforms, &objf_impr, &t);
+        fmllr_accs.Update(regtree, opts, &fmllr_xforms, &objf_impr, &t,
+                          num_threads);
         KALDI_LOG << "fMLLR objf improvement for utterance " << key << " is "
                   << (objf_impr/(t+1.0e-10)) << " per frame over " << t
                   << " frames.";
@@ -46,6 +46,9 @@ int main(int argc, char *argv[]) {
     po.Register("spk2utt", &spk2utt_rspecifier, "rspecifier for speaker to "
                 "utterance-list map");
     po.Register("binary", &binary, "Write output in binary mode");
+    int32 num_threads = 1;
+    po.Register("num-threads", &num_threads, "Number of threads to use in "
+                "estimating the transforms of the different classes");
     // register other modules
     RegtreeMllrOptions opts;
     opts.Register(&po);
@@ -120,16 +123,11 @@ int main(int argc, char *argv[]) {
           BaseFloat file_like = 0.0, file_t = 0.0;
           Posterior pdf_posterior;
           ConvertPosteriorToPdfs(trans_model, posterior, &pdf_posterior);
-          for (size_t i = 0; i < posterior.size(); i++) {
-            for (size_t j = 0; j < pdf_posterior[i].size(); j++) {
-              int32 pdf_id = pdf_posterior[i][j].first;
-              BaseFloat prob = pdf_posterior[i][j].second;
-              file_like += mllr_accs.AccumulateForGmm(regtree, am_gmm,
-                                                      feats.Row(i), pdf_id,
-                                                      prob);
-              file_t += prob;
-            }
-          }
+          for (size_t i = 0; i < pdf_posterior.size(); i++)
+            for (size_t j = 0; j < pdf_posterior[i].size(); j++)
+              file_t += pdf_posterior[i][j].second;
+          file_like += mllr_accs.AccumulateForUtterance(regtree, am_gmm, feats,
+                                                        pdf_posterior);
           KALDI_VLOG(2) << "Average like for this file is " << (file_like/file_t)
                         << " over " << file_t << " frames.";
           tot_like += file_like;
@@ -140,7 +138,8 @@ int main(int argc, char *argv[]) {
                           << (tot_like / tot_t);
         }  // end looping over all utterances of the current speaker
         BaseFloat objf_impr, t;
-        mllr_accs.Update(regtree, opts, &mllr_xforms, &objf_impr, &t);
+        mllr_accs.Update(regtree, opts, &mllr_xforms, &objf_impr, &t,
+                         num_threads);
         KALDI_LOG << "MLLR objf improvement for speaker " << spk << " is "
                   << (objf_impr/(t+1.0e-10)) << " per frame over " << t
                   << " frames.";
@@ -173,16 +172,11 @@ int main(int argc, char *argv[]) {
         mllr_accs.SetZero();
         Posterior pdf_posterior;
         ConvertPosteriorToPdfs(trans_model, posterior, &pdf_posterior);
-        for (size_t i = 0; i < posterior.size(); i++) {
-          for (size_t j = 0; j < pdf_posterior[i].size(); j++) {
-            int32 pdf_id = pdf_posterior[i][j].first;
-            BaseFloat prob = pdf_posterior[i][j].second;
-            file_like += mllr_accs.AccumulateForGmm(regtree, am_gmm,
-                                                    feats.Row(i), pdf_id,
-                                                    prob);
-            file_t += prob;
-          }
-        }
+        for (size_t i = 0; i < pdf_posterior.size(); i++)
+          for (size_t j = 0; j < pdf_posterior[i].size(); j++)
+            file_t += pdf_posterior[i][j].second;
+        file_like += mllr_accs.AccumulateForUtterance(regtree, am_gmm, feats,
+                                                      pdf_posterior);
         KALDI_VLOG(2) << "Average like for this file is " << (file_like/file_t)
                       << " over " << file_t << " frames.";
         tot_like += file_like;
@@ -190,7 +184,8 @@ int main(int argc, char *argv[]) {
         if (num_done % 10 == 0)
           KALDI_VLOG(1) << "Avg like per frame so far is " << (tot_like / tot_t);
         BaseFloat objf_impr, t;
-        mllr_accs.Update(regtree, opts, &mllr_xforms, &objf_impr, &t);
+        mllr_accs.Update(regtree, opts, &mllr_xforms, &objf_impr, &t,
+                         num_threads);
         KALDI_LOG << "MLLR objf improvement for utterance " << key << " is "
                   << (objf_impr/(t+1.0e-10)) << " per frame over " << t
                   << " frames.";
@@ -42,7 +42,10 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     bool binary = true;
     std::string model_derivative_rxfilename;
+    int32 num_threads = 1;
     po.Register("binary", &binary, "If true, write stats in binary mode.");
+    po.Register("num-threads", &num_threads, "Number of threads to use in "
+                "computing the fMPE features and accumulating the stats");
     po.Register("model-derivative", &model_derivative_rxfilename,
                 "GMM-accs file containing model derivative [note: contains no transition stats].  Used for indirect differential.  Warning: this will only work correctly in the case of MMI/BMMI objective function, with non-canceled stats.");
     po.Read(argc, argv);
@@ -119,7 +122,7 @@ int main(int argc, char *argv[]) {
       
       num_done++;
       Matrix<BaseFloat> fmpe_feat(feat_in.NumRows(), feat_in.NumCols());
-      fmpe.ComputeFeatures(feat_in, gselect, &fmpe_feat);
+      fmpe.ComputeFeatures(feat_in, gselect, &fmpe_feat, num_threads);
       fmpe_feat.AddMat(1.0, feat_in);
       
       Matrix<BaseFloat> direct_deriv, indirect_deriv;
@@ -131,7 +134,8 @@ int main(int argc, char *argv[]) {
       num_frames += feat_in.NumRows();
 
       fmpe.AccStats(feat_in, gselect, direct_deriv,
-                    (have_indirect ? &indirect_deriv : NULL), &fmpe_stats);
+                    (have_indirect ? &indirect_deriv : NULL), &fmpe_stats,
+                    num_threads);
       
       if (num_done % 100 == 0)
         KALDI_LOG << "Processed " << num_done << " utterances.";
@@ -30,6 +30,7 @@
 #include "gmm/decodable-am-diag-gmm.h"
 #include "base/timer.h"
 #include "feat/feature-functions.h"  // feature reversal
+#include "feat/feature-reader.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -42,15 +43,23 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Generate lattices using GMM-based model.\n"
         "Usage: gmm-latgen-faster [options] model-in (fst-in|fsts-rspecifier) features-rspecifier"
-        " lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n";
+        " lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n"
+        "If --feature-type is set, features-rspecifier is instead a wav\n"
+        "rspecifier and the features are computed on the fly, e.g.:\n"
+        " gmm-latgen-faster --feature-type=mfcc --mfcc-config=conf/mfcc.conf \\\n"
+        "   --feature-chain='cmvn; deltas' --cmvn-stats=scp:data/test/cmvn.scp \\\n"
+        "   --utt2spk=ark:data/test/utt2spk final.mdl HCLG.fst \\\n"
+        "   scp:data/test/wav.scp ark:lat.ark\n";
     ParseOptions po(usage);
     Timer timer;
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
+    FeatureReaderOptions feature_opts;
     
     std::string word_syms_filename;
     config.Register(&po);
+    feature_opts.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale,
                 "Scaling factor for acoustic likelihoods");
     po.Register("word-symbol-table", &word_syms_filename,
@@ -104,7 +113,7 @@ int main(int argc, char *argv[]) {
     int num_done = 0, num_err = 0;
 
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
-      SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+      SequentialFeatureReader feature_reader(feature_opts, feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
       VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
       
@@ -136,10 +145,13 @@ int main(int argc, char *argv[]) {
           } else num_err++;
         }
       }
+      // Utterances we could not compute features for.
+      num_err += feature_reader.NumErrors();
       delete decode_fst; // delete this only after decoder goes out of scope.
     } else { // We have different FSTs for different utterances.
       SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
-      RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);          
+      RandomAccessFeatureReader feature_reader(feature_opts,
+                                               feature_rspecifier);
       for (; !fst_reader.Done(); fst_reader.Next()) {
         std::string utt = fst_reader.Key();
         if (!feature_reader.HasKey(utt)) {
@@ -0,0 +1,129 @@
+// ivector/voice-activity-detection-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ivector/voice-activity-detection.h"
+
+
+namespace kaldi {
+
+// Gives the rows of a matrix as features, with the number of frames ready
+// set by the test, to simulate the input arriving a piece at a time.
+class TestFeature: public OnlineFeatureInterface {
+ public:
+  explicit TestFeature(const Matrix<BaseFloat> &feats):
+      feats_(feats), num_ready_(0) { }
+  virtual int32 Dim() const { return feats_.NumCols(); }
+  virtual int32 NumFramesReady() const { return num_ready_; }
+  virtual bool IsLastFrame(int32 frame) const {
+    return frame == feats_.NumRows() - 1;
+  }
+  virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
+    KALDI_ASSERT(frame < num_ready_);
+    feat->CopyFromVec(feats_.Row(frame));
+  }
+  void SetNumReady(int32 num_ready) { num_ready_ = num_ready; }
+ private:
+  Matrix<BaseFloat> feats_;
+  int32 num_ready_;
+};
+
+void UnitTestOnlineVadEnergy() {
+  // Log-energies with a few regions of low energy.
+  int32 num_frames = 100 + Rand() % 500;
+  Matrix<BaseFloat> feats(num_frames, 3);
+  feats.SetRandn();
+  for (int32 t = 0; t < num_frames; t++)
+    feats(t, 0) = 15.0 + feats(t, 0);
+  for (int32 n = 0; n < 3; n++) {
+    int32 start = Rand() % num_frames,
+        end = std::min(num_frames, start + Rand() % 100);
+    for (int32 t = start; t < end; t++)
+      feats(t, 0) -= 10.0;
+  }
+
+  OnlineVadEnergyConfig config;
+  config.vad_padding = Rand() % 15;
+  if (Rand() % 2 == 0)
+    config.vad_opts.vad_energy_mean_scale = 0.0;
+  int32 context = config.vad_opts.vad_frames_context,
+      padding = config.vad_padding;
+
+  // With the whole input, check that frames are judged to be non-speech iff
+  // there are no voiced frames within "padding" frames of them.  With no
+  // mean term in the threshold, the voiced frames are as for
+  // ComputeVadEnergy() [but with the window as documented].
+  Vector<BaseFloat> voiced(num_frames);
+  for (int32 t = 0; t < num_frames; t++) {
+    BaseFloat threshold = config.vad_opts.vad_energy_threshold;
+    int32 end = std::min(t + context, num_frames - 1);
+    if (config.vad_opts.vad_energy_mean_scale != 0.0)
+      threshold += config.vad_opts.vad_energy_mean_scale *
+          feats.Range(0, end + 1, 0, 1).Sum() / (end + 1);
+    int32 num_count = 0, den_count = 0;
+    for (int32 t2 = std::max(0, t - context); t2 <= end; t2++) {
+      den_count++;
+      if (feats(t2, 0) > threshold)
+        num_count++;
+    }
+    voiced(t) = (num_count >= den_count *
+                 config.vad_opts.vad_proportion_threshold ? 1.0 : 0.0);
+  }
+  TestFeature all_input(feats);
+  all_input.SetNumReady(num_frames);
+  OnlineVadEnergy vad(config, &all_input);
+  KALDI_ASSERT(vad.NumFramesReady() == num_frames);
+  Vector<BaseFloat> output(num_frames);
+  for (int32 t = 0; t < num_frames; t++) {
+    bool any_voiced = false;
+    for (int32 t2 = std::max(0, t - padding);
+         t2 <= std::min(num_frames - 1, t + padding); t2++)
+      if (voiced(t2) != 0.0) any_voiced = true;
+    SubVector<BaseFloat> frame(output, t, 1);
+    vad.GetFrame(t, &frame);
+    KALDI_ASSERT(output(t) == (any_voiced ? 1.0 : 0.0));
+    KALDI_ASSERT(vad.IsNonSpeech(t) == !any_voiced);
+  }
+
+  // Check that the output does not depend on how the input arrives.
+  TestFeature input(feats);
+  OnlineVadEnergy online_vad(config, &input);
+  int32 num_ready = 0, num_done = 0;
+  while (num_done < num_frames) {
+    num_ready = std::min(num_frames, num_ready + Rand() % 20);
+    input.SetNumReady(num_ready);
+    int32 vad_ready = online_vad.NumFramesReady();
+    if (num_ready < num_frames)
+      KALDI_ASSERT(vad_ready == std::max(0, num_ready - context - padding));
+    else
+      KALDI_ASSERT(vad_ready == num_frames);
+    for (; num_done < vad_ready; num_done++) {
+      Vector<BaseFloat> frame(1);
+      online_vad.GetFrame(num_done, &frame);
+      KALDI_ASSERT(frame(0) == output(num_done));
+    }
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 20; i++)
+    UnitTestOnlineVadEnergy();
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -18,6 +18,8 @@
 // limitations under the License.
 
 
+#include <algorithm>
+
 #include "ivector/voice-activity-detection.h"
 #include "matrix/matrix-functions.h"
 
@@ -62,4 +64,82 @@ void ComputeVadEnergy(const VadEnergyOptions &opts,
   }
 }  
 
+
+OnlineVadEnergy::OnlineVadEnergy(const OnlineVadEnergyConfig &config,
+                                 OnlineFeatureInterface *src):
+    config_(config), src_(src) {
+  const VadEnergyOptions &opts = config_.vad_opts;
+  KALDI_ASSERT(opts.vad_frames_context >= 0 && config_.vad_padding >= 0);
+  KALDI_ASSERT(opts.vad_energy_mean_scale >= 0.0);
+  KALDI_ASSERT(opts.vad_proportion_threshold > 0.0 &&
+               opts.vad_proportion_threshold < 1.0);
+}
+
+int32 OnlineVadEnergy::NumVoicedDecisionsReady() const {
+  int32 src_ready = src_->NumFramesReady();
+  if (src_ready == 0 || src_->IsLastFrame(src_ready - 1))
+    return src_ready;
+  return std::max<int32>(0, src_ready - config_.vad_opts.vad_frames_context);
+}
+
+int32 OnlineVadEnergy::NumFramesReady() const {
+  int32 src_ready = src_->NumFramesReady();
+  if (src_ready == 0 || src_->IsLastFrame(src_ready - 1))
+    return src_ready;
+  return std::max<int32>(0, src_ready - config_.vad_opts.vad_frames_context -
+                         config_.vad_padding);
+}
+
+void OnlineVadEnergy::Update() {
+  int32 src_ready = src_->NumFramesReady();
+  if (static_cast<int32>(energies_.size()) < src_ready) {
+    Vector<BaseFloat> feat(src_->Dim());
+    for (int32 t = energies_.size(); t < src_ready; t++) {
+      src_->GetFrame(t, &feat);
+      energies_.push_back(feat(0));
+      energy_sums_.push_back(feat(0) + (t > 0 ? energy_sums_[t - 1] : 0.0));
+    }
+  }
+  const VadEnergyOptions &opts = config_.vad_opts;
+  int32 context = opts.vad_frames_context,
+      decisions_ready = NumVoicedDecisionsReady();
+  for (int32 t = num_voiced_.size(); t < decisions_ready; t++) {
+    // If the input is not finished, t + context < src_ready.
+    int32 end = std::min(t + context, src_ready - 1);
+    BaseFloat energy_threshold = opts.vad_energy_threshold +
+        opts.vad_energy_mean_scale * energy_sums_[end] / (end + 1);
+    int32 num_count = 0, den_count = 0;
+    for (int32 t2 = std::max(0, t - context); t2 <= end; t2++) {
+      den_count++;
+      if (energies_[t2] > energy_threshold)
+        num_count++;
+    }
+    bool voiced = (num_count >= den_count * opts.vad_proportion_threshold);
+    num_voiced_.push_back((t > 0 ? num_voiced_[t - 1] : 0) + (voiced ? 1 : 0));
+  }
+  // If the input is not finished, we have the voiced decisions up to frame
+  // t + padding for all the ready frames t.
+  int32 padding = config_.vad_padding, frames_ready = NumFramesReady(),
+      last_decision = static_cast<int32>(num_voiced_.size()) - 1;
+  for (int32 t = non_speech_.size(); t < frames_ready; t++) {
+    int32 begin = t - padding, end = std::min(t + padding, last_decision);
+    int32 count = num_voiced_[end] - (begin > 0 ? num_voiced_[begin - 1] : 0);
+    non_speech_.push_back(count == 0);
+  }
+}
+
+bool OnlineVadEnergy::IsNonSpeech(int32 frame) {
+  KALDI_ASSERT(frame >= 0);
+  if (frame >= static_cast<int32>(non_speech_.size())) {
+    Update();
+    KALDI_ASSERT(frame < static_cast<int32>(non_speech_.size()));
+  }
+  return non_speech_[frame];
+}
+
+void OnlineVadEnergy::GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
+  KALDI_ASSERT(feat->Dim() == 1);
+  (*feat)(0) = (IsNonSpeech(frame) ? 0.0 : 1.0);
+}
+
 }
@@ -29,6 +29,7 @@
 #include "matrix/matrix-lib.h"
 #include "util/common-utils.h"
 #include "base/kaldi-error.h"
+#include "itf/online-feature-itf.h"
 
 namespace kaldi {
 
@@ -37,6 +38,8 @@ namespace kaldi {
   This code is geared toward speaker-id applications and is not suitable
   for automatic speech recognition (ASR) because it makes independent
   decisions for each frame without imposing any notion of continuity.
+  (Class OnlineVadEnergy, below, adds a continuity constraint so that it
+  can be used in ASR to find long non-speech regions.)
 */
  
 struct VadEnergyOptions {
@@ -82,6 +85,82 @@ void ComputeVadEnergy(const VadEnergyOptions &opts,
                       Vector<BaseFloat> *output_voiced);
 
 
+struct OnlineVadEnergyConfig {
+  VadEnergyOptions vad_opts;
+  // A frame is only judged to be non-speech if there is no voiced frame within
+  // this many frames of it.
+  int32 vad_padding;
+
+  OnlineVadEnergyConfig(): vad_padding(10) { }
+
+  void Register(OptionsItf *opts) {
+    vad_opts.Register(opts);
+    opts->Register("vad-padding", &vad_padding, "A frame is only judged to "
+                   "be non-speech if there are no voiced frames within this "
+                   "many frames of it.");
+  }
+};
+
+/**
+   OnlineVadEnergy is an online version of ComputeVadEnergy(), for use in
+   online decoding to find long regions of non-speech.  It looks at the first
+   coefficient of the source features (assumed to be a log-energy or something
+   similar), and decides whether each frame is voiced in the same way as
+   ComputeVadEnergy(), except that the mean log-energy in the threshold is the
+   mean over frames zero through t + vad-frames-context, since we don't have
+   the whole file.  Its output is one-dimensional: 0.0 for frames that have no
+   voiced frames within opts.vad_padding frames of them, and 1.0 otherwise.
+   So the output for frame t is ready once the source has frame
+   t + vad-frames-context + vad-padding, and it does not depend on how the
+   input arrives.
+*/
+class OnlineVadEnergy: public OnlineFeatureInterface {
+ public:
+  /// "src" is not owned here.
+  OnlineVadEnergy(const OnlineVadEnergyConfig &config,
+                  OnlineFeatureInterface *src);
+
+  virtual int32 Dim() const { return 1; }
+
+  virtual int32 NumFramesReady() const;
+
+  virtual bool IsLastFrame(int32 frame) const {
+    return src_->IsLastFrame(frame);
+  }
+
+  virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
+
+  /// Returns true if the output for this frame is 0.0, i.e. it is in a region
+  /// of non-speech.
+  bool IsNonSpeech(int32 frame);
+
+ private:
+  // Returns the number of frames for which we can decide whether they are
+  // voiced.
+  int32 NumVoicedDecisionsReady() const;
+
+  // Gets the log-energies of any new source frames, decides whether any new
+  // frames are voiced, and then whether any newly ready frames are
+  // non-speech.
+  void Update();
+
+  OnlineVadEnergyConfig config_;
+  OnlineFeatureInterface *src_;
+
+  // The log-energies of the source frames we have seen, and their running
+  // sums: energy_sums_[t] is the sum of the log-energies of frames zero
+  // through t.
+  std::vector<BaseFloat> energies_;
+  std::vector<double> energy_sums_;
+  // num_voiced_[t] is the number of frames zero through t that we decided are
+  // voiced.
+  std::vector<int32> num_voiced_;
+  // non_speech_[t] is true if the output for frame t is 0.0; it is set once
+  // frame t is ready.
+  std::vector<bool> non_speech_;
+};
+
+
 }  // namespace kaldi
 
 
@@ -19,9 +19,11 @@
 
 
 #include "base/kaldi-common.h"
+#include "base/timer.h"
 #include "util/common-utils.h"
 #include "gmm/am-diag-gmm.h"
 #include "ivector/ivector-extractor.h"
+#include "thread/kaldi-affinity.h"
 #include "thread/kaldi-task-sequence.h"
 
 
@@ -32,25 +34,32 @@ namespace kaldi {
 // in parallel.
 class IvectorTask {
  public:
-  IvectorTask(const IvectorExtractor &extractor,
+  IvectorTask(const NumaReplicated<IvectorExtractor> &extractor,
               const Matrix<BaseFloat> &features,
               const Posterior &posterior,
-              IvectorExtractorStats *stats): extractor_(extractor),
+              IvectorExtractorStats *stats,
+              NumaTimingStats *timing_stats): extractor_(extractor),
                                     features_(features),
                                     posterior_(posterior),
-                                    stats_(stats) { }
+                                    stats_(stats),
+                                    timing_stats_(timing_stats) { }
 
   void operator () () {
-    stats_->AccStatsForUtterance(extractor_, features_, posterior_);
+    Timer timer;
+    int32 start_cpu = CurrentCpu();
+    // Get() gives the copy of the extractor on this thread's NUMA node.
+    stats_->AccStatsForUtterance(extractor_.Get(), features_, posterior_);
+    timing_stats_->AddTask(start_cpu, timer.Elapsed());
   }
   ~IvectorTask() { }  // the destructor doesn't have to do anything.
  private:
-  const IvectorExtractor &extractor_;
+  const NumaReplicated<IvectorExtractor> &extractor_;
   Matrix<BaseFloat> features_; // not a reference, since features come from a
                                // Table and the reference we get from that is
                                // not valid long-term.
   Posterior posterior_;  // as above.
   IvectorExtractorStats *stats_;
+  NumaTimingStats *timing_stats_;
 };
 
 
@@ -113,10 +122,16 @@ int main(int argc, char *argv[]) {
     ReadKaldiObject(ivector_extractor_rxfilename, &extractor);
     
     IvectorExtractorStats stats(extractor, stats_opts);
+
+    // If the threads are pinned to CPUs, keep a copy of the extractor on each
+    // NUMA node, so the threads don't read it from another node's memory.
+    NumaReplicated<IvectorExtractor> extractor_replicas(
+        extractor, sequencer_opts.thread_affinity != "none");
     
     
     int64 tot_t = 0;
     int32 num_done = 0, num_err = 0;
+    NumaTimingStats timing_stats;
     
     {
       TaskSequencer<IvectorTask> sequencer(sequencer_opts);
@@ -139,7 +154,8 @@ int main(int argc, char *argv[]) {
           continue;
         }
 
-        sequencer.Run(new IvectorTask(extractor, mat, posterior, &stats));
+        sequencer.Run(new IvectorTask(extractor_replicas, mat, posterior,
+                                      &stats, &timing_stats));
 
         tot_t += posterior.size();
         num_done++;
@@ -147,6 +163,7 @@ int main(int argc, char *argv[]) {
       // destructor of "sequencer" will wait for any remaining tasks that
       // have not yet completed.
     }
+    timing_stats.Print("accumulating stats");
     
     KALDI_LOG << "Done " << num_done << " files, " << num_err
               << " with errors.  Total frames " << tot_t;
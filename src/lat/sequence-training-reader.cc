@@ -0,0 +1,103 @@
+// lat/sequence-training-reader.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/sequence-training-reader.h"
+#include "lat/lattice-functions.h"
+
+namespace kaldi {
+
+SequenceTrainingReader::SequenceTrainingReader(
+    SequentialBaseFloatMatrixReader *feature_reader,
+    RandomAccessLatticeReader *den_lat_reader,
+    RandomAccessInt32VectorReader *ali_reader,
+    BaseFloat old_acoustic_scale,
+    int32 max_frames,
+    int32 num_prefetch):
+    feature_reader_(feature_reader), den_lat_reader_(den_lat_reader),
+    ali_reader_(ali_reader), old_acoustic_scale_(old_acoustic_scale),
+    max_frames_(max_frames), num_no_den_lat_(0), num_no_ali_(0),
+    num_other_error_(0), reader_(this, num_prefetch) { }
+
+bool SequenceTrainingReader::Read(SequenceTrainingUtterance *eg) {
+  for (; !feature_reader_->Done(); feature_reader_->Next()) {
+    std::string utt = feature_reader_->Key();
+    if (!den_lat_reader_->HasKey(utt)) {
+      KALDI_WARN << "Utterance " << utt << ": found no lattice.";
+      num_no_den_lat_++;
+      continue;
+    }
+    if (!ali_reader_->HasKey(utt)) {
+      KALDI_WARN << "Utterance " << utt << ": found no reference alignment.";
+      num_no_ali_++;
+      continue;
+    }
+
+    // 1) get the features, numerator alignment
+    const Matrix<BaseFloat> &mat = feature_reader_->Value();
+    const std::vector<int32> &ali = ali_reader_->Value(utt);
+    // check for temporal length of numerator alignments
+    if (static_cast<MatrixIndexT>(ali.size()) != mat.NumRows()) {
+      KALDI_WARN << "Numerator alignment has wrong length "
+                 << ali.size() << " vs. "<< mat.NumRows();
+      num_other_error_++;
+      continue;
+    }
+    if (mat.NumRows() > max_frames_) {
+      KALDI_WARN << "Utterance " << utt << ": Skipped because it has "
+                 << mat.NumRows() << " frames, which is more than "
+                 << max_frames_ << ".";
+      num_other_error_++;
+      continue;
+    }
+    // 2) get the denominator lattice, preprocess
+    eg->den_lat = den_lat_reader_->Value(utt);
+    Lattice &den_lat = eg->den_lat;
+    if (den_lat.Start() == -1) {
+      KALDI_WARN << "Empty lattice for utt " << utt;
+      num_other_error_++;
+      continue;
+    }
+    if (old_acoustic_scale_ != 1.0) {
+      fst::ScaleLattice(fst::AcousticLatticeScale(old_acoustic_scale_),
+                        &den_lat);
+    }
+    // optional sort it topologically
+    kaldi::uint64 props = den_lat.Properties(fst::kFstProperties, false);
+    if (!(props & fst::kTopSorted)) {
+      if (fst::TopSort(&den_lat) == false)
+        KALDI_ERR << "Cycles detected in lattice.";
+    }
+    // get the lattice length and times of states
+    int32 max_time = LatticeStateTimes(den_lat, &eg->state_times);
+    // check for temporal length of denominator lattices
+    if (max_time != mat.NumRows()) {
+      KALDI_WARN << "Denominator lattice has wrong length "
+                 << max_time << " vs. " << mat.NumRows();
+      num_other_error_++;
+      continue;
+    }
+
+    eg->utt = utt;
+    eg->feats = mat;
+    eg->ali = ali;
+    feature_reader_->Next();
+    return true;
+  }
+  return false;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,103 @@
+// lat/sequence-training-reader.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_LAT_SEQUENCE_TRAINING_READER_H_
+#define KALDI_LAT_SEQUENCE_TRAINING_READER_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "fstext/fstext-lib.h"
+#include "lat/kaldi-lattice.h"
+#include "thread/kaldi-background-reader.h"
+
+namespace kaldi {
+
+/// One utterance of sequence-discriminative training data, as prepared by
+/// SequenceTrainingReader.
+struct SequenceTrainingUtterance {
+  std::string utt;
+  Matrix<BaseFloat> feats;
+  /// The reference (numerator) alignment, one transition-id per frame.
+  std::vector<int32> ali;
+  /// The denominator lattice: topologically sorted, with the old acoustic
+  /// scale applied.
+  Lattice den_lat;
+  /// The time of each state of den_lat, from LatticeStateTimes().
+  std::vector<int32> state_times;
+};
+
+
+/**
+   SequenceTrainingReader reads the data of the per-utterance sequence
+   training (nnet-train-mmi-sequential, nnet-train-mpe-sequential): the
+   features, the reference alignments and the denominator lattices.  It skips
+   the utterances with missing or mismatched data, and prepares the lattices
+   for the acoustic rescoring (acoustic scaling, topological sorting and state
+   times).  If 'num_prefetch' > 0, this is done in a background thread for up to
+   'num_prefetch' utterances ahead, so that reading and preparing the lattices
+   overlaps with the training on the current utterance.
+*/
+class SequenceTrainingReader:
+      private BackgroundReader<SequenceTrainingUtterance>::Source {
+ public:
+  /// Utterances with more than 'max_frames' frames are skipped; the lattice
+  /// scores are scaled by 'old_acoustic_scale' (unless it is 1.0).
+  SequenceTrainingReader(SequentialBaseFloatMatrixReader *feature_reader,
+                         RandomAccessLatticeReader *den_lat_reader,
+                         RandomAccessInt32VectorReader *ali_reader,
+                         BaseFloat old_acoustic_scale,
+                         int32 max_frames,
+                         int32 num_prefetch);
+
+  /// Returns the next utterance, or NULL when there are no more.  The
+  /// utterance may be modified, and remains valid until the next call.
+  SequenceTrainingUtterance *Next() { return reader_.Next(); }
+
+  /// The error counts; if we prefetch, only call these after Next() has
+  /// returned NULL.
+  int32 NumNoDenLat() const { return num_no_den_lat_; }
+  int32 NumNoAli() const { return num_no_ali_; }
+  int32 NumOtherError() const { return num_other_error_; }
+
+ private:
+  /// Reads the next valid utterance into *utt; returns false at the end of
+  /// the input.
+  virtual bool Read(SequenceTrainingUtterance *utt);
+
+  SequentialBaseFloatMatrixReader *feature_reader_;
+  RandomAccessLatticeReader *den_lat_reader_;
+  RandomAccessInt32VectorReader *ali_reader_;
+  BaseFloat old_acoustic_scale_;
+  int32 max_frames_;
+  int32 num_no_den_lat_;
+  int32 num_no_ali_;
+  int32 num_other_error_;
+
+  // Declared last, so that the background thread is stopped before the
+  // other members are destroyed.
+  BackgroundReader<SequenceTrainingUtterance> reader_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SequenceTrainingReader);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_SEQUENCE_TRAINING_READER_H_
@@ -1067,19 +1067,131 @@ void MatrixBase<Real>::MulRowsVec(const VectorBase<Real> &scale) {
 }
 
 
+// The following helpers implement MulRowsGroupMat(), GroupPnorm(), GroupMax()
+// and their derivatives for a single row.  The template argument G is the group size if
+// it is known at compile time (we instantiate the common cases 2, 4, 5 and 10),
+// or 0 if it is only known at run time, in which case "group_size" is used.
+// With a constant group size the compiler can unroll and vectorize the inner
+// loops, which matters because the groups are too small for BLAS.
+
+// Computes the p-norms of the groups for p == 1 or p == 2; other values of p
+// are handled in GroupPnorm() itself.
+template<typename Real, int G>
+static void GroupPnormRow(const Real *src, MatrixIndexT num_groups,
+                          MatrixIndexT group_size, Real power, Real *dest) {
+  const MatrixIndexT gs = (G > 0 ? G : group_size);
+  if (power == 2.0) {
+    for (MatrixIndexT j = 0; j < num_groups; j++, src += gs) {
+      Real sum = 0.0;
+      for (MatrixIndexT k = 0; k < gs; k++)
+        sum += src[k] * src[k];
+      dest[j] = std::sqrt(sum);
+    }
+  } else {
+    KALDI_ASSERT(power == 1.0);
+    for (MatrixIndexT j = 0; j < num_groups; j++, src += gs) {
+      Real sum = 0.0;
+      for (MatrixIndexT k = 0; k < gs; k++)
+        sum += std::abs(src[k]);
+      dest[j] = sum;
+    }
+  }
+}
+
+template<typename Real, int G>
+static void GroupPnormDerivRow(const Real *input, const Real *output,
+                               MatrixIndexT num_groups,
+                               MatrixIndexT group_size, Real power,
+                               Real *deriv) {
+  const MatrixIndexT gs = (G > 0 ? G : group_size);
+  if (power == 1.0) {
+    for (MatrixIndexT j = 0; j < num_groups * gs; j++) {
+      Real input_val = input[j];
+      deriv[j] = (input_val == 0 ? 0 : (input_val > 0 ? 1 : -1));
+    }
+  } else if (power == 2.0) {
+    // d/dx_k sqrt(sum_k x_k^2) = x_k / y.
+    for (MatrixIndexT j = 0; j < num_groups; j++, input += gs, deriv += gs) {
+      Real output_val = output[j];
+      Real inv_output = (output_val == 0 ? 0 : 1.0 / output_val);
+      for (MatrixIndexT k = 0; k < gs; k++)
+        deriv[k] = input[k] * inv_output;
+    }
+  } else {
+    for (MatrixIndexT j = 0; j < num_groups; j++, input += gs, deriv += gs) {
+      Real output_val = output[j];
+      if (output_val == 0) {
+        for (MatrixIndexT k = 0; k < gs; k++)
+          deriv[k] = 0;
+      } else {
+        // this factor is shared by the whole group.
+        Real scale = pow(output_val, 1 - power);
+        for (MatrixIndexT k = 0; k < gs; k++) {
+          Real input_val = input[k];
+          deriv[k] = pow(std::abs(input_val), power - 1) * scale *
+              (input_val >= 0 ? 1 : -1);
+        }
+      }
+    }
+  }
+}
+
+template<typename Real, int G>
+static void GroupMaxRow(const Real *src, MatrixIndexT num_groups,
+                        MatrixIndexT group_size, Real *dest) {
+  const MatrixIndexT gs = (G > 0 ? G : group_size);
+  for (MatrixIndexT j = 0; j < num_groups; j++, src += gs) {
+    Real max_val = src[0];
+    for (MatrixIndexT k = 1; k < gs; k++)
+      max_val = (src[k] > max_val ? src[k] : max_val);
+    dest[j] = max_val;
+  }
+}
+
+template<typename Real, int G>
+static void GroupMaxDerivRow(const Real *input, const Real *output,
+                             MatrixIndexT num_groups, MatrixIndexT group_size,
+                             Real *deriv) {
+  const MatrixIndexT gs = (G > 0 ? G : group_size);
+  for (MatrixIndexT j = 0; j < num_groups; j++, input += gs, deriv += gs) {
+    Real output_val = output[j];
+    for (MatrixIndexT k = 0; k < gs; k++)
+      deriv[k] = (input[k] == output_val ? 1 : 0);
+  }
+}
+
+template<typename Real, int G>
+static void MulRowsGroupMatRow(const Real *src, MatrixIndexT num_groups,
+                               MatrixIndexT group_size, Real *data) {
+  const MatrixIndexT gs = (G > 0 ? G : group_size);
+  for (MatrixIndexT j = 0; j < num_groups; j++, data += gs) {
+    Real scale = src[j];
+    for (MatrixIndexT k = 0; k < gs; k++)
+      data[k] *= scale;
+  }
+}
+
 template<typename Real> 
 void MatrixBase<Real>::MulRowsGroupMat(const MatrixBase<Real> &src) {
   KALDI_ASSERT(src.NumRows() == this->NumRows() &&
                this->NumCols() % src.NumCols() == 0);
-  int32 group_size = this->NumCols() / src.NumCols(),
-      num_groups = this->NumCols() / group_size,
+  MatrixIndexT num_groups = src.NumCols(),
+      group_size = this->NumCols() / num_groups,
       num_rows = this->NumRows();
-
   for (MatrixIndexT i = 0; i < num_rows; i++) {
-    Real *data = this->RowData(i);
-    for (MatrixIndexT j = 0; j < num_groups; j++, data += group_size) {
-      Real scale = src(i, j);
-      cblas_Xscal(group_size, scale, data, 1);
+    const Real *src_row = src.RowData(i);
+    Real *this_row = this->RowData(i);
+    switch (group_size) {
+      case 2: MulRowsGroupMatRow<Real, 2>(src_row, num_groups, group_size,
+                                          this_row); break;
+      case 4: MulRowsGroupMatRow<Real, 4>(src_row, num_groups, group_size,
+                                          this_row); break;
+      case 5: MulRowsGroupMatRow<Real, 5>(src_row, num_groups, group_size,
+                                          this_row); break;
+      case 10: MulRowsGroupMatRow<Real, 10>(src_row, num_groups, group_size,
+                                            this_row); break;
+      default: MulRowsGroupMatRow<Real, 0>(src_row, num_groups, group_size,
+                                           this_row);
     }
   }
 }
@@ -1092,27 +1204,23 @@ void MatrixBase<Real>::GroupPnormDeriv(const MatrixBase<Real> &input,
   KALDI_ASSERT(this->NumCols() % output.NumCols() == 0 &&
                this->NumRows() == output.NumRows());
 
-  int group_size = this->NumCols() / output.NumCols(),
-    num_rows = this->NumRows(), num_cols = this->NumCols(); 
-
-  if (power == 1.0) {   
-    for (MatrixIndexT i = 0; i < num_rows; i++) { 
-      for (MatrixIndexT j = 0; j < num_cols; j++) {
-        Real input_val = input(i, j);
-        (*this)(i, j) = (input_val == 0 ? 0 : (input_val > 0 ? 1 : -1));
-      }
-    }
-  } else {
-    for (MatrixIndexT i = 0; i < num_rows; i++) {
-      for (MatrixIndexT j = 0; j < num_cols; j++) {
-        Real output_val = output(i, j / group_size),
-          input_val = input(i, j);
-        if (output_val == 0) 
-          (*this)(i, j) = 0;
-         else
-            (*this)(i, j) = pow(std::abs(input_val), power - 1) * 
-              pow(output_val, 1 - power) * (input_val >= 0 ? 1 : -1) ;
-      }
+  MatrixIndexT num_groups = output.NumCols(),
+      group_size = this->NumCols() / num_groups,
+      num_rows = this->NumRows();
+  for (MatrixIndexT i = 0; i < num_rows; i++) {
+    const Real *input_row = input.RowData(i), *output_row = output.RowData(i);
+    Real *deriv_row = this->RowData(i);
+    switch (group_size) {
+      case 2: GroupPnormDerivRow<Real, 2>(input_row, output_row, num_groups,
+                                          group_size, power, deriv_row); break;
+      case 4: GroupPnormDerivRow<Real, 4>(input_row, output_row, num_groups,
+                                          group_size, power, deriv_row); break;
+      case 5: GroupPnormDerivRow<Real, 5>(input_row, output_row, num_groups,
+                                          group_size, power, deriv_row); break;
+      case 10: GroupPnormDerivRow<Real, 10>(input_row, output_row, num_groups,
+                                            group_size, power, deriv_row); break;
+      default: GroupPnormDerivRow<Real, 0>(input_row, output_row, num_groups,
+                                           group_size, power, deriv_row);
     }
   }
 }
@@ -1125,14 +1233,23 @@ void MatrixBase<Real>::GroupMaxDeriv(const MatrixBase<Real> &input,
   KALDI_ASSERT(this->NumCols() % output.NumCols() == 0 &&
                this->NumRows() == output.NumRows());
 
-  int group_size = this->NumCols() / output.NumCols(),
-      num_rows = this->NumRows(), num_cols = this->NumCols();
-
+  MatrixIndexT num_groups = output.NumCols(),
+      group_size = this->NumCols() / num_groups,
+      num_rows = this->NumRows();
   for (MatrixIndexT i = 0; i < num_rows; i++) {
-    for (MatrixIndexT j = 0; j < num_cols; j++) {
-      Real input_val = input(i, j);
-      Real output_val = output(i, j / group_size);
-      (*this)(i, j) = (input_val == output_val ? 1 : 0);
+    const Real *input_row = input.RowData(i), *output_row = output.RowData(i);
+    Real *deriv_row = this->RowData(i);
+    switch (group_size) {
+      case 2: GroupMaxDerivRow<Real, 2>(input_row, output_row, num_groups,
+                                        group_size, deriv_row); break;
+      case 4: GroupMaxDerivRow<Real, 4>(input_row, output_row, num_groups,
+                                        group_size, deriv_row); break;
+      case 5: GroupMaxDerivRow<Real, 5>(input_row, output_row, num_groups,
+                                        group_size, deriv_row); break;
+      case 10: GroupMaxDerivRow<Real, 10>(input_row, output_row, num_groups,
+                                          group_size, deriv_row); break;
+      default: GroupMaxDerivRow<Real, 0>(input_row, output_row, num_groups,
+                                         group_size, deriv_row);
     }
   }
 }
@@ -1291,6 +1408,9 @@ void Matrix<Real>::Read(std::istream & is, bool binary, bool add) {
   std::ostringstream specific_error;
 
   if (binary) {  // Read in binary mode.
+    // A binary matrix never starts with whitespace, so any whitespace here is
+    // padding, e.g. from nnet2's AffineComponent::SetAlignOnWrite().
+    is >> std::ws;
     int peekval = Peek(is, binary);
     if (peekval == 'C') {
       // This code enable us to read CompressedMatrix as a regular matrix.
@@ -2530,29 +2650,52 @@ template<typename Real>
 void MatrixBase<Real>::GroupPnorm(const MatrixBase<Real> &src, Real power) {
   KALDI_ASSERT(src.NumCols() % this->NumCols() == 0 &&
                src.NumRows() == this->NumRows());
-  int group_size = src.NumCols() / this->NumCols(),
-    num_rows = this->NumRows(), num_cols = this->NumCols();
-  for (MatrixIndexT i = 0; i < num_rows; i++)
-    for (MatrixIndexT j = 0; j < num_cols; j++)
-      (*this)(i, j) = src.Row(i).Range(j * group_size,  group_size).Norm(power);
+  MatrixIndexT group_size = src.NumCols() / this->NumCols(),
+      num_rows = this->NumRows(), num_cols = this->NumCols();
+  if (power != 1.0 && power != 2.0) {
+    // The general case needs pow(), which dominates the cost anyway.
+    for (MatrixIndexT i = 0; i < num_rows; i++)
+      for (MatrixIndexT j = 0; j < num_cols; j++)
+        (*this)(i, j) = src.Row(i).Range(j * group_size,  group_size).Norm(power);
+    return;
+  }
+  for (MatrixIndexT i = 0; i < num_rows; i++) {
+    const Real *src_row = src.RowData(i);
+    Real *this_row = this->RowData(i);
+    switch (group_size) {
+      case 2: GroupPnormRow<Real, 2>(src_row, num_cols, group_size, power,
+                                     this_row); break;
+      case 4: GroupPnormRow<Real, 4>(src_row, num_cols, group_size, power,
+                                     this_row); break;
+      case 5: GroupPnormRow<Real, 5>(src_row, num_cols, group_size, power,
+                                     this_row); break;
+      case 10: GroupPnormRow<Real, 10>(src_row, num_cols, group_size, power,
+                                       this_row); break;
+      default: GroupPnormRow<Real, 0>(src_row, num_cols, group_size, power,
+                                      this_row);
+    }
+  }
 }
 
 template<typename Real>
 void MatrixBase<Real>::GroupMax(const MatrixBase<Real> &src) {
   KALDI_ASSERT(src.NumCols() % this->NumCols() == 0 &&
                src.NumRows() == this->NumRows());
-  int group_size = src.NumCols() / this->NumCols(),
+  MatrixIndexT group_size = src.NumCols() / this->NumCols(),
       num_rows = this->NumRows(), num_cols = this->NumCols();
   for (MatrixIndexT i = 0; i < num_rows; i++) {
-    const Real *src_row_data = src.RowData(i);
-    for (MatrixIndexT j = 0; j < num_cols; j++) {
-      Real max_val = -1e20;
-      for (MatrixIndexT k = 0; k < group_size; k++) {
-        Real src_data = src_row_data[j * group_size + k];
-        if (src_data > max_val)
-          max_val = src_data;
-      }
-      (*this)(i, j) = max_val;
+    const Real *src_row = src.RowData(i);
+    Real *this_row = this->RowData(i);
+    switch (group_size) {
+      case 2: GroupMaxRow<Real, 2>(src_row, num_cols, group_size, this_row);
+        break;
+      case 4: GroupMaxRow<Real, 4>(src_row, num_cols, group_size, this_row);
+        break;
+      case 5: GroupMaxRow<Real, 5>(src_row, num_cols, group_size, this_row);
+        break;
+      case 10: GroupMaxRow<Real, 10>(src_row, num_cols, group_size, this_row);
+        break;
+      default: GroupMaxRow<Real, 0>(src_row, num_cols, group_size, this_row);
     }
   }
 }
@@ -2394,6 +2394,29 @@ template<typename Real> static void  UnitTestMat2Vec() {
     B3.AddMat2Vec(1.0, PT, kTrans, s, 0.0);
     AssertEqual(B, B3);
   }
+  for (MatrixIndexT i = 0; i < 5; i++) {
+    // Compare with rank-one updates, with many vectors (so the rank-k code is
+    // used) and weights of either sign, some zero.
+    MatrixIndexT dimM = 5 + Rand() % 10, num_vecs = 1 + Rand() % 50;
+    Matrix<Real> M(num_vecs, dimM);
+    InitRand(&M);
+    Vector<Real> v(num_vecs);
+    InitRand(&v);
+    for (MatrixIndexT j = 0; j < num_vecs; j++)
+      if (Rand() % 5 == 0) v(j) = 0.0;
+    SpMatrix<Real> B(dimM), B2(dimM), B3(dimM);
+    InitRand(&B);
+    B2.CopyFromSp(B);
+    B3.CopyFromSp(B);
+    B.Scale(0.5);
+    for (MatrixIndexT j = 0; j < num_vecs; j++)
+      B.AddVec2(2.0 * v(j), M.Row(j));
+    B2.AddMat2Vec(2.0, M, kTrans, v, 0.5);
+    AssertEqual(B, B2);
+    Matrix<Real> MT(M, kTrans);
+    B3.AddMat2Vec(2.0, MT, kNoTrans, v, 0.5);
+    AssertEqual(B, B3);
+  }
 }
 
 template<typename Real> static void  UnitTestLimitCond() {
@@ -4535,8 +4558,54 @@ template<typename Real> static void UnitTestTriVecSolver() {
 }
 
 
+// checks GroupPnorm(), GroupMax(), their derivatives and MulRowsGroupMat(),
+// which are specialized for some group sizes and powers, against a direct
+// computation.
+template<typename Real> static void UnitTestGroupPnormAndMax() {
+  for (MatrixIndexT iter = 0; iter < 20; iter++) {
+    int32 group_sizes[] = { 1, 2, 3, 4, 5, 10 };
+    Real powers[] = { 1.0, 1.5, 2.0 };
+    int32 group_size = group_sizes[Rand() % 6],
+        num_rows = 1 + Rand() % 20, num_groups = 1 + Rand() % 20;
+    Real power = powers[Rand() % 3];
+    Matrix<Real> input(num_rows, num_groups * group_size);
+    input.SetRandn();
+    if (iter % 2 == 0)
+      input.ApplyFloor(0.0);  // zeros are a special case in the derivatives.
+    Matrix<Real> pnorm(num_rows, num_groups), max(num_rows, num_groups),
+        pnorm_deriv(input.NumRows(), input.NumCols()),
+        max_deriv(input.NumRows(), input.NumCols());
+    pnorm.GroupPnorm(input, power);
+    max.GroupMax(input);
+    pnorm_deriv.GroupPnormDeriv(input, pnorm, power);
+    max_deriv.GroupMaxDeriv(input, max);
+    Matrix<Real> scaled(input);
+    scaled.MulRowsGroupMat(pnorm);
+    for (int32 i = 0; i < num_rows; i++) {
+      for (int32 j = 0; j < num_groups; j++) {
+        SubVector<Real> group(input.Row(i), j * group_size, group_size);
+        AssertEqual(pnorm(i, j), group.Norm(power));
+        AssertEqual(max(i, j), group.Max());
+        for (int32 k = 0; k < group_size; k++) {
+          Real x = group(k), y = pnorm(i, j), d = 0.0;
+          if (power == 1.0)
+            d = (x == 0 ? 0 : (x > 0 ? 1 : -1));
+          else if (y != 0)
+            d = pow(std::abs(x), power - 1) * pow(y, 1 - power) *
+                (x >= 0 ? 1 : -1);
+          AssertEqual(pnorm_deriv(i, j * group_size + k), d);
+          AssertEqual(scaled(i, j * group_size + k), x * y);
+          KALDI_ASSERT(max_deriv(i, j * group_size + k) == (x == max(i, j) ?
+                                                            1 : 0));
+        }
+      }
+    }
+  }
+}
+
 template<typename Real> static void MatrixUnitTest(bool full_test) {
   UnitTestLinearCgd<Real>();
+  UnitTestGroupPnormAndMax<Real>();
   UnitTestGeneralMatrix<BaseFloat>();
   UnitTestTridiagonalize<Real>();
   UnitTestTridiagonalizeAndQr<Real>();  
@@ -1113,21 +1113,53 @@ void SpMatrix<Real>::AddMat2Vec(const Real alpha,
                (transM == kTrans && this->NumRows() == M.NumCols() &&
                 M.NumRows() == v.Dim()));
 
-  if (transM == kNoTrans) {
-    const Real *Mdata = M.Data(), *vdata = v.Data();
-    Real *data = this->data_;
-    MatrixIndexT dim = this->NumRows(), mcols = M.NumCols(),
-        mstride = M.Stride();
-    for (MatrixIndexT col = 0; col < mcols; col++, vdata++, Mdata += 1)
-      cblas_Xspr(dim, *vdata*alpha, Mdata, mstride, data);
-  } else {
-    const Real *Mdata = M.Data(), *vdata = v.Data();
-    Real *data = this->data_;
-    MatrixIndexT dim = this->NumRows(), mrows = M.NumRows(),
-        mstride = M.Stride();
-    for (MatrixIndexT row = 0; row < mrows; row++, vdata++, Mdata += mstride)
-      cblas_Xspr(dim, *vdata*alpha, Mdata, 1, data);
+  MatrixIndexT dim = this->NumRows(),
+      num_vecs = (transM == kNoTrans ? M.NumCols() : M.NumRows());
+  if (num_vecs < 16) {
+    // A rank-one update for each vector is fastest when there are few.
+    if (transM == kNoTrans) {
+      const Real *Mdata = M.Data(), *vdata = v.Data();
+      Real *data = this->data_;
+      MatrixIndexT mstride = M.Stride();
+      for (MatrixIndexT col = 0; col < num_vecs; col++, vdata++, Mdata += 1)
+        cblas_Xspr(dim, *vdata*alpha, Mdata, mstride, data);
+    } else {
+      const Real *Mdata = M.Data(), *vdata = v.Data();
+      Real *data = this->data_;
+      MatrixIndexT mstride = M.Stride();
+      for (MatrixIndexT row = 0; row < num_vecs; row++, vdata++, Mdata += mstride)
+        cblas_Xspr(dim, *vdata*alpha, Mdata, 1, data);
+    }
+    return;
   }
+
+  // Otherwise we do it as rank-k updates (as in AddMat2()), which are much
+  // faster: the rows of "scaled" are the vectors times sqrt(|v(i)|), those with
+  // positive v(i) first and then those with negative v(i), which we add with
+  // opposite signs.
+  MatrixIndexT num_pos = 0, num_neg = 0;
+  for (MatrixIndexT i = 0; i < num_vecs; i++) {
+    if (v(i) > 0.0) num_pos++;
+    else if (v(i) < 0.0) num_neg++;
+  }
+  if (num_pos + num_neg == 0) return;
+  Matrix<Real> scaled(num_pos + num_neg, dim, kUndefined);
+  MatrixIndexT pos_index = 0, neg_index = num_pos;
+  for (MatrixIndexT i = 0; i < num_vecs; i++) {
+    if (v(i) == 0.0) continue;
+    SubVector<Real> row(scaled, (v(i) > 0.0 ? pos_index++ : neg_index++));
+    if (transM == kNoTrans) row.CopyColFromMat(M, i);
+    else row.CopyFromVec(M.Row(i));
+    row.Scale(std::sqrt(std::abs(v(i))));
+  }
+  Matrix<Real> temp_mat(*this);
+  if (num_pos != 0)
+    cblas_Xsyrk(kTrans, dim, num_pos, alpha, scaled.Data(), scaled.Stride(),
+                1.0, temp_mat.Data(), temp_mat.Stride());
+  if (num_neg != 0)
+    cblas_Xsyrk(kTrans, dim, num_neg, -alpha, scaled.RowData(num_pos),
+                scaled.Stride(), 1.0, temp_mat.Data(), temp_mat.Stride());
+  this->CopyFromMat(temp_mat, kTakeLower);
 }
 
 template<typename Real>
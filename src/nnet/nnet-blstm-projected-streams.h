@@ -467,6 +467,7 @@ class BLstmProjectedStreams : public UpdatableComponent {
     CuSubMatrix<BaseFloat> F_YR(f_propagate_buf_.ColRange(7*ncell_, nrecur_));
 
     CuSubMatrix<BaseFloat> F_YGIFO(f_propagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> F_YGIFOCHM(f_propagate_buf_.ColRange(0, 7*ncell_));
 
     // disassembling backward-pass forward-propagation buffer into different neurons,
     CuSubMatrix<BaseFloat> B_YG(b_propagate_buf_.ColRange(0*ncell_, ncell_));
@@ -479,6 +480,7 @@ class BLstmProjectedStreams : public UpdatableComponent {
     CuSubMatrix<BaseFloat> B_YR(b_propagate_buf_.ColRange(7*ncell_, nrecur_));
 
     CuSubMatrix<BaseFloat> B_YGIFO(b_propagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> B_YGIFOCHM(b_propagate_buf_.ColRange(0, 7*ncell_));
 
     // forward direction
     // x -> g, i, f, o, not recurrent, do it all in once
@@ -500,43 +502,15 @@ class BLstmProjectedStreams : public UpdatableComponent {
       CuSubMatrix<BaseFloat> y_r(F_YR.RowRange(t*S, S));
 
       CuSubMatrix<BaseFloat> y_gifo(F_YGIFO.RowRange(t*S, S));
+      CuSubMatrix<BaseFloat> y_gifochm(F_YGIFOCHM.RowRange(t*S, S));
 
       // r(t-1) -> g, i, f, o
       y_gifo.AddMatMat(1.0, F_YR.RowRange((t-1)*S, S), kNoTrans, f_w_gifo_r_, kTrans, 1.0);
 
-      // c(t-1) -> i(t) via peephole
-      y_i.AddMatDiagVec(1.0, F_YC.RowRange((t-1)*S, S), kNoTrans, f_peephole_i_c_, 1.0);
-
-      // c(t-1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, F_YC.RowRange((t-1)*S, S), kNoTrans, f_peephole_f_c_, 1.0);
-
-      // i, f sigmoid squashing
-      y_i.Sigmoid(y_i);
-      y_f.Sigmoid(y_f);
-
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g -> c
-      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-      // c(t-1) -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, F_YC.RowRange((t-1)*S, S), y_f, 1.0);
-
-      y_c.ApplyFloor(-50);   // optional clipping of cell activation
-      y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-      // h tanh squashing
-      y_h.Tanh(y_c);
-
-      // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, f_peephole_o_c_, 1.0);
-
-      // o sigmoid squashing
-      y_o.Sigmoid(y_o);
-
-      // h -> m via output gate
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+      // peepholes, nonlinearities, cell update and output gate, fused into
+      // one pass over g, i, f, o, c, h, m (see cu::LstmStepForward)
+      cu::LstmStepForward(f_peephole_i_c_, f_peephole_f_c_, f_peephole_o_c_,
+                          F_YGIFOCHM.RowRange((t-1)*S, S), &y_gifochm);
 
       // m -> r
       y_r.AddMatMat(1.0, y_m, kNoTrans, f_w_r_m_, kTrans, 0.0);
@@ -589,43 +563,15 @@ class BLstmProjectedStreams : public UpdatableComponent {
       CuSubMatrix<BaseFloat> y_m(B_YM.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_r(B_YR.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> y_gifo(B_YGIFO.RowRange(t*S, S));
+      CuSubMatrix<BaseFloat> y_gifochm(B_YGIFOCHM.RowRange(t*S, S));
 
       // r(t+1) -> g, i, f, o
       y_gifo.AddMatMat(1.0, B_YR.RowRange((t+1)*S, S), kNoTrans, b_w_gifo_r_, kTrans, 1.0);
 
-      // c(t+1) -> i(t) via peephole
-      y_i.AddMatDiagVec(1.0, B_YC.RowRange((t+1)*S, S), kNoTrans, b_peephole_i_c_, 1.0);
-
-      // c(t+1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, B_YC.RowRange((t+1)*S, S), kNoTrans, b_peephole_f_c_, 1.0);
-
-      // i, f sigmoid squashing
-      y_i.Sigmoid(y_i);
-      y_f.Sigmoid(y_f);
-
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g -> c
-      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-      // c(t+1) -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, B_YC.RowRange((t+1)*S, S), y_f, 1.0);
-
-      y_c.ApplyFloor(-50);   // optional clipping of cell activation
-      y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-      // h tanh squashing
-      y_h.Tanh(y_c);
-
-      // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, b_peephole_o_c_, 1.0);
-
-      // o sigmoid squashing
-      y_o.Sigmoid(y_o);
-
-      // h -> m via output gate
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+      // peepholes, nonlinearities, cell update and output gate, fused into
+      // one pass over g, i, f, o, c, h, m (see cu::LstmStepForward)
+      cu::LstmStepForward(b_peephole_i_c_, b_peephole_f_c_, b_peephole_o_c_,
+                          B_YGIFOCHM.RowRange((t+1)*S, S), &y_gifochm);
 
       // m -> r
       y_r.AddMatMat(1.0, y_m, kNoTrans, b_w_r_m_, kTrans, 0.0);
@@ -674,6 +620,7 @@ class BLstmProjectedStreams : public UpdatableComponent {
     CuSubMatrix<BaseFloat> F_YH(f_propagate_buf_.ColRange(5*ncell_, ncell_));
     CuSubMatrix<BaseFloat> F_YM(f_propagate_buf_.ColRange(6*ncell_, ncell_));
     CuSubMatrix<BaseFloat> F_YR(f_propagate_buf_.ColRange(7*ncell_, nrecur_));
+    CuSubMatrix<BaseFloat> F_YGIFOCHM(f_propagate_buf_.ColRange(0, 7*ncell_));
 
     // 0:dummy, [1,T] frames, T+1 backward pass history
     f_backpropagate_buf_.Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
@@ -689,6 +636,7 @@ class BLstmProjectedStreams : public UpdatableComponent {
     CuSubMatrix<BaseFloat> F_DR(f_backpropagate_buf_.ColRange(7*ncell_, nrecur_));
 
     CuSubMatrix<BaseFloat> F_DGIFO(f_backpropagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> F_DGIFOCHM(f_backpropagate_buf_.ColRange(0, 7*ncell_));
 
     // projection layer to BLSTM output is not recurrent, so backprop it all in once
     F_DR.RowRange(1*S, T*S).CopyFromMat(out_diff.ColRange(0, nrecur_));
@@ -712,6 +660,7 @@ class BLstmProjectedStreams : public UpdatableComponent {
       CuSubMatrix<BaseFloat> d_m(F_DM.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> d_r(F_DR.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> d_all(f_backpropagate_buf_.RowRange(t*S, S));
+      CuSubMatrix<BaseFloat> d_gifochm(F_DGIFOCHM.RowRange(t*S, S));
       // r
       //   Version 1 (precise gradients):
       //   backprop error from g(t+1), i(t+1), f(t+1), o(t+1) to r(t)
@@ -734,37 +683,12 @@ class BLstmProjectedStreams : public UpdatableComponent {
       // r -> m
       d_m.AddMatMat(1.0, d_r, kNoTrans, f_w_r_m_, kNoTrans, 0.0);
 
-      // m -> h via output gate
-      d_h.AddMatMatElements(1.0, d_m, y_o, 0.0);
-      d_h.DiffTanh(y_h, d_h);
-
-      // o
-      d_o.AddMatMatElements(1.0, d_m, y_h, 0.0);
-      d_o.DiffSigmoid(y_o, d_o);
-
-      // c
-      // 1. diff from h(t)
-      // 2. diff from c(t+1) (via forget-gate between CEC)
-      // 3. diff from i(t+1) (via peephole)
-      // 4. diff from f(t+1) (via peephole)
-      // 5. diff from o(t)   (via peephole, not recurrent)
-      d_c.AddMat(1.0, d_h);
-      d_c.AddMatMatElements(1.0, F_DC.RowRange((t+1)*S, S), F_YF.RowRange((t+1)*S, S), 1.0);
-      d_c.AddMatDiagVec(1.0, F_DI.RowRange((t+1)*S, S), kNoTrans, f_peephole_i_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, F_DF.RowRange((t+1)*S, S), kNoTrans, f_peephole_f_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, d_o           , kNoTrans, f_peephole_o_c_, 1.0);
-
-      // f
-      d_f.AddMatMatElements(1.0, d_c, F_YC.RowRange((t-1)*S, S), 0.0);
-      d_f.DiffSigmoid(y_f, d_f);
-
-      // i
-      d_i.AddMatMatElements(1.0, d_c, y_g, 0.0);
-      d_i.DiffSigmoid(y_i, d_i);
-
-      // c -> g via input gate
-      d_g.AddMatMatElements(1.0, d_c, y_i, 0.0);
-      d_g.DiffTanh(y_g, d_g);
+      // m -> h, o; c (from h(t), c(t+1), i(t+1), f(t+1), o(t)) -> f, i, g,
+      // fused into one pass (see cu::LstmStepBackward)
+      cu::LstmStepBackward(f_peephole_i_c_, f_peephole_f_c_, f_peephole_o_c_,
+                           F_YGIFOCHM.RowRange((t-1)*S, S), F_YGIFOCHM.RowRange(t*S, S),
+                           F_YGIFOCHM.RowRange((t+1)*S, S), F_DGIFOCHM.RowRange((t+1)*S, S),
+                           &d_gifochm);
 
       // debug info
       if (DEBUG) {
@@ -789,6 +713,7 @@ class BLstmProjectedStreams : public UpdatableComponent {
     CuSubMatrix<BaseFloat> B_YH(b_propagate_buf_.ColRange(5*ncell_, ncell_));
     CuSubMatrix<BaseFloat> B_YM(b_propagate_buf_.ColRange(6*ncell_, ncell_));
     CuSubMatrix<BaseFloat> B_YR(b_propagate_buf_.ColRange(7*ncell_, nrecur_));
+    CuSubMatrix<BaseFloat> B_YGIFOCHM(b_propagate_buf_.ColRange(0, 7*ncell_));
 
     // 0:dummy, [1,T] frames, T+1 backward pass history
     b_backpropagate_buf_.Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
@@ -803,6 +728,7 @@ class BLstmProjectedStreams : public UpdatableComponent {
     CuSubMatrix<BaseFloat> B_DM(b_backpropagate_buf_.ColRange(6*ncell_, ncell_));
     CuSubMatrix<BaseFloat> B_DR(b_backpropagate_buf_.ColRange(7*ncell_, nrecur_));
     CuSubMatrix<BaseFloat> B_DGIFO(b_backpropagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> B_DGIFOCHM(b_backpropagate_buf_.ColRange(0, 7*ncell_));
 
     // projection layer to BLSTM output is not recurrent, so backprop it all in once
     B_DR.RowRange(1*S, T*S).CopyFromMat(out_diff.ColRange(nrecur_, nrecur_));
@@ -826,6 +752,7 @@ class BLstmProjectedStreams : public UpdatableComponent {
       CuSubMatrix<BaseFloat> d_m(B_DM.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> d_r(B_DR.RowRange(t*S, S));
       CuSubMatrix<BaseFloat> d_all(b_backpropagate_buf_.RowRange(t*S, S));
+      CuSubMatrix<BaseFloat> d_gifochm(B_DGIFOCHM.RowRange(t*S, S));
 
       // r
       //   Version 1 (precise gradients):
@@ -848,37 +775,12 @@ class BLstmProjectedStreams : public UpdatableComponent {
       // r -> m
       d_m.AddMatMat(1.0, d_r, kNoTrans, b_w_r_m_, kNoTrans, 0.0);
 
-      // m -> h via output gate
-      d_h.AddMatMatElements(1.0, d_m, y_o, 0.0);
-      d_h.DiffTanh(y_h, d_h);
-
-      // o
-      d_o.AddMatMatElements(1.0, d_m, y_h, 0.0);
-      d_o.DiffSigmoid(y_o, d_o);
-
-      // c
-      // 1. diff from h(t)
-      // 2. diff from c(t+1) (via forget-gate between CEC)
-      // 3. diff from i(t+1) (via peephole)
-      // 4. diff from f(t+1) (via peephole)
-      // 5. diff from o(t)   (via peephole, not recurrent)
-      d_c.AddMat(1.0, d_h);
-      d_c.AddMatMatElements(1.0, B_DC.RowRange((t-1)*S, S), B_YF.RowRange((t-1)*S, S), 1.0);
-      d_c.AddMatDiagVec(1.0, B_DI.RowRange((t-1)*S, S), kNoTrans, b_peephole_i_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, B_DF.RowRange((t-1)*S, S), kNoTrans, b_peephole_f_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, d_o                     , kNoTrans, b_peephole_o_c_, 1.0);
-
-      // f
-      d_f.AddMatMatElements(1.0, d_c, B_YC.RowRange((t-1)*S, S), 0.0);
-      d_f.DiffSigmoid(y_f, d_f);
-
-      // i
-      d_i.AddMatMatElements(1.0, d_c, y_g, 0.0);
-      d_i.DiffSigmoid(y_i, d_i);
-
-      // c -> g via input gate
-      d_g.AddMatMatElements(1.0, d_c, y_i, 0.0);
-      d_g.DiffTanh(y_g, d_g);
+      // m -> h, o; c (from h(t), c(t-1), i(t-1), f(t-1), o(t)) -> f, i, g,
+      // fused into one pass (see cu::LstmStepBackward)
+      cu::LstmStepBackward(b_peephole_i_c_, b_peephole_f_c_, b_peephole_o_c_,
+                           B_YGIFOCHM.RowRange((t+1)*S, S), B_YGIFOCHM.RowRange(t*S, S),
+                           B_YGIFOCHM.RowRange((t-1)*S, S), B_DGIFOCHM.RowRange((t-1)*S, S),
+                           &d_gifochm);
 
       // debug info
       if (DEBUG) {
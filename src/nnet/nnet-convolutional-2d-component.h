@@ -249,8 +249,6 @@ class Convolutional2DComponent : public UpdatableComponent {
 
   void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
     // useful dims
-    int32 num_input_fmaps = input_dim_ / (fmap_x_len_ * fmap_y_len_);
-    // int32 inp_fmap_size = fmap_x_len_ * fmap_y_len_;
     int32 out_fmap_x_len = (fmap_x_len_ - filt_x_len_)/filt_x_step_ + 1;
     int32 out_fmap_y_len = (fmap_y_len_ - filt_y_len_)/filt_y_step_ + 1;
     int32 out_fmap_size = out_fmap_x_len*out_fmap_y_len;
@@ -259,63 +257,29 @@ class Convolutional2DComponent : public UpdatableComponent {
     // so each input_fmap has size num_filters/num_input_fmaps
     int32 num_filters = filters_.NumRows();
     KALDI_ASSERT(num_filters == num_output_fmaps);
-    // int32 filter_size = filt_x_len_*filt_y_len_;
     int32 num_frames = in.NumRows();
 
-    // we will need the buffers
-    if (vectorized_feature_patches_.size() == 0) {
-      vectorized_feature_patches_.resize(out_fmap_size);
-      feature_patch_diffs_.resize(out_fmap_size);
-    }
-
-    for (int32 p = 0; p < out_fmap_size; p++) {
-      vectorized_feature_patches_[p].Resize(num_frames, filters_.NumCols());
-    }
-
-    // Checked for num_input_fmaps=1, check for num_inp_fmaps>1
-    int32 out_fmap_cnt = 0;
-    for (int32 m = 0; m < fmap_x_len_-filt_x_len_+1; m = m+filt_x_step_) {
-      for (int32 n = 0; n < fmap_y_len_-filt_y_len_+1; n = n+filt_y_step_) {
-    std::vector<int32> column_mask;
-    int32 st = 0;
-    if (connect_fmap_ == 1) {
-      st = (m * fmap_y_len_ + n) * num_input_fmaps;
-    } else {
-      st = m * fmap_y_len_ * num_input_fmaps + n;
-    }
-
-    for (int32 i = 0; i < filt_x_len_; i++) {
-      for (int32 j = 0; j < filt_y_len_*num_input_fmaps; j++) {
-        int32 c = 0;
-        if (connect_fmap_ == 1) {
-          c = st + i * (num_input_fmaps*fmap_y_len_) + j;
-        } else {
-          c = st + i * (num_input_fmaps * fmap_y_len_)
-                     + (j / num_input_fmaps)
-                     + (j % num_input_fmaps) * fmap_y_len_;
-        }
-        column_mask.push_back(c);
-      }
-    }
-    CuArray<int32> cu_column_mask(column_mask);
-    vectorized_feature_patches_[out_fmap_cnt].CopyCols(in, cu_column_mask);
-    out_fmap_cnt++;
-      }
-    }
-
-    for (int32 p = 0; p < out_fmap_size; p++) {
-      CuSubMatrix<BaseFloat> tgt(out->ColRange(p*num_filters, num_filters));
-      tgt.AddVecToRows(1.0, bias_, 0.0);
-      tgt.AddMatMat(1.0, vectorized_feature_patches_[p], kNoTrans, filters_, kTrans, 1.0);
-    }
+    // the index arrays only depend on the geometry, prepare them once
+    if (patch_forward_indexes_.empty())
+      PreparePatchIndexes();
+
+    // unfold the patches, stacked as blocks of rows (one per patch position),
+    // and apply all the filters by one matrix multiplication
+    vectorized_feature_patches_.Resize(out_fmap_size * num_frames,
+                                       filters_.NumCols(), kUndefined);
+    cu::UnfoldPatches(in, patch_forward_indexes_, &vectorized_feature_patches_);
+
+    patch_outputs_.Resize(out_fmap_size * num_frames, num_filters, kUndefined);
+    patch_outputs_.AddVecToRows(1.0, bias_, 0.0);
+    patch_outputs_.AddMatMat(1.0, vectorized_feature_patches_, kNoTrans,
+                             filters_, kTrans, 1.0);
+    cu::UnstackColumnBlocks(patch_outputs_, out);
   }
 
 
   void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
                         const CuMatrixBase<BaseFloat> &out_diff, CuMatrixBase<BaseFloat> *in_diff) {
     // useful dims
-    int32 num_input_fmaps = input_dim_ / (fmap_x_len_ * fmap_y_len_);
-
     int32 out_fmap_x_len = (fmap_x_len_ - filt_x_len_)/filt_x_step_ + 1;
     int32 out_fmap_y_len = (fmap_y_len_ - filt_y_len_)/filt_y_step_ + 1;
     int32 out_fmap_size = out_fmap_x_len * out_fmap_y_len;
@@ -324,74 +288,30 @@ class Convolutional2DComponent : public UpdatableComponent {
     // so each input_fmap has num_filters/num_input_fmaps
     int32 num_filters = filters_.NumRows();
     KALDI_ASSERT(num_filters == num_output_fmaps);
-    // int32 filter_size = filt_x_len_*filt_y_len_;
     int32 num_frames = in.NumRows();
 
-    for (int32 p = 0; p < out_fmap_size; p++) {
-      feature_patch_diffs_[p].Resize(num_frames, filters_.NumCols(), kSetZero);
-      CuSubMatrix<BaseFloat> out_diff_patch(out_diff.ColRange(p*num_filters, num_filters));
-      feature_patch_diffs_[p].AddMatMat(1.0, out_diff_patch, kNoTrans, filters_, kNoTrans, 0.0);
-    }
+    // derivatives w.r.t. all the patches, by one matrix multiplication
+    patch_outputs_.Resize(out_fmap_size * num_frames, num_filters, kUndefined);
+    cu::StackColumnBlocks(out_diff, &patch_outputs_);
+    feature_patch_diffs_.Resize(out_fmap_size * num_frames, filters_.NumCols(),
+                                kUndefined);
+    feature_patch_diffs_.AddMatMat(1.0, patch_outputs_, kNoTrans,
+                                   filters_, kNoTrans, 0.0);
 
     // compute in_diff_summands_ once
     if (in_diff_summands_.Dim() == 0) {
       in_diff_summands_.Resize(in_diff->NumCols(), kSetZero);
-      for (int32 m = 0; m < fmap_x_len_-filt_x_len_+1; m = m+filt_x_step_) {
-        for (int32 n = 0; n < fmap_y_len_-filt_y_len_+1; n = n+filt_y_step_) {
-          int32 st = 0;
-          if (connect_fmap_ == 1) {
-            st = (m * fmap_y_len_ + n) * num_input_fmaps;
-          } else {
-            st = m * fmap_y_len_ * num_input_fmaps + n;
-          }
-          for (int32 i = 0; i < filt_x_len_; i++) {
-            for (int32 j = 0; j < filt_y_len_*num_input_fmaps; j++) {
-              int32 c = 0;
-              if (connect_fmap_ == 1) {
-                c = st + i * (num_input_fmaps * fmap_y_len_) + j;
-              } else {
-                c = st + i * (num_input_fmaps * fmap_y_len_)
-                       + (j / num_input_fmaps)
-                       + (j % num_input_fmaps) * fmap_y_len_;
-              }
-              // add 1.0
-              in_diff_summands_.Range(c, 1).Add(1.0);
-            }
-          }
-        }
-      }
+      Vector<BaseFloat> summands(in_diff->NumCols());
+      for (size_t p = 0; p < patch_columns_.size(); p++)
+        for (size_t k = 0; k < patch_columns_[p].size(); k++)
+          summands(patch_columns_[p][k]) += 1.0;
+      in_diff_summands_.CopyFromVec(summands);
       in_diff_summands_.InvertElements();
     }
 
-    int32 out_fmap_cnt = 0;
-
-    for (int32 m = 0; m < fmap_x_len_-filt_x_len_+1; m = m+filt_x_step_) {
-      for (int32 n = 0; n< fmap_y_len_-filt_y_len_+1; n = n+filt_y_step_) {
-        int32 st = 0;
-        if (connect_fmap_ == 1) {
-          st = (m * fmap_y_len_ + n) * num_input_fmaps;
-        } else {
-          st = m * fmap_y_len_ * num_input_fmaps + n;
-        }
-
-        for (int32 i = 0; i < filt_x_len_; i++) {
-          for (int32 j = 0; j < filt_y_len_*num_input_fmaps; j++) {
-            int32 c = 0;
-            if (connect_fmap_ == 1) {
-              c = st + i *(num_input_fmaps*fmap_y_len_)+j;
-            } else {
-              c = st + i * (num_input_fmaps * fmap_y_len_)
-                     + (j / num_input_fmaps)
-                     + (j % num_input_fmaps) * fmap_y_len_;
-            }
-            CuSubMatrix<BaseFloat> src(feature_patch_diffs_[out_fmap_cnt].ColRange(i*filt_y_len_*num_input_fmaps+j, 1));  // from which col
-            CuSubMatrix<BaseFloat> tgt(in_diff->ColRange(c, 1));  // to which col?
-            tgt.AddMat(1.0, src);
-          }
-        }
-        out_fmap_cnt++;
-      }
-    }
+    // sum the patch derivatives back into the input
+    in_diff->SetZero();
+    cu::FoldPatches(feature_patch_diffs_, patch_backward_indexes_, in_diff);
     // compensate for summands
     in_diff->MulColsVec(in_diff_summands_);
   }
@@ -405,6 +325,7 @@ class Convolutional2DComponent : public UpdatableComponent {
     int32 num_output_fmaps = output_dim_ / (out_fmap_x_len * out_fmap_y_len);
     int32 num_filters = filters_.NumRows();  // this is total num_filters, so each input_fmap has num_filters/num_input_fmaps
     KALDI_ASSERT(num_filters == num_output_fmaps);
+    int32 num_frames = input.NumRows();
 
     // we use following hyperparameters from the option class
     const BaseFloat lr = opts_.learn_rate;
@@ -416,16 +337,16 @@ class Convolutional2DComponent : public UpdatableComponent {
 
 
     //
-    // calculate the gradient
+    // calculate the gradient, summed over all the patch positions
+    // by one matrix multiplication
     //
-    filters_grad_.Resize(filters_.NumRows(), filters_.NumCols(), kSetZero);
-    bias_grad_.Resize(filters_.NumRows());
-
-    for (int32 p = 0; p < out_fmap_size; p++) {
-      CuSubMatrix<BaseFloat> diff_patch(diff.ColRange(p*num_filters, num_filters));
-      filters_grad_.AddMatMat(1.0, diff_patch, kTrans, vectorized_feature_patches_[p], kNoTrans, 1.0);
-      bias_grad_.AddRowSumMat(1.0, diff_patch, 1.0);
-    }
+    patch_outputs_.Resize(out_fmap_size * num_frames, num_filters, kUndefined);
+    cu::StackColumnBlocks(diff, &patch_outputs_);
+    filters_grad_.Resize(filters_.NumRows(), filters_.NumCols(), kUndefined);
+    bias_grad_.Resize(filters_.NumRows(), kUndefined);
+    filters_grad_.AddMatMat(1.0, patch_outputs_, kTrans,
+                            vectorized_feature_patches_, kNoTrans, 0.0);
+    bias_grad_.AddRowSumMat(1.0, patch_outputs_, 0.0);
 
     // scale
     filters_grad_.Scale(1.0/out_fmap_size);
@@ -440,6 +361,39 @@ class Convolutional2DComponent : public UpdatableComponent {
   }
 
  private:
+  /// Builds the column selection maps of the patches (as index arrays for
+  /// cu::UnfoldPatches() and cu::FoldPatches()).
+  void PreparePatchIndexes() {
+    int32 num_input_fmaps = input_dim_ / (fmap_x_len_ * fmap_y_len_);
+    patch_columns_.clear();
+    for (int32 m = 0; m < fmap_x_len_-filt_x_len_+1; m = m+filt_x_step_) {
+      for (int32 n = 0; n < fmap_y_len_-filt_y_len_+1; n = n+filt_y_step_) {
+        int32 st = 0;
+        if (connect_fmap_ == 1) {
+          st = (m * fmap_y_len_ + n) * num_input_fmaps;
+        } else {
+          st = m * fmap_y_len_ * num_input_fmaps + n;
+        }
+        std::vector<int32> column_mask;
+        for (int32 i = 0; i < filt_x_len_; i++) {
+          for (int32 j = 0; j < filt_y_len_*num_input_fmaps; j++) {
+            int32 c = 0;
+            if (connect_fmap_ == 1) {
+              c = st + i * (num_input_fmaps*fmap_y_len_) + j;
+            } else {
+              c = st + i * (num_input_fmaps * fmap_y_len_)
+                     + (j / num_input_fmaps)
+                     + (j % num_input_fmaps) * fmap_y_len_;
+            }
+            column_mask.push_back(c);
+          }
+        }
+        patch_columns_.push_back(column_mask);
+      }
+    }
+    cu::ComputePatchIndexes(patch_columns_, input_dim_,
+                            &patch_forward_indexes_, &patch_backward_indexes_);
+  }
   int32 fmap_x_len_, fmap_y_len_,  ///< feature maps dimensions (for input x_ is usually splice and y_ is num of fbanks) shift for 2nd dim of a patch (i.e. frame length before splicing)
     filt_x_len_, filt_y_len_,  ///< 2D filter dimensions, x_ temporal, y_ spectral
     filt_x_step_, filt_y_step_,  ///< 2D shifts along temporal and spectral
@@ -457,17 +411,21 @@ class Convolutional2DComponent : public UpdatableComponent {
   /** Buffer of reshaped inputs:
    *  1row = vectorized rectangular feature patch,
    *  1col = dim over speech frames,
-   *  std::vector-dim = patch-position
+   *  the patch-positions are stacked as blocks of rows
    */
-  std::vector<CuMatrix<BaseFloat> > vectorized_feature_patches_;
+  CuMatrix<BaseFloat> vectorized_feature_patches_;
 
   /** Buffer for backpropagation:
-   *  derivatives in the domain of 'vectorized_feature_patches_',
-   *  1row = vectorized rectangular feature patch,
-   *  1col = dim over speech frames,
-   *  std::vector-dim = patch-position
+   *  derivatives in the domain of 'vectorized_feature_patches_'
    */
-  std::vector<CuMatrix<BaseFloat> > feature_patch_diffs_;
+  CuMatrix<BaseFloat> feature_patch_diffs_;
+
+  /// Filter outputs (or their derivatives), stacked like the patches
+  CuMatrix<BaseFloat> patch_outputs_;
+
+  /// The input columns of each patch, and the index arrays derived from them
+  std::vector<std::vector<int32> > patch_columns_;
+  std::vector<CuArray<int32> > patch_forward_indexes_, patch_backward_indexes_;
 
   /// Auxiliary vector for compensating #summands when backpropagating
   CuVector<BaseFloat> in_diff_summands_;
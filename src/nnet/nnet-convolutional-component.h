@@ -232,18 +232,14 @@ class ConvolutionalComponent : public UpdatableComponent {
 
   void PropagateFnc(const CuMatrixBase<BaseFloat> &in, CuMatrixBase<BaseFloat> *out) {
     // useful dims
-    int32 num_splice = input_dim_ / patch_stride_;
     int32 num_patches = 1 + (patch_stride_ - patch_dim_) / patch_step_;
     int32 num_filters = filters_.NumRows();
     int32 num_frames = in.NumRows();
     int32 filter_dim = filters_.NumCols();
 
-    // we will need the buffers 
-    if (vectorized_feature_patches_.NumRows() == 0) {
-      vectorized_feature_patches_.Resize(num_frames,
-                                         filter_dim * num_patches, kUndefined);
-      feature_patch_diffs_.Resize(num_frames, filter_dim * num_patches, kSetZero);
-    }
+    // the index arrays only depend on the geometry, prepare them once
+    if (patch_forward_indexes_.empty())
+      PreparePatchIndexes();
 
     /* Prepare feature patches, the layout is:
      * |----------|----------|----------|---------| (in = spliced frames)
@@ -256,116 +252,40 @@ class ConvolutionalComponent : public UpdatableComponent {
      *
      *   xxx-xxx-xxx-xxx : filter dim
      *  
+     * The patches are stacked as blocks of rows (one block per patch
+     * position), so all the filters are applied by one matrix multiplication.
      */
-    // build-up a column selection map:
-    column_map_.resize(filter_dim * num_patches);
-    for (int32 p=0, index=0; p<num_patches; p++) {
-      for (int32 s=0; s<num_splice; s++) {
-          for (int32 d=0; d<patch_dim_; d++, index++) {
-          column_map_[index] = p * patch_step_ + s * patch_stride_ + d;
-        }
-      }
-    }
-    // select the columns
-    CuArray<int32> cu_column_map(column_map_);
-    vectorized_feature_patches_.CopyCols(in, cu_column_map);
+    vectorized_feature_patches_.Resize(num_patches * num_frames, filter_dim,
+                                       kUndefined);
+    cu::UnfoldPatches(in, patch_forward_indexes_, &vectorized_feature_patches_);
 
     // compute filter activations
-    for (int32 p=0; p<num_patches; p++) {
-      CuSubMatrix<BaseFloat> tgt(out->ColRange(p * num_filters, num_filters));
-      CuSubMatrix<BaseFloat> patch(vectorized_feature_patches_.ColRange(
-                                   p * filter_dim, filter_dim));
-      tgt.AddVecToRows(1.0, bias_, 0.0); // add bias
-      // apply all filters
-      tgt.AddMatMat(1.0, patch, kNoTrans, filters_, kTrans, 1.0);
-    }
-  }
-
-  /*
-   This function does an operation similar to reversing a map,
-   except it handles maps that are not one-to-one by outputting
-   the reversed map as a vector of lists.
-   @param[in] forward_indexes is a vector of int32, each of whose
-              elements is between 0 and input_dim - 1.
-   @param[in] input_dim. See definitions of forward_indexes and
-              backward_indexes.
-   @param[out] backward_indexes is a vector of dimension input_dim
-              of lists, The list at (backward_indexes[i]) is a list
-              of all indexes j such that forward_indexes[j] = i.
-  */
-  void ReverseIndexes(const std::vector<int32> &forward_indexes,
-                      std::vector<std::vector<int32> > *backward_indexes) {
-    int32 i;
-    int32 size = forward_indexes.size();
-    backward_indexes->resize(input_dim_);
-    int32 reserve_size = 2+ forward_indexes.size() / input_dim_;
-    std::vector<std::vector<int32> >::iterator iter = backward_indexes->begin(),
-      end = backward_indexes->end();
-    for (; iter != end; ++iter)
-      iter->reserve(reserve_size);
-    for (int32 j = 0; j < size; j++) {
-      i = forward_indexes[j];
-      KALDI_ASSERT(i < input_dim_);
-      (*backward_indexes)[i].push_back(j);
-    }
-  }
-
-  /*
-   This function transforms a vector of lists into a list of vectors,
-   padded with -1.
-   @param[in] The input vector of lists. Let in.size() be D, and let
-              the longest list length (i.e. the max of in[i].size()) be L.
-   @param[out] The output list of vectors. The length of the list will
-              be L, each vector-dimension will be D (i.e. out[i].size() == D),
-              and if in[i] == j, then for some k we will have that
-              out[k][j] = i. The output vectors are padded with -1
-              where necessary if not all the input lists have the same side.
-  */
-  void RearrangeIndexes(const std::vector<std::vector<int32> > &in,
-                        std::vector<std::vector<int32> > *out) {
-    int32 D = in.size();
-    int32 L = 0;
-    for (int32 i = 0; i < D; i++)
-      if (in[i].size() > L)
-        L = in[i].size();
-    out->resize(L);
-    for (int32 i = 0; i < L; i++)
-      (*out)[i].resize(D, -1);
-    for (int32 i = 0; i < D; i++) {
-      for (int32 j = 0; j < in[i].size(); j++) {
-        (*out)[j][i] = in[i][j];
-      }
-    }
+    patch_outputs_.Resize(num_patches * num_frames, num_filters, kUndefined);
+    patch_outputs_.AddVecToRows(1.0, bias_, 0.0); // add bias
+    // apply all filters
+    patch_outputs_.AddMatMat(1.0, vectorized_feature_patches_, kNoTrans,
+                             filters_, kTrans, 1.0);
+    cu::UnstackColumnBlocks(patch_outputs_, out);
   }
 
   void BackpropagateFnc(const CuMatrixBase<BaseFloat> &in, const CuMatrixBase<BaseFloat> &out,
                         const CuMatrixBase<BaseFloat> &out_diff, CuMatrixBase<BaseFloat> *in_diff) {
     // useful dims
-    int32 num_splice = input_dim_ / patch_stride_;
     int32 num_patches = 1 + (patch_stride_ - patch_dim_) / patch_step_;
     int32 num_filters = filters_.NumRows();
     int32 num_frames = in.NumRows();
     int32 filter_dim = filters_.NumCols();
 
-    // backpropagate to vector of matrices (corresponding to position of a filter)
-    for (int32 p=0; p<num_patches; p++) {
-      CuSubMatrix<BaseFloat> patch_diff(feature_patch_diffs_.ColRange(
-                                        p * filter_dim, filter_dim));
-      CuSubMatrix<BaseFloat> out_diff_patch(out_diff.ColRange(
-                                            p * num_filters, num_filters));
-      patch_diff.AddMatMat(1.0, out_diff_patch, kNoTrans,
-                           filters_, kNoTrans, 0.0);
-    }
+    // backpropagate to the stacked patches (all positions of the filter at once)
+    patch_outputs_.Resize(num_patches * num_frames, num_filters, kUndefined);
+    cu::StackColumnBlocks(out_diff, &patch_outputs_);
+    feature_patch_diffs_.Resize(num_patches * num_frames, filter_dim,
+                                kUndefined);
+    feature_patch_diffs_.AddMatMat(1.0, patch_outputs_, kNoTrans,
+                                   filters_, kNoTrans, 0.0);
 
-    // sum the derivatives into in_diff, we will compensate #summands
-    std::vector<std::vector<int32> > reversed_column_map;
-    ReverseIndexes(column_map_, &reversed_column_map);
-    std::vector<std::vector<int32> > rearranged_column_map;
-    RearrangeIndexes(reversed_column_map, &rearranged_column_map);
-    for (int32 p = 0; p < rearranged_column_map.size(); p++) {
-      CuArray<int32> cu_cols(rearranged_column_map[p]);
-      in_diff->AddCols(feature_patch_diffs_, cu_cols);
-    }
+    // sum the derivatives into in_diff
+    cu::FoldPatches(feature_patch_diffs_, patch_backward_indexes_, in_diff);
   }
 
 
@@ -373,6 +293,7 @@ class ConvolutionalComponent : public UpdatableComponent {
     // useful dims
     int32 num_patches = 1 + (patch_stride_ - patch_dim_) / patch_step_;
     int32 num_filters = filters_.NumRows();
+    int32 num_frames = input.NumRows();
     int32 filter_dim = filters_.NumCols();
 
     // we use following hyperparameters from the option class
@@ -383,14 +304,12 @@ class ConvolutionalComponent : public UpdatableComponent {
     //
     filters_grad_.Resize(num_filters, filter_dim, kSetZero); // reset
     bias_grad_.Resize(num_filters, kSetZero); // reset
-    // use all the patches
-    for (int32 p=0; p<num_patches; p++) { // sum
-      CuSubMatrix<BaseFloat> diff_patch(diff.ColRange(p * num_filters, num_filters));
-      CuSubMatrix<BaseFloat> patch(vectorized_feature_patches_.ColRange(
-                                   p * filter_dim, filter_dim));
-      filters_grad_.AddMatMat(1.0, diff_patch, kTrans, patch, kNoTrans, 1.0);
-      bias_grad_.AddRowSumMat(1.0, diff_patch, 1.0);
-    }
+    // use all the patches at once
+    patch_outputs_.Resize(num_patches * num_frames, num_filters, kUndefined);
+    cu::StackColumnBlocks(diff, &patch_outputs_);
+    filters_grad_.AddMatMat(1.0, patch_outputs_, kTrans,
+                            vectorized_feature_patches_, kNoTrans, 0.0);
+    bias_grad_.AddRowSumMat(1.0, patch_outputs_, 0.0);
 
     //
     // update
@@ -416,6 +335,23 @@ class ConvolutionalComponent : public UpdatableComponent {
   }
 
  private:
+  /// Builds the column selection maps of the patches (as index arrays for
+  /// cu::UnfoldPatches() and cu::FoldPatches()).
+  void PreparePatchIndexes() {
+    int32 num_splice = input_dim_ / patch_stride_;
+    int32 num_patches = 1 + (patch_stride_ - patch_dim_) / patch_step_;
+    std::vector<std::vector<int32> > patch_columns(num_patches);
+    for (int32 p = 0; p < num_patches; p++) {
+      for (int32 s = 0; s < num_splice; s++) {
+        for (int32 d = 0; d < patch_dim_; d++) {
+          patch_columns[p].push_back(p * patch_step_ + s * patch_stride_ + d);
+        }
+      }
+    }
+    cu::ComputePatchIndexes(patch_columns, input_dim_,
+                            &patch_forward_indexes_, &patch_backward_indexes_);
+  }
+
   int32 patch_dim_,    ///< number of consecutive inputs, 1st dim of patch
         patch_step_,   ///< step of the convolution (i.e. shift between 2 patches)
         patch_stride_; ///< shift for 2nd dim of a patch (i.e. frame length before splicing)
@@ -431,20 +367,26 @@ class ConvolutionalComponent : public UpdatableComponent {
   BaseFloat max_norm_; ///< limit L2 norm of a neuron weights to positive value
 
   /** Buffer of reshaped inputs:
-   *  1row = vectorized rectangular feature patches,
-   *  1col = dim over speech frames
-   *  Map of input features:
-   *  std::vector-dim = patch-position
+   *  1row = vectorized rectangular feature patch,
+   *  one block of rows (over speech frames) per patch position
    */
   CuMatrix<BaseFloat> vectorized_feature_patches_;
-  std::vector<int32> column_map_;
 
   /** Buffer for backpropagation:
    *  derivatives in the domain of 'vectorized_feature_patches_',
-   *  1row = vectorized rectangular feature patches,
-   *  1col = dim over speech frames,
+   *  same layout
    */
   CuMatrix<BaseFloat> feature_patch_diffs_;
+
+  /** Buffer of the filter outputs (or their derivatives) in the layout of
+   *  'vectorized_feature_patches_', i.e. one block of rows per patch position
+   */
+  CuMatrix<BaseFloat> patch_outputs_;
+
+  /// Index arrays for cu::UnfoldPatches() and cu::FoldPatches(),
+  /// computed on the first use.
+  std::vector<CuArray<int32> > patch_forward_indexes_;
+  std::vector<CuArray<int32> > patch_backward_indexes_;
 };
 
 } // namespace nnet1
@@ -325,6 +325,7 @@ class LstmProjectedStreams : public UpdatableComponent {
     CuSubMatrix<BaseFloat> YR(propagate_buf_.ColRange(7*ncell_, nrecur_));
 
     CuSubMatrix<BaseFloat> YGIFO(propagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> YGIFOCHM(propagate_buf_.ColRange(0, 7*ncell_));
 
     // x -> g, i, f, o, not recurrent, do it all in once
     YGIFO.RowRange(1*S,T*S).AddMatMat(1.0, in, kNoTrans, w_gifo_x_, kTrans, 0.0);
@@ -354,43 +355,15 @@ class LstmProjectedStreams : public UpdatableComponent {
       CuSubMatrix<BaseFloat> y_r(YR.RowRange(t*S,S));
 
       CuSubMatrix<BaseFloat> y_gifo(YGIFO.RowRange(t*S,S));
+      CuSubMatrix<BaseFloat> y_gifochm(YGIFOCHM.RowRange(t*S,S));
 
       // r(t-1) -> g, i, f, o
       y_gifo.AddMatMat(1.0, YR.RowRange((t-1)*S,S), kNoTrans, w_gifo_r_, kTrans,  1.0);
 
-      // c(t-1) -> i(t) via peephole
-      y_i.AddMatDiagVec(1.0, YC.RowRange((t-1)*S,S), kNoTrans, peephole_i_c_, 1.0);
-
-      // c(t-1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, YC.RowRange((t-1)*S,S), kNoTrans, peephole_f_c_, 1.0);
-
-      // i, f sigmoid squashing
-      y_i.Sigmoid(y_i);
-      y_f.Sigmoid(y_f);
-
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g -> c
-      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-
-      // c(t-1) -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, YC.RowRange((t-1)*S,S), y_f, 1.0);
-
-      y_c.ApplyFloor(-50);   // optional clipping of cell activation
-      y_c.ApplyCeiling(50);  // google paper Interspeech2014: LSTM for LVCSR
-
-      // h tanh squashing
-      y_h.Tanh(y_c);
-
-      // c(t) -> o(t) via peephole (non-recurrent) & o squashing
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, peephole_o_c_, 1.0);
-
-      // o sigmoid squashing
-      y_o.Sigmoid(y_o);
-
-      // h -> m via output gate
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+      // peepholes, nonlinearities, cell update and output gate, fused into
+      // one pass over g, i, f, o, c, h, m (see cu::LstmStepForward)
+      cu::LstmStepForward(peephole_i_c_, peephole_f_c_, peephole_o_c_,
+                          YGIFOCHM.RowRange((t-1)*S,S), &y_gifochm);
 
       // m -> r
       y_r.AddMatMat(1.0, y_m, kNoTrans, w_r_m_, kTrans, 0.0);
@@ -433,6 +406,8 @@ class LstmProjectedStreams : public UpdatableComponent {
     CuSubMatrix<BaseFloat> YM(propagate_buf_.ColRange(6*ncell_, ncell_));
     CuSubMatrix<BaseFloat> YR(propagate_buf_.ColRange(7*ncell_, nrecur_));
 
+    CuSubMatrix<BaseFloat> YGIFOCHM(propagate_buf_.ColRange(0, 7*ncell_));
+
     // 0:dummy, [1,T] frames, T+1 backward pass history
     backpropagate_buf_.Resize((T+2)*S, 7 * ncell_ + nrecur_, kSetZero);
 
@@ -447,6 +422,7 @@ class LstmProjectedStreams : public UpdatableComponent {
     CuSubMatrix<BaseFloat> DR(backpropagate_buf_.ColRange(7*ncell_, nrecur_));
 
     CuSubMatrix<BaseFloat> DGIFO(backpropagate_buf_.ColRange(0, 4*ncell_));
+    CuSubMatrix<BaseFloat> DGIFOCHM(backpropagate_buf_.ColRange(0, 7*ncell_));
 
     // projection layer to LSTM output is not recurrent, so backprop it all in once
     DR.RowRange(1*S,T*S).CopyFromMat(out_diff);
@@ -469,6 +445,7 @@ class LstmProjectedStreams : public UpdatableComponent {
       CuSubMatrix<BaseFloat> d_h(DH.RowRange(t*S,S));
       CuSubMatrix<BaseFloat> d_m(DM.RowRange(t*S,S));
       CuSubMatrix<BaseFloat> d_r(DR.RowRange(t*S,S));
+      CuSubMatrix<BaseFloat> d_gifochm(DGIFOCHM.RowRange(t*S,S));
 
       // r
       //   Version 1 (precise gradients):
@@ -491,37 +468,12 @@ class LstmProjectedStreams : public UpdatableComponent {
       // r -> m
       d_m.AddMatMat(1.0, d_r, kNoTrans, w_r_m_, kNoTrans, 0.0);
 
-      // m -> h via output gate
-      d_h.AddMatMatElements(1.0, d_m, y_o, 0.0);
-      d_h.DiffTanh(y_h, d_h);
-
-      // o
-      d_o.AddMatMatElements(1.0, d_m, y_h, 0.0);
-      d_o.DiffSigmoid(y_o, d_o);
-
-      // c
-      // 1. diff from h(t)
-      // 2. diff from c(t+1) (via forget-gate between CEC)
-      // 3. diff from i(t+1) (via peephole)
-      // 4. diff from f(t+1) (via peephole)
-      // 5. diff from o(t)   (via peephole, not recurrent)
-      d_c.AddMat(1.0, d_h);
-      d_c.AddMatMatElements(1.0, DC.RowRange((t+1)*S,S), YF.RowRange((t+1)*S,S), 1.0);
-      d_c.AddMatDiagVec(1.0, DI.RowRange((t+1)*S,S), kNoTrans, peephole_i_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, DF.RowRange((t+1)*S,S), kNoTrans, peephole_f_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, d_o                   , kNoTrans, peephole_o_c_, 1.0);
-
-      // f
-      d_f.AddMatMatElements(1.0, d_c, YC.RowRange((t-1)*S,S), 0.0);
-      d_f.DiffSigmoid(y_f, d_f);
-
-      // i
-      d_i.AddMatMatElements(1.0, d_c, y_g, 0.0);
-      d_i.DiffSigmoid(y_i, d_i);
-
-      // c -> g via input gate
-      d_g.AddMatMatElements(1.0, d_c, y_i, 0.0);
-      d_g.DiffTanh(y_g, d_g);
+      // m -> h, o; c (from h(t), c(t+1), i(t+1), f(t+1), o(t)) -> f, i, g,
+      // fused into one pass (see cu::LstmStepBackward)
+      cu::LstmStepBackward(peephole_i_c_, peephole_f_c_, peephole_o_c_,
+                           YGIFOCHM.RowRange((t-1)*S,S), YGIFOCHM.RowRange(t*S,S),
+                           YGIFOCHM.RowRange((t+1)*S,S), DGIFOCHM.RowRange((t+1)*S,S),
+                           &d_gifochm);
 
       // debug info
       if (DEBUG) {
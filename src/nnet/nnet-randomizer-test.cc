@@ -119,6 +119,23 @@ void UnitTestMatrixRandomizer() {
     const CuMatrixBase<BaseFloat> &m3 = r.Value();
   }
   KALDI_ASSERT(i == 22); // 22 minibatches
+
+  KALDI_LOG << "Filling a 2nd randomizer with the left-over";
+  // the 2nd randomizer continues where the 1st one stopped
+  MatrixRandomizer r2(c);
+  r2.AddData(m2);
+  r2.CopyLeftover(r);
+  KALDI_ASSERT(r2.NumFrames() == 22);
+  r2.AddData(m2);
+  KALDI_ASSERT(r2.IsFull());
+  KALDI_ASSERT(r2.NumFrames() == 22 + 1111);
+  {
+    const CuMatrixBase<BaseFloat> &m3 = r2.Value();
+    Matrix<BaseFloat> m4(m3.NumRows(),m3.NumCols()); m3.CopyToMat(&m4);
+    // the last 22 rows of the 2nd fill of 'r', then the new data
+    AssertEqual(m4.RowRange(0,22),m.RowRange(1089,22));
+    AssertEqual(m4.RowRange(22,78),m.RowRange(0,78));
+  }
 }
 
 void UnitTestVectorRandomizer() {
@@ -69,21 +69,33 @@ void MatrixRandomizer::AddData(const CuMatrixBase<BaseFloat>& m) {
   data_end_ += m.NumRows();
 }
 
+void MatrixRandomizer::CopyLeftover(const MatrixRandomizer &other) {
+  int32 leftover = other.data_end_ % conf_.minibatch_size;
+  if (data_.NumCols() != other.data_.NumCols() || data_.NumRows() < leftover) {
+    data_.Resize(std::max(conf_.randomizer_size, leftover),
+                 other.data_.NumCols());
+  }
+  if (leftover > 0) {
+    data_.RowRange(0, leftover).CopyFromMat(
+        other.data_.RowRange(other.data_end_ - leftover, leftover));
+  }
+  data_begin_ = 0; data_end_ = leftover;
+}
+
 void MatrixRandomizer::Randomize(const std::vector<int32>& mask) {
   KALDI_ASSERT(data_begin_ == 0);
   KALDI_ASSERT(data_end_ > 0);
   KALDI_ASSERT(data_end_ == mask.size());
-  // Copy to auxiliary buffer for unshuffled data
-  data_aux_ = data_;
-  // Put the mask to GPU 
-  CuArray<int32> mask_in_gpu(mask.size());
-  mask_in_gpu.CopyFromVec(mask);
-  // Randomize the data, mask is used to index rows in source matrix:
-  // (Here the vector 'mask_in_gpu' is typically shorter than number of rows in 'data_aux_',
-  //  because the the buffer 'data_aux_' is larger than capacity 'randomizer_size'.
-  //  The extra rows in 'data_aux_' do not contain speech frames and are not copied
-  //  from 'data_aux_', the extra rows in 'data_' are unchanged by cu::Randomize.)
-  cu::Randomize(data_aux_, mask_in_gpu, &data_);
+  // Put the mask to GPU
+  CuArray<int32> mask_in_gpu(mask);
+  // Randomize the data in a single pass: the rows are gathered in the order
+  // given by the mask into the auxiliary buffer, which then becomes 'data_'.
+  // (The mask is typically shorter than the number of rows in 'data_',
+  //  because the buffer is larger than capacity 'randomizer_size'; the extra
+  //  rows do not contain speech frames and are left undefined.)
+  data_aux_.Resize(data_.NumRows(), data_.NumCols(), kUndefined);
+  data_aux_.RowRange(0, data_end_).CopyRows(data_, mask_in_gpu);
+  data_.Swap(&data_aux_);
 }
 
 void MatrixRandomizer::Next() {
@@ -127,16 +139,29 @@ void VectorRandomizer::AddData(const Vector<BaseFloat>& v) {
   data_end_ += v.Dim();
 }
 
+void VectorRandomizer::CopyLeftover(const VectorRandomizer &other) {
+  int32 leftover = other.data_end_ % conf_.minibatch_size;
+  if (data_.Dim() < leftover) {
+    data_.Resize(std::max(conf_.randomizer_size, leftover));
+  }
+  if (leftover > 0) {
+    data_.Range(0, leftover).CopyFromVec(
+        other.data_.Range(other.data_end_ - leftover, leftover));
+  }
+  data_begin_ = 0; data_end_ = leftover;
+}
+
 void VectorRandomizer::Randomize(const std::vector<int32>& mask) {
   KALDI_ASSERT(data_begin_ == 0);
   KALDI_ASSERT(data_end_ > 0);
   KALDI_ASSERT(data_end_ == mask.size());
-  // Use auxiliary buffer for unshuffled data
-  Vector<BaseFloat> data_aux(data_);
-  // randomize the data, mask is used to index elements in source vector
+  // randomize the data into an auxiliary buffer in a single pass,
+  // mask is used to index elements in source vector
+  Vector<BaseFloat> data_aux(data_.Dim(), kUndefined);
   for(int32 i = 0; i<mask.size(); i++) {
-    data_(i) = data_aux(mask.at(i));
+    data_aux(i) = data_(mask[i]);
   }
+  data_.Swap(&data_aux);
 }
 
 void VectorRandomizer::Next() {
@@ -180,17 +205,30 @@ void StdVectorRandomizer<T>::AddData(const std::vector<T>& v) {
   data_end_ += v.size();
 }
 
+template<typename T>
+void StdVectorRandomizer<T>::CopyLeftover(const StdVectorRandomizer<T> &other) {
+  int32 leftover = other.data_end_ % conf_.minibatch_size;
+  if (data_.size() < leftover) {
+    data_.resize(std::max(conf_.randomizer_size, leftover));
+  }
+  std::copy(other.data_.begin() + other.data_end_ - leftover,
+            other.data_.begin() + other.data_end_, data_.begin());
+  data_begin_ = 0; data_end_ = leftover;
+}
+
 template<typename T>
 void StdVectorRandomizer<T>::Randomize(const std::vector<int32>& mask) {
   KALDI_ASSERT(data_begin_ == 0);
   KALDI_ASSERT(data_end_ > 0);
   KALDI_ASSERT(data_end_ == mask.size());
-  // Use auxiliary buffer for unshuffled data
-  std::vector<T> data_aux(data_);
-  // randomize the data, mask is used to index elements in source vector
+  // randomize the data into an auxiliary buffer, mask is used to index
+  // elements in source vector; as the mask is a permutation, each element
+  // is swapped (not deep-copied) into its new position.
+  std::vector<T> data_aux(data_.size());
   for(int32 i = 0; i<mask.size(); i++) {
-    data_.at(i) = data_aux.at(mask.at(i));
+    std::swap(data_aux[i], data_[mask[i]]);
   }
+  data_.swap(data_aux);
 }
 
 template<typename T>
@@ -76,6 +76,11 @@ class MatrixRandomizer {
   bool IsFull() { return ((data_begin_ == 0) && (data_end_ > conf_.randomizer_size )); }
   /// Number of frames stored inside the Randomizer
   int32 NumFrames() { return data_end_; }
+  /// Discards the data, and takes the frames which 'other' has left over
+  /// after its last full mini-batch (the frames it would keep for its next
+  /// fill).  Does not touch the cursor of 'other', so 'other' may deliver its
+  /// mini-batches in another thread meanwhile.
+  void CopyLeftover(const MatrixRandomizer &other);
   /// Randomize matrix row-order using mask
   void Randomize(const std::vector<int32>& mask);
 
@@ -114,6 +119,11 @@ class VectorRandomizer {
   bool IsFull() { return ((data_begin_ == 0) && (data_end_ > conf_.randomizer_size )); }
   /// Number of frames stored inside the Randomizer
   int32 NumFrames() { return data_end_; }
+  /// Discards the data, and takes the frames which 'other' has left over
+  /// after its last full mini-batch (the frames it would keep for its next
+  /// fill).  Does not touch the cursor of 'other', so 'other' may deliver its
+  /// mini-batches in another thread meanwhile.
+  void CopyLeftover(const VectorRandomizer &other);
   /// Randomize matrix row-order using mask
   void Randomize(const std::vector<int32>& mask);
 
@@ -152,6 +162,11 @@ class StdVectorRandomizer {
   bool IsFull() { return ((data_begin_ == 0) && (data_end_ > conf_.randomizer_size )); }
   /// Number of frames stored inside the Randomizer
   int32 NumFrames() { return data_end_; }
+  /// Discards the data, and takes the frames which 'other' has left over
+  /// after its last full mini-batch (the frames it would keep for its next
+  /// fill).  Does not touch the cursor of 'other', so 'other' may deliver its
+  /// mini-batches in another thread meanwhile.
+  void CopyLeftover(const StdVectorRandomizer &other);
   /// Randomize matrix row-order using mask
   void Randomize(const std::vector<int32>& mask);
 
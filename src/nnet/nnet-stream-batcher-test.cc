@@ -0,0 +1,251 @@
+// nnet/nnet-stream-batcher-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet/nnet-stream-batcher.h"
+
+#include <unistd.h>
+#include <vector>
+
+using namespace kaldi;
+using namespace kaldi::nnet1;
+
+// Frame t of utterance u has the features [ u t ] and the target
+// u * 1000 + t, so that we can check where each frame of a minibatch came from.
+static void AddTestUtterance(int32 u, int32 len, StreamBatcher *batcher) {
+  Matrix<BaseFloat> feats(len, 2);
+  Posterior targets(len);
+  Vector<BaseFloat> weights(len);
+  for (int32 t = 0; t < len; t++) {
+    feats(t, 0) = u;
+    feats(t, 1) = t;
+    targets[t].push_back(std::make_pair(u * 1000 + t, 1.0));
+    weights(t) = 1.0;
+  }
+  batcher->AddUtterance(&feats, &targets, &weights);
+}
+
+// Runs the batcher on utterances of the given lengths, as in the
+// documentation of StreamBatcher.
+static void GetAllBatches(const std::vector<int32> &lengths,
+                          StreamBatcher *batcher,
+                          std::vector<StreamBatch> *batches) {
+  size_t u = 0;
+  while (true) {
+    while (batcher->NeedsInput()) {
+      if (u < lengths.size()) {
+        AddTestUtterance(u, lengths[u], batcher);
+        u++;
+      } else {
+        batcher->InputDone();
+      }
+    }
+    StreamBatch batch;
+    if (!batcher->GetBatch(&batch)) break;
+    batches->push_back(batch);
+  }
+  KALDI_ASSERT(u == lengths.size());
+}
+
+void UnitTestStreamBatcherTruncated() {
+  int32 num_utts = 1 + Rand() % 30;
+  std::vector<int32> lengths(num_utts);
+  int64 tot_frames = 0;
+  for (int32 u = 0; u < num_utts; u++) {
+    lengths[u] = 1 + Rand() % 50;
+    tot_frames += lengths[u];
+  }
+  StreamBatcherOptions opts;
+  opts.num_streams = 1 + Rand() % 5;
+  opts.batch_size = 1 + Rand() % 10;
+  opts.targets_delay = Rand() % 4;
+  opts.bucket_size = Rand() % 8;
+  StreamBatcher batcher(opts);
+  std::vector<StreamBatch> batches;
+  GetAllBatches(lengths, &batcher, &batches);
+
+  int32 num_streams = opts.num_streams;
+  // next frame expected of each utterance, and current utterance per stream.
+  std::vector<int32> next_frame(num_utts, 0), stream_utt(num_streams, -1);
+  int64 num_real = 0;
+  int32 num_new = 0;
+  for (size_t b = 0; b < batches.size(); b++) {
+    const StreamBatch &batch = batches[b];
+    KALDI_ASSERT(batch.feats.NumRows() == opts.batch_size * num_streams);
+    KALDI_ASSERT(batch.new_utt_flags.size() == num_streams);
+    num_new += batch.num_new_utts;
+    for (int32 s = 0; s < num_streams; s++) {
+      for (int32 t = 0; t < opts.batch_size; t++) {
+        int32 r = t * num_streams + s;
+        if (batch.weights(r) == 0.0) continue;
+        KALDI_ASSERT(batch.weights(r) == 1.0);
+        int32 id = batch.targets[r][0].first, u = id / 1000, pos = id % 1000;
+        if (t == 0 && batch.new_utt_flags[s] == 1) stream_utt[s] = u;
+        KALDI_ASSERT(stream_utt[s] == u && next_frame[u] == pos);
+        next_frame[u]++;
+        num_real++;
+        // the features are delayed, and padded with the last frame.
+        int32 feat_pos = std::min(pos + opts.targets_delay, lengths[u] - 1);
+        KALDI_ASSERT(batch.feats(r, 0) == u && batch.feats(r, 1) == feat_pos);
+      }
+    }
+    KALDI_ASSERT(batch.num_real_frames == batch.weights.Sum());
+  }
+  for (int32 u = 0; u < num_utts; u++)
+    KALDI_ASSERT(next_frame[u] == lengths[u]);
+  KALDI_ASSERT(num_new == num_utts);
+  KALDI_ASSERT(num_real == tot_frames && batcher.NumRealFrames() == tot_frames);
+  KALDI_ASSERT(batcher.NumBatches() == batches.size());
+  KALDI_LOG << batcher.EfficiencyInfo();
+}
+
+void UnitTestStreamBatcherWholeUtt() {
+  int32 num_utts = 1 + Rand() % 30;
+  std::vector<int32> lengths(num_utts);
+  for (int32 u = 0; u < num_utts; u++)
+    lengths[u] = 1 + Rand() % 50;
+
+  for (int32 sorted = 0; sorted < 2; sorted++) {
+    StreamBatcherOptions opts;
+    opts.num_streams = 1 + Rand() % 5;
+    opts.batch_size = 0;
+    opts.frame_limit = (sorted == 0 ? 40 + Rand() % 100 : 100000);
+    opts.bucket_size = (sorted == 0 ? 0 : num_utts);
+    StreamBatcher batcher(opts);
+    std::vector<StreamBatch> batches;
+    GetAllBatches(lengths, &batcher, &batches);
+
+    std::vector<bool> seen(num_utts, false);
+    for (size_t b = 0; b < batches.size(); b++) {
+      const StreamBatch &batch = batches[b];
+      int32 n = batch.seq_lengths.size(), max_len = 0;
+      KALDI_ASSERT(n > 0 && n <= opts.num_streams && batch.num_new_utts == n);
+      for (int32 s = 0; s < n; s++)
+        max_len = std::max(max_len, batch.seq_lengths[s]);
+      KALDI_ASSERT(batch.feats.NumRows() == n * max_len);
+      for (int32 s = 0; s < n; s++) {
+        int32 u = batch.feats(s, 0);
+        KALDI_ASSERT(!seen[u] && batch.seq_lengths[s] == lengths[u]);
+        seen[u] = true;
+        for (int32 t = 0; t < max_len; t++) {
+          int32 r = t * n + s;
+          if (t < lengths[u]) {
+            KALDI_ASSERT(batch.weights(r) == 1.0 &&
+                         batch.targets[r][0].first == u * 1000 + t &&
+                         batch.feats(r, 0) == u && batch.feats(r, 1) == t);
+          } else {  // padding
+            KALDI_ASSERT(batch.weights(r) == 0.0 && batch.targets[r].empty() &&
+                         batch.feats.Row(r).Sum() == 0.0);
+          }
+        }
+      }
+      if (sorted == 1 && b > 0)  // longest first.
+        KALDI_ASSERT(batch.seq_lengths[0] <= batches[b-1].seq_lengths.back());
+    }
+    for (int32 u = 0; u < num_utts; u++)
+      KALDI_ASSERT(seen[u]);
+    KALDI_LOG << batcher.EfficiencyInfo();
+  }
+}
+
+void UnitTestStreamBatcherBucketing() {
+  // with whole utterances and no frame limit, sorting all the utterances by
+  // length can only reduce the padding.
+  int32 num_utts = 2 + Rand() % 50;
+  std::vector<int32> lengths(num_utts);
+  for (int32 u = 0; u < num_utts; u++)
+    lengths[u] = 1 + Rand() % 100;
+  StreamBatcherOptions opts;
+  opts.num_streams = 1 + Rand() % 8;
+  opts.batch_size = 0;
+  StreamBatcher batcher(opts);
+  std::vector<StreamBatch> batches;
+  GetAllBatches(lengths, &batcher, &batches);
+
+  opts.bucket_size = num_utts;
+  StreamBatcher sorted_batcher(opts);
+  std::vector<StreamBatch> sorted_batches;
+  GetAllBatches(lengths, &sorted_batcher, &sorted_batches);
+
+  KALDI_ASSERT(batcher.NumRealFrames() == sorted_batcher.NumRealFrames());
+  KALDI_ASSERT(sorted_batcher.NumComputedFrames() <=
+               batcher.NumComputedFrames());
+}
+
+// Reads all the minibatches with a StreamBatchReader.
+static void ReadAllBatches(const StreamBatcherOptions &opts, bool background,
+                           std::vector<StreamBatch> *batches) {
+  SequentialBaseFloatMatrixReader feature_reader("ark:tmpf.feats.ark");
+  RandomAccessPosteriorReader targets_reader("ark:tmpf.targets.ark");
+  RandomAccessBaseFloatVectorReader weights_reader;
+  StreamBatchReader reader(opts, &feature_reader, &targets_reader,
+                           &weights_reader, NULL, 5, background);
+  const StreamBatch *batch;
+  while ((batch = reader.NextBatch()) != NULL)
+    batches->push_back(*batch);
+  KALDI_ASSERT(reader.NumNoTargets() == 0 && reader.NumOtherErrors() == 0);
+}
+
+void UnitTestStreamBatchReader() {
+  // the background thread gives the same minibatches, in the same order, as
+  // reading in the main thread.
+  int32 num_utts = 1 + Rand() % 30;
+  {
+    BaseFloatMatrixWriter feature_writer("ark:tmpf.feats.ark");
+    PosteriorWriter targets_writer("ark:tmpf.targets.ark");
+    for (int32 u = 0; u < num_utts; u++) {
+      std::ostringstream utt;
+      utt << "utt" << u;
+      int32 len = 1 + Rand() % 50;
+      Matrix<BaseFloat> feats(len, 2);
+      Posterior targets(len);
+      for (int32 t = 0; t < len; t++) {
+        feats(t, 0) = u;
+        feats(t, 1) = t;
+        targets[t].push_back(std::make_pair(u * 1000 + t, 1.0));
+      }
+      feature_writer.Write(utt.str(), feats);
+      targets_writer.Write(utt.str(), targets);
+    }
+  }
+  StreamBatcherOptions opts;
+  opts.num_streams = 1 + Rand() % 5;
+  opts.batch_size = Rand() % 10;
+  opts.bucket_size = Rand() % 8;
+  std::vector<StreamBatch> serial, background;
+  ReadAllBatches(opts, false, &serial);
+  ReadAllBatches(opts, true, &background);
+  KALDI_ASSERT(!serial.empty() && serial.size() == background.size());
+  for (size_t b = 0; b < serial.size(); b++) {
+    KALDI_ASSERT(serial[b].feats.ApproxEqual(background[b].feats, 0.0));
+    KALDI_ASSERT(serial[b].targets == background[b].targets);
+    KALDI_ASSERT(serial[b].weights.ApproxEqual(background[b].weights, 0.0));
+    KALDI_ASSERT(serial[b].new_utt_flags == background[b].new_utt_flags);
+    KALDI_ASSERT(serial[b].seq_lengths == background[b].seq_lengths);
+  }
+  unlink("tmpf.feats.ark");
+  unlink("tmpf.targets.ark");
+}
+
+int main() {
+  for (int32 i = 0; i < 10; i++) {
+    UnitTestStreamBatcherTruncated();
+    UnitTestStreamBatcherWholeUtt();
+    UnitTestStreamBatcherBucketing();
+    UnitTestStreamBatchReader();
+  }
+  std::cout << "Tests succeeded.\n";
+}
@@ -0,0 +1,307 @@
+// nnet/nnet-stream-batcher.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet/nnet-stream-batcher.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace kaldi {
+namespace nnet1 {
+
+/* StreamBatcher:: */
+
+StreamBatcher::StreamBatcher(const StreamBatcherOptions &opts):
+    opts_(opts), ready_begin_(0), input_done_(false),
+    num_real_frames_(0), num_computed_frames_(0), num_batches_(0) {
+  KALDI_ASSERT(opts_.num_streams > 0 && opts_.batch_size >= 0 &&
+               opts_.targets_delay >= 0);
+}
+
+StreamBatcher::~StreamBatcher() {
+  DeletePointers(&bucket_);
+  for (size_t i = ready_begin_; i < ready_.size(); i++)
+    delete ready_[i];
+  DeletePointers(&streams_);
+}
+
+int32 StreamBatcher::NumNeeded() const {
+  if (opts_.batch_size == 0) return opts_.num_streams;
+  if (streams_.empty()) return opts_.num_streams;
+  int32 ans = 0;
+  for (size_t s = 0; s < streams_.size(); s++)
+    if (streams_[s] == NULL ||
+        stream_pos_[s] >= streams_[s]->feats.NumRows())
+      ans++;
+  return ans;
+}
+
+bool StreamBatcher::NeedsInput() const {
+  return (!input_done_ &&
+          static_cast<int32>(ready_.size() - ready_begin_) < NumNeeded());
+}
+
+void StreamBatcher::AddUtterance(Matrix<BaseFloat> *feats,
+                                 Posterior *targets,
+                                 Vector<BaseFloat> *weights) {
+  KALDI_ASSERT(!input_done_);
+  KALDI_ASSERT(feats->NumRows() > 0 &&
+               feats->NumRows() == targets->size() &&
+               feats->NumRows() == weights->Dim());
+  Utterance *utt = new Utterance;
+  utt->feats.Swap(feats);
+  utt->targets.swap(*targets);
+  utt->weights.Swap(weights);
+  bucket_.push_back(utt);
+  if (static_cast<int32>(bucket_.size()) >= std::max(opts_.bucket_size, 1))
+    FlushBucket();
+}
+
+void StreamBatcher::InputDone() {
+  input_done_ = true;
+  FlushBucket();
+}
+
+void StreamBatcher::FlushBucket() {
+  if (opts_.bucket_size > 1)
+    std::stable_sort(bucket_.begin(), bucket_.end(), LongerThan);
+  ready_.erase(ready_.begin(), ready_.begin() + ready_begin_);
+  ready_begin_ = 0;
+  ready_.insert(ready_.end(), bucket_.begin(), bucket_.end());
+  bucket_.clear();
+}
+
+StreamBatcher::Utterance *StreamBatcher::NextUtterance() {
+  if (ready_begin_ == ready_.size()) return NULL;
+  return ready_[ready_begin_++];
+}
+
+bool StreamBatcher::GetBatch(StreamBatch *batch) {
+  KALDI_ASSERT(!NeedsInput());
+  bool ans = (opts_.batch_size > 0 ? GetTruncatedBatch(batch) :
+              GetWholeUttBatch(batch));
+  if (ans) {
+    num_real_frames_ += batch->num_real_frames;
+    num_computed_frames_ += batch->feats.NumRows();
+    num_batches_++;
+  }
+  return ans;
+}
+
+bool StreamBatcher::GetTruncatedBatch(StreamBatch *batch) {
+  int32 num_streams = opts_.num_streams, batch_size = opts_.batch_size;
+  if (streams_.empty()) {
+    streams_.resize(num_streams, NULL);
+    stream_pos_.resize(num_streams, 0);
+  }
+  // feed the exhausted streams with new utterances.
+  batch->new_utt_flags.assign(num_streams, 0);
+  batch->seq_lengths.clear();
+  batch->num_new_utts = 0;
+  bool have_data = false;
+  int32 feat_dim = 0;
+  for (int32 s = 0; s < num_streams; s++) {
+    if (streams_[s] == NULL ||
+        stream_pos_[s] >= streams_[s]->feats.NumRows()) {
+      Utterance *utt = NextUtterance();
+      if (utt != NULL) {
+        delete streams_[s];
+        streams_[s] = utt;
+        stream_pos_[s] = 0;
+        batch->new_utt_flags[s] = 1;
+        batch->num_new_utts++;
+      }
+    }
+    if (streams_[s] != NULL) {
+      feat_dim = streams_[s]->feats.NumCols();
+      if (stream_pos_[s] < streams_[s]->feats.NumRows()) have_data = true;
+    }
+  }
+  // we are done if all streams are exhausted.
+  if (!have_data) return false;
+
+  // fill the minibatch: the padding at the end of an utterance has zero
+  // weight and repeats the last target; the features are shifted by the
+  // targets delay, and padded with the last frame.
+  int32 num_rows = batch_size * num_streams;
+  batch->feats.Resize(num_rows, feat_dim, kUndefined);
+  batch->targets.resize(num_rows);
+  batch->weights.Resize(num_rows, kUndefined);
+  batch->num_real_frames = 0;
+  for (int32 s = 0; s < num_streams; s++) {
+    const Utterance *utt = streams_[s];
+    for (int32 t = 0; t < batch_size; t++) {
+      int32 r = t * num_streams + s;
+      if (utt == NULL) {  // this stream never had any data.
+        batch->feats.Row(r).SetZero();
+        batch->targets[r].clear();
+        batch->weights(r) = 0.0;
+        continue;
+      }
+      int32 pos = stream_pos_[s] + t, len = utt->feats.NumRows();
+      if (pos < len) {
+        batch->targets[r] = utt->targets[pos];
+        batch->weights(r) = utt->weights(pos);
+        batch->num_real_frames++;
+      } else {
+        batch->targets[r] = utt->targets[len - 1];
+        batch->weights(r) = 0.0;
+      }
+      int32 feat_pos = std::min(pos + opts_.targets_delay, len - 1);
+      batch->feats.Row(r).CopyFromVec(utt->feats.Row(feat_pos));
+    }
+    stream_pos_[s] += batch_size;
+  }
+  return true;
+}
+
+bool StreamBatcher::GetWholeUttBatch(StreamBatch *batch) {
+  std::vector<Utterance*> utts;
+  int32 max_len = 0;
+  while (static_cast<int32>(utts.size()) < opts_.num_streams) {
+    Utterance *utt = NextUtterance();
+    if (utt == NULL) break;
+    utts.push_back(utt);
+    max_len = std::max(max_len, utt->feats.NumRows());
+    // If the total number of frames reaches frame_limit, then stop adding
+    // more utterances, regardless of whether we have num_streams of them.
+    if (static_cast<int32>(utts.size()) * max_len > opts_.frame_limit) break;
+  }
+  if (utts.empty()) return false;
+
+  // every utterance is padded to the max length within the minibatch.
+  int32 num_utts = utts.size(), num_rows = num_utts * max_len;
+  batch->feats.Resize(num_rows, utts[0]->feats.NumCols(), kSetZero);
+  batch->targets.clear();
+  batch->targets.resize(num_rows);
+  batch->weights.Resize(num_rows, kSetZero);
+  batch->new_utt_flags.assign(num_utts, 1);
+  batch->seq_lengths.resize(num_utts);
+  batch->num_new_utts = num_utts;
+  batch->num_real_frames = 0;
+  for (int32 s = 0; s < num_utts; s++) {
+    const Utterance *utt = utts[s];
+    int32 len = utt->feats.NumRows();
+    for (int32 t = 0; t < len; t++) {
+      int32 r = t * num_utts + s;
+      batch->feats.Row(r).CopyFromVec(utt->feats.Row(t));
+      batch->targets[r] = utt->targets[t];
+      batch->weights(r) = utt->weights(t);
+    }
+    batch->seq_lengths[s] = len;
+    batch->num_real_frames += len;
+  }
+  DeletePointers(&utts);
+  return true;
+}
+
+std::string StreamBatcher::EfficiencyInfo() const {
+  std::ostringstream os;
+  os << "Computed " << num_computed_frames_ << " frames in " << num_batches_
+     << " minibatches, of which " << num_real_frames_ << " were real frames ("
+     << (num_computed_frames_ == 0 ? 0.0 :
+         100.0 * num_real_frames_ / num_computed_frames_)
+     << "% efficiency, the rest is padding).";
+  return os.str();
+}
+
+
+/* StreamBatchReader:: */
+
+StreamBatchReader::StreamBatchReader(
+    const StreamBatcherOptions &opts,
+    SequentialBaseFloatMatrixReader *feature_reader,
+    RandomAccessPosteriorReader *targets_reader,
+    RandomAccessBaseFloatVectorReader *weights_reader,
+    Nnet *feature_transform,
+    int32 length_tolerance,
+    bool background):
+    batcher_(opts), feature_reader_(feature_reader),
+    targets_reader_(targets_reader), weights_reader_(weights_reader),
+    feature_transform_(feature_transform),
+    length_tolerance_(length_tolerance), num_no_tgt_mat_(0),
+    num_other_error_(0), reader_(this, background ? 1 : 0) { }
+
+bool StreamBatchReader::Read(StreamBatch *batch) {
+  while (batcher_.NeedsInput()) {
+    if (!ReadUtterance())
+      batcher_.InputDone();
+  }
+  return batcher_.GetBatch(batch);
+}
+
+bool StreamBatchReader::ReadUtterance() {
+  bool use_weights = (weights_reader_ != NULL && weights_reader_->IsOpen());
+  for ( ; !feature_reader_->Done(); feature_reader_->Next()) {
+    std::string utt = feature_reader_->Key();
+    KALDI_VLOG(3) << "Reading " << utt;
+    // check that we have targets
+    if (!targets_reader_->HasKey(utt)) {
+      KALDI_WARN << utt << ", missing targets";
+      num_no_tgt_mat_++;
+      continue;
+    }
+    // check we have per-frame weights
+    if (use_weights && !weights_reader_->HasKey(utt)) {
+      KALDI_WARN << utt << ", missing per-frame weights";
+      num_other_error_++;
+      continue;
+    }
+    // get feature / target pair, apply optional feature transform;
+    // it may contain <Splice>, so it is applied to whole utterances.
+    Matrix<BaseFloat> feats;
+    if (feature_transform_ != NULL) {
+      CuMatrix<BaseFloat> feats_transf;
+      feature_transform_->Feedforward(
+          CuMatrix<BaseFloat>(feature_reader_->Value()), &feats_transf);
+      feats_transf.Swap(&feats);
+    } else {
+      feats = feature_reader_->Value();
+    }
+    Posterior targets = targets_reader_->Value(utt);
+    // get per-frame weights
+    Vector<BaseFloat> weights;
+    if (use_weights) {
+      weights = weights_reader_->Value(utt);
+    } else {  // all per-frame weights are 1.0
+      weights.Resize(feats.NumRows());
+      weights.Set(1.0);
+    }
+    // correct small length mismatch ... or drop sentence
+    int32 min = std::min(feats.NumRows(), std::min<int32>(targets.size(),
+                                                          weights.Dim())),
+        max = std::max(feats.NumRows(), std::max<int32>(targets.size(),
+                                                        weights.Dim()));
+    if (max - min < length_tolerance_ && min > 0) {
+      if (feats.NumRows() != min) feats.Resize(min, feats.NumCols(), kCopyData);
+      if (targets.size() != min) targets.resize(min);
+      if (weights.Dim() != min) weights.Resize(min, kCopyData);
+    } else {
+      KALDI_WARN << utt << ", length mismatch of targets " << targets.size()
+                 << " and features " << feats.NumRows();
+      num_other_error_++;
+      continue;
+    }
+    batcher_.AddUtterance(&feats, &targets, &weights);
+    feature_reader_->Next();
+    return true;
+  }
+  return false;
+}
+
+} // namespace nnet1
+} // namespace kaldi
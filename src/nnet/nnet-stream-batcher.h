@@ -0,0 +1,234 @@
+// nnet/nnet-stream-batcher.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_NNET_NNET_STREAM_BATCHER_H_
+#define KALDI_NNET_NNET_STREAM_BATCHER_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "hmm/posterior.h"
+#include "matrix/kaldi-matrix.h"
+#include "nnet/nnet-nnet.h"
+#include "thread/kaldi-background-reader.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+/// Configuration of the multi-stream minibatches of the recurrent-network
+/// trainers (nnet-train-lstm-streams, nnet-train-blstm-streams).  The binaries
+/// register these under their own option names.
+struct StreamBatcherOptions {
+  /// Number of utterances processed in parallel.
+  int32 num_streams;
+  /// If > 0, the minibatches are for truncated BPTT: each stream holds one
+  /// utterance at a time, which is cut into pieces of 'batch_size' frames, and
+  /// a stream gets its next utterance once the previous one is finished.
+  /// If 0, each minibatch contains up to 'num_streams' whole utterances,
+  /// padded to the longest one.
+  int32 batch_size;
+  /// For truncated BPTT: the features are delayed by this many frames
+  /// w.r.t. the targets.
+  int32 targets_delay;
+  /// For whole utterances: no more utterances are added to a minibatch once
+  /// it has this many frames, including the padding.
+  int32 frame_limit;
+  /// If > 1, the utterances are read in groups of this many, and each group is
+  /// sorted by length (longest first), so that the utterances processed in
+  /// parallel have similar lengths and less padding is needed.
+  int32 bucket_size;
+
+  StreamBatcherOptions(): num_streams(4), batch_size(20), targets_delay(0),
+                          frame_limit(100000), bucket_size(0) { }
+};
+
+
+/// One multi-stream minibatch.  The frames of the streams are interleaved:
+/// row t * num_streams + s is frame t of stream s.
+struct StreamBatch {
+  Matrix<BaseFloat> feats;
+  Posterior targets;
+  /// The frame weights; zero for the padding.
+  Vector<BaseFloat> weights;
+  /// For truncated BPTT: 1 for the streams that start a new utterance in this
+  /// minibatch (their LSTM state needs to be reset), see
+  /// Nnet::ResetLstmStreams().
+  std::vector<int32> new_utt_flags;
+  /// For whole utterances: the lengths of the utterances (before padding),
+  /// see Nnet::SetSeqLengths().
+  std::vector<int32> seq_lengths;
+  /// The number of utterances started in this minibatch.
+  int32 num_new_utts;
+  /// The number of real (non-padding) frames.
+  int32 num_real_frames;
+
+  StreamBatch(): num_new_utts(0), num_real_frames(0) { }
+};
+
+
+/**
+   StreamBatcher arranges utterances into multi-stream minibatches
+   (StreamBatch), see StreamBatcherOptions for the two types of minibatches.
+   Usage:
+   \code
+     while (true) {
+       while (batcher.NeedsInput()) {
+         if (<there are more utterances>) batcher.AddUtterance(...);
+         else batcher.InputDone();
+       }
+       if (!batcher.GetBatch(&batch)) break;
+       ...
+     }
+   \endcode
+   It keeps statistics of the real and computed (including padding) frames,
+   which show how much work is spent on padding for a given number of streams.
+*/
+class StreamBatcher {
+ public:
+  explicit StreamBatcher(const StreamBatcherOptions &opts);
+  ~StreamBatcher();
+
+  /// Returns true if more utterances (or a call to InputDone()) are needed
+  /// before GetBatch() can be called.
+  bool NeedsInput() const;
+
+  /// Adds an utterance; the features should already have the feature
+  /// transform applied.  The contents of the arguments are taken (swapped)
+  /// to avoid copying.
+  void AddUtterance(Matrix<BaseFloat> *feats, Posterior *targets,
+                    Vector<BaseFloat> *weights);
+
+  /// Call this when there are no more utterances.
+  void InputDone();
+
+  /// Outputs the next minibatch; returns false if there are no more.
+  bool GetBatch(StreamBatch *batch);
+
+  /// The number of real frames in the minibatches so far.
+  int64 NumRealFrames() const { return num_real_frames_; }
+  /// The number of frames computed (real frames plus padding) so far.
+  int64 NumComputedFrames() const { return num_computed_frames_; }
+  /// The number of minibatches so far.
+  int64 NumBatches() const { return num_batches_; }
+  /// Returns a line describing the efficiency (real frames / computed frames).
+  std::string EfficiencyInfo() const;
+
+ private:
+  struct Utterance {
+    Matrix<BaseFloat> feats;
+    Posterior targets;
+    Vector<BaseFloat> weights;
+  };
+  static bool LongerThan(const Utterance *a, const Utterance *b) {
+    return a->feats.NumRows() > b->feats.NumRows();
+  }
+
+  /// Moves the utterances read so far to the end of 'ready_', sorted if
+  /// we are using buckets.
+  void FlushBucket();
+  /// The number of utterances the next minibatch may need.
+  int32 NumNeeded() const;
+  /// Removes and returns the next utterance of 'ready_', or NULL.
+  Utterance *NextUtterance();
+
+  bool GetTruncatedBatch(StreamBatch *batch);
+  bool GetWholeUttBatch(StreamBatch *batch);
+
+  StreamBatcherOptions opts_;
+  /// The utterances being read into the current bucket.
+  std::vector<Utterance*> bucket_;
+  /// The utterances ready to be used, from 'ready_begin_' on.
+  std::vector<Utterance*> ready_;
+  size_t ready_begin_;
+  bool input_done_;
+
+  /// For truncated BPTT, the utterance in each stream (or NULL) and the
+  /// position in it.
+  std::vector<Utterance*> streams_;
+  std::vector<int32> stream_pos_;
+
+  int64 num_real_frames_;
+  int64 num_computed_frames_;
+  int64 num_batches_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(StreamBatcher);
+};
+
+
+/**
+   StreamBatchReader reads the training data of the multi-stream trainers
+   (features, targets and optionally per-frame weights), applies the feature
+   transform to each utterance, and arranges the data into minibatches with a
+   StreamBatcher.  If 'background' is true, this is done in a background
+   thread, which prepares the next minibatch while the current one is being
+   trained on.  The GPU can only be used from the main thread, so with a GPU,
+   'background' must be false unless 'feature_transform' is NULL.
+*/
+class StreamBatchReader: private BackgroundReader<StreamBatch>::Source {
+ public:
+  /// 'weights_reader' is only used if it is open.  Utterances whose features,
+  /// targets and weights differ in length by less than 'length_tolerance'
+  /// frames are truncated to the shortest of them; others are skipped.
+  StreamBatchReader(const StreamBatcherOptions &opts,
+                    SequentialBaseFloatMatrixReader *feature_reader,
+                    RandomAccessPosteriorReader *targets_reader,
+                    RandomAccessBaseFloatVectorReader *weights_reader,
+                    Nnet *feature_transform,
+                    int32 length_tolerance,
+                    bool background);
+
+  /// Returns the next minibatch, or NULL when there are no more.  The batch
+  /// remains valid until the next call.
+  const StreamBatch *NextBatch() { return reader_.Next(); }
+
+  int32 NumNoTargets() const { return num_no_tgt_mat_; }
+  int32 NumOtherErrors() const { return num_other_error_; }
+  /// The batcher, for its statistics; only call this after NextBatch() has
+  /// returned NULL if we use a background thread.
+  const StreamBatcher &Batcher() const { return batcher_; }
+
+ private:
+  /// Reads utterances until the batcher can produce a minibatch, and puts it
+  /// in *batch; returns false if there are no more.
+  virtual bool Read(StreamBatch *batch);
+  /// Reads the next valid utterance and gives it to the batcher; returns
+  /// false at the end of the input.
+  bool ReadUtterance();
+
+  StreamBatcher batcher_;
+  SequentialBaseFloatMatrixReader *feature_reader_;
+  RandomAccessPosteriorReader *targets_reader_;
+  RandomAccessBaseFloatVectorReader *weights_reader_;
+  Nnet *feature_transform_;
+  int32 length_tolerance_;
+  int32 num_no_tgt_mat_;
+  int32 num_other_error_;
+
+  // Declared last, so that the background thread is stopped before the
+  // other members are destroyed.
+  BackgroundReader<StreamBatch> reader_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(StreamBatchReader);
+};
+
+} // namespace nnet1
+} // namespace kaldi
+
+#endif
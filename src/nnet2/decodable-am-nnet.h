@@ -33,6 +33,13 @@ namespace nnet2 {
 
 /// DecodableAmNnet is a decodable object that decodes
 /// with a neural net acoustic model of type AmNnet.
+///
+/// If frame_subsampling_factor > 1, the network output is only computed for
+/// every frame_subsampling_factor'th frame.  If repeat_frames == false, the
+/// decoder sees only those frames (so the decoding graph must be built for the
+/// lower frame rate, e.g. with a reduced topology); if true, each computed
+/// frame is repeated for the following frame_subsampling_factor - 1 frames, so
+/// the decoder sees all the frames and the graph needs no change.
 
 class DecodableAmNnet: public DecodableInterface {
  public:
@@ -41,8 +48,12 @@ class DecodableAmNnet: public DecodableInterface {
                   const CuMatrixBase<BaseFloat> &feats,
                   bool pad_input = true, // if !pad_input, the NumIndices()
                                          // will be < feats.NumRows().
-                  BaseFloat prob_scale = 1.0):
-      trans_model_(trans_model) {
+                  BaseFloat prob_scale = 1.0,
+                  int32 frame_subsampling_factor = 1,
+                  bool repeat_frames = false):
+      trans_model_(trans_model), num_frames_(0),
+      repeat_factor_(repeat_frames ? frame_subsampling_factor : 1) {
+    KALDI_ASSERT(frame_subsampling_factor > 0);
     // Note: we could make this more memory-efficient by doing the
     // computation in smaller chunks than the whole utterance, and not
     // storing the whole thing.  We'll leave this for later.
@@ -54,9 +65,13 @@ class DecodableAmNnet: public DecodableInterface {
                  << "empty output.";
       return;
     }
-    CuMatrix<BaseFloat> log_probs(num_rows, trans_model.NumPdfs());
+    int32 num_computed_rows = (num_rows + frame_subsampling_factor - 1) /
+        frame_subsampling_factor;
+    num_frames_ = (repeat_frames ? num_rows : num_computed_rows);
+    CuMatrix<BaseFloat> log_probs(num_computed_rows, trans_model.NumPdfs());
     // the following function is declared in nnet-compute.h
-    NnetComputation(am_nnet.GetNnet(), feats, pad_input, &log_probs);
+    NnetComputation(am_nnet.GetNnet(), feats, pad_input,
+                    frame_subsampling_factor, &log_probs);
     log_probs.ApplyFloor(1.0e-20); // Avoid log of zero which leads to NaN.
     log_probs.ApplyLog();
     CuVector<BaseFloat> priors(am_nnet.Priors());
@@ -75,11 +90,11 @@ class DecodableAmNnet: public DecodableInterface {
   // Note, frames are numbered from zero.  But transition_id is numbered
   // from one (this routine is called by FSTs).
   virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id) {
-    return log_probs_(frame,
+    return log_probs_(frame / repeat_factor_,
                       trans_model_.TransitionIdToPdf(transition_id));
   }
 
-  virtual int32 NumFramesReady() const { return log_probs_.NumRows(); }
+  virtual int32 NumFramesReady() const { return num_frames_; }
   
   // Indices are one-based!  This is for compatibility with OpenFst.
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
@@ -93,6 +108,8 @@ class DecodableAmNnet: public DecodableInterface {
   const TransitionModel &trans_model_;
   Matrix<BaseFloat> log_probs_; // actually not really probabilities, since we divide
   // by the prior -> they won't sum to one.
+  int32 num_frames_;  // The number of frames the decoder sees.
+  int32 repeat_factor_;  // Frame t uses row t / repeat_factor_ of log_probs_.
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmNnet);
 };
@@ -109,17 +126,33 @@ class DecodableAmNnetParallel: public DecodableInterface {
       const AmNnet &am_nnet,
       const CuMatrix<BaseFloat> *feats,
       bool pad_input = true,
-      BaseFloat prob_scale = 1.0):
+      BaseFloat prob_scale = 1.0,
+      int32 frame_subsampling_factor = 1,
+      bool repeat_frames = false):
       trans_model_(trans_model), am_nnet_(am_nnet), feats_(feats),
-      pad_input_(pad_input), prob_scale_(prob_scale) {
-    KALDI_ASSERT(feats_ != NULL);
+      pad_input_(pad_input), prob_scale_(prob_scale),
+      frame_subsampling_factor_(frame_subsampling_factor),
+      repeat_frames_(repeat_frames) {
+    KALDI_ASSERT(feats_ != NULL && frame_subsampling_factor > 0);
+    num_frames_ = feats_->NumRows();
+    if (!pad_input_)
+      num_frames_ = std::max<int32>(0, num_frames_ -
+                                    am_nnet_.GetNnet().LeftContext() -
+                                    am_nnet_.GetNnet().RightContext());
+    if (!repeat_frames_)
+      num_frames_ = (num_frames_ + frame_subsampling_factor_ - 1) /
+          frame_subsampling_factor_;
   }
 
   void Compute() {
-    log_probs_.Resize(feats_->NumRows(), trans_model_.NumPdfs());
+    int32 num_rows = (repeat_frames_ ?
+                      (num_frames_ + frame_subsampling_factor_ - 1) /
+                      frame_subsampling_factor_ : num_frames_);
+    log_probs_.Resize(num_rows, trans_model_.NumPdfs());
     // the following function is declared in nnet-compute.h
-    NnetComputation(am_nnet_.GetNnet(), *feats_,
-                    pad_input_, &log_probs_);
+    if (num_rows != 0)
+      NnetComputation(am_nnet_.GetNnet(), *feats_, pad_input_,
+                      frame_subsampling_factor_, &log_probs_);
     log_probs_.ApplyFloor(1.0e-20); // Avoid log of zero which leads to NaN.
     log_probs_.ApplyLog();
     CuVector<BaseFloat> priors(am_nnet_.Priors());
@@ -138,23 +171,12 @@ class DecodableAmNnetParallel: public DecodableInterface {
   // from one (this routine is called by FSTs).
   virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id) {
     if (feats_) Compute(); // this function sets feats_ to NULL.
+    if (repeat_frames_) frame /= frame_subsampling_factor_;
     return log_probs_(frame,
                       trans_model_.TransitionIdToPdf(transition_id));
   }
 
-  int32 NumFramesReady() const {
-    if (feats_) {
-      if (pad_input_) return feats_->NumRows();
-      else {
-        int32 ans = feats_->NumRows() - am_nnet_.GetNnet().LeftContext() -
-            am_nnet_.GetNnet().RightContext();
-        if (ans < 0) ans = 0;
-        return ans;
-      }
-    } else {
-      return log_probs_.NumRows();
-    }
-  }
+  int32 NumFramesReady() const { return num_frames_; }
   
   // Indices are one-based!  This is for compatibility with OpenFst.
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
@@ -174,6 +196,9 @@ class DecodableAmNnetParallel: public DecodableInterface {
   const CuMatrix<BaseFloat> *feats_;
   bool pad_input_;
   BaseFloat prob_scale_;
+  int32 frame_subsampling_factor_;
+  bool repeat_frames_;
+  int32 num_frames_;  // The number of frames the decoder sees.
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmNnetParallel);
 };
 
@@ -144,7 +144,7 @@ void SoftmaxComponent::MixUp(int32 num_mixtures,
   
   // bias and linear terms from affine component:
   Vector<BaseFloat> old_bias_term(ac->bias_params_);
-  Matrix<BaseFloat> old_linear_term(ac->linear_params_);
+  Matrix<BaseFloat> old_linear_term(ac->LinearParams());
   
   Vector<BaseFloat> new_bias_term(new_dim);
   Matrix<BaseFloat> new_linear_term(new_dim, affine_input_dim);
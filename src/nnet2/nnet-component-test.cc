@@ -20,6 +20,7 @@
 
 #include "nnet2/nnet-component.h"
 #include "util/common-utils.h"
+#include "util/mapped-input.h"
 
 namespace kaldi {
 namespace nnet2 {
@@ -362,6 +363,136 @@ void UnitTestAffineComponent() {
   }
 }
 
+void UnitTestAffineComponentCompressed() {
+  BaseFloat learning_rate = 0.01,
+      param_stddev = 0.1, bias_stddev = 1.0;
+  int32 input_dim = 5 + Rand() % 100, output_dim = 5 + Rand() % 100;
+  AffineComponentPreconditionedOnline component;
+  component.Init(learning_rate, input_dim, output_dim, param_stddev,
+                 bias_stddev, 2, 2, 1, 2000.0, 4.0, 0.1);
+  std::ostringstream os, os_compressed;
+  component.Write(os, true);
+  component.SetCompressOnWrite(true);
+  component.Write(os_compressed, true);
+  // the compressed matrix has 1 byte per element, plus headers.
+  KALDI_ASSERT(os_compressed.str().size() < os.str().size());
+
+  std::istringstream is(os_compressed.str());
+  Component *c = Component::ReadNew(is, true);
+  AffineComponent *ac = dynamic_cast<AffineComponentPreconditionedOnline*>(c);
+  KALDI_ASSERT(ac != NULL);
+  Vector<BaseFloat> bias1(ac->BiasParams()), bias2(component.BiasParams());
+  AssertEqual(bias1, bias2);  // the bias is not compressed.
+  CuMatrix<BaseFloat> diff(ac->LinearParams());
+  diff.AddMat(-1.0, component.LinearParams());
+  BaseFloat rel_error = diff.FrobeniusNorm() /
+      component.LinearParams().FrobeniusNorm();
+  KALDI_LOG << "Relative error from compression is " << rel_error;
+  KALDI_ASSERT(rel_error < 0.02);
+  delete c;
+}
+
+void UnitTestAffineComponentMapped() {
+  BaseFloat learning_rate = 0.01,
+      param_stddev = 0.1, bias_stddev = 1.0;
+  int32 input_dim = 5 + Rand() % 100, output_dim = 5 + Rand() % 100;
+  AffineComponent component1;
+  component1.Init(learning_rate, input_dim, output_dim,
+                  param_stddev, bias_stddev);
+  AffineComponentPreconditionedOnline component2;
+  component2.Init(learning_rate, output_dim, input_dim, param_stddev,
+                  bias_stddev, 2, 2, 1, 2000.0, 4.0, 0.1);
+  component1.SetAlignOnWrite(true);
+  component2.SetAlignOnWrite(true);
+  {
+    Output ko("tmpf", true);
+    component1.Write(ko.Stream(), true);
+    component2.Write(ko.Stream(), true);
+  }
+  CuMatrix<BaseFloat> input(10, input_dim), output1(10, output_dim),
+      output2(10, output_dim);
+  input.SetRandn();
+  component1.Propagate(ChunkInfo(input_dim, 1, 0, 9),
+                       ChunkInfo(output_dim, 1, 0, 9), input, &output1);
+  {
+    bool binary;
+    MappedInput mi("tmpf", &binary);
+    Component *c1 = Component::ReadNew(mi.Stream(), binary),
+        *c2 = Component::ReadNew(mi.Stream(), binary);
+    AffineComponent *ac1 = dynamic_cast<AffineComponent*>(c1),
+        *ac2 = dynamic_cast<AffineComponentPreconditionedOnline*>(c2);
+    KALDI_ASSERT(ac1 != NULL && ac2 != NULL);
+#if HAVE_CUDA == 1
+    if (!CuDevice::Instantiate().Enabled())
+#endif
+    {
+      // the weights are used in place, aligned by SetAlignOnWrite(), and
+      // copies share them.
+      const BaseFloat *data = ac2->LinearParams().Data();
+      KALDI_ASSERT(reinterpret_cast<size_t>(data) % 64 == 0);
+      AffineComponent *ac3 = dynamic_cast<AffineComponent*>(c2->Copy());
+      KALDI_ASSERT(ac3->LinearParams().Data() == data);
+      // changing the parameters copies them first (the mapping is read-only).
+      ac3->Scale(2.0);
+      KALDI_ASSERT(ac3->LinearParams().Data() != data);
+      delete ac3;
+    }
+    CuMatrix<BaseFloat> params1(ac2->LinearParams()),
+        params2(component2.LinearParams());
+    AssertEqual(params1, params2);
+    c1->Propagate(ChunkInfo(input_dim, 1, 0, 9),
+                  ChunkInfo(output_dim, 1, 0, 9), input, &output2);
+    AssertEqual(output1, output2);
+    // Init() replaces the mapped parameters.
+    ac1->Init(learning_rate, 3, 4, param_stddev, bias_stddev);
+    KALDI_ASSERT(ac1->InputDim() == 3 && ac1->OutputDim() == 4);
+    delete c1;
+    delete c2;
+  }
+  {
+    // the padding is skipped when reading with class Input.
+    bool binary;
+    Input ki("tmpf", &binary);
+    Component *c1 = Component::ReadNew(ki.Stream(), binary),
+        *c2 = Component::ReadNew(ki.Stream(), binary);
+    CuMatrix<BaseFloat> params1(
+        dynamic_cast<AffineComponent*>(c1)->LinearParams()),
+        params2(component1.LinearParams());
+    AssertEqual(params1, params2);
+    params1 = dynamic_cast<AffineComponent*>(c2)->LinearParams();
+    params2 = component2.LinearParams();
+    AssertEqual(params1, params2);
+    delete c1;
+    delete c2;
+  }
+  {
+    // a build with double-precision BaseFloat reads the padded float data
+    // with Matrix<double>::Read().
+    bool binary;
+    Input ki("tmpf", &binary);
+    ExpectToken(ki.Stream(), binary, "<AffineComponent>");
+    ExpectToken(ki.Stream(), binary, "<LearningRate>");
+    BaseFloat learning_rate_in;
+    ReadBasicType(ki.Stream(), binary, &learning_rate_in);
+    ExpectToken(ki.Stream(), binary, "<LinearParams>");
+    Matrix<double> params;
+    params.Read(ki.Stream(), binary);
+    Matrix<BaseFloat> params_float(component1.LinearParams());
+    Matrix<double> params_ref(params_float);
+    KALDI_ASSERT(params.ApproxEqual(params_ref, 0.0));
+  }
+  {
+    // without SetAlignOnWrite() there is no padding.
+    component1.SetAlignOnWrite(false);
+    std::ostringstream os1, os2;
+    os2 << 'x';  // a different position in the output.
+    component1.Write(os1, true);
+    component1.Write(os2, true);
+    KALDI_ASSERT(os2.str().size() == os1.str().size() + 1);
+  }
+  unlink("tmpf");
+}
+
 void UnitTestConvolutional1dComponent() {
   BaseFloat learning_rate = 0.01,
             param_stddev = 0.1, bias_stddev = 1.0;
@@ -890,6 +1021,8 @@ int main() {
       UnitTestFixedBiasComponent();
       UnitTestAffineComponentPreconditioned();
       UnitTestAffineComponentPreconditionedOnline();
+      UnitTestAffineComponentCompressed();
+      UnitTestAffineComponentMapped();
       UnitTestConvolutional1dComponent();
       UnitTestDropoutComponent();
       UnitTestAdditiveNoiseComponent();
@@ -26,9 +26,11 @@
 #include "nnet2/nnet-component.h"
 #include "nnet2/nnet-precondition.h"
 #include "nnet2/nnet-precondition-online.h"
+#include "cudamatrix/cu-math.h"
 #include "util/stl-utils.h"
 #include "util/text-utils.h"
 #include "util/kaldi-io.h"
+#include "util/mapped-input.h"
 
 namespace kaldi {
 namespace nnet2 {
@@ -1048,6 +1050,7 @@ void LogSoftmaxComponent::Backprop(const ChunkInfo &in_info,
 
 
 void AffineComponent::Scale(BaseFloat scale) {
+  CopyMappedParams();
   linear_params_.Scale(scale);
   bias_params_.Scale(scale);
 }
@@ -1055,6 +1058,7 @@ void AffineComponent::Scale(BaseFloat scale) {
 // virtual
 void AffineComponent::Resize(int32 input_dim, int32 output_dim) {
   KALDI_ASSERT(input_dim > 0 && output_dim > 0);
+  CopyMappedParams();
   bias_params_.Resize(output_dim);
   linear_params_.Resize(output_dim, input_dim);
 }
@@ -1063,7 +1067,8 @@ void AffineComponent::Add(BaseFloat alpha, const UpdatableComponent &other_in) {
   const AffineComponent *other =
       dynamic_cast<const AffineComponent*>(&other_in);
   KALDI_ASSERT(other != NULL);
-  linear_params_.AddMat(alpha, other->linear_params_);
+  CopyMappedParams();
+  linear_params_.AddMat(alpha, other->LinearParams());
   bias_params_.AddVec(alpha, other->bias_params_);
 }
 
@@ -1071,14 +1076,23 @@ AffineComponent::AffineComponent(const AffineComponent &component):
     UpdatableComponent(component),
     linear_params_(component.linear_params_),
     bias_params_(component.bias_params_),
-    is_gradient_(component.is_gradient_) { }
+    is_gradient_(component.is_gradient_),
+    compress_on_write_(component.compress_on_write_),
+    align_on_write_(component.align_on_write_),
+    mapped_linear_params_(NULL) {
+  // A mapped copy shares the data of the MappedInput.
+  if (component.mapped_linear_params_ != NULL)
+    mapped_linear_params_ =
+        new CuSubMatrix<BaseFloat>(*component.mapped_linear_params_);
+}
 
 AffineComponent::AffineComponent(const CuMatrixBase<BaseFloat> &linear_params,
                                  const CuVectorBase<BaseFloat> &bias_params,
                                  BaseFloat learning_rate):
     UpdatableComponent(learning_rate),
     linear_params_(linear_params),
-    bias_params_(bias_params) {
+    bias_params_(bias_params), compress_on_write_(false),
+    align_on_write_(false), mapped_linear_params_(NULL) {
   KALDI_ASSERT(linear_params.NumRows() == bias_params.Dim()&&
                bias_params.Dim() != 0);
   is_gradient_ = false;
@@ -1090,6 +1104,7 @@ void AffineComponent::SetZero(bool treat_as_gradient) {
   if (treat_as_gradient) {
     SetLearningRate(1.0);
   }
+  CopyMappedParams();
   linear_params_.SetZero();
   bias_params_.SetZero();
   if (treat_as_gradient)
@@ -1098,12 +1113,14 @@ void AffineComponent::SetZero(bool treat_as_gradient) {
 
 void AffineComponent::SetParams(const VectorBase<BaseFloat> &bias,
                                 const MatrixBase<BaseFloat> &linear) {
+  CopyMappedParams();
   bias_params_ = bias;
   linear_params_ = linear;
   KALDI_ASSERT(bias_params_.Dim() == linear_params_.NumRows());
 }
 
 void AffineComponent::PerturbParams(BaseFloat stddev) {
+  CopyMappedParams();
   CuMatrix<BaseFloat> temp_linear_params(linear_params_);
   temp_linear_params.SetRandn();
   linear_params_.AddMat(stddev, temp_linear_params);
@@ -1115,10 +1132,11 @@ void AffineComponent::PerturbParams(BaseFloat stddev) {
 
 std::string AffineComponent::Info() const {
   std::stringstream stream;
-  BaseFloat linear_params_size = static_cast<BaseFloat>(linear_params_.NumRows())
-      * static_cast<BaseFloat>(linear_params_.NumCols());
+  const CuMatrixBase<BaseFloat> &linear_params = LinearParams();
+  BaseFloat linear_params_size = static_cast<BaseFloat>(linear_params.NumRows())
+      * static_cast<BaseFloat>(linear_params.NumCols());
   BaseFloat linear_stddev =
-      std::sqrt(TraceMatMat(linear_params_, linear_params_, kTrans) /
+      std::sqrt(TraceMatMat(linear_params, linear_params, kTrans) /
                 linear_params_size),
       bias_stddev = std::sqrt(VecVec(bias_params_, bias_params_) /
                               bias_params_.Dim());
@@ -1134,15 +1152,20 @@ Component* AffineComponent::Copy() const {
   AffineComponent *ans = new AffineComponent();
   ans->learning_rate_ = learning_rate_;
   ans->linear_params_ = linear_params_;
+  if (mapped_linear_params_ != NULL)
+    ans->mapped_linear_params_ =
+        new CuSubMatrix<BaseFloat>(*mapped_linear_params_);
   ans->bias_params_ = bias_params_;
   ans->is_gradient_ = is_gradient_;
+  ans->compress_on_write_ = compress_on_write_;
+  ans->align_on_write_ = align_on_write_;
   return ans;
 }
 
 BaseFloat AffineComponent::DotProduct(const UpdatableComponent &other_in) const {
   const AffineComponent *other =
       dynamic_cast<const AffineComponent*>(&other_in);
-  return TraceMatMat(linear_params_, other->linear_params_, kTrans)
+  return TraceMatMat(LinearParams(), other->LinearParams(), kTrans)
       + VecVec(bias_params_, other->bias_params_);
 }
 
@@ -1150,6 +1173,7 @@ void AffineComponent::Init(BaseFloat learning_rate,
                            int32 input_dim, int32 output_dim,
                            BaseFloat param_stddev, BaseFloat bias_stddev) {
   UpdatableComponent::Init(learning_rate);
+  CopyMappedParams();
   linear_params_.Resize(output_dim, input_dim);
   bias_params_.Resize(output_dim);
   KALDI_ASSERT(output_dim > 0 && input_dim > 0 && param_stddev >= 0.0);
@@ -1162,6 +1186,7 @@ void AffineComponent::Init(BaseFloat learning_rate,
 void AffineComponent::Init(BaseFloat learning_rate,
                            std::string matrix_filename) {
   UpdatableComponent::Init(learning_rate);
+  CopyMappedParams();
   CuMatrix<BaseFloat> mat;
   ReadKaldiObject(matrix_filename, &mat); // will abort on failure.
   KALDI_ASSERT(mat.NumCols() >= 2);
@@ -1216,7 +1241,7 @@ void AffineComponent::Propagate(const ChunkInfo &in_info,
   // No need for asserts as they'll happen within the matrix operations.
   out->CopyRowsFromVec(bias_params_); // copies bias_params_ to each row
   // of *out.
-  out->AddMatMat(1.0, in, kNoTrans, linear_params_, kTrans, 1.0);
+  out->AddMatMat(1.0, in, kNoTrans, LinearParams(), kTrans, 1.0);
 }
 
 void AffineComponent::UpdateSimple(const CuMatrixBase<BaseFloat> &in_value,
@@ -1236,12 +1261,13 @@ void AffineComponent::Backprop(const ChunkInfo &, //in_info,
   AffineComponent *to_update = dynamic_cast<AffineComponent*>(to_update_in);
   in_deriv->Resize(out_deriv.NumRows(), InputDim());
   // Propagate the derivative back to the input.
-  in_deriv->AddMatMat(1.0, out_deriv, kNoTrans, linear_params_, kNoTrans,
+  in_deriv->AddMatMat(1.0, out_deriv, kNoTrans, LinearParams(), kNoTrans,
                       0.0);
 
   if (to_update != NULL) {
     // Next update the model (must do this 2nd so the derivatives we propagate
     // are accurate, in case this == to_update_in.)
+    to_update->CopyMappedParams();
     if (to_update->is_gradient_)
       to_update->UpdateSimple(in_value, out_deriv);
     else  // the call below is to a virtual function that may be re-implemented
@@ -1258,7 +1284,7 @@ void AffineComponent::Read(std::istream &is, bool binary) {
   ExpectOneOrTwoTokens(is, binary, ostr_beg.str(), "<LearningRate>");
   ReadBasicType(is, binary, &learning_rate_);
   ExpectToken(is, binary, "<LinearParams>");
-  linear_params_.Read(is, binary);
+  ReadLinearParams(is, binary);
   ExpectToken(is, binary, "<BiasParams>");
   bias_params_.Read(is, binary);
   std::string tok;
@@ -1281,6 +1307,70 @@ void AffineComponent::Read(std::istream &is, bool binary) {
   }
 }
 
+void AffineComponent::WriteLinearParams(std::ostream &os, bool binary) const {
+  if (compress_on_write_ && binary) {
+    // Matrix::Read() recognizes the compressed form, so the reading code needs
+    // no changes.
+    Matrix<BaseFloat> linear_params(LinearParams());
+    CompressedMatrix compressed(linear_params);
+    compressed.Write(os, binary);
+    return;
+  }
+  if (align_on_write_ && binary) {
+    // The data follows the "FM" token and the two dimensions, which take 13
+    // bytes.  If the position is unknown (e.g. writing to a pipe), we can't
+    // align, and ReadLinearParams() will copy the data.
+    std::streamoff pos = os.tellp();
+    if (pos >= 0) {
+      const std::streamoff kAlign = 64, kHeaderSize = 13;
+      std::streamoff padding = (kAlign - (pos + kHeaderSize) % kAlign) % kAlign;
+      os << std::string(padding, ' ');
+    }
+  }
+  LinearParams().Write(os, binary);
+}
+
+void AffineComponent::ReadLinearParams(std::istream &is, bool binary) {
+  delete mapped_linear_params_;
+  mapped_linear_params_ = NULL;
+  bool use_in_place = (binary && sizeof(BaseFloat) == sizeof(float) &&
+                       MappedInput::IsMappedStream(is));
+#if HAVE_CUDA == 1
+  // with a GPU the parameters have to be copied to it anyway.
+  use_in_place = use_in_place && !CuDevice::Instantiate().Enabled();
+#endif
+  if (use_in_place) {
+    is >> std::ws;  // skip the padding from WriteLinearParams().
+    std::streampos start = is.tellg();
+    if (is.peek() == 'F') {
+      ExpectToken(is, binary, "FM");
+      int32 rows, cols;
+      ReadBasicType(is, binary, &rows);
+      ReadBasicType(is, binary, &cols);
+      const char *data = (rows * cols == 0 ? NULL :
+                          MappedInput::MapData(is, sizeof(float) * rows * cols,
+                                               sizeof(float)));
+      if (data != NULL) {
+        linear_params_.Resize(0, 0);
+        mapped_linear_params_ = new CuSubMatrix<BaseFloat>(
+            reinterpret_cast<const BaseFloat*>(data), rows, cols, cols);
+        return;
+      }
+    }
+    // Not data we can use in place (e.g. a compressed matrix).
+    is.seekg(start);
+  }
+  linear_params_.Read(is, binary);
+}
+
+void AffineComponent::CopyMappedParams() {
+  if (mapped_linear_params_ != NULL) {
+    linear_params_ = *mapped_linear_params_;
+    delete mapped_linear_params_;
+    mapped_linear_params_ = NULL;
+  }
+}
+
 void AffineComponent::Write(std::ostream &os, bool binary) const {
   std::ostringstream ostr_beg, ostr_end;
   ostr_beg << "<" << Type() << ">"; // e.g. "<AffineComponent>"
@@ -1289,7 +1379,7 @@ void AffineComponent::Write(std::ostream &os, bool binary) const {
   WriteToken(os, binary, "<LearningRate>");
   WriteBasicType(os, binary, learning_rate_);
   WriteToken(os, binary, "<LinearParams>");
-  linear_params_.Write(os, binary);
+  WriteLinearParams(os, binary);
   WriteToken(os, binary, "<BiasParams>");
   bias_params_.Write(os, binary);
   WriteToken(os, binary, "<IsGradient>");
@@ -1301,11 +1391,12 @@ int32 AffineComponent::GetParameterDim() const {
   return (InputDim() + 1) * OutputDim();
 }
 void AffineComponent::Vectorize(VectorBase<BaseFloat> *params) const {
-  params->Range(0, InputDim() * OutputDim()).CopyRowsFromMat(linear_params_);
+  params->Range(0, InputDim() * OutputDim()).CopyRowsFromMat(LinearParams());
   params->Range(InputDim() * OutputDim(),
                 OutputDim()).CopyFromVec(bias_params_);
 }
 void AffineComponent::UnVectorize(const VectorBase<BaseFloat> &params) {
+  CopyMappedParams();
   linear_params_.CopyRowsFromVec(params.Range(0, InputDim() * OutputDim()));
   bias_params_.CopyFromVec(params.Range(InputDim() * OutputDim(),
                                         OutputDim()));
@@ -1316,7 +1407,7 @@ void AffineComponent::LimitRank(int32 d,
   KALDI_ASSERT(d <= InputDim());
 
   // We'll limit the rank of just the linear part, keeping the bias vector full.
-  Matrix<BaseFloat> M (linear_params_);
+  Matrix<BaseFloat> M (LinearParams());
   int32 rows = M.NumRows(), cols = M.NumCols(), rc_min = std::min(rows, cols);
   Vector<BaseFloat> s(rc_min);
   Matrix<BaseFloat> U(rows, rc_min), Vt(rc_min, cols);
@@ -1338,9 +1429,11 @@ void AffineComponent::LimitRank(int32 d,
   *a = dynamic_cast<AffineComponent*>(this->Copy());
   *b = dynamic_cast<AffineComponent*>(this->Copy());
 
+  (*a)->CopyMappedParams();
   (*a)->bias_params_.Resize(d, kSetZero);
   (*a)->linear_params_ = Vt;
 
+  (*b)->CopyMappedParams();
   (*b)->bias_params_ = this->bias_params_;
   (*b)->linear_params_ = U;
 }
@@ -1353,12 +1446,13 @@ Component *AffineComponent::CollapseWithNext(
   // as AffineComponentPreconditioned, but this will still work.
   // the "copy" call will copy things like learning rates, "alpha" value
   // for preconditioned component, etc.
+  ans->CopyMappedParams();
   ans->linear_params_.Resize(next_component.OutputDim(), InputDim());
   ans->bias_params_ = next_component.bias_params_;
 
-  ans->linear_params_.AddMatMat(1.0, next_component.linear_params_, kNoTrans,
-                                this->linear_params_, kNoTrans, 0.0);
-  ans->bias_params_.AddMatVec(1.0, next_component.linear_params_, kNoTrans,
+  ans->linear_params_.AddMatMat(1.0, next_component.LinearParams(), kNoTrans,
+                                this->LinearParams(), kNoTrans, 0.0);
+  ans->bias_params_.AddMatVec(1.0, next_component.LinearParams(), kNoTrans,
                               this->bias_params_, 1.0);
   return ans;
 }
@@ -1373,7 +1467,7 @@ Component *AffineComponent::CollapseWithNext(
   ans->bias_params_ = next_component.bias_params_;
 
   ans->linear_params_.AddMatMat(1.0, next_component.linear_params_, kNoTrans,
-                                this->linear_params_, kNoTrans, 0.0);
+                                this->LinearParams(), kNoTrans, 0.0);
   ans->bias_params_.AddMatVec(1.0, next_component.linear_params_, kNoTrans,
                               this->bias_params_, 1.0);
   return ans;
@@ -1385,6 +1479,7 @@ Component *AffineComponent::CollapseWithNext(
   AffineComponent *ans =
       dynamic_cast<AffineComponent*>(this->Copy());
   KALDI_ASSERT(ans != NULL);
+  ans->CopyMappedParams();
   ans->linear_params_.MulRowsVec(next_component.scales_);
   ans->bias_params_.MulElements(next_component.scales_);
 
@@ -1403,9 +1498,9 @@ Component *AffineComponent::CollapseWithPrevious(
   ans->linear_params_.Resize(this->OutputDim(), prev_component.InputDim());
   ans->bias_params_ = this->bias_params_;
 
-  ans->linear_params_.AddMatMat(1.0, this->linear_params_, kNoTrans,
+  ans->linear_params_.AddMatMat(1.0, this->LinearParams(), kNoTrans,
                                 prev_component.linear_params_, kNoTrans, 0.0);
-  ans->bias_params_.AddMatVec(1.0, this->linear_params_, kNoTrans,
+  ans->bias_params_.AddMatVec(1.0, this->LinearParams(), kNoTrans,
                               prev_component.bias_params_, 1.0);
   return ans;
 }
@@ -1419,7 +1514,7 @@ void AffineComponentPreconditioned::Read(std::istream &is, bool binary) {
   ExpectOneOrTwoTokens(is, binary, ostr_beg.str(), "<LearningRate>");
   ReadBasicType(is, binary, &learning_rate_);
   ExpectToken(is, binary, "<LinearParams>");
-  linear_params_.Read(is, binary);
+  ReadLinearParams(is, binary);
   ExpectToken(is, binary, "<BiasParams>");
   bias_params_.Read(is, binary);
   ExpectToken(is, binary, "<Alpha>");
@@ -1480,6 +1575,7 @@ void AffineComponentPreconditioned::Init(BaseFloat learning_rate,
                                          BaseFloat alpha, BaseFloat max_change,
                                          std::string matrix_filename) {
   UpdatableComponent::Init(learning_rate);
+  CopyMappedParams();
   alpha_ = alpha;
   max_change_ = max_change;
   CuMatrix<BaseFloat> mat;
@@ -1498,6 +1594,7 @@ void AffineComponentPreconditioned::Init(
     BaseFloat param_stddev, BaseFloat bias_stddev,
     BaseFloat alpha, BaseFloat max_change) {
   UpdatableComponent::Init(learning_rate);
+  CopyMappedParams();
   KALDI_ASSERT(input_dim > 0 && output_dim > 0);
   linear_params_.Resize(output_dim, input_dim);
   bias_params_.Resize(output_dim);
@@ -1521,7 +1618,7 @@ void AffineComponentPreconditioned::Write(std::ostream &os, bool binary) const {
   WriteToken(os, binary, "<LearningRate>");
   WriteBasicType(os, binary, learning_rate_);
   WriteToken(os, binary, "<LinearParams>");
-  linear_params_.Write(os, binary);
+  WriteLinearParams(os, binary);
   WriteToken(os, binary, "<BiasParams>");
   bias_params_.Write(os, binary);
   WriteToken(os, binary, "<Alpha>");
@@ -1533,10 +1630,11 @@ void AffineComponentPreconditioned::Write(std::ostream &os, bool binary) const {
 
 std::string AffineComponentPreconditioned::Info() const {
   std::stringstream stream;
-  BaseFloat linear_params_size = static_cast<BaseFloat>(linear_params_.NumRows())
-      * static_cast<BaseFloat>(linear_params_.NumCols());
+  const CuMatrixBase<BaseFloat> &linear_params = LinearParams();
+  BaseFloat linear_params_size = static_cast<BaseFloat>(linear_params.NumRows())
+      * static_cast<BaseFloat>(linear_params.NumCols());
   BaseFloat linear_stddev =
-      std::sqrt(TraceMatMat(linear_params_, linear_params_, kTrans) /
+      std::sqrt(TraceMatMat(linear_params, linear_params, kTrans) /
                 linear_params_size),
       bias_stddev = std::sqrt(VecVec(bias_params_, bias_params_) /
                               bias_params_.Dim());
@@ -1554,10 +1652,15 @@ Component* AffineComponentPreconditioned::Copy() const {
   AffineComponentPreconditioned *ans = new AffineComponentPreconditioned();
   ans->learning_rate_ = learning_rate_;
   ans->linear_params_ = linear_params_;
+  if (mapped_linear_params_ != NULL)
+    ans->mapped_linear_params_ =
+        new CuSubMatrix<BaseFloat>(*mapped_linear_params_);
   ans->bias_params_ = bias_params_;
   ans->alpha_ = alpha_;
   ans->max_change_ = max_change_;
   ans->is_gradient_ = is_gradient_;
+  ans->compress_on_write_ = compress_on_write_;
+  ans->align_on_write_ = align_on_write_;
   return ans;
 }
 
@@ -1649,6 +1752,7 @@ void AffineComponentPreconditionedOnline::Resize(
   KALDI_ASSERT(input_dim > 1 && output_dim > 1);
   if (rank_in_ >= input_dim) rank_in_ = input_dim - 1;
   if (rank_out_ >= output_dim) rank_out_ = output_dim - 1;
+  CopyMappedParams();
   bias_params_.Resize(output_dim);
   linear_params_.Resize(output_dim, input_dim);
   OnlinePreconditioner temp;
@@ -1667,7 +1771,7 @@ void AffineComponentPreconditionedOnline::Read(std::istream &is, bool binary) {
   ExpectOneOrTwoTokens(is, binary, ostr_beg.str(), "<LearningRate>");
   ReadBasicType(is, binary, &learning_rate_);
   ExpectToken(is, binary, "<LinearParams>");
-  linear_params_.Read(is, binary);
+  ReadLinearParams(is, binary);
   ExpectToken(is, binary, "<BiasParams>");
   bias_params_.Read(is, binary);
   std::string tok;
@@ -1760,6 +1864,7 @@ void AffineComponentPreconditionedOnline::Init(
     BaseFloat max_change_per_sample,
     std::string matrix_filename) {
   UpdatableComponent::Init(learning_rate);
+  CopyMappedParams();
   rank_in_ = rank_in;
   rank_out_ = rank_out;
   update_period_ = update_period;
@@ -1783,7 +1888,7 @@ AffineComponentPreconditionedOnline::AffineComponentPreconditionedOnline(
     int32 rank_in, int32 rank_out, int32 update_period,
     BaseFloat num_samples_history, BaseFloat alpha):
     max_change_per_sample_(0.1) {
-  this->linear_params_ = orig.linear_params_;
+  this->linear_params_ = orig.LinearParams();
   this->bias_params_ = orig.bias_params_;
   this->learning_rate_ = orig.learning_rate_;
   this->is_gradient_ = orig.is_gradient_;
@@ -1803,6 +1908,7 @@ void AffineComponentPreconditionedOnline::Init(
     BaseFloat num_samples_history, BaseFloat alpha,
     BaseFloat max_change_per_sample) {
   UpdatableComponent::Init(learning_rate);
+  CopyMappedParams();
   linear_params_.Resize(output_dim, input_dim);
   bias_params_.Resize(output_dim);
   KALDI_ASSERT(output_dim > 0 && input_dim > 0 && param_stddev >= 0.0 &&
@@ -1830,7 +1936,7 @@ void AffineComponentPreconditionedOnline::Write(std::ostream &os, bool binary) c
   WriteToken(os, binary, "<LearningRate>");
   WriteBasicType(os, binary, learning_rate_);
   WriteToken(os, binary, "<LinearParams>");
-  linear_params_.Write(os, binary);
+  WriteLinearParams(os, binary);
   WriteToken(os, binary, "<BiasParams>");
   bias_params_.Write(os, binary);
   WriteToken(os, binary, "<RankIn>");
@@ -1850,10 +1956,11 @@ void AffineComponentPreconditionedOnline::Write(std::ostream &os, bool binary) c
 
 std::string AffineComponentPreconditionedOnline::Info() const {
   std::stringstream stream;
-  BaseFloat linear_params_size = static_cast<BaseFloat>(linear_params_.NumRows())
-      * static_cast<BaseFloat>(linear_params_.NumCols());
+  const CuMatrixBase<BaseFloat> &linear_params = LinearParams();
+  BaseFloat linear_params_size = static_cast<BaseFloat>(linear_params.NumRows())
+      * static_cast<BaseFloat>(linear_params.NumCols());
   BaseFloat linear_stddev =
-      std::sqrt(TraceMatMat(linear_params_, linear_params_, kTrans) /
+      std::sqrt(TraceMatMat(linear_params, linear_params, kTrans) /
                 linear_params_size),
       bias_stddev = std::sqrt(VecVec(bias_params_, bias_params_) /
                               bias_params_.Dim());
@@ -1880,11 +1987,16 @@ Component* AffineComponentPreconditionedOnline::Copy() const {
   ans->num_samples_history_ = num_samples_history_;
   ans->alpha_ = alpha_;
   ans->linear_params_ = linear_params_;
+  if (mapped_linear_params_ != NULL)
+    ans->mapped_linear_params_ =
+        new CuSubMatrix<BaseFloat>(*mapped_linear_params_);
   ans->bias_params_ = bias_params_;
   ans->preconditioner_in_ = preconditioner_in_;
   ans->preconditioner_out_ = preconditioner_out_;
   ans->max_change_per_sample_ = max_change_per_sample_;
   ans->is_gradient_ = is_gradient_;
+  ans->compress_on_write_ = compress_on_write_;
+  ans->align_on_write_ = align_on_write_;
   ans->SetPreconditionerConfigs();
   return ans;
 }
@@ -3869,40 +3981,29 @@ void Convolutional1dComponent::Propagate(const ChunkInfo &in_info,
   KALDI_ASSERT(in_info.NumChunks() == out_info.NumChunks());
 
   // dims
-  int32 num_splice = InputDim() / patch_stride_;
   int32 num_patches = 1 + (patch_stride_ - patch_dim_) / patch_step_;
   int32 num_filters = filter_params_.NumRows();
   int32 num_frames = in.NumRows();
   int32 filter_dim = filter_params_.NumCols();
 
   /** Buffer of reshaped inputs:
-   *  1row = vectorized rectangular feature patches
+   *  1row = vectorized rectangular feature patch,
    *  1col = dim over speech frames,
+   *  the patch-positions are stacked as blocks of rows, so that all the
+   *  filters are applied to all the patches by one matrix multiplication.
    */
-  CuMatrix<BaseFloat> patches(num_frames, filter_dim * num_patches, kUndefined);
-  // column_map is indexed by the column-index of "patches",
-  // and the value is the corresponding column-index of "in". 
-  std::vector<int32> column_map(filter_dim * num_patches);
-
-  // build-up a column selection map
-  for (int32 p = 0, index = 0; p < num_patches; p++) {
-    for (int32 s = 0; s < num_splice; s++) {
-        for (int32 d = 0; d < patch_dim_; d++, index++) {
-        column_map[index] = p * patch_step_ + s * patch_stride_ + d;
-      }
-    }
-  }
-  CuArray<int32> cu_cols(column_map);
-  patches.CopyCols(in, cu_cols);
+  std::vector<CuArray<int32> > forward_indexes, backward_indexes;
+  ComputePatchIndexes(&forward_indexes, &backward_indexes);
+  CuMatrix<BaseFloat> patches(num_patches * num_frames, filter_dim, kUndefined);
+  cu::UnfoldPatches(in, forward_indexes, &patches);
 
   // compute filter activations
-  for (int32 p = 0; p < num_patches; p++) {
-    CuSubMatrix<BaseFloat> tgt(out->ColRange(p * num_filters, num_filters));
-    CuSubMatrix<BaseFloat> patch(patches.ColRange(p * filter_dim, filter_dim));
-    tgt.AddVecToRows(1.0, bias_params_, 0.0); // add bias
-    // apply all filters
-    tgt.AddMatMat(1.0, patch, kNoTrans, filter_params_, kTrans, 1.0);
-  }
+  CuMatrix<BaseFloat> patch_out(num_patches * num_frames, num_filters,
+                                kUndefined);
+  patch_out.AddVecToRows(1.0, bias_params_, 0.0); // add bias
+  // apply all filters
+  patch_out.AddMatMat(1.0, patches, kNoTrans, filter_params_, kTrans, 1.0);
+  cu::UnstackColumnBlocks(patch_out, out);
 }
 
 // scale the parameters
@@ -3920,61 +4021,22 @@ void Convolutional1dComponent::Add(BaseFloat alpha, const UpdatableComponent &ot
   bias_params_.AddVec(alpha, other->bias_params_);
 }
 
-/*
- This function does an operation similar to reversing a map,
- except it handles maps that are not one-to-one by outputting
- the reversed map as a vector of lists.
- @param[in] forward_indexes is a vector of int32, each of whose
-            elements is between 0 and input_dim - 1.
- @param[in] input_dim. See definitions of forward_indexes and
-            backward_indexes.
- @param[out] backward_indexes is a vector of dimension input_dim
-            of lists, The list at (backward_indexes[i]) is a list
-            of all indexes j such that forward_indexes[j] = i.
-*/
-void Convolutional1dComponent::ReverseIndexes(const std::vector<int32> &forward_indexes,
-                                              int32 input_dim,
-                                              std::vector<std::vector<int32> > *backward_indexes) {
-  int32 i, size = forward_indexes.size();
-  int32 reserve_size = 2 + size / input_dim;
-  backward_indexes->resize(input_dim);
-  std::vector<std::vector<int32> >::iterator iter = backward_indexes->begin(),
-    end = backward_indexes->end();
-  for (; iter != end; ++iter)
-    iter->reserve(reserve_size);
-  for (int32 j = 0; j < forward_indexes.size(); j++) {
-    i = forward_indexes[j];
-    KALDI_ASSERT(i < input_dim);
-    (*backward_indexes)[i].push_back(j);
-  }
-}
-
-/*
- This function transforms a vector of lists into a list of vectors,
- padded with -1.
- @param[in] The input vector of lists. Let in.size() be D, and let
-            the longest list length (i.e. the max of in[i].size()) be L.
- @param[out] The output list of vectors. The length of the list will
-            be L, each vector-dimension will be D (i.e. out[i].size() == D),
-            and if in[i] == j, then for some k we will have that
-            out[k][j] = i. The output vectors are padded with -1
-            where necessary if not all the input lists have the same side.
-*/
-void Convolutional1dComponent::RearrangeIndexes(const std::vector<std::vector<int32> > &in,
-                                                std::vector<std::vector<int32> > *out) {
-  int32 D = in.size();
-  int32 L = 0;
-  for (int32 i = 0; i < D; i++)
-    if (in[i].size() > L)
-      L = in[i].size();
-  out->resize(L);
-  for (int32 i = 0; i < L; i++)
-    (*out)[i].resize(D, -1);
-  for (int32 i = 0; i < D; i++) {
-    for (int32 j = 0; j < in[i].size(); j++) {
-      (*out)[j][i] = in[i][j];
-    }
+// The input columns of patch p are, for each of the spliced frames s, the
+// patch_dim_ columns starting at p * patch_step_ + s * patch_stride_.
+void Convolutional1dComponent::ComputePatchIndexes(
+    std::vector<CuArray<int32> > *forward_indexes,
+    std::vector<CuArray<int32> > *backward_indexes) const {
+  int32 num_splice = InputDim() / patch_stride_;
+  int32 num_patches = 1 + (patch_stride_ - patch_dim_) / patch_step_;
+  std::vector<std::vector<int32> > patch_columns(num_patches);
+  for (int32 p = 0; p < num_patches; p++) {
+    patch_columns[p].reserve(num_splice * patch_dim_);
+    for (int32 s = 0; s < num_splice; s++)
+      for (int32 d = 0; d < patch_dim_; d++)
+        patch_columns[p].push_back(p * patch_step_ + s * patch_stride_ + d);
   }
+  cu::ComputePatchIndexes(patch_columns, InputDim(), forward_indexes,
+                          backward_indexes);
 }
 
 // back propagation function
@@ -3987,7 +4049,6 @@ void Convolutional1dComponent::Backprop(const ChunkInfo &in_info,
                                         CuMatrix<BaseFloat> *in_deriv) const {
   in_deriv->Resize(out_deriv.NumRows(), InputDim());
   Convolutional1dComponent *to_update = dynamic_cast<Convolutional1dComponent*>(to_update_in);
-  int32 num_splice = InputDim() / patch_stride_;
   int32 num_patches = 1 + (patch_stride_ - patch_dim_) / patch_step_;
   int32 num_filters = filter_params_.NumRows();
   int32 num_frames = out_deriv.NumRows();
@@ -3995,38 +4056,22 @@ void Convolutional1dComponent::Backprop(const ChunkInfo &in_info,
 
   /** Buffer for backpropagation:
    *  derivatives in the domain of 'patches_',
-   *  1row = vectorized rectangular feature patches,
+   *  1row = vectorized rectangular feature patch,
    *  1col = dim over speech frames,
+   *  stacked by patch-position as in Propagate().
    */
-  CuMatrix<BaseFloat> patches_deriv(num_frames, filter_dim * num_patches, kSetZero);
-
-  // backpropagate to vector of matrices
-  // (corresponding to position of a filter)
-  for (int32 p = 0; p < num_patches; p++) {
-    CuSubMatrix<BaseFloat> patch_deriv(patches_deriv.ColRange(p * filter_dim, filter_dim));
-    CuSubMatrix<BaseFloat> out_deriv_patch(out_deriv.ColRange(p * num_filters,
-                                                              num_filters));
-    patch_deriv.AddMatMat(1.0, out_deriv_patch, kNoTrans,
+  CuMatrix<BaseFloat> out_deriv_stacked(num_patches * num_frames, num_filters,
+                                        kUndefined);
+  cu::StackColumnBlocks(out_deriv, &out_deriv_stacked);
+  CuMatrix<BaseFloat> patches_deriv(num_patches * num_frames, filter_dim,
+                                    kUndefined);
+  patches_deriv.AddMatMat(1.0, out_deriv_stacked, kNoTrans,
                           filter_params_, kNoTrans, 0.0);
-  }
 
   // sum the derivatives into in_deriv
-  std::vector<int32> column_map(filter_dim * num_patches);
-  for (int32 p = 0, index = 0; p < num_patches; p++) {
-    for (int32 s = 0; s < num_splice; s++) {
-      for (int32 d = 0; d < patch_dim_; d++, index++) {
-        column_map[index] = p * patch_step_ + s * patch_stride_ + d;
-      }
-    }
-  }
-  std::vector<std::vector<int32> > reversed_column_map;
-  ReverseIndexes(column_map, InputDim(), &reversed_column_map);
-  std::vector<std::vector<int32> > rearranged_column_map;
-  RearrangeIndexes(reversed_column_map, &rearranged_column_map);
-  for (int32 p = 0; p < rearranged_column_map.size(); p++) {
-    CuArray<int32> cu_cols(rearranged_column_map[p]);
-    in_deriv->AddCols(patches_deriv, cu_cols);
-  }
+  std::vector<CuArray<int32> > forward_indexes, backward_indexes;
+  ComputePatchIndexes(&forward_indexes, &backward_indexes);
+  cu::FoldPatches(patches_deriv, backward_indexes, in_deriv);
 
   if (to_update != NULL) {
     // Next update the model (must do this 2nd so the derivatives we propagate
@@ -4145,39 +4190,27 @@ void Convolutional1dComponent::Update(const CuMatrixBase<BaseFloat> &in_value,
   int32 num_filters = filter_params_.NumRows();
   int32 filter_dim = filter_params_.NumCols();
   int32 num_frames = in_value.NumRows();
-  int32 num_splice = InputDim() / patch_stride_;
   CuMatrix<BaseFloat> filters_grad;
   CuVector<BaseFloat> bias_grad;
 
-  /** Buffer of reshaped inputs:
-   *  1row = vectorized rectangular feature patches
-   *  1col = dim over speech frames,
+  /** Buffer of reshaped inputs, stacked by patch-position
+   *  as in Propagate().
    */
-  CuMatrix<BaseFloat> patches(num_frames, filter_dim * num_patches, kUndefined);
-  std::vector<int32> column_map(filter_dim * num_patches);
-  for (int32 p = 0, index = 0; p < num_patches; p++) {
-    for (int32 s = 0; s < num_splice; s++) {
-      for (int32 d = 0; d < patch_dim_; d++, index++) {
-        column_map[index] = p * patch_step_ + s * patch_stride_ + d;
-      }
-    }
-  }
-  CuArray<int32> cu_cols(column_map);
-  patches.CopyCols(in_value, cu_cols);
+  std::vector<CuArray<int32> > forward_indexes, backward_indexes;
+  ComputePatchIndexes(&forward_indexes, &backward_indexes);
+  CuMatrix<BaseFloat> patches(num_patches * num_frames, filter_dim, kUndefined);
+  cu::UnfoldPatches(in_value, forward_indexes, &patches);
+  CuMatrix<BaseFloat> out_deriv_stacked(num_patches * num_frames, num_filters,
+                                        kUndefined);
+  cu::StackColumnBlocks(out_deriv, &out_deriv_stacked);
 
   //
-  // calculate the gradient
+  // calculate the gradient, summed over all the patches
   //
-  filters_grad.Resize(num_filters, filter_dim, kSetZero); // reset
-  bias_grad.Resize(num_filters, kSetZero); // reset
-  // use all the patches
-  for (int32 p = 0; p < num_patches; p++) { // sum
-    CuSubMatrix<BaseFloat> diff_patch(out_deriv.ColRange(p * num_filters,
-                                                         num_filters));
-    CuSubMatrix<BaseFloat> patch(patches.ColRange(p * filter_dim, filter_dim));
-    filters_grad.AddMatMat(1.0, diff_patch, kTrans, patch, kNoTrans, 1.0);
-    bias_grad.AddRowSumMat(1.0, diff_patch, 1.0);
-  }
+  filters_grad.Resize(num_filters, filter_dim, kUndefined);
+  bias_grad.Resize(num_filters, kUndefined);
+  filters_grad.AddMatMat(1.0, out_deriv_stacked, kTrans, patches, kNoTrans, 0.0);
+  bias_grad.AddRowSumMat(1.0, out_deriv_stacked, 0.0);
 
   //
   // update
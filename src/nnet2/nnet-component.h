@@ -849,8 +849,8 @@ class AffineComponent: public UpdatableComponent {
                   const CuVectorBase<BaseFloat> &bias_params,
                   BaseFloat learning_rate);
   
-  virtual int32 InputDim() const { return linear_params_.NumCols(); }
-  virtual int32 OutputDim() const { return linear_params_.NumRows(); }
+  virtual int32 InputDim() const { return LinearParams().NumCols(); }
+  virtual int32 OutputDim() const { return LinearParams().NumRows(); }
   void Init(BaseFloat learning_rate,
             int32 input_dim, int32 output_dim,
             BaseFloat param_stddev, BaseFloat bias_stddev);
@@ -873,7 +873,10 @@ class AffineComponent: public UpdatableComponent {
   virtual std::string Info() const;
   virtual void InitFromString(std::string args);
   
-  AffineComponent(): is_gradient_(false) { } // use Init to really initialize.
+  // use Init to really initialize.
+  AffineComponent(): is_gradient_(false), compress_on_write_(false),
+                     align_on_write_(false), mapped_linear_params_(NULL) { }
+  virtual ~AffineComponent() { delete mapped_linear_params_; }
   virtual std::string Type() const { return "AffineComponent"; }
   virtual bool BackpropNeedsInput() const { return true; }
   virtual bool BackpropNeedsOutput() const { return false; }
@@ -900,8 +903,28 @@ class AffineComponent: public UpdatableComponent {
   // This new function is used when mixing up:
   virtual void SetParams(const VectorBase<BaseFloat> &bias,
                          const MatrixBase<BaseFloat> &linear);
-  const CuVector<BaseFloat> &BiasParams() { return bias_params_; }
-  const CuMatrix<BaseFloat> &LinearParams() { return linear_params_; }
+  const CuVector<BaseFloat> &BiasParams() const { return bias_params_; }
+  /// The linear parameters; these may be in the memory of a MappedInput
+  /// that the component was read from, see ReadLinearParams().
+  const CuMatrixBase<BaseFloat> &LinearParams() const {
+    if (mapped_linear_params_ != NULL) return *mapped_linear_params_;
+    else return linear_params_;
+  }
+
+  /// If set, Write() in binary mode writes the linear parameters in the
+  /// 8-bit form of class CompressedMatrix, which makes them about 4 times
+  /// smaller on disk.  This is lossy, so is intended for models that will only
+  /// be used for decoding.  Read() accepts either form.  This setting is not
+  /// itself written to disk.
+  void SetCompressOnWrite(bool compress) { compress_on_write_ = compress; }
+
+  /// If set, Write() in binary mode pads the file with spaces before the
+  /// uncompressed linear parameters, so that they start at a multiple of 64
+  /// bytes in the file; ReadLinearParams() can then use them in place from a
+  /// MappedInput, so that processes reading the same model share the memory.
+  /// Matrix::Read() skips the padding, so the output can be read as usual.
+  /// This setting is not itself written to disk.
+  void SetAlignOnWrite(bool align) { align_on_write_ = align; }
 
   virtual int32 GetParameterDim() const;
   virtual void Vectorize(VectorBase<BaseFloat> *params) const;
@@ -933,11 +956,32 @@ class AffineComponent: public UpdatableComponent {
       const CuMatrixBase<BaseFloat> &in_value,
       const CuMatrixBase<BaseFloat> &out_deriv);  
 
+  /// Writes the linear parameters, compressed if compress_on_write_ is set and
+  /// aligned if align_on_write_ is set; for use in the Write() functions of
+  /// this and the child classes.
+  void WriteLinearParams(std::ostream &os, bool binary) const;
+
+  /// Reads the linear parameters, for the Read() functions of this and the
+  /// child classes.  If "is" is the stream of a MappedInput, the data is
+  /// binary float and aligned, and we are not using a GPU, the parameters
+  /// are not copied: mapped_linear_params_ is set to point to the data in
+  /// the MappedInput, which must then outlive this component.
+  void ReadLinearParams(std::istream &is, bool binary);
+
+  /// If the linear parameters are in a MappedInput, copies them into
+  /// linear_params_; this is called before anything changes them.
+  void CopyMappedParams();
+
   const AffineComponent &operator = (const AffineComponent &other); // Disallow.
   CuMatrix<BaseFloat> linear_params_;
   CuVector<BaseFloat> bias_params_;
 
   bool is_gradient_; // If true, treat this as just a gradient.
+  bool compress_on_write_; // See SetCompressOnWrite().
+  bool align_on_write_; // See SetAlignOnWrite().
+  // If non-NULL, the linear parameters (read-only, in a MappedInput), and
+  // linear_params_ is empty.
+  CuSubMatrix<BaseFloat> *mapped_linear_params_;
 };
 
 
@@ -1104,6 +1148,8 @@ class SpliceComponent: public Component {
   virtual int32 InputDim() const { return input_dim_; }
   virtual int32 OutputDim() const;
   virtual std::vector<int32> Context() const { return context_; }
+  /// The dimension at the end of the input that is not spliced.
+  int32 ConstComponentDim() const { return const_component_dim_; }
   using Component::Propagate; // to avoid name hiding
   virtual void Propagate(const ChunkInfo &in_info,
                          const ChunkInfo &out_info,
@@ -1687,9 +1733,9 @@ class AdditiveNoiseComponent: public RandomComponent {
  * In order to have a fast implementations, the filters are
  * represented in vectorized form, where each rectangular filter
  * corresponds to a row in a matrix, where all the filters are
- * stored. The features are then re-shaped to a set of matrices, where
- * one matrix corresponds to single patch-position, where all the
- * filters get applied.
+ * stored. The features are then re-shaped into a matrix in which the
+ * patch-positions are stacked as blocks of rows, so all the filters get
+ * applied to all the patches by a single matrix multiplication.
  * 
  * The type of convolution is controled by hyperparameters:
  * patch_dim_     ... frequency axis size of the patch
@@ -1773,11 +1819,9 @@ class Convolutional1dComponent: public UpdatableComponent {
   int32 patch_step_;
   int32 patch_stride_;
 
-  static void ReverseIndexes(const std::vector<int32> &forward_indexes,
-                             int32 input_dim,
-                             std::vector<std::vector<int32> > *backward_indexes);
-  static void RearrangeIndexes(const std::vector<std::vector<int32> > &in,
-                               std::vector<std::vector<int32> > *out);
+  // Computes the index arrays for cu::UnfoldPatches() and cu::FoldPatches().
+  void ComputePatchIndexes(std::vector<CuArray<int32> > *forward_indexes,
+                           std::vector<CuArray<int32> > *backward_indexes) const;
     
   const Convolutional1dComponent &operator = (const Convolutional1dComponent &other); // Disallow.
   CuMatrix<BaseFloat> filter_params_;
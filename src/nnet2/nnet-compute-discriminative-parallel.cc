@@ -17,87 +17,57 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
-#include <deque>
 #include "nnet2/nnet-compute-discriminative-parallel.h"
 #include "hmm/posterior.h"
 #include "lat/lattice-functions.h"
-#include "thread/kaldi-semaphore.h"
 #include "thread/kaldi-mutex.h"
+#include "thread/kaldi-queue.h"
 #include "thread/kaldi-thread.h"
 
 namespace kaldi {
 namespace nnet2 {
 
-/** This struct stores neural net training examples to be used in
-    multi-threaded training.  */
-class DiscriminativeExamplesRepository {
- public:
-  /// The following function is called by the code that reads in the examples.
-  void AcceptExample(const DiscriminativeNnetExample &example);
-
-  /// The following function is called by the code that reads in the examples,
-  /// when we're done reading examples; it signals this way to this class
-  /// that the stream is now empty
-  void ExamplesDone();
-  
-  /// This function is called by the code that does the training.  If there is
-  /// an example available it will provide it, or it will sleep till one is
-  /// available.  It returns NULL when there are no examples left and
-  /// ExamplesDone() has been called.
-  DiscriminativeNnetExample *ProvideExample();
-
-  DiscriminativeExamplesRepository(): buffer_size_(4),
-                                      empty_semaphore_(buffer_size_),
-                                      done_(false) { }
- private:
-  int32 buffer_size_;
-  Semaphore full_semaphore_;
-  Semaphore empty_semaphore_;
-  Mutex examples_mutex_; // mutex we lock to modify examples_.
-  
-  std::deque<DiscriminativeNnetExample*> examples_;
-  bool done_;
-  KALDI_DISALLOW_COPY_AND_ASSIGN(DiscriminativeExamplesRepository);
+/// A training example, with its lattice prepared by
+/// PrepareDiscriminativeLattice().
+struct DiscriminativePreparedExample {
+  DiscriminativeNnetExample *eg;
+  Lattice lat;
+  explicit DiscriminativePreparedExample(DiscriminativeNnetExample *eg):
+      eg(eg) { }
+  ~DiscriminativePreparedExample() { delete eg; }
 };
 
 
-void DiscriminativeExamplesRepository::AcceptExample(
-    const DiscriminativeNnetExample &example) {
-  empty_semaphore_.Wait();
-  examples_mutex_.Lock();
-  examples_.push_back(new DiscriminativeNnetExample(example));
-  examples_mutex_.Unlock();
-  full_semaphore_.Signal();
-}
-
-void DiscriminativeExamplesRepository::ExamplesDone() {
-  for (int32 i = 0; i < buffer_size_; i++)
-    empty_semaphore_.Wait();
-  examples_mutex_.Lock();  
-  KALDI_ASSERT(examples_.empty());
-  examples_mutex_.Unlock();
-  done_ = true;
-  full_semaphore_.Signal();
-}
+/// The threads of this class take the examples as they are read in, and
+/// prepare their lattices for the training threads.
+class DiscLatticePrepareClass: public MultiThreadable {
+ public:
+  DiscLatticePrepareClass(
+      const TransitionModel &tmodel,
+      const NnetDiscriminativeUpdateOptions &opts,
+      const std::vector<int32> &silence_phones,
+      BoundedQueue<DiscriminativeNnetExample*> *examples,
+      BoundedQueue<DiscriminativePreparedExample*> *prepared_examples):
+      tmodel_(tmodel), opts_(opts), silence_phones_(silence_phones),
+      examples_(examples), prepared_examples_(prepared_examples) { }
 
-DiscriminativeNnetExample*
-DiscriminativeExamplesRepository::ProvideExample() {
-  full_semaphore_.Wait();
-  if (done_) {
-    KALDI_ASSERT(examples_.empty());
-    full_semaphore_.Signal(); // Increment the semaphore so
-    // the call by the next thread will not block.
-    return NULL; // no examples to return-- all finished.
-  } else {
-    examples_mutex_.Lock();  
-    KALDI_ASSERT(!examples_.empty());
-    DiscriminativeNnetExample *ans = examples_.front();
-    examples_.pop_front();
-    examples_mutex_.Unlock();
-    empty_semaphore_.Signal();
-    return ans;
+  void operator () () {
+    DiscriminativeNnetExample *eg;
+    while (examples_->Pop(&eg)) {
+      DiscriminativePreparedExample *prepared =
+          new DiscriminativePreparedExample(eg);
+      PrepareDiscriminativeLattice(tmodel_, opts_, silence_phones_, *eg,
+                                   &(prepared->lat));
+      prepared_examples_->Push(prepared);
+    }
   }
-}
+ private:
+  const TransitionModel &tmodel_;
+  const NnetDiscriminativeUpdateOptions &opts_;
+  const std::vector<int32> &silence_phones_;
+  BoundedQueue<DiscriminativeNnetExample*> *examples_;
+  BoundedQueue<DiscriminativePreparedExample*> *prepared_examples_;
+};
 
 
 class DiscTrainParallelClass: public MultiThreadable {
@@ -107,24 +77,37 @@ class DiscTrainParallelClass: public MultiThreadable {
   DiscTrainParallelClass(const AmNnet &am_nnet,
                          const TransitionModel &tmodel,
                          const NnetDiscriminativeUpdateOptions &opts,
+                         const std::vector<int32> &silence_phones,
                          bool store_separate_gradients,
-                         DiscriminativeExamplesRepository *repository,
+                         int32 examples_per_batch,
+                         int32 examples_per_merge,
+                         BoundedQueue<DiscriminativePreparedExample*> *examples,
+                         Mutex *merge_mutex,
                          Nnet *nnet_to_update,
                          NnetDiscriminativeStats *stats):
       am_nnet_(am_nnet), tmodel_(tmodel), opts_(opts),
+      silence_phones_(silence_phones),
       store_separate_gradients_(store_separate_gradients),
-      repository_(repository),
+      examples_per_batch_(examples_per_batch),
+      examples_per_merge_(examples_per_merge),
+      examples_(examples), merge_mutex_(merge_mutex),
       nnet_to_update_(nnet_to_update),
       nnet_to_update_orig_(nnet_to_update),
+      num_unmerged_(0),
       stats_ptr_(stats) { }
   
   // The following constructor is called multiple times within
   // the RunMultiThreaded template function.
   DiscTrainParallelClass(const DiscTrainParallelClass &other):
   am_nnet_(other.am_nnet_), tmodel_(other.tmodel_), opts_(other.opts_),
+  silence_phones_(other.silence_phones_),
   store_separate_gradients_(other.store_separate_gradients_),
-  repository_(other.repository_), nnet_to_update_(other.nnet_to_update_),
+  examples_per_batch_(other.examples_per_batch_),
+  examples_per_merge_(other.examples_per_merge_),
+  examples_(other.examples_), merge_mutex_(other.merge_mutex_),
+  nnet_to_update_(other.nnet_to_update_),
   nnet_to_update_orig_(other.nnet_to_update_orig_),
+  num_unmerged_(0),
   stats_ptr_(other.stats_ptr_) {
     if (store_separate_gradients_) {
       // To ensure correctness, we work on separate copies of the gradient
@@ -141,17 +124,40 @@ class DiscTrainParallelClass: public MultiThreadable {
       } else { // support case where we don't really need a gradient.
         nnet_to_update_ = NULL;
       }
-    }    
+    } else if (examples_per_merge_ > 0) {
+      // We accumulate the parameter changes (i.e. the gradients times the
+      // learning rates) in a private copy of the nnet, and add them to the
+      // shared nnet every examples_per_merge_ examples, rather than have all
+      // threads write to the shared nnet all the time.
+      nnet_to_update_ = new Nnet(*(other.nnet_to_update_));
+      nnet_to_update_->SetZero(false);
+    }
   }
   // This does the main function of the class.
   void operator () () {
-    DiscriminativeNnetExample *example;
-    while ((example = repository_->ProvideExample()) != NULL) {
+    std::vector<DiscriminativePreparedExample*> batch;
+    DiscriminativePreparedExample *example;
+    while (true) {
+      batch.clear();
+      while (static_cast<int32>(batch.size()) < examples_per_batch_ &&
+             examples_->Pop(&example))
+        batch.push_back(example);
+      if (batch.empty()) break;  // no more examples.
+      std::vector<const DiscriminativeNnetExample*> egs(batch.size());
+      std::vector<Lattice*> lats(batch.size());
+      for (size_t i = 0; i < batch.size(); i++) {
+        egs[i] = batch[i]->eg;
+        lats[i] = &(batch[i]->lat);
+      }
       // This is a function call to a function defined in
       // nnet-compute-discriminative.h
-      NnetDiscriminativeUpdate(am_nnet_, tmodel_, opts_,
-                               *example, nnet_to_update_, &stats_);
-      delete example;
+      NnetDiscriminativeUpdateBatch(am_nnet_, tmodel_, opts_, silence_phones_,
+                                    egs, lats, nnet_to_update_, &stats_);
+      num_unmerged_ += batch.size();
+      DeletePointers(&batch);
+      if (!store_separate_gradients_ && examples_per_merge_ > 0 &&
+          num_unmerged_ >= examples_per_merge_)
+        MergeUpdate();
 
       if (GetVerboseLevel() > 3) {
         KALDI_VLOG(3) << "Printing local stats for thread " << thread_id_;
@@ -164,21 +170,38 @@ class DiscTrainParallelClass: public MultiThreadable {
     if (nnet_to_update_orig_ != nnet_to_update_) {
       // This branch is only taken if this instance of the class is
       // one of the multiple instances allocated inside the RunMultiThreaded
-      // template function, *and* store_separate_gradients_ has been set to true.
-      // In the typical hogwild case, we don't do this.
-      nnet_to_update_orig_->AddNnet(1.0, *nnet_to_update_);
+      // template function, *and* we have a separate gradient or parameter
+      // change.  In the typical hogwild case, we don't do this.
+      if (store_separate_gradients_) 
+        nnet_to_update_orig_->AddNnet(1.0, *nnet_to_update_);
+      else
+        MergeUpdate();
       delete nnet_to_update_;
     }
     stats_ptr_->Add(stats_);
   }
  private:
+  // Adds the parameter change accumulated by this thread to the shared nnet.
+  void MergeUpdate() {
+    merge_mutex_->Lock();
+    nnet_to_update_orig_->AddNnet(1.0, *nnet_to_update_);
+    merge_mutex_->Unlock();
+    nnet_to_update_->SetZero(false);
+    num_unmerged_ = 0;
+  }
+
   const AmNnet &am_nnet_;
   const TransitionModel &tmodel_;
   const NnetDiscriminativeUpdateOptions &opts_;
+  const std::vector<int32> &silence_phones_;
   bool store_separate_gradients_;
-  DiscriminativeExamplesRepository *repository_;
+  int32 examples_per_batch_;
+  int32 examples_per_merge_;
+  BoundedQueue<DiscriminativePreparedExample*> *examples_;
+  Mutex *merge_mutex_;
   Nnet *nnet_to_update_;
   Nnet *nnet_to_update_orig_;
+  int32 num_unmerged_;  // number of examples since the last MergeUpdate().
   NnetDiscriminativeStats *stats_ptr_;
   NnetDiscriminativeStats stats_;
 };
@@ -189,28 +212,46 @@ void NnetDiscriminativeUpdateParallel(
     const AmNnet &am_nnet,
     const TransitionModel &tmodel,
     const NnetDiscriminativeUpdateOptions &opts,
+    const std::vector<int32> &silence_phones,
     int32 num_threads,
+    int32 num_lattice_threads,
+    int32 examples_per_batch,
+    int32 examples_per_merge,
     SequentialDiscriminativeNnetExampleReader *example_reader,
     Nnet *nnet_to_update,
     NnetDiscriminativeStats *stats) {
-  
-  DiscriminativeExamplesRepository repository;
+  KALDI_ASSERT(num_threads > 0 && num_lattice_threads > 0 &&
+               examples_per_batch > 0 && examples_per_merge >= 0);
+  // The examples go from the reader, through the lattice preparation threads,
+  // to the training threads.
+  BoundedQueue<DiscriminativeNnetExample*> examples(4);
+  BoundedQueue<DiscriminativePreparedExample*> prepared_examples(
+      4 + num_threads * examples_per_batch);
+  Mutex merge_mutex;
   
   const bool store_separate_gradients = (nnet_to_update != &(am_nnet.GetNnet()));
   
-  DiscTrainParallelClass c(am_nnet, tmodel, opts,
-                           store_separate_gradients,
-                           &repository, nnet_to_update, stats);
+  DiscLatticePrepareClass p(tmodel, opts, silence_phones, &examples,
+                            &prepared_examples);
+  DiscTrainParallelClass c(am_nnet, tmodel, opts, silence_phones,
+                           store_separate_gradients, examples_per_batch,
+                           examples_per_merge,
+                           &prepared_examples, &merge_mutex,
+                           nnet_to_update, stats);
 
   {
     // The initialization of the following class spawns the threads that
     // process the examples.  They get re-joined in its destructor.
     MultiThreader<DiscTrainParallelClass> m(num_threads, c);
-
-    for (; !example_reader->Done(); example_reader->Next()) {
-      repository.AcceptExample(example_reader->Value());
+    {
+      MultiThreader<DiscLatticePrepareClass> mp(num_lattice_threads, p);
+      for (; !example_reader->Done(); example_reader->Next()) {
+        examples.Push(new DiscriminativeNnetExample(example_reader->Value()));
+      }
+      examples.Close();
     }
-    repository.ExamplesDone();
+    // all the lattices have been prepared.
+    prepared_examples.Close();
   }
   stats->Print(opts.criterion);
 }
@@ -31,13 +31,27 @@ namespace nnet2 {
 /* This header provides a multi-threaded version of the discriminative training
    code (this is for a CPU-based, instead of GPU-based, setup).
    Note: we expect that "nnet_to_update" will be the same as "&(am_nnet.GetNnet())"
+   The lattices of the examples are converted and sorted by
+   "num_lattice_threads" threads, ahead of the "num_threads" training threads.
+   Each training thread takes "examples_per_batch" examples at a time, and does
+   the forward and backward passes for them together (see
+   NnetDiscriminativeUpdateBatch()).
+   If examples_per_merge > 0, each training thread accumulates its parameter
+   changes in its own copy of the nnet, and adds them to "nnet_to_update" (under
+   a lock) after every examples_per_merge examples; if it is 0, the threads
+   update "nnet_to_update" directly, Hogwild-style.
+   "silence_phones" should be the output of ParseSilencePhones(opts).
 */
 
 void NnetDiscriminativeUpdateParallel(
     const AmNnet &am_nnet,
     const TransitionModel &tmodel,
     const NnetDiscriminativeUpdateOptions &opts,
+    const std::vector<int32> &silence_phones,
     int32 num_threads,
+    int32 num_lattice_threads,
+    int32 examples_per_batch,
+    int32 examples_per_merge,
     SequentialDiscriminativeNnetExampleReader *example_reader,
     Nnet *nnet_to_update,
     NnetDiscriminativeStats *stats);
@@ -28,6 +28,10 @@ namespace nnet2 {
   This class does the forward and possibly backward computation for (typically)
   a whole utterance of contiguous features.  You'll instantiate one of
   these classes each time you want to do this computation.
+  It can also do the computation for several examples at once: the forward and
+  backward passes are then done for all of them together, with each example as
+  one chunk of the minibatch, and the lattice computations for each example
+  separately.
 */
 class NnetDiscriminativeUpdater {
  public:
@@ -39,6 +43,19 @@ class NnetDiscriminativeUpdater {
                             Nnet *nnet_to_update,
                             NnetDiscriminativeStats *stats);
 
+  /// This version takes the outputs of PrepareDiscriminativeLattice()
+  /// for the examples "egs" from "lats", and the silence phones already parsed
+  /// from opts.silence_phones_str.  The examples shorter than the longest one
+  /// are padded at the end, by repeating their last input frame.
+  NnetDiscriminativeUpdater(const AmNnet &am_nnet,
+                            const TransitionModel &tmodel,
+                            const NnetDiscriminativeUpdateOptions &opts,
+                            const std::vector<int32> &silence_phones,
+                            const std::vector<const DiscriminativeNnetExample*> &egs,
+                            const std::vector<Lattice*> &lats,
+                            Nnet *nnet_to_update,
+                            NnetDiscriminativeStats *stats);
+
   void Update() {
     Propagate();
     LatticeComputations();
@@ -50,20 +67,23 @@ class NnetDiscriminativeUpdater {
   void Propagate();  
 
   /// Does the parts between Propagate() and Backprop(), that
-  /// involve forward-backward over the lattice.
+  /// involve forward-backward over the lattices.
   void LatticeComputations();
   
   void Backprop();
 
-  /// Assuming the lattice already has the correct scores in
+  /// Assuming the lattice "lat" of "eg" already has the correct scores in
   /// it, this function does the MPE or MMI forward-backward
   /// and puts the resulting discriminative posteriors (which
   /// may have positive or negative weight) into "post".
   /// It returns, for MPFE/SMBR, the objective function, or
   /// for MMI, the negative of the denominator-lattice log-likelihood.
-  double GetDiscriminativePosteriors(Posterior *post);
+  double GetDiscriminativePosteriors(const DiscriminativeNnetExample &eg,
+                                     const Lattice &lat,
+                                     Posterior *post);
   
-  SubMatrix<BaseFloat> GetInputFeatures() const;
+  /// The input features of the i'th example, with the context the nnet needs.
+  SubMatrix<BaseFloat> GetInputFeatures(int32 i) const;
   
   CuMatrixBase<BaseFloat> &GetOutput() { return forward_data_.back(); }
 
@@ -78,20 +98,35 @@ class NnetDiscriminativeUpdater {
   typedef LatticeArc Arc;
   typedef Arc::StateId StateId;
 
+  /// Sets num_frames_per_chunk_ and chunk_info_out_.
+  void Init();
+
+  /// The lattice computations for one example: "posteriors" is the nnet
+  /// output for it, which starts at row "row_offset" of the whole output.
+  /// Appends the derivative w.r.t. the output to "sv_labels".
+  void LatticeComputations(const DiscriminativeNnetExample &eg,
+                           Lattice *lat,
+                           const CuMatrixBase<BaseFloat> &posteriors,
+                           int32 row_offset,
+                           std::vector<MatrixElement<BaseFloat> > *sv_labels);
   
   const AmNnet &am_nnet_;
   const TransitionModel &tmodel_;
   const NnetDiscriminativeUpdateOptions &opts_;
-  const DiscriminativeNnetExample &eg_;
+  std::vector<const DiscriminativeNnetExample*> egs_;
   Nnet *nnet_to_update_; // will equal am_nnet_.GetNnet(), in SGD case, or
                          // another Nnet, in gradient-computation case, or
                          // NULL if we just need the objective function.
   NnetDiscriminativeStats *stats_; // the objective function, etc.
+  int32 num_frames_per_chunk_; // the number of output frames of the longest
+                               // example; each example is one chunk.
   std::vector<ChunkInfo> chunk_info_out_; 
   // forward_data_[i] is the input of the i'th component and (if i > 0)
   // the output of the i-1'th component.
   std::vector<CuMatrix<BaseFloat> > forward_data_; 
-  Lattice lat_; // we convert the CompactLattice in the eg, into Lattice form.
+  // we convert the CompactLattices in the egs, into Lattice form.
+  std::vector<Lattice> lats_;
+  bool lat_prepared_; // true if lats_ were supplied by the caller.
   CuMatrix<BaseFloat> backward_data_;
   std::vector<int32> silence_phones_; // derived from opts_.silence_phones_str
 };
@@ -105,23 +140,57 @@ NnetDiscriminativeUpdater::NnetDiscriminativeUpdater(
     const DiscriminativeNnetExample &eg,
     Nnet *nnet_to_update,
     NnetDiscriminativeStats *stats):
-    am_nnet_(am_nnet), tmodel_(tmodel), opts_(opts), eg_(eg),
-    nnet_to_update_(nnet_to_update), stats_(stats) {
-  if (!SplitStringToIntegers(opts_.silence_phones_str, ":", false,
-                             &silence_phones_)) {
-    KALDI_ERR << "Bad value for --silence-phones option: "
-              << opts_.silence_phones_str;
+    am_nnet_(am_nnet), tmodel_(tmodel), opts_(opts), egs_(1, &eg),
+    nnet_to_update_(nnet_to_update), stats_(stats), lats_(1),
+    lat_prepared_(false) {
+  ParseSilencePhones(opts_, &silence_phones_);
+  Init();
+}
+
+NnetDiscriminativeUpdater::NnetDiscriminativeUpdater(
+    const AmNnet &am_nnet,
+    const TransitionModel &tmodel,
+    const NnetDiscriminativeUpdateOptions &opts,
+    const std::vector<int32> &silence_phones,
+    const std::vector<const DiscriminativeNnetExample*> &egs,
+    const std::vector<Lattice*> &lats,
+    Nnet *nnet_to_update,
+    NnetDiscriminativeStats *stats):
+    am_nnet_(am_nnet), tmodel_(tmodel), opts_(opts), egs_(egs),
+    nnet_to_update_(nnet_to_update), stats_(stats), lats_(lats.size()),
+    lat_prepared_(true), silence_phones_(silence_phones) {
+  KALDI_ASSERT(!egs.empty() && egs.size() == lats.size());
+  for (size_t i = 0; i < lats.size(); i++) {
+    // the assignment shares the lattice data; deleting the states of "lat"
+    // leaves us with the only reference to it, so it won't be copied when we
+    // modify it.
+    lats_[i] = *(lats[i]);
+    lats[i]->DeleteStates();
   }
+  Init();
+}
+
+void NnetDiscriminativeUpdater::Init() {
   const Nnet &nnet = am_nnet_.GetNnet();
-  nnet.ComputeChunkInfo(eg_.input_frames.NumRows(), 1, &chunk_info_out_);
+  num_frames_per_chunk_ = 0;
+  for (size_t i = 0; i < egs_.size(); i++) {
+    KALDI_ASSERT(egs_[i]->spk_info.Dim() == egs_[0]->spk_info.Dim());
+    num_frames_per_chunk_ = std::max(num_frames_per_chunk_,
+                                     static_cast<int32>(egs_[i]->num_ali.size()));
+  }
+  int32 input_chunk_size = num_frames_per_chunk_ + nnet.LeftContext() +
+      nnet.RightContext();
+  nnet.ComputeChunkInfo(input_chunk_size, egs_.size(), &chunk_info_out_);
 }
 
 
 
-SubMatrix<BaseFloat> NnetDiscriminativeUpdater::GetInputFeatures() const {
-  int32 num_frames_output = eg_.num_ali.size();
-  int32 eg_left_context = eg_.left_context,
-      eg_right_context = eg_.input_frames.NumRows() -
+SubMatrix<BaseFloat> NnetDiscriminativeUpdater::GetInputFeatures(
+    int32 i) const {
+  const DiscriminativeNnetExample &eg = *(egs_[i]);
+  int32 num_frames_output = eg.num_ali.size();
+  int32 eg_left_context = eg.left_context,
+      eg_right_context = eg.input_frames.NumRows() -
       num_frames_output - eg_left_context;
   KALDI_ASSERT(eg_right_context >= 0);
   const Nnet &nnet = am_nnet_.GetNnet();
@@ -134,8 +203,8 @@ SubMatrix<BaseFloat> NnetDiscriminativeUpdater::GetInputFeatures() const {
   int32 offset = eg_left_context - nnet.LeftContext(),
       num_output_frames =
       num_frames_output + nnet.LeftContext() + nnet.RightContext();
-  SubMatrix<BaseFloat> ans(eg_.input_frames, offset, num_output_frames,
-                           0, eg_.input_frames.NumCols());
+  SubMatrix<BaseFloat> ans(eg.input_frames, offset, num_output_frames,
+                           0, eg.input_frames.NumCols());
   return ans;
 }
 
@@ -143,18 +212,29 @@ void NnetDiscriminativeUpdater::Propagate() {
   const Nnet &nnet = am_nnet_.GetNnet();
   forward_data_.resize(nnet.NumComponents() + 1);
   
-  SubMatrix<BaseFloat> input_feats = GetInputFeatures();
-  int32 spk_dim = eg_.spk_info.Dim();
-  if (spk_dim == 0) {
-    forward_data_[0] = input_feats;
+  int32 num_egs = egs_.size(), spk_dim = egs_[0]->spk_info.Dim(),
+      input_chunk_size = num_frames_per_chunk_ + nnet.LeftContext() +
+      nnet.RightContext();
+  if (num_egs == 1 && spk_dim == 0) {
+    forward_data_[0] = GetInputFeatures(0);
   } else {
-    forward_data_[0].Resize(input_feats.NumRows(),
-                            input_feats.NumCols() + eg_.spk_info.Dim());
-    forward_data_[0].Range(0, input_feats.NumRows(),
-                           0, input_feats.NumCols()).CopyFromMat(input_feats);
-    forward_data_[0].Range(0, input_feats.NumRows(),
-                           input_feats.NumCols(), spk_dim).CopyRowsFromVec(
-                               eg_.spk_info);
+    int32 feat_dim = egs_[0]->input_frames.NumCols();
+    forward_data_[0].Resize(num_egs * input_chunk_size, feat_dim + spk_dim,
+                            kUndefined);
+    for (int32 i = 0; i < num_egs; i++) {
+      SubMatrix<BaseFloat> input_feats = GetInputFeatures(i);
+      KALDI_ASSERT(input_feats.NumCols() == feat_dim);
+      CuSubMatrix<BaseFloat> chunk(forward_data_[0].RowRange(
+          i * input_chunk_size, input_chunk_size));
+      int32 num_rows = input_feats.NumRows();
+      chunk.Range(0, num_rows, 0, feat_dim).CopyFromMat(input_feats);
+      if (num_rows < input_chunk_size)  // pad with the last frame.
+        chunk.Range(num_rows, input_chunk_size - num_rows,
+                    0, feat_dim).CopyRowsFromVec(input_feats.Row(num_rows - 1));
+      if (spk_dim != 0)
+        chunk.Range(0, input_chunk_size,
+                    feat_dim, spk_dim).CopyRowsFromVec(egs_[i]->spk_info);
+    }
   }
 
   for (int32 c = 0; c < nnet.NumComponents(); c++) {
@@ -176,22 +256,44 @@ void NnetDiscriminativeUpdater::Propagate() {
 
 
 void NnetDiscriminativeUpdater::LatticeComputations() {
-  ConvertLattice(eg_.den_lat, &lat_); // convert to Lattice.
-  TopSort(&lat_); // Topologically sort (required by forward-backward algorithms)
-
-  if (opts_.criterion == "mmi" && opts_.boost != 0.0) {
-    BaseFloat max_silence_error = 0.0;
-    LatticeBoost(tmodel_, eg_.num_ali, silence_phones_,
-                 opts_.boost, max_silence_error, &lat_);
+  const CuMatrix<BaseFloat> &output = forward_data_.back();
+  KALDI_ASSERT(output.NumRows() == egs_.size() * num_frames_per_chunk_);
+  std::vector<MatrixElement<BaseFloat> > sv_labels;
+  for (size_t i = 0; i < egs_.size(); i++) {
+    int32 row_offset = i * num_frames_per_chunk_,
+        num_frames = egs_[i]->num_ali.size();
+    CuSubMatrix<BaseFloat> posteriors(output, row_offset, num_frames,
+                                      0, output.NumCols());
+    LatticeComputations(*(egs_[i]), &(lats_[i]), posteriors, row_offset,
+                        &sv_labels);
   }
+  // The padding frames have no labels, so their derivative is zero.
+  backward_data_.Resize(output.NumRows(), output.NumCols()); // zeroes it.
   
-  int32 num_frames = static_cast<int32>(eg_.num_ali.size());
+  { // We don't actually need tot_objf and tot_weight; we have already
+    // computed the objective function.
+    BaseFloat tot_objf, tot_weight;
+    backward_data_.CompObjfAndDeriv(sv_labels, output, &tot_objf, &tot_weight);
+    // Now backward_data_ will contan the derivative at the output.
+    // Our work here is done..
+  }
+}
+
+void NnetDiscriminativeUpdater::LatticeComputations(
+    const DiscriminativeNnetExample &eg,
+    Lattice *lat,
+    const CuMatrixBase<BaseFloat> &posteriors,
+    int32 row_offset,
+    std::vector<MatrixElement<BaseFloat> > *sv_labels) {
+  if (!lat_prepared_)
+    PrepareDiscriminativeLattice(tmodel_, opts_, silence_phones_, eg, lat);
+  
+  int32 num_frames = static_cast<int32>(eg.num_ali.size());
 
   stats_->tot_t += num_frames;
-  stats_->tot_t_weighted += num_frames * eg_.weight;
+  stats_->tot_t_weighted += num_frames * eg.weight;
   
   const VectorBase<BaseFloat> &priors = am_nnet_.Priors();
-  const CuMatrix<BaseFloat> &posteriors = forward_data_.back();
 
   KALDI_ASSERT(posteriors.NumRows() == num_frames);
   int32 num_pdfs = posteriors.NumCols();
@@ -208,24 +310,24 @@ void NnetDiscriminativeUpdater::LatticeComputations() {
   
   std::vector<Int32Pair> requested_indexes;
   BaseFloat wiggle_room = 1.3; // value not critical.. it's just 'reserve'
-  requested_indexes.reserve(num_frames + wiggle_room * lat_.NumStates());
+  requested_indexes.reserve(num_frames + wiggle_room * lat->NumStates());
 
   if (opts_.criterion == "mmi") { // need numerator probabilities...
     for (int32 t = 0; t < num_frames; t++) {
-      int32 tid = eg_.num_ali[t], pdf_id = tmodel_.TransitionIdToPdf(tid);
+      int32 tid = eg.num_ali[t], pdf_id = tmodel_.TransitionIdToPdf(tid);
       KALDI_ASSERT(pdf_id >= 0 && pdf_id < num_pdfs);
       requested_indexes.push_back(MakePair(t, pdf_id));
     }
   }
 
   std::vector<int32> state_times;
-  int32 T = LatticeStateTimes(lat_, &state_times);
+  int32 T = LatticeStateTimes(*lat, &state_times);
   KALDI_ASSERT(T == num_frames);
   
-  StateId num_states = lat_.NumStates();
+  StateId num_states = lat->NumStates();
   for (StateId s = 0; s < num_states; s++) {
     StateId t = state_times[s];
-    for (fst::ArcIterator<Lattice> aiter(lat_, s); !aiter.Done(); aiter.Next()) {
+    for (fst::ArcIterator<Lattice> aiter(*lat, s); !aiter.Done(); aiter.Next()) {
       const Arc &arc = aiter.Value();
       if (arc.ilabel != 0) { // input-side has transition-ids, output-side empty
         int32 tid = arc.ilabel, pdf_id = tmodel_.TransitionIdToPdf(tid);
@@ -263,14 +365,14 @@ void NnetDiscriminativeUpdater::LatticeComputations() {
   
   if (opts_.criterion == "mmi") {
     double tot_num_like = 0.0;
-    for (; index < eg_.num_ali.size(); index++)
+    for (; index < eg.num_ali.size(); index++)
       tot_num_like += answers[index];
-    stats_->tot_num_objf += eg_.weight * tot_num_like;
+    stats_->tot_num_objf += eg.weight * tot_num_like;
   }
 
   // Now put the (scaled) acoustic log-likelihoods in the lattice.
   for (StateId s = 0; s < num_states; s++) {
-    for (fst::MutableArcIterator<Lattice> aiter(&lat_, s);
+    for (fst::MutableArcIterator<Lattice> aiter(lat, s);
          !aiter.Done(); aiter.Next()) {
       Arc arc = aiter.Value();
       if (arc.ilabel != 0) { // input-side has transition-ids, output-side empty
@@ -279,54 +381,44 @@ void NnetDiscriminativeUpdater::LatticeComputations() {
         aiter.SetValue(arc);
       }
     }
-    LatticeWeight final = lat_.Final(s);
+    LatticeWeight final = lat->Final(s);
     if (final != LatticeWeight::Zero()) {
       final.SetValue2(0.0); // make sure no acoustic term in final-prob.
-      lat_.SetFinal(s, final);
+      lat->SetFinal(s, final);
     }
   }
   KALDI_ASSERT(index == answers.size());
   
   // Get the MPE or MMI posteriors.
   Posterior post;
-  stats_->tot_den_objf += eg_.weight * GetDiscriminativePosteriors(&post);
+  stats_->tot_den_objf += eg.weight * GetDiscriminativePosteriors(eg, *lat,
+                                                                  &post);
 
-  ScalePosterior(eg_.weight, &post);
+  ScalePosterior(eg.weight, &post);
 
   double tot_num_post = 0.0, tot_den_post = 0.0;
-  std::vector<MatrixElement<BaseFloat> > sv_labels;
-  sv_labels.reserve(answers.size());
+  sv_labels->reserve(sv_labels->size() + answers.size());
   for (int32 t = 0; t < post.size(); t++) {
     for (int32 i = 0; i < post[t].size(); i++) {
       int32 pdf_id = post[t][i].first;
       BaseFloat weight = post[t][i].second;
       if (weight > 0.0) { tot_num_post += weight; }
       else { tot_den_post -= weight; }
-      MatrixElement<BaseFloat> elem = {t, pdf_id, weight};
-      sv_labels.push_back(elem);
+      MatrixElement<BaseFloat> elem = {row_offset + t, pdf_id, weight};
+      sv_labels->push_back(elem);
     }
   }
   stats_->tot_num_count += tot_num_post;
-  int32 num_components = am_nnet_.GetNnet().NumComponents();
-  const CuMatrix<BaseFloat> &output(forward_data_[num_components]);
-  backward_data_.Resize(output.NumRows(), output.NumCols()); // zeroes it.
-  
-  { // We don't actually need tot_objf and tot_weight; we have already
-    // computed the objective function.
-    BaseFloat tot_objf, tot_weight;
-    backward_data_.CompObjfAndDeriv(sv_labels, output, &tot_objf, &tot_weight);
-    // Now backward_data_ will contan the derivative at the output.
-    // Our work here is done..
-  }
 }
 
 
-double NnetDiscriminativeUpdater::GetDiscriminativePosteriors(Posterior *post) {
+double NnetDiscriminativeUpdater::GetDiscriminativePosteriors(
+    const DiscriminativeNnetExample &eg, const Lattice &lat, Posterior *post) {
   if (opts_.criterion == "mpfe" || opts_.criterion == "smbr") {
     Posterior tid_post;
     double ans;
-    ans = LatticeForwardBackwardMpeVariants(tmodel_, silence_phones_, lat_,
-                                            eg_.num_ali, opts_.criterion,
+    ans = LatticeForwardBackwardMpeVariants(tmodel_, silence_phones_, lat,
+                                            eg.num_ali, opts_.criterion,
                                             opts_.one_silence_class,
                                             &tid_post);
     ConvertPosteriorToPdfs(tmodel_, tid_post, post);
@@ -336,7 +428,7 @@ double NnetDiscriminativeUpdater::GetDiscriminativePosteriors(Posterior *post) {
     bool convert_to_pdfs = true, cancel = true;
     // we'll return the denominator-lattice forward backward likelihood,
     // which is one term in the objective function.
-    return LatticeForwardBackwardMmi(tmodel_, lat_, eg_.num_ali,
+    return LatticeForwardBackwardMmi(tmodel_, lat, eg.num_ali,
                                      opts_.drop_frames, convert_to_pdfs,
                                      cancel, post);
   }
@@ -344,6 +436,31 @@ double NnetDiscriminativeUpdater::GetDiscriminativePosteriors(Posterior *post) {
 
 
 
+void ParseSilencePhones(const NnetDiscriminativeUpdateOptions &opts,
+                        std::vector<int32> *silence_phones) {
+  if (!SplitStringToIntegers(opts.silence_phones_str, ":", false,
+                             silence_phones)) {
+    KALDI_ERR << "Bad value for --silence-phones option: "
+              << opts.silence_phones_str;
+  }
+}
+
+void PrepareDiscriminativeLattice(const TransitionModel &tmodel,
+                                  const NnetDiscriminativeUpdateOptions &opts,
+                                  const std::vector<int32> &silence_phones,
+                                  const DiscriminativeNnetExample &eg,
+                                  Lattice *lat) {
+  ConvertLattice(eg.den_lat, lat); // convert to Lattice.
+  TopSort(lat); // Topologically sort (required by forward-backward algorithms)
+
+  if (opts.criterion == "mmi" && opts.boost != 0.0) {
+    BaseFloat max_silence_error = 0.0;
+    LatticeBoost(tmodel, eg.num_ali, silence_phones,
+                 opts.boost, max_silence_error, lat);
+  }
+}
+
+
 void NnetDiscriminativeUpdater::Backprop() {
   const Nnet &nnet = am_nnet_.GetNnet();
   for (int32 c = nnet.NumComponents() - 1; c >= 0; c--) {
@@ -371,6 +488,35 @@ void NnetDiscriminativeUpdate(const AmNnet &am_nnet,
   updater.Update();
 }
 
+void NnetDiscriminativeUpdate(const AmNnet &am_nnet,
+                              const TransitionModel &tmodel,
+                              const NnetDiscriminativeUpdateOptions &opts,
+                              const std::vector<int32> &silence_phones,
+                              const DiscriminativeNnetExample &eg,
+                              Lattice *lat,
+                              Nnet *nnet_to_update,
+                              NnetDiscriminativeStats *stats) {
+  std::vector<const DiscriminativeNnetExample*> egs(1, &eg);
+  std::vector<Lattice*> lats(1, lat);
+  NnetDiscriminativeUpdater updater(am_nnet, tmodel, opts, silence_phones, egs,
+                                    lats, nnet_to_update, stats);
+  updater.Update();
+}
+
+void NnetDiscriminativeUpdateBatch(
+    const AmNnet &am_nnet,
+    const TransitionModel &tmodel,
+    const NnetDiscriminativeUpdateOptions &opts,
+    const std::vector<int32> &silence_phones,
+    const std::vector<const DiscriminativeNnetExample*> &egs,
+    const std::vector<Lattice*> &lats,
+    Nnet *nnet_to_update,
+    NnetDiscriminativeStats *stats) {
+  NnetDiscriminativeUpdater updater(am_nnet, tmodel, opts, silence_phones, egs,
+                                    lats, nnet_to_update, stats);
+  updater.Update();
+}
+
 void NnetDiscriminativeStats::Add(const NnetDiscriminativeStats &other) {
   tot_t += other.tot_t;
   tot_t_weighted += other.tot_t_weighted;
@@ -108,6 +108,52 @@ void NnetDiscriminativeUpdate(const AmNnet &am_nnet,
                               Nnet *nnet_to_update,
                               NnetDiscriminativeStats *stats);
 
+/// Puts the integer ids in opts.silence_phones_str in "silence_phones"; it is
+/// an error if the string is malformed.
+void ParseSilencePhones(const NnetDiscriminativeUpdateOptions &opts,
+                        std::vector<int32> *silence_phones);
+
+/// Converts the lattice of "eg" to Lattice form, topologically sorts it and
+/// (for boosted MMI) applies the boosting.  This is the part of the lattice
+/// computation that does not depend on the neural net, so the multi-threaded
+/// code can do it ahead of time, in other threads.  "silence_phones" is
+/// the output of ParseSilencePhones(), so that we don't parse the option for
+/// each example.
+void PrepareDiscriminativeLattice(const TransitionModel &tmodel,
+                                  const NnetDiscriminativeUpdateOptions &opts,
+                                  const std::vector<int32> &silence_phones,
+                                  const DiscriminativeNnetExample &eg,
+                                  Lattice *lat);
+
+/// As NnetDiscriminativeUpdate() above, but "lat" should contain the output of
+/// PrepareDiscriminativeLattice() for "eg".  Its contents are consumed.
+void NnetDiscriminativeUpdate(const AmNnet &am_nnet,
+                              const TransitionModel &tmodel,
+                              const NnetDiscriminativeUpdateOptions &opts,
+                              const std::vector<int32> &silence_phones,
+                              const DiscriminativeNnetExample &eg,
+                              Lattice *lat,
+                              Nnet *nnet_to_update,
+                              NnetDiscriminativeStats *stats);
+
+/// As the NnetDiscriminativeUpdate() above, but for several examples at once:
+/// "lats" contains the output of PrepareDiscriminativeLattice() for each
+/// example in "egs".  The forward and backward passes through the nnet are
+/// done for all the examples together, as the chunks of one minibatch, which
+/// is more efficient than one example at a time; the examples shorter than the
+/// longest one are padded with their last input frame, and the derivatives for
+/// the padding are zero, so the result is the same as doing them one by one
+/// (except that here, all of them see the nnet before any of the updates).
+void NnetDiscriminativeUpdateBatch(
+    const AmNnet &am_nnet,
+    const TransitionModel &tmodel,
+    const NnetDiscriminativeUpdateOptions &opts,
+    const std::vector<int32> &silence_phones,
+    const std::vector<const DiscriminativeNnetExample*> &egs,
+    const std::vector<Lattice*> &lats,
+    Nnet *nnet_to_update,
+    NnetDiscriminativeStats *stats);
+
 
 } // namespace nnet2
 } // namespace kaldi
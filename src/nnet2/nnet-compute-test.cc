@@ -80,6 +80,90 @@ void UnitTestNnetCompute() {
   delete nnet;
 }
 
+// Tests that NnetComputation(), which folds splicing into the following affine
+// component, gives the same output as propagating through the components one
+// by one.
+void UnitTestNnetComputeSpliceFolding() {
+  int32 input_dim = 10 + rand() % 20, hidden_dim = 20 + rand() % 50,
+      output_dim = 10 + rand() % 100;
+  std::vector<Component*> components;
+  int32 cur_dim = input_dim;
+  for (int32 layer = 0; layer < 2; layer++) {
+    std::vector<int32> context;
+    int32 left = rand() % 4, right = rand() % 4;
+    for (int32 i = -left; i <= right; i++)
+      if (i == 0 || i == -left || i == right || rand() % 2 == 0)
+        context.push_back(i);
+    SpliceComponent *splice = new SpliceComponent();
+    splice->Init(cur_dim, context);
+    components.push_back(splice);
+    int32 next_dim = (layer == 0 ? hidden_dim : output_dim);
+    AffineComponent *affine = (layer == 0 ? new AffineComponent() :
+                               new AffineComponentPreconditioned());
+    affine->Init(0.001, cur_dim * context.size(), next_dim, 0.1, 0.1);
+    components.push_back(affine);
+    cur_dim = next_dim;
+    if (layer == 0)
+      components.push_back(new SigmoidComponent(cur_dim));
+  }
+  components.push_back(new SoftmaxComponent(cur_dim));
+  Nnet nnet;
+  nnet.Init(&components);
+
+  int32 num_feats = nnet.LeftContext() + nnet.RightContext() + 1 +
+      rand() % 200;
+  CuMatrix<BaseFloat> input(num_feats, input_dim);
+  input.SetRandn();
+  CuMatrix<BaseFloat> output1(num_feats - nnet.LeftContext() -
+                              nnet.RightContext(), output_dim);
+  NnetComputation(nnet, input, false, &output1);
+
+  std::vector<ChunkInfo> chunk_info;
+  nnet.ComputeChunkInfo(num_feats, 1, &chunk_info);
+  CuMatrix<BaseFloat> cur_data(input);
+  for (int32 c = 0; c < nnet.NumComponents(); c++) {
+    CuMatrix<BaseFloat> next_data;
+    nnet.GetComponent(c).Propagate(chunk_info[c], chunk_info[c+1], cur_data,
+                                   &next_data);
+    cur_data.Swap(&next_data);
+  }
+  AssertEqual(output1, cur_data);
+  KALDI_LOG << "OK";
+}
+
+void UnitTestNnetComputeSubsampled() {
+  int32 input_dim = 10 + rand() % 40, output_dim = 100 + rand() % 500;
+  bool pad_input = (rand() % 2 == 0);
+  int32 frame_subsampling_factor = 1 + rand() % 4;
+
+  Nnet *nnet = GenRandomNnet(input_dim, output_dim);
+  int32 num_feats = 5 + rand() % 100;
+  CuMatrix<BaseFloat> input(num_feats, input_dim);
+  input.SetRandn();
+
+  int32 num_output_rows = num_feats -
+      (pad_input ? 0 : nnet->LeftContext() + nnet->RightContext());
+  if (num_output_rows <= 0) {
+    delete nnet;
+    return;
+  }
+  CuMatrix<BaseFloat> output(num_output_rows, output_dim);
+  NnetComputation(*nnet, input, pad_input, &output);
+
+  int32 num_subsampled_rows = (num_output_rows + frame_subsampling_factor - 1) /
+      frame_subsampling_factor;
+  CuMatrix<BaseFloat> output_subsampled(num_subsampled_rows, output_dim);
+  NnetComputation(*nnet, input, pad_input, frame_subsampling_factor,
+                  &output_subsampled);
+  for (int32 i = 0; i < num_subsampled_rows; i++) {
+    CuSubVector<BaseFloat> vec1(output, i * frame_subsampling_factor),
+        vec2(output_subsampled, i);
+    AssertEqual(vec1, vec2);
+  }
+  KALDI_LOG << "OK";
+  delete nnet;
+}
+
 }  // namespace nnet2
 }  // namespace kaldi
 
@@ -90,8 +174,11 @@ int main() {
   using namespace kaldi;
   using namespace kaldi::nnet2;
 
-  for (int32 i = 0; i < 10; i++) 
+  for (int32 i = 0; i < 10; i++) {
     UnitTestNnetCompute();
+    UnitTestNnetComputeSpliceFolding();
+    UnitTestNnetComputeSubsampled();
+  }
   return 0;
 }
   
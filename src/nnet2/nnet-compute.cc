@@ -32,11 +32,13 @@ class NnetComputer {
  public:
   /* Initializer.  If pad == true, pad input with nnet.LeftContext() frames on
      the left and nnet.RightContext() frames on the right (duplicate the first
-     and last frames.) */
+     and last frames.)  If frame_subsampling_factor > 1, only every
+     frame_subsampling_factor'th output frame is computed. */
   NnetComputer(const Nnet &nnet,
                const CuMatrixBase<BaseFloat> &input_feats,
                bool pad, 
-               Nnet *nnet_to_update = NULL);
+               Nnet *nnet_to_update = NULL,
+               int32 frame_subsampling_factor = 1);
   
   /// The forward-through-the-layers part of the computation.
   void Propagate();
@@ -53,6 +55,15 @@ class NnetComputer {
   CuMatrixBase<BaseFloat> &GetOutput() { return forward_data_.back(); }
   
  private:  
+  /// If component c is a SpliceComponent followed by an AffineComponent (or a
+  /// child class of it), computes the output of component c+1 directly from
+  /// the input of component c, without forming the spliced features: the
+  /// output is the bias plus, for each context offset, the appropriately
+  /// shifted rows of the input times the corresponding block of columns of the
+  /// linear parameters.  Returns false (and does nothing) if this does not
+  /// apply.
+  bool PropagateSpliceAffine(int32 c);
+
   const Nnet &nnet_;
   std::vector<CuMatrix<BaseFloat> > forward_data_;
   Nnet *nnet_to_update_; // May be NULL, if just want objective function
@@ -63,22 +74,38 @@ class NnetComputer {
 NnetComputer::NnetComputer(const Nnet &nnet,
                            const CuMatrixBase<BaseFloat> &input_feats,
                            bool pad,
-                           Nnet *nnet_to_update):
+                           Nnet *nnet_to_update,
+                           int32 frame_subsampling_factor):
     nnet_(nnet), nnet_to_update_(nnet_to_update) {
   int32 dim = input_feats.NumCols();
   if (dim != nnet.InputDim()) {
     KALDI_ERR << "Feature dimension is " << dim << " but network expects "
               << nnet.InputDim();
   }
+  KALDI_ASSERT(frame_subsampling_factor > 0);
   forward_data_.resize(nnet.NumComponents() + 1);
 
   int32 left_context = (pad ? nnet_.LeftContext() : 0),
        right_context = (pad ? nnet_.RightContext() : 0);
 
   int32 num_rows = left_context + input_feats.NumRows() + right_context;
-  nnet.ComputeChunkInfo(num_rows, 1, &chunk_info_);
-
   CuMatrix<BaseFloat> &input(forward_data_[0]);
+  if (frame_subsampling_factor != 1 &&
+      nnet.LeftContext() == 0 && nnet.RightContext() == 0) {
+    // The network has no context, so we can just subsample the input; this
+    // also covers networks with no splicing components, which
+    // ComputeChunkInfo() could not subsample.
+    int32 num_rows_subsampled =
+        (input_feats.NumRows() + frame_subsampling_factor - 1) /
+        frame_subsampling_factor;
+    nnet.ComputeChunkInfo(num_rows_subsampled, 1, &chunk_info_);
+    input.Resize(num_rows_subsampled, dim, kUndefined);
+    for (int32 i = 0; i < num_rows_subsampled; i++)
+      input.Row(i).CopyFromVec(input_feats.Row(i * frame_subsampling_factor));
+    return;
+  }
+  nnet.ComputeChunkInfo(num_rows, 1, frame_subsampling_factor, &chunk_info_);
+
   input.Resize(num_rows, dim);
   input.Range(left_context, input_feats.NumRows(),
               0, dim).CopyFromMat(input_feats);
@@ -90,9 +117,62 @@ NnetComputer::NnetComputer(const Nnet &nnet,
 }
 
 
+bool NnetComputer::PropagateSpliceAffine(int32 c) {
+  if (c + 1 >= nnet_.NumComponents()) return false;
+  const SpliceComponent *splice =
+      dynamic_cast<const SpliceComponent*>(&(nnet_.GetComponent(c)));
+  const AffineComponent *affine =
+      dynamic_cast<const AffineComponent*>(&(nnet_.GetComponent(c + 1)));
+  if (splice == NULL || affine == NULL || splice->ConstComponentDim() != 0)
+    return false;
+  const ChunkInfo &in_info = chunk_info_[c], &out_info = chunk_info_[c+1];
+  int32 in_chunk_size = in_info.ChunkSize(),
+      out_chunk_size = out_info.ChunkSize();
+  // We need the frames within each chunk to be contiguous in time, so that
+  // each context offset corresponds to a range of rows of the input.
+  if (in_chunk_size <= 0 || out_chunk_size <= 0 ||
+      in_info.GetOffset(in_chunk_size - 1) - in_info.GetOffset(0) !=
+      in_chunk_size - 1 ||
+      out_info.GetOffset(out_chunk_size - 1) - out_info.GetOffset(0) !=
+      out_chunk_size - 1)
+    return false;
+
+  const CuMatrix<BaseFloat> &input = forward_data_[c];
+  CuMatrix<BaseFloat> &output = forward_data_[c+2];
+  const CuMatrixBase<BaseFloat> &linear_params = affine->LinearParams();
+  std::vector<int32> context = splice->Context();
+  int32 dim = input.NumCols(), num_splice = context.size();
+  KALDI_ASSERT(linear_params.NumCols() == dim * num_splice);
+  in_info.CheckSize(input);
+  output.Resize(out_info.NumRows(), affine->OutputDim(), kUndefined);
+
+  for (int32 chunk = 0; chunk < in_info.NumChunks(); chunk++) {
+    CuSubMatrix<BaseFloat> out_part(output, chunk * out_chunk_size,
+                                    out_chunk_size, 0, output.NumCols());
+    out_part.CopyRowsFromVec(affine->BiasParams());
+    for (int32 k = 0; k < num_splice; k++) {
+      // the row of the input that goes with the first row of the output.
+      int32 in_start = out_info.GetOffset(0) + context[k] - in_info.GetOffset(0);
+      KALDI_ASSERT(in_start >= 0 && in_start + out_chunk_size <= in_chunk_size);
+      CuSubMatrix<BaseFloat> in_part(input, chunk * in_chunk_size + in_start,
+                                     out_chunk_size, 0, dim);
+      out_part.AddMatMat(1.0, in_part, kNoTrans,
+                         linear_params.ColRange(k * dim, dim), kTrans, 1.0);
+    }
+  }
+  return true;
+}
+
 /// This is the forward part of the computation.
 void NnetComputer::Propagate() {
   for (int32 c = 0; c < nnet_.NumComponents(); c++) {
+    // If we're not going to backprop, we don't need the spliced features, so
+    // we fold the splicing into the following affine component.
+    if (nnet_to_update_ == NULL && PropagateSpliceAffine(c)) {
+      forward_data_[c].Resize(0, 0);
+      c++;  // we have also done component c+1, whose input we never formed.
+      continue;
+    }
     const Component &component = nnet_.GetComponent(c);
     CuMatrix<BaseFloat> &input = forward_data_[c],
                      &output = forward_data_[c+1];
@@ -165,6 +245,17 @@ void NnetComputation(const Nnet &nnet,
   output->CopyFromMat(nnet_computer.GetOutput());
 }
 
+void NnetComputation(const Nnet &nnet,
+                     const CuMatrixBase<BaseFloat> &input,  // features
+                     bool pad_input,
+                     int32 frame_subsampling_factor,
+                     CuMatrixBase<BaseFloat> *output) {
+  NnetComputer nnet_computer(nnet, input, pad_input, NULL,
+                             frame_subsampling_factor);
+  nnet_computer.Propagate();
+  output->CopyFromMat(nnet_computer.GetOutput());
+}
+
 BaseFloat NnetGradientComputation(const Nnet &nnet,
                                   const CuMatrixBase<BaseFloat> &input,
                                   bool pad_input,
@@ -46,6 +46,20 @@ void NnetComputation(const Nnet &nnet,
                      bool pad_input,
                      CuMatrixBase<BaseFloat> *output); // posteriors.
 
+/**
+  As NnetComputation() above, but computes only every
+  frame_subsampling_factor'th output frame, starting from the first one.  If
+  the above version would output N frames, the output must have
+  (N + frame_subsampling_factor - 1) / frame_subsampling_factor rows.  The
+  layers after the last splicing component are only computed for those frames,
+  which is where most of the computation is in typical networks.
+*/
+void NnetComputation(const Nnet &nnet,
+                     const CuMatrixBase<BaseFloat> &input,  // features
+                     bool pad_input,
+                     int32 frame_subsampling_factor,
+                     CuMatrixBase<BaseFloat> *output); // posteriors.
+
 /** Does the neural net computation and backprop, given input and labels.
     Note: if pad_input==true the number of rows of input should be the
     same as the number of labels, and if false, you should omit
@@ -64,24 +64,23 @@ int32 Nnet::RightContext() const {
 
 void Nnet::ComputeChunkInfo(int32 input_chunk_size,
                             int32 num_chunks,
+                            int32 frame_subsampling_factor,
                             std::vector<ChunkInfo> *chunk_info_out) const {
+  KALDI_ASSERT(frame_subsampling_factor > 0);
   // First compute the output-chunk indices for the last component in the
   // network. we assume that the numbering of the input starts from zero.
   int32 output_chunk_size = input_chunk_size - LeftContext() - RightContext();
   KALDI_ASSERT(output_chunk_size > 0);
   std::vector<int32> current_output_inds;
-  for (int32 i = 0; i < output_chunk_size; i++)
+  for (int32 i = 0; i < output_chunk_size; i += frame_subsampling_factor)
     current_output_inds.push_back(i + LeftContext());
 
   (*chunk_info_out).resize(NumComponents() + 1);
 
-  // indexes for last component is empty, since the last component's chunk is
-  // always contiguous
-  // component's output is always contiguous
+  // the last component's output is contiguous unless we subsample.
   (*chunk_info_out)[NumComponents()] = ChunkInfo(
       GetComponent(NumComponents() - 1).OutputDim(),
-      num_chunks, current_output_inds.front(),
-      current_output_inds.back());
+      num_chunks, current_output_inds);
 
   std::vector<int32> current_input_inds;
   for (int32 i = NumComponents() - 1; i >= 0; i--) {
@@ -119,9 +118,12 @@ void Nnet::ComputeChunkInfo(int32 input_chunk_size,
 
   // Ensuring that all components until the first component capable of data
   // rearrangement (e.g. SpliceComponent|SpliceMaxComponent) operate on
-  // contiguous chunks at the input
-  for (size_t i = 0 ; i < NumComponents() ; i++) {
-      (*chunk_info_out)[i].MakeOffsetsContiguous();
+  // contiguous chunks at the input, covering all the input frames (if we
+  // subsample, the last few frames may not otherwise be needed).
+  size_t i = 0;
+  for (; i < NumComponents() ; i++) {
+      (*chunk_info_out)[i] = ChunkInfo(GetComponent(i).InputDim(), num_chunks,
+                                       0, input_chunk_size - 1);
       // Check if the current component is present in the set of components
       // capable of data rearrangement.
       if (std::find(data_rearrange_components.begin(),
@@ -130,6 +132,9 @@ void Nnet::ComputeChunkInfo(int32 input_chunk_size,
           != data_rearrange_components.end())
           break;
   }
+  if (i == NumComponents() && frame_subsampling_factor != 1)
+    KALDI_ERR << "Cannot subsample the output of a network with no splicing "
+              << "components.";
 
   // sanity testing for chunk_info_out vector
   for (size_t i = 0; i < chunk_info_out->size(); i++) {
@@ -527,6 +532,34 @@ void Nnet::SetDropoutScale(BaseFloat scale) {
             << " for " << n_set << " components.";
 }
 
+void Nnet::SetCompressOnWrite(bool compress) {
+  size_t n_set = 0;
+  for (size_t i = 0; i < components_.size(); i++) {
+    AffineComponent *ac =
+        dynamic_cast<AffineComponent*>(components_[i]);
+    if (ac != NULL) {
+      ac->SetCompressOnWrite(compress);
+      n_set++;
+    }
+  }
+  KALDI_LOG << (compress ? "Set" : "Unset") << " compression on write for "
+            << n_set << " components.";
+}
+
+void Nnet::SetAlignOnWrite(bool align) {
+  size_t n_set = 0;
+  for (size_t i = 0; i < components_.size(); i++) {
+    AffineComponent *ac =
+        dynamic_cast<AffineComponent*>(components_[i]);
+    if (ac != NULL) {
+      ac->SetAlignOnWrite(align);
+      n_set++;
+    }
+  }
+  KALDI_LOG << (align ? "Set" : "Unset") << " alignment on write for "
+            << n_set << " components.";
+}
+
 
 void Nnet::RemovePreconditioning() {
   for (size_t i = 0; i < components_.size(); i++) {
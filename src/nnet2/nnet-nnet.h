@@ -102,6 +102,18 @@ class Nnet {
   /// LeftContext() + RightContext().
   void ComputeChunkInfo(int32 input_chunk_size,
                         int32 num_chunks,
+                        std::vector<ChunkInfo> *chunk_info_out) const {
+    ComputeChunkInfo(input_chunk_size, num_chunks, 1, chunk_info_out);
+  }
+
+  /// As ComputeChunkInfo() above, but only every "frame_subsampling_factor"'th
+  /// output frame is computed (the first output frame, and every k'th one after
+  /// it).  The computation is subsampled from the last splicing component
+  /// upward, so the network must contain a SpliceComponent or
+  /// SpliceMaxComponent if frame_subsampling_factor > 1.
+  void ComputeChunkInfo(int32 input_chunk_size,
+                        int32 num_chunks,
+                        int32 frame_subsampling_factor,
                         std::vector<ChunkInfo> *chunk_info_out) const;
 
   void ZeroStats(); // zeroes the stats on the nonlinear layers.
@@ -131,6 +143,16 @@ class Nnet {
 
   /// Calls SetDropoutScale for all the dropout nodes.
   void SetDropoutScale(BaseFloat scale);
+
+  /// Calls SetCompressOnWrite for all the components of type AffineComponent
+  /// or derived classes, so that their parameters are written in compressed
+  /// form (for decoding-only models).
+  void SetCompressOnWrite(bool compress);
+
+  /// Calls SetAlignOnWrite for all the components of type AffineComponent
+  /// or derived classes, so that their parameters can be used in place when
+  /// the model is read from a MappedInput.
+  void SetAlignOnWrite(bool align);
   
   /// Replace any components of type AffineComponentPreconditioned with
   /// components of type AffineComponent.
@@ -22,6 +22,7 @@
 #include "nnet2/decodable-am-nnet.h"
 #include "nnet2/online-nnet2-decodable.h"
 #include "feat/online-feature.h"
+#include "ivector/voice-activity-detection.h"
 
 namespace kaldi {
 namespace nnet2 {
@@ -67,6 +68,8 @@ void UnitTestNnetDecodable() {
   opts.acoustic_scale = 0.1;
 
   opts.pad_input = (rand() % 2 == 0);
+  opts.frame_subsampling_factor = 1 + rand() % 3;
+  opts.repeat_frames = (rand() % 2 == 0);
 
   int32 num_input_frames = 400;
   Matrix<BaseFloat> input_feats(num_input_frames, input_dim);
@@ -80,12 +83,22 @@ void UnitTestNnetDecodable() {
   DecodableAmNnet offline_decodable(trans_model, am_nnet,
                                     CuMatrix<BaseFloat>(input_feats),
                                     opts.pad_input,
-                                    opts.acoustic_scale);
+                                    opts.acoustic_scale,
+                                    opts.frame_subsampling_factor,
+                                    opts.repeat_frames);
+  // the same without frame subsampling.
+  DecodableAmNnet full_decodable(trans_model, am_nnet,
+                                 CuMatrix<BaseFloat>(input_feats),
+                                 opts.pad_input,
+                                 opts.acoustic_scale);
 
   KALDI_ASSERT(online_decodable.NumFramesReady() ==
                offline_decodable.NumFramesReady());
   int32 num_frames = online_decodable.NumFramesReady(),
-      num_tids = trans_model.NumTransitionIds();
+      num_tids = trans_model.NumTransitionIds(),
+      subsample = opts.frame_subsampling_factor;
+  KALDI_ASSERT(online_decodable.IsLastFrame(num_frames - 1) &&
+               !online_decodable.IsLastFrame(num_frames - 2));
   
   for (int32 i = 0; i < 50; i++) {
 
@@ -93,9 +106,112 @@ void UnitTestNnetDecodable() {
     BaseFloat l1 = online_decodable.LogLikelihood(t, tid),
         l2 = offline_decodable.LogLikelihood(t, tid);
     KALDI_ASSERT(ApproxEqual(l1, l2));
+    // the frame of full_decodable that frame t comes from.
+    int32 full_t = (opts.repeat_frames ? (t / subsample) * subsample :
+                    t * subsample);
+    BaseFloat l3 = full_decodable.LogLikelihood(full_t, tid);
+    KALDI_ASSERT(ApproxEqual(l1, l3));
   }
 }
 
+// Tests that with voice activity detection from OnlineVadEnergy, the frames in
+// a long region of non-speech get the smaller max-active and the network
+// output for the first frame of the region, while the frames around it are
+// not affected.
+void UnitTestNnetDecodableSilence() {
+  std::vector<int32> phones;
+  phones.push_back(1);
+  for (int32 i = 2; i < 20; i++)
+    if (rand() % 2 == 0)
+      phones.push_back(i);
+  int32 N = 2 + rand() % 2, P = rand() % N;
+  std::vector<int32> num_pdf_classes;
+  ContextDependency *ctx_dep =
+      GenRandContextDependencyLarge(phones, N, P,
+                                    true, &num_pdf_classes);
+  HmmTopology topo = GetDefaultTopology(phones);
+  TransitionModel trans_model(*ctx_dep, topo);
+  delete ctx_dep;
+
+  int32 input_dim = 40, output_dim = trans_model.NumPdfs();
+  Nnet *nnet = GenRandomNnet(input_dim, output_dim);
+  AmNnet am_nnet(*nnet);
+  delete nnet;
+  Vector<BaseFloat> priors(output_dim);
+  priors.SetRandn();
+  priors.ApplyExp();
+  priors.Scale(1.0 / priors.Sum());
+  am_nnet.SetPriors(priors);
+
+  DecodableNnet2OnlineOptions opts;
+  opts.max_nnet_batch_size = 20;
+  opts.acoustic_scale = 0.1;
+  opts.pad_input = (rand() % 2 == 0);
+
+  // The first coefficient is like a log-energy: speech, then a long pause,
+  // then speech again.
+  int32 num_input_frames = 400;
+  Matrix<BaseFloat> input_feats(num_input_frames, input_dim);
+  input_feats.SetRandn();
+  for (int32 t = 0; t < num_input_frames; t++)
+    input_feats(t, 0) += (t >= 100 && t < 300 ? 0.0 : 20.0);
+
+  OnlineMatrixFeature matrix_feature(input_feats);
+  OnlineVadEnergyConfig vad_config;
+  OnlineVadEnergy vad(vad_config, &matrix_feature);
+  DecodableNnet2Online online_decodable(am_nnet, trans_model, opts,
+                                        &matrix_feature, &vad);
+  DecodableAmNnet offline_decodable(trans_model, am_nnet,
+                                    CuMatrix<BaseFloat>(input_feats),
+                                    opts.pad_input,
+                                    opts.acoustic_scale);
+
+  int32 num_frames = online_decodable.NumFramesReady(),
+      num_tids = trans_model.NumTransitionIds(),
+      left_context = am_nnet.GetNnet().LeftContext(),
+      max_active = 7000, silence_max_active = 1000;
+  KALDI_ASSERT(num_frames == offline_decodable.NumFramesReady());
+
+  int32 num_silence = 0, run_begin = -1;
+  for (int32 t = 0; t < num_frames; t++) {
+    // the input frame that the network output for frame t is centered on.
+    int32 vad_t = t + (opts.pad_input ? 0 : left_context);
+    bool is_silence = vad.IsNonSpeech(vad_t);
+    KALDI_ASSERT(online_decodable.IsSilenceFrame(t) == is_silence);
+
+    int32 end_frame;
+    KALDI_ASSERT(online_decodable.GetMaxActive(t, max_active,
+                                               silence_max_active,
+                                               &end_frame) ==
+                 (is_silence ? silence_max_active : max_active));
+    KALDI_ASSERT(end_frame > t && end_frame <= num_frames);
+    for (int32 t2 = t; t2 < end_frame; t2++)
+      KALDI_ASSERT(online_decodable.IsSilenceFrame(t2) == is_silence);
+    KALDI_ASSERT(end_frame == num_frames ||
+                 online_decodable.IsSilenceFrame(end_frame) != is_silence);
+    // silence_max_active <= 0 means we don't change the max-active.
+    KALDI_ASSERT(online_decodable.GetMaxActive(t, max_active, 0,
+                                               &end_frame) == max_active);
+
+    int32 tid = 1 + rand() % num_tids;
+    BaseFloat l = online_decodable.LogLikelihood(t, tid);
+    if (is_silence) {
+      num_silence++;
+      if (t == 0 || !online_decodable.IsSilenceFrame(t - 1))
+        run_begin = t;
+      KALDI_ASSERT(ApproxEqual(l, offline_decodable.LogLikelihood(run_begin,
+                                                                  tid)));
+    } else {
+      KALDI_ASSERT(ApproxEqual(l, offline_decodable.LogLikelihood(t, tid)));
+    }
+  }
+  // Most of the pause is non-speech, but none of the speech.
+  KALDI_LOG << num_silence << " of " << num_frames << " frames are silence.";
+  KALDI_ASSERT(num_silence > 150 && num_silence < 200);
+  for (int32 t = 0; t < 90 - left_context; t++)
+    KALDI_ASSERT(!online_decodable.IsSilenceFrame(t));
+}
+
 } // namespace nnet2
 } // namespace kaldi
 
@@ -107,6 +223,8 @@ int main() {
 
   for (int32 i = 0; i < 3; i++)
     UnitTestNnetDecodable();
+  for (int32 i = 0; i < 3; i++)
+    UnitTestNnetDecodableSilence();
   return 0;
 }
   
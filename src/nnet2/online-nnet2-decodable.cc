@@ -26,8 +26,10 @@ DecodableNnet2Online::DecodableNnet2Online(
     const AmNnet &nnet,
     const TransitionModel &trans_model,
     const DecodableNnet2OnlineOptions &opts,
-    OnlineFeatureInterface *input_feats):
+    OnlineFeatureInterface *input_feats,
+    OnlineFeatureInterface *vad):
     features_(input_feats),
+    vad_(vad),
     nnet_(nnet),
     trans_model_(trans_model),
     opts_(opts),
@@ -35,27 +37,78 @@ DecodableNnet2Online::DecodableNnet2Online(
     left_context_(nnet.GetNnet().LeftContext()),
     right_context_(nnet.GetNnet().RightContext()),
     num_pdfs_(nnet.GetNnet().OutputDim()),
-    begin_frame_(-1) {
-  KALDI_ASSERT(opts_.max_nnet_batch_size > 0);
+    begin_frame_(-1),
+    end_frame_(-1) {
+  KALDI_ASSERT(opts_.max_nnet_batch_size > 0 &&
+               opts_.frame_subsampling_factor > 0);
   log_priors_ = nnet_.Priors();
   KALDI_ASSERT(log_priors_.Dim() == trans_model_.NumPdfs() &&
                "Priors in neural network not set up (or mismatch "
                "with transition model).");
   log_priors_.ApplyLog();
+  KALDI_ASSERT(vad_ == NULL || vad_->Dim() == 1);
 }
 
 
 
 BaseFloat DecodableNnet2Online::LogLikelihood(int32 frame, int32 index) {
+  if (opts_.repeat_frames) frame /= opts_.frame_subsampling_factor;
   ComputeForFrame(frame);
   int32 pdf_id = trans_model_.TransitionIdToPdf(index);
-  KALDI_ASSERT(frame >= begin_frame_ &&
-               frame < begin_frame_ + scaled_loglikes_.NumRows());
-  return scaled_loglikes_(frame - begin_frame_, pdf_id);
+  KALDI_ASSERT(frame >= begin_frame_ && frame < end_frame_);
+  // After a run of non-speech frames, scaled_loglikes_ has just one row.
+  int32 row = std::min(frame - begin_frame_, scaled_loglikes_.NumRows() - 1);
+  return scaled_loglikes_(row, pdf_id);
+}
+
+bool DecodableNnet2Online::IsSilenceFrame(int32 frame) {
+  if (opts_.repeat_frames) frame /= opts_.frame_subsampling_factor;
+  return IsSilenceSubsampledFrame(frame);
+}
+
+int32 DecodableNnet2Online::GetMaxActive(int32 frame, int32 max_active,
+                                         int32 silence_max_active,
+                                         int32 *end_frame) {
+  int32 num_frames_ready = NumFramesReady();
+  KALDI_ASSERT(frame >= 0 && frame < num_frames_ready);
+  bool is_silence = IsSilenceFrame(frame);
+  *end_frame = frame + 1;
+  while (*end_frame < num_frames_ready &&
+         IsSilenceFrame(*end_frame) == is_silence)
+    (*end_frame)++;
+  return (is_silence && silence_max_active > 0 ? silence_max_active :
+          max_active);
+}
+
+bool DecodableNnet2Online::IsSilenceSubsampledFrame(int32 frame) {
+  if (vad_ == NULL)
+    return false;
+  KALDI_ASSERT(frame >= 0);
+  if (frame >= static_cast<int32>(is_silence_.size())) {
+    // Get the decisions for all the frames that are ready.
+    int32 subsample = opts_.frame_subsampling_factor,
+        frames_ready = (NumNnetFramesReady() + subsample - 1) / subsample;
+    KALDI_ASSERT(frame < frames_ready);
+    Vector<BaseFloat> vad(1);
+    for (int32 f = is_silence_.size(); f < frames_ready; f++) {
+      // The network output for nnet frame n needs input frame
+      // n + left_context_ if we don't pad the input.
+      int32 vad_frame = f * subsample + (opts_.pad_input ? 0 : left_context_);
+      vad_->GetFrame(vad_frame, &vad);
+      is_silence_.push_back(vad(0) == 0.0);
+    }
+  }
+  return is_silence_[frame];
 }
 
 
 bool DecodableNnet2Online::IsLastFrame(int32 frame) const {
+  int32 subsample = opts_.frame_subsampling_factor;
+  if (subsample != 1 && !opts_.repeat_frames) {
+    int32 features_ready = features_->NumFramesReady();
+    return (features_ready > 0 && features_->IsLastFrame(features_ready - 1) &&
+            frame == NumFramesReady() - 1);
+  }
   if (opts_.pad_input) { // normal case
     return features_->IsLastFrame(frame);
   } else {
@@ -64,41 +117,78 @@ bool DecodableNnet2Online::IsLastFrame(int32 frame) const {
 }
 
 int32 DecodableNnet2Online::NumFramesReady() const {
+  int32 ans = NumNnetFramesReady(),
+      subsample = opts_.frame_subsampling_factor;
+  if (opts_.repeat_frames || subsample == 1)
+    return ans;
+  else
+    return (ans + subsample - 1) / subsample;
+}
+
+int32 DecodableNnet2Online::NumNnetFramesReady() const {
   int32 features_ready = features_->NumFramesReady();
   if (features_ready == 0)
     return 0;
   bool input_finished = features_->IsLastFrame(features_ready - 1);
+  int32 ans;
   if (opts_.pad_input) {
     // normal case... we'll pad with duplicates of first + last frame to get the
     // required left and right context.
-    if (input_finished) return features_ready;
-    else return std::max<int32>(0, features_ready - right_context_);
+    if (input_finished) ans = features_ready;
+    else ans = std::max<int32>(0, features_ready - right_context_);
   } else {
-    return std::max<int32>(0, features_ready - right_context_ - left_context_);
+    ans = std::max<int32>(0, features_ready - right_context_ - left_context_);
   }
+  if (vad_ != NULL) {
+    // We also need the voice activity decision for each frame.
+    int32 vad_ready = vad_->NumFramesReady();
+    if (!opts_.pad_input)
+      vad_ready -= left_context_;
+    ans = std::max<int32>(0, std::min(ans, vad_ready));
+  }
+  return ans;
 }
 
 void DecodableNnet2Online::ComputeForFrame(int32 frame) {
   int32 features_ready = features_->NumFramesReady();
   bool input_finished = features_->IsLastFrame(features_ready - 1);  
   KALDI_ASSERT(frame >= 0);
-  if (frame >= begin_frame_ &&
-      frame < begin_frame_ + scaled_loglikes_.NumRows())
+  if (frame >= begin_frame_ && frame < end_frame_)
     return;
-  KALDI_ASSERT(frame < NumFramesReady());
+  int32 subsample = opts_.frame_subsampling_factor,
+      nnet_frame = frame * subsample,
+      nnet_frames_ready = NumNnetFramesReady(),
+      frames_ready = (nnet_frames_ready + subsample - 1) / subsample;
+  KALDI_ASSERT(nnet_frame < nnet_frames_ready);
+
+  // We compute the output for up to opts_.max_nnet_batch_size frames, but
+  // only up to the next run of non-speech frames.  For a run of non-speech
+  // frames, we only compute the output for its first frame.
+  int32 batch_end = frame + 1;
+  bool is_silence = IsSilenceSubsampledFrame(frame);
+  if (is_silence) {
+    while (batch_end < frames_ready && IsSilenceSubsampledFrame(batch_end))
+      batch_end++;
+  } else {
+    while (batch_end < frames_ready &&
+           batch_end < frame + opts_.max_nnet_batch_size &&
+           !IsSilenceSubsampledFrame(batch_end))
+      batch_end++;
+  }
+  int32 num_subsampled_frames = (is_silence ? 1 : batch_end - frame);
 
   int32 input_frame_begin;
   if (opts_.pad_input)
-    input_frame_begin = frame - left_context_;
+    input_frame_begin = nnet_frame - left_context_;
   else
-    input_frame_begin = frame;
+    input_frame_begin = nnet_frame;
   int32 max_possible_input_frame_end = features_ready;
   if (input_finished && opts_.pad_input)
     max_possible_input_frame_end += right_context_;
   int32 input_frame_end = std::min<int32>(max_possible_input_frame_end,
                                           input_frame_begin +
                                           left_context_ + right_context_ +
-                                          opts_.max_nnet_batch_size);
+                                          num_subsampled_frames * subsample);
   KALDI_ASSERT(input_frame_end > input_frame_begin);
   Matrix<BaseFloat> features(input_frame_end - input_frame_begin,
                              feat_dim_);
@@ -118,13 +208,15 @@ void DecodableNnet2Online::ComputeForFrame(int32 frame) {
 
   int32 num_frames_out = input_frame_end - input_frame_begin -
       left_context_ - right_context_;
+  // we compute the output for every subsample'th frame.
+  int32 num_rows_out = (num_frames_out + subsample - 1) / subsample;
   
-  CuMatrix<BaseFloat> cu_posteriors(num_frames_out, num_pdfs_);
+  CuMatrix<BaseFloat> cu_posteriors(num_rows_out, num_pdfs_);
   
   // The "false" below tells it not to pad the input: we've already done
   // any padding that we needed to do.
   NnetComputation(nnet_.GetNnet(), cu_features,
-                  false, &cu_posteriors);
+                  false, subsample, &cu_posteriors);
   
   cu_posteriors.ApplyFloor(1.0e-20); // Avoid log of zero which leads to NaN.
   cu_posteriors.ApplyLog();
@@ -139,6 +231,8 @@ void DecodableNnet2Online::ComputeForFrame(int32 frame) {
   cu_posteriors.Swap(&scaled_loglikes_);
 
   begin_frame_ = frame;
+  end_frame_ = (is_silence ? batch_end :
+                begin_frame_ + scaled_loglikes_.NumRows());
 }
 
 } // namespace nnet2
@@ -38,11 +38,15 @@ struct DecodableNnet2OnlineOptions {
   BaseFloat acoustic_scale;
   bool pad_input;
   int32 max_nnet_batch_size;
+  int32 frame_subsampling_factor;
+  bool repeat_frames;
   
   DecodableNnet2OnlineOptions():
       acoustic_scale(0.1),
       pad_input(true),
-      max_nnet_batch_size(256) { }
+      max_nnet_batch_size(256),
+      frame_subsampling_factor(1),
+      repeat_frames(false) { }
 
   void Register(OptionsItf *opts) {
     opts->Register("acoustic-scale", &acoustic_scale,
@@ -54,7 +58,15 @@ struct DecodableNnet2OnlineOptions {
                    "Maximum batch size we use in neural-network decodable object, "
                    "in cases where we are not constrained by currently available "
                    "frames (this will rarely make a difference)");
-                 
+    opts->Register("frame-subsampling-factor", &frame_subsampling_factor,
+                   "If >1, only compute the neural-net output for every n'th "
+                   "frame.  Unless --repeat-frames=true, the decoder only sees "
+                   "those frames, so the graph must be built for the lower "
+                   "frame rate.");
+    opts->Register("repeat-frames", &repeat_frames,
+                   "If true (and --frame-subsampling-factor > 1), repeat each "
+                   "computed frame for the frames that were skipped, so the "
+                   "decoder sees all the frames.");
   }
 };
 
@@ -63,6 +75,13 @@ struct DecodableNnet2OnlineOptions {
    This Decodable object for class nnet2::AmNnet takes feature input from class
    OnlineFeatureInterface, unlike, say, class DecodableAmNnet which takes
    feature input from a matrix.
+
+   If you give it a voice activity detection "vad" (e.g. class
+   OnlineVadEnergy, via OnlineNnet2FeaturePipeline::Vad()), which must be
+   one-dimensional, with the same frames as the input features, and zero for
+   frames in long regions of non-speech, then for each run of such frames we
+   only evaluate the network for the first frame and use its output for the
+   rest of the run.
 */
 
 class DecodableNnet2Online: public DecodableInterface {
@@ -70,7 +89,8 @@ class DecodableNnet2Online: public DecodableInterface {
   DecodableNnet2Online(const AmNnet &nnet,
                        const TransitionModel &trans_model,
                        const DecodableNnet2OnlineOptions &opts,
-                       OnlineFeatureInterface *input_feats);
+                       OnlineFeatureInterface *input_feats,
+                       OnlineFeatureInterface *vad = NULL);
   
   
   /// Returns the scaled log likelihood
@@ -82,14 +102,40 @@ class DecodableNnet2Online: public DecodableInterface {
   
   /// Indices are one-based!  This is for compatibility with OpenFst.
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
+
+  /// Returns true if this frame (numbered as in LogLikelihood()) is in a long
+  /// region of non-speech according to the voice activity detection, so its
+  /// output is copied from an earlier frame; always false if there is no voice
+  /// activity detection.  The frame must be ready.
+  bool IsSilenceFrame(int32 frame);
+
+  /// For decoding with a smaller max-active in long regions of non-speech:
+  /// returns "silence_max_active" if "frame" is a silence frame (see
+  /// IsSilenceFrame()) and silence_max_active > 0, else "max_active", and
+  /// sets *end_frame to one past the last of the ready frames from "frame"
+  /// onward that are of the same kind (silence or not), so the value applies
+  /// to frames "frame" through *end_frame - 1.  The frame must be ready.
+  int32 GetMaxActive(int32 frame, int32 max_active, int32 silence_max_active,
+                     int32 *end_frame);
   
  private:
 
   /// If the neural-network outputs for this frame are not cached, it computes
-  /// them (and possibly for some succeeding frames)
+  /// them (and possibly for some succeeding frames).  Here, "frame" is the
+  /// index of the subsampled frame, i.e. the network output for input frame
+  /// frame * opts_.frame_subsampling_factor.
   void ComputeForFrame(int32 frame);
+
+  /// The number of frames for which we can compute the network output, at the
+  /// input frame rate.
+  int32 NumNnetFramesReady() const;
+
+  /// Like IsSilenceFrame(), but "frame" is the index of the subsampled frame,
+  /// as in ComputeForFrame().
+  bool IsSilenceSubsampledFrame(int32 frame);
   
   OnlineFeatureInterface *features_;
+  OnlineFeatureInterface *vad_;  // Voice activity detection, or NULL.
   const AmNnet &nnet_;
   const TransitionModel &trans_model_;
   DecodableNnet2OnlineOptions opts_;
@@ -99,10 +145,16 @@ class DecodableNnet2Online: public DecodableInterface {
   int32 right_context_;  // Right context of the network (cached here)
   int32 num_pdfs_;  // Number of pdfs, equals output-dim of the network (cached
                     // here)
+
+  // is_silence_[f] is IsSilenceSubsampledFrame(f), for the (subsampled)
+  // frames that we have looked at so far.
+  std::vector<bool> is_silence_;
   
-  int32 begin_frame_;  // First frame for which scaled_loglikes_ is valid
-                       // (i.e. the first frame of the batch of frames for
-                       // which we've computed the output).
+  int32 begin_frame_;  // First (subsampled) frame for which scaled_loglikes_
+                       // is valid (i.e. the first frame of the batch of
+                       // frames for which we've computed the output).
+  int32 end_frame_;  // One past the last (subsampled) frame for which
+                     // scaled_loglikes_ is valid.
   
   // scaled_loglikes_ contains the neural network pseudo-likelihoods: the log of
   // (prob divided by the prior), scaled by opts.acoustic_scale).  We may
@@ -110,7 +162,8 @@ class DecodableNnet2Online: public DecodableInterface {
   // when we store it here.  These scores are only kept for a subset of frames,
   // starting at begin_frame_, whose length depends how many frames were ready
   // at the time we called LogLikelihood(), and will never exceed
-  // opts_.max_nnet_batch_size.
+  // opts_.max_nnet_batch_size.  For a run of non-speech frames, it has one row,
+  // which we use for all the frames of the run.
   Matrix<BaseFloat> scaled_loglikes_;
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableNnet2Online);
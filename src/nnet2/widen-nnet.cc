@@ -40,6 +40,8 @@ void AffineComponent::Widen(int32 new_dim,
     return;
   }
   
+  this->CopyMappedParams();
+  c3->CopyMappedParams();
   this->bias_params_.Resize(new_dim,
                             kCopyData);
   this->bias_params_.Range(old_dim, extra_dim).SetRandn();
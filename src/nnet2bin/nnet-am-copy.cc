@@ -39,7 +39,9 @@ int main(int argc, char *argv[]) {
         "\n"
         "Usage:  nnet-am-copy [options] <nnet-in> <nnet-out>\n"
         "e.g.:\n"
-        " nnet-am-copy --binary=false 1.mdl text.mdl\n";
+        " nnet-am-copy --binary=false 1.mdl text.mdl\n"
+        " nnet-am-copy --compress=true final.mdl final_compressed.mdl\n"
+        " nnet-am-copy --align-weights=true final.mdl final_aligned.mdl\n";
 
     int32 truncate = -1;
     bool binary_write = true;
@@ -48,6 +50,8 @@ int main(int argc, char *argv[]) {
     bool remove_preconditioning = false;
     bool collapse = false;
     bool match_updatableness = true;
+    bool compress = false;
+    bool align_weights = false;
     BaseFloat learning_rate_factor = 1.0, learning_rate = -1;
     std::string learning_rate_scales_str = " ";
     std::string learning_rates = "";
@@ -87,6 +91,17 @@ int main(int argc, char *argv[]) {
                 "neural network: provide the extended filename.");
     po.Register("collapse", &collapse, "If true, collapse sequences of AffineComponents "
                 "and FixedAffineComponents to compactify model");
+    po.Register("compress", &compress, "If true, write the weight matrices of "
+                "affine components in compressed (8-bit) form, which makes the "
+                "model about 4 times smaller.  This is lossy, so only use it "
+                "for models that will be used for decoding.  Only affects "
+                "binary output.");
+    po.Register("align-weights", &align_weights, "If true, pad the output so "
+                "that the weight matrices of affine components are aligned in "
+                "the file; decoders that memory-map the model (e.g. "
+                "nnet-latgen-faster) can then use them without copying, and "
+                "processes decoding with the same model share them.  Only "
+                "affects binary output, and not compressed matrices.");
     po.Register("match-updatableness", &match_updatableness, "Only relevant if "
                 "collapse=true; set this to false to collapse mixed types.");
 
@@ -198,6 +213,9 @@ int main(int argc, char *argv[]) {
       am_nnet_stats.Read(ki.Stream(), binary);
       am_nnet.GetNnet().CopyStatsFrom(am_nnet_stats.GetNnet());
     }
+
+    if (compress) am_nnet.GetNnet().SetCompressOnWrite(true);
+    if (align_weights) am_nnet.GetNnet().SetAlignOnWrite(true);
     
     {
       Output ko(nnet_wxfilename, binary_write);
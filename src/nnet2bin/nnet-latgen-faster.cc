@@ -22,6 +22,7 @@
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "util/mapped-input.h"
 #include "tree/context-dep.h"
 #include "hmm/transition-model.h"
 #include "fstext/kaldi-fst-io.h"
@@ -46,6 +47,8 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     Timer timer;
     bool allow_partial = false;
+    int32 frame_subsampling_factor = 1;
+    bool repeat_frames = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
     
@@ -54,6 +57,15 @@ int main(int argc, char *argv[]) {
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("frame-subsampling-factor", &frame_subsampling_factor,
+                "If >1, only compute the neural-net output for every n'th "
+                "frame.  Unless --repeat-frames=true, the decoder only sees "
+                "those frames, so the graph must be built for the lower frame "
+                "rate.");
+    po.Register("repeat-frames", &repeat_frames, "If true (and "
+                "--frame-subsampling-factor > 1), repeat each computed frame "
+                "for the frames that were skipped, so the decoder sees all the "
+                "frames.");
     
     po.Read(argc, argv);
     
@@ -69,14 +81,14 @@ int main(int argc, char *argv[]) {
         words_wspecifier = po.GetOptArg(5),
         alignment_wspecifier = po.GetOptArg(6);
     
+    // The affine weights are used in place from the mapped model file, so
+    // model_input must outlive am_nnet.
+    bool binary;
+    MappedInput model_input(model_in_filename, &binary);
     TransitionModel trans_model;
     AmNnet am_nnet;
-    {
-      bool binary;
-      Input ki(model_in_filename, &binary);
-      trans_model.Read(ki.Stream(), binary);
-      am_nnet.Read(ki.Stream(), binary);
-    }
+    trans_model.Read(model_input.Stream(), binary);
+    am_nnet.Read(model_input.Stream(), binary);
 
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
@@ -123,7 +135,9 @@ int main(int argc, char *argv[]) {
                                          am_nnet,
                                          features,
                                          pad_input,
-                                         acoustic_scale);
+                                         acoustic_scale,
+                                         frame_subsampling_factor,
+                                         repeat_frames);
           double like;
           if (DecodeUtteranceLatticeFaster(
                   decoder, nnet_decodable, trans_model, word_syms, utt,
@@ -162,7 +176,9 @@ int main(int argc, char *argv[]) {
                                        am_nnet,
                                        features,
                                        pad_input,
-                                       acoustic_scale);
+                                       acoustic_scale,
+                                       frame_subsampling_factor,
+                                       repeat_frames);
         double like;
         if (DecodeUtteranceLatticeFaster(
                 decoder, nnet_decodable, trans_model, word_syms, utt,
@@ -43,12 +43,23 @@ int main(int argc, char *argv[]) {
     
     bool binary_write = true;
     std::string use_gpu = "yes";
-    int32 num_threads = 1;
+    int32 num_threads = 1, num_lattice_threads = 1, examples_per_batch = 1,
+        examples_per_merge = 10;
     NnetDiscriminativeUpdateOptions update_opts;
     
     ParseOptions po(usage);
     po.Register("binary", &binary_write, "Write output in binary mode");
     po.Register("num-threads", &num_threads, "Number of threads to use");
+    po.Register("num-lattice-threads", &num_lattice_threads, "Number of "
+                "threads that prepare the lattices for the training threads");
+    po.Register("examples-per-batch", &examples_per_batch, "Number of "
+                "examples each thread propagates through the network together; "
+                "the shorter ones are padded to the length of the longest");
+    po.Register("examples-per-merge", &examples_per_merge, "If >0, each "
+                "thread accumulates its parameter change in its own copy of "
+                "the model, and adds it to the shared model after this many "
+                "examples; if 0, the threads update the shared model directly "
+                "(Hogwild)");
     update_opts.Register(&po);
     
     po.Read(argc, argv);
@@ -72,12 +83,19 @@ int main(int argc, char *argv[]) {
     }
 
     
+    // Parse the silence phones once here, not for each example.
+    std::vector<int32> silence_phones;
+    ParseSilencePhones(update_opts, &silence_phones);
+
     NnetDiscriminativeStats stats;
     SequentialDiscriminativeNnetExampleReader example_reader(
         examples_rspecifier);
 
     NnetDiscriminativeUpdateParallel(am_nnet, trans_model,
-                                     update_opts, num_threads, &example_reader,
+                                     update_opts, silence_phones, num_threads,
+                                     num_lattice_threads, examples_per_batch,
+                                     examples_per_merge,
+                                     &example_reader,
                                      &(am_nnet.GetNnet()), &stats);
     {
       Output ko(nnet_wxfilename, binary_write);
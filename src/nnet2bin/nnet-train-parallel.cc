@@ -55,11 +55,15 @@ int main(int argc, char *argv[]) {
     po.Register("num-threads", &g_num_threads, "Number of training threads to use "
                 "in the parallel update. [Note: if you use a parallel "
                 "implementation of BLAS, the actual number of threads may be larger.]");
+    po.Register("thread-affinity", &g_thread_affinity, "Controls which CPUs "
+                "the training threads run on: none, compact or scatter "
+                "(spread over the NUMA nodes).");
     po.Register("minibatch-size", &minibatch_size, "Number of examples to use for "
                 "each minibatch during training.");
     
     po.Read(argc, argv);
     srand(srand_seed);
+    CheckThreadAffinity(g_thread_affinity);
 
     if (po.NumArgs() != 3) {
       po.PrintUsage();
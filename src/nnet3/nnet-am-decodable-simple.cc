@@ -89,8 +89,17 @@ DecodableAmNnetSimple::DecodableAmNnetSimple(
 }      
 
 
+int32 DecodableAmNnetSimple::NumFramesReady() const {
+  int32 subsample = opts_.frame_subsampling_factor;
+  if (opts_.repeat_frames)
+    return feats_.NumRows();
+  else
+    return (feats_.NumRows() + subsample - 1) / subsample;
+}
+
 BaseFloat DecodableAmNnetSimple::LogLikelihood(int32 frame,
                                                int32 transition_id) {
+  if (opts_.repeat_frames) frame /= opts_.frame_subsampling_factor;
   if (frame < current_log_post_offset_ ||
       frame >= current_log_post_offset_ + current_log_post_.NumRows())
     EnsureFrameIsComputed(frame);
@@ -109,7 +118,9 @@ int32 DecodableAmNnetSimple::GetIvectorDim() const {
 }
 
 void DecodableAmNnetSimple::EnsureFrameIsComputed(int32 frame) {
-  KALDI_ASSERT(frame >= 0 && frame  < feats_.NumRows());
+  int32 subsample = opts_.frame_subsampling_factor;
+  KALDI_ASSERT(subsample > 0 && frame >= 0 &&
+               frame * subsample < feats_.NumRows());
 
   const Nnet &nnet = am_nnet_.GetNnet();
   int32 feature_dim = feats_.NumCols(),
@@ -129,15 +140,20 @@ void DecodableAmNnetSimple::EnsureFrameIsComputed(int32 frame) {
   KALDI_ASSERT(frame < current_offset ||
                frame >= current_offset + current_frames_computed);
   // allow the output to be computed for frame 0 ... num_input_frames - 1.
-  int32 start_output_frame = frame,
-      num_output_frames = std::min<int32>(feats_.NumRows() - start_output_frame,
-                                          opts_.frames_per_chunk);
+  // If we subsample, the chunk still spans (up to) frames_per_chunk frames of
+  // time, but we only compute every subsample'th frame of it.
+  int32 start_output_frame = frame * subsample,
+      output_span = std::min<int32>(feats_.NumRows() - start_output_frame,
+                                    opts_.frames_per_chunk),
+      num_output_frames = (output_span + subsample - 1) / subsample;
   KALDI_ASSERT(num_output_frames > 0);
+  // the time-span of the frames we compute, from first to last.
+  output_span = (num_output_frames - 1) * subsample + 1;
   int32 first_input_frame = start_output_frame - am_nnet_.LeftContext(),
-      num_input_frames = am_nnet_.LeftContext() + num_output_frames +
+      num_input_frames = am_nnet_.LeftContext() + output_span +
                          am_nnet_.RightContext();
   Vector<BaseFloat> ivector;
-  GetCurrentIvector(start_output_frame, num_output_frames, &ivector);
+  GetCurrentIvector(start_output_frame, output_span, &ivector);
   
   Matrix<BaseFloat> input_feats;
   if (first_input_frame >= 0 &&
@@ -221,9 +237,20 @@ void DecodableAmNnetSimple::DoNnetComputation(
     indexes.push_back(Index(0, 0, 0));
     request.inputs.push_back(IoSpecification("ivector", indexes));
   }
-  request.outputs.push_back(
-      IoSpecification("output", time_offset + output_t_start,
-                      time_offset + output_t_start + num_output_frames));
+  int32 subsample = opts_.frame_subsampling_factor;
+  if (subsample == 1) {
+    request.outputs.push_back(
+        IoSpecification("output", time_offset + output_t_start,
+                        time_offset + output_t_start + num_output_frames));
+  } else {
+    // only ask for the frames we need; the compiler will work out which parts
+    // of the computation are needed for them.
+    std::vector<Index> indexes;
+    indexes.reserve(num_output_frames);
+    for (int32 i = 0; i < num_output_frames; i++)
+      indexes.push_back(Index(0, time_offset + output_t_start + i * subsample));
+    request.outputs.push_back(IoSpecification("output", indexes));
+  }
   const NnetComputation *computation = compiler_.Compile(request);
   Nnet *nnet_to_update = NULL;  // we're not doing any update.
   NnetComputer computer(opts_.compute_config, *computation,
@@ -247,7 +274,7 @@ void DecodableAmNnetSimple::DoNnetComputation(
   current_log_post_.Resize(0, 0);
   // the following statement just swaps the pointers if we're not using a GPU.
   cu_output.Swap(&current_log_post_);
-  current_log_post_offset_ = output_t_start;
+  current_log_post_offset_ = output_t_start / subsample;
 }
 
 void DecodableAmNnetSimple::PossiblyWarnForFramesPerChunk() const {
@@ -36,13 +36,17 @@ namespace nnet3 {
 struct DecodableAmNnetSimpleOptions {
   int32 frames_per_chunk;
   BaseFloat acoustic_scale;
+  int32 frame_subsampling_factor;
+  bool repeat_frames;
   bool debug_computation;
   NnetOptimizeOptions optimize_config;
   NnetComputeOptions compute_config;
 
   DecodableAmNnetSimpleOptions():
       frames_per_chunk(50),
-      acoustic_scale(0.1) { }
+      acoustic_scale(0.1),
+      frame_subsampling_factor(1),
+      repeat_frames(false) { }
 
   void Register(OptionsItf *opts) {
     opts->Register("frames-per-chunk", &frames_per_chunk,
@@ -50,6 +54,15 @@ struct DecodableAmNnetSimpleOptions {
                    "by the neural net.");
     opts->Register("acoustic-scale", &acoustic_scale,
                    "Scaling factor for acoustic log-likelihoods");
+    opts->Register("frame-subsampling-factor", &frame_subsampling_factor,
+                   "If >1, only compute the neural-net output for every n'th "
+                   "frame.  Unless --repeat-frames=true, the decoder only sees "
+                   "those frames, so the graph must be built for the lower "
+                   "frame rate.");
+    opts->Register("repeat-frames", &repeat_frames,
+                   "If true (and --frame-subsampling-factor > 1), repeat each "
+                   "computed frame for the frames that were skipped, so the "
+                   "decoder sees all the frames.");
     opts->Register("debug-computation", &debug_computation, "If true, turn on "
                    "debug for the actual computation (very verbose!)");
 
@@ -66,6 +79,11 @@ struct DecodableAmNnetSimpleOptions {
 /* DecodableAmNnetSimple is a decodable object that decodes with a neural net
    acoustic model of type AmNnetSimple.  It can accept just input features, or
    input features plus iVectors.
+
+   If opts.frame_subsampling_factor > 1, the network output is only computed
+   for every frame_subsampling_factor'th frame.  By default the decoder then
+   sees only those frames; with opts.repeat_frames, each computed frame is
+   repeated for the skipped frames after it.
 */
 class DecodableAmNnetSimple: public DecodableInterface {
  public:
@@ -103,7 +121,7 @@ class DecodableAmNnetSimple: public DecodableInterface {
   // from one (this routine is called by FSTs).
   virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id);
 
-  virtual int32 NumFramesReady() const { return feats_.NumRows(); }
+  virtual int32 NumFramesReady() const;
   
   // Note: these indices are one-based!  This is for compatibility with OpenFst.
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
@@ -117,13 +135,18 @@ class DecodableAmNnetSimple: public DecodableInterface {
   
  private:
   // This call is made to ensure that we have the log-probs for this frame
-  // cached in current_log_post_.
+  // cached in current_log_post_.  Here, "frame" is the index of the subsampled
+  // frame, i.e. the network output for input frame
+  // frame * opts_.frame_subsampling_factor.
   void EnsureFrameIsComputed(int32 frame);
 
   // This function does the actual nnet computation; it is called from
   // EnsureFrameIsComputed.  Any padding at file start/end is done by
   // the caller of this function (so the input should exceed the output
-  // by a suitable amount of context).  It puts its output in current_log_post_.
+  // by a suitable amount of context).  It computes num_output_frames frames
+  // of output, for times output_t_start, output_t_start +
+  // opts_.frame_subsampling_factor, and so on, and puts them in
+  // current_log_post_.
   void DoNnetComputation(int32 input_t_start,
                          const MatrixBase<BaseFloat> &input_feats,
                          const VectorBase<BaseFloat> &ivector,
@@ -162,7 +185,7 @@ class DecodableAmNnetSimple: public DecodableInterface {
   // The current log-posteriors that we got from the last time we
   // ran the computation.
   Matrix<BaseFloat> current_log_post_;
-  // The time-offset of the current log-posteriors. 
+  // The (subsampled) frame index of the first row of current_log_post_.
   int32 current_log_post_offset_;
   
 
@@ -26,6 +26,7 @@
 #include "fstext/fstext-lib.h"
 #include "decoder/decoder-wrappers.h"
 #include "nnet3/nnet-am-decodable-simple.h"
+#include "feat/feature-reader.h"
 #include "base/timer.h"
 
 
@@ -44,21 +45,28 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Generate lattices using nnet3 neural net model.\n"
         "Usage: nnet3-latgen-faster [options] <nnet-in> <fst-in|fsts-rspecifier> <features-rspecifier>"
-        " <lattice-wspecifier> [ <words-wspecifier> [<alignments-wspecifier>] ]\n";
+        " <lattice-wspecifier> [ <words-wspecifier> [<alignments-wspecifier>] ]\n"
+        "If --feature-type is set, <features-rspecifier> is instead a wav\n"
+        "rspecifier and the features are computed on the fly, e.g.:\n"
+        " nnet3-latgen-faster --feature-type=mfcc --mfcc-config=conf/mfcc_hires.conf \\\n"
+        "   --feature-chain='cmvn' --cmvn-stats=scp:data/test/cmvn.scp \\\n"
+        "   --utt2spk=ark:data/test/utt2spk final.mdl HCLG.fst \\\n"
+        "   scp:data/test/wav.scp ark:lat.ark\n";
     ParseOptions po(usage);
     Timer timer;
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
     DecodableAmNnetSimpleOptions decodable_opts;
+    FeatureReaderOptions feature_opts;
     
     std::string word_syms_filename;
     std::string ivector_rspecifier,
-        online_ivector_rspecifier,
-        utt2spk_rspecifier;
+        online_ivector_rspecifier;
     int32 online_ivector_period = 0;
     config.Register(&po);
     decodable_opts.Register(&po);
+    feature_opts.Register(&po);
     po.Register("word-symbol-table", &word_syms_filename,
                 "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial,
@@ -107,7 +115,7 @@ int main(int argc, char *argv[]) {
     RandomAccessBaseFloatMatrixReader online_ivector_reader(
         online_ivector_rspecifier);
     RandomAccessBaseFloatVectorReaderMapped ivector_reader(
-        ivector_rspecifier, utt2spk_rspecifier);
+        ivector_rspecifier, feature_opts.utt2spk_rspecifier);
     
     Int32VectorWriter words_writer(words_wspecifier);
     Int32VectorWriter alignment_writer(alignment_wspecifier);
@@ -123,7 +131,7 @@ int main(int argc, char *argv[]) {
     int num_success = 0, num_fail = 0;
 
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
-      SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+      SequentialFeatureReader feature_reader(feature_opts, feature_rspecifier);
       
       // Input FST is just one FST, not a table of FSTs.
       VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
@@ -177,10 +185,13 @@ int main(int argc, char *argv[]) {
           } else num_fail++;
         }
       }
+      // Utterances we could not compute features for.
+      num_fail += feature_reader.NumErrors();
       delete decode_fst; // delete this only after decoder goes out of scope.
     } else { // We have different FSTs for different utterances.
       SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
-      RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);          
+      RandomAccessFeatureReader feature_reader(feature_opts,
+                                               feature_rspecifier);
       for (; !fst_reader.Done(); fst_reader.Next()) {
         std::string utt = fst_reader.Key();
         if (!feature_reader.HasKey(utt)) {
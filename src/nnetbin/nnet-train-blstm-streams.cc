@@ -21,6 +21,7 @@
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-loss.h"
 #include "nnet/nnet-randomizer.h"
+#include "nnet/nnet-stream-batcher.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "base/timer.h"
@@ -68,6 +69,10 @@ int main(int argc, char *argv[]) {
     double frame_limit = 100000;
     po.Register("frame-limit", &frame_limit, "Max number of frames to be processed");
 
+    int32 bucket_size = 0;
+    po.Register("bucket-size", &bucket_size, "Sort groups of this many utterances by length, "
+                "so that the utterances processed in parallel need less padding [ 0 == disabled ]");
+
     int32 report_step = 100;
     po.Register("report-step", &report_step, "Step (number of sequences) for status reporting");
 
@@ -93,7 +98,6 @@ int main(int argc, char *argv[]) {
     using namespace kaldi;
     using namespace kaldi::nnet1;
     typedef kaldi::int32 int32;
-    Vector<BaseFloat> weights;
     // Select the GPU
 #if HAVE_CUDA == 1
     CuDevice::Instantiate().SelectGpuId(use_gpu);
@@ -118,117 +122,46 @@ int main(int argc, char *argv[]) {
       weights_reader.Open(frame_weights);
     }
 
+    // The minibatches are prepared in a background thread, unless the feature
+    // transform needs to run on the GPU, which can only be used from this thread.
+    bool background = true;
+#if HAVE_CUDA == 1
+    background = (feature_transform == "" || !CuDevice::Instantiate().Enabled());
+#endif
+    StreamBatcherOptions batcher_opts;
+    batcher_opts.num_streams = num_streams;
+    batcher_opts.batch_size = 0;  // whole utterances,
+    batcher_opts.frame_limit = static_cast<int32>(frame_limit);
+    batcher_opts.bucket_size = bucket_size;
+    // the feature transform is applied to each utterance before the padding,
+    StreamBatchReader batch_reader(batcher_opts, &feature_reader, &targets_reader,
+                                   &weights_reader,
+                                   (feature_transform != "" ? &nnet_transf : NULL),
+                                   length_tolerance, background);
+
     Xent xent;
     Mse mse;
 
-    CuMatrix<BaseFloat> feats, feats_transf, nnet_out, obj_diff;
+    CuMatrix<BaseFloat> nnet_out, obj_diff;
 
     Timer time;
     KALDI_LOG << (crossvalidate?"CROSS-VALIDATION":"TRAINING") << " STARTED";
-    // Feature matrix of every utterance
-    std::vector< Matrix<BaseFloat> > feats_utt(num_streams);
-    // Label vector of every utterance
-    std::vector< Posterior > labels_utt(num_streams);
-    std::vector< Vector<BaseFloat> > weights_utt(num_streams);
-
-    int32 feat_dim = nnet.InputDim();
-
-    int32 num_done = 0, num_no_tgt_mat = 0, num_other_error = 0;
-    while (1) {
-
-      std::vector<int32> frame_num_utt;
-      int32 sequence_index = 0, max_frame_num = 0;
-
-      for ( ; !feature_reader.Done(); feature_reader.Next()) {
-        std::string utt = feature_reader.Key();
-        // Check that we have targets
-        if (!targets_reader.HasKey(utt)) {
-          KALDI_WARN << utt << ", missing targets";
-          num_no_tgt_mat++;
-          continue;
-        }
-        // Get feature / target pair
-        Matrix<BaseFloat> mat = feature_reader.Value();
-        Posterior targets  = targets_reader.Value(utt);
-
-        if (frame_weights != "") {
-          weights = weights_reader.Value(utt);
-        } else {  // all per-frame weights are 1.0
-          weights.Resize(mat.NumRows());
-          weights.Set(1.0);
-        }
-        // correct small length mismatch ... or drop sentence
-        {
-          // add lengths to vector
-          std::vector<int32> lenght;
-          lenght.push_back(mat.NumRows());
-          lenght.push_back(targets.size());
-          lenght.push_back(weights.Dim());
-          // find min, max
-          int32 min = *std::min_element(lenght.begin(), lenght.end());
-          int32 max = *std::max_element(lenght.begin(), lenght.end());
-          // fix or drop ?
-          if (max - min < length_tolerance) {
-            if (mat.NumRows() != min) mat.Resize(min, mat.NumCols(), kCopyData);
-            if (targets.size() != min) targets.resize(min);
-            if (weights.Dim() != min) weights.Resize(min, kCopyData);
-          } else {
-            KALDI_WARN << utt << ", length mismatch of targets " << targets.size()
-                       << " and features " << mat.NumRows();
-            num_other_error++;
-            continue;
-          }
-        }
-
-        if (max_frame_num < mat.NumRows()) max_frame_num = mat.NumRows();
-        feats_utt[sequence_index] = mat;
-        labels_utt[sequence_index] = targets;
-        weights_utt[sequence_index] = weights;
-
-        frame_num_utt.push_back(mat.NumRows());
-        sequence_index++;
-        // If the total number of frames reaches frame_limit, then stop adding more sequences, regardless of whether
-        // the number of utterances reaches num_sequence or not.
-        if (frame_num_utt.size() == num_streams || frame_num_utt.size() * max_frame_num > frame_limit) {
-            feature_reader.Next(); break;
-        }
-      }
-      int32 cur_sequence_num = frame_num_utt.size();
 
-      // Create the final feature matrix. Every utterance is padded to the max length within this group of utterances
-      Matrix<BaseFloat> feat_mat_host(cur_sequence_num * max_frame_num, feat_dim, kSetZero);
-      Posterior target_host;
-      Vector<BaseFloat> weight_host;
-
-      target_host.resize(cur_sequence_num * max_frame_num);
-      weight_host.Resize(cur_sequence_num * max_frame_num, kSetZero);
-
-      for (int s = 0; s < cur_sequence_num; s++) {
-        Matrix<BaseFloat> mat_tmp = feats_utt[s];
-        for (int r = 0; r < frame_num_utt[s]; r++) {
-          feat_mat_host.Row(r*cur_sequence_num + s).CopyFromVec(mat_tmp.Row(r));
-        }
-      }
-
-      for (int s = 0; s < cur_sequence_num; s++) {
-        Posterior target_tmp = labels_utt[s];
-        for (int r = 0; r < frame_num_utt[s]; r++) {
-          target_host[r*cur_sequence_num+s] = target_tmp[r];
-        }
-        Vector<BaseFloat> weight_tmp = weights_utt[s];
-        for (int r = 0; r < frame_num_utt[s]; r++) {
-          weight_host(r*cur_sequence_num+s) = weight_tmp(r);
-        }
-      }
-
-      // transform feature
-      nnet_transf.Feedforward(CuMatrix<BaseFloat>(feat_mat_host), &feats_transf);
+    int32 num_done = 0;
+    // Each minibatch holds up to 'num_streams' utterances, interleaved and
+    // padded to the max length within the minibatch (see StreamBatcher).
+    const StreamBatch *batch;
+    while ((batch = batch_reader.NextBatch()) != NULL) {
+      const Vector<BaseFloat> &weight_host = batch->weights;
+      const Posterior &target_host = batch->targets;
+      KALDI_VLOG(3) << "Minibatch with " << batch->num_real_frames
+                    << " real frames out of " << batch->feats.NumRows();
 
       // Set the original lengths of utterances before padding
-      nnet.SetSeqLengths(frame_num_utt);
+      nnet.SetSeqLengths(batch->seq_lengths);
 
       // Propagation and xent training
-      nnet.Propagate(feats_transf, &nnet_out);
+      nnet.Propagate(CuMatrix<BaseFloat>(batch->feats), &nnet_out);
 
       if (objective_function == "xent") {
           // gradients re-scaled by weights in Eval,
@@ -255,10 +188,8 @@ int main(int argc, char *argv[]) {
         }
       }
 
-      num_done += cur_sequence_num;
-      total_frames += feats_transf.NumRows();
-
-      if (feature_reader.Done()) break;  // end loop of while(1)
+      num_done += batch->num_new_utts;
+      total_frames += batch->feats.NumRows();
     }
 
     // Check network parameters and gradients when training finishes
@@ -275,12 +206,13 @@ int main(int argc, char *argv[]) {
       nnet.Write(target_model_filename, binary);
     }
 
-    KALDI_LOG << "Done " << num_done << " files, " << num_no_tgt_mat
-              << " with no tgt_mats, " << num_other_error
+    KALDI_LOG << "Done " << num_done << " files, " << batch_reader.NumNoTargets()
+              << " with no tgt_mats, " << batch_reader.NumOtherErrors()
               << " with other errors. "
               << "[" << (crossvalidate?"CROSS-VALIDATION":"TRAINING")
               << ", " << time.Elapsed()/60 << " min, fps" << total_frames/time.Elapsed()
               << "]";
+    KALDI_LOG << batch_reader.Batcher().EfficiencyInfo();
     KALDI_LOG << xent.Report();
 
 #if HAVE_CUDA == 1
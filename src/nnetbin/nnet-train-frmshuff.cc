@@ -25,6 +25,228 @@
 #include "util/common-utils.h"
 #include "base/timer.h"
 #include "cudamatrix/cu-device.h"
+#include "thread/kaldi-queue.h"
+#include "thread/kaldi-thread.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+/// One fill of the randomizers.  When we train on the CPU, the reader thread
+/// adds the utterances to the randomizers of the block and shuffles them, so
+/// the main thread only has to train on the mini-batches.  Otherwise the
+/// utterances are just stored in 'feats', 'targets' and 'weights', and the
+/// main thread passes them to its own randomizers.
+struct RandomizerBlock {
+  std::vector<Matrix<BaseFloat> > feats;
+  std::vector<Posterior> targets;
+  std::vector<Vector<BaseFloat> > weights;
+  int32 num_frames;  ///< number of frames read into this block.
+  int32 num_utts;  ///< number of utterances read into this block.
+
+  MatrixRandomizer feature_randomizer;
+  PosteriorRandomizer targets_randomizer;
+  VectorRandomizer weights_randomizer;
+
+  explicit RandomizerBlock(const NnetDataRandomizerOptions &opts):
+      num_frames(0), num_utts(0), feature_randomizer(opts),
+      targets_randomizer(opts), weights_randomizer(opts) { }
+
+  /// Passes one utterance to the randomizers.
+  void AddData(const CuMatrixBase<BaseFloat> &feats_transf,
+               const Posterior &tgt, const Vector<BaseFloat> &wgt) {
+    KALDI_ASSERT(feats_transf.NumRows() == tgt.size());
+    feature_randomizer.AddData(feats_transf);
+    targets_randomizer.AddData(tgt);
+    weights_randomizer.AddData(wgt);
+  }
+  /// Discards the data in the randomizers, and takes the frames 'other' has
+  /// left over after its last full mini-batch.
+  void CopyLeftover(const RandomizerBlock &other) {
+    feature_randomizer.CopyLeftover(other.feature_randomizer);
+    targets_randomizer.CopyLeftover(other.targets_randomizer);
+    weights_randomizer.CopyLeftover(other.weights_randomizer);
+  }
+  /// Shuffles the frames in the randomizers.
+  void Randomize(RandomizerMask *randomizer_mask) {
+    const std::vector<int32> &mask =
+        randomizer_mask->Generate(feature_randomizer.NumFrames());
+    feature_randomizer.Randomize(mask);
+    targets_randomizer.Randomize(mask);
+    weights_randomizer.Randomize(mask);
+  }
+  bool Done() { return feature_randomizer.Done(); }
+  void Next() {
+    feature_randomizer.Next();
+    targets_randomizer.Next();
+    weights_randomizer.Next();
+  }
+  /// Clears the utterances read (not the randomizers, which may still hold
+  /// the left-over frames of an incomplete mini-batch).
+  void Clear() {
+    feats.clear();
+    targets.clear();
+    weights.clear();
+    num_frames = 0;
+    num_utts = 0;
+  }
+};
+
+/// RandomizerFiller runs in a background thread and prepares the next fill of
+/// the randomizers while the main thread trains on the current one: it reads
+/// the features, targets and frame weights and checks their lengths.  If
+/// 'nnet_transf' is non-NULL (we train on the CPU; the GPU may not be used
+/// from this thread), it also applies the feature transform, adds the data to
+/// the randomizers of the block and, if 'randomizer_mask' is non-NULL,
+/// shuffles them.  The frames left over after the last full mini-batch of a
+/// block are carried to the next block, so the mini-batches are the same as
+/// with a single set of randomizers.  It takes blocks from 'free_blocks' and
+/// puts them, filled with a little more than 'randomizer_size' frames each
+/// (counting the left-over), on 'full_blocks', which it closes at the end.
+class RandomizerFiller: public MultiThreadable {
+ public:
+  RandomizerFiller(SequentialBaseFloatMatrixReader *feature_reader,
+                   RandomAccessPosteriorReader *targets_reader,
+                   RandomAccessBaseFloatVectorReader *weights_reader,
+                   Nnet *nnet_transf, RandomizerMask *randomizer_mask,
+                   const NnetDataRandomizerOptions &rnd_opts,
+                   int32 length_tolerance,
+                   BoundedQueue<RandomizerBlock*> *free_blocks,
+                   BoundedQueue<RandomizerBlock*> *full_blocks,
+                   int32 *num_no_tgt_mat, int32 *num_other_error,
+                   std::string *error):
+      feature_reader_(feature_reader), targets_reader_(targets_reader),
+      weights_reader_(weights_reader), nnet_transf_(nnet_transf),
+      randomizer_mask_(randomizer_mask), rnd_opts_(rnd_opts),
+      length_tolerance_(length_tolerance), free_blocks_(free_blocks),
+      full_blocks_(full_blocks), num_no_tgt_mat_(num_no_tgt_mat),
+      num_other_error_(num_other_error), error_(error), last_block_(NULL),
+      num_leftover_(0) { }
+
+  void operator() () {
+    try {
+      RandomizerBlock *block;
+      while (!feature_reader_->Done() && free_blocks_->Pop(&block)) {
+        Fill(block);
+        if (block->num_utts == 0) break;  // no valid utterances were left.
+        if (nnet_transf_ != NULL && randomizer_mask_ != NULL)
+          block->Randomize(randomizer_mask_);
+        num_leftover_ = (num_leftover_ + block->num_frames) %
+            rnd_opts_.minibatch_size;
+        last_block_ = block;
+        if (!full_blocks_->Push(block)) return;  // aborted.
+      }
+    } catch(const std::exception &e) {
+      *error_ = e.what();
+    }
+    full_blocks_->Close();
+  }
+
+ private:
+  void Fill(RandomizerBlock *block) {
+    CuMatrix<BaseFloat> feats_transf;
+    // the main thread may still be training on 'last_block_', but it does
+    // not change the frames we copy.
+    if (nnet_transf_ != NULL && last_block_ != NULL)
+      block->CopyLeftover(*last_block_);
+    for ( ; !feature_reader_->Done(); feature_reader_->Next()) {
+      // keep the utterance for the next block if this one is full
+      if (num_leftover_ + block->num_frames > rnd_opts_.randomizer_size)
+        break;
+      std::string utt = feature_reader_->Key();
+      KALDI_VLOG(3) << "Reading " << utt;
+      // check that we have targets
+      if (!targets_reader_->HasKey(utt)) {
+        KALDI_WARN << utt << ", missing targets";
+        (*num_no_tgt_mat_)++;
+        continue;
+      }
+      // check we have per-frame weights
+      if (weights_reader_->IsOpen() && !weights_reader_->HasKey(utt)) {
+        KALDI_WARN << utt << ", missing per-frame weights";
+        (*num_other_error_)++;
+        continue;
+      }
+      // get feature / target pair
+      Matrix<BaseFloat> mat = feature_reader_->Value();
+      Posterior targets = targets_reader_->Value(utt);
+      // get per-frame weights
+      Vector<BaseFloat> weights;
+      if (weights_reader_->IsOpen()) {
+        weights = weights_reader_->Value(utt);
+      } else { // all per-frame weights are 1.0
+        weights.Resize(mat.NumRows());
+        weights.Set(1.0);
+      }
+      // correct small length mismatch ... or drop sentence
+      {
+        // add lengths to vector
+        std::vector<int32> lenght;
+        lenght.push_back(mat.NumRows());
+        lenght.push_back(targets.size());
+        lenght.push_back(weights.Dim());
+        // find min, max
+        int32 min = *std::min_element(lenght.begin(),lenght.end());
+        int32 max = *std::max_element(lenght.begin(),lenght.end());
+        // fix or drop ?
+        if (max - min < length_tolerance_) {
+          if(mat.NumRows() != min) mat.Resize(min, mat.NumCols(), kCopyData);
+          if(targets.size() != min) targets.resize(min);
+          if(weights.Dim() != min) weights.Resize(min, kCopyData);
+        } else {
+          KALDI_WARN << utt << ", length mismatch of targets " << targets.size()
+                     << " and features " << mat.NumRows();
+          (*num_other_error_)++;
+          continue;
+        }
+      }
+      block->num_frames += targets.size();
+      block->num_utts++;
+      if (nnet_transf_ != NULL) {
+        // apply the feature transform and pass the data to the randomizers
+        nnet_transf_->Feedforward(CuMatrix<BaseFloat>(mat), &feats_transf);
+        block->AddData(feats_transf, targets, weights);
+      } else {
+        block->feats.resize(block->feats.size() + 1);
+        block->feats.back().Swap(&mat);
+        block->targets.resize(block->targets.size() + 1);
+        block->targets.back().swap(targets);
+        block->weights.resize(block->weights.size() + 1);
+        block->weights.back().Swap(&weights);
+      }
+    }
+  }
+
+  SequentialBaseFloatMatrixReader *feature_reader_;
+  RandomAccessPosteriorReader *targets_reader_;
+  RandomAccessBaseFloatVectorReader *weights_reader_;
+  Nnet *nnet_transf_;
+  RandomizerMask *randomizer_mask_;
+  NnetDataRandomizerOptions rnd_opts_;
+  int32 length_tolerance_;
+  BoundedQueue<RandomizerBlock*> *free_blocks_;
+  BoundedQueue<RandomizerBlock*> *full_blocks_;
+  int32 *num_no_tgt_mat_;
+  int32 *num_other_error_;
+  std::string *error_;
+  RandomizerBlock *last_block_;  ///< the block we filled last.
+  int32 num_leftover_;  ///< frames left over after the last full mini-batch.
+};
+
+/// Aborts two queues when it goes out of scope.
+template<class T>
+class QueueAborter {
+ public:
+  QueueAborter(BoundedQueue<T> *a, BoundedQueue<T> *b): a_(a), b_(b) { }
+  ~QueueAborter() {
+    a_->Abort();
+    b_->Abort();
+  }
+ private:
+  BoundedQueue<T> *a_, *b_;
+};
+
+}  // namespace nnet1
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
@@ -124,9 +346,6 @@ int main(int argc, char *argv[]) {
     }
 
     RandomizerMask randomizer_mask(rnd_opts);
-    MatrixRandomizer feature_randomizer(rnd_opts);
-    PosteriorRandomizer targets_randomizer(rnd_opts);
-    VectorRandomizer weights_randomizer(rnd_opts);
 
     Xent xent;
     Mse mse;
@@ -143,100 +362,79 @@ int main(int argc, char *argv[]) {
     
     CuMatrix<BaseFloat> feats_transf, nnet_out, obj_diff;
 
+    // The data is read by a background thread, which fills one of two blocks
+    // while we train on the other.  When we train on the CPU, it also applies
+    // the feature transform and fills and shuffles the randomizers of the
+    // block.  The GPU may only be used from this thread, so with a GPU we do
+    // that here, in the randomizers of 'main_block'.
+    bool transform_in_reader = true;
+#if HAVE_CUDA==1
+    transform_in_reader = !CuDevice::Instantiate().Enabled();
+#endif
+    bool shuffle = (!crossvalidate && randomize);
+    RandomizerBlock block_a(rnd_opts), block_b(rnd_opts), main_block(rnd_opts);
+    BoundedQueue<RandomizerBlock*> free_blocks(2), full_blocks(2);
+    free_blocks.Push(&block_a);
+    free_blocks.Push(&block_b);
+    int32 num_done = 0, num_no_tgt_mat = 0, num_other_error = 0;
+    std::string reader_error;
+    RandomizerFiller filler(&feature_reader, &targets_reader, &weights_reader,
+                            (transform_in_reader ? &nnet_transf : NULL),
+                            (shuffle ? &randomizer_mask : NULL),
+                            rnd_opts, length_tolerance,
+                            &free_blocks, &full_blocks, &num_no_tgt_mat,
+                            &num_other_error, &reader_error);
+
     Timer time;
     KALDI_LOG << (crossvalidate?"CROSS-VALIDATION":"TRAINING") << " STARTED";
 
-    int32 num_done = 0, num_no_tgt_mat = 0, num_other_error = 0;
-    while (!feature_reader.Done()) {
+    MultiThreader<RandomizerFiller> reader_thread(1, filler);
+    // if we exit with an exception, this stops the reader so it can be joined.
+    QueueAborter<RandomizerBlock*> aborter(&free_blocks, &full_blocks);
+    RandomizerBlock *block;
+    while (full_blocks.Pop(&block)) {
 #if HAVE_CUDA==1
       // check the GPU is not overheated
       CuDevice::Instantiate().CheckGpuHealth();
 #endif
-      // fill the randomizer
-      for ( ; !feature_reader.Done(); feature_reader.Next()) {
-        if (feature_randomizer.IsFull()) break; // suspend, keep utt for next loop
-        std::string utt = feature_reader.Key();
-        KALDI_VLOG(3) << "Reading " << utt;
-        // check that we have targets
-        if (!targets_reader.HasKey(utt)) {
-          KALDI_WARN << utt << ", missing targets";
-          num_no_tgt_mat++;
-          continue;
-        }
-        // check we have per-frame weights
-        if (frame_weights != "" && !weights_reader.HasKey(utt)) {
-          KALDI_WARN << utt << ", missing per-frame weights";
-          num_other_error++;
-          continue;
-        }
-        // get feature / target pair
-        Matrix<BaseFloat> mat = feature_reader.Value();
-        Posterior targets = targets_reader.Value(utt);
-        // get per-frame weights
-        Vector<BaseFloat> weights;
-        if (frame_weights != "") {
-          weights = weights_reader.Value(utt);
-        } else { // all per-frame weights are 1.0
-          weights.Resize(mat.NumRows());
-          weights.Set(1.0);
-        }
-        // correct small length mismatch ... or drop sentence
-        {
-          // add lengths to vector
-          std::vector<int32> lenght;
-          lenght.push_back(mat.NumRows());
-          lenght.push_back(targets.size());
-          lenght.push_back(weights.Dim());
-          // find min, max
-          int32 min = *std::min_element(lenght.begin(),lenght.end());
-          int32 max = *std::max_element(lenght.begin(),lenght.end());
-          // fix or drop ?
-          if (max - min < length_tolerance) {
-            if(mat.NumRows() != min) mat.Resize(min, mat.NumCols(), kCopyData);
-            if(targets.size() != min) targets.resize(min);
-            if(weights.Dim() != min) weights.Resize(min, kCopyData);
-          } else {
-            KALDI_WARN << utt << ", length mismatch of targets " << targets.size()
-                       << " and features " << mat.NumRows();
-            num_other_error++;
-            continue;
-          }
-        }
-        // apply optional feature transform
-        nnet_transf.Feedforward(CuMatrix<BaseFloat>(mat), &feats_transf);
-
-        // pass data to randomizers
-        KALDI_ASSERT(feats_transf.NumRows() == targets.size());
-        feature_randomizer.AddData(feats_transf);
-        targets_randomizer.AddData(targets);
-        weights_randomizer.AddData(weights);
-        num_done++;
-      
-        // report the speed
-        if (num_done % 5000 == 0) {
-          double time_now = time.Elapsed();
-          KALDI_VLOG(1) << "After " << num_done << " utterances: time elapsed = "
-                        << time_now/60 << " min; processed " << total_frames/time_now
-                        << " frames per second.";
+      RandomizerBlock *randomizer = block;
+      if (!transform_in_reader) {
+        // apply the feature transform, fill the randomizer
+        randomizer = &main_block;
+        for (size_t i = 0; i < block->feats.size(); i++) {
+          nnet_transf.Feedforward(CuMatrix<BaseFloat>(block->feats[i]),
+                                  &feats_transf);
+          main_block.AddData(feats_transf, block->targets[i],
+                             block->weights[i]);
         }
+        // randomize
+        if (shuffle) main_block.Randomize(&randomizer_mask);
       }
 
-      // randomize
-      if (!crossvalidate && randomize) {
-        const std::vector<int32>& mask = randomizer_mask.Generate(feature_randomizer.NumFrames());
-        feature_randomizer.Randomize(mask);
-        targets_randomizer.Randomize(mask);
-        weights_randomizer.Randomize(mask);
+      // report the speed
+      if ((num_done + block->num_utts) / 5000 != num_done / 5000) {
+        double time_now = time.Elapsed();
+        KALDI_VLOG(1) << "After " << num_done + block->num_utts
+                      << " utterances: time elapsed = " << time_now/60
+                      << " min; processed " << total_frames/time_now
+                      << " frames per second.";
+      }
+      num_done += block->num_utts;
+
+      // hand the block back to the reader, if we have finished with it
+      if (randomizer != block) {
+        block->Clear();
+        free_blocks.Push(block);
       }
 
       // train with data from randomizers (using mini-batches)
-      for ( ; !feature_randomizer.Done(); feature_randomizer.Next(),
-                                          targets_randomizer.Next(),
-                                          weights_randomizer.Next()) {
+      for ( ; !randomizer->Done(); randomizer->Next()) {
         // get block of feature/target pairs
-        const CuMatrixBase<BaseFloat>& nnet_in = feature_randomizer.Value();
-        const Posterior& nnet_tgt = targets_randomizer.Value();
-        const Vector<BaseFloat>& frm_weights = weights_randomizer.Value();
+        const CuMatrixBase<BaseFloat>& nnet_in =
+            randomizer->feature_randomizer.Value();
+        const Posterior& nnet_tgt = randomizer->targets_randomizer.Value();
+        const Vector<BaseFloat>& frm_weights =
+            randomizer->weights_randomizer.Value();
 
         // forward pass
         nnet.Propagate(nnet_in, &nnet_out);
@@ -284,6 +482,14 @@ int main(int argc, char *argv[]) {
         
         total_frames += nnet_in.NumRows();
       }
+
+      if (randomizer == block) {
+        block->Clear();
+        free_blocks.Push(block);
+      }
+    }
+    if (reader_error != "") {
+      KALDI_ERR << "Error reading the training data: " << reader_error;
     }
     
     // after last minibatch : show what happens in network 
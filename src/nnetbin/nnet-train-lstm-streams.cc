@@ -24,6 +24,7 @@
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-loss.h"
 #include "nnet/nnet-randomizer.h"
+#include "nnet/nnet-stream-batcher.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "base/timer.h"
@@ -84,6 +85,10 @@ int main(int argc, char *argv[]) {
     po.Register("dump-interval", &dump_interval, "---LSTM--- num utts between model dumping [ 0 == disabled ]"); 
     //</jiayu>
 
+    int32 bucket_size = 0;
+    po.Register("bucket-size", &bucket_size, "Sort groups of this many utterances by length, "
+                "so that the streams get utterances of similar lengths [ 0 == disabled ]");
+
     // Add dummy randomizer options, to make the tool compatible with standard scripts
     NnetDataRandomizerOptions rnd_opts;
     rnd_opts.Register(&po);
@@ -129,18 +134,22 @@ int main(int argc, char *argv[]) {
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     RandomAccessPosteriorReader target_reader(targets_rspecifier);
-    
-    /*
-    RandomAccessBaseFloatVectorReader weights_reader;
-    if (frame_weights != "") {
-      weights_reader.Open(frame_weights);
-    }
-    */
 
-    RandomizerMask randomizer_mask(rnd_opts);
-    MatrixRandomizer feature_randomizer(rnd_opts);
-    PosteriorRandomizer targets_randomizer(rnd_opts);
-    VectorRandomizer weights_randomizer(rnd_opts);
+    // The minibatches are prepared in a background thread, unless the feature
+    // transform needs to run on the GPU, which can only be used from this thread.
+    bool background = true;
+#if HAVE_CUDA==1
+    background = (feature_transform == "" || !CuDevice::Instantiate().Enabled());
+#endif
+    StreamBatcherOptions batcher_opts;
+    batcher_opts.num_streams = num_stream;
+    batcher_opts.batch_size = batch_size;
+    batcher_opts.targets_delay = targets_delay;
+    batcher_opts.bucket_size = bucket_size;
+    // the lengths of features and targets have to match exactly (tolerance 1),
+    StreamBatchReader batch_reader(batcher_opts, &feature_reader, &target_reader,
+                                   NULL, (feature_transform != "" ? &nnet_transf : NULL),
+                                   1, background);
 
     Xent xent;
     Mse mse;
@@ -148,101 +157,27 @@ int main(int argc, char *argv[]) {
     Timer time;
     KALDI_LOG << (crossvalidate?"CROSS-VALIDATION":"TRAINING") << " STARTED";
 
-    int32 num_done = 0, num_no_tgt_mat = 0, num_other_error = 0;
-
-    //  book-keeping for multi-streams
-    std::vector<std::string> keys(num_stream);
-    std::vector<Matrix<BaseFloat> > feats(num_stream);
-    std::vector<Posterior> targets(num_stream);
-    std::vector<int> curt(num_stream, 0);
-    std::vector<int> lent(num_stream, 0);
-    std::vector<int> new_utt_flags(num_stream, 0);
-
-    // bptt batch buffer
-    int32 feat_dim = nnet.InputDim();
-    Vector<BaseFloat> frame_mask(batch_size * num_stream, kSetZero);
-    Matrix<BaseFloat> feat(batch_size * num_stream, feat_dim, kSetZero);
-    Posterior target(batch_size * num_stream);
-    CuMatrix<BaseFloat> feat_transf, nnet_out, obj_diff;
-
-    while (1) {
-        // loop over all streams, check if any stream reaches the end of its utterance,
-        // if any, feed the exhausted stream with a new utterance, update book-keeping infos
-        for (int s = 0; s < num_stream; s++) {
-            // this stream still has valid frames
-            if (curt[s] < lent[s]) {
-                new_utt_flags[s] = 0;
-                continue;
-            }
-            // else, this stream exhausted, need new utterance
-            while (!feature_reader.Done()) {
-                keys[s]  = feature_reader.Key();
-                const Matrix<BaseFloat> &mat = feature_reader.Value();
-                { // apply optional feature transform,
-                  // Karel: feature transform may contain <Splice> which does clone
-                  // frames on sentence boundaries. It is better to apply feature 
-                  // transform to whole sentences.
-                  nnet_transf.Feedforward(CuMatrix<BaseFloat>(mat), &feat_transf);
-                  feats[s].Resize(feat_transf.NumRows(), feat_transf.NumCols());
-                  feat_transf.CopyToMat(&feats[s]); 
-                }
-                if (!target_reader.HasKey(keys[s])) {
-                    KALDI_WARN << keys[s] << ", missing targets";
-                    num_no_tgt_mat++;
-                    feature_reader.Next();
-                    continue;
-                }
-                targets[s] = target_reader.Value(keys[s]);
-                if (feats[s].NumRows() != targets[s].size()) {
-                    KALDI_WARN << keys[s] << ", length miss-match between feats and targets, skip";
-                    feature_reader.Next();
-                    continue;
-                }
-                curt[s] = 0;
-                lent[s] = feats[s].NumRows();
-                new_utt_flags[s] = 1;  // a new utterance feeded to this stream
-                feature_reader.Next();
-                break;
-            }
-        }
+    int32 num_done = 0;
 
-        // we are done if all streams are exhausted
-        int done = 1;
-        for (int s = 0; s < num_stream; s++) {
-            if (curt[s] < lent[s]) done = 0;  // this stream still contains valid data, not exhausted
-        }
-        if (done) break;
-
-        // fill a multi-stream bptt batch
-        // * frame_mask: 0 indicates padded frames, 1 indicates valid frames
-        // * target: padded to batch_size
-        // * feat: first shifted to achieve targets delay; then padded to batch_size
-        for (int t = 0; t < batch_size; t++) {
-            for (int s = 0; s < num_stream; s++) {
-                // frame_mask & targets padding
-                if (curt[s] < lent[s]) {
-                    frame_mask(t * num_stream + s) = 1;
-                    target[t * num_stream + s] = targets[s][curt[s]];
-                } else {
-                    frame_mask(t * num_stream + s) = 0;
-                    target[t * num_stream + s] = targets[s][lent[s]-1];
-                }
-                // feat shifting & padding
-                if (curt[s] + targets_delay < lent[s]) {
-                    feat.Row(t * num_stream + s).CopyFromVec(feats[s].Row(curt[s]+targets_delay));
-                } else {
-                    feat.Row(t * num_stream + s).CopyFromVec(feats[s].Row(lent[s]-1));
-                }
+    CuMatrix<BaseFloat> nnet_out, obj_diff;
 
-                curt[s]++;
-            }
-        }
+    // Each minibatch contains 'batch_size' frames of each of the 'num_stream'
+    // streams (interleaved); when an utterance is finished, its stream gets the
+    // next one.  The features are shifted by 'targets_delay' frames, and the
+    // padding at the end of an utterance has zero weight (see StreamBatcher).
+    const StreamBatch *batch;
+    while ((batch = batch_reader.NextBatch()) != NULL) {
+        const Vector<BaseFloat> &frame_mask = batch->weights;
+        const Posterior &target = batch->targets;
+        const std::vector<int32> &new_utt_flags = batch->new_utt_flags;
+        KALDI_VLOG(3) << "Minibatch with " << batch->num_real_frames << " real frames out of "
+                      << batch->feats.NumRows();
 
         // for streams with new utterance, history states need to be reset
         nnet.ResetLstmStreams(new_utt_flags);
 
         // forward pass
-        nnet.Propagate(CuMatrix<BaseFloat>(feat), &nnet_out);
+        nnet.Propagate(CuMatrix<BaseFloat>(batch->feats), &nnet_out);
     
         // evaluate objective function we've chosen
         if (objective_function == "xent") {
@@ -271,10 +206,7 @@ int main(int argc, char *argv[]) {
         int frame_progress = frame_mask.Sum();
         total_frames += frame_progress;
 
-        int num_done_progress = 0;
-        for (int i =0; i < new_utt_flags.size(); i++) {
-            num_done_progress += new_utt_flags[i];
-        }
+        int num_done_progress = batch->num_new_utts;
         num_done += num_done_progress;
         
         // monitor the NN training
@@ -327,13 +259,14 @@ int main(int argc, char *argv[]) {
       nnet.Write(target_model_filename, binary);
     }
 
-    KALDI_LOG << "Done " << num_done << " files, " << num_no_tgt_mat
-              << " with no tgt_mats, " << num_other_error
+    KALDI_LOG << "Done " << num_done << " files, " << batch_reader.NumNoTargets()
+              << " with no tgt_mats, " << batch_reader.NumOtherErrors()
               << " with other errors. "
               << "[" << (crossvalidate?"CROSS-VALIDATION":"TRAINING")
               << ", " << (randomize?"RANDOMIZED":"NOT-RANDOMIZED") 
               << ", " << time.Elapsed()/60 << " min, fps" << total_frames/time.Elapsed()
               << "]";  
+    KALDI_LOG << batch_reader.Batcher().EfficiencyInfo();
 
     if (objective_function == "xent") {
       KALDI_LOG << xent.Report();
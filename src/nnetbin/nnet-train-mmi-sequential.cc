@@ -27,6 +27,7 @@
 #include "decoder/decodable-matrix.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
+#include "lat/sequence-training-reader.h"
 
 #include "nnet/nnet-trnopts.h"
 #include "nnet/nnet-component.h"
@@ -130,6 +131,11 @@ int main(int argc, char *argv[]) {
                 "Drop frames, where is zero den-posterior under numerator path "
                 "(ie. path not in lattice)");
 
+    int32 lattice_prefetch = 2;
+    po.Register("lattice-prefetch", &lattice_prefetch, "Number of utterances "
+                "whose lattices are read and prepared ahead, in a background "
+                "thread [ 0 == no thread ]");
+
     std::string use_gpu="yes";
     po.Register("use-gpu", &use_gpu, "yes|no|optional, only has effect if compiled with CUDA"); 
 
@@ -186,6 +192,9 @@ int main(int argc, char *argv[]) {
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     RandomAccessLatticeReader den_lat_reader(den_lat_rspecifier);
     RandomAccessInt32VectorReader num_ali_reader(num_ali_rspecifier);
+    SequenceTrainingReader training_reader(&feature_reader, &den_lat_reader,
+                                           &num_ali_reader, old_acoustic_scale,
+                                           max_frames, lattice_prefetch);
 
     CuMatrix<BaseFloat> feats, feats_transf, nnet_out, nnet_diff;
     Matrix<BaseFloat> nnet_out_h, nnet_diff_h;
@@ -202,8 +211,7 @@ int main(int argc, char *argv[]) {
     double time_now = 0;
     KALDI_LOG << "TRAINING STARTED";
 
-    int32 num_done = 0, num_no_num_ali = 0, num_no_den_lat = 0, 
-          num_other_error = 0, num_frm_drop = 0;
+    int32 num_done = 0, num_frm_drop = 0;
 
     kaldi::int64 total_frames = 0;
     double lat_like; // total likelihood of the lattice
@@ -211,64 +219,19 @@ int main(int argc, char *argv[]) {
     double total_mmi_obj = 0.0, mmi_obj = 0.0;
     double total_post_on_ali = 0.0, post_on_ali = 0.0;
 
-    // do per-utterance processing
-    for( ; !feature_reader.Done(); feature_reader.Next()) {
-      std::string utt = feature_reader.Key();
-      if (!den_lat_reader.HasKey(utt)) { 
-        KALDI_WARN << "Utterance " << utt << ": found no lattice.";
-        num_no_den_lat++;
-        continue;
-      }
-      if (!num_ali_reader.HasKey(utt)) { 
-        KALDI_WARN << "Utterance " << utt << ": found no reference alignment.";
-        num_no_num_ali++;
-        continue;
-      }
-
+    // do per-utterance processing; the utterances are checked, and the
+    // lattices are prepared, by the reader (possibly in a background thread)
+    SequenceTrainingUtterance *eg;
+    while ((eg = training_reader.Next()) != NULL) {
       // 1) get the features, numerator alignment
-      const Matrix<BaseFloat> &mat = feature_reader.Value();
-      const std::vector<int32> &num_ali = num_ali_reader.Value(utt);
-      // check for temporal length of numerator alignments
-      if ((int32)num_ali.size() != mat.NumRows()) {
-        KALDI_WARN << "Numerator alignment has wrong length "
-                   << num_ali.size() << " vs. "<< mat.NumRows();
-        num_other_error++;
-        continue;
-      }
-      if (mat.NumRows() > max_frames) {
-    KALDI_WARN << "Utterance " << utt << ": Skipped because it has " << mat.NumRows() << 
-      " frames, which is more than " << max_frames << ".";
-    num_other_error++;
-    continue;
-      }
-      
-      // 2) get the denominator lattice, preprocess
-      Lattice den_lat = den_lat_reader.Value(utt);
-      if (den_lat.Start() == -1) {
-        KALDI_WARN << "Empty lattice for utt " << utt;
-        num_other_error++;
-        continue;
-      }
-      if (old_acoustic_scale != 1.0) {
-        fst::ScaleLattice(fst::AcousticLatticeScale(old_acoustic_scale), &den_lat);
-      }
-      // optional sort it topologically
-      kaldi::uint64 props = den_lat.Properties(fst::kFstProperties, false);
-      if (!(props & fst::kTopSorted)) {
-        if (fst::TopSort(&den_lat) == false)
-          KALDI_ERR << "Cycles detected in lattice.";
-      }
-      // get the lattice length and times of states
-      vector<int32> state_times;
-      int32 max_time = kaldi::LatticeStateTimes(den_lat, &state_times);
-      // check for temporal length of denominator lattices
-      if (max_time != mat.NumRows()) {
-        KALDI_WARN << "Denominator lattice has wrong length "
-                   << max_time << " vs. " << mat.NumRows();
-        num_other_error++;
-        continue;
-      }
-     
+      const std::string &utt = eg->utt;
+      const Matrix<BaseFloat> &mat = eg->feats;
+      const std::vector<int32> &num_ali = eg->ali;
+      // 2) get the denominator lattice, topologically sorted, and the times
+      // of its states
+      Lattice &den_lat = eg->den_lat;
+      const std::vector<int32> &state_times = eg->state_times;
+
       // get actual dims for this utt and nnet
       int32 num_frames = mat.NumRows(),
           num_fea = mat.NumCols(),
@@ -433,9 +396,9 @@ int main(int argc, char *argv[]) {
               << (total_frames/time_now) << " frames per second.";
 
     KALDI_LOG << "Done " << num_done << " files, " 
-              << num_no_num_ali << " with no numerator alignments, " 
-              << num_no_den_lat << " with no denominator lattices, " 
-              << num_other_error << " with other errors.";
+              << training_reader.NumNoAli() << " with no numerator alignments, " 
+              << training_reader.NumNoDenLat() << " with no denominator lattices, " 
+              << training_reader.NumOtherError() << " with other errors.";
 
     KALDI_LOG << "Overall MMI-objective/frame is " 
               << std::setprecision(8) << (total_mmi_obj/total_frames) 
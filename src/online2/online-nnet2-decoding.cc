@@ -32,13 +32,36 @@ SingleUtteranceNnet2Decoder::SingleUtteranceNnet2Decoder(
     config_(config),
     feature_pipeline_(feature_pipeline),
     tmodel_(tmodel),
-    decodable_(model, tmodel, config.decodable_opts, feature_pipeline),
+    decodable_(model, tmodel, config.decodable_opts, feature_pipeline,
+               feature_pipeline->Vad()),
     decoder_(fst, config.decoder_opts) {
   decoder_.InitDecoding();
 }
 
 void SingleUtteranceNnet2Decoder::AdvanceDecoding() {
-  decoder_.AdvanceDecoding(&decodable_);
+  if (feature_pipeline_->Vad() == NULL || config_.silence_max_active <= 0 ||
+      config_.silence_max_active >= config_.decoder_opts.max_active) {
+    decoder_.AdvanceDecoding(&decodable_);
+    return;
+  }
+  // In runs of non-speech frames the decodable object repeats the same
+  // likelihoods, and we use a smaller max-active so the tokens are propagated
+  // through them quickly.  We don't drop the frames, so the frame indexes,
+  // and the traceback used in endpointing, are unaffected.
+  LatticeFasterDecoderConfig opts(config_.decoder_opts);
+  int32 num_frames_ready = decodable_.NumFramesReady();
+  while (decoder_.NumFramesDecoded() < num_frames_ready) {
+    int32 frame = decoder_.NumFramesDecoded(), end_frame;
+    opts.max_active = decodable_.GetMaxActive(frame,
+                                              config_.decoder_opts.max_active,
+                                              config_.silence_max_active,
+                                              &end_frame);
+    opts.min_active = std::min(config_.decoder_opts.min_active,
+                               opts.max_active);
+    decoder_.SetOptions(opts);
+    decoder_.AdvanceDecoding(&decodable_, end_frame - frame);
+  }
+  decoder_.SetOptions(config_.decoder_opts);
 }
 
 void SingleUtteranceNnet2Decoder::FinalizeDecoding() {
@@ -71,9 +94,12 @@ void SingleUtteranceNnet2Decoder::GetBestPath(bool end_of_utterance,
 
 bool SingleUtteranceNnet2Decoder::EndpointDetected(
     const OnlineEndpointConfig &config) {
-  return kaldi::EndpointDetected(config, tmodel_,
-                                 feature_pipeline_->FrameShiftInSeconds(),
-                                 decoder_);  
+  BaseFloat frame_shift = feature_pipeline_->FrameShiftInSeconds();
+  // if we subsample frames, the decoder sees frames at the lower rate.
+  const nnet2::DecodableNnet2OnlineOptions &opts = config_.decodable_opts;
+  if (!opts.repeat_frames)
+    frame_shift *= opts.frame_subsampling_factor;
+  return kaldi::EndpointDetected(config, tmodel_, frame_shift, decoder_);
 }
 
 
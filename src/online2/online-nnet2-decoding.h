@@ -51,12 +51,21 @@ struct OnlineNnet2DecodingConfig {
   
   LatticeFasterDecoderConfig decoder_opts;
   nnet2::DecodableNnet2OnlineOptions decodable_opts;
+
+  // The max-active we use in the decoder for frames in long regions of
+  // non-speech, if the feature pipeline does voice activity detection.
+  int32 silence_max_active;
   
-  OnlineNnet2DecodingConfig() {  decodable_opts.acoustic_scale = 0.1; }
+  OnlineNnet2DecodingConfig(): silence_max_active(1000) {
+    decodable_opts.acoustic_scale = 0.1;
+  }
   
   void Register(OptionsItf *opts) {
     decoder_opts.Register(opts);
     decodable_opts.Register(opts);
+    opts->Register("silence-max-active", &silence_max_active, "Decoder "
+                   "max-active for frames in long regions of non-speech, with "
+                   "--skip-silence=true (if <= 0, use --max-active)");
   }
 };
 
@@ -24,7 +24,8 @@ namespace kaldi {
 
 OnlineNnet2FeaturePipelineInfo::OnlineNnet2FeaturePipelineInfo(
     const OnlineNnet2FeaturePipelineConfig &config):
-    silence_weighting_config(config.silence_weighting_config) {
+    silence_weighting_config(config.silence_weighting_config),
+    skip_silence(config.skip_silence), vad_config(config.vad_config) {
   if (config.feature_type == "mfcc" || config.feature_type == "plp" ||
       config.feature_type == "fbank") {
     feature_type = config.feature_type;
@@ -110,6 +111,11 @@ OnlineNnet2FeaturePipeline::OnlineNnet2FeaturePipeline(
     ivector_feature_ = NULL;
     final_feature_ = feature_plus_optional_pitch_;
   }
+
+  if (info_.skip_silence)
+    vad_ = new OnlineVadEnergy(info_.vad_config, base_feature_);
+  else
+    vad_ = NULL;
   dim_ = final_feature_->Dim();
 }
 
@@ -150,6 +156,7 @@ OnlineNnet2FeaturePipeline::~OnlineNnet2FeaturePipeline() {
   // of the pointers below will be non-NULL.
   // Some of the online-feature pointers are just copies of other pointers,
   // and we do have to avoid deleting them in those cases.
+  delete vad_;
   if (final_feature_ != feature_plus_optional_pitch_)
     delete final_feature_;
   delete ivector_feature_;
@@ -31,6 +31,7 @@
 #include "feat/online-feature.h"
 #include "feat/pitch-functions.h"
 #include "online2/online-ivector-feature.h"
+#include "ivector/voice-activity-detection.h"
 
 namespace kaldi {
 /// @addtogroup  onlinefeat OnlineFeatureExtraction
@@ -85,8 +86,14 @@ struct OnlineNnet2FeaturePipelineConfig {
   // play with it in test time.
   OnlineSilenceWeightingConfig silence_weighting_config;
 
+  // If true, we run an energy-based voice activity detector on the base
+  // features, and the decoding skips the neural net computation for long
+  // regions of non-speech.
+  bool skip_silence;
+  OnlineVadEnergyConfig vad_config;
+
   OnlineNnet2FeaturePipelineConfig():
-      feature_type("mfcc"), add_pitch(false) { }
+      feature_type("mfcc"), add_pitch(false), skip_silence(false) { }
       
 
   void Register(OptionsItf *opts) {
@@ -107,6 +114,11 @@ struct OnlineNnet2FeaturePipelineConfig {
                    "Configuration file for online iVector extraction, "
                    "see class OnlineIvectorExtractionConfig in the code");
     silence_weighting_config.RegisterWithPrefix("ivector-silence-weighting", opts);
+    opts->Register("skip-silence", &skip_silence, "If true, use energy-based "
+                   "voice activity detection on the base features to find "
+                   "long regions of non-speech, and don't evaluate the neural "
+                   "net on them (see the --vad-* options)");
+    vad_config.Register(opts);
   }
 };
 
@@ -121,7 +133,7 @@ struct OnlineNnet2FeaturePipelineConfig {
 /// command line, as well as for easiter multithreaded operation.
 struct OnlineNnet2FeaturePipelineInfo {
   OnlineNnet2FeaturePipelineInfo():
-      feature_type("mfcc"), add_pitch(false) { }
+      feature_type("mfcc"), add_pitch(false), skip_silence(false) { }
 
   OnlineNnet2FeaturePipelineInfo(
       const OnlineNnet2FeaturePipelineConfig &config);
@@ -153,6 +165,10 @@ struct OnlineNnet2FeaturePipelineInfo {
   // it's the kind of thing you might want to play with directly
   // on the command line instead of inside sub-config-files.
   OnlineSilenceWeightingConfig silence_weighting_config;
+
+  // Config for the voice activity detection, if skip_silence is true.
+  bool skip_silence;
+  OnlineVadEnergyConfig vad_config;
   
   int32 IvectorDim() { return ivector_extractor_info.extractor.IvectorDim(); }
  private:
@@ -224,6 +240,12 @@ class OnlineNnet2FeaturePipeline: public OnlineFeatureInterface {
 
   BaseFloat FrameShiftInSeconds() const { return info_.FrameShiftInSeconds(); }
 
+  /// Returns the voice activity detection, if the info's skip_silence is true,
+  /// else NULL.  It is one-dimensional, and is zero for frames in long regions
+  /// of non-speech; see class OnlineVadEnergy.  It is computed from the base
+  /// features, so its frames are the same as those of this class.
+  OnlineFeatureInterface *Vad() { return vad_; }
+
   /// If you call InputFinished(), it tells the class you won't be providing any
   /// more waveform.  This will help flush out the last few frames of delta or
   /// LDA features, and finalize the pitch features (making them more
@@ -253,6 +275,8 @@ class OnlineNnet2FeaturePipeline: public OnlineFeatureInterface {
   // (OnlineAppendFeature) with ivector_feature_, if ivector_feature_ is used;
   // otherwise, points to the same address as feature_plus_optional_pitch_.
   OnlineFeatureInterface *final_feature_;
+
+  OnlineVadEnergy *vad_;  // Voice activity detection, if used.
  
   // we cache the feature dimension, to save time when calling Dim().
   int32 dim_;
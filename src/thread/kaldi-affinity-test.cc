@@ -0,0 +1,129 @@
+// thread/kaldi-affinity-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <set>
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "thread/kaldi-affinity.h"
+#include "thread/kaldi-thread.h"
+
+namespace kaldi {
+
+void TestTopology() {
+  int32 num_nodes = NumaNumNodes(), num_cpus = 0;
+  KALDI_ASSERT(num_nodes >= 1);
+  std::set<int32> all_cpus;
+  for (int32 node = 0; node < num_nodes; node++) {
+    std::vector<int32> cpus;
+    NumaNodeCpus(node, &cpus);
+    for (size_t i = 0; i < cpus.size(); i++) {
+      KALDI_ASSERT(NumaNodeOfCpu(cpus[i]) == node);
+      all_cpus.insert(cpus[i]);
+    }
+    num_cpus += cpus.size();
+  }
+  KALDI_ASSERT(static_cast<int32>(all_cpus.size()) == num_cpus);
+  KALDI_LOG << "Found " << num_nodes << " NUMA nodes with " << num_cpus
+            << " CPUs.";
+
+  // Each CPU should be used once before any is used twice.
+  const char *policies[] = { "compact", "scatter" };
+  for (int32 p = 0; p < 2; p++) {
+    std::set<int32> used;
+    for (int32 t = 0; t < num_cpus; t++) {
+      int32 cpu = ThreadAffinityCpu(policies[p], t);
+      KALDI_ASSERT(all_cpus.count(cpu) == 1);
+      used.insert(cpu);
+    }
+    KALDI_ASSERT(static_cast<int32>(used.size()) == num_cpus);
+  }
+  KALDI_ASSERT(ThreadAffinityCpu("none", 3) == -1);
+  if (num_nodes > 1) {  // Threads 0 and 1 should be on different nodes.
+    KALDI_ASSERT(NumaNodeOfCpu(ThreadAffinityCpu("scatter", 0)) !=
+                 NumaNodeOfCpu(ThreadAffinityCpu("scatter", 1)));
+  }
+  bool threw = false;
+  try {
+    CheckThreadAffinity("nonesuch");
+  } catch(...) {
+    threw = true;
+  }
+  KALDI_ASSERT(threw);
+}
+
+class PinnedThreadClass: public MultiThreadable {
+ public:
+  PinnedThreadClass(int32 *num_wrong, NumaTimingStats *stats):
+      num_wrong_(num_wrong), stats_(stats), wrong_(false) { }
+  void operator() () {
+    Timer timer;
+    int32 start_cpu = CurrentCpu(),
+        expected_cpu = ThreadAffinityCpu(g_thread_affinity, thread_id_);
+    // CurrentCpu() is -1 if not supported.
+    wrong_ = (start_cpu != -1 && start_cpu != expected_cpu);
+    stats_->AddTask(start_cpu, timer.Elapsed());
+  }
+  ~PinnedThreadClass() {
+    if (wrong_) (*num_wrong_)++;
+  }
+ private:
+  int32 *num_wrong_;
+  NumaTimingStats *stats_;
+  bool wrong_;
+};
+
+void TestPinnedThreads() {
+  std::string policies[] = { "compact", "scatter" };
+  for (int32 p = 0; p < 2; p++) {
+    g_thread_affinity = policies[p];
+    int32 num_wrong = 0;
+    NumaTimingStats stats;
+    {
+      PinnedThreadClass c(&num_wrong, &stats);
+      RunMultiThreaded(c);
+    }
+    KALDI_ASSERT(stats.NumTasks() == g_num_threads);
+    stats.Print("pinned threads");
+    // Pinning may legitimately fail, e.g. if we are restricted to a subset of
+    // the CPUs by a job scheduler; so this is only a warning.
+    if (num_wrong != 0)
+      KALDI_WARN << num_wrong << " threads were not running on the expected CPU";
+  }
+  g_thread_affinity = "none";
+}
+
+void TestNumaReplicated() {
+  std::vector<int32> v(1000, 7);
+  NumaReplicated<std::vector<int32> > replicas(v);
+  for (int32 i = 0; i < 10; i++) {
+    const std::vector<int32> &r = replicas.Get();
+    KALDI_ASSERT(r == v);
+    if (NumaNumNodes() == 1)
+      KALDI_ASSERT(&r == &v);
+  }
+}
+
+}  // end namespace kaldi.
+
+int main() {
+  using namespace kaldi;
+  TestTopology();
+  TestPinnedThreads();
+  TestNumaReplicated();
+  KALDI_LOG << "Test OK.";
+  return 0;
+}
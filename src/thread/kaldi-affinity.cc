@@ -0,0 +1,299 @@
+// thread/kaldi-affinity.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <sstream>
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#endif
+#include "thread/kaldi-affinity.h"
+
+namespace kaldi {
+
+std::string g_thread_affinity = "none";
+
+namespace {
+
+// The NUMA topology: for each node, the list of CPUs.  Read once.
+struct NumaTopology {
+  std::vector<std::vector<int32> > node_cpus;
+  std::vector<int32> cpu_to_node;  // Indexed by CPU.
+};
+
+// Parses a list like "0-3,8,10-11" as found in the cpulist files in sysfs.
+bool ParseCpuList(const std::string &str, std::vector<int32> *cpus) {
+  cpus->clear();
+  std::istringstream is(str);
+  std::string range;
+  while (std::getline(is, range, ',')) {
+    if (range.empty() || range == "\n") continue;
+    int32 begin, end;
+    char dash;
+    std::istringstream range_is(range);
+    if (!(range_is >> begin)) return false;
+    if (range_is >> dash) {
+      if (dash != '-' || !(range_is >> end)) return false;
+    } else {
+      end = begin;
+    }
+    if (begin < 0 || end < begin) return false;
+    for (int32 cpu = begin; cpu <= end; cpu++)
+      cpus->push_back(cpu);
+  }
+  return !cpus->empty();
+}
+
+// Reads the first line of a file; returns false if it could not be read.
+bool ReadFirstLine(const std::string &filename, std::string *line) {
+  std::ifstream is(filename.c_str());
+  if (!is.good()) return false;
+  std::getline(is, *line);
+  return !is.fail();
+}
+
+void ReadNumaTopology(NumaTopology *topo) {
+#if defined(__linux__)
+  // The CPUs this process may run on (e.g. inside a container, or under a job
+  // scheduler that uses cpusets); we never pin threads to any others.
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  bool have_allowed = (sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+
+  // The nodes are numbered as in sysfs, so NumaNodeOfCpu() agrees with the
+  // system; nodes that are not online, or that have no CPUs we may use (e.g.
+  // memory-only nodes), have empty CPU lists.
+  std::string line;
+  std::vector<int32> nodes;
+  if (ReadFirstLine("/sys/devices/system/node/online", &line) &&
+      !ParseCpuList(line, &nodes))
+    KALDI_WARN << "Could not parse the list of online NUMA nodes '" << line
+               << "'; ignoring NUMA topology.";
+  for (size_t i = 0; i < nodes.size(); i++) {
+    int32 node = nodes[i];
+    std::ostringstream filename;
+    filename << "/sys/devices/system/node/node" << node << "/cpulist";
+    std::vector<int32> cpus, usable_cpus;
+    if (!ReadFirstLine(filename.str(), &line)) continue;
+    if (!ParseCpuList(line, &cpus) && !line.empty()) {
+      KALDI_WARN << "Could not parse the CPU list '" << line << "' in "
+                 << filename.str() << "; ignoring this node.";
+      continue;
+    }
+    for (size_t j = 0; j < cpus.size(); j++)
+      if (!have_allowed ||
+          (cpus[j] < CPU_SETSIZE && CPU_ISSET(cpus[j], &allowed)))
+        usable_cpus.push_back(cpus[j]);
+    if (node >= static_cast<int32>(topo->node_cpus.size()))
+      topo->node_cpus.resize(node + 1);
+    topo->node_cpus[node] = usable_cpus;
+  }
+  int32 num_cpus = 0;
+  for (size_t node = 0; node < topo->node_cpus.size(); node++)
+    num_cpus += topo->node_cpus[node].size();
+  if (num_cpus == 0) {  // No topology information: a single node.
+    topo->node_cpus.clear();
+    topo->node_cpus.resize(1);
+    int32 max_cpus = static_cast<int32>(sysconf(_SC_NPROCESSORS_CONF));
+    for (int32 cpu = 0; cpu < max_cpus && cpu < CPU_SETSIZE; cpu++)
+      if (!have_allowed || CPU_ISSET(cpu, &allowed))
+        topo->node_cpus[0].push_back(cpu);
+  }
+#endif
+  if (topo->node_cpus.empty())
+    topo->node_cpus.resize(1);  // One node, CPUs unknown.
+  for (size_t node = 0; node < topo->node_cpus.size(); node++) {
+    const std::vector<int32> &cpus = topo->node_cpus[node];
+    for (size_t i = 0; i < cpus.size(); i++) {
+      if (cpus[i] >= static_cast<int32>(topo->cpu_to_node.size()))
+        topo->cpu_to_node.resize(cpus[i] + 1, 0);
+      topo->cpu_to_node[cpus[i]] = node;
+    }
+  }
+}
+
+Mutex topology_mutex;
+NumaTopology *topology = NULL;  // Never deleted.
+
+const NumaTopology &GetTopology() {
+  topology_mutex.Lock();
+  if (topology == NULL) {
+    topology = new NumaTopology;
+    ReadNumaTopology(topology);
+  }
+  topology_mutex.Unlock();
+  return *topology;
+}
+
+}  // namespace
+
+int32 NumaNumNodes() {
+  return GetTopology().node_cpus.size();
+}
+
+void NumaNodeCpus(int32 node, std::vector<int32> *cpus) {
+  const NumaTopology &topo = GetTopology();
+  KALDI_ASSERT(node >= 0 && node < static_cast<int32>(topo.node_cpus.size()));
+  *cpus = topo.node_cpus[node];
+}
+
+int32 CurrentCpu() {
+#if defined(__linux__)
+  return sched_getcpu();
+#else
+  return -1;
+#endif
+}
+
+int32 NumaNodeOfCpu(int32 cpu) {
+  const NumaTopology &topo = GetTopology();
+  if (cpu < 0 || cpu >= static_cast<int32>(topo.cpu_to_node.size()))
+    return 0;
+  return topo.cpu_to_node[cpu];
+}
+
+int32 CurrentNumaNode() {
+  return NumaNodeOfCpu(CurrentCpu());
+}
+
+void CheckThreadAffinity(const std::string &affinity) {
+  if (affinity != "none" && affinity != "compact" && affinity != "scatter")
+    KALDI_ERR << "Invalid thread-affinity '" << affinity
+              << "': expected none, compact or scatter.";
+}
+
+int32 ThreadAffinityCpu(const std::string &affinity, int32 thread_index) {
+  CheckThreadAffinity(affinity);
+  KALDI_ASSERT(thread_index >= 0);
+  if (affinity == "none") return -1;
+  const NumaTopology &topo = GetTopology();
+  int32 num_nodes = topo.node_cpus.size(), num_cpus = 0;
+  for (int32 node = 0; node < num_nodes; node++)
+    num_cpus += topo.node_cpus[node].size();
+  if (num_cpus == 0) return -1;
+  if (affinity == "compact") {
+    int32 index = thread_index % num_cpus;
+    for (int32 node = 0; node < num_nodes; node++) {
+      int32 size = topo.node_cpus[node].size();
+      if (index < size) return topo.node_cpus[node][index];
+      index -= size;
+    }
+    return -1;  // Not reached.
+  } else {  // "scatter": take CPUs from the nodes in turn, skipping nodes that
+    // have run out of CPUs (if the nodes are of different sizes).
+    int32 index = thread_index % num_cpus;
+    for (int32 round = 0; ; round++) {
+      for (int32 node = 0; node < num_nodes; node++) {
+        if (round < static_cast<int32>(topo.node_cpus[node].size())) {
+          if (index == 0) return topo.node_cpus[node][round];
+          index--;
+        }
+      }
+    }
+  }
+}
+
+bool SetThreadAffinity(pthread_t thread, const std::vector<int32> &cpus) {
+  static bool warned = false;
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (size_t i = 0; i < cpus.size(); i++)
+    if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE)
+      CPU_SET(cpus[i], &cpu_set);
+  int ret = pthread_setaffinity_np(thread, sizeof(cpu_set), &cpu_set);
+  if (ret == 0) return true;
+  if (!warned) {
+    const char *c = strerror(ret);
+    KALDI_WARN << "Could not set thread affinity, error was: "
+               << (c ? c : "[NULL]");
+    warned = true;
+  }
+  return false;
+#else
+  if (!warned) {
+    KALDI_WARN << "Setting thread affinity is not supported on this system.";
+    warned = true;
+  }
+  return false;
+#endif
+}
+
+bool SetThreadAttrAffinity(pthread_attr_t *attr,
+                           const std::vector<int32> &cpus) {
+  static bool warned = false;
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (size_t i = 0; i < cpus.size(); i++)
+    if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE)
+      CPU_SET(cpus[i], &cpu_set);
+  int ret = pthread_attr_setaffinity_np(attr, sizeof(cpu_set), &cpu_set);
+  if (ret == 0) return true;
+  if (!warned) {
+    const char *c = strerror(ret);
+    KALDI_WARN << "Could not set thread affinity, error was: "
+               << (c ? c : "[NULL]");
+    warned = true;
+  }
+  return false;
+#else
+  if (!warned) {
+    KALDI_WARN << "Setting thread affinity is not supported on this system.";
+    warned = true;
+  }
+  return false;
+#endif
+}
+
+void ApplyThreadAffinity(pthread_attr_t *attr, const std::string &affinity,
+                         int32 thread_index) {
+  int32 cpu = ThreadAffinityCpu(affinity, thread_index);
+  if (cpu >= 0) {
+    KALDI_VLOG(3) << "Pinning thread " << thread_index << " to CPU " << cpu;
+    SetThreadAttrAffinity(attr, std::vector<int32>(1, cpu));
+  }
+}
+
+
+void NumaTimingStats::AddTask(int32 start_cpu, double elapsed_seconds) {
+  int32 start_node = NumaNodeOfCpu(start_cpu),
+      end_node = CurrentNumaNode();
+  mutex_.Lock();
+  if (start_node >= static_cast<int32>(node_seconds_.size())) {
+    node_seconds_.resize(start_node + 1, 0.0);
+    node_tasks_.resize(start_node + 1, 0);
+  }
+  node_seconds_[start_node] += elapsed_seconds;
+  node_tasks_[start_node]++;
+  num_tasks_++;
+  if (end_node != start_node) num_migrated_++;
+  mutex_.Unlock();
+}
+
+void NumaTimingStats::Print(const std::string &name) const {
+  if (num_tasks_ == 0) return;
+  std::ostringstream os;
+  for (size_t node = 0; node < node_seconds_.size(); node++)
+    os << " node " << node << ": " << node_tasks_[node] << " tasks, "
+       << node_seconds_[node] << " sec;";
+  KALDI_LOG << "Timing for " << name << ", by NUMA node:" << os.str()
+            << " " << num_migrated_ << " of " << num_tasks_
+            << " tasks moved to another node while running.";
+}
+
+}  // namespace kaldi
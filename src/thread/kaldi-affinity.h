@@ -0,0 +1,206 @@
+// thread/kaldi-affinity.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_THREAD_KALDI_AFFINITY_H_
+#define KALDI_THREAD_KALDI_AFFINITY_H_ 1
+
+#include <pthread.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "thread/kaldi-mutex.h"
+
+// This header contains utilities for controlling which CPUs (cores) the
+// threads of multi-threaded programs run on, and for working with machines
+// that have more than one NUMA node (typically, one node per CPU socket; memory
+// attached to another node is slower to access).  The topology is read from
+// /sys/devices/system/node on Linux; we don't depend on libnuma.  On other
+// systems, or if the information is not available, we behave as if there is a
+// single node and pinning threads does nothing.
+//
+// The thread-affinity policies are given as strings:
+//   "none"    : don't pin threads (the default).
+//   "compact" : pin thread i to the i'th CPU, numbering the CPUs node by node,
+//               so that threads share a node as far as possible.
+//   "scatter" : pin threads to CPUs of the nodes in turn, so that the threads
+//               are spread evenly over the nodes.
+
+namespace kaldi {
+
+/// The thread-affinity policy used by MultiThreader (and hence
+/// RunMultiThreaded()).  Programs that register --num-threads with
+/// g_num_threads may register --thread-affinity with this.
+extern std::string g_thread_affinity;
+
+/// Returns the number of NUMA nodes (at least 1).  The nodes are numbered as
+/// by the system, so some may have no CPUs (e.g. nodes that are not online, or
+/// that only have memory).
+int32 NumaNumNodes();
+
+/// Returns the CPUs that belong to this NUMA node and that this process is
+/// allowed to run on (e.g. in a container or a cpuset, this may be a subset of
+/// the node's CPUs, or empty).  The thread-affinity policies only use these
+/// CPUs.
+void NumaNodeCpus(int32 node, std::vector<int32> *cpus);
+
+/// Returns the NUMA node of the CPU the calling thread is running on (0 if
+/// unknown).
+int32 CurrentNumaNode();
+
+/// Returns the CPU the calling thread is running on, or -1 if unknown.
+int32 CurrentCpu();
+
+/// Returns the NUMA node that CPU "cpu" belongs to (0 if unknown).
+int32 NumaNodeOfCpu(int32 cpu);
+
+/// Checks that "affinity" is a valid policy ("none", "compact" or "scatter");
+/// throws if not.
+void CheckThreadAffinity(const std::string &affinity);
+
+/// Returns the CPU that the thread with index "thread_index" should be pinned
+/// to, under the given policy; or -1 if it should not be pinned.
+int32 ThreadAffinityCpu(const std::string &affinity, int32 thread_index);
+
+/// Restricts the thread to run on the given CPUs.  Returns false (and warns,
+/// the first time) on failure, e.g. if the system does not support it.
+bool SetThreadAffinity(pthread_t thread, const std::vector<int32> &cpus);
+
+/// Sets the CPUs in the attributes of a thread that has not been created yet,
+/// so it runs only on those CPUs from the start.  Returns false (and warns,
+/// the first time) on failure, as SetThreadAffinity().
+bool SetThreadAttrAffinity(pthread_attr_t *attr, const std::vector<int32> &cpus);
+
+/// Sets the attributes of a thread that has not been created yet so that it
+/// will be pinned according to the policy, if the policy is not "none".
+void ApplyThreadAffinity(pthread_attr_t *attr, const std::string &affinity,
+                         int32 thread_index);
+
+
+/// NumaTimingStats accumulates the time spent in tasks run by different
+/// threads, broken down by the NUMA node the task started on; it also counts
+/// tasks during which the thread moved to a different node, since those will
+/// have had to access memory remotely.  It is thread-safe.
+class NumaTimingStats {
+ public:
+  NumaTimingStats(): num_tasks_(0), num_migrated_(0) { }
+
+  /// Called at the end of a task; "start_cpu" is the value of CurrentCpu()
+  /// at the start of the task.
+  void AddTask(int32 start_cpu, double elapsed_seconds);
+
+  int64 NumTasks() const { return num_tasks_; }
+
+  /// Prints the stats (with KALDI_LOG); "name" says what was timed.
+  void Print(const std::string &name) const;
+
+ private:
+  Mutex mutex_;
+  int64 num_tasks_;
+  int64 num_migrated_;  // Number of tasks that changed NUMA node.
+  std::vector<double> node_seconds_;  // Time spent, indexed by NUMA node.
+  std::vector<int64> node_tasks_;  // Number of tasks, indexed by NUMA node.
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NumaTimingStats);
+};
+
+
+/// NumaReplicated keeps one copy of a read-only object (e.g. a model) per NUMA
+/// node, so that threads running on each node read memory local to that node.
+/// Each copy is made by a thread that pins itself to the node in question
+/// before copying, so that (with the usual first-touch memory policy) its
+/// memory is allocated on that node.  T must have a copy constructor that makes
+/// a deep copy.  If there is only one node, no copies are made and Get()
+/// returns the original object, as it does on nodes we have no copy for.
+///
+/// At present this is only used for the model in ivector-extractor-acc-stats.
+/// It is not used in the multi-threaded decoders (for HCLG and the acoustic
+/// model), because they create the decoder and the decodable for an utterance
+/// in the main thread, before we know which thread (and hence node) will run
+/// the task; and because the copy constructors of the FST types share the
+/// data rather than copying it.
+template<class T>
+class NumaReplicated {
+ public:
+  /// Does not take ownership of "t", which must outlive this object.  If
+  /// "replicate" is false, no copies are made (this is convenient when the
+  /// threads are not pinned, since then they may move between nodes anyway).
+  explicit NumaReplicated(const T &t, bool replicate = true);
+
+  /// Returns the copy for the node the calling thread is running on.
+  const T &Get() const {
+    if (replicas_.size() <= 1) return *original_;
+    int32 node = CurrentNumaNode();
+    if (node < 0 || node >= static_cast<int32>(replicas_.size()) ||
+        replicas_[node] == NULL)
+      return *original_;
+    return *(replicas_[node]);
+  }
+
+  ~NumaReplicated() {
+    for (size_t i = 0; i < replicas_.size(); i++)
+      delete replicas_[i];
+  }
+
+ private:
+  struct CopyArgs {
+    const T *original;
+    std::vector<int32> cpus;  // The CPUs of the node.
+    T *copy;
+  };
+  static void *MakeCopy(void *input) {
+    CopyArgs *args = static_cast<CopyArgs*>(input);
+    // Pin this thread before copying, so the copy is allocated on the node.
+    // If pinning fails, the copy may just not be local.
+    SetThreadAffinity(pthread_self(), args->cpus);
+    args->copy = new T(*(args->original));
+    return NULL;
+  }
+  const T *original_;
+  std::vector<T*> replicas_;  // Indexed by node; empty if there is one node.
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NumaReplicated);
+};
+
+template<class T>
+NumaReplicated<T>::NumaReplicated(const T &t, bool replicate):
+    original_(&t) {
+  int32 num_nodes = NumaNumNodes();
+  if (!replicate || num_nodes <= 1) return;
+  replicas_.resize(num_nodes, NULL);
+  for (int32 node = 0; node < num_nodes; node++) {
+    CopyArgs args;
+    args.original = original_;
+    args.copy = NULL;
+    NumaNodeCpus(node, &(args.cpus));
+    if (args.cpus.empty()) continue;  // No thread will run on this node.
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_t thread;
+    int32 ret;
+    if ((ret = pthread_create(&thread, &attr, MakeCopy, &args))) {
+      const char *c = strerror(ret);
+      KALDI_ERR << "Error creating thread, errno was: " << (c ? c : "[NULL]");
+    }
+    if (pthread_join(thread, NULL))
+      KALDI_ERR << "Error rejoining thread.";
+    pthread_attr_destroy(&attr);
+    replicas_[node] = args.copy;
+  }
+}
+
+}  // namespace kaldi
+
+#endif  // KALDI_THREAD_KALDI_AFFINITY_H_
@@ -0,0 +1,115 @@
+// thread/kaldi-background-reader-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "thread/kaldi-background-reader.h"
+
+namespace kaldi {
+
+// Outputs the items 0, 1, ..., num_items - 1 as vectors [ i i*i ], and
+// throws when it gets to 'error_item' (if >= 0).  The previous contents of the
+// item are checked, to see that the items are reused and not copied.
+class TestSource: public BackgroundReader<std::vector<int32> >::Source {
+ public:
+  TestSource(int32 num_items, int32 error_item):
+      num_items_(num_items), error_item_(error_item), next_(0) { }
+  virtual bool Read(std::vector<int32> *item) {
+    KALDI_ASSERT(item->empty() ||
+                 (item->size() == 2 && (*item)[0] < next_));
+    if (next_ == error_item_)
+      KALDI_ERR << "Error at item " << next_;
+    if (next_ == num_items_) return false;
+    int32 spin = Rand() % 1000;
+    for (int32 i = 0; i < spin; i++);
+    item->resize(2);
+    (*item)[0] = next_;
+    (*item)[1] = next_ * next_;
+    next_++;
+    return true;
+  }
+  int32 NumRead() const { return next_; }
+ private:
+  int32 num_items_;
+  int32 error_item_;
+  int32 next_;
+};
+
+// Reads everything, and returns the items (and whether there was an error).
+bool ReadAll(int32 num_items, int32 error_item, int32 num_prefetch,
+             std::vector<std::vector<int32> > *output) {
+  TestSource source(num_items, error_item);
+  BackgroundReader<std::vector<int32> > reader(&source, num_prefetch);
+  output->clear();
+  try {
+    std::vector<int32> *item;
+    while ((item = reader.Next()) != NULL)
+      output->push_back(*item);
+  } catch(const std::exception &e) {
+    return false;
+  }
+  // Next() keeps returning NULL at the end.
+  KALDI_ASSERT(reader.Next() == NULL);
+  return true;
+}
+
+void TestBackgroundReader() {
+  int32 num_items = Rand() % 100, num_prefetch = 1 + Rand() % 5;
+  std::vector<std::vector<int32> > serial, background;
+  KALDI_ASSERT(ReadAll(num_items, -1, 0, &serial));
+  KALDI_ASSERT(ReadAll(num_items, -1, num_prefetch, &background));
+  KALDI_ASSERT(serial.size() == static_cast<size_t>(num_items));
+  KALDI_ASSERT(background == serial);
+}
+
+void TestBackgroundReaderError() {
+  int32 num_items = 1 + Rand() % 100, error_item = Rand() % num_items,
+      num_prefetch = Rand() % 5;
+  std::vector<std::vector<int32> > output;
+  KALDI_ASSERT(!ReadAll(num_items, error_item, num_prefetch, &output));
+  // the items read before the error are still returned, in order.
+  KALDI_ASSERT(output.size() == static_cast<size_t>(error_item));
+  for (int32 i = 0; i < error_item; i++)
+    KALDI_ASSERT(output[i][0] == i);
+}
+
+void TestBackgroundReaderEarlyExit() {
+  // destroying the reader before the end stops the background thread, which
+  // has read at most 'num_prefetch' items ahead.
+  int32 num_items = 10 + Rand() % 100, num_read = Rand() % 10,
+      num_prefetch = 1 + Rand() % 5;
+  TestSource source(num_items, -1);
+  {
+    BackgroundReader<std::vector<int32> > reader(&source, num_prefetch);
+    for (int32 i = 0; i < num_read; i++)
+      KALDI_ASSERT((*reader.Next())[0] == i);
+  }
+  KALDI_ASSERT(source.NumRead() >= num_read &&
+               source.NumRead() <= num_read + num_prefetch);
+}
+
+}  // end namespace kaldi.
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++) {
+    TestBackgroundReader();
+    TestBackgroundReaderError();
+    TestBackgroundReaderEarlyExit();
+  }
+  KALDI_LOG << "Test OK.";
+  return 0;
+}
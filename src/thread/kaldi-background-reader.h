@@ -0,0 +1,141 @@
+// thread/kaldi-background-reader.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_THREAD_KALDI_BACKGROUND_READER_H_
+#define KALDI_THREAD_KALDI_BACKGROUND_READER_H_ 1
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "thread/kaldi-queue.h"
+#include "thread/kaldi-thread.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+/**
+   BackgroundReader reads a sequence of items from a Source, optionally in a
+   background thread that works up to 'num_prefetch' items ahead of the
+   caller, so that reading and preparing the data overlaps with the work done
+   on the current item.  The items are allocated once and reused: the caller
+   gets a pointer to an item from Next(), and it is given back to the
+   background thread on the next call to Next().  If 'num_prefetch' is 0,
+   Next() simply calls the Source; the items come out in the same order either
+   way.
+
+   Exceptions thrown by the Source in the background thread are passed on to
+   the caller: Next() throws (via KALDI_ERR) after the items read before the
+   error have been returned.
+*/
+template<class Item>
+class BackgroundReader {
+ public:
+  class Source {
+   public:
+    /// Reads the next item into *item, which may contain an earlier item;
+    /// returns false at the end of the input.  If we prefetch, this is called
+    /// in the background thread.
+    virtual bool Read(Item *item) = 0;
+    virtual ~Source() { }
+  };
+
+  /// The background thread is started by the first call to Next(), so
+  /// 'source' may be an object that is still being constructed.
+  BackgroundReader(Source *source, int32 num_prefetch):
+      source_(source), num_prefetch_(num_prefetch), current_(NULL),
+      free_items_(std::max(num_prefetch + 1, 1)),
+      full_items_(std::max(num_prefetch, 1)), thread_(NULL) {
+    KALDI_ASSERT(num_prefetch >= 0);
+    // one item is used by the caller, the others are being prefetched.
+    items_.resize(num_prefetch + 1);
+    for (size_t i = 0; i < items_.size(); i++)
+      items_[i] = new Item;
+  }
+
+  ~BackgroundReader() {
+    if (thread_ != NULL) {
+      // stop the thread, in case we did not read everything.
+      free_items_.Abort();
+      full_items_.Abort();
+      delete thread_;
+    }
+    DeletePointers(&items_);
+  }
+
+  /// Returns the next item, or NULL when there are no more.  The item may be
+  /// modified, and remains valid until the next call.
+  Item *Next() {
+    if (num_prefetch_ == 0) {
+      current_ = items_[0];
+      return (source_->Read(current_) ? current_ : NULL);
+    }
+    if (thread_ == NULL) {
+      for (size_t i = 0; i < items_.size(); i++)
+        free_items_.Push(items_[i]);
+      // this starts the thread.
+      thread_ = new MultiThreader<Worker>(1, Worker(this));
+    }
+    // give the previous item back to the background thread.
+    if (current_ != NULL) free_items_.Push(current_);
+    if (!full_items_.Pop(&current_)) {
+      current_ = NULL;
+      if (!error_.empty())
+        KALDI_ERR << "Error reading in the background thread: " << error_;
+      return NULL;
+    }
+    return current_;
+  }
+
+ private:
+  class Worker: public MultiThreadable {
+   public:
+    explicit Worker(BackgroundReader *reader): reader_(reader) { }
+    void operator() () { reader_->Run(); }
+   private:
+    BackgroundReader *reader_;
+  };
+
+  /// The function of the background thread.
+  void Run() {
+    try {
+      Item *item;
+      while (free_items_.Pop(&item)) {
+        if (!source_->Read(item)) break;
+        if (!full_items_.Push(item)) return;  // aborted.
+      }
+    } catch(const std::exception &e) {
+      error_ = e.what();
+    }
+    full_items_.Close();
+  }
+
+  Source *source_;
+  int32 num_prefetch_;
+  std::vector<Item*> items_;
+  Item *current_;  // The item last returned by Next().
+  BoundedQueue<Item*> free_items_;
+  BoundedQueue<Item*> full_items_;
+  MultiThreader<Worker> *thread_;  // NULL until the thread is started.
+  std::string error_;  // The error message if the background thread failed.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(BackgroundReader);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_THREAD_KALDI_BACKGROUND_READER_H_
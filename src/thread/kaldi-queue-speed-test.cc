@@ -0,0 +1,174 @@
+// thread/kaldi-queue-speed-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <deque>
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-queue.h"
+#include "thread/kaldi-semaphore.h"
+
+// This program compares the producer/consumer throughput of BoundedQueue with
+// that of a buffer guarded in the way ThreadSynchronizer (in
+// online2/online-nnet2-decoding-threaded.h) guards the buffers between the
+// threads of the threaded online decoder: a mutex, plus semaphores on which a
+// thread that found the buffer full (or empty) waits for the other thread.
+// ThreadSynchronizer itself is in online2/, which depends on the thread
+// library, so the same protocol is re-implemented here.
+
+namespace kaldi {
+
+class SemaphoreBuffer {
+ public:
+  explicit SemaphoreBuffer(size_t capacity):
+      capacity_(capacity), producer_waiting_(false), consumer_waiting_(false),
+      done_(false) {
+    producer_semaphore_.Signal();
+    consumer_semaphore_.Signal();
+  }
+  void Push(int32 i) {
+    while (true) {
+      producer_semaphore_.Wait();
+      mutex_.Lock();
+      if (buffer_.size() < capacity_) {
+        buffer_.push_back(i);
+        UnlockSuccess(true);
+        return;
+      }
+      producer_waiting_ = true;  // UnlockFailure().
+      mutex_.Unlock();
+    }
+  }
+  bool Pop(int32 *i) {
+    while (true) {
+      consumer_semaphore_.Wait();
+      mutex_.Lock();
+      if (!buffer_.empty()) {
+        *i = buffer_.front();
+        buffer_.pop_front();
+        UnlockSuccess(false);
+        return true;
+      } else if (done_) {
+        UnlockSuccess(false);
+        return false;
+      }
+      consumer_waiting_ = true;  // UnlockFailure().
+      mutex_.Unlock();
+    }
+  }
+  void Close() {
+    producer_semaphore_.Wait();
+    mutex_.Lock();
+    done_ = true;
+    UnlockSuccess(true);
+  }
+ private:
+  void UnlockSuccess(bool producer) {
+    if (producer) {
+      producer_semaphore_.Signal();
+      if (consumer_waiting_) {
+        consumer_semaphore_.Signal();
+        consumer_waiting_ = false;
+      }
+    } else {
+      consumer_semaphore_.Signal();
+      if (producer_waiting_) {
+        producer_semaphore_.Signal();
+        producer_waiting_ = false;
+      }
+    }
+    mutex_.Unlock();
+  }
+  size_t capacity_;
+  std::deque<int32> buffer_;
+  Mutex mutex_;
+  Semaphore producer_semaphore_;
+  Semaphore consumer_semaphore_;
+  bool producer_waiting_;
+  bool consumer_waiting_;
+  bool done_;
+};
+
+template<class Q>
+struct SpeedTestInfo {
+  Q *queue;
+  int32 num_items;
+};
+
+template<class Q>
+static void *Produce(void *input) {
+  SpeedTestInfo<Q> *info = static_cast<SpeedTestInfo<Q>*>(input);
+  for (int32 i = 0; i < info->num_items; i++)
+    info->queue->Push(i);
+  return NULL;
+}
+
+template<class Q>
+static void *Consume(void *input) {
+  SpeedTestInfo<Q> *info = static_cast<SpeedTestInfo<Q>*>(input);
+  int32 i;
+  while (info->queue->Pop(&i));
+  return NULL;
+}
+
+// Returns the number of items per second that went through the queue.
+template<class Q>
+static double TestThroughput(Q *queue, int32 num_producers,
+                             int32 num_consumers, int32 num_items) {
+  Timer timer;
+  SpeedTestInfo<Q> info = { queue, num_items / num_producers };
+  std::vector<pthread_t> producers(num_producers), consumers(num_consumers);
+  for (int32 i = 0; i < num_consumers; i++)
+    KALDI_ASSERT(pthread_create(&(consumers[i]), NULL, Consume<Q>, &info) == 0);
+  for (int32 i = 0; i < num_producers; i++)
+    KALDI_ASSERT(pthread_create(&(producers[i]), NULL, Produce<Q>, &info) == 0);
+  for (int32 i = 0; i < num_producers; i++)
+    KALDI_ASSERT(pthread_join(producers[i], NULL) == 0);
+  queue->Close();
+  for (int32 i = 0; i < num_consumers; i++)
+    KALDI_ASSERT(pthread_join(consumers[i], NULL) == 0);
+  return info.num_items * num_producers / timer.Elapsed();
+}
+
+void TestQueueSpeed() {
+  int32 num_items = 200000;
+  int32 capacities[] = { 4, 64, 1024 };
+  for (int32 c = 0; c < 3; c++) {
+    int32 capacity = capacities[c];
+    SemaphoreBuffer buffer(capacity);
+    BoundedQueue<int32> queue(capacity);
+    double semaphore_speed = TestThroughput(&buffer, 1, 1, num_items),
+        queue_speed = TestThroughput(&queue, 1, 1, num_items);
+    KALDI_LOG << "Capacity " << capacity << ", 1 producer and 1 consumer: "
+              << "semaphore-guarded buffer: " << semaphore_speed
+              << " items/sec; BoundedQueue: " << queue_speed << " items/sec";
+    for (int32 n = 2; n <= 4; n *= 2) {
+      BoundedQueue<int32> queue2(capacity);
+      KALDI_LOG << "Capacity " << capacity << ", " << n << " producers and "
+                << n << " consumers: BoundedQueue: "
+                << TestThroughput(&queue2, n, n, num_items) << " items/sec";
+    }
+  }
+}
+
+}  // end namespace kaldi.
+
+int main() {
+  kaldi::TestQueueSpeed();
+  KALDI_LOG << "Test OK.";
+  return 0;
+}
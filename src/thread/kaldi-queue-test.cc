@@ -0,0 +1,171 @@
+// thread/kaldi-queue-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "thread/kaldi-queue.h"
+#include "thread/kaldi-task-pipeline.h"
+
+namespace kaldi {
+
+void TestLockFreeQueueSerial() {
+  int32 capacity = 1 + Rand() % 20;
+  LockFreeQueue<int32> queue(capacity);
+  KALDI_ASSERT(queue.Capacity() >= capacity &&
+               queue.Capacity() <= std::max(2 * capacity - 1, 2));
+  int32 n = queue.Capacity(), x = 0;
+  for (int32 lap = 0; lap < 3; lap++) {
+    KALDI_ASSERT(!queue.TryPop(&x));
+    for (int32 i = 0; i < n; i++)
+      KALDI_ASSERT(queue.TryPush(i + lap));
+    KALDI_ASSERT(!queue.TryPush(-1));
+    for (int32 i = 0; i < n; i++)
+      KALDI_ASSERT(queue.TryPop(&x) && x == i + lap);
+  }
+}
+
+struct QueueTestInfo {
+  BoundedQueue<int32> *queue;
+  int32 num_items;  // Number of items each producer pushes.
+  int64 sum;  // Sum of items popped by a consumer.
+  int32 count;  // Number of items popped by a consumer.
+};
+
+static void *Produce(void *input) {
+  QueueTestInfo *info = static_cast<QueueTestInfo*>(input);
+  for (int32 i = 0; i < info->num_items; i++)
+    KALDI_ASSERT(info->queue->Push(i));
+  return NULL;
+}
+
+static void *Consume(void *input) {
+  QueueTestInfo *info = static_cast<QueueTestInfo*>(input);
+  int32 x = 0;
+  while (info->queue->Pop(&x)) {
+    info->sum += x;
+    info->count++;
+  }
+  return NULL;
+}
+
+void TestBoundedQueue() {
+  int32 num_producers = 1 + Rand() % 4, num_consumers = 1 + Rand() % 4,
+      num_items = Rand() % 10000;
+  BoundedQueue<int32> queue(1 + Rand() % 10);
+  std::vector<QueueTestInfo> producers(num_producers),
+      consumers(num_consumers);
+  std::vector<pthread_t> producer_threads(num_producers),
+      consumer_threads(num_consumers);
+  for (int32 i = 0; i < num_consumers; i++) {
+    QueueTestInfo info = { &queue, num_items, 0, 0 };
+    consumers[i] = info;
+    KALDI_ASSERT(pthread_create(&(consumer_threads[i]), NULL, Consume,
+                                &(consumers[i])) == 0);
+  }
+  for (int32 i = 0; i < num_producers; i++) {
+    QueueTestInfo info = { &queue, num_items, 0, 0 };
+    producers[i] = info;
+    KALDI_ASSERT(pthread_create(&(producer_threads[i]), NULL, Produce,
+                                &(producers[i])) == 0);
+  }
+  for (int32 i = 0; i < num_producers; i++)
+    KALDI_ASSERT(pthread_join(producer_threads[i], NULL) == 0);
+  queue.Close();
+  int64 sum = 0, count = 0;
+  for (int32 i = 0; i < num_consumers; i++) {
+    KALDI_ASSERT(pthread_join(consumer_threads[i], NULL) == 0);
+    sum += consumers[i].sum;
+    count += consumers[i].count;
+  }
+  KALDI_ASSERT(count == static_cast<int64>(num_items) * num_producers);
+  KALDI_ASSERT(sum == num_producers * (num_items * (num_items - 1LL)) / 2);
+}
+
+void TestBoundedQueueAbort() {
+  BoundedQueue<int32> queue(4);
+  QueueTestInfo info = { &queue, 0, 0, 0 };
+  pthread_t thread;
+  KALDI_ASSERT(pthread_create(&thread, NULL, Consume, &info) == 0);
+  queue.Abort();  // the consumer, which may be waiting, should now return.
+  KALDI_ASSERT(pthread_join(thread, NULL) == 0);
+  KALDI_ASSERT(info.count == 0);
+  KALDI_ASSERT(!queue.Push(1));
+}
+
+class MyPipelineTask {  // squares an integer and outputs it.
+ public:
+  MyPipelineTask(int32 i, std::vector<int32> *vec):
+      done_(false), i_(i), vec_(vec) { }
+
+  void operator() () {
+    int32 spin = Rand() % 10000;
+    for (int32 i = 0; i < spin; i++);
+    i_ = i_ * i_;
+    done_ = true;
+  }
+  ~MyPipelineTask() {
+    if (done_) vec_->push_back(i_);
+  }
+ private:
+  bool done_;
+  int32 i_;
+  std::vector<int32> *vec_;
+};
+
+void TestTaskPipeline() {
+  TaskSequencerConfig config;
+  config.num_threads = 1 + Rand() % 8;
+  if (Rand() % 2 == 1)
+    config.num_threads_total = config.num_threads + Rand() % config.num_threads;
+  int32 num_tasks = Rand() % 1000;
+  std::vector<int32> output;
+  {
+    TaskPipeline<MyPipelineTask> pipeline(config);
+    for (int32 i = 0; i < num_tasks; i++)
+      pipeline.Run(new MyPipelineTask(i, &output));
+  }
+  KALDI_ASSERT(output.size() == num_tasks);
+  for (int32 i = 0; i < num_tasks; i++)
+    KALDI_ASSERT(output[i] == i * i);
+
+  // Check that after Abort(), the remaining tasks are destroyed but not run,
+  // and that the ones that were run are still output in order.
+  output.clear();
+  {
+    TaskPipeline<MyPipelineTask> pipeline(config);
+    for (int32 i = 0; i < num_tasks; i++) {
+      if (i == num_tasks / 2) pipeline.Abort();
+      pipeline.Run(new MyPipelineTask(i, &output));
+    }
+  }
+  KALDI_ASSERT(output.size() <= num_tasks);
+  for (size_t i = 0; i + 1 < output.size(); i++)
+    KALDI_ASSERT(output[i] < output[i+1]);
+}
+
+}  // end namespace kaldi.
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++) {
+    TestLockFreeQueueSerial();
+    TestBoundedQueue();
+    TestBoundedQueueAbort();
+    TestTaskPipeline();
+  }
+  KALDI_LOG << "Test OK.";
+  return 0;
+}
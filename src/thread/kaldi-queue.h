@@ -0,0 +1,251 @@
+// thread/kaldi-queue.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_THREAD_KALDI_QUEUE_H_
+#define KALDI_THREAD_KALDI_QUEUE_H_ 1
+
+#include <pthread.h>
+#include <sched.h>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "thread/kaldi-semaphore.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace kaldi {
+
+// Atomic operations needed by LockFreeQueue.  KaldiCompareAndSwap sets *ptr
+// to new_value and returns true if *ptr equals old_value, atomically;
+// KaldiMemoryBarrier is a full memory barrier.
+#if defined(_MSC_VER)
+inline bool KaldiCompareAndSwap(volatile int64 *ptr, int64 old_value,
+                                int64 new_value) {
+  return _InterlockedCompareExchange64(ptr, new_value, old_value) == old_value;
+}
+inline void KaldiMemoryBarrier() { _mm_mfence(); }
+#else
+inline bool KaldiCompareAndSwap(volatile int64 *ptr, int64 old_value,
+                                int64 new_value) {
+  return __sync_bool_compare_and_swap(ptr, old_value, new_value);
+}
+inline void KaldiMemoryBarrier() { __sync_synchronize(); }
+#endif
+
+
+/**
+   LockFreeQueue is a bounded multi-producer, multi-consumer FIFO queue,
+   implemented as a ring buffer in which each cell has a sequence number that
+   says whether it is ready to be written or to be read (this is the
+   well-known algorithm of D. Vyukov).  Producers and consumers each claim a
+   position with a single compare-and-swap and never take a lock, so there is
+   no contention between producers and consumers unless the queue is nearly
+   empty or full.
+
+   TryPush() and TryPop() never block; they return false if the queue is full
+   or empty respectively.  See BoundedQueue for a blocking version.  T must be
+   copyable and assignable; for large objects, store pointers.
+*/
+template<class T>
+class LockFreeQueue {
+ public:
+  /// The capacity is rounded up to a power of two (and at least two, which
+  /// the algorithm requires).
+  explicit LockFreeQueue(size_t capacity) {
+    KALDI_ASSERT(capacity > 0);
+    size_t size = 2;
+    while (size < capacity) size *= 2;
+    cells_.resize(size);
+    for (size_t i = 0; i < size; i++)
+      cells_[i].sequence = i;
+    mask_ = size - 1;
+    enqueue_pos_ = 0;
+    dequeue_pos_ = 0;
+  }
+
+  size_t Capacity() const { return mask_ + 1; }
+
+  /// Adds a copy of "t" to the queue and returns true, or returns false if
+  /// the queue is full.
+  bool TryPush(const T &t) {
+    Cell *cell;
+    int64 pos = Load(&enqueue_pos_);
+    while (true) {
+      cell = &(cells_[pos & mask_]);
+      int64 diff = Load(&(cell->sequence)) - pos;
+      if (diff == 0) {  // The cell is free for writing at position "pos".
+        if (KaldiCompareAndSwap(&enqueue_pos_, pos, pos + 1))
+          break;
+      } else if (diff < 0) {  // The cell still holds an unread element.
+        return false;
+      }
+      pos = Load(&enqueue_pos_);  // Another producer got there first.
+    }
+    cell->data = t;
+    Store(&(cell->sequence), pos + 1);  // Makes it visible to consumers.
+    return true;
+  }
+
+  /// Removes the oldest element of the queue, puts it in *t and returns true;
+  /// or returns false if the queue is empty.  Note: if a producer has claimed
+  /// a position but not yet finished writing it, the queue appears empty from
+  /// that position on.
+  bool TryPop(T *t) {
+    Cell *cell;
+    int64 pos = Load(&dequeue_pos_);
+    while (true) {
+      cell = &(cells_[pos & mask_]);
+      int64 diff = Load(&(cell->sequence)) - (pos + 1);
+      if (diff == 0) {  // The cell has been written for position "pos".
+        if (KaldiCompareAndSwap(&dequeue_pos_, pos, pos + 1))
+          break;
+      } else if (diff < 0) {  // Nothing written yet.
+        return false;
+      }
+      pos = Load(&dequeue_pos_);
+    }
+    *t = cell->data;
+    cell->data = T();  // Don't hold on to resources, e.g. if T is a vector.
+    Store(&(cell->sequence), pos + mask_ + 1);  // Free for the next lap.
+    return true;
+  }
+
+ private:
+  // Load with acquire semantics and store with release semantics.
+  static inline int64 Load(volatile int64 *ptr) {
+    int64 ans = *ptr;
+    KaldiMemoryBarrier();
+    return ans;
+  }
+  static inline void Store(volatile int64 *ptr, int64 value) {
+    KaldiMemoryBarrier();
+    *ptr = value;
+  }
+
+  struct Cell {
+    volatile int64 sequence;
+    T data;
+  };
+  // The padding keeps the producer and consumer positions in different cache
+  // lines, so that producers and consumers do not invalidate each other's
+  // caches.
+  char pad0_[64];
+  std::vector<Cell> cells_;
+  size_t mask_;
+  char pad1_[64];
+  volatile int64 enqueue_pos_;
+  char pad2_[64];
+  volatile int64 dequeue_pos_;
+  char pad3_[64];
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LockFreeQueue);
+};
+
+
+/**
+   BoundedQueue is a blocking multi-producer, multi-consumer FIFO queue of
+   bounded size, built on LockFreeQueue.  Push() blocks while the queue is
+   full, which provides back-pressure to producers that are faster than the
+   consumers; Pop() blocks while the queue is empty.
+
+   When the producers are finished they should call Close(); after that, Pop()
+   returns false once the queue has been emptied.  Abort() is for cancellation:
+   it makes all current and future calls to Push() and Pop() return false
+   immediately.
+*/
+template<class T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity):
+      queue_(capacity), num_items_(0),
+      num_free_(static_cast<int32>(queue_.Capacity())),
+      closed_(false), aborted_(false) { }
+
+  /// Adds a copy of "t" to the queue, waiting if the queue is full.  Returns
+  /// false (and does not add "t") if Abort() has been called.  It is an error
+  /// to call this after Close().
+  bool Push(const T &t) {
+    KALDI_ASSERT(!closed_ && "Push() called after Close()");
+    num_free_.Wait();
+    if (aborted_) {
+      num_free_.Signal();  // wake up the next waiting producer, if any.
+      return false;
+    }
+    // A free slot is guaranteed, but a consumer that is slower than others
+    // may not have finished reading it yet.
+    while (!queue_.TryPush(t))
+      sched_yield();
+    num_items_.Signal();
+    return true;
+  }
+
+  /// Removes the oldest element and puts it in *t, waiting if the queue is
+  /// empty.  Returns false if Abort() has been called, or if Close() has been
+  /// called and there are no more elements.
+  bool Pop(T *t) {
+    num_items_.Wait();
+    while (true) {
+      if (aborted_) {
+        num_items_.Signal();  // wake up the next waiting consumer, if any.
+        return false;
+      }
+      if (queue_.TryPop(t)) break;
+      KaldiMemoryBarrier();
+      if (closed_ && !queue_.TryPop(t)) {
+        // All Push() calls finished before Close(), so the queue is really
+        // empty.  We were woken by Close(); pass the wake-up on.
+        num_items_.Signal();
+        return false;
+      }
+      if (closed_) break;  // the second TryPop() above succeeded.
+      sched_yield();  // A producer is still writing the element.
+    }
+    num_free_.Signal();
+    return true;
+  }
+
+  /// Producers call this after their last call to Push().
+  void Close() {
+    KaldiMemoryBarrier();
+    closed_ = true;
+    KaldiMemoryBarrier();
+    num_items_.Signal();  // Consumers wake each other up in turn.
+  }
+
+  /// Makes all calls to Push() and Pop() return false; elements still in the
+  /// queue are not returned.
+  void Abort() {
+    aborted_ = true;
+    KaldiMemoryBarrier();
+    num_items_.Signal();
+    num_free_.Signal();
+  }
+
+  bool Aborted() const { return aborted_; }
+
+ private:
+  LockFreeQueue<T> queue_;
+  Semaphore num_items_;  // Number of elements that may be popped.
+  Semaphore num_free_;  // Number of free cells.
+  volatile bool closed_;
+  volatile bool aborted_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(BoundedQueue);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_THREAD_KALDI_QUEUE_H_
@@ -0,0 +1,134 @@
+// thread/kaldi-table-shard-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <map>
+#include "base/kaldi-common.h"
+#include "util/table-types.h"
+#include "thread/kaldi-table-shard.h"
+
+namespace kaldi {
+
+// Multiplies each element of the table by a shared "model" (an integer) and
+// writes it to a shared writer; also sums up the inputs.
+class MyShardClass: public TableShardTask<BasicHolder<int32> > {
+ public:
+  MyShardClass(const std::string &rspecifier,
+               const int32 *model,
+               SynchronizedTableWriter<BasicHolder<int32> > *writer,
+               int64 *tot):
+      TableShardTask<BasicHolder<int32> >(rspecifier), model_(model),
+      writer_(writer), tot_(tot), private_tot_(0) { }
+
+  virtual void ProcessItem(const std::string &key, const int32 &value) {
+    private_tot_ += value;
+    writer_->Write(key, value * *model_);
+  }
+
+  ~MyShardClass() { *tot_ += private_tot_; }  // destructors are not called
+                                              // concurrently.
+ private:
+  const int32 *model_;
+  SynchronizedTableWriter<BasicHolder<int32> > *writer_;
+  int64 *tot_;
+  int64 private_tot_;
+};
+
+// Writes its output per shard.
+class MyPerShardClass: public TableShardTask<BasicHolder<int32> > {
+ public:
+  MyPerShardClass(const std::string &rspecifier,
+                  const std::string &wspecifier):
+      TableShardTask<BasicHolder<int32> >(rspecifier),
+      wspecifier_(wspecifier) { }
+
+  virtual void operator() () {
+    writer_.Open(ShardWspecifier(wspecifier_, thread_id_));
+    TableShardTask<BasicHolder<int32> >::operator() ();
+    KALDI_ASSERT(writer_.Close());
+  }
+
+  virtual void ProcessItem(const std::string &key, const int32 &value) {
+    writer_.Write(key, value + 1);
+  }
+ private:
+  std::string wspecifier_;
+  Int32Writer writer_;
+};
+
+
+void TestTableShards() {
+  int32 num_items = Rand() % 50, num_shards = Rand() % 5;
+  std::map<std::string, int32> input;
+  int64 input_tot = 0;
+  {
+    Int32Writer writer("ark,scp:tmpf,tmpf.scp");
+    for (int32 i = 0; i < num_items; i++) {
+      std::ostringstream os;
+      os << "key" << i;
+      int32 value = Rand() % 1000;
+      writer.Write(os.str(), value);
+      input[os.str()] = value;
+      input_tot += value;
+    }
+  }
+  int32 model = 1 + Rand() % 3;
+  int64 tot = 0;
+  {
+    SynchronizedTableWriter<BasicHolder<int32> > writer("ark:tmpf.out");
+    MyShardClass c("scp:tmpf.scp", &model, &writer, &tot);
+    RunTableShards(num_shards, c);
+    KALDI_ASSERT(writer.Close());
+  }
+  KALDI_ASSERT(tot == input_tot);
+  std::map<std::string, int32> output;
+  for (SequentialInt32Reader reader("ark:tmpf.out"); !reader.Done();
+       reader.Next()) {
+    KALDI_ASSERT(output.count(reader.Key()) == 0);
+    output[reader.Key()] = reader.Value();
+  }
+  KALDI_ASSERT(output.size() == input.size());
+  for (std::map<std::string, int32>::iterator iter = input.begin();
+       iter != input.end(); ++iter)
+    KALDI_ASSERT(output[iter->first] == iter->second * model);
+
+  {
+    MyPerShardClass c("scp:tmpf.scp", "ark:tmpf.SHARD.out");
+    RunTableShards(num_shards, c);
+  }
+  int32 num_read = 0;
+  for (int32 shard = 0; shard < std::max(num_shards, 1); shard++) {
+    std::string rspecifier = ShardWspecifier("ark:tmpf.SHARD.out", shard);
+    for (SequentialInt32Reader reader(rspecifier); !reader.Done();
+         reader.Next(), num_read++)
+      KALDI_ASSERT(reader.Value() == input[reader.Key()] + 1);
+    unlink(ShardWspecifier("tmpf.SHARD.out", shard).c_str());
+  }
+  KALDI_ASSERT(num_read == num_items);
+  unlink("tmpf");
+  unlink("tmpf.scp");
+  unlink("tmpf.out");
+}
+
+}  // end namespace kaldi.
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    TestTableShards();
+  KALDI_LOG << "Test OK.";
+  return 0;
+}
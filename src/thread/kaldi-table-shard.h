@@ -0,0 +1,133 @@
+// thread/kaldi-table-shard.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_THREAD_KALDI_TABLE_SHARD_H_
+#define KALDI_THREAD_KALDI_TABLE_SHARD_H_ 1
+
+#include <string>
+#include "base/kaldi-common.h"
+#include "util/kaldi-table.h"
+#include "thread/kaldi-thread.h"
+#include "thread/kaldi-mutex.h"
+
+namespace kaldi {
+
+/**
+   This header provides a mechanism for doing, inside a single process, what
+   the recipes normally do by splitting an scp file N ways and running N
+   processes.  Each thread reads its own disjoint subset ("shard") of the scp
+   file through its own SequentialTableReader (see
+   SequentialTableReader::OpenShard()), while large read-only objects such as
+   models, decoding graphs and language models are loaded only once and shared
+   between the threads by pointer.
+
+   The mechanism builds on MultiThreader (see kaldi-thread.h): you derive a
+   class from TableShardTask<Holder>, implement ProcessItem(), and give an
+   object of that class to RunTableShards().  The object is copied once per
+   thread; as with other MultiThreadable classes, the destructors of the
+   copies are a convenient place to sum up per-thread statistics.
+
+   For output you have two choices:
+     - A single SynchronizedTableWriter, shared by pointer between the
+       threads, which writes all outputs to one table (the order of the keys
+       in the output will not be the same as in the input).
+     - One TableWriter per thread, opened with ShardWspecifier(wspecifier,
+       thread_id_), e.g. "ark:lat.SHARD.ark" -> "ark:lat.3.ark".  Because
+       TableShardTask objects are copied, these should be opened in
+       operator () (e.g. in an override that opens the writer and then
+       calls TableShardTask<Holder>::operator ()), not in the constructor.
+*/
+
+template<class Holder>
+class TableShardTask: public MultiThreadable {
+ public:
+  typedef typename Holder::T T;
+
+  /// "rspecifier" must be of the "scp:" type.
+  explicit TableShardTask(const std::string &rspecifier):
+      rspecifier_(rspecifier), num_done_(0) { }
+
+  /// Reads this thread's shard of the table and calls ProcessItem() on each
+  /// element.
+  virtual void operator() () {
+    SequentialTableReader<Holder> reader;
+    if (!reader.OpenShard(rspecifier_, thread_id_, num_threads_))
+      KALDI_ERR << "Error opening shard " << thread_id_ << " of "
+                << num_threads_ << " of table " << rspecifier_;
+    for (; !reader.Done(); reader.Next()) {
+      ProcessItem(reader.Key(), reader.Value());
+      num_done_++;
+    }
+    if (!reader.Close())
+      KALDI_ERR << "Error reading shard " << thread_id_ << " of table "
+                << rspecifier_;
+  }
+
+  /// This is called once for each element of this thread's shard.
+  virtual void ProcessItem(const std::string &key, const T &value) = 0;
+
+  virtual ~TableShardTask() { }
+
+ protected:
+  std::string rspecifier_;
+  int64 num_done_;  // Number of items processed by this copy of the object.
+};
+
+
+/// A wrapper for TableWriter that may be shared between threads: Write() is
+/// protected by a mutex.
+template<class Holder>
+class SynchronizedTableWriter {
+ public:
+  typedef typename Holder::T T;
+
+  explicit SynchronizedTableWriter(const std::string &wspecifier):
+      writer_(wspecifier) { }
+
+  void Write(const std::string &key, const T &value) {
+    mutex_.Lock();
+    try {
+      writer_.Write(key, value);
+    } catch (...) {
+      mutex_.Unlock();
+      throw;
+    }
+    mutex_.Unlock();
+  }
+
+  /// Not thread-safe; call this after all threads have finished.
+  bool Close() { return writer_.Close(); }
+
+ private:
+  TableWriter<Holder> writer_;
+  Mutex mutex_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SynchronizedTableWriter);
+};
+
+
+/// Runs "c" in "num_shards" threads, each of which processes one shard of the
+/// table.  Class C should inherit from TableShardTask<Holder> for some Holder.
+/// If num_shards is 0 it behaves like 1, but without creating a new thread
+/// (as for MultiThreader).
+template<class C> void RunTableShards(int32 num_shards, const C &c) {
+  MultiThreader<C> m(num_shards, c);
+}
+
+
+} // namespace kaldi
+
+#endif  // KALDI_THREAD_KALDI_TABLE_SHARD_H_
@@ -0,0 +1,178 @@
+// thread/kaldi-task-pipeline.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_THREAD_KALDI_TASK_PIPELINE_H_
+#define KALDI_THREAD_KALDI_TASK_PIPELINE_H_ 1
+
+#include <pthread.h>
+#include <map>
+#include <utility>
+#include "base/kaldi-common.h"
+#include "thread/kaldi-affinity.h"
+#include "thread/kaldi-queue.h"
+#include "thread/kaldi-semaphore.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+/**
+   TaskPipeline is a three-stage pipeline: a source (the thread that calls
+   Run()), a pool of worker threads that do the computation, and an ordered
+   sink.  It accepts the same kind of task objects as TaskSequencer (see
+   kaldi-task-sequence.h), and gives the same guarantees: the operator () of
+   the tasks is called in parallel, and the destructors are called one at a
+   time, in the same order the tasks were given to Run(), so the destructor
+   may safely produce output.
+
+   The difference from TaskSequencer is that TaskPipeline keeps a fixed set of
+   threads alive and passes tasks between them through BoundedQueue objects,
+   instead of creating a new thread for each task; this matters when there
+   are many small tasks.
+
+   The configuration is the same as for TaskSequencer: --num-threads is the
+   number of worker threads, and --num-threads-total limits the number of
+   tasks that are in the pipeline at any one time (this bounds memory use: Run()
+   waits when the limit is reached).  --thread-affinity pins the worker
+   threads to CPUs (see kaldi-affinity.h).
+
+   Cancellation: after Abort() is called, tasks that have not started running
+   yet are not run; they are still destroyed, in order, so their destructors
+   should check whether the computation was done.
+*/
+template<class C>
+class TaskPipeline {
+ public:
+  TaskPipeline(const TaskSequencerConfig &config):
+      num_threads_(std::max<int32>(config.num_threads, 1)),
+      max_tasks_(config.num_threads_total > 0 ? config.num_threads_total :
+                 config.num_threads + 20),
+      tasks_avail_(max_tasks_), input_(max_tasks_), output_(max_tasks_),
+      next_task_(0), waited_(false), aborted_(false) {
+    KALDI_ASSERT((config.num_threads_total <= 0 ||
+                  config.num_threads_total >= config.num_threads) &&
+                 "num-threads-total, if specified, must be >= num-threads");
+    workers_.resize(num_threads_);
+    CheckThreadAffinity(config.thread_affinity);
+    for (size_t i = 0; i < workers_.size(); i++)
+      CreateThread(&(workers_[i]), TaskPipeline<C>::RunWorker,
+                   config.thread_affinity, i);
+    CreateThread(&sink_, TaskPipeline<C>::RunSink, "none", 0);
+  }
+
+  /// This function takes ownership of the pointer "c", and will delete it
+  /// in the same sequence as Run was called on the jobs.  It waits if there
+  /// are already --num-threads-total tasks in the pipeline.
+  void Run(C *c) {
+    KALDI_ASSERT(!waited_ && "Run() called after Wait()");
+    tasks_avail_.Wait();
+    input_.Push(std::make_pair(next_task_++, c));
+  }
+
+  /// Waits for all tasks to finish and be destroyed.  The destructor calls
+  /// this if you don't.
+  void Wait() {
+    if (waited_) return;
+    waited_ = true;
+    input_.Close();
+    for (size_t i = 0; i < workers_.size(); i++)
+      JoinThread(workers_[i]);
+    output_.Close();
+    JoinThread(sink_);
+  }
+
+  /// Tasks that have not yet started running will not be run (but they will
+  /// still be destroyed in order).
+  void Abort() { aborted_ = true; }
+
+  ~TaskPipeline() { Wait(); }
+
+ private:
+  typedef std::pair<int64, C*> Task;  // (sequence number, task).
+
+  // Creates the thread, pinned according to "affinity" as thread number
+  // "thread_index" (see kaldi-affinity.h).
+  void CreateThread(pthread_t *thread, void *(*func)(void*),
+                    const std::string &affinity, int32 thread_index) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (affinity != "none")
+      ApplyThreadAffinity(&attr, affinity, thread_index);
+    int32 ret = pthread_create(thread, &attr, func, static_cast<void*>(this));
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+      const char *c = strerror(ret);
+      KALDI_ERR << "Error creating thread, errno was: " << (c ? c : "[NULL]");
+    }
+  }
+  static void JoinThread(pthread_t thread) {
+    int32 ret;
+    if ((ret = pthread_join(thread, NULL))) {
+      const char *c = strerror(ret);
+      KALDI_ERR << "Error joining thread, errno was: " << (c ? c : "[NULL]");
+    }
+  }
+
+  // The worker threads run the tasks and pass them on to the sink.
+  static void *RunWorker(void *input) {
+    TaskPipeline<C> *me = static_cast<TaskPipeline<C>*>(input);
+    Task task;
+    while (me->input_.Pop(&task)) {
+      if (!me->aborted_)
+        (*(task.second))();  // call operator () on the task.
+      me->output_.Push(task);
+    }
+    return NULL;
+  }
+
+  // The sink thread destroys the tasks in order.  Tasks may arrive out of
+  // order, so we keep them in "pending" until their turn comes.
+  static void *RunSink(void *input) {
+    TaskPipeline<C> *me = static_cast<TaskPipeline<C>*>(input);
+    std::map<int64, C*> pending;
+    int64 next_to_delete = 0;
+    Task task;
+    while (me->output_.Pop(&task)) {
+      pending[task.first] = task.second;
+      typename std::map<int64, C*>::iterator iter;
+      while (!pending.empty() &&
+             (iter = pending.begin())->first == next_to_delete) {
+        delete iter->second;  // This may produce output.
+        pending.erase(iter);
+        next_to_delete++;
+        me->tasks_avail_.Signal();
+      }
+    }
+    KALDI_ASSERT(pending.empty());
+    return NULL;
+  }
+
+  int32 num_threads_;
+  int32 max_tasks_;
+  Semaphore tasks_avail_;  // Limits the number of tasks in the pipeline.
+  BoundedQueue<Task> input_;  // Tasks waiting to be run.
+  BoundedQueue<Task> output_;  // Tasks waiting to be destroyed.
+  std::vector<pthread_t> workers_;
+  pthread_t sink_;
+  int64 next_task_;  // Sequence number of the next task given to Run().
+  bool waited_;
+  volatile bool aborted_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(TaskPipeline);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_THREAD_KALDI_TASK_PIPELINE_H_
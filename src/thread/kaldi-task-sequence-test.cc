@@ -19,8 +19,12 @@
 // limitations under the License.
 
 
+#include <set>
+
 #include "base/kaldi-common.h"
 #include "thread/kaldi-task-sequence.h"
+#include "thread/kaldi-affinity.h"
+#include "thread/kaldi-mutex.h"
 
 namespace kaldi {
 
@@ -66,11 +70,72 @@ void TestTaskSequencer() {
     KALDI_ASSERT(task_output[i] == i);
 }
 
+// Records the CPUs that the tasks are computing on, to check that two tasks
+// that compute at the same time are never on the same CPU.
+struct CpuUsage {
+  Mutex mutex;
+  std::multiset<int32> cpus_in_use;
+  std::set<int32> allowed_cpus;  // The CPUs of thread indexes < num-threads.
+  int32 num_collisions;
+  int32 num_unexpected;
+  CpuUsage(): num_collisions(0), num_unexpected(0) { }
+};
+
+class PinnedTaskClass {
+ public:
+  PinnedTaskClass(CpuUsage *usage): usage_(usage) { }
+  void operator() () {
+    int32 cpu = CurrentCpu();
+    usage_->mutex.Lock();
+    if (usage_->cpus_in_use.count(cpu) != 0) usage_->num_collisions++;
+    if (usage_->allowed_cpus.count(cpu) == 0) usage_->num_unexpected++;
+    usage_->cpus_in_use.insert(cpu);
+    usage_->mutex.Unlock();
+    int32 spin = 1000000 * Rand() % 100;  // tasks finish out of order.
+    for (int32 i = 0; i < spin; i++);
+    usage_->mutex.Lock();
+    usage_->cpus_in_use.erase(usage_->cpus_in_use.find(cpu));
+    usage_->mutex.Unlock();
+  }
+ private:
+  CpuUsage *usage_;
+};
+
+void TestTaskSequencerAffinity() {
+  // Pinning may legitimately fail, e.g. if we are restricted to a subset of
+  // the CPUs by a job scheduler, or be unsupported; then there is nothing to
+  // test.
+  std::vector<int32> cpus;
+  for (int32 node = 0; node < NumaNumNodes(); node++) {
+    std::vector<int32> node_cpus;
+    NumaNodeCpus(node, &node_cpus);
+    cpus.insert(cpus.end(), node_cpus.begin(), node_cpus.end());
+  }
+  if (cpus.empty() || CurrentCpu() == -1 ||
+      !SetThreadAffinity(pthread_self(), cpus))
+    return;
+
+  TaskSequencerConfig config;
+  config.num_threads = 1 + Rand() % std::min<int32>(cpus.size(), 8);
+  config.thread_affinity = (Rand() % 2 == 0 ? "compact" : "scatter");
+  CpuUsage usage;
+  for (int32 i = 0; i < config.num_threads; i++)
+    usage.allowed_cpus.insert(ThreadAffinityCpu(config.thread_affinity, i));
+  {
+    TaskSequencer<PinnedTaskClass> sequencer(config);
+    for (int32 i = 0; i < 200; i++)
+      sequencer.Run(new PinnedTaskClass(&usage));
+  }
+  KALDI_ASSERT(usage.num_collisions == 0 && usage.num_unexpected == 0);
+}
+
 }  // end namespace kaldi.
 
 int main() {
   using namespace kaldi;
   for (int32 i = 0; i < 1000; i++)
     TestTaskSequencer();
+  for (int32 i = 0; i < 10; i++)
+    TestTaskSequencerAffinity();
 }
 
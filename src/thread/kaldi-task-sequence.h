@@ -24,6 +24,7 @@
 #include "thread/kaldi-thread.h"
 #include "itf/options-itf.h"
 #include "thread/kaldi-semaphore.h"
+#include "thread/kaldi-mutex.h"
 
 
 namespace kaldi {
@@ -60,7 +61,9 @@ namespace kaldi {
 struct TaskSequencerConfig {
   int32 num_threads;
   int32 num_threads_total;
-  TaskSequencerConfig(): num_threads(1), num_threads_total(0)  { }
+  std::string thread_affinity;
+  TaskSequencerConfig(): num_threads(1), num_threads_total(0),
+                         thread_affinity("none") { }
   void Register(OptionsItf *opts) {
     opts->Register("num-threads", &num_threads, "Number of actively processing "
                    "threads to run in parallel");
@@ -69,6 +72,10 @@ struct TaskSequencerConfig {
                    "to produce their output.  Controls memory use.  If <= 0, "
                    "defaults to --num-threads plus 20.  Otherwise, must "
                    "be >= num-threads.");
+    opts->Register("thread-affinity", &thread_affinity, "Controls which CPUs "
+                   "the threads run on: none, compact (fill one NUMA node "
+                   "before the next) or scatter (spread over the NUMA "
+                   "nodes).");
   }
 };
 
@@ -82,7 +89,9 @@ class TaskSequencer {
       threads_avail_(config.num_threads),
       tot_threads_avail_(config.num_threads_total > 0 ? config.num_threads_total :
                          config.num_threads + 20),
-      thread_list_(NULL) {
+      thread_list_(NULL), thread_affinity_(config.thread_affinity),
+      slot_busy_(std::max<int32>(config.num_threads, 1), false) {
+    CheckThreadAffinity(thread_affinity_);
     KALDI_ASSERT((config.num_threads_total <= 0 ||
                   config.num_threads_total >= config.num_threads) &&
                  "num-threads-total, if specified, must be >= num-threads");
@@ -97,12 +106,16 @@ class TaskSequencer {
     
     // put the new RunTaskArgsList object at head of the singly
     // linked list thread_list_.
-    thread_list_ = new RunTaskArgsList(this, c, thread_list_);
-    int32 ret;
-    if ((ret=pthread_create(&(thread_list_->thread),
-                            NULL, // default attributes
-                            TaskSequencer<C>::RunTask,
-                            static_cast<void*>(thread_list_)))) {
+    thread_list_ = new RunTaskArgsList(this, c, GetFreeSlot(), thread_list_);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (thread_affinity_ != "none")
+      ApplyThreadAffinity(&attr, thread_affinity_, thread_list_->slot);
+    int32 ret = pthread_create(&(thread_list_->thread), &attr,
+                               TaskSequencer<C>::RunTask,
+                               static_cast<void*>(thread_list_));
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
       const char *c = strerror(ret);
       KALDI_ERR << "Error creating thread, errno was: " << (c ? c : "[NULL]");
     }
@@ -131,17 +144,40 @@ class TaskSequencer {
   struct RunTaskArgsList {
     TaskSequencer *me; // Think of this as a "this" pointer.
     C *c; // Clist element of the task we're expected
+    int32 slot; // See GetFreeSlot().
     pthread_t thread;
     RunTaskArgsList *tail;
-    RunTaskArgsList(TaskSequencer *me, C *c, RunTaskArgsList *tail):
-        me(me), c(c), tail(tail) {}
+    RunTaskArgsList(TaskSequencer *me, C *c, int32 slot,
+                    RunTaskArgsList *tail):
+        me(me), c(c), slot(slot), tail(tail) {}
   };
+
+  // No more than num_threads tasks compute at once, so we number the tasks
+  // that are computing 0 ... num_threads - 1; a new task takes a number that
+  // is not in use, and the thread-affinity policy pins it to the CPU for that
+  // thread index.  Tasks finish out of order, so we can't just go round-robin.
+  int32 GetFreeSlot() {
+    slot_mutex_.Lock();
+    int32 slot = 0;
+    while (slot < static_cast<int32>(slot_busy_.size()) && slot_busy_[slot])
+      slot++;
+    KALDI_ASSERT(slot < static_cast<int32>(slot_busy_.size()));
+    slot_busy_[slot] = true;
+    slot_mutex_.Unlock();
+    return slot;
+  }
+  void FreeSlot(int32 slot) {
+    slot_mutex_.Lock();
+    slot_busy_[slot] = false;
+    slot_mutex_.Unlock();
+  }
   // This static function gets run in the threads that we create.
   static void* RunTask(void *input) {
     RunTaskArgsList *args = static_cast<RunTaskArgsList*>(input);
     
     // (1) run the job.
     (*(args->c))(); // call operator () on args->c, which does the computation.
+    args->me->FreeSlot(args->slot);  // before Signal(), so Run() finds it free.
     args->me->threads_avail_.Signal(); // Signal that the compute-intensive
     // part of the thread is done (we want to run no more than
     // config_.num_threads of these.)
@@ -189,6 +225,11 @@ class TaskSequencer {
   Semaphore tot_threads_avail_; // We use this semaphore to ensure we don't
   // consume too much memory...
   RunTaskArgsList *thread_list_; 
+
+  std::string thread_affinity_;
+  std::vector<bool> slot_busy_;  // slot_busy_[i] is true if a task that is
+                                 // computing has slot i.
+  Mutex slot_mutex_;  // Guards slot_busy_.
   
 };
 
@@ -28,6 +28,7 @@
 #endif
 
 #include <pthread.h>
+#include "thread/kaldi-affinity.h"
 #include "thread/kaldi-barrier.h"
 // This header provides a convenient mechanism for parallelization.  The idea is
 // that you have some range of integers, e.g. A ... B-1 (with B > A), and some
@@ -65,6 +66,8 @@ extern int32 g_num_threads;  // Maximum number of threads (for programs that
 // used, with --num-threads.  Programs that think they will use threads
 // should register it with their ParseOptions, as something like:
 // po.Register("num-threads", &g_num_threads, "Number of threads to use.");
+// Such programs may also register --thread-affinity with g_thread_affinity
+// (see kaldi-affinity.h), which controls which CPUs the threads run on.
 
 class MultiThreadable {
   // To create function that does part of the job, create class that inherits
@@ -137,11 +140,13 @@ class MultiThreader {
       cvec_[0].num_threads_ = 1;
       (cvec_[0])();
     } else {
-      pthread_attr_t pthread_attr;
-      pthread_attr_init(&pthread_attr);
       for (int32 thread = 0; thread < num_threads; thread++) {
         cvec_[thread].thread_id_ = thread;
         cvec_[thread].num_threads_ = num_threads;
+        pthread_attr_t pthread_attr;
+        pthread_attr_init(&pthread_attr);
+        if (g_thread_affinity != "none")  // see kaldi-affinity.h
+          ApplyThreadAffinity(&pthread_attr, g_thread_affinity, thread);
         int32 ret;
         if ((ret=pthread_create(&(threads_[thread]),
                                 &pthread_attr, C::run, &(cvec_[thread])))) {
@@ -149,6 +154,7 @@ class MultiThreader {
           if (c == NULL) { c = "[NULL]"; }
           KALDI_ERR << "Error creating thread, errno was: " << c;
         }
+        pthread_attr_destroy(&pthread_attr);
       }
     }
   }
@@ -26,6 +26,35 @@ using std::vector;
 namespace kaldi {
 
 
+void DecodableAmDiagGmmRegtreeFmllr::ComputeXformedBlock(int32 frame) {
+  // The decoders ask for the frames in order, so we transform the features of
+  // a block of frames at a time, with one matrix multiplication per transform
+  // instead of a matrix-vector product per frame.
+  const int32 kBlockSize = 32;
+  int32 num_xforms = fmllr_xform_.NumRegClasses(),
+      dim = feature_matrix_.NumCols(),
+      num_frames = std::min(kBlockSize, NumFramesReady() - frame);
+  if (xform_matrices_.empty()) {
+    xform_matrices_.resize(num_xforms);
+    for (int32 r = 0; r < num_xforms; r++)
+      fmllr_xform_.GetXformMatrix(r, &(xform_matrices_[r]));
+  }
+  Matrix<BaseFloat> extended_data(num_frames, dim + 1, kUndefined);
+  extended_data.Range(0, num_frames, 0, dim).CopyFromMat(
+      feature_matrix_.RowRange(frame, num_frames));
+  extended_data.Range(0, num_frames, dim, 1).Set(1.0);
+  xformed_data_.resize(num_xforms);
+  xformed_data_squared_.resize(num_xforms);
+  for (int32 r = 0; r < num_xforms; r++) {
+    xformed_data_[r].Resize(num_frames, dim, kUndefined);
+    xformed_data_[r].AddMatMat(1.0, extended_data, kNoTrans,
+                               xform_matrices_[r], kTrans, 0.0);
+    xformed_data_squared_[r] = xformed_data_[r];
+    xformed_data_squared_[r].ApplyPow(2.0);
+  }
+  block_start_ = frame;
+}
+
 BaseFloat DecodableAmDiagGmmRegtreeFmllr::LogLikelihoodZeroBased(int32 frame,
                                                           int32 state) {
   KALDI_ASSERT(frame < NumFramesReady() && frame >= 0);
@@ -54,27 +83,22 @@ BaseFloat DecodableAmDiagGmmRegtreeFmllr::LogLikelihoodZeroBased(int32 frame,
         "before computing likelihood.";
   }
 
-  if (frame != previous_frame_) {  // cache the transformed & squared stats.
-    fmllr_xform_.TransformFeature(data, &xformed_data_);
-    xformed_data_squared_ = xformed_data_;
-    vector< Vector <BaseFloat> >::iterator it = xformed_data_squared_.begin(),
-        end = xformed_data_squared_.end();
-    for (; it != end; ++it) { it->ApplyPow(2.0); }
-    previous_frame_ = frame;
-  }
+  if (block_start_ == -1 || frame < block_start_ ||
+      frame >= block_start_ + xformed_data_[0].NumRows())
+    ComputeXformedBlock(frame);
 
   Vector<BaseFloat> loglikes(pdf.gconsts());  // need to recreate for each pdf
-  int32 baseclass, regclass;
+  int32 baseclass, regclass, row = frame - block_start_;
   for (int32 comp_id = 0, num_comp = pdf.NumGauss(); comp_id < num_comp;
       ++comp_id) {
     baseclass = regtree_.Gauss2BaseclassId(state, comp_id);
     regclass = fmllr_xform_.Base2RegClass(baseclass);
     // loglikes +=  means * inv(vars) * data.
     loglikes(comp_id) += VecVec(pdf.means_invvars().Row(comp_id),
-                                xformed_data_[regclass]);
+                                xformed_data_[regclass].Row(row));
     // loglikes += -0.5 * inv(vars) * data_sq.
     loglikes(comp_id) -= 0.5 * VecVec(pdf.inv_vars().Row(comp_id),
-                                      xformed_data_squared_[regclass]);
+                                      xformed_data_squared_[regclass].Row(row));
     loglikes(comp_id) += logdets_(regclass);
   }
 
@@ -46,7 +46,7 @@ class DecodableAmDiagGmmRegtreeFmllr: public DecodableAmDiagGmmUnmapped {
                                  BaseFloat log_sum_exp_prune = -1.0)
     : DecodableAmDiagGmmUnmapped(am, feats, log_sum_exp_prune), trans_model_(tm),
       scale_(scale), fmllr_xform_(fmllr_xform), regtree_(regtree),
-      valid_logdets_(false) {}
+      block_start_(-1), valid_logdets_(false) {}
 
   // Note, frames are numbered from zero but transition-ids (tid) from one.
   virtual BaseFloat LogLikelihood(int32 frame, int32 tid) {
@@ -69,8 +69,18 @@ class DecodableAmDiagGmmRegtreeFmllr: public DecodableAmDiagGmmUnmapped {
   BaseFloat scale_;
   const RegtreeFmllrDiagGmm &fmllr_xform_;
   const RegressionTree &regtree_;
-  std::vector< Vector<BaseFloat> > xformed_data_;
-  std::vector< Vector<BaseFloat> > xformed_data_squared_;
+
+  /// Transforms the features of the block of frames starting at "frame" with
+  /// each of the transforms, and caches them (and their squares).
+  void ComputeXformedBlock(int32 frame);
+
+  /// The transforms, cached as we need them for each block.
+  std::vector< Matrix<BaseFloat> > xform_matrices_;
+  /// The first frame of the cached block, or -1 if none yet.
+  int32 block_start_;
+  /// Transformed features of the frames of the block, for each transform.
+  std::vector< Matrix<BaseFloat> > xformed_data_;
+  std::vector< Matrix<BaseFloat> > xformed_data_squared_;
   Vector<BaseFloat> logdets_;
   bool valid_logdets_;
 
@@ -22,6 +22,7 @@
 #include "gmm/diag-gmm-normal.h"
 #include "gmm/model-test-common.h"
 #include "transform/fmpe.h"
+#include "matrix/matrix-functions.h"
 
 namespace kaldi {
 
@@ -165,6 +166,107 @@ void TestFmpe() {
   unlink("tmpf");
 }
 
+// Checks that ComputeFeatures() and AccStats() give the same results with
+// several threads as with one.
+void TestFmpeThreaded() {
+  int32 dim = 10 + (Rand() % 10);
+  int32 num_comp = 10 + (Rand() % 10);
+  DiagGmm gmm;
+  unittest::InitRandDiagGmm(dim, num_comp, &gmm);
+
+  int32 num_frames = 1 + Rand() % 100;
+  Matrix<BaseFloat> feats(num_frames, dim);
+  feats.SetRandn();
+  std::vector<std::vector<int32> > gselect(num_frames);
+  for (int32 i = 0; i < num_frames; i++)
+    for (int32 j = 0; j < gmm.NumGauss(); j++)
+      if (Rand() % 3 == 0 || j == i % gmm.NumGauss())
+        gselect[i].push_back(j);
+
+  FmpeOptions opts;
+  Fmpe fmpe(gmm, opts);
+  Matrix<BaseFloat> deriv(num_frames, dim), indirect_deriv(num_frames, dim);
+  deriv.SetRandn();
+  indirect_deriv.SetRandn();
+  {
+    // Give the projection some random nonzero value.
+    FmpeStats stats(fmpe);
+    fmpe.AccStats(feats, gselect, deriv, NULL, &stats);
+    FmpeUpdateOptions update_opts;
+    fmpe.Update(update_opts, stats);
+  }
+  int32 num_threads = 2 + Rand() % 4;
+  Matrix<BaseFloat> offset1, offset2;
+  fmpe.ComputeFeatures(feats, gselect, &offset1);
+  fmpe.ComputeFeatures(feats, gselect, &offset2, num_threads);
+  KALDI_ASSERT(!offset1.IsZero());
+  AssertEqual(offset1, offset2);
+
+  FmpeStats stats1(fmpe), stats2(fmpe);
+  fmpe.AccStats(feats, gselect, deriv, &indirect_deriv, &stats1);
+  fmpe.AccStats(feats, gselect, deriv, &indirect_deriv, &stats2, num_threads);
+  AssertEqual(stats1.DerivPlus(), stats2.DerivPlus());
+  AssertEqual(stats1.DerivMinus(), stats2.DerivMinus());
+  KALDI_ASSERT(stats1.DerivPlus().Min() >= 0.0 &&
+               stats1.DerivMinus().Min() >= 0.0);
+}
+
+// Checks ApplyProjectionReverse(), which does the rank-one updates of the
+// derivative stats as matrix-matrix products, against the per-posterior
+// AddOuterProductPlusMinus() code it replaced.
+void TestFmpeProjectionReverse() {
+  int32 dim = 10 + (Rand() % 10);
+  int32 num_comp = 10 + (Rand() % 10);
+  DiagGmm gmm;
+  unittest::InitRandDiagGmm(dim, num_comp, &gmm);
+
+  int32 num_frames = 1 + Rand() % 100;
+  Matrix<BaseFloat> feats(num_frames, dim);
+  feats.SetRandn();
+  std::vector<std::vector<int32> > gselect(num_frames);
+  for (int32 i = 0; i < num_frames; i++)
+    for (int32 j = 0; j < gmm.NumGauss(); j++)
+      if (Rand() % 3 == 0 || j == i % gmm.NumGauss())
+        gselect[i].push_back(j);
+
+  FmpeOptions opts;
+  Fmpe fmpe(gmm, opts);
+  int32 ncontexts = fmpe.NumContexts(), num_threads = 1 + Rand() % 4;
+  Matrix<BaseFloat> intermed_feat_deriv(num_frames, dim * ncontexts);
+  intermed_feat_deriv.SetRandn();
+  Matrix<BaseFloat> plus(fmpe.ProjectionTNumRows(), fmpe.ProjectionTNumCols()),
+      minus(plus), plus_ref(plus), minus_ref(plus);
+  fmpe.ApplyProjectionReverse(feats, gselect, intermed_feat_deriv,
+                              &plus, &minus, num_threads);
+
+  Matrix<BaseFloat> means, vars;
+  gmm.GetMeans(&means);
+  gmm.GetVars(&vars);
+  Vector<BaseFloat> post, input_chunk(dim + 1);
+  for (int32 t = 0; t < num_frames; t++) {
+    gmm.LogLikelihoodsPreselect(feats.Row(t), gselect[t], &post);
+    post.ApplySoftMax();
+    for (int32 i = 0; i < post.Dim(); i++) {
+      int32 gauss = gselect[t][i];
+      // The high-dimensional features are post * (x - mean) / stddev, and the
+      // scaled posterior.
+      for (int32 d = 0; d < dim; d++)
+        input_chunk(d) = post(i) * (feats(t, d) - means(gauss, d)) /
+            std::sqrt(vars(gauss, d));
+      input_chunk(dim) = post(i) * opts.post_scale;
+      SubMatrix<BaseFloat> plus_chunk(plus_ref, gauss * (dim + 1), dim + 1,
+                                      0, dim * ncontexts),
+          minus_chunk(minus_ref, gauss * (dim + 1), dim + 1,
+                      0, dim * ncontexts);
+      AddOuterProductPlusMinus(static_cast<BaseFloat>(1.0), input_chunk,
+                               intermed_feat_deriv.Row(t),
+                               &plus_chunk, &minus_chunk);
+    }
+  }
+  AssertEqual(plus, plus_ref);
+  AssertEqual(minus, minus_ref);
+}
+
 }
 
 
@@ -172,6 +274,10 @@ int main() {
   kaldi::g_kaldi_verbose_level = 5;
   for (int i = 0; i <= 10; i++)
     kaldi::TestFmpe();
+  for (int i = 0; i < 10; i++)
+    kaldi::TestFmpeThreaded();
+  for (int i = 0; i < 10; i++)
+    kaldi::TestFmpeProjectionReverse();
   std::cout << "Test OK.\n";
 }
 
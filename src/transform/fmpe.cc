@@ -23,6 +23,7 @@
 #include "gmm/diag-gmm-normal.h"
 #include "gmm/am-diag-gmm.h"
 #include "hmm/transition-model.h"
+#include "thread/kaldi-thread.h"
 
 namespace kaldi {
 
@@ -104,21 +105,18 @@ void Fmpe::ApplyContext(const MatrixBase<BaseFloat> &intermed_feat,
                && feat_out->NumCols() == dim);
   // note: ncontexts == contexts_.size().
   for (int32 i = 0; i < ncontexts; i++) {
-    // this_intermed_feat is the chunk of the "intermediate features"
-    // that corresponds to this "context"
-    SubMatrix<BaseFloat> this_intermed_feat(intermed_feat, 0, T,
-                                            dim*i, dim);
     for (int32 j = 0; j < static_cast<int32>(contexts_[i].size()); j++) {
       int32 t_offset = contexts_[i][j].first;
       BaseFloat weight = contexts_[i][j].second;
-      // Note: we could do this more efficiently using matrix operations,
-      // but this doesn't dominate the computation and I think this is
-      // clearer.
-      for (int32 t_out = 0; t_out < T; t_out++) { // t_out indexes the output
-        int32 t_in = t_out + t_offset; // t_in indexes the input.
-        if (t_in >= 0 && t_in < T) // Discard frames outside range.
-          feat_out->Row(t_out).AddVec(weight, this_intermed_feat.Row(t_in));
-      }
+      // Output frame t_out gets input frame t_in = t_out + t_offset, for the
+      // frames where t_in is in range; we do all those frames at once.
+      int32 t_out_begin = std::max(0, -t_offset),
+          t_out_end = std::min(T, T - t_offset),
+          num_frames = t_out_end - t_out_begin;
+      if (num_frames <= 0) continue;
+      feat_out->RowRange(t_out_begin, num_frames).AddMat(
+          weight, intermed_feat.Range(t_out_begin + t_offset, num_frames,
+                                      dim * i, dim));
     }
   }
 }
@@ -135,89 +133,213 @@ void Fmpe::ApplyContextReverse(const MatrixBase<BaseFloat> &feat_deriv,
                && feat_deriv.NumCols() == dim);
   // note: ncontexts == contexts_.size().
   for (int32 i = 0; i < ncontexts; i++) {
-    // this_intermed_feat is the chunk of the derivative of
-    // "intermediate features" that corresponds to this "context"
-    // (this is output, in this routine).
-    SubMatrix<BaseFloat> this_intermed_feat_deriv(*intermed_feat_deriv, 0, T,
-                                                  dim*i, dim);
     for (int32 j = 0; j < static_cast<int32>(contexts_[i].size()); j++) {
       int32 t_offset = contexts_[i][j].first;
       BaseFloat weight = contexts_[i][j].second;
-      // Note: we could do this more efficiently using matrix operations,
-      // but this doesn't dominate the computation and I think this is
-      // clearer.
-      for (int32 t_out = 0; t_out < T; t_out++) { // t_out indexes the output
-        int32 t_in = t_out + t_offset; // t_in indexes the input.
-        if (t_in >= 0 && t_in < T) // Discard frames outside range.
-          this_intermed_feat_deriv.Row(t_in).AddVec(weight,
-                                                    feat_deriv.Row(t_out));
-        // Note: the line above is where the work happens; it's the same
-        // as in ApplyContext except reversing the input and output.
-      }
+      // The same as in ApplyContext except reversing the input and output.
+      int32 t_out_begin = std::max(0, -t_offset),
+          t_out_end = std::min(T, T - t_offset),
+          num_frames = t_out_end - t_out_begin;
+      if (num_frames <= 0) continue;
+      intermed_feat_deriv->Range(t_out_begin + t_offset, num_frames,
+                                 dim * i, dim).AddMat(
+          weight, feat_deriv.RowRange(t_out_begin, num_frames));
     }
   }
 }
 
 void Fmpe::ApplyC(MatrixBase<BaseFloat> *feat_out, bool reverse) const {
-  int32 T = feat_out->NumRows();
-  Vector<BaseFloat> tmp(feat_out->NumCols());
-  for (int32 t = 0; t < T; t++) {
-    SubVector<BaseFloat> row(*feat_out, t);
-    // Next line does: tmp = C_ * row
-    tmp.AddTpVec(1.0, C_, (reverse ? kTrans : kNoTrans), row, 0.0);
-    row.CopyFromVec(tmp);
+  // Each row is multiplied by C_ (or C_^T if reverse == true), i.e. the matrix
+  // is multiplied on the right by C_^T (or C_).
+  Matrix<BaseFloat> tmp(feat_out->NumRows(), feat_out->NumCols(), kUndefined);
+  tmp.AddMatTp(1.0, *feat_out, kNoTrans, C_, (reverse ? kNoTrans : kTrans),
+               0.0);
+  feat_out->CopyFromMat(tmp);
+}
+
+void Fmpe::ComputePosteriors(const MatrixBase<BaseFloat> &feat_in,
+                             const std::vector<std::vector<int32> > &gselect,
+                             int32 begin_frame, int32 end_frame,
+                             PostList *posts) const {
+  Vector<BaseFloat> post; // will be posteriors of selected Gaussians.
+  for (int32 t = begin_frame; t < end_frame; t++) {
+    SubVector<BaseFloat> this_feat(feat_in, t);
+    gmm_.LogLikelihoodsPreselect(this_feat, gselect[t], &post);
+    // At this point, post will contain log-likes of the selected
+    // Gaussians.
+    post.ApplySoftMax(); // Now they are posteriors (which sum to one).
+    for (int32 i = 0; i < post.Dim(); i++) {
+      int32 gauss = gselect[t][i];
+      posts->push_back(std::make_pair(std::make_pair(gauss, t), post(i)));
+    }
+  }
+}
+
+void Fmpe::GetInputChunks(const MatrixBase<BaseFloat> &feat_in,
+                          const PostList &posts, int32 begin, int32 end,
+                          MatrixBase<BaseFloat> *input_chunks) const {
+  int32 dim = FeatDim(), gauss = posts[begin].first.first;
+  KALDI_ASSERT(input_chunks->NumRows() == end - begin &&
+               input_chunks->NumCols() == dim + 1);
+  SubVector<BaseFloat> this_stddev(stddevs_, gauss),
+      this_mean_invvar(gmm_.means_invvars(), gauss);
+  for (int32 j = 0; j < end - begin; j++) {
+    // To understand this code, first examine code and comments in the
+    // "non-optimized" code in ApplyProjectionRange().
+    int32 t = posts[begin + j].first.second;
+    SubVector<BaseFloat> this_feat(feat_in, t);
+    SubVector<BaseFloat> this_input_chunk(*input_chunks, j);
+    BaseFloat this_post = posts[begin + j].second;
+    this_input_chunk.Range(0, dim).AddVecVec(-this_post,
+                                             this_mean_invvar,
+                                             this_stddev, 0.0);
+    this_input_chunk.Range(0, dim).AddVecDivVec(this_post, this_feat,
+                                                this_stddev, 1.0);
+    this_input_chunk(dim) = this_post * config_.post_scale;
   }
 }
 
+// This class is used to do ApplyProjection() multi-threaded; each thread
+// handles a block of frames.
+class FmpeApplyProjectionClass: public MultiThreadable {
+ public:
+  FmpeApplyProjectionClass(const Fmpe &fmpe,
+                           const MatrixBase<BaseFloat> &feat_in,
+                           const std::vector<std::vector<int32> > &gselect,
+                           MatrixBase<BaseFloat> *intermed_feat):
+      fmpe_(fmpe), feat_in_(feat_in), gselect_(gselect),
+      intermed_feat_(intermed_feat) { }
+
+  void operator () () {
+    int32 T = feat_in_.NumRows(),
+        begin_frame = (T * thread_id_) / num_threads_,
+        end_frame = (T * (thread_id_ + 1)) / num_threads_;
+    fmpe_.ApplyProjectionRange(feat_in_, gselect_, begin_frame, end_frame,
+                               intermed_feat_);
+  }
+ private:
+  const Fmpe &fmpe_;
+  const MatrixBase<BaseFloat> &feat_in_;
+  const std::vector<std::vector<int32> > &gselect_;
+  MatrixBase<BaseFloat> *intermed_feat_;
+};
+
+// This class is used to compute the Gaussian posteriors multi-threaded, for
+// ApplyProjectionReverse(); each thread handles a block of frames, and the
+// results are appended to *posts in the destructor.
+class FmpeComputePosteriorsClass: public MultiThreadable {
+ public:
+  FmpeComputePosteriorsClass(const Fmpe &fmpe,
+                             const MatrixBase<BaseFloat> &feat_in,
+                             const std::vector<std::vector<int32> > &gselect,
+                             Fmpe::PostList *posts):
+      fmpe_(fmpe), feat_in_(feat_in), gselect_(gselect), posts_ptr_(posts) { }
+
+  void operator () () {
+    int32 T = feat_in_.NumRows(),
+        begin_frame = (T * thread_id_) / num_threads_,
+        end_frame = (T * (thread_id_ + 1)) / num_threads_;
+    fmpe_.ComputePosteriors(feat_in_, gselect_, begin_frame, end_frame,
+                            &posts_);
+  }
+
+  ~FmpeComputePosteriorsClass() {
+    posts_ptr_->insert(posts_ptr_->end(), posts_.begin(), posts_.end());
+  }
+ private:
+  const Fmpe &fmpe_;
+  const MatrixBase<BaseFloat> &feat_in_;
+  const std::vector<std::vector<int32> > &gselect_;
+  Fmpe::PostList *posts_ptr_;
+  Fmpe::PostList posts_;
+};
+
+// This class is used to do ApplyProjectionReverse() multi-threaded, once we
+// have the sorted posteriors; each thread handles a range of Gaussians, so
+// they write to different parts of the stats.
+class FmpeApplyProjectionReverseClass: public MultiThreadable {
+ public:
+  FmpeApplyProjectionReverseClass(
+      const Fmpe &fmpe, const MatrixBase<BaseFloat> &feat_in,
+      const Fmpe::PostList &posts,
+      const MatrixBase<BaseFloat> &intermed_feat_deriv,
+      MatrixBase<BaseFloat> *proj_deriv_plus,
+      MatrixBase<BaseFloat> *proj_deriv_minus):
+      fmpe_(fmpe), feat_in_(feat_in), posts_(posts),
+      intermed_feat_deriv_(intermed_feat_deriv),
+      proj_deriv_plus_(proj_deriv_plus), proj_deriv_minus_(proj_deriv_minus) { }
+
+  void operator () () {
+    int32 begin = Boundary(thread_id_), end = Boundary(thread_id_ + 1);
+    if (begin < end)
+      fmpe_.ApplyProjectionReverseRange(feat_in_, posts_, begin, end,
+                                        intermed_feat_deriv_,
+                                        proj_deriv_plus_, proj_deriv_minus_);
+  }
+ private:
+  // Returns the start of the range of posteriors for thread i, which is
+  // moved forward to where the Gaussian index changes.
+  int32 Boundary(int32 i) const {
+    int32 size = posts_.size(),
+        b = static_cast<int32>((static_cast<int64>(size) * i) / num_threads_);
+    while (b > 0 && b < size &&
+           posts_[b].first.first == posts_[b - 1].first.first)
+      b++;
+    return b;
+  }
+  const Fmpe &fmpe_;
+  const MatrixBase<BaseFloat> &feat_in_;
+  const Fmpe::PostList &posts_;
+  const MatrixBase<BaseFloat> &intermed_feat_deriv_;
+  MatrixBase<BaseFloat> *proj_deriv_plus_;
+  MatrixBase<BaseFloat> *proj_deriv_minus_;
+};
+
+
 // Constructs the high-dim features and applies the main projection matrix
 // projT_.  This projects from dimension ngauss*(dim+1) to dim*ncontexts.  Note:
 // because the input vector of size ngauss*(dim+1) is sparse in a blocky way
 // (i.e. each frame only has a couple of nonzero posteriors), we deal with
 // sub-matrices of the projection matrix projT_.  We actually further optimize
-// the code by taking all frames in a file that had nonzero posteriors for a
+// the code by taking all frames in a block that had nonzero posteriors for a
 // particular Gaussian, and forming a matrix out of the corresponding
 // high-dimensional features; we can then use a matrix-matrix multiply rather
-// than using vector-matrix operations.
+// than using vector-matrix operations.  The blocks of frames are processed
+// in parallel if num_threads > 1.
 
 void Fmpe::ApplyProjection(const MatrixBase<BaseFloat> &feat_in,
                            const std::vector<std::vector<int32> > &gselect,
-                           MatrixBase<BaseFloat> *intermed_feat) const {
-  int32 dim = FeatDim(), ncontexts = NumContexts();  
-  
-  Vector<BaseFloat> post; // will be posteriors of selected Gaussians.
-  Vector<BaseFloat> input_chunk(dim+1); // will be a segment of
-  // the high-dimensional features.
+                           MatrixBase<BaseFloat> *intermed_feat,
+                           int32 num_threads) const {
+  FmpeApplyProjectionClass c(*this, feat_in, gselect, intermed_feat);
+  // num_threads == 0 to MultiThreader means: run in this thread.
+  MultiThreader<FmpeApplyProjectionClass> m(num_threads > 1 ? num_threads : 0,
+                                            c);
+}
+
+void Fmpe::ApplyProjectionRange(const MatrixBase<BaseFloat> &feat_in,
+                                const std::vector<std::vector<int32> > &gselect,
+                                int32 begin_frame, int32 end_frame,
+                                MatrixBase<BaseFloat> *intermed_feat) const {
+  int32 dim = FeatDim(), ncontexts = NumContexts();
 
   // "all_posts" is a vector of ((gauss-index, time-index), gaussian
   // posterior).
   // We'll compute the posterior information, sort it, and then
   // go through it in sorted order, which maintains memory locality
   // when accessing the projection matrix.
-  // Note: if we really cared we could make this use level-3 BLAS
-  // (matrix-matrix multiply), but we'd need to have a temporary
-  // matrix for the output and input.
-  std::vector<std::pair<std::pair<int32, int32>, BaseFloat> > all_posts;
-  
-  for (int32 t = 0; t < feat_in.NumRows(); t++) {
-    SubVector<BaseFloat> this_feat(feat_in, t);
-    gmm_.LogLikelihoodsPreselect(this_feat, gselect[t], &post);
-    // At this point, post will contain log-likes of the selected
-    // Gaussians.
-    post.ApplySoftMax(); // Now they are posteriors (which sum to one).
-    for (int32 i = 0; i < post.Dim(); i++) {
-      int32 gauss = gselect[t][i];
-      all_posts.push_back(std::make_pair(std::make_pair(gauss, t), post(i)));
-    }
-  }
+  PostList all_posts;
+  ComputePosteriors(feat_in, gselect, begin_frame, end_frame, &all_posts);
   std::sort(all_posts.begin(), all_posts.end());
-  
+
   bool optimize = true;
 
   if (!optimize) { // Why do we keep this un-optimized code around?
-    // For clarity, so you can see what's going on, and for easier
-    // comparision with ApplyProjectionReverse which is similar to this
-    // un-optimized segment.  Both un-optimized and optimized versions
-    // should give identical transforms (up to tiny roundoff differences).
+    // For clarity, so you can see what's going on.  Both un-optimized and
+    // optimized versions should give identical transforms (up to tiny
+    // roundoff differences).
+    Vector<BaseFloat> input_chunk(dim+1); // will be a segment of
+    // the high-dimensional features.
     for (size_t i = 0; i < all_posts.size(); i++) {
       int32 gauss = all_posts[i].first.first, t = all_posts[i].first.second;
       SubVector<BaseFloat> this_feat(feat_in, t);
@@ -250,8 +372,6 @@ void Fmpe::ApplyProjection(const MatrixBase<BaseFloat> &feat_in,
     // the same Gaussian index (but different times).
     while (i < all_posts.size()) {
       int32 gauss = all_posts[i].first.first;
-      SubVector<BaseFloat> this_stddev(stddevs_, gauss),
-          this_mean_invvar(gmm_.means_invvars(), gauss);
       SubMatrix<BaseFloat> this_projT_chunk(projT_, gauss*(dim+1), dim+1,
                                             0, dim*ncontexts);
       int32 batch_size; // number of posteriors with same Gaussian..
@@ -261,20 +381,7 @@ void Fmpe::ApplyProjection(const MatrixBase<BaseFloat> &feat_in,
            batch_size++); // empty loop body.
       Matrix<BaseFloat> input_chunks(batch_size, dim+1);
       Matrix<BaseFloat> intermed_temp(batch_size, dim*ncontexts);
-      for (int32 j = 0; j < batch_size; j++) { // set up "input_chunks".
-        // To understand this code, first examine code and comments in "non-optimized"
-        // code chunk above (the other branch of the if/else statement).
-        int32 t = all_posts[i+j].first.second;
-        SubVector<BaseFloat> this_feat(feat_in, t);
-        SubVector<BaseFloat> this_input_chunk(input_chunks, j);
-        BaseFloat this_post = all_posts[i+j].second;
-        this_input_chunk.Range(0, dim).AddVecVec(-this_post,
-                                                 this_mean_invvar,
-                                                 this_stddev, 0.0);
-        this_input_chunk.Range(0, dim).AddVecDivVec(this_post, this_feat,
-                                                    this_stddev, 1.0);
-        this_input_chunk(dim) = this_post * config_.post_scale;
-      }
+      GetInputChunks(feat_in, all_posts, i, i + batch_size, &input_chunks);
       // The next line is where most of the computation will happen,
       // during the feature computation phase.  We have rearranged
       // stuff so it's a matrix-matrix operation, for greater
@@ -292,7 +399,7 @@ void Fmpe::ApplyProjection(const MatrixBase<BaseFloat> &feat_in,
       i += batch_size;
     }
   }
-}      
+}
 
 
 
@@ -303,85 +410,100 @@ void Fmpe::ApplyProjectionReverse(const MatrixBase<BaseFloat> &feat_in,
                                   const std::vector<std::vector<int32> > &gselect,
                                   const MatrixBase<BaseFloat> &intermed_feat_deriv,
                                   MatrixBase<BaseFloat> *proj_deriv_plus,
-                                  MatrixBase<BaseFloat> *proj_deriv_minus) const {
-  int32 dim = FeatDim(), ncontexts = NumContexts();  
-  
-  Vector<BaseFloat> post; // will be posteriors of selected Gaussians.
-  Vector<BaseFloat> input_chunk(dim+1); // will be a segment of
-  // the high-dimensional features.
-
+                                  MatrixBase<BaseFloat> *proj_deriv_minus,
+                                  int32 num_threads) const {
   // "all_posts" is a vector of ((gauss-index, time-index), gaussian
   // posterior).
   // We'll compute the posterior information, sort it, and then
   // go through it in sorted order, which maintains memory locality
   // when accessing the projection matrix.
-  std::vector<std::pair<std::pair<int32, int32>, BaseFloat> > all_posts;
-  
-  for (int32 t = 0; t < feat_in.NumRows(); t++) {
-    SubVector<BaseFloat> this_feat(feat_in, t);
-    gmm_.LogLikelihoodsPreselect(this_feat, gselect[t], &post);
-    // At this point, post will contain log-likes of the selected
-    // Gaussians.
-    post.ApplySoftMax(); // Now they are posteriors (which sum to one).
-    for (int32 i = 0; i < post.Dim(); i++) {
-      // The next few lines (where we set up "input_chunk") are identical
-      // to ApplyProjection.
-      int32 gauss = gselect[t][i];
-      all_posts.push_back(std::make_pair(std::make_pair(gauss, t), post(i)));
-    }
+  PostList all_posts;
+  // num_threads == 0 to MultiThreader means: run in this thread.
+  if (num_threads < 2) num_threads = 0;
+  {
+    FmpeComputePosteriorsClass c(*this, feat_in, gselect, &all_posts);
+    MultiThreader<FmpeComputePosteriorsClass> m(num_threads, c);
   }
   std::sort(all_posts.begin(), all_posts.end());
-  for (size_t i = 0; i < all_posts.size(); i++) {
-    int32 gauss = all_posts[i].first.first, t = all_posts[i].first.second;
-    BaseFloat this_post = all_posts[i].second;
-    SubVector<BaseFloat> this_feat(feat_in, t);    
-    SubVector<BaseFloat> this_intermed_feat_deriv(intermed_feat_deriv, t);
-    SubVector<BaseFloat> this_stddev(stddevs_, gauss);
-    input_chunk.Range(0, dim).AddVecVec(-this_post, gmm_.means_invvars().Row(gauss),
-                                        this_stddev, 0.0);
-    input_chunk.Range(0, dim).AddVecDivVec(this_post, this_feat, this_stddev,
-                                           1.0);
-    input_chunk(dim) = this_post * config_.post_scale;
-
-    // If not for accumulating the + and - parts separately, we would be
-    // doing something like:
-    // proj_deriv_.Range(0, dim*ncontexts, gauss*(dim+1), dim+1).AddVecVec(
-    //                    1.0, this_intermed_feat_deriv, input_chunk);
-
-
-    SubMatrix<BaseFloat> plus_chunk(*proj_deriv_plus, 
+  {
+    FmpeApplyProjectionReverseClass c(*this, feat_in, all_posts,
+                                      intermed_feat_deriv,
+                                      proj_deriv_plus, proj_deriv_minus);
+    MultiThreader<FmpeApplyProjectionReverseClass> m(num_threads, c);
+  }
+}
+
+void Fmpe::ApplyProjectionReverseRange(
+    const MatrixBase<BaseFloat> &feat_in,
+    const PostList &all_posts, int32 begin, int32 end,
+    const MatrixBase<BaseFloat> &intermed_feat_deriv,
+    MatrixBase<BaseFloat> *proj_deriv_plus,
+    MatrixBase<BaseFloat> *proj_deriv_minus) const {
+  int32 dim = FeatDim(), ncontexts = NumContexts();
+
+  // As in ApplyProjectionRange(), we process the posteriors in batches with
+  // the same Gaussian index.  The positive part of a product a_i b_j is
+  // a+_i b+_j + a-_i b-_j and its negative part is a+_i b-_j + a-_i b+_j,
+  // where a+ = max(a, 0) and a- = max(-a, 0); so if the rows of A are the
+  // input chunks and the rows of B the intermediate derivatives,
+  // plus_chunk += A+^T B+ + A-^T B- and minus_chunk += A+^T B- + A-^T B+,
+  // which are matrix-matrix operations.
+  int32 i = begin;
+  while (i < end) {
+    int32 gauss = all_posts[i].first.first;
+    int32 batch_size; // number of posteriors with same Gaussian..
+    for (batch_size = 0;
+         batch_size + i < end &&
+             all_posts[batch_size+i].first.first == gauss;
+         batch_size++); // empty loop body.
+    Matrix<BaseFloat> input_plus(batch_size, dim+1, kUndefined),
+        deriv_plus(batch_size, dim*ncontexts, kUndefined);
+    GetInputChunks(feat_in, all_posts, i, i + batch_size, &input_plus);
+    for (int32 j = 0; j < batch_size; j++) {
+      int32 t = all_posts[i+j].first.second;
+      deriv_plus.Row(j).CopyFromVec(intermed_feat_deriv.Row(t));
+    }
+    Matrix<BaseFloat> input_minus(input_plus), deriv_minus(deriv_plus);
+    input_plus.ApplyFloor(0.0);
+    input_minus.Scale(-1.0);
+    input_minus.ApplyFloor(0.0);
+    deriv_plus.ApplyFloor(0.0);
+    deriv_minus.Scale(-1.0);
+    deriv_minus.ApplyFloor(0.0);
+
+    SubMatrix<BaseFloat> plus_chunk(*proj_deriv_plus,
                                     gauss*(dim+1), dim+1,
                                     0, dim*ncontexts),
-        minus_chunk(*proj_deriv_minus, 
+        minus_chunk(*proj_deriv_minus,
                     gauss*(dim+1), dim+1,
                     0, dim*ncontexts);
-          
-    // This next function takes the rank-one matrix
-    //  (input_chunk * this_intermed_deriv'), and adds the positive
-    // part to proj_deriv_plus, and minus the negative part to
-    // proj_deriv_minus.
-    AddOuterProductPlusMinus(static_cast<BaseFloat>(1.0),
-                             input_chunk,
-                             this_intermed_feat_deriv,
-                             &plus_chunk, &minus_chunk);
+    plus_chunk.AddMatMat(1.0, input_plus, kTrans, deriv_plus, kNoTrans, 1.0);
+    plus_chunk.AddMatMat(1.0, input_minus, kTrans, deriv_minus, kNoTrans,
+                         1.0);
+    minus_chunk.AddMatMat(1.0, input_plus, kTrans, deriv_minus, kNoTrans,
+                          1.0);
+    minus_chunk.AddMatMat(1.0, input_minus, kTrans, deriv_plus, kNoTrans,
+                          1.0);
+    i += batch_size;
   }
-}      
+}
 
 void Fmpe::ComputeFeatures(const MatrixBase<BaseFloat> &feat_in,
                            const std::vector<std::vector<int32> > &gselect,
-                           Matrix<BaseFloat> *feat_out) const {
+                           Matrix<BaseFloat> *feat_out,
+                           int32 num_threads) const {
   int32 dim = FeatDim();
   KALDI_ASSERT(feat_in.NumRows() != 0 && feat_in.NumCols() == dim);
   KALDI_ASSERT(feat_in.NumRows() == static_cast<int32>(gselect.size()));
   feat_out->Resize(feat_in.NumRows(), feat_in.NumCols()); // will zero it.
-  
+
   // Intermediate-dimension features
   Matrix<BaseFloat> intermed_feat(feat_in.NumRows(),
                                   dim * NumContexts());
 
   // Apply the main projection, from high-dim to intermediate
   // dimension (dim * NumContexts()).
-  ApplyProjection(feat_in, gselect, &intermed_feat);
+  ApplyProjection(feat_in, gselect, &intermed_feat, num_threads);
 
   // Apply the temporal context and reduces from
   // dimension dim*ncontexts to dim.
@@ -396,7 +518,8 @@ void Fmpe::AccStats(const MatrixBase<BaseFloat> &feat_in,
                     const std::vector<std::vector<int32> > &gselect,
                     const MatrixBase<BaseFloat> &direct_feat_deriv,
                     const MatrixBase<BaseFloat> *indirect_feat_deriv, // may be NULL
-                    FmpeStats *fmpe_stats) const {
+                    FmpeStats *fmpe_stats,
+                    int32 num_threads) const {
   SubMatrix<BaseFloat> stats_plus(fmpe_stats->DerivPlus());
   SubMatrix<BaseFloat> stats_minus(fmpe_stats->DerivMinus());
   int32 dim = FeatDim(), ncontexts = NumContexts();
@@ -419,10 +542,11 @@ void Fmpe::AccStats(const MatrixBase<BaseFloat> &feat_in,
   ApplyContextReverse(feat_deriv, &intermed_feat_deriv);
   
   ApplyProjectionReverse(feat_in, gselect, intermed_feat_deriv,
-                         &stats_plus, &stats_minus);
+                         &stats_plus, &stats_minus, num_threads);
 }
 
 
+
 void FmpeOptions::Write(std::ostream &os, bool binary) const {
   WriteToken(os, binary, context_expansion);
   WriteBasicType(os, binary, post_scale);
@@ -157,18 +157,23 @@ class Fmpe {
   // Requires the Gaussian-selection info, which would normally
   // be computed by a separate program-- this consists of
   // lists of the top-scoring Gaussians for these features.
+  // If num_threads > 1, the blocks of frames are processed in parallel.
   void ComputeFeatures(const MatrixBase<BaseFloat> &feat_in,
                        const std::vector<std::vector<int32> > &gselect,
-                       Matrix<BaseFloat> *feat_out) const;
+                       Matrix<BaseFloat> *feat_out,
+                       int32 num_threads = 1) const;
 
   // For training-- compute the derivative w.r.t the projection matrix
   // (we keep the positive and negative parts separately to help
-  // set the learning rates).
+  // set the learning rates).  If num_threads > 1, the Gaussian posteriors are
+  // computed in parallel for blocks of frames, and the stats for different
+  // ranges of Gaussians are accumulated in parallel.
   void AccStats(const MatrixBase<BaseFloat> &feat_in,
                 const std::vector<std::vector<int32> > &gselect,
                 const MatrixBase<BaseFloat> &direct_feat_deriv,
                 const MatrixBase<BaseFloat> *indirect_feat_deriv, // may be NULL
-                FmpeStats *stats) const;
+                FmpeStats *stats,
+                int32 num_threads = 1) const;
   
   // Note: the form on disk starts with the GMM; that way,
   // the gselect program can treat the fMPE object as if it
@@ -181,21 +186,62 @@ class Fmpe {
                    const FmpeStats &stats);
   
  private:
+  friend class FmpeApplyProjectionClass;
+  friend class FmpeComputePosteriorsClass;
+  friend class FmpeApplyProjectionReverseClass;
+  friend void TestFmpeProjectionReverse();
+
+  // A list of ((gauss-index, time-index), gaussian posterior).
+  typedef std::vector<std::pair<std::pair<int32, int32>, BaseFloat> > PostList;
+
   void SetContexts(std::string context_str);
   void ComputeC(); // Computes the Cholesky factor C, from the GMM.
   void ComputeStddevs();
 
+  // Appends to "posts" the posteriors of the selected Gaussians for frames
+  // begin_frame <= t < end_frame.
+  void ComputePosteriors(const MatrixBase<BaseFloat> &feat_in,
+                         const std::vector<std::vector<int32> > &gselect,
+                         int32 begin_frame, int32 end_frame,
+                         PostList *posts) const;
+
+  // Sets the rows of "input_chunks" to the segments of the high-dimensional
+  // features for posts[begin] ... posts[end-1], which must all be for the
+  // same Gaussian.
+  void GetInputChunks(const MatrixBase<BaseFloat> &feat_in,
+                      const PostList &posts, int32 begin, int32 end,
+                      MatrixBase<BaseFloat> *input_chunks) const;
+
   // Constructs the high-dim features and applies the main projection matrix proj_.
   void ApplyProjection(const MatrixBase<BaseFloat> &feat_in,
                        const std::vector<std::vector<int32> > &gselect,
-                       MatrixBase<BaseFloat> *intermed_feat) const;
+                       MatrixBase<BaseFloat> *intermed_feat,
+                       int32 num_threads) const;
+
+  // ApplyProjection for frames begin_frame <= t < end_frame; it only writes
+  // those rows of intermed_feat.
+  void ApplyProjectionRange(const MatrixBase<BaseFloat> &feat_in,
+                            const std::vector<std::vector<int32> > &gselect,
+                            int32 begin_frame, int32 end_frame,
+                            MatrixBase<BaseFloat> *intermed_feat) const;
 
   // The same in reverse, for computing derivatives.
   void ApplyProjectionReverse(const MatrixBase<BaseFloat> &feat_in,
                               const std::vector<std::vector<int32> > &gselect,
                               const MatrixBase<BaseFloat> &intermed_feat_deriv,
                               MatrixBase<BaseFloat> *proj_deriv_plus,
-                              MatrixBase<BaseFloat> *proj_deriv_minus) const;
+                              MatrixBase<BaseFloat> *proj_deriv_minus,
+                              int32 num_threads) const;
+
+  // ApplyProjectionReverse for the sorted posteriors all_posts[begin] ...
+  // all_posts[end-1]; it only writes the parts of proj_deriv_plus and
+  // proj_deriv_minus for the Gaussians in that range.
+  void ApplyProjectionReverseRange(
+      const MatrixBase<BaseFloat> &feat_in,
+      const PostList &all_posts, int32 begin, int32 end,
+      const MatrixBase<BaseFloat> &intermed_feat_deriv,
+      MatrixBase<BaseFloat> *proj_deriv_plus,
+      MatrixBase<BaseFloat> *proj_deriv_minus) const;
 
   // Applies the temporal context splicing from the intermediate
   // features-- adds the result to feat_out which at this point
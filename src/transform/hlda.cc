@@ -21,6 +21,7 @@
 #include "util/common-utils.h"
 #include "transform/hlda.h"
 #include "transform/mllt.h"
+#include "thread/kaldi-thread.h"
 
 namespace kaldi {
 
@@ -189,11 +190,102 @@ AccumulateFromPosteriors(int32 pdf_id,
 }
 
 
+void HldaAccsDiagGmm::AccumulateFromPosteriors(
+    const AmDiagGmm &am,
+    const std::vector<int32> &pdf_ids,
+    const MatrixBase<BaseFloat> &data,
+    const std::vector<Vector<BaseFloat> > &posteriors) {
+  int32 num_frames = data.NumRows(), model_dim = S_.size() - 1,
+      feat_dim = data.NumCols();
+  KALDI_ASSERT(static_cast<int32>(pdf_ids.size()) == num_frames &&
+               static_cast<int32>(posteriors.size()) == num_frames);
+  KALDI_ASSERT(feat_dim == FeatureDim()
+               && "Feature dim mismatch in HLDA computation ");
+  Matrix<double> data_dbl(data);
+  // scales(i, t) is the weight of frame t in S_[i]: the sum over Gaussians of
+  // the posterior times the i'th inverse variance, or for i == model_dim just
+  // of the posterior.  It is zero for frames left out of the subset of the
+  // data we accumulate the full stats on, if speedup_ != 1.0.
+  Matrix<double> scales(model_dim + 1, num_frames);
+  std::vector<bool> in_subset(num_frames, true);
+  for (int32 t = 0; t < num_frames; t++) {
+    int32 pdf_id = pdf_ids[t];
+    KALDI_ASSERT(static_cast<size_t>(pdf_id) < occs_.size()
+                 && occs_[pdf_id].Dim() == posteriors[t].Dim());
+    if (speedup_ != 1.0 && RandUniform() > speedup_) {
+      in_subset[t] = false;
+      continue;
+    }
+    const Matrix<BaseFloat> &inv_vars = am.GetPdf(pdf_id).inv_vars();
+    const Vector<BaseFloat> &post = posteriors[t];
+    for (int32 i = 0; i < post.Dim(); i++) {
+      if (post(i) > 1.0e-05) {
+        for (int32 d = 0; d < model_dim; d++)
+          scales(d, t) += post(i) * inv_vars(i, d);
+        scales(model_dim, t) += post(i);
+      }
+    }
+  }
+  // This is most of the work, so we do it before taking the lock.
+  std::vector<SpMatrix<double> > S(model_dim + 1);
+  for (int32 i = 0; i <= model_dim; i++) {
+    S[i].Resize(feat_dim);
+    S[i].AddMat2Vec(1.0, data_dbl, kTrans, scales.Row(i), 0.0);
+  }
+
+  mutex_.Lock();
+  std::vector<Vector<double> > &occs = (speedup_ == 1.0 ? occs_ : occs_sub_);
+  std::vector<Matrix<double> > &mean_accs = (speedup_ == 1.0 ? mean_accs_ :
+                                             mean_accs_sub_);
+  for (int32 t = 0; t < num_frames; t++) {
+    int32 pdf_id = pdf_ids[t];
+    const Vector<BaseFloat> &post = posteriors[t];
+    SubVector<double> frame(data_dbl, t);
+    if (speedup_ != 1.0) {
+      // In any case, accumulate regular occs and means.
+      Vector<double> post_dbl(post);
+      occs_[pdf_id].AddVec(1.0, post_dbl);
+      mean_accs_[pdf_id].AddVecVec(1.0, post_dbl, frame);
+    }
+    if (!in_subset[t]) continue;
+    for (int32 i = 0; i < post.Dim(); i++) {
+      if (post(i) > 1.0e-05) {
+        occs[pdf_id](i) += post(i);
+        mean_accs[pdf_id].Row(i).AddVec(post(i), frame);
+      }
+    }
+  }
+  for (int32 i = 0; i <= model_dim; i++)
+    S_[i].AddSp(1.0, S[i]);
+  mutex_.Unlock();
+}
+
+// This class is used in HldaAccsDiagGmm::Update() to subtract from the G
+// matrices the outer products of a block of means, scaled by the occupancies
+// and inverse variances, in multiple threads.
+class HldaUpdateGClass: public MultiThreadable {
+ public:
+  HldaUpdateGClass(const MatrixBase<double> &means,
+                   const MatrixBase<double> &scales,
+                   std::vector<SpMatrix<double> > *G):
+      means_(means), scales_(scales), G_(G) { }
+  void operator () () {
+    for (int32 d = thread_id_; d < scales_.NumRows(); d += num_threads_)
+      (*G_)[d].AddMat2Vec(-1.0, means_, kTrans, scales_.Row(d), 1.0);
+  }
+ private:
+  const MatrixBase<double> &means_;  // a block of means, one per row.
+  const MatrixBase<double> &scales_;  // scales_(d, g) is occupancy times
+                                      // d'th inverse variance of mean g.
+  std::vector<SpMatrix<double> > *G_;
+};
+
 void HldaAccsDiagGmm::Update(AmDiagGmm *am,
                              MatrixBase<BaseFloat> *Mfull,
                              MatrixBase<BaseFloat> *M_out,
                              BaseFloat *objf_impr_out,
-                             BaseFloat *count_out) const {
+                             BaseFloat *count_out,
+                             int32 num_threads) const {
   KALDI_ASSERT(am != NULL && Mfull != NULL);
   KALDI_ASSERT(!S_.empty());
 
@@ -232,26 +324,38 @@ void HldaAccsDiagGmm::Update(AmDiagGmm *am,
   int32 num_pdfs = occs.size();
   Vector<double> tot_mean_acc(feat_dim);
   double tot_occ = 0.0;  // will be occ of subset of data, if speedup_ != 1.0
+  // update G matrices (subtracting outer-product of means, scaled by occ and
+  // inverse-var); has same effect as if G is summed outer product of (x-mu)^2,
+  // scaled by occ and inverse-var.  We do this for blocks of Gaussians as
+  // rank-k updates, in "num_threads" threads.
+  int32 block_size = 1024, num_in_block = 0;
+  Matrix<double> means(block_size, feat_dim), scales(model_dim, block_size);
   for (int32 p = 0; p < num_pdfs; p++) {
     int32 num_gauss = occs[p].Dim();
     const DiagGmm &gmm = am->GetPdf(p);
     KALDI_ASSERT(num_gauss == gmm.NumGauss());
     for (int32 g = 0; g < num_gauss; g++) {
       double occ = occs[p](g), inv_occ = (occ == 0.0 ? 0.0 : 1.0/occ);
-      Vector<double> mean(feat_dim);
-      mean.AddVec(inv_occ, mean_accs[p].Row(g));
+      means.Row(num_in_block).CopyFromVec(mean_accs[p].Row(g));
+      means.Row(num_in_block).Scale(inv_occ);
       tot_mean_acc.AddVec(1.0, mean_accs[p].Row(g));
       tot_occ += occ;
-      // update G matrices (subtracting outer-product of means, scaled by
-      // occ and inverse-var); has same effect as if G is summed outer product of
-      // (x-mu)^2, scaled by occ and inverse-var.
-
       SubVector<BaseFloat> inv_var(gmm.inv_vars(), g);  // this inv-var.
-      for (int32 d = 0; d < model_dim; d++) {
-        G[d].AddVec2(-1.0*occ*inv_var(d), mean);
+      for (int32 d = 0; d < model_dim; d++)
+        scales(d, num_in_block) = occ * inv_var(d);
+      if (++num_in_block == block_size) {
+        MultiThreader<HldaUpdateGClass> m(num_threads,
+                                          HldaUpdateGClass(means, scales, &G));
+        num_in_block = 0;
       }
     }
   }
+  if (num_in_block != 0) {
+    SubMatrix<double> block_means(means, 0, num_in_block, 0, feat_dim),
+        block_scales(scales, 0, model_dim, 0, num_in_block);
+    MultiThreader<HldaUpdateGClass> m(
+        num_threads, HldaUpdateGClass(block_means, block_scales, &G));
+  }
   KALDI_ASSERT(tot_occ > 0.0);
   Vector<double> tot_mean(tot_mean_acc);
   tot_mean.Scale(1.0 / tot_occ);
@@ -264,7 +368,7 @@ void HldaAccsDiagGmm::Update(AmDiagGmm *am,
   for (int32 d = 0; d < feat_dim; d++)
     KALDI_ASSERT(G[d].IsPosDef());
 
-  MlltAccs::Update(tot_occ, G, Mfull, objf_impr_out, count_out);
+  MlltAccs::Update(tot_occ, G, Mfull, objf_impr_out, count_out, num_threads);
 
   SubMatrix<BaseFloat> Mpart(*Mfull, 0, model_dim, 0, feat_dim);
   if (M_out) {
@@ -28,6 +28,7 @@
 #include "gmm/am-diag-gmm.h"
 #include "transform/transform-common.h"
 #include "transform/regression-tree.h"
+#include "thread/kaldi-mutex.h"
 
 namespace kaldi {
 
@@ -78,11 +79,13 @@ class HldaAccsDiagGmm {
   ///                  (feature-dim x orig-dim)
   ///  @param objf_impr_out [out] The objective function improvement
   ///  @param count_out [out] The data-count
+  ///  @param num_threads [in] The number of threads to use.
   void Update(AmDiagGmm *model,
               MatrixBase<BaseFloat> *Mfull,
               MatrixBase<BaseFloat> *M,
               BaseFloat *objf_impr_out,
-              BaseFloat *count_out) const;
+              BaseFloat *count_out,
+              int32 num_threads = 1) const;
 
   /// Accumulates stats (you have to first work out the posteriors yourself).
   void AccumulateFromPosteriors(int32 pdf_id,
@@ -90,6 +93,16 @@ class HldaAccsDiagGmm {
                                 const VectorBase<BaseFloat> &data,
                                 const VectorBase<BaseFloat> &posteriors);
 
+  /// Accumulates stats for a set of frames, e.g. an utterance: frame
+  /// data.Row(t) is aligned to pdf pdf_ids[t] of "am", and posteriors[t] are
+  /// its Gaussian-level posteriors (times any weight).  This is equivalent to
+  /// calling the version above for each frame, but faster, as the
+  /// full-dimensional stats are added as rank-k updates; it may be called
+  /// from multiple threads at once.
+  void AccumulateFromPosteriors(const AmDiagGmm &am,
+                                const std::vector<int32> &pdf_ids,
+                                const MatrixBase<BaseFloat> &data,
+                                const std::vector<Vector<BaseFloat> > &posteriors);
 
  private:
   std::vector<SpMatrix<double> > S_;  // the S matrices: [model-dim+1] matrices of size (feat-dim) x (feat-dim)
@@ -104,6 +117,8 @@ class HldaAccsDiagGmm {
   std::vector<Matrix<double> > mean_accs_sub_;
   BaseFloat sample_gconst_;  // a sample gconst from the model, as a check
   // that the user does not switch the model between accu and update.
+  Mutex mutex_;  // guards the stats, for the multi-frame
+  // AccumulateFromPosteriors().
 };
 
 
@@ -159,8 +159,18 @@ UnitTestEstimateLda() {
   LdaEstimate lda_est;
   lda_est.Init(num_class, dim);
   lda_est.ZeroAccumulators();
-  for (size_t i = 0; i < counter; i++) {
-    lda_est.Accumulate(feats.Row(i), feats_class[i]);
+  if (Rand() % 2 == 0) {
+    for (size_t i = 0; i < counter; i++) {
+      lda_est.Accumulate(feats.Row(i), feats_class[i]);
+    }
+  } else {
+    // Accumulate all the frames at once, with the weight split in two.
+    std::vector<std::vector<std::pair<int32, BaseFloat> > > post(counter);
+    for (size_t i = 0; i < counter; i++) {
+      post[i].push_back(std::make_pair(feats_class[i], 0.25));
+      post[i].push_back(std::make_pair(feats_class[i], 0.75));
+    }
+    lda_est.Accumulate(feats, post);
   }
   LdaEstimateOptions opts;
   opts.dim = dim;
@@ -54,6 +54,39 @@ void LdaEstimate::Accumulate(const VectorBase<BaseFloat> &data,
   total_second_acc_.AddVec2(weight, data_d);
 }
 
+void LdaEstimate::Accumulate(
+    const MatrixBase<BaseFloat> &data,
+    const std::vector<std::vector<std::pair<int32, BaseFloat> > > &post) {
+  int32 num_frames = data.NumRows();
+  KALDI_ASSERT(data.NumCols() == Dim() &&
+               static_cast<int32>(post.size()) == num_frames);
+  Matrix<double> data_d(data);
+  // total weight of each frame.
+  Vector<double> weights(num_frames);
+  for (int32 t = 0; t < num_frames; t++) {
+    for (size_t i = 0; i < post[t].size(); i++) {
+      KALDI_ASSERT(post[t][i].first >= 0 && post[t][i].first < NumClasses());
+      weights(t) += post[t][i].second;
+    }
+  }
+  // We work out the second-order stats of these frames before taking the lock,
+  // as this is most of the work.
+  SpMatrix<double> second_acc(Dim());
+  second_acc.AddMat2Vec(1.0, data_d, kTrans, weights, 0.0);
+
+  mutex_.Lock();
+  for (int32 t = 0; t < num_frames; t++) {
+    for (size_t i = 0; i < post[t].size(); i++) {
+      int32 class_id = post[t][i].first;
+      BaseFloat weight = post[t][i].second;
+      zero_acc_(class_id) += weight;
+      first_acc_.Row(class_id).AddVec(weight, data_d.Row(t));
+    }
+  }
+  total_second_acc_.AddSp(1.0, second_acc);
+  mutex_.Unlock();
+}
+
 void LdaEstimate::GetStats(SpMatrix<double> *total_covar,
                            SpMatrix<double> *between_covar,
                            Vector<double> *total_mean,
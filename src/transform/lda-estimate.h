@@ -23,6 +23,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "matrix/matrix-lib.h"
+#include "thread/kaldi-mutex.h"
 
 namespace kaldi {
 
@@ -74,6 +75,15 @@ class LdaEstimate {
   /// Accumulates data
   void Accumulate(const VectorBase<BaseFloat> &data, int32 class_id, BaseFloat weight = 1.0);
 
+  /// Accumulates the data of a set of frames, e.g. an utterance: post[t] is
+  /// a list of (class_id, weight) pairs for frame data.Row(t).  This is
+  /// faster than calling the version above for each frame, as the
+  /// second-order stats are added as a rank-k update, and it may be called
+  /// from multiple threads at once.
+  void Accumulate(const MatrixBase<BaseFloat> &data,
+                  const std::vector<std::vector<std::pair<int32, BaseFloat> > >
+                  &post);
+
   /// Estimates the LDA transform matrix m.  If Mfull != NULL, it also outputs
   /// the full matrix (without dimensionality reduction), which is useful for
   /// some purposes.  If opts.remove_offset == true, it will output both matrices
@@ -93,6 +103,7 @@ class LdaEstimate {
   Vector<double> zero_acc_;
   Matrix<double> first_acc_;
   SpMatrix<double> total_second_acc_;
+  Mutex mutex_;  // guards the stats, for the multi-frame Accumulate().
 
   /// This function modifies the LDA matrix so that it
   /// also subtracts the mean feature value.
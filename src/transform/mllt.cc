@@ -19,6 +19,7 @@
 
 #include "transform/mllt.h"
 #include "util/const-integer-set.h"
+#include "thread/kaldi-thread.h"
 
 namespace kaldi {
 
@@ -62,12 +63,31 @@ void MlltAccs::Write(std::ostream &os, bool binary) const {
   if(!binary) os << '\n';
 }
 
+// This class is used to invert the G matrices in multiple threads, in
+// MlltAccs::Update().
+class MlltInvertClass: public MultiThreadable {
+ public:
+  MlltInvertClass(const std::vector<SpMatrix<double> > &G,
+                  std::vector<SpMatrix<double> > *Ginv): G_(G), Ginv_(Ginv) { }
+  void operator () () {
+    for (size_t i = thread_id_; i < G_.size(); i += num_threads_) {
+      (*Ginv_)[i].Resize(G_[i].NumRows(), kUndefined);
+      (*Ginv_)[i].CopyFromSp(G_[i]);
+      (*Ginv_)[i].Invert();
+    }
+  }
+ private:
+  const std::vector<SpMatrix<double> > &G_;
+  std::vector<SpMatrix<double> > *Ginv_;
+};
+
 // static version of the Update function.
 void MlltAccs::Update(double beta,
                       const std::vector<SpMatrix<double> > &G,
                       MatrixBase<BaseFloat> *M_ptr,
                       BaseFloat *objf_impr_out,
-                      BaseFloat *count_out) {
+                      BaseFloat *count_out,
+                      int32 num_threads) {
   int32 dim = G.size();
   KALDI_ASSERT(dim != 0 && M_ptr != NULL
                && M_ptr->NumRows() == dim
@@ -84,22 +104,23 @@ void MlltAccs::Update(double beta,
   Matrix<double> M(dim, dim), Minv(dim, dim);
   M.CopyFromMat(*M_ptr);
   std::vector<SpMatrix<double> > Ginv(dim);
-  for (int32 i = 0; i < dim;  i++) {
-    Ginv[i].Resize(dim);
-    Ginv[i].CopyFromSp(G[i]);
-    Ginv[i].Invert();
+  {
+    // The destructor waits for the threads to finish.
+    MultiThreader<MlltInvertClass> m(num_threads, MlltInvertClass(G, &Ginv));
   }
+  Vector<double> cofactor(dim), delta(dim), delta_Minv(dim);
 
   double tot_objf_impr = 0.0;
   for (int32 p = 0; p < num_iters; p++) {
+    // We invert M at the start of each iteration, and update the inverse each
+    // time we change a row, which is much cheaper than inverting M again.
+    Minv.CopyFromMat(M);
+    Minv.Invert();
     for (int32 i = 0; i < dim; i++) {  // for each row
       SubVector<double> row(M, i);
       // work out cofactor (actually cofactor times a constant which
-      // doesn't affect anything):
-      Minv.CopyFromMat(M);
-      Minv.Invert();
-      Minv.Transpose();
-      SubVector<double> cofactor(Minv, i);
+      // doesn't affect anything), which is column i of M^{-1}:
+      cofactor.CopyColFromMat(Minv, i);
       // Objf is: beta log(|row . cofactor|) -0.5 row^T G[i] row
       // optimized by (c.f. Mark Gales's techreport "semitied covariance matrices
       // for hidden markov models, eq.  (22)),
@@ -107,6 +128,7 @@ void MlltAccs::Update(double beta,
       // here, "row" and "cofactor" are considered as column vectors.
       double objf_before = beta * Log(std::abs(VecVec(row, cofactor)))
           -0.5 * VecSpVec(row, G[i], row);
+      delta.CopyFromVec(row);
       // do eq. (1) above:
       row.AddSpVec(std::sqrt(beta / VecSpVec(cofactor, Ginv[i], cofactor)),
                    Ginv[i], cofactor, 0.0);
@@ -115,6 +137,14 @@ void MlltAccs::Update(double beta,
       if (objf_after < objf_before - fabs(objf_before)*0.00001)
         KALDI_ERR << "Objective decrease in MLLT update.";
       tot_objf_impr += objf_after - objf_before;
+      // M has changed by e_i d^T, where d = (new row) - (old row), so by the
+      // Sherman-Morrison formula M^{-1} changes by
+      // -(M^{-1} e_i) (d^T M^{-1}) / (1 + d^T M^{-1} e_i), where M^{-1} e_i is
+      // the cofactor, and since (old row) . cofactor = 1 the denominator is
+      // (new row) . cofactor.  Here, delta = -d.
+      delta.AddVec(-1.0, row);
+      delta_Minv.AddMatVec(1.0, Minv, kTrans, delta, 0.0);
+      Minv.AddVecVec(1.0 / VecVec(row, cofactor), cofactor, delta_Minv);
     }
     if (p < 10 || p % 10 == 0)
       KALDI_LOG << "MLLT objective improvement per frame by " << p
@@ -159,6 +189,86 @@ void MlltAccs::AccumulateFromPosteriors(const DiagGmm &gmm,
   Vector<double> data_dbl(data);
 }
 
+void MlltAccs::AccumulateOffsets(const MatrixBase<double> &offsets,
+                                 const MatrixBase<double> &scales,
+                                 std::vector<SpMatrix<double> > *G) {
+  KALDI_ASSERT(scales.NumRows() == static_cast<int32>(G->size()) &&
+               offsets.NumRows() == scales.NumCols());
+  for (size_t j = 0; j < G->size(); j++)
+    (*G)[j].AddMat2Vec(1.0, offsets, kTrans, scales.Row(j), 1.0);
+}
+
+BaseFloat MlltAccs::AccumulateFromGmms(
+    const std::vector<const DiagGmm*> &gmms,
+    const MatrixBase<BaseFloat> &data,
+    const VectorBase<BaseFloat> &weights,
+    const std::vector<std::vector<int32> > *gselect) {
+  int32 dim = Dim(), num_frames = data.NumRows();
+  KALDI_ASSERT(data.NumCols() == dim &&
+               static_cast<int32>(gmms.size()) == num_frames &&
+               weights.Dim() == num_frames &&
+               (gselect == NULL ||
+                static_cast<int32>(gselect->size()) == num_frames));
+  KALDI_ASSERT(rand_prune_ >= 0.0);
+  // We accumulate the stats of this set of frames in "G", and add them to G_
+  // at the end, so that other threads can accumulate at the same time.  The
+  // (frame, Gaussian) pairs are added to G in blocks of "block_size".
+  std::vector<SpMatrix<double> > G(dim);
+  for (int32 j = 0; j < dim; j++)
+    G[j].Resize(dim);
+  int32 block_size = 256, num_pairs = 0;
+  Matrix<double> offsets(block_size, dim), scales(dim, block_size);
+  Vector<BaseFloat> posteriors, loglikes, offset(dim);
+  double tot_loglike = 0.0, this_beta = 0.0;
+  for (int32 t = 0; t < num_frames; t++) {
+    const DiagGmm &gmm = *(gmms[t]);
+    KALDI_ASSERT(gmm.Dim() == dim);
+    SubVector<BaseFloat> frame(data, t);
+    BaseFloat weight = weights(t);
+    if (weight == 0.0) continue;
+    if (gselect == NULL) {
+      tot_loglike += weight * gmm.ComponentPosteriors(frame, &posteriors);
+      posteriors.Scale(weight);
+    } else {
+      const std::vector<int32> &this_gselect = (*gselect)[t];
+      KALDI_ASSERT(!this_gselect.empty());
+      gmm.LogLikelihoodsPreselect(frame, this_gselect, &loglikes);
+      tot_loglike += weight * loglikes.ApplySoftMax();
+      posteriors.Resize(gmm.NumGauss());
+      for (size_t i = 0; i < this_gselect.size(); i++)
+        posteriors(this_gselect[i]) = loglikes(i) * weight;
+    }
+    const Matrix<BaseFloat> &means_invvars = gmm.means_invvars(),
+        &inv_vars = gmm.inv_vars();
+    for (int32 i = 0; i < posteriors.Dim(); i++) {
+      BaseFloat posterior = RandPrune(posteriors(i), rand_prune_);
+      if (posterior == 0.0) continue;
+      SubVector<BaseFloat> inv_var(inv_vars, i);
+      offset.AddVecDivVec(1.0, SubVector<BaseFloat>(means_invvars, i),
+                          inv_var, 0.0);  // get mean.
+      offset.AddVec(-1.0, frame);
+      offsets.Row(num_pairs).CopyFromVec(offset);
+      for (int32 j = 0; j < dim; j++)
+        scales(j, num_pairs) = posterior * inv_var(j);
+      this_beta += posterior;
+      if (++num_pairs == block_size) {
+        AccumulateOffsets(offsets, scales, &G);
+        num_pairs = 0;
+      }
+    }
+  }
+  if (num_pairs != 0)
+    AccumulateOffsets(offsets.RowRange(0, num_pairs),
+                      scales.ColRange(0, num_pairs), &G);
+
+  mutex_.Lock();
+  beta_ += this_beta;
+  for (int32 j = 0; j < dim; j++)
+    G_[j].AddSp(1.0, G[j]);
+  mutex_.Unlock();
+  return tot_loglike;
+}
+
 BaseFloat MlltAccs::AccumulateFromGmm(const DiagGmm &gmm,
                                       const VectorBase<BaseFloat> &data,
                                       BaseFloat weight) {  // e.g. weight = 1.0
@@ -29,6 +29,7 @@
 #include "transform/regression-tree.h"
 #include "util/kaldi-table.h"
 #include "util/kaldi-holder.h"
+#include "thread/kaldi-mutex.h"
 
 
 
@@ -66,10 +67,13 @@ class MlltAccs {
   ///                   improvement is measured relative to this value).
   ///  @param [out] objf_impr_out  The objective function improvement
   ///  @param [out] count_out  The data-count
+  ///  @param [in] num_threads  The number of threads used to invert the G
+  ///                   matrices.
   void Update(MatrixBase<BaseFloat> *M,
               BaseFloat *objf_impr_out,
-              BaseFloat *count_out) const {
-    Update(beta_, G_, M, objf_impr_out, count_out);
+              BaseFloat *count_out,
+              int32 num_threads = 1) const {
+    Update(beta_, G_, M, objf_impr_out, count_out, num_threads);
   }
 
   // A static version of the Update function, so it can
@@ -78,7 +82,8 @@ class MlltAccs {
                      const std::vector<SpMatrix<double> > &G,
                      MatrixBase<BaseFloat> *M,
                      BaseFloat *objf_impr_out,
-                     BaseFloat *count_out);
+                     BaseFloat *count_out,
+                     int32 num_threads = 1);
 
 
   void AccumulateFromPosteriors(const DiagGmm &gmm,
@@ -95,6 +100,20 @@ class MlltAccs {
                                        const VectorBase<BaseFloat> &data,
                                        BaseFloat weight);  // e.g. weight = 1.0
 
+  /// Accumulates stats for a set of frames, e.g. an utterance: frame
+  /// data.Row(i) is aligned to the GMM *(gmms[i]) with weight weights(i), and
+  /// if gselect != NULL, (*gselect)[i] is its Gaussian selection.  This is
+  /// equivalent to calling AccumulateFromGmm() or AccumulateFromGmmPreselect()
+  /// for each frame, but faster, as the stats of many (frame, Gaussian)
+  /// pairs are added together as rank-k updates.  It may be called from
+  /// multiple threads at once.  Returns the sum of the GMM log-likelihoods
+  /// times the weights.
+  BaseFloat AccumulateFromGmms(const std::vector<const DiagGmm*> &gmms,
+                               const MatrixBase<BaseFloat> &data,
+                               const VectorBase<BaseFloat> &weights,
+                               const std::vector<std::vector<int32> > *gselect
+                               = NULL);
+
   
   // premultiplies the means of the model by M.  typically called
   // after update.
@@ -107,6 +126,16 @@ class MlltAccs {
   BaseFloat rand_prune_;
   double beta_;  // count.
   std::vector<SpMatrix<double> > G_;  // the G matrices (d matrices of size d x d)
+
+ private:
+  // Adds to "G" the stats of a block of (frame, Gaussian) pairs: the rows of
+  // "offsets" are the means minus the frames, and column k of "scales" is the
+  // posterior of pair k times the Gaussian's inverse variance.
+  static void AccumulateOffsets(const MatrixBase<double> &offsets,
+                                const MatrixBase<double> &scales,
+                                std::vector<SpMatrix<double> > *G);
+
+  Mutex mutex_;  // Guards beta_ and G_ in AccumulateFromGmms().
 };
 
 } // namespace kaldi
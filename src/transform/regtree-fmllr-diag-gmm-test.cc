@@ -23,6 +23,9 @@
 #include "gmm/mle-am-diag-gmm.h"
 #include "gmm/model-test-common.h"
 #include "transform/regtree-fmllr-diag-gmm.h"
+#include "transform/decodable-am-diag-gmm-regtree.h"
+#include "hmm/hmm-topology.h"
+#include "tree/context-dep.h"
 
 namespace kaldi {
 
@@ -252,10 +255,47 @@ void UnitTestRegtreeFmllrDiagGmm(cova_type feature_type, size_t max_bclass) {
       loglike += fmllr_accs->AccumulateForGmm(regtree, *am, *adapt_feats[j], 0, 1.0);
       loglike += logdet[j]->operator()(0);
     }
+    if (iteration == 0) {
+      // Check that AccumulateForUtterance() gives the same stats (before the
+      // first iteration, the log-determinants are zero).
+      Matrix<BaseFloat> feats(adapt_feats.size(), dim);
+      std::vector<std::vector<std::pair<int32, BaseFloat> > >
+          pdf_post(adapt_feats.size());
+      for (size_t j = 0; j < adapt_feats.size(); j++) {
+        feats.Row(j).CopyFromVec(*adapt_feats[j]);
+        pdf_post[j].push_back(std::make_pair(0, 1.0));
+      }
+      RegtreeFmllrDiagGmmAccs utt_accs;
+      utt_accs.Init(regtree.NumBaseclasses(), dim);
+      AssertEqual(loglike, utt_accs.AccumulateForUtterance(regtree, *am, feats,
+                                                           pdf_post), 1e-4);
+      for (int32 b = 0; b < regtree.NumBaseclasses(); b++) {
+        const AffineXformStats &stats = *(fmllr_accs->baseclass_stats()[b]),
+            &utt_stats = *(utt_accs.baseclass_stats()[b]);
+        AssertEqual(stats.beta_, utt_stats.beta_, 1e-4);
+        AssertEqual(stats.K_, utt_stats.K_, 1e-4);
+        for (size_t d = 0; d < dim; d++)
+          AssertEqual(stats.G_[d], utt_stats.G_[d], 1e-4);
+      }
+    }
     std::cout << "FMLLR: Loglikelihood before iteration " << iteration << " : "
               << std::scientific << loglike << '\n';
 
     fmllr_accs->Update(regtree, xform_opts, new_fmllr, NULL, NULL);
+    {
+      // The transforms do not depend on the number of threads.
+      RegtreeFmllrDiagGmm fmllr_threaded;
+      fmllr_accs->Update(regtree, xform_opts, &fmllr_threaded, NULL, NULL,
+                         2 + Rand() % 3);
+      KALDI_ASSERT(fmllr_threaded.NumRegClasses() ==
+                   new_fmllr->NumRegClasses());
+      for (int32 i = 0; i < new_fmllr->NumRegClasses(); i++) {
+        Matrix<BaseFloat> xform, xform_threaded;
+        new_fmllr->GetXformMatrix(i, &xform);
+        fmllr_threaded.GetXformMatrix(i, &xform_threaded);
+        KALDI_ASSERT(xform.ApproxEqual(xform_threaded, 0.0));
+      }
+    }
     std::cout << "Got " << new_fmllr->NumBaseClasses() << " baseclasses\n";
     bool binary = (RandUniform() < 0.5)? true : false;
     std::cout << "Writing the transform to disk.\n";
@@ -303,6 +343,134 @@ void UnitTestRegtreeFmllrDiagGmm(cova_type feature_type, size_t max_bclass) {
   DeletePointers(&train_feats);
   DeletePointers(&adapt_feats);
 }
+
+// Makes a random model with a few pdfs, and a regression tree for it.
+static void InitRandModel(int32 dim, int32 num_pdfs, AmDiagGmm *am,
+                          RegressionTree *regtree) {
+  for (int32 p = 0; p < num_pdfs; p++) {
+    DiagGmm gmm;
+    unittest::InitRandDiagGmm(dim, 2 + Rand() % 3, &gmm);
+    am->AddPdf(gmm);
+  }
+  Vector<BaseFloat> occs(num_pdfs);
+  occs.Set(1.0 / num_pdfs);
+  std::vector<int32> silphones;
+  regtree->BuildTree(occs, silphones, *am, 2 + Rand() % 4);
+}
+
+// Checks that AccumulateForUtterance() gives the same stats as
+// AccumulateForGmm(), for an utterance with several blocks of frames (the last
+// one partial) and several pdfs per frame, in different base classes.
+void UnitTestRegtreeFmllrAccumulateForUtterance() {
+  int32 dim = 5 + Rand() % 3, num_pdfs = 2 + Rand() % 4,
+      num_frames = 600 + Rand() % 300;
+  AmDiagGmm am;
+  RegressionTree regtree;
+  InitRandModel(dim, num_pdfs, &am, &regtree);
+  KALDI_ASSERT(regtree.NumBaseclasses() > 1);
+
+  Matrix<BaseFloat> feats(num_frames, dim);
+  feats.SetRandn();
+  std::vector<std::vector<std::pair<int32, BaseFloat> > > pdf_post(num_frames);
+  RegtreeFmllrDiagGmmAccs accs, utt_accs;
+  accs.Init(regtree.NumBaseclasses(), dim);
+  utt_accs.Init(regtree.NumBaseclasses(), dim);
+  BaseFloat loglike = 0.0;
+  for (int32 t = 0; t < num_frames; t++) {
+    for (int32 p = 0; p < num_pdfs; p++) {
+      if (Rand() % 2 == 0) continue;  // some frames have no pdfs.
+      BaseFloat weight = RandUniform();
+      pdf_post[t].push_back(std::make_pair(p, weight));
+      loglike += accs.AccumulateForGmm(regtree, am, feats.Row(t), p, weight);
+    }
+  }
+  AssertEqual(loglike, utt_accs.AccumulateForUtterance(regtree, am, feats,
+                                                       pdf_post), 1e-4);
+  for (int32 b = 0; b < regtree.NumBaseclasses(); b++) {
+    const AffineXformStats &stats = *(accs.baseclass_stats()[b]),
+        &utt_stats = *(utt_accs.baseclass_stats()[b]);
+    AssertEqual(stats.beta_, utt_stats.beta_, 1e-4);
+    AssertEqual(stats.K_, utt_stats.K_, 1e-4);
+    for (int32 d = 0; d < dim; d++)
+      AssertEqual(stats.G_[d], utt_stats.G_[d], 1e-4);
+  }
+}
+
+// Checks that DecodableAmDiagGmmRegtreeFmllr, which transforms the features a
+// block of frames at a time, gives the same likelihoods as transforming each
+// frame with TransformFeature(), including when it goes back to earlier frames.
+void UnitTestRegtreeFmllrDecodable() {
+  std::vector<int32> phones;
+  for (int32 i = 1; i <= 3; i++)
+    phones.push_back(i);
+  int32 N = 1 + Rand() % 2, P = Rand() % N;
+  std::vector<int32> num_pdf_classes;
+  ContextDependency *ctx_dep =
+      GenRandContextDependencyLarge(phones, N, P, true, &num_pdf_classes);
+  TransitionModel trans_model(*ctx_dep, GetDefaultTopology(phones));
+  delete ctx_dep;
+
+  int32 dim = 5 + Rand() % 3, num_pdfs = trans_model.NumPdfs(),
+      num_frames = 70 + Rand() % 50;
+  AmDiagGmm am;
+  RegressionTree regtree;
+  InitRandModel(dim, num_pdfs, &am, &regtree);
+
+  int32 num_bclass = regtree.NumBaseclasses(),
+      num_xforms = 1 + Rand() % num_bclass;
+  RegtreeFmllrDiagGmm fmllr;
+  fmllr.Init(num_xforms, dim);
+  for (int32 r = 0; r < num_xforms; r++) {
+    Matrix<BaseFloat> xform(dim, dim + 1);
+    xform.SetRandn();
+    xform.Scale(0.2);
+    for (int32 d = 0; d < dim; d++)
+      xform(d, d) += 1.0;
+    fmllr.SetParameters(xform, r);
+  }
+  std::vector<int32> bclass2xforms(num_bclass);
+  for (int32 b = 0; b < num_bclass; b++)
+    bclass2xforms[b] = Rand() % num_xforms;
+  fmllr.set_bclass2xforms(bclass2xforms);
+  fmllr.ComputeLogDets();
+  Vector<BaseFloat> logdets(num_xforms);
+  fmllr.GetLogDets(&logdets);
+
+  Matrix<BaseFloat> feats(num_frames, dim);
+  feats.SetRandn();
+  DecodableAmDiagGmmRegtreeFmllr decodable(am, trans_model, feats, fmllr,
+                                           regtree, 1.0);
+
+  // All the frames in order, then back to an earlier block, then random
+  // frames.
+  std::vector<int32> frames;
+  for (int32 t = 0; t < num_frames; t++)
+    frames.push_back(t);
+  for (int32 t = 10; t < 50; t++)
+    frames.push_back(t);
+  for (int32 i = 0; i < 50; i++)
+    frames.push_back(Rand() % num_frames);
+
+  std::vector<Vector<BaseFloat> > xformed_feats;
+  for (size_t i = 0; i < frames.size(); i++) {
+    int32 t = frames[i];
+    fmllr.TransformFeature(feats.Row(t), &xformed_feats);
+    for (int32 tid = 1; tid <= trans_model.NumTransitionIds(); tid++) {
+      int32 p = trans_model.TransitionIdToPdf(tid);
+      const DiagGmm &pdf = am.GetPdf(p);
+      Vector<BaseFloat> loglikes(pdf.gconsts());
+      for (int32 g = 0; g < pdf.NumGauss(); g++) {
+        int32 r = fmllr.Base2RegClass(regtree.Gauss2BaseclassId(p, g));
+        Vector<BaseFloat> xformed_sq(xformed_feats[r]);
+        xformed_sq.ApplyPow(2.0);
+        loglikes(g) += VecVec(pdf.means_invvars().Row(g), xformed_feats[r]) -
+            0.5 * VecVec(pdf.inv_vars().Row(g), xformed_sq) + logdets(r);
+      }
+      AssertEqual(decodable.LogLikelihood(t, tid), loglikes.LogSumExp(), 1e-4);
+    }
+  }
+}
+
 }  // namespace kaldi ends here
 
 int main() {
@@ -315,6 +483,10 @@ int main() {
     kaldi::UnitTestRegtreeFmllrDiagGmm(kaldi::diag, (i%10+1));
     std::cout << "--------------------------------------" << '\n';
   }
+  for (int i = 0; i < 5; i++) {
+    kaldi::UnitTestRegtreeFmllrAccumulateForUtterance();
+    kaldi::UnitTestRegtreeFmllrDecodable();
+  }
   std::cout << "Test OK.\n";
 }
 
@@ -23,6 +23,7 @@
 using std::vector;
 
 #include "itf/optimizable-itf.h"
+#include "thread/kaldi-thread.h"
 #include "transform/fmllr-diag-gmm.h"
 #include "transform/regtree-fmllr-diag-gmm.h"
 
@@ -282,6 +283,96 @@ void RegtreeFmllrDiagGmmAccs::AccumulateForGaussian(
     G[d].AddSp((weight_d * pdf.inv_vars()(gauss_index, d)), scatter);
 }
 
+BaseFloat RegtreeFmllrDiagGmmAccs::AccumulateForUtterance(
+    const RegressionTree &regtree, const AmDiagGmm &am,
+    const MatrixBase<BaseFloat> &data,
+    const vector<vector<std::pair<int32, BaseFloat> > > &pdf_post) {
+  KALDI_ASSERT(data.NumCols() == dim_ &&
+               static_cast<size_t>(data.NumRows()) == pdf_post.size());
+  // For each block of frames, and each base class, we work out per frame the
+  // sums over the Gaussians of the posteriors times the inverse variances (the
+  // scales on the frame's scatter in the rows of G), and times the means times
+  // inverse variances (the terms of K).  We then add the stats of the block
+  // with a matrix multiplication for K, and one for all the rows of G, whose
+  // columns are the scatters of the frames as packed matrices.
+  const int32 kBlockSize = 256;
+  int32 num_frames = data.NumRows(),
+      packed_dim = (dim_ + 1) * (dim_ + 2) / 2;
+  BaseFloat tot_like = 0.0;
+  vector<Matrix<double> > g_scales(num_baseclasses_), k_terms(num_baseclasses_);
+  // The frames of the block that each base class has posteriors for.
+  vector<vector<int32> > bclass_frames(num_baseclasses_);
+  vector<int32> block_bclasses;
+  Matrix<double> extended_data, scatters;
+  SpMatrix<double> scatter(dim_ + 1);
+  Vector<BaseFloat> posterior;
+  for (int32 start = 0; start < num_frames; start += kBlockSize) {
+    int32 block_size = std::min(kBlockSize, num_frames - start);
+    for (int32 t = 0; t < block_size; t++) {
+      SubVector<BaseFloat> frame(data, start + t);
+      const vector<std::pair<int32, BaseFloat> > &post = pdf_post[start + t];
+      for (size_t j = 0; j < post.size(); j++) {
+        int32 pdf_index = post[j].first;
+        const DiagGmm &pdf = am.GetPdf(pdf_index);
+        int32 num_comp = pdf.NumGauss();
+        posterior.Resize(num_comp, kUndefined);
+        tot_like += pdf.ComponentPosteriors(frame, &posterior);
+        posterior.Scale(post[j].second);
+        for (int32 m = 0; m < num_comp; m++) {
+          int32 bclass = regtree.Gauss2BaseclassId(pdf_index, m);
+          vector<int32> &frames = bclass_frames[bclass];
+          if (frames.empty()) {
+            block_bclasses.push_back(bclass);
+            g_scales[bclass].Resize(block_size, dim_);
+            k_terms[bclass].Resize(block_size, dim_);
+          }
+          if (frames.empty() || frames.back() != t)
+            frames.push_back(t);
+          baseclass_stats_[bclass]->beta_ += posterior(m);
+          k_terms[bclass].Row(t).AddVec(posterior(m),
+                                        pdf.means_invvars().Row(m));
+          g_scales[bclass].Row(t).AddVec(posterior(m), pdf.inv_vars().Row(m));
+        }
+      }
+    }
+    extended_data.Resize(block_size, dim_ + 1, kUndefined);
+    extended_data.Range(0, block_size, 0, dim_).CopyFromMat(
+        data.RowRange(start, block_size));
+    extended_data.Range(0, block_size, dim_, 1).Set(1.0);
+    scatters.Resize(block_size, packed_dim, kUndefined);
+    for (int32 t = 0; t < block_size; t++) {
+      scatter.SetZero();
+      scatter.AddVec2(1.0, extended_data.Row(t));
+      scatters.Row(t).CopyFromPacked(scatter);
+    }
+    for (size_t i = 0; i < block_bclasses.size(); i++) {
+      int32 bclass = block_bclasses[i];
+      vector<int32> &frames = bclass_frames[bclass];
+      int32 n = frames.size();
+      Matrix<double> frame_data(n, dim_ + 1, kUndefined),
+          frame_scatters(n, packed_dim, kUndefined),
+          g_scale(n, dim_, kUndefined), k_term(n, dim_, kUndefined);
+      for (int32 k = 0; k < n; k++) {
+        frame_data.Row(k).CopyFromVec(extended_data.Row(frames[k]));
+        frame_scatters.Row(k).CopyFromVec(scatters.Row(frames[k]));
+        g_scale.Row(k).CopyFromVec(g_scales[bclass].Row(frames[k]));
+        k_term.Row(k).CopyFromVec(k_terms[bclass].Row(frames[k]));
+      }
+      AffineXformStats *stats = baseclass_stats_[bclass];
+      stats->K_.AddMatMat(1.0, k_term, kTrans, frame_data, kNoTrans, 1.0);
+      Matrix<double> g_terms(dim_, packed_dim, kUndefined);
+      g_terms.AddMatMat(1.0, g_scale, kTrans, frame_scatters, kNoTrans, 0.0);
+      for (int32 d = 0; d < dim_; d++) {
+        SubVector<double> g(stats->G_[d].Data(), packed_dim);
+        g.AddVec(1.0, g_terms.Row(d));
+      }
+      frames.clear();
+    }
+    block_bclasses.clear();
+  }
+  return tot_like;
+}
+
 void RegtreeFmllrDiagGmmAccs::Write(std::ostream &out, bool binary) const {
   WriteToken(out, binary, "<FMLLRACCS>");
   WriteToken(out, binary, "<NUMBASECLASSES>");
@@ -316,13 +407,50 @@ void RegtreeFmllrDiagGmmAccs::Read(std::istream &in, bool binary, bool add) {
 }
 
 
+// This class is used to estimate the transforms of the different classes in
+// multiple threads, in RegtreeFmllrDiagGmmAccs::Update().
+class RegtreeFmllrUpdateClass: public MultiThreadable {
+ public:
+  RegtreeFmllrUpdateClass(const vector<AffineXformStats*> &stats,
+                          const std::string &update_type, int32 num_iters,
+                          vector<Matrix<BaseFloat> > *xforms,
+                          vector<BaseFloat> *auxf_impr):
+      stats_(stats), update_type_(update_type), num_iters_(num_iters),
+      xforms_(xforms), auxf_impr_(auxf_impr) { }
+  void operator () () {
+    for (size_t i = thread_id_; i < stats_.size(); i += num_threads_) {
+      const AffineXformStats &stats = *(stats_[i]);
+      Matrix<BaseFloat> &xform = (*xforms_)[i];
+      xform.Resize(stats.dim_, stats.dim_ + 1);
+      xform.SetUnit();
+      if (update_type_ == "full")
+        (*auxf_impr_)[i] = ComputeFmllrMatrixDiagGmmFull(xform, stats,
+                                                         num_iters_, &xform);
+      else if (update_type_ == "diag")
+        (*auxf_impr_)[i] = ComputeFmllrMatrixDiagGmmDiagonal(xform, stats,
+                                                             &xform);
+      else if (update_type_ == "offset")
+        (*auxf_impr_)[i] = ComputeFmllrMatrixDiagGmmOffset(xform, stats,
+                                                           &xform);
+      else  // "none"
+        (*auxf_impr_)[i] = 0.0;
+    }
+  }
+ private:
+  const vector<AffineXformStats*> &stats_;
+  std::string update_type_;
+  int32 num_iters_;
+  vector<Matrix<BaseFloat> > *xforms_;
+  vector<BaseFloat> *auxf_impr_;
+};
+
 void RegtreeFmllrDiagGmmAccs::Update(const RegressionTree &regtree,
                               const RegtreeFmllrOptions &opts,
                               RegtreeFmllrDiagGmm *out_fmllr,
                               BaseFloat *auxf_impr_out,
-                              BaseFloat *tot_t_out) const {
+                              BaseFloat *tot_t_out,
+                              int32 num_threads) const {
   BaseFloat tot_auxf_impr = 0.0, tot_t = 0.0;
-  Matrix<BaseFloat> xform_mat(dim_, dim_+1);
   if (opts.use_regtree) {  // estimate transforms using a regression tree
     vector<AffineXformStats*> regclass_stats;
     vector<int32> base2regclass;
@@ -331,19 +459,22 @@ void RegtreeFmllrDiagGmmAccs::Update(const RegressionTree &regtree,
     out_fmllr->set_bclass2xforms(base2regclass);
     // If update_xforms == true, none should be negative, else all should be -1
     if (update_xforms) {
-      out_fmllr->Init(regclass_stats.size(), dim_);
       size_t num_rclass = regclass_stats.size();
+      out_fmllr->Init(num_rclass, dim_);
+      vector<Matrix<BaseFloat> > xforms(num_rclass);
+      vector<BaseFloat> auxf_impr(num_rclass);
+      {
+        MultiThreader<RegtreeFmllrUpdateClass> m(
+            num_threads, RegtreeFmllrUpdateClass(regclass_stats, "full",
+                                                 opts.num_iters, &xforms,
+                                                 &auxf_impr));
+      }
       for (size_t rclass_index = 0;
            rclass_index < num_rclass; ++rclass_index) {
         KALDI_ASSERT(regclass_stats[rclass_index]->beta_ >= opts.min_count);
-        xform_mat.SetUnit();
         tot_t += regclass_stats[rclass_index]->beta_;
-
-        tot_auxf_impr +=
-            ComputeFmllrMatrixDiagGmmFull(xform_mat, *(regclass_stats[rclass_index]),
-                                          opts.num_iters, &xform_mat);
-        
-        out_fmllr->SetParameters(xform_mat, rclass_index);
+        tot_auxf_impr += auxf_impr[rclass_index];
+        out_fmllr->SetParameters(xforms[rclass_index], rclass_index);
       }
       KALDI_LOG << "Estimated " << num_rclass << " regression classes.";
     } else {
@@ -352,56 +483,46 @@ void RegtreeFmllrDiagGmmAccs::Update(const RegressionTree &regtree,
     DeletePointers(&regclass_stats);
     // end of estimation using regression tree
   } else {  // No regtree: estimate 1 transform per baseclass (if enough count)
-    for (int32 bclass_index = 0; bclass_index < num_baseclasses_;
-         ++bclass_index) {
-      tot_t += baseclass_stats_[bclass_index]->beta_;
-    }
-
+    if (opts.update_type != "full" && opts.update_type != "diag" &&
+        opts.update_type != "offset" && opts.update_type != "none")
+      KALDI_ERR << "Unknown fMLLR update type " << opts.update_type
+                << ", fmllr-update-type must be one of \"full\"|\"diag\"|\"offset\"|\"none\"";
     out_fmllr->Init(num_baseclasses_, dim_);
     vector<int32> base2regclass(num_baseclasses_);
+    vector<AffineXformStats*> update_stats;
     for (int32 bclass_index = 0; bclass_index < num_baseclasses_;
          ++bclass_index) {
+      tot_t += baseclass_stats_[bclass_index]->beta_;
       if (baseclass_stats_[bclass_index]->beta_ >= opts.min_count) {
-        xform_mat.SetUnit();
-
-        if (opts.update_type == "full") {
-          tot_auxf_impr +=
-              ComputeFmllrMatrixDiagGmmFull(xform_mat,
-                                            *(baseclass_stats_[bclass_index]),
-                                            opts.num_iters, &xform_mat);
-        } else if (opts.update_type == "diag")
-          tot_auxf_impr +=
-              ComputeFmllrMatrixDiagGmmDiagonal(xform_mat,
-                                                *(baseclass_stats_[bclass_index]),
-                                                &xform_mat);
-        else if (opts.update_type == "offset")
-          tot_auxf_impr +=
-              ComputeFmllrMatrixDiagGmmOffset(xform_mat,
-                                              *(baseclass_stats_[bclass_index]),
-                                              &xform_mat);
-        else if (opts.update_type == "none")
-          tot_auxf_impr = 0.0;
-        else
-          KALDI_ERR << "Unknown fMLLR update type " << opts.update_type
-                    << ", fmllr-update-type must be one of \"full\"|\"diag\"|\"offset\"|\"none\"";
-
-        out_fmllr->SetParameters(xform_mat, bclass_index);
         base2regclass[bclass_index] = bclass_index;
+        update_stats.push_back(baseclass_stats_[bclass_index]);
       } else {
         KALDI_WARN << "For baseclass " << (bclass_index) << " count = "
                    << (baseclass_stats_[bclass_index]->beta_) << " < "
                    << opts.min_count << ": not updating FMLLR";
         base2regclass[bclass_index] = -1;
       }
-      out_fmllr->set_bclass2xforms(base2regclass);
-    }  // end looping over all baseclasses
+    }
+    vector<Matrix<BaseFloat> > xforms(update_stats.size());
+    vector<BaseFloat> auxf_impr(update_stats.size());
+    {
+      MultiThreader<RegtreeFmllrUpdateClass> m(
+          num_threads, RegtreeFmllrUpdateClass(update_stats, opts.update_type,
+                                               opts.num_iters, &xforms,
+                                               &auxf_impr));
+    }
+    for (int32 bclass_index = 0, i = 0; bclass_index < num_baseclasses_;
+         ++bclass_index) {
+      if (base2regclass[bclass_index] == -1) continue;
+      tot_auxf_impr += auxf_impr[i];
+      out_fmllr->SetParameters(xforms[i], bclass_index);
+      i++;
+    }
+    out_fmllr->set_bclass2xforms(base2regclass);
   }  // end of estimating one transform per baseclass without regtree
   if (auxf_impr_out) *auxf_impr_out = tot_auxf_impr;
   if (tot_t_out) *tot_t_out = tot_t;
 }
 
-
-
-
 }  // namespace kaldi
 
@@ -167,9 +167,22 @@ class RegtreeFmllrDiagGmmAccs {
                              size_t pdf_index, size_t gauss_index,
                              BaseFloat weight);
 
+  /// Accumulate stats for a whole utterance, given for each frame the pdfs
+  /// and their posteriors (as from ConvertPosteriorToPdfs()).  Gives the same
+  /// stats as calling AccumulateForGmm() for each frame and pdf, and returns
+  /// the sum of what it would have returned; but it is faster, as the stats
+  /// are added for blocks of frames with matrix-matrix operations.
+  BaseFloat AccumulateForUtterance(
+      const RegressionTree &regtree, const AmDiagGmm &am,
+      const MatrixBase<BaseFloat> &data,
+      const std::vector<std::vector<std::pair<int32, BaseFloat> > > &pdf_post);
+
+  /// Estimates the transforms.  The transforms of the different regression
+  /// classes (or base classes) are estimated in parallel, using "num_threads"
+  /// threads.
   void Update(const RegressionTree &regtree, const RegtreeFmllrOptions &opts,
               RegtreeFmllrDiagGmm *out_fmllr, BaseFloat *auxf_impr,
-              BaseFloat *tot_t) const;
+              BaseFloat *tot_t, int32 num_threads = 1) const;
 
   void Write(std::ostream &out_stream, bool binary) const;
   void Read(std::istream &in_stream, bool binary, bool add);
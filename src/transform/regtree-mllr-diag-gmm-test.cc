@@ -109,6 +109,15 @@ void TestXformMean(const kaldi::AmDiagGmm &am_gmm,
   opts.min_count = 100;
   opts.use_regtree = false;
   accs.Update(regtree, opts, &mllr, NULL, NULL);
+  // The transforms do not depend on the number of threads.
+  kaldi::RegtreeMllrDiagGmm mllr_threaded;
+  accs.Update(regtree, opts, &mllr_threaded, NULL, NULL,
+              2 + kaldi::Rand() % 3);
+  KALDI_ASSERT(mllr.xform_matrices().size() ==
+               mllr_threaded.xform_matrices().size());
+  for (size_t i = 0; i < mllr.xform_matrices().size(); i++)
+    KALDI_ASSERT(mllr.xform_matrices()[i].ApproxEqual(
+        mllr_threaded.xform_matrices()[i], 0.0));
 
   kaldi::AmDiagGmm am1;
   am1.CopyFromAmDiagGmm(am_gmm);
@@ -145,6 +154,31 @@ void TestXformMean(const kaldi::AmDiagGmm &am_gmm,
   kaldi::AssertEqual(loglike, loglike1, 1e-6);
 }
 
+// Checks that AccumulateForUtterance() gives the same stats as
+// AccumulateForGmm() for each frame.
+void TestMllrAccumulateForUtterance(const kaldi::AmDiagGmm &am_gmm,
+                                    const kaldi::RegressionTree &regtree,
+                                    const RegtreeMllrDiagGmmAccs &accs,
+                                    const kaldi::Matrix<BaseFloat> &adapt_data,
+                                    BaseFloat loglike) {
+  std::vector<std::vector<std::pair<int32, BaseFloat> > >
+      pdf_post(adapt_data.NumRows());
+  for (size_t j = 0; j < pdf_post.size(); j++)
+    pdf_post[j].push_back(std::make_pair(0, 1.0));
+  kaldi::RegtreeMllrDiagGmmAccs utt_accs;
+  utt_accs.Init(accs.NumBaseClasses(), accs.Dim());
+  BaseFloat utt_loglike = utt_accs.AccumulateForUtterance(regtree, am_gmm,
+                                                          adapt_data, pdf_post);
+  kaldi::AssertEqual(loglike, utt_loglike, 1e-4);
+  for (int32 b = 0; b < accs.NumBaseClasses(); b++) {
+    const kaldi::AffineXformStats &stats = *(accs.baseclass_stats()[b]),
+        &utt_stats = *(utt_accs.baseclass_stats()[b]);
+    kaldi::AssertEqual(stats.beta_, utt_stats.beta_, 1e-4);
+    kaldi::AssertEqual(stats.K_, utt_stats.K_, 1e-4);
+    for (int32 d = 0; d < accs.Dim(); d++)
+      kaldi::AssertEqual(stats.G_[d], utt_stats.G_[d], 1e-4);
+  }
+}
 
 void UnitTestRegtreeMllrDiagGmm() {
   size_t dim = 1 + kaldi::RandInt(1, 9);  // random dimension of the gmm
@@ -181,6 +215,7 @@ void UnitTestRegtreeMllrDiagGmm() {
   KALDI_LOG << "Per-frame loglike during accumulations = " << (loglike/npoints)
             << " over " << npoints << " frames.";
 
+  TestMllrAccumulateForUtterance(am_gmm, regtree, accs, adapt_data, loglike);
   TestMllrAccsIO(am_gmm, regtree, accs, adapt_data);
   TestXformMean(am_gmm, regtree, accs, adapt_data);
 }
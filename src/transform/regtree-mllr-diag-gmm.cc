@@ -22,6 +22,7 @@ using std::pair;
 #include <vector>
 using std::vector;
 
+#include "thread/kaldi-thread.h"
 #include "transform/regtree-mllr-diag-gmm.h"
 
 namespace kaldi {
@@ -247,6 +248,83 @@ void RegtreeMllrDiagGmmAccs::AccumulateForGaussian(
     G[d].AddSp((weight_d * pdf.inv_vars()(gauss_index, d)), mean_scatter);
 }
 
+BaseFloat RegtreeMllrDiagGmmAccs::AccumulateForUtterance(
+    const RegressionTree &regtree, const AmDiagGmm &am,
+    const MatrixBase<BaseFloat> &data,
+    const vector<vector<std::pair<int32, BaseFloat> > > &pdf_post) {
+  KALDI_ASSERT(data.NumCols() == dim_ &&
+               static_cast<size_t>(data.NumRows()) == pdf_post.size());
+  // The stats depend on the data only through the occupancy of each Gaussian
+  // and the sum of the data weighted by its posteriors, so we first work these
+  // out for the pdfs seen in the utterance.
+  vector<int32> pdf2index(am.NumPdfs(), -1), pdfs;
+  for (size_t t = 0; t < pdf_post.size(); t++) {
+    for (size_t j = 0; j < pdf_post[t].size(); j++) {
+      int32 pdf_index = pdf_post[t][j].first;
+      if (pdf2index[pdf_index] == -1) {
+        pdf2index[pdf_index] = pdfs.size();
+        pdfs.push_back(pdf_index);
+      }
+    }
+  }
+  vector<Vector<double> > occs(pdfs.size());
+  vector<Matrix<double> > data_sums(pdfs.size());
+  for (size_t i = 0; i < pdfs.size(); i++) {
+    int32 num_comp = am.GetPdf(pdfs[i]).NumGauss();
+    occs[i].Resize(num_comp);
+    data_sums[i].Resize(num_comp, dim_);
+  }
+  BaseFloat tot_like = 0.0;
+  Vector<BaseFloat> posterior;
+  for (size_t t = 0; t < pdf_post.size(); t++) {
+    SubVector<BaseFloat> frame(data, t);
+    for (size_t j = 0; j < pdf_post[t].size(); j++) {
+      int32 pdf_index = pdf_post[t][j].first, i = pdf2index[pdf_index];
+      const DiagGmm &pdf = am.GetPdf(pdf_index);
+      posterior.Resize(pdf.NumGauss(), kUndefined);
+      tot_like += pdf.ComponentPosteriors(frame, &posterior);
+      posterior.Scale(pdf_post[t][j].second);
+      occs[i].AddVec(1.0, posterior);
+      data_sums[i].AddVecVec(1.0, posterior, frame);
+    }
+  }
+
+  // Now add the stats of the Gaussians of each base class.  The terms of G
+  // are added as a rank-k update for each dimension.
+  vector<vector<std::pair<int32, int32> > > bclass_gauss(num_baseclasses_);
+  for (size_t i = 0; i < pdfs.size(); i++)
+    for (int32 m = 0; m < occs[i].Dim(); m++)
+      bclass_gauss[regtree.Gauss2BaseclassId(pdfs[i], m)].push_back(
+          std::make_pair(static_cast<int32>(i), m));
+  for (int32 bclass = 0; bclass < num_baseclasses_; bclass++) {
+    int32 num_gauss = bclass_gauss[bclass].size();
+    if (num_gauss == 0) continue;
+    AffineXformStats *stats = baseclass_stats_[bclass];
+    Matrix<double> extended_means(num_gauss, dim_ + 1),
+        inv_var_x(num_gauss, dim_), g_scales(dim_, num_gauss);
+    for (int32 n = 0; n < num_gauss; n++) {
+      int32 i = bclass_gauss[bclass][n].first,
+          m = bclass_gauss[bclass][n].second;
+      const DiagGmm &pdf = am.GetPdf(pdfs[i]);
+      double occ = occs[i](m);
+      stats->beta_ += occ;
+      SubVector<double> mean(extended_means, n);
+      SubVector<double> tmp_mean(mean, 0, dim_);
+      pdf.GetComponentMean(m, &tmp_mean);
+      mean(dim_) = 1.0;
+      inv_var_x.Row(n).CopyFromVec(pdf.inv_vars().Row(m));
+      inv_var_x.Row(n).MulElements(data_sums[i].Row(m));
+      for (int32 d = 0; d < dim_; d++)
+        g_scales(d, n) = occ * pdf.inv_vars()(m, d);
+    }
+    stats->K_.AddMatMat(1.0, inv_var_x, kTrans, extended_means, kNoTrans, 1.0);
+    for (int32 d = 0; d < dim_; d++)
+      stats->G_[d].AddMat2Vec(1.0, extended_means, kTrans, g_scales.Row(d),
+                              1.0);
+  }
+  return tot_like;
+}
+
 void RegtreeMllrDiagGmmAccs::Write(std::ostream &out, bool binary) const {
   WriteToken(out, binary, "<MLLRACCS>");
   WriteToken(out, binary, "<NUMBASECLASSES>");
@@ -319,13 +397,40 @@ static BaseFloat MllrAuxFunction(const Matrix<BaseFloat> &xform,
   return obj;
 }
 
+// This class is used to estimate the transforms of the different classes in
+// multiple threads, in RegtreeMllrDiagGmmAccs::Update().
+class RegtreeMllrUpdateClass: public MultiThreadable {
+ public:
+  RegtreeMllrUpdateClass(const vector<AffineXformStats*> &stats,
+                         vector<Matrix<BaseFloat> > *xforms,
+                         vector<BaseFloat> *obj_old,
+                         vector<BaseFloat> *obj_new):
+      stats_(stats), xforms_(xforms), obj_old_(obj_old), obj_new_(obj_new) { }
+  void operator () () {
+    for (size_t i = thread_id_; i < stats_.size(); i += num_threads_) {
+      const AffineXformStats &stats = *(stats_[i]);
+      Matrix<BaseFloat> &xform = (*xforms_)[i];
+      xform.Resize(stats.dim_, stats.dim_ + 1);
+      xform.SetUnit();
+      (*obj_old_)[i] = MllrAuxFunction(xform, stats);
+      ComputeMllrMatrix(stats.K_, stats.G_, &xform);
+      (*obj_new_)[i] = MllrAuxFunction(xform, stats);
+    }
+  }
+ private:
+  const vector<AffineXformStats*> &stats_;
+  vector<Matrix<BaseFloat> > *xforms_;
+  vector<BaseFloat> *obj_old_;
+  vector<BaseFloat> *obj_new_;
+};
+
 void RegtreeMllrDiagGmmAccs::Update(const RegressionTree &regtree,
                                     const RegtreeMllrOptions &opts,
                                     RegtreeMllrDiagGmm *out_mllr,
                                     BaseFloat *auxf_impr,
-                                    BaseFloat *t) const {
+                                    BaseFloat *t,
+                                    int32 num_threads) const {
   BaseFloat tot_auxf_impr = 0, tot_t = 0;
-  Matrix<BaseFloat> xform_mat(dim_, dim_ + 1);
   if (opts.use_regtree) {  // estimate transforms using a regression tree
     vector<AffineXformStats*> regclass_stats;
     vector<int32> base2regclass;
@@ -334,26 +439,29 @@ void RegtreeMllrDiagGmmAccs::Update(const RegressionTree &regtree,
     out_mllr->set_bclass2xforms(base2regclass);
     // If update_xforms == true, none should be negative, else all should be -1
     if (update_xforms) {
-      out_mllr->Init(regclass_stats.size(), dim_);
-      for (int32 rclass_index = 0, num_rclass = regclass_stats.size();
-           rclass_index < num_rclass; ++rclass_index) {
+      int32 num_rclass = regclass_stats.size();
+      out_mllr->Init(num_rclass, dim_);
+      vector<Matrix<BaseFloat> > xforms(num_rclass);
+      vector<BaseFloat> obj_old(num_rclass), obj_new(num_rclass);
+      {
+        MultiThreader<RegtreeMllrUpdateClass> m(
+            num_threads, RegtreeMllrUpdateClass(regclass_stats, &xforms,
+                                                &obj_old, &obj_new));
+      }
+      for (int32 rclass_index = 0; rclass_index < num_rclass; ++rclass_index) {
         KALDI_ASSERT(regclass_stats[rclass_index]->beta_ >= opts.min_count);
-        xform_mat.SetUnit();
-        BaseFloat obj_old = MllrAuxFunction(xform_mat,
-                                            *(regclass_stats[rclass_index]));
-        ComputeMllrMatrix(regclass_stats[rclass_index]->K_,
-                          regclass_stats[rclass_index]->G_, &xform_mat);
-        out_mllr->SetParameters(xform_mat, rclass_index);
-        BaseFloat obj_new = MllrAuxFunction(xform_mat,
-                                            *(regclass_stats[rclass_index]));
+        out_mllr->SetParameters(xforms[rclass_index], rclass_index);
         KALDI_LOG << "MLLR: regclass " << (rclass_index)
                   << ": Objective function impr per frame is "
-                  << ((obj_new - obj_old)/regclass_stats[rclass_index]->beta_)
+                  << ((obj_new[rclass_index] - obj_old[rclass_index])
+                      / regclass_stats[rclass_index]->beta_)
                   << " over " << regclass_stats[rclass_index]->beta_
                   << " frames.";
-        KALDI_ASSERT(obj_new >= obj_old - (std::abs(obj_new)+std::abs(obj_old))*1.0e-05);
+        KALDI_ASSERT(obj_new[rclass_index] >= obj_old[rclass_index] -
+                     (std::abs(obj_new[rclass_index]) +
+                      std::abs(obj_old[rclass_index])) * 1.0e-05);
         tot_t += regclass_stats[rclass_index]->beta_;
-        tot_auxf_impr += obj_new - obj_old;
+        tot_auxf_impr += obj_new[rclass_index] - obj_old[rclass_index];
       }
     } else {
       out_mllr->Init(1, dim_);  // Use a unit transform at the root.
@@ -363,31 +471,40 @@ void RegtreeMllrDiagGmmAccs::Update(const RegressionTree &regtree,
   } else {  // estimate 1 transform per baseclass (if enough count)
     out_mllr->Init(num_baseclasses_, dim_);
     vector<int32> base2xforms(num_baseclasses_, -1);
+    vector<AffineXformStats*> update_stats;
     for (int32 bclass_index = 0; bclass_index < num_baseclasses_;
          ++bclass_index) {
       if (baseclass_stats_[bclass_index]->beta_ > opts.min_count) {
         base2xforms[bclass_index] = bclass_index;
-        xform_mat.SetUnit();
-        BaseFloat obj_old = MllrAuxFunction(xform_mat,
-                                            *(baseclass_stats_[bclass_index]));
-        ComputeMllrMatrix(baseclass_stats_[bclass_index]->K_,
-                          baseclass_stats_[bclass_index]->G_, &xform_mat);
-        out_mllr->SetParameters(xform_mat, bclass_index);
-        BaseFloat obj_new = MllrAuxFunction(xform_mat,
-                                            *(baseclass_stats_[bclass_index]));
-        KALDI_LOG << "MLLR: base-class " << (bclass_index)
-                  << ": Auxiliary function impr per frame is "
-                  << ((obj_new-obj_old)/baseclass_stats_[bclass_index]->beta_);
-        KALDI_ASSERT(obj_new >= obj_old - (std::abs(obj_new)+std::abs(obj_old))*1.0e-05);
-        tot_t += baseclass_stats_[bclass_index]->beta_;
-        tot_auxf_impr += obj_new - obj_old;
+        update_stats.push_back(baseclass_stats_[bclass_index]);
       } else {
         KALDI_WARN << "For baseclass "  << (bclass_index) << " count = "
                    << (baseclass_stats_[bclass_index]->beta_) << " < "
                    << opts.min_count << ": not updating MLLR";
-        tot_t += baseclass_stats_[bclass_index]->beta_;
       }
-    }  // end looping over all baseclasses
+      tot_t += baseclass_stats_[bclass_index]->beta_;
+    }
+    vector<Matrix<BaseFloat> > xforms(update_stats.size());
+    vector<BaseFloat> obj_old(update_stats.size()),
+        obj_new(update_stats.size());
+    {
+      MultiThreader<RegtreeMllrUpdateClass> m(
+          num_threads, RegtreeMllrUpdateClass(update_stats, &xforms,
+                                              &obj_old, &obj_new));
+    }
+    for (int32 bclass_index = 0, i = 0; bclass_index < num_baseclasses_;
+         ++bclass_index) {
+      if (base2xforms[bclass_index] == -1) continue;
+      out_mllr->SetParameters(xforms[i], bclass_index);
+      KALDI_LOG << "MLLR: base-class " << (bclass_index)
+                << ": Auxiliary function impr per frame is "
+                << ((obj_new[i] - obj_old[i])
+                    / baseclass_stats_[bclass_index]->beta_);
+      KALDI_ASSERT(obj_new[i] >= obj_old[i] - (std::abs(obj_new[i]) +
+                                               std::abs(obj_old[i])) * 1.0e-05);
+      tot_auxf_impr += obj_new[i] - obj_old[i];
+      i++;
+    }
     out_mllr->set_bclass2xforms(base2xforms);
   }  // end of estimating one transform per baseclass
   if (auxf_impr != NULL) *auxf_impr = tot_auxf_impr;
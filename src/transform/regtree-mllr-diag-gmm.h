@@ -122,9 +122,22 @@ class RegtreeMllrDiagGmmAccs {
                              int32 pdf_index, int32 gauss_index,
                              BaseFloat weight);
 
+  /// Accumulate stats for a whole utterance, given for each frame the pdfs
+  /// and their posteriors (as from ConvertPosteriorToPdfs()).  Gives the same
+  /// stats as calling AccumulateForGmm() for each frame and pdf, and returns
+  /// the sum of what it would have returned; but it is faster, as it first
+  /// sums the occupancies and data of each Gaussian over the utterance.
+  BaseFloat AccumulateForUtterance(
+      const RegressionTree &regtree, const AmDiagGmm &am,
+      const MatrixBase<BaseFloat> &data,
+      const std::vector<std::vector<std::pair<int32, BaseFloat> > > &pdf_post);
+
+  /// Estimates the transforms.  The transforms of the different regression
+  /// classes (or base classes) are estimated in parallel, using "num_threads"
+  /// threads.
   void Update(const RegressionTree &regtree, const RegtreeMllrOptions &opts,
               RegtreeMllrDiagGmm *out_mllr, BaseFloat *auxf_impr,
-              BaseFloat *t) const;
+              BaseFloat *t, int32 num_threads = 1) const;
 
   void Write(std::ostream &out_stream, bool binary) const;
   void Read(std::istream &in_stream, bool binary, bool add);
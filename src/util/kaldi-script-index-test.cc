@@ -0,0 +1,89 @@
+// util/kaldi-script-index-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <sstream>
+#include "util/kaldi-script-index.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+void UnitTestScriptIndex() {
+  int32 sz = Rand() % 100;
+  std::vector<std::pair<std::string, std::string> > script;
+  for (int32 i = 0; i < sz; i++) {
+    std::ostringstream key, rxfilename;
+    key << "utt" << (Rand() % 1000) << "_" << i;
+    switch (Rand() % 4) {
+      case 0: rxfilename << "foo.ark:" << Rand(); break;
+      case 1: rxfilename << "bar/baz.ark:" << (Rand() % 10); break;
+      case 2: rxfilename << "file" << i << ".mat"; break;
+      default: rxfilename << "gunzip -c foo" << (i % 3) << ".gz |";
+    }
+    script.push_back(std::make_pair(key.str(), rxfilename.str()));
+  }
+  std::sort(script.begin(), script.end());
+  std::vector<std::pair<std::string, std::string> > script_copy(script);
+
+  ScriptIndex index;
+  index.Init(&script_copy);
+  KALDI_ASSERT(script_copy.empty());
+  KALDI_ASSERT(index.Size() == script.size());
+  for (size_t i = 0; i < script.size(); i++) {
+    size_t pos;
+    KALDI_ASSERT(index.Lookup(script[i].first, &pos) && pos == i);
+    KALDI_ASSERT(index.Key(i) == script[i].first);
+    KALDI_ASSERT(index.KeyIs(i, script[i].first));
+    KALDI_ASSERT(index.Rxfilename(i) == script[i].second);
+    bool has_offset = (script[i].second.find(".ark:") != std::string::npos);
+    KALDI_ASSERT(has_offset == (index.Offset(i) != -1));
+    size_t pos2;
+    KALDI_ASSERT(!index.Lookup(script[i].first + "x", &pos2) ||
+                 (i + 1 < script.size() &&
+                  script[i+1].first == script[i].first + "x"));
+  }
+  // Entries in the same archive share the file index.
+  for (size_t i = 0; i + 1 < script.size(); i++) {
+    if (index.Offset(i) != -1 && index.Offset(i+1) != -1) {
+      std::string f1 = script[i].second, f2 = script[i+1].second;
+      f1 = f1.substr(0, f1.find(':'));
+      f2 = f2.substr(0, f2.find(':'));
+      KALDI_ASSERT((f1 == f2) == (index.FileIndex(i) == index.FileIndex(i+1)));
+    }
+  }
+  size_t pos;
+  KALDI_ASSERT(!index.Lookup("", &pos));
+  KALDI_ASSERT(!index.Lookup("zzz", &pos));
+  if (sz > 0) {
+    int32 i = Rand() % sz;
+    index.Erase(i);
+    KALDI_ASSERT(index.IsErased(i) && index.Rxfilename(i) == "");
+    KALDI_ASSERT(index.Lookup(script[i].first, &pos) && pos == i);
+  }
+  index.Clear();
+  KALDI_ASSERT(index.Size() == 0);
+}
+
+}  // end namespace kaldi.
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 100; i++)
+    UnitTestScriptIndex();
+  std::cout << "Test OK.\n";
+  return 0;
+}
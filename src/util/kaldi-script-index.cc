@@ -0,0 +1,112 @@
+// util/kaldi-script-index.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <map>
+#include <sstream>
+#include "util/kaldi-script-index.h"
+#include "util/kaldi-io.h"
+#include "util/text-utils.h"
+
+namespace kaldi {
+
+void ScriptIndex::Init(
+    std::vector<std::pair<std::string, std::string> > *script) {
+  Clear();
+  size_t num_entries = script->size(), tot_key_length = 0;
+  for (size_t i = 0; i < num_entries; i++)
+    tot_key_length += (*script)[i].first.size() + 1;
+  keys_.reserve(tot_key_length);
+  key_begin_.reserve(num_entries);
+  file_index_.reserve(num_entries);
+  offset_.reserve(num_entries);
+
+  std::map<std::string, int32> filename_to_index;
+  for (size_t i = 0; i < num_entries; i++) {
+    const std::string &key = (*script)[i].first,
+        &rxfilename = (*script)[i].second;
+    KALDI_ASSERT(i == 0 || (*script)[i-1].first < key);
+    key_begin_.push_back(keys_.size());
+    keys_.insert(keys_.end(), key.begin(), key.end());
+    keys_.push_back('\0');
+
+    std::string filename = rxfilename;
+    int64 offset = -1;
+    if (ClassifyRxfilename(rxfilename) == kOffsetFileInput) {
+      size_t pos = rxfilename.find_last_of(':');
+      if (ConvertStringToInteger(std::string(rxfilename, pos + 1), &offset))
+        filename = std::string(rxfilename, 0, pos);
+      else
+        offset = -1;  // leave it as it is; the error will appear on reading.
+    }
+    std::map<std::string, int32>::iterator iter =
+        filename_to_index.find(filename);
+    int32 file_index;
+    if (iter != filename_to_index.end()) {
+      file_index = iter->second;
+    } else {
+      file_index = filenames_.size();
+      filenames_.push_back(filename);
+      filename_to_index[filename] = file_index;
+    }
+    file_index_.push_back(file_index);
+    offset_.push_back(offset);
+  }
+  std::vector<std::pair<std::string, std::string> > temp;
+  script->swap(temp);  // free the memory.
+}
+
+void ScriptIndex::Clear() {
+  std::vector<char> temp_keys;
+  keys_.swap(temp_keys);
+  std::vector<size_t> temp_begin;
+  key_begin_.swap(temp_begin);
+  filenames_.clear();
+  std::vector<int32> temp_index;
+  file_index_.swap(temp_index);
+  std::vector<int64> temp_offset;
+  offset_.swap(temp_offset);
+}
+
+bool ScriptIndex::Lookup(const std::string &key, size_t *index) const {
+  size_t begin = 0, end = Size();
+  const char *key_str = key.c_str();
+  while (begin < end) {  // invariant: the key, if present, is in [begin, end).
+    size_t middle = begin + (end - begin) / 2;
+    int c = std::strcmp(&(keys_[key_begin_[middle]]), key_str);
+    if (c == 0) {
+      *index = middle;
+      return true;
+    } else if (c < 0) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return false;
+}
+
+std::string ScriptIndex::Rxfilename(size_t index) const {
+  int32 file_index = file_index_[index];
+  if (file_index == -1) return "";
+  if (offset_[index] == -1) return filenames_[file_index];
+  std::ostringstream os;
+  os << filenames_[file_index] << ':' << offset_[index];
+  return os.str();
+}
+
+}  // end namespace kaldi
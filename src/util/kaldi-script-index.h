@@ -0,0 +1,100 @@
+// util/kaldi-script-index.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_SCRIPT_INDEX_H_
+#define KALDI_UTIL_KALDI_SCRIPT_INDEX_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/// \addtogroup table_impl_types
+/// @{
+
+/// ScriptIndex is a compact, sorted, in-memory representation of an scp file,
+/// used by RandomAccessTableReaderScriptImpl.  Storing an scp file as a
+/// std::vector<std::pair<std::string, std::string> > costs two std::string
+/// objects plus usually two heap allocations per line, which matters for scp
+/// files with tens of millions of lines.  Here the keys are stored
+/// consecutively in one buffer, and rxfilenames of the form
+/// "/some/archive.ark:12345" (which is what "ark,scp" output produces) are
+/// stored as an index into a de-duplicated list of archive filenames plus an
+/// offset.  Other rxfilenames (plain files, pipes) are stored as they are.
+class ScriptIndex {
+ public:
+  ScriptIndex() { }
+
+  /// Initializes the index from "script", which must be sorted on the key and
+  /// contain no duplicate keys (the calling code checks this).  "script" is
+  /// cleared, to free the memory.
+  void Init(std::vector<std::pair<std::string, std::string> > *script);
+
+  void Clear();
+
+  size_t Size() const { return file_index_.size(); }
+
+  /// Looks up "key" by binary search; returns true and sets *index if found.
+  bool Lookup(const std::string &key, size_t *index) const;
+
+  /// Returns the key of entry "index".
+  std::string Key(size_t index) const {
+    return std::string(&(keys_[key_begin_[index]]));
+  }
+
+  /// Returns true if the key at position "index" equals "key"; this is faster
+  /// than comparing with Key(index).
+  bool KeyIs(size_t index, const std::string &key) const {
+    return key.compare(&(keys_[key_begin_[index]])) == 0;
+  }
+
+  /// Returns the rxfilename of entry "index", e.g. "/some/archive.ark:12345";
+  /// returns the empty string if the entry was erased.
+  std::string Rxfilename(size_t index) const;
+
+  /// Returns an index (into the list of distinct filenames) that identifies
+  /// the file that entry "index" is in, or -1 if the entry was erased.
+  /// Entries that are offsets into the same archive share the same file index.
+  int32 FileIndex(size_t index) const { return file_index_[index]; }
+
+  /// Returns the byte offset into the file for entries of the form
+  /// "filename:offset", or -1 for other entries.
+  int64 Offset(size_t index) const { return offset_[index]; }
+
+  /// Marks the entry as erased (used for the "once" option: such entries
+  /// will be found by Lookup() but Rxfilename() will return "").
+  void Erase(size_t index) { file_index_[index] = -1; }
+
+  bool IsErased(size_t index) const { return file_index_[index] == -1; }
+
+ private:
+  std::vector<char> keys_;  // Null-terminated keys, concatenated.
+  std::vector<size_t> key_begin_;  // Position in keys_ of each key.
+  std::vector<std::string> filenames_;  // Distinct filenames.
+  std::vector<int32> file_index_;  // Index into filenames_ for each entry.
+  std::vector<int64> offset_;  // Offset into the file, or -1.
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ScriptIndex);
+};
+
+/// @} end "addtogroup table_impl_types"
+
+}  // end namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_SCRIPT_INDEX_H_
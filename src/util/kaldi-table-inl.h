@@ -24,6 +24,7 @@
 
 #include <algorithm>
 #include "util/kaldi-io.h"
+#include "util/kaldi-script-index.h"
 #include "util/text-utils.h"
 #include "util/stl-utils.h" // for StringHasher.
 
@@ -59,7 +60,18 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
  public:
   typedef typename Holder::T T;
 
-  SequentialTableReaderScriptImpl(): state_(kUninitialized) { }
+  SequentialTableReaderScriptImpl(): shard_(0), num_shards_(1),
+                                     line_number_(0), state_(kUninitialized) { }
+
+  // Restricts reading to lines shard, shard + num_shards, shard +
+  // 2*num_shards, ... of the script file (counting from zero).  Must be
+  // called before Open().
+  void SetShard(int32 shard, int32 num_shards) {
+    KALDI_ASSERT(state_ == kUninitialized && num_shards > 0 &&
+                 shard >= 0 && shard < num_shards);
+    shard_ = shard;
+    num_shards_ = num_shards;
+  }
 
   virtual bool Open(const std::string &rspecifier) {
     if (state_ != kUninitialized)
@@ -68,6 +80,7 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
                   << "rspecifier was " << rspecifier_;
     bool binary;
     rspecifier_ = rspecifier;
+    line_number_ = 0;
     RspecifierType rs = ClassifyRspecifier(rspecifier, &script_rxfilename_,
                                            &opts_);
     KALDI_ASSERT(rs == kScriptRspecifier);
@@ -248,7 +261,13 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
         KALDI_ERR << "Reading script file: Next called wrongly.";
     }
     std::string line;
-    if (getline(script_input_.Stream(), line)) {
+    bool have_line;
+    // Skip over lines that belong to other shards (if num_shards_ == 1
+    // this loop only executes once).
+    while ((have_line = static_cast<bool>(
+                getline(script_input_.Stream(), line))) &&
+           line_number_++ % num_shards_ != shard_);
+    if (have_line) {
       SplitStringOnFirstSpace(line, &key_, &data_rxfilename_);
       if (!key_.empty() && !data_rxfilename_.empty()) {
         // Got a valid line.
@@ -278,6 +297,9 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
   std::string script_rxfilename_;  // of the script file.
   RspecifierOptions opts_;  // options.
   std::string data_rxfilename_;  // of the file we're reading.
+  int32 shard_;  // we read only lines whose index modulo num_shards_ equals
+  int32 num_shards_;  // shard_; by default, num_shards_ == 1.
+  int64 line_number_;  // index of the next line of the script file.
   enum StateType {
     //       [The state of the reading process]               [does holder_ [is script_inp_
     //                                                         have object]   open]
@@ -540,6 +562,31 @@ bool SequentialTableReader<Holder>::Open(const std::string &rspecifier) {
   else return true;
 }
 
+template<class Holder>
+bool SequentialTableReader<Holder>::OpenShard(const std::string &rspecifier,
+                                              int32 shard, int32 num_shards) {
+  if (IsOpen())
+    if (!Close())
+      KALDI_ERR << "Could not close previously open object.";
+  if (num_shards <= 0 || shard < 0 || shard >= num_shards)
+    KALDI_ERR << "Invalid shard " << shard << " of " << num_shards;
+  if (ClassifyRspecifier(rspecifier, NULL, NULL) != kScriptRspecifier) {
+    KALDI_WARN << "Only scp rspecifiers can be opened in shards, got "
+               << rspecifier;
+    return false;
+  }
+  SequentialTableReaderScriptImpl<Holder> *impl =
+      new SequentialTableReaderScriptImpl<Holder>();
+  impl->SetShard(shard, num_shards);
+  impl_ = impl;
+  if (!impl_->Open(rspecifier)) {
+    delete impl_;
+    impl_ = NULL;
+    return false;  // sub-object will have printed warnings.
+  }
+  return true;
+}
+
 template<class Holder>
 bool SequentialTableReader<Holder>::Close() {
   CheckImpl();  
@@ -1245,11 +1292,12 @@ class RandomAccessTableReaderScriptImpl:
                                            &script_rxfilename_,
                                            &opts_);
     KALDI_ASSERT(rs == kScriptRspecifier);  // or wrongly called.
-    KALDI_ASSERT(script_.empty());  // no way it could be nonempty at this point.
+    KALDI_ASSERT(script_.Size() == 0);  // no way it could be nonempty at this point.
 
+    std::vector<std::pair<std::string, std::string> > script;
     if (! ReadScriptFile(script_rxfilename_,
                         true,  // print any warnings
-                        &script_)) {  // error reading script file or invalid format
+                        &script)) {  // error reading script file or invalid format
       state_ = kNotReadScript;
       return false;  // no need to print further warnings.  user gets the error.
     }
@@ -1260,19 +1308,20 @@ class RandomAccessTableReaderScriptImpl:
     // mistake.  This same mistake could have serious effects if used with an
     // archive rather than a script.
     if (!opts_.sorted)
-      std::sort(script_.begin(), script_.end());
-    for (size_t i = 0; i+1 < script_.size(); i++) {
-      if (script_[i].first.compare(script_[i+1].first) >= 0) {
+      std::sort(script.begin(), script.end());
+    for (size_t i = 0; i+1 < script.size(); i++) {
+      if (script[i].first.compare(script[i+1].first) >= 0) {
         // script[i] not < script[i+1] in lexical order...
-        bool same = (script_[i].first == script_[i+1].first);
+        bool same = (script[i].first == script[i+1].first);
         KALDI_WARN << "Script file " << PrintableRxfilename(script_rxfilename_)
                    << (same ? " contains duplicate key: " :
                        " is not sorted (remove s, option or add ns, option): key is ")
-                   << script_[i].first;
+                   << script[i].first;
         state_ = kNotReadScript;
         return false;
       }
     }
+    script_.Init(&script);  // this frees the memory of "script".
     state_ = kNotHaveObject;
     return true;
   }
@@ -1288,7 +1337,10 @@ class RandomAccessTableReaderScriptImpl:
     holder_.Clear();
     state_ = kUninitialized;
     last_found_ = 0;
-    script_.clear();
+    script_.Clear();
+    ClearInputCache();
+    if (input_.IsOpen())
+      input_.Close();
     current_key_ = "";
     // This one cannot fail because any errors of a "global"
     // nature would have been detected when we did Open().
@@ -1336,6 +1388,7 @@ class RandomAccessTableReaderScriptImpl:
   virtual ~RandomAccessTableReaderScriptImpl() {
     if (state_ == kHaveObject || state_ == kGaveObject)
       holder_.Clear();
+    ClearInputCache();
   }
 
  private:
@@ -1361,7 +1414,7 @@ class RandomAccessTableReaderScriptImpl:
     if (!ans) return false;
     else {
       // First do a check regarding the "once" option.
-      if (opts_.once && script_[key_pos].second == "") {  // A "tombstone"; user is asking about
+      if (opts_.once && script_.IsErased(key_pos)) {  // A "tombstone"; user is asking about
         // already-read key.
         KALDI_ERR << "HasKey called on key whose value was already read, and "
             " you specified the \"once\" option (o, ): try removing o, or adding no, :"
@@ -1370,21 +1423,22 @@ class RandomAccessTableReaderScriptImpl:
       if (!preload)
         return true;  // we have the key.
       else {  // preload specified, so we have to pre-load the object before returning true.
-        if (!input_.Open(script_[key_pos].second)) {
+        Input *input = OpenEntry(key_pos);
+        if (input == NULL) {
           KALDI_WARN << "Error opening stream "
-                     << PrintableRxfilename(script_[key_pos].second);
+                     << PrintableRxfilename(script_.Rxfilename(key_pos));
           return false;
         } else {
           // Make sure holder empty.
           if (state_ == kHaveObject || state_ == kGaveObject)
             holder_.Clear();
-          if (holder_.Read(input_.Stream())) {
+          if (holder_.Read(input->Stream())) {
             state_ = kHaveObject;
             current_key_ = key;
             return true;
           } else {
             KALDI_WARN << "Error reading object from "
-                "stream " << PrintableRxfilename(script_[key_pos].second);
+                "stream " << PrintableRxfilename(script_.Rxfilename(key_pos));
             state_ = kNotHaveObject;
             return false;
           }
@@ -1397,39 +1451,78 @@ class RandomAccessTableReaderScriptImpl:
     if (!LookupKey(key, &offset))
       KALDI_ERR << "RandomAccessTableReader object in inconsistent state.";
     else
-      script_[offset].second = "";
+      script_.Erase(offset);
   }
   bool LookupKey(const std::string &key, size_t *script_offset) {
     // First, an optimization: if we're going consecutively, this will
     // make the lookup very fast.  Since we may call HasKey and then
     // Value(), which both may look up the key, we test if either the
     // current or next position are correct.
-    if (last_found_ < script_.size() && script_[last_found_].first == key) {
+    if (last_found_ < script_.Size() && script_.KeyIs(last_found_, key)) {
       *script_offset = last_found_;
       return true;
     }
     last_found_++;
-    if (last_found_ < script_.size() && script_[last_found_].first == key) {
+    if (last_found_ < script_.Size() && script_.KeyIs(last_found_, key)) {
       *script_offset = last_found_;
       return true;
     }
-    std::pair<std::string, std::string> pr(key, "");  // Important that ""
-    // compares less than or equal to any string, so lower_bound points to the
-    // element that has the same key.
-    typedef typename std::vector<std::pair<std::string, std::string> >::const_iterator 
-        IterType;
-    IterType iter = std::lower_bound(script_.begin(), script_.end(), pr);
-    if (iter != script_.end() && iter->first == key) {
-      last_found_ = *script_offset = iter - script_.begin();
+    if (script_.Lookup(key, script_offset)) {
+      last_found_ = *script_offset;
       return true;
     } else {
       return false;
     }
   }
 
-
-  Input input_;  // Use the same input_ object for reading each file, in case
-  // the scp specifies offsets in an archive (so we can keep the same file open).
+  // Opens the input for entry "key_pos" of the script and returns it, or NULL
+  // on failure.  Entries that are offsets into archives (the normal case for
+  // scp files written with "ark,scp:") are read through a small cache of open
+  // Input objects, one per archive, so that lookups that alternate between
+  // several archives do not have to re-open the files each time; within an
+  // archive, lookups in sorted order turn into short forward seeks.  Other
+  // entries (whole files, pipes) are opened with input_.
+  Input *OpenEntry(size_t key_pos) {
+    int32 file_index = script_.FileIndex(key_pos);
+    if (file_index == -1) return NULL;  // erased entry.
+    std::string rxfilename = script_.Rxfilename(key_pos);
+    if (script_.Offset(key_pos) == -1)
+      return (input_.Open(rxfilename) ? &input_ : NULL);
+    // Look for this archive in the cache, which is kept in order of most
+    // recent use.
+    size_t i = 0;
+    for (; i < input_cache_.size(); i++)
+      if (input_cache_[i].first == file_index) break;
+    std::pair<int32, Input*> entry;
+    if (i < input_cache_.size()) {
+      entry = input_cache_[i];
+    } else if (input_cache_.size() < kMaxCachedInputs) {
+      entry = std::make_pair(file_index, new Input());
+      input_cache_.push_back(entry);
+    } else {  // reuse the least recently used Input object.
+      i = input_cache_.size() - 1;
+      entry = std::make_pair(file_index, input_cache_[i].second);
+    }
+    for (; i > 0; i--)  // move it to the front.
+      input_cache_[i] = input_cache_[i-1];
+    input_cache_[0] = entry;
+    // If entry.second is already open on the same archive, Open() just seeks.
+    return (entry.second->Open(rxfilename) ? entry.second : NULL);
+  }
+
+  void ClearInputCache() {
+    for (size_t i = 0; i < input_cache_.size(); i++)
+      delete input_cache_[i].second;
+    input_cache_.clear();
+  }
+
+  // The maximum number of archives we keep open at one time.
+  static const size_t kMaxCachedInputs = 16;
+
+  Input input_;  // Input object used for entries that are not offsets into
+  // archives.
+  std::vector<std::pair<int32, Input*> > input_cache_;  // Pairs of (file index
+  // in script_, Input object open on that file), most recently used first.
   RspecifierOptions opts_;
   std::string rspecifier_;  // rspecifier used to open it; used in debug messages
   std::string script_rxfilename_;  // filename of script.
@@ -1437,15 +1530,10 @@ class RandomAccessTableReaderScriptImpl:
   std::string current_key_;  // Key of object in holder_
   Holder holder_;
 
-  // the script_ variable contains pairs of (key, filename), sorted using
-  // std::sort.  This can be used with binary_search to look up filenames for
-  // writing.  If this becomes inefficient we can use std::unordered_map (but I
-  // suspect this wouldn't be significantly faster & would use more memory).
-  // If memory becomes a problem here, the user should probably be passing
-  // only the relevant part of the scp file rather than expecting us to get too
-  // clever in the code.
-  std::vector<std::pair<std::string, std::string> > script_;
-  size_t last_found_;  // This is for an optimization used in FindFilename.
+  // the script_ variable contains the (key, filename) pairs of the scp file,
+  // sorted on the key, in a compact form; see ScriptIndex for details.
+  ScriptIndex script_;
+  size_t last_found_;  // This is for an optimization used in LookupKey.
 
   enum {  //           [Do we have          [Does holder_
     //                script_ set up?]      contain object?]
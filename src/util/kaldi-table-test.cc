@@ -625,6 +625,47 @@ void UnitTestTableSequentialInt32Script(bool binary) {
   KALDI_ASSERT(v2 == v);
 }
 
+// Writing as both, and reading the scp in shards: shard n should give lines n,
+// n + num_shards, ... of the scp.
+void UnitTestTableSequentialInt32Shards(bool binary) {
+  int32 sz = Rand() % 20, num_shards = 1 + Rand() % 4;
+  std::vector<std::string> k;
+  std::vector<int32> v;
+  for (int32 i = 0; i < sz; i++) {
+    k.push_back("a" + CharToString('a' + static_cast<char>(i)));
+    v.push_back(Rand());
+  }
+  Int32Writer bw(binary ? "b,ark,scp:tmpf,tmpf.scp" : "t,ark,scp:tmpf,tmpf.scp");
+  for (int32 i = 0; i < sz; i++)
+    bw.Write(k[i], v[i]);
+  KALDI_ASSERT(bw.Close());
+
+  std::vector<std::string> k2(sz);
+  std::vector<int32> v2(sz);
+  for (int32 shard = 0; shard < num_shards; shard++) {
+    SequentialInt32Reader sbr;
+    KALDI_ASSERT(sbr.OpenShard("scp:tmpf.scp", shard, num_shards));
+    int32 i = shard;
+    for (; !sbr.Done(); sbr.Next(), i += num_shards) {
+      KALDI_ASSERT(i < sz);
+      k2[i] = sbr.Key();
+      v2[i] = sbr.Value();
+    }
+    KALDI_ASSERT(sbr.Close());
+    KALDI_ASSERT(i >= sz);  // we saw all the lines in this shard.
+  }
+  KALDI_ASSERT(k2 == k);
+  KALDI_ASSERT(v2 == v);
+
+  SequentialInt32Reader sbr;
+  KALDI_ASSERT(!sbr.OpenShard("ark:tmpf", 0, num_shards));
+  KALDI_ASSERT(ShardWspecifier("ark,t:foo.SHARD.ark", 12) == "ark,t:foo.12.ark");
+  KALDI_ASSERT(ShardWspecifier("ark,scp:SHARD.ark,SHARD.scp", 0) ==
+               "ark,scp:0.ark,0.scp");
+  unlink("tmpf");
+  unlink("tmpf.scp");
+}
+
 // Writing as both and reading as archive.
 void UnitTestTableSequentialDoubleMatrixBoth(bool binary, bool read_scp) {
   int32 sz = Rand() % 10;
@@ -804,6 +845,49 @@ void UnitTestTableRandomBothDouble(bool binary, bool read_scp,
 }
 
 
+// Tests random access into an scp file whose entries point into several
+// archives, interleaved, which exercises the cache of open archives in
+// RandomAccessTableReaderScriptImpl.
+void UnitTestTableRandomScriptMultipleArchives(bool binary) {
+  int32 num_archives = 1 + Rand() % 20, sz = Rand() % 100;
+  std::vector<std::pair<std::string, std::string> > script;
+  std::vector<std::string> k;
+  std::vector<int32> v;
+  for (int32 a = 0; a < num_archives; a++) {
+    std::ostringstream ark;
+    ark << "tmpf." << a;
+    Int32Writer writer((binary ? "b,ark,scp:" : "t,ark,scp:") + ark.str() +
+                       "," + ark.str() + ".scp");
+    for (int32 i = a; i < sz; i += num_archives) {
+      std::ostringstream key;
+      key << "key" << i;
+      k.push_back(key.str());
+      v.push_back(Rand());
+      writer.Write(k.back(), v.back());
+    }
+    KALDI_ASSERT(writer.Close());
+    KALDI_ASSERT(ReadScriptFile(ark.str() + ".scp", true, &script));
+    unlink((ark.str() + ".scp").c_str());
+  }
+  std::sort(script.begin(), script.end());
+  WriteScriptFile("tmpf.scp", script);
+
+  RandomAccessInt32Reader reader(Rand() % 2 == 0 ? "s,scp:tmpf.scp" :
+                                 "scp:tmpf.scp");
+  for (int32 i = 0; i < 2 * sz; i++) {
+    int32 j = Rand() % sz;
+    KALDI_ASSERT(reader.HasKey(k[j]) && reader.Value(k[j]) == v[j]);
+  }
+  KALDI_ASSERT(!reader.HasKey("foo"));
+  KALDI_ASSERT(reader.Close());
+  for (int32 a = 0; a < num_archives; a++) {
+    std::ostringstream ark;
+    ark << "tmpf." << a;
+    unlink(ark.str().c_str());
+  }
+  unlink("tmpf.scp");
+}
+
 void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
                                          bool sorted, bool called_sorted,
                                          bool once) {
@@ -892,6 +976,8 @@ int main() {
     UnitTestTableSequentialBool(b);
     UnitTestTableSequentialInt32(b);
     UnitTestTableSequentialInt32Script(b);
+    UnitTestTableSequentialInt32Shards(b);
+    UnitTestTableRandomScriptMultipleArchives(b);
     UnitTestTableSequentialDouble(b);
     for (int j = 0; j < 2; j++) {
       bool c = (j == 0);
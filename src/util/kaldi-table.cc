@@ -123,6 +123,21 @@ bool WriteScriptFile(const std::string &wxfilename,
 }
 
 
+std::string ShardWspecifier(const std::string &wspecifier, int32 shard) {
+  const std::string pattern = "SHARD";
+  std::ostringstream os;
+  os << shard;
+  std::string ans = wspecifier, shard_str = os.str();
+  size_t pos = ans.find(pattern);
+  if (pos == std::string::npos)
+    KALDI_ERR << "Expected the string " << pattern << " in wspecifier "
+              << wspecifier << " when writing output per shard.";
+  while (pos != std::string::npos) {
+    ans.replace(pos, pattern.size(), shard_str);
+    pos = ans.find(pattern, pos + shard_str.size());
+  }
+  return ans;
+}
 
 WspecifierType ClassifyWspecifier(const std::string &wspecifier,
                                   std::string *archive_wxfilename,
@@ -125,6 +125,12 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
                                   std::string *script_wxfilename,
                                   WspecifierOptions *opts);
 
+// Given a wspecifier, returns the version of it for shard "shard" when output
+// is written per shard: each occurrence of the string "SHARD" is replaced by
+// the decimal shard index, e.g. "ark:foo.SHARD.ark" -> "ark:foo.3.ark".
+// Throws if the wspecifier does not contain "SHARD".
+std::string ShardWspecifier(const std::string &wspecifier, int32 shard);
+
 // ReadScriptFile reads an .scp file in its entirety, and appends it
 // (in order as it was in the scp file) in script_out_, which contains
 // pairs of (key, xfilename).  The .scp
@@ -289,6 +295,15 @@ class SequentialTableReader {
   // calling Open more than once is not recommended.]
   bool Open(const std::string &rspecifier);
 
+  // Opens a subset of a table that is read from an scp file: we only read
+  // lines shard, shard + num_shards, shard + 2*num_shards, ... of the scp
+  // file (counting from zero).  Readers opened with the same rspecifier and
+  // 0 <= shard < num_shards see disjoint subsets that together cover the
+  // whole table; this is how we split an scp between the threads of a
+  // single process (see thread/kaldi-table-shard.h).  Returns false (with a
+  // warning) if the rspecifier is not of the "scp:" type.
+  bool OpenShard(const std::string &rspecifier, int32 shard, int32 num_shards);
+
   // Returns true if we're done.  It will also return true if there's some kind
   // of error and we can't read any more; in this case, you can detect the
   // error by calling Close and checking the return status; otherwise
@@ -0,0 +1,112 @@
+// util/mapped-input-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/mapped-input.h"
+#include "util/kaldi-io.h"
+
+#include <unistd.h>
+
+namespace kaldi {
+
+// Writes a token, then 'num' int32's aligned to 16 bytes in the file, then
+// another token; returns the offset of the int32's.
+size_t WriteTestFile(const std::string &filename, int32 num) {
+  Output ko(filename, true);
+  std::ostream &os = ko.Stream();
+  WriteToken(os, true, "<Data>");
+  size_t pos = os.tellp();
+  size_t padding = (16 - pos % 16) % 16;
+  os << std::string(padding, ' ');
+  for (int32 i = 0; i < num; i++)
+    os.write(reinterpret_cast<const char*>(&i), sizeof(i));
+  WriteToken(os, true, "<End>");
+  return pos + padding;
+}
+
+void CheckTestData(const std::string &rxfilename, int32 num) {
+  bool binary;
+  MappedInput mi(rxfilename, &binary);
+  KALDI_ASSERT(binary);
+  std::istream &is = mi.Stream();
+  KALDI_ASSERT(MappedInput::IsMappedStream(is));
+  ExpectToken(is, binary, "<Data>");
+  is >> std::ws;
+  size_t pos = is.tellg();
+  KALDI_ASSERT(pos % 16 == 0);
+  // misaligned, or longer than the file: nothing is consumed.
+  is.seekg(pos + 1);
+  KALDI_ASSERT(MappedInput::MapData(is, 4, 4) == NULL);
+  KALDI_ASSERT(static_cast<size_t>(is.tellg()) == pos + 1);
+  is.seekg(pos);
+  KALDI_ASSERT(MappedInput::MapData(is, 1 << 20, 4) == NULL);
+  KALDI_ASSERT(static_cast<size_t>(is.tellg()) == pos);
+  const int32 *data = reinterpret_cast<const int32*>(
+      MappedInput::MapData(is, num * sizeof(int32), 16));
+  KALDI_ASSERT(data != NULL);
+  for (int32 i = 0; i < num; i++)
+    KALDI_ASSERT(data[i] == i);
+  ExpectToken(is, binary, "<End>");
+}
+
+void UnitTestMappedInput() {
+  std::string filename = "tmpf";
+  int32 num = 100;
+  size_t offset = WriteTestFile(filename, num);
+  KALDI_ASSERT(offset % 16 == 0);
+
+  {
+    MappedInput mi(filename);
+    KALDI_ASSERT(mi.IsMapped());
+  }
+  CheckTestData(filename, num);
+  // through a pipe the file is read into a buffer, with the same alignment.
+  {
+    MappedInput mi("cat " + filename + " |");
+    KALDI_ASSERT(!mi.IsMapped());
+  }
+  CheckTestData("cat " + filename + " |", num);
+
+  // an offset into a file (here, into the data).
+  {
+    std::ostringstream rxfilename;
+    rxfilename << filename << ":" << offset;
+    MappedInput mi(rxfilename.str());
+    std::istream &is = mi.Stream();
+    KALDI_ASSERT(static_cast<size_t>(is.tellg()) == offset);
+    int32 i;
+    is.read(reinterpret_cast<char*>(&i), sizeof(i));
+    KALDI_ASSERT(i == 0);
+  }
+
+  // streams of other kinds are never mapped.
+  {
+    bool binary;
+    Input ki(filename, &binary);
+    KALDI_ASSERT(MappedInput::MapData(ki.Stream(), 1, 1) == NULL);
+    KALDI_ASSERT(!MappedInput::IsMappedStream(ki.Stream()));
+  }
+  unlink(filename.c_str());
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestMappedInput();
+  std::cout << "Test OK.\n";
+  return 0;
+}
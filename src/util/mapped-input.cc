@@ -0,0 +1,144 @@
+// util/mapped-input.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/mapped-input.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "util/kaldi-io.h"
+#include "util/text-utils.h"
+
+namespace kaldi {
+
+MappedInput::MappedInput(const std::string &rxfilename,
+                         bool *contents_binary):
+    data_(NULL), size_(0), mapped_(false), is_(&buf_) {
+  InputType type = ClassifyRxfilename(rxfilename);
+  if (type == kNoInput)
+    KALDI_ERR << "Invalid input filename format " << rxfilename;
+  std::string filename = rxfilename;
+  size_t offset = 0;
+  if (type == kOffsetFileInput) {
+    size_t pos = rxfilename.find_last_of(':');
+    filename = std::string(rxfilename, 0, pos);
+    if (!ConvertStringToInteger(std::string(rxfilename, pos + 1), &offset))
+      KALDI_ERR << "Cannot get offset from filename " << rxfilename;
+  }
+#ifndef _MSC_VER
+  if (type == kFileInput || type == kOffsetFileInput) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+      KALDI_ERR << "Error opening " << filename << ": " << strerror(errno);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+      void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (addr != MAP_FAILED) {
+        data_ = static_cast<char*>(addr);
+        size_ = st.st_size;
+        mapped_ = true;
+      } else {
+        KALDI_WARN << "Could not map " << filename << " (" << strerror(errno)
+                   << "), reading it instead.";
+      }
+    }
+    close(fd);  // the mapping stays valid.
+  }
+#endif
+  if (!mapped_)
+    ReadIntoBuffer(type == kOffsetFileInput ? filename : rxfilename);
+  if (offset > size_)
+    KALDI_ERR << "Offset " << offset << " is past the end of " << filename;
+  // The read position is the offset into the file, as for class Input.
+  buf_.SetData(data_, size_);
+  is_.seekg(offset);
+  if (contents_binary != NULL && !InitKaldiInputStream(is_, contents_binary))
+    KALDI_ERR << "Error reading binary-mode header from " << rxfilename;
+}
+
+void MappedInput::ReadIntoBuffer(const std::string &rxfilename) {
+  Input ki(rxfilename);
+  std::string contents;
+  char block[65536];
+  while (ki.Stream().read(block, sizeof(block)) || ki.Stream().gcount() > 0)
+    contents.append(block, ki.Stream().gcount());
+  if (ki.Stream().bad())
+    KALDI_ERR << "Error reading " << rxfilename;
+  size_ = contents.size();
+  // Aligned like the start of a mapped file, so that data which is aligned in
+  // the file is aligned in memory.
+  void *free_data;
+  if ((data_ = static_cast<char*>(
+          KALDI_MEMALIGN(64, std::max<size_t>(size_, 1), &free_data))) == NULL)
+    throw std::bad_alloc();
+  if (size_ > 0) memcpy(data_, contents.data(), size_);
+}
+
+MappedInput::~MappedInput() {
+#ifndef _MSC_VER
+  if (mapped_) {
+    munmap(data_, size_);
+    return;
+  }
+#endif
+  if (data_ != NULL) KALDI_MEMALIGN_FREE(data_);
+}
+
+const char *MappedInput::MapData(std::istream &is, size_t num_bytes,
+                                 size_t alignment) {
+  MemoryBuf *buf = dynamic_cast<MemoryBuf*>(is.rdbuf());
+  if (buf == NULL) return NULL;
+  return buf->Map(num_bytes, alignment);
+}
+
+bool MappedInput::IsMappedStream(const std::istream &is) {
+  return dynamic_cast<MemoryBuf*>(is.rdbuf()) != NULL;
+}
+
+const char *MappedInput::MemoryBuf::Map(size_t num_bytes, size_t alignment) {
+  char *ans = gptr();
+  if (static_cast<size_t>(egptr() - ans) < num_bytes ||
+      reinterpret_cast<size_t>(ans) % alignment != 0)
+    return NULL;
+  setg(eback(), ans + num_bytes, egptr());
+  return ans;
+}
+
+std::streambuf::pos_type MappedInput::MemoryBuf::seekoff(
+    off_type off, std::ios_base::seekdir way, std::ios_base::openmode which) {
+  if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+  char *base = (way == std::ios_base::beg ? eback() :
+                (way == std::ios_base::cur ? gptr() : egptr()));
+  char *pos = base + off;
+  if (pos < eback() || pos > egptr()) return pos_type(off_type(-1));
+  setg(eback(), pos, egptr());
+  return pos_type(off_type(pos - eback()));
+}
+
+std::streambuf::pos_type MappedInput::MemoryBuf::seekpos(
+    pos_type pos, std::ios_base::openmode which) {
+  return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+}  // namespace kaldi
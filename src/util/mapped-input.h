@@ -0,0 +1,100 @@
+// util/mapped-input.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_MAPPED_INPUT_H_
+#define KALDI_UTIL_MAPPED_INPUT_H_
+
+#include <istream>
+#include <streambuf>
+#include <string>
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/// \addtogroup io_group
+/// @{
+
+/// MappedInput can be used instead of class Input to read objects whose data
+/// may be used in place, without copying it (e.g. the weights of nnet2's
+/// AffineComponent, see AffineComponent::ReadLinearParams()).  It maps the
+/// whole file into memory (read-only) and reads from the mapped pages through
+/// Stream(); objects that know about it call MapData() to get a pointer to
+/// their data instead of reading it.  The pages are shared with the page
+/// cache, so processes that map the same file share one copy of the data in
+/// physical memory.
+///
+/// Normal files and offsets into files (e.g. "/my/file:123") are mapped; for
+/// other rxfilenames (pipes, the standard input), or if mmap() is not
+/// available, the contents are read into an aligned buffer instead, which is
+/// used in the same way but is not shared between processes.
+///
+/// Objects that use the data in place must not be used after the MappedInput
+/// has been destroyed.
+class MappedInput {
+ public:
+  /// Maps "rxfilename" and, if contents_binary != NULL, reads the binary-mode
+  /// header into it, as class Input does.  Throws on error.
+  explicit MappedInput(const std::string &rxfilename,
+                       bool *contents_binary = NULL);
+
+  ~MappedInput();
+
+  std::istream &Stream() { return is_; }
+
+  /// Returns true if the file was mapped with mmap(), false if it was read
+  /// into a buffer.
+  bool IsMapped() const { return mapped_; }
+
+  /// If "is" is the stream of a MappedInput, returns a pointer to the next
+  /// "num_bytes" bytes of its data and moves the read position past them.
+  /// Returns NULL, leaving the position unchanged, if "is" reads from some
+  /// other kind of stream, if fewer than "num_bytes" bytes are left, or if the
+  /// data is not aligned to "alignment" bytes.
+  static const char *MapData(std::istream &is, size_t num_bytes,
+                             size_t alignment);
+
+  /// Returns true if "is" is the stream of a MappedInput (such streams are
+  /// always seekable).
+  static bool IsMappedStream(const std::istream &is);
+
+ private:
+  /// A read-only stream buffer over memory that we do not own.
+  class MemoryBuf: public std::streambuf {
+   public:
+    void SetData(char *data, size_t size) { setg(data, data, data + size); }
+    const char *Map(size_t num_bytes, size_t alignment);
+   protected:
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir way,
+                             std::ios_base::openmode which);
+    virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+  };
+
+  void ReadIntoBuffer(const std::string &rxfilename);
+
+  char *data_;  // Start of the mapped region or of the buffer.
+  size_t size_;
+  bool mapped_;
+  MemoryBuf buf_;
+  std::istream is_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MappedInput);
+};
+
+/// @} end "addtogroup io_group"
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_MAPPED_INPUT_H_